@@ -52,8 +52,28 @@ int bi_ffs(uint32 value)
 
 #define first_n_bit_mask(n)	(~(0xFFFFFFFFU >> n))
 
+// Number of cached mappings for stateless anonymizers, a power of two.
+static const int ANON_CACHE_BITS = 14;
+
 ipaddr32_t AnonymizeIPAddr::Anonymize(ipaddr32_t addr)
 	{
+	if ( Stateless() )
+		{
+		if ( cache.empty() )
+			cache.resize(1 << ANON_CACHE_BITS, CacheEntry{0, 0, false});
+
+		CacheEntry& e = cache[(addr * 2654435761U) >> (32 - ANON_CACHE_BITS)];
+
+		if ( ! (e.valid && e.input == addr) )
+			{
+			e.input = addr;
+			e.output = anonymize(addr);
+			e.valid = true;
+			}
+
+		return e.output;
+		}
+
 	map<ipaddr32_t, ipaddr32_t>::iterator p = mapping.find(addr);
 	if ( p != mapping.end() )
 		return p->second;
@@ -131,6 +151,65 @@ ipaddr32_t AnonymizeIPAddr_PrefixMD5::anonymize(ipaddr32_t input)
 	return htonl(output);
 	}
 
+AnonymizeIPAddr_CryptoPAn::AnonymizeIPAddr_CryptoPAn()
+	{
+	// The key consists of the seeded HMAC and SipHash keys, so that
+	// loading the seeds reproduces the mapping.
+	ctx = EVP_CIPHER_CTX_new();
+
+	if ( ! ctx ||
+	     ! EVP_EncryptInit_ex(ctx, EVP_aes_128_ecb(), 0, shared_hmac_md5_key, 0) )
+		reporter->InternalError("cannot initialize AES for IP anonymization");
+
+	EVP_CIPHER_CTX_set_padding(ctx, 0);
+
+	int len;
+	if ( ! EVP_EncryptUpdate(ctx, pad, &len, shared_siphash_key, sizeof(pad)) )
+		reporter->InternalError("cannot initialize AES for IP anonymization");
+	}
+
+AnonymizeIPAddr_CryptoPAn::~AnonymizeIPAddr_CryptoPAn()
+	{
+	EVP_CIPHER_CTX_free(ctx);
+	}
+
+ipaddr32_t AnonymizeIPAddr_CryptoPAn::anonymize(ipaddr32_t input)
+	{
+	uint8 in[32][16];
+	uint8 out[32][16];
+	input = ntohl(input);
+
+	uint32 pad_prefix = (uint32(pad[0]) << 24) | (uint32(pad[1]) << 16) |
+			    (uint32(pad[2]) << 8) | pad[3];
+
+	// Block i holds the first i bits of the input followed by the
+	// remaining bits of the pad.
+	for ( int i = 0; i < 32; ++i )
+		{
+		uint32 mask = i ? first_n_bit_mask(i) : 0;
+		uint32 p = (input & mask) | (pad_prefix & ~mask);
+
+		memcpy(in[i], pad, sizeof(pad));
+		in[i][0] = p >> 24;
+		in[i][1] = p >> 16;
+		in[i][2] = p >> 8;
+		in[i][3] = p;
+		}
+
+	int len;
+	if ( ! EVP_EncryptUpdate(ctx, out[0], &len, in[0], sizeof(in)) )
+		reporter->InternalError("AES failed for IP anonymization");
+
+	// Bit i of the output is bit i of the input, flipped by the first
+	// bit of block i's ciphertext.
+	ipaddr32_t flips = 0;
+
+	for ( int i = 0; i < 32; ++i )
+		flips |= uint32(out[i][0] >> 7) << (31 - i);
+
+	return htonl(input ^ flips);
+	}
+
 AnonymizeIPAddr_A50::~AnonymizeIPAddr_A50()
 	{
 	for ( unsigned int i = 0; i < blocks.size(); ++i )
@@ -354,6 +433,7 @@ void init_ip_addr_anonymizers()
 	ip_anonymizer[RANDOM_MD5] = new AnonymizeIPAddr_RandomMD5();
 	ip_anonymizer[PREFIX_PRESERVING_A50] = new AnonymizeIPAddr_A50();
 	ip_anonymizer[PREFIX_PRESERVING_MD5] = new AnonymizeIPAddr_PrefixMD5();
+	ip_anonymizer[PREFIX_PRESERVING_CRYPTOPAN] = new AnonymizeIPAddr_CryptoPAn();
 	}
 
 ipaddr32_t anonymize_ip(ipaddr32_t ip, enum ip_addr_anonymization_class_t cl)
@@ -382,7 +462,8 @@ ipaddr32_t anonymize_ip(ipaddr32_t ip, enum ip_addr_anonymization_class_t cl)
 
 	ipaddr32_t new_ip = 0;
 
-	if ( preserve_addr && preserve_addr->Lookup(&addr) )
+	if ( preserve_addr && preserve_addr->Size() > 0 &&
+	     preserve_addr->Lookup(&addr) )
 		new_ip = ip;
 
 	else if ( method >= 0 && method < NUM_ADDR_ANONYMIZATION_METHODS )
@@ -12,7 +12,7 @@ const char* attr_name(attr_tag t)
 		"&optional", "&default", "&redef",
 		"&add_func", "&delete_func", "&expire_func",
 		"&read_expire", "&write_expire", "&create_expire",
-		"&raw_output", "&priority",
+		"&raw_output", "&priority", "&batch",
 		"&group", "&log", "&error_handler", "&type_column",
 		"(&tracked)", "&deprecated",
 	};
@@ -486,6 +486,10 @@ void Attributes::CheckAttr(Attr* a)
 		Error("&priority only applicable to event bodies");
 		break;
 
+	case ATTR_BATCH:
+		Error("&batch only applicable to event bodies");
+		break;
+
 	case ATTR_GROUP:
 		if ( type->Tag() != TYPE_FUNC ||
 		     type->AsFuncType()->Flavor() != FUNC_FLAVOR_EVENT )
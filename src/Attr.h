@@ -23,6 +23,7 @@ typedef enum {
 	ATTR_EXPIRE_CREATE,
 	ATTR_RAW_OUTPUT,
 	ATTR_PRIORITY,
+	ATTR_BATCH,
 	ATTR_GROUP,
 	ATTR_LOG,
 	ATTR_ERROR_HANDLER,
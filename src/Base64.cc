@@ -175,6 +175,37 @@ int Base64Converter::Decode(int len, const char* data, int* pblen, char** pbuf)
 			base64_padding = 0;
 			}
 
+		if ( base64_group_next == 0 && ! base64_after_padding )
+			{
+			// Decode whole groups of four characters in one go
+			// for as long as there's neither padding nor anything
+			// to ignore. The general case below takes over for
+			// the rest.
+			char* buf_end = *pbuf + blen;
+
+			while ( dlen + 4 <= len && buf + 3 <= buf_end )
+				{
+				const unsigned char* p = (const unsigned char*) data + dlen;
+
+				int a = base64_table[p[0]];
+				int b = base64_table[p[1]];
+				int c = base64_table[p[2]];
+				int d = base64_table[p[3]];
+
+				if ( (a | b | c | d) < 0 ||
+				     p[0] == '=' || p[1] == '=' || p[2] == '=' || p[3] == '=' )
+					break;
+
+				uint32 bit32 = (a << 18) | (b << 12) | (c << 6) | d;
+
+				*buf++ = char((bit32 >> 16) & 0xff);
+				*buf++ = char((bit32 >> 8) & 0xff);
+				*buf++ = char((bit32) & 0xff);
+
+				dlen += 4;
+				}
+			}
+
 		if ( dlen >= len )
 			break;
 
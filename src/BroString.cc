@@ -75,7 +75,9 @@ BroString::BroString()
 
 void BroString::Reset()
 	{
-	if ( use_free_to_delete )
+	if ( b == inline_bytes )
+		;
+	else if ( use_free_to_delete )
 		free(b);
 	else
 		delete [] b;
@@ -88,9 +90,12 @@ void BroString::Reset()
 
 const BroString& BroString::operator=(const BroString &bs)
 	{
+	if ( this == &bs )
+		return *this;
+
 	Reset();
 	n = bs.n;
-	b = new u_char[n+1];
+	b = Alloc(n+1);
 
 	memcpy(b, bs.b, n);
 	b[n] = '\0';
@@ -127,7 +132,7 @@ void BroString::Set(const u_char* str, int len, int add_NUL)
 	Reset();
 
 	n = len;
-	b = new u_char[add_NUL ? n + 1 : n];
+	b = Alloc(add_NUL ? n + 1 : n);
 	memcpy(b, str, n);
 	final_NUL = add_NUL;
 
@@ -142,7 +147,7 @@ void BroString::Set(const char* str)
 	Reset();
 
 	n = strlen(str);
-	b = new u_char[n+1];
+	b = Alloc(n+1);
 	memcpy(b, str, n+1);
 	final_NUL = 1;
 	use_free_to_delete = 0;
@@ -153,7 +158,7 @@ void BroString::Set(const string& str)
 	Reset();
 
 	n = str.size();
-	b = new u_char[n+1];
+	b = Alloc(n+1);
 	memcpy(b, str.c_str(), n+1);
 	final_NUL = 1;
 	use_free_to_delete = 0;
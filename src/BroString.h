@@ -117,7 +117,10 @@ public:
 	void ToUpper();
 
 	unsigned int MemoryAllocation() const
-		{ return padded_sizeof(*this) + pad_size(n + final_NUL); }
+		{
+		return padded_sizeof(*this) +
+			(b == inline_bytes ? 0 : pad_size(n + final_NUL));
+		}
 
 	// Returns new string containing the substring of this string,
 	// starting at @start >= 0 for going up to @length elements,
@@ -146,10 +149,20 @@ public:
 protected:
 	void Reset();
 
+	// Returns space for the given number of bytes, which is the
+	// inline buffer if they fit.
+	byte_vec Alloc(int size)
+		{ return size <= INLINE_SIZE ? inline_bytes : new u_char[size]; }
+
 	byte_vec b;
 	int n;
 	unsigned int final_NUL:1;	// whether we have added a final NUL
 	unsigned int use_free_to_delete:1;	// free() vs. operator delete
+
+	// Short strings, including their final NUL, are stored right here
+	// rather than in a separate allocation.
+	static const int INLINE_SIZE = 16;
+	u_char inline_bytes[INLINE_SIZE];
 };
 
 // A comparison class that sorts pointers to BroString's according to
@@ -27,19 +27,20 @@ bool Brofiler::ReadStats()
 		return false;
 
 	char line[16384];
-	string delimiter;
-	delimiter = delim;
 
 	while( fgets(line, sizeof(line), f) )
 		{
 		line[strlen(line) - 1] = 0; //remove newline
-		string cnt(strtok(line, delimiter.c_str()));
-		string location(strtok(0, delimiter.c_str()));
-		string desc(strtok(0, delimiter.c_str()));
-		pair<string, string> location_desc(location, desc);
+
+		// The count comes first, the rest is the statement's key.
+		char* key = strchr(line, delim);
+
+		if ( ! key )
+			continue;
+
 		uint64 count;
-		atoi_n(cnt.size(), cnt.c_str(), 0, 10, count);
-		usage_map[location_desc] = count;
+		atoi_n(key - line, line, 0, 10, count);
+		usage_map[key + 1] = count;
 		}
 
 	fclose(f);
@@ -88,30 +89,38 @@ bool Brofiler::WriteStats()
 		return false;
 		}
 
-	for ( list<const Stmt*>::const_iterator it = stmts.begin();
-	      it != stmts.end(); ++it )
+	map<string, uint64> totals = usage_map;
+	const vector<string>& keys = StmtKeys();
+
+	for ( size_t i = 0; i < stmts.size(); ++i )
+		totals[keys[i]] += stmts[i]->GetAccessCount();
+
+	for ( const auto& t : totals )
+		fprintf(f, "%" PRIu64"%c%s\n", t.second, delim, t.first.c_str());
+
+	fclose(f);
+	return true;
+	}
+
+
+const vector<string>& Brofiler::StmtKeys()
+	{
+	stmt_keys.reserve(stmts.size());
+
+	for ( size_t i = stmt_keys.size(); i < stmts.size(); ++i )
 		{
 		ODesc location_info;
-		(*it)->GetLocationInfo()->Describe(&location_info);
+		stmts[i]->GetLocationInfo()->Describe(&location_info);
 		ODesc desc_info;
-		(*it)->Describe(&desc_info);
+		stmts[i]->Describe(&desc_info);
 		string desc(desc_info.Description());
 		for_each(desc.begin(), desc.end(), canonicalize_desc());
-		pair<string, string> location_desc(location_info.Description(), desc);
-		if ( usage_map.find(location_desc) != usage_map.end() )
-			usage_map[location_desc] += (*it)->GetAccessCount();
-		else
-			usage_map[location_desc] = (*it)->GetAccessCount();
-		}
 
-	map<pair<string, string>, uint64 >::const_iterator it;
-	for ( it = usage_map.begin(); it != usage_map.end(); ++it )
-		{
-		fprintf(f, "%" PRIu64"%c%s%c%s\n", it->second, delim,
-				it->first.first.c_str(), delim, it->first.second.c_str());
+		string key(location_info.Description());
+		key += delim;
+		key += desc;
+		stmt_keys.push_back(std::move(key));
 		}
 
-	fclose(f);
-	return true;
+	return stmt_keys;
 	}
-
@@ -2,8 +2,8 @@
 #define BROFILER_H_
 
 #include <map>
-#include <utility>
-#include <list>
+#include <string>
+#include <vector>
 #include <Stmt.h>
 
 
@@ -28,7 +28,9 @@ public:
 	 * then writes information to file pointed to by environment variable
 	 * ZEEK_PROFILER_FILE.  If the value of that env. variable ends with
 	 * ".XXXXXX" (exactly 6 X's), then it is first passed through mkstemp
-	 * to get a unique file.
+	 * to get a unique file.  This may be called repeatedly, e.g. to look
+	 * at the coverage of a long-running process; each time overwrites the
+	 * same file with the totals so far.
 	 *
 	 * @return: true when usage info is written, otherwise false.
 	 */
@@ -42,10 +44,25 @@ public:
 	void AddStmt(const Stmt* s) { if ( ignoring == 0 ) stmts.push_back(s); }
 
 private:
+	/**
+	 * Returns the keys of the statements in stmts, by which their usage
+	 * is combined with that of earlier runs: their location and
+	 * description, separated by delim. Describing them takes a while, so
+	 * that's done the first time they're needed.
+	 */
+	const vector<string>& StmtKeys();
+
 	/**
 	 * The current, global Brofiler instance creates this list at parse-time.
+	 * Statements count their executions themselves, so tracking them
+	 * costs nothing until the stats are written.
+	 */
+	vector<const Stmt*> stmts;
+
+	/**
+	 * The keys of the statements in stmts, in the same order.
 	 */
-	list<const Stmt*> stmts;
+	vector<string> stmt_keys;
 
 	/**
 	 * Indicates whether new statments will not be considered as part of
@@ -54,12 +71,11 @@ private:
 	unsigned int ignoring;
 
 	/**
-	 * This maps Stmt location-desc pairs to the total number of times that
-	 * Stmt has been executed.  The map can be initialized from a file at
-	 * startup time and modified at shutdown time before writing back
-	 * to a file.
+	 * This maps Stmt keys to the total number of times that Stmt has been
+	 * executed in earlier runs, as read from a file at startup time.
+	 * WriteStats() adds the counts of the current run to these.
 	 */
-	map<pair<string, string>, uint64> usage_map;
+	map<string, uint64> usage_map;
 
 	/**
 	 * The character to use to delimit Brofiler output files.  Default is '\t'.
@@ -348,6 +348,22 @@ HashKey* CompositeHash::ComputeHash(const Val* v, int type_check) const
 		type_check = 0;	// no need to type-check again.
 		}
 
+	char* kp = ComputeCompositeKey(v, type_check, k);
+
+	if ( ! kp )
+		{
+		if ( k != key )
+			delete [] reinterpret_cast<double*>(k);
+
+		return 0;
+		}
+
+	return new HashKey((k == key), (void*) k, kp - k);
+	}
+
+char* CompositeHash::ComputeCompositeKey(const Val* v, int type_check,
+					 char* k) const
+	{
 	const type_list* tl = type->Types();
 
 	if ( type_check && v->Type()->Tag() != TYPE_LIST )
@@ -365,7 +381,85 @@ HashKey* CompositeHash::ComputeHash(const Val* v, int type_check) const
 			return 0;
 		}
 
-	return new HashKey((k == key), (void*) k, kp - k);
+	return kp;
+	}
+
+bool CompositeHash::ComputeLookupKey(const Val* v, KeyBuffer* buf,
+				     const void*& k, int& key_size,
+				     hash_t& hash) const
+	{
+	if ( ! is_singleton )
+		{
+		// Keys of fixed size have the same layout in any buffer
+		// aligned like the one we keep for them.
+		if ( ! key || is_complex_type || size > int(sizeof(buf->bytes)) )
+			return false;
+
+		char* kp = ComputeCompositeKey(v, 1, buf->bytes);
+
+		if ( ! kp )
+			return false;
+
+		k = buf->bytes;
+		key_size = kp - buf->bytes;
+		hash = HashKey::HashBytes(k, key_size);
+		return true;
+		}
+
+	if ( v->Type()->Tag() == TYPE_LIST )
+		{
+		const val_list* vl = v->AsListVal()->Vals();
+		if ( vl->length() != 1 )
+			return false;
+
+		v = (*vl)[0];
+		}
+
+	if ( v->Type()->InternalType() != singleton_tag )
+		return false;
+
+	// The keys need to come out just like the ones HashKey's
+	// constructors build in ComputeSingletonHash().
+	switch ( singleton_tag ) {
+	case TYPE_INTERNAL_INT:
+	case TYPE_INTERNAL_UNSIGNED:
+		{
+		bro_int_t* kp = reinterpret_cast<bro_int_t*>(buf->bytes);
+		*kp = v->ForceAsInt();
+		k = kp;
+		key_size = sizeof(*kp);
+		break;
+		}
+
+	case TYPE_INTERNAL_DOUBLE:
+		{
+		double* kp = reinterpret_cast<double*>(buf->bytes);
+		*kp = v->InternalDouble();
+		k = kp;
+		key_size = sizeof(*kp);
+		break;
+		}
+
+	case TYPE_INTERNAL_ADDR:
+		{
+		uint32* kp = reinterpret_cast<uint32*>(buf->bytes);
+		v->AsAddr().CopyIPv6(kp);
+		k = kp;
+		key_size = 4 * sizeof(uint32);
+		break;
+		}
+
+	case TYPE_INTERNAL_STRING:
+		k = v->AsString()->Bytes();
+		key_size = v->AsString()->Len();
+		break;
+
+	default:
+		return false;
+	}
+
+	hash = HashKey::HashBytes(k, key_size);
+	return true;
 	}
 
 HashKey* CompositeHash::ComputeSingletonHash(const Val* v, int type_check) const
@@ -689,6 +783,24 @@ ListVal* CompositeHash::RecoverVals(const HashKey* k) const
 	return l;
 	}
 
+void CompositeHash::RecoverVals(const HashKey* k, Val** vals) const
+	{
+	const type_list* tl = type->Types();
+	const char* kp = (const char*) k->Key();
+	const char* const k_end = kp + k->Size();
+
+	for ( const auto& type : *tl )
+		{
+		Val* v = nullptr;
+		kp = RecoverOneVal(k, kp, k_end, type, v, false);
+		ASSERT(v);
+		*vals++ = v;
+		}
+
+	if ( kp != k_end )
+		reporter->InternalError("under-ran key in CompositeHash::DescribeKey %zd", k_end - kp);
+	}
+
 const char* CompositeHash::RecoverOneVal(const HashKey* k, const char* kp0,
 					 const char* const k_end, BroType* t,
 					 Val*& pval, bool optional) const
@@ -17,14 +17,38 @@ public:
 	// or 0 if it fails to typecheck.
 	HashKey* ComputeHash(const Val* v, int type_check) const;
 
+	// Space for keys computed by ComputeLookupKey().
+	union KeyBuffer {
+		double align;
+		char bytes[128];
+	};
+
+	// Computes the key for looking up the given index val like
+	// ComputeHash(v, 1) does, but without any heap allocation. That
+	// works for singleton indices and for composite ones of fixed size,
+	// such as [addr, port]. The key's bytes either point into v or
+	// into *buf. Returns false for other index types, and if v doesn't
+	// type-check.
+	bool ComputeLookupKey(const Val* v, KeyBuffer* buf, const void*& key,
+			      int& key_size, hash_t& hash) const;
+
 	// Given a hash key, recover the values used to create it.
 	ListVal* RecoverVals(const HashKey* k) const;
 
+	// Same, but stores the values into *vals*, which needs room for one
+	// per index type, rather than allocating a ListVal for them. The
+	// caller takes over the references.
+	void RecoverVals(const HashKey* k, Val** vals) const;
+
 	unsigned int MemoryAllocation() const { return padded_sizeof(*this) + pad_size(size); }
 
 protected:
 	HashKey* ComputeSingletonHash(const Val* v, int type_check) const;
 
+	// Fills in the key for a non-singleton index starting at k,
+	// returning the end of the key, or nil if v doesn't type-check.
+	char* ComputeCompositeKey(const Val* v, int type_check, char* k) const;
+
 	// Computes the piece of the hash for Val*, returning the new kp.
 	// Used as a helper for ComputeHash in the non-singleton case.
 	char* SingleValHash(int type_check, char* kp, BroType* bt, Val* v,
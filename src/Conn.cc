@@ -10,6 +10,7 @@
 #include "Event.h"
 #include "Sessions.h"
 #include "Reporter.h"
+#include "Stats.h"
 #include "Timer.h"
 #include "analyzer/protocol/pia/PIA.h"
 #include "binpac.h"
@@ -17,6 +18,10 @@
 #include "analyzer/Analyzer.h"
 #include "analyzer/Manager.h"
 
+IMPLEMENT_POOLED_ALLOC(Connection, CONNECTION)
+IMPLEMENT_POOLED_ALLOC(ConnectionTimer, CONNECTION)
+IMPLEMENT_OBJ_COUNTER(Connection)
+
 void ConnectionTimer::Init(Connection* arg_conn, timer_func arg_timer,
 				int arg_do_expire)
 	{
@@ -87,6 +92,9 @@ Connection::Connection(NetSessions* s, HashKey* k, double t, const ConnID* id,
 
 	conn_val = 0;
 	login_conn = 0;
+	lru_prev = lru_next = 0;
+	expiry_slot = -1;
+	expiry_prev = expiry_next = 0;
 
 	is_active = 1;
 	skip = 0;
@@ -104,7 +112,8 @@ Connection::Connection(NetSessions* s, HashKey* k, double t, const ConnID* id,
 	finished = 0;
 
 	hist_seen = 0;
-	history = "";
+	history_len = 0;
+	history_overflow = 0;
 
 	root_analyzer = 0;
 	primary_PIA = 0;
@@ -148,6 +157,7 @@ Connection::~Connection()
 	delete root_analyzer;
 	delete conn_timer_mgr;
 	delete encapsulation;
+	delete history_overflow;
 
 	--current_connections;
 	if ( conn_timer_mgr )
@@ -204,6 +214,8 @@ void Connection::NextPacket(double t, int is_orig,
 
 	if ( root_analyzer )
 		{
+		PipelineStats::Timer timer(&pipeline_stats, PipelineStats::ANALYZERS);
+
 		record_current_packet = record_packet;
 		record_current_content = record_content;
 		root_analyzer->NextPacket(len, data, is_orig, -1, ip, caplen);
@@ -228,6 +240,24 @@ bool Connection::IsReuse(double t, const u_char* pkt)
 	return root_analyzer && root_analyzer->IsReuse(t, pkt);
 	}
 
+void Connection::AddHistoryOverflow(char code)
+	{
+	if ( ! history_overflow )
+		history_overflow = new string;
+
+	*history_overflow += code;
+	}
+
+string Connection::History() const
+	{
+	string h(history, history_len);
+
+	if ( history_overflow )
+		h += *history_overflow;
+
+	return h;
+	}
+
 bool Connection::ScaledHistoryEntry(char code, uint32& counter,
                                     uint32& scaling_threshold,
                                     uint32 scaling_base)
@@ -308,9 +338,16 @@ void Connection::SetInactivityTimeout(double timeout)
 	{
 	// We add a new inactivity timer even if there already is one.  When
 	// it fires, we always use the current value to check for inactivity.
+	// In the expiry wheel, there's just a single entry per connection,
+	// which this moves.
 	if ( timeout )
-		ADD_TIMER(&Connection::InactivityTimer,
-				last_time + timeout, 0, TIMER_CONN_INACTIVITY);
+		{
+		if ( BifConst::conn_expiry_granularity > 0 && ! conn_timer_mgr )
+			sessions->ScheduleExpiry(this, last_time + timeout);
+		else
+			ADD_TIMER(&Connection::InactivityTimer,
+					last_time + timeout, 0, TIMER_CONN_INACTIVITY);
+		}
 
 	inactivity_timeout = timeout;
 	}
@@ -393,9 +430,14 @@ RecordVal* Connection::BuildConnVal()
 	if ( root_analyzer )
 		root_analyzer->UpdateConnVal(conn_val);
 
-	conn_val->Assign(3, new Val(start_time, TYPE_TIME));	// ###
-	conn_val->Assign(4, new Val(last_time - start_time, TYPE_INTERVAL));
-	conn_val->Assign(6, new StringVal(history.c_str()));
+	// The record stays around between calls, so we only need to touch
+	// what has changed since.
+	conn_val->AssignDouble(3, start_time, TYPE_TIME);
+	conn_val->AssignDouble(4, last_time - start_time, TYPE_INTERVAL);
+	if ( history_overflow )
+		conn_val->AssignString(6, History());
+	else
+		conn_val->AssignString(6, history, history_len);
 
 	conn_val->SetOrigin(this);
 
@@ -604,6 +646,7 @@ unsigned int Connection::MemoryAllocation() const
 		+ (timers.MemoryAllocation() - padded_sizeof(timers))
 		+ (conn_val ? conn_val->MemoryAllocation() : 0)
 		+ (root_analyzer ? root_analyzer->MemoryAllocation(): 0)
+		+ (history_overflow ? padded_sizeof(*history_overflow) + pad_size(history_overflow->capacity()) : 0)
 		// login_conn is just a casted 'this'.
 		// primary_PIA is already contained in the analyzer tree.
 		;
@@ -710,8 +753,8 @@ void Connection::CheckFlowLabel(bool is_orig, uint32 flow_label)
 		saw_first_resp_packet = 1;
 	}
 
-bool Connection::PermitWeird(const char* name, uint64 threshold, uint64 rate,
+bool Connection::PermitWeird(uint32 weird_id, uint64 threshold, uint64 rate,
                              double duration)
 	{
-	return ::PermitWeird(weird_state, name, threshold, rate, duration);
+	return ::PermitWeird(weird_state, weird_id, threshold, rate, duration);
 	}
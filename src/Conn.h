@@ -19,6 +19,8 @@
 
 #include "analyzer/Tag.h"
 #include "analyzer/Analyzer.h"
+#include "ObjPool.h"
+#include "ObjCounter.h"
 
 class Connection;
 class ConnectionTimer;
@@ -55,12 +57,16 @@ static inline int addr_port_canon_lt(const IPAddr& addr1, uint32 p1,
 
 namespace analyzer { class Analyzer; }
 
-class Connection : public BroObj {
+class Connection : public BroObj, CountedObj<Connection> {
 public:
+	DECLARE_OBJ_COUNTER()
+
 	Connection(NetSessions* s, HashKey* k, double t, const ConnID* id,
 	           uint32 flow, const Packet* pkt, const EncapsulationStack* arg_encap);
 	~Connection() override;
 
+	DECLARE_POOLED_ALLOC()
+
 	// Invoked when an encapsulation is discovered. It records the
 	// encapsulation with the connection and raises a "tunnel_changed"
 	// event if it's different from the previous encapsulation (or the
@@ -259,7 +265,29 @@ public:
 	void HistoryThresholdEvent(EventHandlerPtr e, bool is_orig,
 	                           uint32 threshold);
 
-	void AddHistory(char code)	{ history += code; }
+	void AddHistory(char code)
+		{
+		if ( history_len < HISTORY_INLINE_LEN )
+			history[history_len++] = code;
+		else
+			AddHistoryOverflow(code);
+		}
+
+	// Returns the history codes in the order they were added.
+	string History() const;
+
+	// Returns the mask of the history codes CheckHistory() has seen.
+	uint32 HistorySeen() const	{ return hist_seen; }
+
+	// Carries over the history of a connection from an earlier
+	// process, as returned by History() and HistorySeen() there.
+	void RestoreHistory(const string& h, uint32 seen)
+		{
+		for ( auto code : h )
+			AddHistory(code);
+
+		hist_seen = seen;
+		}
 
 	void DeleteTimer(double t);
 
@@ -283,7 +311,7 @@ public:
 	uint32 GetOrigFlowLabel() { return orig_flow_label; }
 	uint32 GetRespFlowLabel() { return resp_flow_label; }
 
-	bool PermitWeird(const char* name, uint64 threshold, uint64 rate,
+	bool PermitWeird(uint32 weird_id, uint64 threshold, uint64 rate,
 	                 double duration);
 
 protected:
@@ -301,6 +329,9 @@ protected:
 	// Allow other classes to access pointers to these:
 	friend class ConnectionTimer;
 
+	// Maintains the activity list below.
+	friend class NetSessions;
+
 	void InactivityTimer(double t);
 	void StatusUpdateTimer(double t);
 	void RemoveConnectionTimer(double t);
@@ -342,14 +373,32 @@ protected:
 	static uint64 current_connections;
 	static uint64 external_connections;
 
-	string history;
+	void AddHistoryOverflow(char code);
+
+	// The history's first codes are stored inline, which covers nearly
+	// all connections. Any further ones go into history_overflow.
+	enum { HISTORY_INLINE_LEN = 11 };
+	char history[HISTORY_INLINE_LEN];
+	uint8 history_len;
 	uint32 hist_seen;
+	string* history_overflow;
 
 	analyzer::TransportLayerAnalyzer* root_analyzer;
 	analyzer::pia::PIA* primary_PIA;
 
 	Bro::UID uid;	// Globally unique connection ID.
-	WeirdStateMap weird_state;
+	WeirdStateVector weird_state;
+
+	// Neighbors in NetSessions' list of connections ordered by most
+	// recent activity.
+	Connection* lru_prev;
+	Connection* lru_next;
+
+	// Slot of NetSessions' expiry wheel we're in, or -1, and our
+	// neighbors there.
+	int expiry_slot;
+	Connection* expiry_prev;
+	Connection* expiry_next;
 };
 
 class ConnectionTimer : public Timer {
@@ -360,6 +409,8 @@ public:
 		{ Init(arg_conn, arg_timer, arg_do_expire); }
 	~ConnectionTimer() override;
 
+	DECLARE_POOLED_ALLOC()
+
 	void Dispatch(double t, int is_expire) override;
 
 protected:
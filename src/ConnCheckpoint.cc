@@ -0,0 +1,334 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <caf/stream_serializer.hpp>
+#include <caf/stream_deserializer.hpp>
+#include <caf/streambuf.hpp>
+
+#include "ConnCheckpoint.h"
+#include "ConnTable.h"
+#include "Reporter.h"
+#include "analyzer/Manager.h"
+#include "analyzer/protocol/conn-size/ConnSize.h"
+#include "broker/Data.h"
+
+// A checkpoint starts with this, followed by one entry per connection: its
+// size as a 32-bit number in network byte order and the serialized vector
+// of the connection's state.
+static const char CHECKPOINT_MAGIC[8] = { 'Z', 'E', 'E', 'K', 'C', 'O', 'N', '1' };
+
+enum {
+	FIELD_PROTO, FIELD_KEY, FIELD_ORIG_ADDR, FIELD_ORIG_PORT,
+	FIELD_RESP_ADDR, FIELD_RESP_PORT, FIELD_UID, FIELD_START_TIME,
+	FIELD_LAST_TIME, FIELD_HISTORY, FIELD_HIST_SEEN, FIELD_ORIG_PKTS,
+	FIELD_ORIG_BYTES, FIELD_RESP_PKTS, FIELD_RESP_BYTES, FIELD_ANALYZERS,
+	FIELD_SERVICES, NUM_FIELDS
+};
+
+static std::string addr_to_bytes(const IPAddr& a)
+	{
+	in6_addr in6;
+	a.CopyIPv6(&in6);
+	return std::string(reinterpret_cast<const char*>(&in6), sizeof(in6));
+	}
+
+static bool bytes_to_addr(const std::string* s, IPAddr* a)
+	{
+	in6_addr in6;
+
+	if ( ! s || s->size() != sizeof(in6) )
+		return false;
+
+	memcpy(&in6, s->data(), sizeof(in6));
+	*a = IPAddr(in6);
+	return true;
+	}
+
+static broker::vector build_entry(Connection* c)
+	{
+	ConnIDKey key;
+	ConnTable::KeyFromHashKey(c->Key(), &key);
+
+	// Building the record assigns the UID if no event has needed it
+	// so far.
+	RecordVal* conn_val = c->BuildConnVal();
+	Bro::UID uid = c->GetUID();
+	const uint64* uid_values = uid.Values();
+	broker::vector uid_vals;
+
+	for ( int i = 0; i < BRO_UID_LEN; ++i )
+		uid_vals.emplace_back(uid_values[i]);
+
+	uint64 orig_pkts = 0, orig_bytes = 0, resp_pkts = 0, resp_bytes = 0;
+	auto cs = static_cast<analyzer::conn_size::ConnSize_Analyzer*>(c->FindAnalyzer("CONNSIZE"));
+
+	if ( cs )
+		cs->GetCounts(&orig_pkts, &orig_bytes, &resp_pkts, &resp_bytes);
+
+	// Analyzers that DPD attached need to be reattached.
+	broker::vector analyzers;
+
+	for ( auto a : c->GetRootAnalyzer()->GetChildren() )
+		{
+		if ( a->ProtocolConfirmed() )
+			analyzers.emplace_back(analyzer_mgr->GetComponentName(a->GetAnalyzerTag()));
+		}
+
+	broker::vector services;
+	ListVal* lv = conn_val->Lookup(5)->AsTableVal()->ConvertToPureList();
+
+	for ( int i = 0; i < lv->Length(); ++i )
+		services.emplace_back(std::string(lv->Index(i)->AsString()->CheckString()));
+
+	Unref(lv);
+	Unref(conn_val);
+
+	broker::vector v(NUM_FIELDS);
+	v[FIELD_PROTO] = static_cast<uint64>(c->ConnTransport());
+	v[FIELD_KEY] = std::string(reinterpret_cast<const char*>(&key), sizeof(key));
+	v[FIELD_ORIG_ADDR] = addr_to_bytes(c->OrigAddr());
+	v[FIELD_ORIG_PORT] = static_cast<uint64>(c->OrigPort());
+	v[FIELD_RESP_ADDR] = addr_to_bytes(c->RespAddr());
+	v[FIELD_RESP_PORT] = static_cast<uint64>(c->RespPort());
+	v[FIELD_UID] = std::move(uid_vals);
+	v[FIELD_START_TIME] = c->StartTime();
+	v[FIELD_LAST_TIME] = c->LastTime();
+	v[FIELD_HISTORY] = c->History();
+	v[FIELD_HIST_SEEN] = static_cast<uint64>(c->HistorySeen());
+	v[FIELD_ORIG_PKTS] = orig_pkts;
+	v[FIELD_ORIG_BYTES] = orig_bytes;
+	v[FIELD_RESP_PKTS] = resp_pkts;
+	v[FIELD_RESP_BYTES] = resp_bytes;
+	v[FIELD_ANALYZERS] = std::move(analyzers);
+	v[FIELD_SERVICES] = std::move(services);
+
+	return v;
+	}
+
+static bool get_strings(const broker::data& d, std::vector<std::string>* strings)
+	{
+	auto v = caf::get_if<broker::vector>(&d);
+
+	if ( ! v )
+		return false;
+
+	for ( const auto& x : *v )
+		{
+		auto s = caf::get_if<std::string>(&x);
+
+		if ( ! s )
+			return false;
+
+		strings->push_back(*s);
+		}
+
+	return true;
+	}
+
+static bool parse_entry(const broker::data& d, ConnCheckpoint::Entry* e)
+	{
+	auto v = caf::get_if<broker::vector>(&d);
+
+	if ( ! (v && v->size() == NUM_FIELDS) )
+		return false;
+
+	const broker::vector& f = *v;
+
+	auto proto = caf::get_if<uint64>(&f[FIELD_PROTO]);
+	auto key = caf::get_if<std::string>(&f[FIELD_KEY]);
+	auto orig_port = caf::get_if<uint64>(&f[FIELD_ORIG_PORT]);
+	auto resp_port = caf::get_if<uint64>(&f[FIELD_RESP_PORT]);
+	auto uid = caf::get_if<broker::vector>(&f[FIELD_UID]);
+	auto start_time = caf::get_if<double>(&f[FIELD_START_TIME]);
+	auto last_time = caf::get_if<double>(&f[FIELD_LAST_TIME]);
+	auto history = caf::get_if<std::string>(&f[FIELD_HISTORY]);
+	auto hist_seen = caf::get_if<uint64>(&f[FIELD_HIST_SEEN]);
+	auto orig_pkts = caf::get_if<uint64>(&f[FIELD_ORIG_PKTS]);
+	auto orig_bytes = caf::get_if<uint64>(&f[FIELD_ORIG_BYTES]);
+	auto resp_pkts = caf::get_if<uint64>(&f[FIELD_RESP_PKTS]);
+	auto resp_bytes = caf::get_if<uint64>(&f[FIELD_RESP_BYTES]);
+
+	if ( ! (proto && key && orig_port && resp_port && uid && start_time &&
+		last_time && history && hist_seen && orig_pkts && orig_bytes &&
+		resp_pkts && resp_bytes) )
+		return false;
+
+	if ( key->size() != sizeof(e->key) || uid->size() != BRO_UID_LEN )
+		return false;
+
+	if ( ! (bytes_to_addr(caf::get_if<std::string>(&f[FIELD_ORIG_ADDR]), &e->id.src_addr) &&
+		bytes_to_addr(caf::get_if<std::string>(&f[FIELD_RESP_ADDR]), &e->id.dst_addr)) )
+		return false;
+
+	for ( int i = 0; i < BRO_UID_LEN; ++i )
+		{
+		auto x = caf::get_if<uint64>(&(*uid)[i]);
+
+		if ( ! x )
+			return false;
+
+		e->uid[i] = *x;
+		}
+
+	if ( ! (get_strings(f[FIELD_ANALYZERS], &e->analyzers) &&
+		get_strings(f[FIELD_SERVICES], &e->services)) )
+		return false;
+
+	e->proto = static_cast<TransportProto>(*proto);
+	memcpy(&e->key, key->data(), sizeof(e->key));
+	e->id.src_port = *orig_port;
+	e->id.dst_port = *resp_port;
+	e->id.is_one_way = false;
+	e->start_time = *start_time;
+	e->last_time = *last_time;
+	e->history = *history;
+	e->hist_seen = *hist_seen;
+	e->orig_pkts = *orig_pkts;
+	e->orig_bytes = *orig_bytes;
+	e->resp_pkts = *resp_pkts;
+	e->resp_bytes = *resp_bytes;
+
+	return true;
+	}
+
+bool ConnCheckpoint::Write(const char* path, const std::vector<Connection*>& conns)
+	{
+	FILE* file = fopen(path, "w");
+
+	if ( ! file )
+		{
+		reporter->Error("cannot open connection checkpoint %s: %s", path, strerror(errno));
+		return false;
+		}
+
+	bool ok = fwrite(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC), 1, file) == 1;
+	std::vector<char> buf;
+
+	for ( auto c : conns )
+		{
+		if ( ! ok )
+			break;
+
+		buf.assign(sizeof(uint32), 0);
+		caf::vectorbuf sb{buf};
+		caf::stream_serializer<caf::vectorbuf&> sink{sb};
+		broker::data entry{build_entry(c)};
+
+		if ( auto err = sink(entry) )
+			{
+			reporter->Error("cannot serialize connection %s for checkpoint",
+					c->GetUID().Base62("C").c_str());
+			fclose(file);
+			return false;
+			}
+
+		uint32 len = htonl(buf.size() - sizeof(uint32));
+		memcpy(buf.data(), &len, sizeof(len));
+
+		ok = fwrite(buf.data(), 1, buf.size(), file) == buf.size();
+		}
+
+	if ( fclose(file) != 0 )
+		ok = false;
+
+	if ( ! ok )
+		{
+		reporter->Error("cannot write connection checkpoint %s: %s", path, strerror(errno));
+		return false;
+		}
+
+	return true;
+	}
+
+bool ConnCheckpoint::Read(const char* path, std::vector<Entry>* entries)
+	{
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+
+	if ( fd < 0 || fstat(fd, &st) < 0 )
+		{
+		reporter->Error("cannot open connection checkpoint %s: %s", path, strerror(errno));
+
+		if ( fd >= 0 )
+			close(fd);
+
+		return false;
+		}
+
+	size_t size = st.st_size;
+
+	if ( size < sizeof(CHECKPOINT_MAGIC) )
+		{
+		reporter->Error("%s is not a connection checkpoint", path);
+		close(fd);
+		return false;
+		}
+
+	void* m = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if ( m == MAP_FAILED )
+		{
+		reporter->Error("cannot map connection checkpoint %s: %s", path, strerror(errno));
+		return false;
+		}
+
+	const char* data = static_cast<const char*>(m);
+	bool ok = memcmp(data, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) == 0;
+	size_t offset = sizeof(CHECKPOINT_MAGIC);
+
+	while ( ok && offset < size )
+		{
+		uint32 len;
+
+		if ( size - offset < sizeof(len) )
+			{
+			ok = false;
+			break;
+			}
+
+		memcpy(&len, data + offset, sizeof(len));
+		len = ntohl(len);
+		offset += sizeof(len);
+
+		if ( size - offset < len )
+			{
+			ok = false;
+			break;
+			}
+
+		caf::arraybuf<char> ab{const_cast<char*>(data) + offset, len};
+		caf::stream_deserializer<caf::arraybuf<char>&> source{ab};
+		broker::data d;
+		offset += len;
+
+		Entry e;
+
+		if ( source(d) || ! parse_entry(d, &e) )
+			{
+			ok = false;
+			break;
+			}
+
+		entries->push_back(std::move(e));
+		}
+
+	munmap(m, size);
+
+	if ( ! ok )
+		{
+		reporter->Error("cannot decode connection checkpoint %s", path);
+		return false;
+		}
+
+	return true;
+	}
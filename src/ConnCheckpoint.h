@@ -0,0 +1,57 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef conncheckpoint_h
+#define conncheckpoint_h
+
+// Carrying connection state over from one Zeek process to the next, such as
+// when restarting a worker to deploy script changes. With
+// conn_checkpoint_file set, the connections still active at termination get
+// written to that file rather than finished. With conn_restore_file set, a
+// new process reads them back and recreates them once it sees its first
+// packet, so that their logs come out as if there had been no restart and
+// DPD doesn't need to find their protocols again.
+//
+// What carries over is a connection's identity (endpoints, UID, start
+// time), its activity so far (last time, history, packet and byte counts),
+// the application analyzers that had confirmed their protocol, and the
+// services the scripts recorded. Transport-layer state such as TCP sequence
+// numbers doesn't, so TCP analysis picks up as it does for a connection
+// already in progress. Timers start over, relative to the last activity.
+
+#include <string>
+#include <vector>
+
+#include "Conn.h"
+#include "IPAddr.h"
+#include "UID.h"
+
+class ConnCheckpoint {
+public:
+	// The state of a connection that carries over.
+	struct Entry {
+		TransportProto proto;
+		ConnIDKey key;
+		ConnID id;
+		uint64 uid[BRO_UID_LEN];
+		double start_time;
+		double last_time;
+		std::string history;
+		uint32 hist_seen;
+		uint64 orig_pkts;
+		uint64 orig_bytes;
+		uint64 resp_pkts;
+		uint64 resp_bytes;
+		std::vector<std::string> analyzers;
+		std::vector<std::string> services;
+	};
+
+	// Writes the state of the given connections to a file. Reports an
+	// error and returns false if that fails.
+	static bool Write(const char* path, const std::vector<Connection*>& conns);
+
+	// Reads the state written by Write() from a file. Reports an error
+	// and returns false if that fails.
+	static bool Read(const char* path, std::vector<Entry>* entries);
+};
+
+#endif
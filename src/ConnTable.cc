@@ -0,0 +1,141 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "ConnTable.h"
+#include "Conn.h"
+
+// Number of slots a table starts out with.
+static const size_t INITIAL_CAPACITY = 1024;
+
+ConnTable::ConnTable()
+	{
+	capacity = INITIAL_CAPACITY;
+	mask = capacity - 1;
+	entries = new Entry[capacity];
+	memset(entries, 0, capacity * sizeof(Entry));
+	num_entries = max_entries = 0;
+	cumulative_inserts = 0;
+	}
+
+ConnTable::~ConnTable()
+	{
+	for ( size_t i = 0; i < capacity; i++ )
+		Unref(entries[i].conn);
+
+	delete [] entries;
+	}
+
+bool ConnTable::KeyFromHashKey(const HashKey* hk, ConnIDKey* key)
+	{
+	if ( ! hk || hk->Size() != sizeof(*key) )
+		return false;
+
+	memcpy(key, hk->Key(), sizeof(*key));
+	return true;
+	}
+
+Connection* ConnTable::Lookup(const ConnIDKey& key, hash_t hash) const
+	{
+	return entries[Find(key, hash)].conn;
+	}
+
+Connection* ConnTable::Insert(const ConnIDKey& key, Connection* c)
+	{
+	uint32 hash = Hash(key);
+	size_t i = Find(key, hash);
+
+	++cumulative_inserts;
+
+	if ( entries[i].conn )
+		{
+		Connection* old = entries[i].conn;
+		entries[i].conn = c;
+		return old;
+		}
+
+	entries[i].key = key;
+	entries[i].hash = hash;
+	entries[i].conn = c;
+
+	if ( ++num_entries > max_entries )
+		max_entries = num_entries;
+
+	// Keep the load factor at or below 3/4, beyond which probe
+	// sequences get long.
+	if ( size_t(num_entries) * 4 > capacity * 3 )
+		Resize(capacity * 2);
+
+	return 0;
+	}
+
+Connection* ConnTable::Remove(const ConnIDKey& key)
+	{
+	size_t i = Find(key, Hash(key));
+	Connection* c = entries[i].conn;
+
+	if ( ! c )
+		return 0;
+
+	// Move later entries of the probe sequence back into the gap, as
+	// long as that doesn't put them before their home slot.
+	size_t j = i;
+
+	while ( true )
+		{
+		j = (j + 1) & mask;
+
+		if ( ! entries[j].conn )
+			break;
+
+		size_t home = entries[j].hash & mask;
+
+		if ( ((j - home) & mask) >= ((j - i) & mask) )
+			{
+			entries[i] = entries[j];
+			i = j;
+			}
+		}
+
+	entries[i].conn = 0;
+	--num_entries;
+
+	return c;
+	}
+
+unsigned int ConnTable::MemoryAllocation() const
+	{
+	return padded_sizeof(*this) + pad_size(capacity * sizeof(Entry));
+	}
+
+Connection* ConnTable::NextEntry(size_t* pos) const
+	{
+	while ( *pos < capacity )
+		{
+		Connection* c = entries[(*pos)++].conn;
+
+		if ( c )
+			return c;
+		}
+
+	return 0;
+	}
+
+void ConnTable::Resize(size_t new_capacity)
+	{
+	Entry* old_entries = entries;
+	size_t old_capacity = capacity;
+
+	capacity = new_capacity;
+	mask = capacity - 1;
+	entries = new Entry[capacity];
+	memset(entries, 0, capacity * sizeof(Entry));
+
+	for ( size_t i = 0; i < old_capacity; i++ )
+		{
+		if ( old_entries[i].conn )
+			entries[Find(old_entries[i].key, old_entries[i].hash)] = old_entries[i];
+		}
+
+	delete [] old_entries;
+	}
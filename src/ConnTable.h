@@ -0,0 +1,105 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef conntable_h
+#define conntable_h
+
+#include "Hash.h"
+#include "IPAddr.h"
+
+class Connection;
+
+// A hash table mapping ConnIDKeys to connections, using open addressing
+// with linear probing. Keys are stored inline with the entries, so that a
+// lookup normally touches a single cache line of the table and doesn't
+// need to allocate anything. Deleted entries are removed by shifting
+// later entries of the same probe sequence back, so the table never
+// accumulates tombstones.
+//
+// The table holds a reference to each connection it stores.
+class ConnTable {
+public:
+	ConnTable();
+	~ConnTable();
+
+	// Returns the hash of a key, which is the same as that of a
+	// HashKey built over it.
+	static hash_t Hash(const ConnIDKey& key)
+		{ return HashKey::HashBytes(&key, sizeof(key)); }
+
+	// Extracts the key from a HashKey built by BuildConnIDHashKey().
+	// Returns false if it's not such a key.
+	static bool KeyFromHashKey(const HashKey* hk, ConnIDKey* key);
+
+	// Returns the connection for the given key, or nil if none.
+	Connection* Lookup(const ConnIDKey& key, hash_t hash) const;
+	Connection* Lookup(const ConnIDKey& key) const
+		{ return Lookup(key, Hash(key)); }
+
+	// Hints to the CPU that the slot where a lookup of the given hash
+	// starts probing will be needed soon.
+	void PrefetchSlot(hash_t hash) const
+		{ __builtin_prefetch(&entries[uint32(hash) & mask]); }
+
+	// Hints to the CPU that the connection stored under the given key,
+	// if any, will be needed soon. This probes the table, so it's best
+	// called once PrefetchSlot() had a chance to take effect.
+	void PrefetchConn(const ConnIDKey& key, hash_t hash) const
+		{
+		Connection* c = entries[Find(key, hash)].conn;
+
+		if ( c )
+			__builtin_prefetch(c);
+		}
+
+	// Stores a connection, taking over the caller's reference. Returns
+	// the connection previously stored under the key, if any, which
+	// the caller then owns.
+	Connection* Insert(const ConnIDKey& key, Connection* c);
+
+	// Removes the entry for the given key and returns its connection,
+	// which the caller then owns. Returns nil if there's no entry.
+	Connection* Remove(const ConnIDKey& key);
+
+	int Length() const		{ return num_entries; }
+	int MaxLength() const		{ return max_entries; }
+	uint64 NumCumulativeInserts() const	{ return cumulative_inserts; }
+
+	unsigned int MemoryAllocation() const;
+
+	// Iterates over all connections. Start with *pos* set to zero;
+	// returns nil once done. The table must not be modified while an
+	// iteration is in progress.
+	Connection* NextEntry(size_t* pos) const;
+
+private:
+	struct Entry {
+		ConnIDKey key;
+		uint32 hash;
+		Connection* conn;	// Nil for empty slots.
+	};
+
+	// Returns the slot holding the key, or if it's not there, the empty
+	// slot where it would go.
+	size_t Find(const ConnIDKey& key, uint32 hash) const
+		{
+		size_t i = hash & mask;
+
+		while ( entries[i].conn &&
+			(entries[i].hash != hash ||
+			 memcmp(&entries[i].key, &key, sizeof(key)) != 0) )
+			i = (i + 1) & mask;
+
+		return i;
+		}
+
+	void Resize(size_t new_capacity);
+
+	Entry* entries;
+	size_t capacity;	// Always a power of two.
+	size_t mask;
+	int num_entries;
+	int max_entries;
+	uint64 cumulative_inserts;
+};
+
+#endif
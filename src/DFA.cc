@@ -2,6 +2,10 @@
 
 #include "zeek-config.h"
 
+#include <string.h>
+
+#include <unordered_map>
+
 #include "EquivClass.h"
 #include "DFA.h"
 #include "digest.h"
@@ -18,6 +22,7 @@ DFA_State::DFA_State(int arg_state_num, const EquivClass* ec,
 	accept = arg_accept;
 	mark = 0;
 	centry = 0;
+	dense_idx = -1;
 
 	SymPartition(ec);
 
@@ -75,6 +80,8 @@ void DFA_State::SymPartition(const EquivClass* ec)
 
 DFA_State* DFA_State::ComputeXtion(int sym, DFA_Machine* machine)
 	{
+	++machine->computed_xtions;
+
 	int equiv_sym = meta_ec->EquivRep(sym);
 	if ( xtions[equiv_sym] != DFA_UNCOMPUTED_STATE_PTR )
 		{
@@ -398,6 +405,9 @@ DFA_Machine::DFA_Machine(NFA_Machine* n, EquivClass* arg_ec)
 	Ref(n);
 
 	ec = arg_ec;
+	num_sym = ec->NumClasses();
+
+	cold_xtions = computed_xtions = compacted_xtions = 0;
 
 	dfa_state_cache = new DFA_State_Cache();
 
@@ -442,7 +452,294 @@ unsigned int DFA_Machine::MemoryAllocation() const
 	return padded_sizeof(*this)
 		+ s.mem
 		+ padded_sizeof(*start_state)
-		+ nfa->MemoryAllocation();
+		+ nfa->MemoryAllocation()
+		+ pad_size(dense_xtions.capacity() * sizeof(int))
+		+ pad_size(dense_states.capacity() * sizeof(DFA_State*))
+		+ pad_size(dense_accept.capacity() * sizeof(AcceptingSet*))
+		+ pad_size(dense_exits.capacity() * sizeof(Exits));
+	}
+
+void DFA_Machine::Compact()
+	{
+	cold_xtions = 0;
+
+	if ( computed_xtions == compacted_xtions || ! start_state )
+		// Nothing new to put in.
+		return;
+
+	compacted_xtions = computed_xtions;
+
+	for ( const auto& s : dense_states )
+		s->dense_idx = -1;
+
+	dense_states.clear();
+
+	start_state->dense_idx = 0;
+	dense_states.push_back(start_state);
+
+	for ( size_t i = 0; i < dense_states.size() &&
+	      dense_states.size() < DFA_MAX_DENSE_STATES; ++i )
+		{
+		DFA_State* s = dense_states[i];
+
+		for ( int sym = 0; sym < num_sym; ++sym )
+			{
+			DFA_State* next = s->xtions[sym];
+
+			if ( next == DFA_UNCOMPUTED_STATE_PTR || ! next ||
+			     next->dense_idx >= 0 )
+				continue;
+
+			next->dense_idx = dense_states.size();
+			dense_states.push_back(next);
+
+			if ( dense_states.size() >= DFA_MAX_DENSE_STATES )
+				break;
+			}
+		}
+
+	dense_xtions.resize(dense_states.size() * num_sym);
+	dense_accept.resize(dense_states.size());
+
+	int* x = &dense_xtions[0];
+
+	for ( size_t i = 0; i < dense_states.size(); ++i )
+		{
+		DFA_State* s = dense_states[i];
+		dense_accept[i] = s->Accept();
+
+		for ( int sym = 0; sym < num_sym; ++sym )
+			{
+			DFA_State* next = s->xtions[sym];
+
+			if ( next == DFA_UNCOMPUTED_STATE_PTR )
+				*x++ = DFA_DENSE_COLD;
+			else if ( ! next )
+				*x++ = DFA_DENSE_JAM;
+			else if ( next->dense_idx >= 0 )
+				*x++ = next->dense_idx;
+			else
+				*x++ = DFA_DENSE_COLD;
+			}
+		}
+
+	dense_exits.resize(dense_states.size());
+
+	for ( size_t i = 0; i < dense_states.size(); ++i )
+		{
+		Exits* ex = &dense_exits[i];
+		ex->n = -1;
+
+		if ( dense_accept[i] )
+			// We'd have to record a match for each byte.
+			continue;
+
+		const int* row = &dense_xtions[i * num_sym];
+		int n = 0;
+
+		for ( int b = 0; b < 256; ++b )
+			{
+			if ( row[ec->SymEquivClass(b)] == int(i) )
+				continue;
+
+			if ( n == DFA_MAX_EXIT_BYTES )
+				{
+				n = -1;
+				break;
+				}
+
+			ex->bytes[n++] = b;
+			}
+
+		ex->n = n;
+		}
+	}
+
+void DFA_Machine::NumberNFAStates(std::vector<NFA_State*>* states) const
+	{
+	std::unordered_map<NFA_State*, int> seen;
+
+	states->push_back(nfa->FirstState());
+	seen[nfa->FirstState()] = 0;
+
+	for ( size_t i = 0; i < states->size(); ++i )
+		{
+		for ( const auto& next : *(*states)[i]->Transitions() )
+			{
+			if ( seen.find(next) != seen.end() )
+				continue;
+
+			seen[next] = states->size();
+			states->push_back(next);
+			}
+		}
+	}
+
+void DFA_Machine::ComputedStates(std::vector<DFA_State*>* states) const
+	{
+	std::unordered_map<DFA_State*, int> seen;
+
+	states->push_back(start_state);
+	seen[start_state] = 0;
+
+	for ( size_t i = 0; i < states->size(); ++i )
+		{
+		DFA_State* s = (*states)[i];
+
+		for ( int sym = 0; sym < num_sym; ++sym )
+			{
+			DFA_State* next = s->xtions[sym];
+
+			if ( next == DFA_UNCOMPUTED_STATE_PTR || ! next ||
+			     seen.find(next) != seen.end() )
+				continue;
+
+			seen[next] = states->size();
+			states->push_back(next);
+			}
+		}
+	}
+
+// The layout written by Save() is a sequence of 32-bit values in host byte
+// order: the number of NFA states, the number of symbols, the number of
+// DFA states; then for each DFA state, the number of NFA states it consists
+// of followed by their numbers; and then for each DFA state, the index of
+// the state each symbol leads to, or one of -1 (jam) and -2 (uncomputed).
+
+static void append_uint32(std::string* buf, uint32 v)
+	{
+	buf->append(reinterpret_cast<const char*>(&v), sizeof(v));
+	}
+
+void DFA_Machine::Save(std::string* buf) const
+	{
+	if ( ! start_state )
+		return;
+
+	std::vector<NFA_State*> nfa_states;
+	NumberNFAStates(&nfa_states);
+
+	std::unordered_map<NFA_State*, int> nfa_idx;
+
+	for ( size_t i = 0; i < nfa_states.size(); ++i )
+		nfa_idx[nfa_states[i]] = i;
+
+	std::vector<DFA_State*> states;
+	ComputedStates(&states);
+
+	std::unordered_map<DFA_State*, int> state_idx;
+
+	for ( size_t i = 0; i < states.size(); ++i )
+		state_idx[states[i]] = i;
+
+	append_uint32(buf, nfa_states.size());
+	append_uint32(buf, num_sym);
+	append_uint32(buf, states.size());
+
+	for ( const auto& s : states )
+		{
+		append_uint32(buf, s->nfa_states->length());
+
+		for ( const auto& n : *s->nfa_states )
+			append_uint32(buf, nfa_idx[n]);
+		}
+
+	for ( const auto& s : states )
+		{
+		for ( int sym = 0; sym < num_sym; ++sym )
+			{
+			DFA_State* next = s->xtions[sym];
+
+			if ( next == DFA_UNCOMPUTED_STATE_PTR )
+				append_uint32(buf, uint32(-2));
+			else if ( ! next )
+				append_uint32(buf, uint32(-1));
+			else
+				append_uint32(buf, state_idx[next]);
+			}
+		}
+	}
+
+bool DFA_Machine::Load(const u_char* data, size_t len)
+	{
+	if ( ! start_state || len % sizeof(uint32) )
+		return false;
+
+	const uint32* p = reinterpret_cast<const uint32*>(data);
+	const uint32* end = p + len / sizeof(uint32);
+
+	if ( end - p < 3 )
+		return false;
+
+	std::vector<NFA_State*> nfa_states;
+	NumberNFAStates(&nfa_states);
+
+	uint32 num_nfa = *p++;
+	uint32 saved_num_sym = *p++;
+	uint32 num_states = *p++;
+
+	if ( num_nfa != nfa_states.size() || saved_num_sym != uint32(num_sym) ||
+	     num_states == 0 )
+		return false;
+
+	// Check it all first so that we don't end up with half of it.
+	const uint32* q = p;
+
+	for ( uint32 i = 0; i < num_states; ++i )
+		{
+		if ( q >= end )
+			return false;
+
+		uint32 n = *q++;
+
+		if ( uint32(end - q) < n )
+			return false;
+
+		for ( uint32 j = 0; j < n; ++j )
+			if ( *q++ >= num_nfa )
+				return false;
+		}
+
+	if ( uint32(end - q) != num_states * num_sym )
+		return false;
+
+	for ( const uint32* x = q; x < end; ++x )
+		if ( *x >= num_states && *x != uint32(-1) && *x != uint32(-2) )
+			return false;
+
+	std::vector<DFA_State*> states;
+
+	for ( uint32 i = 0; i < num_states; ++i )
+		{
+		uint32 n = *p++;
+		NFA_state_list* state_set = new NFA_state_list(n);
+
+		for ( uint32 j = 0; j < n; ++j )
+			state_set->push_back(nfa_states[*p++]);
+
+		DFA_State* d;
+
+		if ( ! StateSetToDFA_State(state_set, d, ec) )
+			delete state_set;
+
+		states.push_back(d);
+		}
+
+	for ( const auto& s : states )
+		{
+		for ( int sym = 0; sym < num_sym; ++sym )
+			{
+			uint32 x = *p++;
+
+			if ( x == uint32(-2) || s->xtions[sym] != DFA_UNCOMPUTED_STATE_PTR )
+				continue;
+
+			s->AddXtion(sym, x == uint32(-1) ? 0 : states[x]);
+			++computed_xtions;
+			}
+		}
+
+	return true;
 	}
 
 int DFA_Machine::StateSetToDFA_State(NFA_state_list* state_set,
@@ -6,6 +6,9 @@
 
 #include <assert.h>
 
+#include <string>
+#include <vector>
+
 class DFA_State;
 
 // Transitions to the uncomputed state indicate that we haven't yet
@@ -13,6 +16,21 @@ class DFA_State;
 #define DFA_UNCOMPUTED_STATE -2
 #define DFA_UNCOMPUTED_STATE_PTR ((DFA_State*) DFA_UNCOMPUTED_STATE)
 
+// Entries of the dense transition table (see DFA_Machine::Compact()) that
+// don't lead to another state in the table: either the machine jams, or we
+// need to go through the DFA_State to find out.
+#define DFA_DENSE_JAM -1
+#define DFA_DENSE_COLD -2
+
+// Number of transitions taken outside of the dense table after which we
+// rebuild it, and the maximum number of states it covers.
+#define DFA_COMPACT_THRESHOLD 4096
+#define DFA_MAX_DENSE_STATES 4096
+
+// Maximum number of bytes leaving a state for which we search for those
+// bytes rather than walking the table (see DFA_Machine::DenseExits()).
+#define DFA_MAX_EXIT_BYTES 3
+
 #include "NFA.h"
 
 class DFA_Machine;
@@ -32,6 +50,11 @@ public:
 	inline DFA_State* Xtion(int sym, DFA_Machine* machine);
 
 	const AcceptingSet* Accept() const	{ return accept; }
+
+	// Index into the machine's dense transition table, or -1 if the
+	// state isn't part of it.
+	int DenseIndex() const	{ return dense_idx; }
+
 	void SymPartition(const EquivClass* ec);
 
 	// ec_sym is an equivalence class, not a character.
@@ -51,6 +74,7 @@ public:
 
 protected:
 	friend class DFA_State_Cache;
+	friend class DFA_Machine;	// for DFA_Machine::Compact
 
 	DFA_State* ComputeXtion(int sym, DFA_Machine* machine);
 	void AppendIfNew(int sym, int_list* sym_list);
@@ -65,6 +89,7 @@ protected:
 	EquivClass* meta_ec;	// which ec's make same transition
 	DFA_State* mark;
 	CacheEntry* centry;
+	int dense_idx;
 
 	static unsigned int transition_counter;	// see Xtion()
 };
@@ -122,16 +147,91 @@ public:
 
 	int Rep(int sym);
 
+	// The states visited most often also get their transitions put
+	// into a single table of integers, which the matchers can walk
+	// without touching the DFA_States themselves. The table has
+	// NumSyms() entries per state, indexed by equivalence class; each is
+	// the index of the next state, or one of DFA_DENSE_JAM and
+	// DFA_DENSE_COLD. It's null if there's no table yet.
+	const int* DenseXtions() const
+		{ return dense_xtions.empty() ? 0 : &dense_xtions[0]; }
+	int NumSyms() const	{ return num_sym; }
+	int NumDenseStates() const	{ return dense_states.size(); }
+	DFA_State* DenseState(int idx) const	{ return dense_states[idx]; }
+	const AcceptingSet* DenseAccept(int idx) const
+		{ return dense_accept[idx]; }
+
+	// Input bytes that lead out of a non-accepting dense state which
+	// all others lead back to. That's where unanchored patterns sit
+	// while waiting for their first literal to show up, so matchers can
+	// search for those bytes and skip the rest. Returns null if there
+	// are more than DFA_MAX_EXIT_BYTES of them, or some other byte
+	// leads elsewhere.
+	struct Exits {
+		int n;
+		u_char bytes[DFA_MAX_EXIT_BYTES];
+	};
+
+	const Exits* DenseExits(int idx) const
+		{ return dense_exits[idx].n >= 0 ? &dense_exits[idx] : 0; }
+
+	// To be called by matchers for each transition they take outside
+	// of the dense table.
+	void ColdXtion()	{ ++cold_xtions; }
+
+	// Rebuilds the dense table if it has been missing too often. This
+	// invalidates all indices, so matchers may call it only before they
+	// start walking the table.
+	void MaybeCompact()
+		{
+		if ( cold_xtions >= DFA_COMPACT_THRESHOLD )
+			Compact();
+		}
+
 	void Describe(ODesc* d) const override;
 	void Dump(FILE* f);
 
+	// Appends the states computed so far, and their transitions, to the
+	// given buffer.
+	void Save(std::string* buf) const;
+
+	// Restores states saved by a machine built from the same pattern.
+	// Returns false if the data doesn't fit this machine, in which case
+	// nothing has been changed.
+	bool Load(const u_char* data, size_t len);
+
 	unsigned int MemoryAllocation() const;
 
 protected:
 	friend class DFA_State;	// for DFA_State::ComputeXtion
 	friend class DFA_State_Cache;
 
+	// Puts the states reachable from the start state through transitions
+	// already computed into the dense table, breadth-first.
+	void Compact();
+
+	// Returns all NFA states in a fixed order, which is the same for
+	// all machines built from the same pattern.
+	void NumberNFAStates(std::vector<NFA_State*>* states) const;
+
+	// Returns the states reachable through the transitions computed
+	// so far, with the start state first.
+	void ComputedStates(std::vector<DFA_State*>* states) const;
+
 	int state_count;
+	int num_sym;
+
+	std::vector<int> dense_xtions;
+	std::vector<DFA_State*> dense_states;
+	std::vector<const AcceptingSet*> dense_accept;
+	std::vector<Exits> dense_exits;
+
+	// Transitions taken outside of the dense table since we built it.
+	unsigned int cold_xtions;
+
+	// Transitions computed overall, and when we last built the table.
+	unsigned int computed_xtions;
+	unsigned int compacted_xtions;
 
 	// The state list has to be sorted according to IDs.
 	int StateSetToDFA_State(NFA_state_list* state_set, DFA_State*& d,
@@ -33,6 +33,7 @@
 #include "Event.h"
 #include "Net.h"
 #include "Var.h"
+#include "NetVar.h"
 #include "Reporter.h"
 #include "iosource/Manager.h"
 #include "digest.h"
@@ -388,6 +389,8 @@ DNS_Mgr::DNS_Mgr(DNS_MgrMode arg_mode)
 	cache_name = dir = 0;
 
 	asyncs_pending = 0;
+	max_pending = 20;
+	negative_ttl = 0;
 	num_requests = 0;
 	successful = 0;
 	failed = 0;
@@ -457,6 +460,9 @@ void DNS_Mgr::InitPostScript()
 
 	dm_rec = internal_type("dns_mapping")->AsRecordType();
 
+	max_pending = max(int(BifConst::dns_resolver_max_pending), 1);
+	negative_ttl = uint32(BifConst::dns_resolver_negative_ttl);
+
 	// Registering will call Init()
 	iosource_mgr->Register(this, true);
 
@@ -756,7 +762,14 @@ Val* DNS_Mgr::BuildMappingVal(DNS_Mapping* dm)
 void DNS_Mgr::AddResult(DNS_Mgr_Request* dr, struct nb_dns_result* r)
 	{
 	struct hostent* h = (r && r->host_errno == 0) ? r->hostent : 0;
-	u_int32_t ttl = (r && r->host_errno == 0) ? r->ttl : 0;
+	u_int32_t ttl = 0;
+
+	if ( r && r->host_errno == 0 )
+		ttl = r->ttl;
+	else if ( r && r->host_errno == HOST_NOT_FOUND )
+		// The server says the name doesn't exist. Remember that for
+		// a while rather than asking again for each lookup.
+		ttl = negative_ttl;
 
 	DNS_Mapping* new_dm;
 	DNS_Mapping* prev_dm;
@@ -1192,6 +1205,27 @@ void DNS_Mgr::AsyncLookupNameText(const string& name, LookupCallback* callback)
 	IssueAsyncRequests();
 	}
 
+bool DNS_Mgr::PrefetchAddr(const IPAddr& host)
+	{
+	Init();
+
+	if ( mode == DNS_FAKE || ! nb_dns )
+		return false;
+
+	if ( LookupAddrInCache(host) ||
+	     asyncs_addrs.find(host) != asyncs_addrs.end() )
+		return false;
+
+	// A request without callbacks; its result just ends up in the cache.
+	AsyncRequest* req = new AsyncRequest;
+	req->host = host;
+	asyncs_queued.push_back(req);
+	asyncs_addrs.insert(AsyncRequestAddrMap::value_type(host, req));
+
+	IssueAsyncRequests();
+	return true;
+	}
+
 static bool DoRequest(nb_dns_info* nb_dns, DNS_Mgr_Request* dr)
 	{
 	if ( dr->MakeRequest(nb_dns) )
@@ -1205,7 +1239,7 @@ static bool DoRequest(nb_dns_info* nb_dns, DNS_Mgr_Request* dr)
 
 void DNS_Mgr::IssueAsyncRequests()
 	{
-	while ( asyncs_queued.size() && asyncs_pending < MAX_PENDING_REQUESTS )
+	while ( asyncs_queued.size() && asyncs_pending < max_pending )
 		{
 		AsyncRequest* req = asyncs_queued.front();
 		asyncs_queued.pop_front();
@@ -1421,19 +1455,25 @@ void DNS_Mgr::DoProcess()
 		delete req;
 		}
 
-	if ( AnswerAvailable(0) <= 0 )
-		return;
+	// With many requests in flight, answers arrive faster than the main
+	// loop comes around, so take as many as there are waiting, up to one
+	// round of requests.
+	for ( int i = 0; i < max_pending && AnswerAvailable(0) > 0; ++i )
+		{
+		char err[NB_DNS_ERRSIZE];
+		struct nb_dns_result r;
 
-	char err[NB_DNS_ERRSIZE];
-	struct nb_dns_result r;
+		int status = nb_dns_activity(nb_dns, &r, err);
 
-	int status = nb_dns_activity(nb_dns, &r, err);
+		if ( status < 0 )
+			{
+			reporter->Warning("NB-DNS error in DNS_Mgr::Process (%s)", err);
+			break;
+			}
 
-	if ( status < 0 )
-		reporter->Warning("NB-DNS error in DNS_Mgr::Process (%s)", err);
+		if ( status == 0 )
+			continue;
 
-	else if ( status > 0 )
-		{
 		DNS_Mgr_Request* dr = (DNS_Mgr_Request*) r.cookie;
 
 		bool do_host_timeout = true;
@@ -80,6 +80,11 @@ public:
 	void AsyncLookupName(const string& name, LookupCallback* callback);
 	void AsyncLookupNameText(const string& name, LookupCallback* callback);
 
+	// Starts a reverse lookup of the address without waiting for its
+	// result, so that later lookups find it in the cache. Returns false
+	// if the address is already cached or being looked up.
+	bool PrefetchAddr(const IPAddr& host);
+
 	struct Stats {
 		unsigned long requests;	// These count only async requests.
 		unsigned long successful;
@@ -240,6 +245,8 @@ protected:
 	TimeoutQueue asyncs_timeouts;
 
 	int asyncs_pending;
+	int max_pending;
+	uint32 negative_ttl;
 
 	unsigned long num_requests;
 	unsigned long successful;
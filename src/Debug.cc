@@ -18,6 +18,7 @@ using namespace std;
 #include "Func.h"
 #include "Scope.h"
 #include "PolicyFile.h"
+#include "Stats.h"
 
 #ifdef HAVE_READLINE
 #include <readline/readline.h>
@@ -839,6 +840,9 @@ int dbg_handle_debug_input()
 // Return true to continue execution, false to abort.
 bool pre_execute_stmt(Stmt* stmt, Frame* f)
 	{
+	if ( ScriptSampler::Pending() )
+		script_sampler.Sample(stmt);
+
 	if ( ! g_policy_debug ||
 	     stmt->Tag() == STMT_LIST || stmt->Tag() == STMT_NULL )
 		return true;
@@ -6,73 +6,67 @@
 #include <memory.h>
 #endif
 
+#include <utility>
+
 #include "Dict.h"
-#include "Reporter.h"
 
-// If the mean bucket length exceeds the following then Insert() will
-// increase the size of the hash table.
-#define DEFAULT_DENSITY_THRESH 3.0
+// Default number of hash table slots.  The dictionary will increase the
+// size of the hash table as needed.  Always a power of two.
+#define DEFAULT_DICT_SIZE 16
 
-// Threshold above which we do not try to ensure that the hash size
-// is prime.
-#define PRIME_THRESH 1000
+// If the hash table gets fuller than this many percent, Insert() will
+// double its size.
+#define MAX_LOAD 75
 
-// Default number of hash buckets in dictionary.  The dictionary will
-// increase the size of the hash table as needed.
-#define DEFAULT_DICT_SIZE 16
+// Once more than this many removed entries have accumulated in the entry
+// array and they outnumber the live ones, we squeeze them out.
+#define MIN_HOLES_TO_COMPACT 16
 
+// An entry of the array in insertion order.  Removed entries leave holes,
+// which have a negative length.
 class DictEntry {
 public:
-	DictEntry(void* k, int l, hash_t h, void* val)
-		{ key = k; len = l; hash = h; value = val; }
-
-	~DictEntry()
-		{
-		delete [] (char*) key;
-		}
-
 	void* key;
 	int len;
 	hash_t hash;
 	void* value;
 };
 
-// The value of an iteration cookie is the bucket and offset within the
-// bucket at which to start looking for the next value to return.
+// A slot in the hash table.
+class DictSlot {
+public:
+	uint32 hash;	// folded hash of the entry, see fold_hash()
+	int entry;	// index into the entry array, or -1 if the slot is empty
+};
+
+static inline uint32 fold_hash(hash_t h)
+	{
+	return uint32(h ^ (h >> 32));
+	}
+
+// The value of an iteration cookie is the position in the entry array at
+// which to start looking for the next value to return.
 class IterCookie {
 public:
-	IterCookie(int b, int o)
-		{
-		bucket = b;
-		offset = o;
-		ttbl = 0;
-		num_buckets_p = 0;
-		}
+	IterCookie()	{ next = 0; }
 
-	int bucket, offset;
-	PList<DictEntry>** ttbl;
-	const int* num_buckets_p;
-	PList<DictEntry> inserted;	// inserted while iterating
+	int next;
 };
 
 Dictionary::Dictionary(dict_order ordering, int initial_size)
 	{
-	tbl = 0;
-	tbl2 = 0;
+	entries = 0;
+	num_entries_used = entries_capacity = 0;
 
-	if ( ordering == ORDERED )
-		order = new PList<DictEntry>;
-	else
-		order = 0;
-
-	delete_func = 0;
-	tbl_next_ind = 0;
+	slots = 0;
+	num_slots = slot_bits = 0;
 
+	num_entries = max_num_entries = 0;
 	cumulative_entries = 0;
-	num_buckets = num_entries = max_num_entries = thresh_entries = 0;
-	den_thresh = 0;
-	num_buckets2 = num_entries2 = max_num_entries2 = thresh_entries2 = 0;
-	den_thresh2 = 0;
+
+	ordered = (ordering == ORDERED);
+	delete_func = 0;
+	num_iterations = 0;
 
 	if ( initial_size > 0 )
 		Init(initial_size);
@@ -81,549 +75,382 @@ Dictionary::Dictionary(dict_order ordering, int initial_size)
 Dictionary::~Dictionary()
 	{
 	DeInit();
-	delete order;
 	}
 
 void Dictionary::Clear()
 	{
 	DeInit();
-	tbl = 0;
-	tbl2 = 0;
+	}
+
+void Dictionary::Init(int size)
+	{
+	int n = DEFAULT_DICT_SIZE;
+
+	while ( n * MAX_LOAD / 100 < size )
+		n *= 2;
+
+	Rehash(n);
 	}
 
 void Dictionary::DeInit()
 	{
-	if ( ! tbl )
-		return;
+	for ( int i = 0; i < num_entries_used; ++i )
+		{
+		DictEntry& e = entries[i];
 
-	for ( int i = 0; i < num_buckets; ++i )
-		if ( tbl[i] )
-			{
-			PList<DictEntry>* chain = tbl[i];
-			for ( const auto& e : *chain )
-				{
-				if ( delete_func )
-					delete_func(e->value);
-				delete e;
-				}
+		if ( e.len < 0 )
+			continue;
 
-			delete chain;
-			}
+		if ( delete_func )
+			delete_func(e.value);
 
-	delete [] tbl;
+		delete [] (char*) e.key;
+		}
 
-	if ( tbl2 == 0 )
-		return;
+	delete [] entries;
+	delete [] slots;
 
-	for ( int i = 0; i < num_buckets2; ++i )
-		if ( tbl2[i] )
-			{
-			PList<DictEntry>* chain = tbl2[i];
-			for ( const auto& e : *chain )
-				{
-				if ( delete_func )
-					delete_func(e->value);
-				delete e;
-				}
+	entries = 0;
+	num_entries_used = entries_capacity = 0;
 
-			delete chain;
-			}
+	slots = 0;
+	num_slots = slot_bits = 0;
 
-	delete [] tbl2;
-	tbl2 = 0;
+	num_entries = 0;
 	}
 
-void* Dictionary::Lookup(const void* key, int key_size, hash_t hash) const
+uint32 Dictionary::ProbeDistance(int slot) const
 	{
-	if ( ! tbl && ! tbl2 )
-		return 0;
+	return (slot - HomeSlot(slots[slot].hash)) & (num_slots - 1);
+	}
 
-	hash_t h;
-	PList<DictEntry>* chain;
+int Dictionary::FindSlot(const void* key, int key_size, hash_t hash) const
+	{
+	if ( ! num_slots )
+		return -1;
 
-	// Figure out which hash table to look in.
-	h = hash % num_buckets;
-	if ( ! tbl2 || h >= tbl_next_ind )
-		chain = tbl[h];
-	else
-		chain = tbl2[hash % num_buckets2];
+	uint32 h = fold_hash(hash);
+	uint32 mask = num_slots - 1;
+	uint32 s = HomeSlot(h);
 
-	if ( chain )
+	// The table always has empty slots, so this terminates. With Robin
+	// Hood probing, we can also stop once we get to an entry that's
+	// closer to its home slot than the key would be.
+	for ( uint32 dist = 0; ; ++dist, s = (s + 1) & mask )
 		{
-		for ( int i = 0; i < chain->length(); ++i )
-			{
-			DictEntry* entry = (*chain)[i];
-
-			if ( entry->hash == hash && entry->len == key_size &&
-			     ! memcmp(key, entry->key, key_size) )
-				return entry->value;
-			}
-		}
+		const DictSlot& slot = slots[s];
 
-	return 0;
-	}
+		if ( slot.entry < 0 || ProbeDistance(s) < dist )
+			return -1;
 
-void* Dictionary::Insert(void* key, int key_size, hash_t hash, void* val,
-				int copy_key)
-	{
-	if ( ! tbl )
-		Init(DEFAULT_DICT_SIZE);
+		if ( slot.hash != h )
+			continue;
 
-	DictEntry* new_entry = new DictEntry(key, key_size, hash, val);
-	void* old_val = Insert(new_entry, copy_key);
+		const DictEntry& e = entries[slot.entry];
 
-	if ( old_val )
-		{
-		// We didn't need the new DictEntry, the key was already
-		// present.
-		delete new_entry;
+		if ( e.hash == hash && e.len == key_size &&
+		     ! memcmp(key, e.key, key_size) )
+			return s;
 		}
-	else if ( order )
-		order->push_back(new_entry);
-
-	// Resize logic.
-	if ( tbl2 )
-		MoveChains();
-	else if ( num_entries >= thresh_entries )
-		StartChangeSize(num_buckets * 2 + 1);
-
-	return old_val;
 	}
 
-void* Dictionary::Remove(const void* key, int key_size, hash_t hash,
-				bool dont_delete)
+void Dictionary::InsertSlot(int entry_idx)
 	{
-	if ( ! tbl && ! tbl2 )
-		return 0;
-
-	hash_t h;
-	PList<DictEntry>* chain;
-	int* num_entries_ptr;
-
-	// Figure out which hash table to look in
-	h = hash % num_buckets;
-	if ( ! tbl2 || h >= tbl_next_ind )
-		{
-		chain = tbl[h];
-		num_entries_ptr = &num_entries;
-		}
-	else
-		{
-		chain = tbl2[hash % num_buckets2];
-		num_entries_ptr = &num_entries2;
-		}
+	DictSlot cur;
+	cur.hash = fold_hash(entries[entry_idx].hash);
+	cur.entry = entry_idx;
 
-	if ( ! chain )
-		return 0;
+	uint32 mask = num_slots - 1;
+	uint32 s = HomeSlot(cur.hash);
 
-	for ( int i = 0; i < chain->length(); ++i )
+	for ( uint32 dist = 0; ; ++dist, s = (s + 1) & mask )
 		{
-		DictEntry* entry = (*chain)[i];
-
-		if ( entry->hash == hash && entry->len == key_size &&
-		     ! memcmp(key, entry->key, key_size) )
+		if ( slots[s].entry < 0 )
 			{
-			void* entry_value = DoRemove(entry, h, chain, i);
+			slots[s] = cur;
+			return;
+			}
 
-			if ( dont_delete )
-				entry->key = 0;
+		// Take the slot from entries closer to their home slot than
+		// we are, and move on with placing that one.
+		uint32 d = ProbeDistance(s);
 
-			delete entry;
-			--*num_entries_ptr;
-			return entry_value;
+		if ( d < dist )
+			{
+			std::swap(slots[s], cur);
+			dist = d;
 			}
 		}
-
-	return 0;
 	}
 
-void* Dictionary::DoRemove(DictEntry* entry, hash_t h,
-				PList<DictEntry>* chain, int chain_offset)
+void Dictionary::RemoveSlot(int slot)
 	{
-	void* entry_value = entry->value;
+	uint32 mask = num_slots - 1;
+	uint32 s = slot;
 
-	chain->remove_nth(chain_offset);
-	if ( order )
-		order->remove(entry);
-
-	// Adjust existing cookies.
-	for ( const auto& c : cookies )
+	// Shift the following entries back until we reach one that's in
+	// its home slot already, so that no tombstones are needed.
+	for ( ; ; )
 		{
-		// Is the affected bucket the current one?
-		if ( (unsigned int) c->bucket == h )
-			{
-			if ( c->offset > chain_offset )
-				--c->offset;
-
-			// The only other important case here occurs when we
-			// are deleting the current entry which
-			// simultaniously happens to be the last one in this
-			// bucket. This means that we would have to move on
-			// to the next non-empty bucket. Fortunately,
-			// NextEntry() will do exactly the right thing in
-			// this case. :-)
-			}
+		uint32 next = (s + 1) & mask;
 
-		// This item may have been inserted during this iteration.
-		if ( (unsigned int) c->bucket > h )
-			c->inserted.remove(entry);
+		if ( slots[next].entry < 0 || ProbeDistance(next) == 0 )
+			break;
+
+		slots[s] = slots[next];
+		s = next;
 		}
 
-	return entry_value;
+	slots[s].entry = -1;
 	}
 
-void* Dictionary::NthEntry(int n, const void*& key, int& key_len) const
+void Dictionary::Rehash(int new_num_slots)
 	{
-	if ( ! order || n < 0 || n >= Length() )
-		return 0;
+	// Positions in the entry array must stay put while an iteration is
+	// going on, or entries would move under its cookie.
+	if ( num_iterations == 0 && num_entries_used > num_entries )
+		{
+		int j = 0;
+
+		for ( int i = 0; i < num_entries_used; ++i )
+			if ( entries[i].len >= 0 )
+				entries[j++] = entries[i];
 
-	DictEntry* entry = (*order)[n];
-	key = entry->key;
-	key_len = entry->len;
-	return entry->value;
+		num_entries_used = j;
+		}
+
+	delete [] slots;
+	slots = new DictSlot[new_num_slots];
+	num_slots = new_num_slots;
+
+	for ( slot_bits = 0; (1 << slot_bits) < num_slots; ++slot_bits )
+		;
+
+	for ( int i = 0; i < num_slots; ++i )
+		slots[i].entry = -1;
+
+	for ( int i = 0; i < num_entries_used; ++i )
+		if ( entries[i].len >= 0 )
+			InsertSlot(i);
 	}
 
-IterCookie* Dictionary::InitForIteration() const
+void Dictionary::Compact()
 	{
-	return new IterCookie(0, 0);
+	Rehash(num_slots);
 	}
 
-void Dictionary::StopIteration(IterCookie* cookie) const
+void* Dictionary::Lookup(const void* key, int key_size, hash_t hash) const
 	{
-	delete cookie;
+	int s = FindSlot(key, key_size, hash);
+	return s >= 0 ? entries[slots[s].entry].value : 0;
 	}
 
-void* Dictionary::NextEntry(HashKey*& h, IterCookie*& cookie, int return_hash) const
+void* Dictionary::Insert(void* key, int key_size, hash_t hash, void* val,
+				int copy_key)
 	{
-	if ( ! tbl && ! tbl2 )
-		{
-		const_cast<PList<IterCookie>*>(&cookies)->remove(cookie);
-		delete cookie;
-		cookie = 0;
-		return 0;
-		}
-
-	// If there are any inserted entries, return them first.
-	// That keeps the list small and helps avoiding searching
-	// a large list when deleting an entry.
+	if ( ! num_slots )
+		Init(DEFAULT_DICT_SIZE);
 
-	DictEntry* entry;
+	int s = FindSlot(key, key_size, hash);
 
-	if ( cookie->inserted.length() )
+	if ( s >= 0 )
 		{
-		// Return the last one. Order doesn't matter,
-		// and removing from the tail is cheaper.
-		entry = cookie->inserted.remove_nth(cookie->inserted.length()-1);
-		if ( return_hash )
-			h = new HashKey(entry->key, entry->len, entry->hash);
-
-		return entry->value;
-		}
+		// We don't need the new key, it's present already.
+		DictEntry& e = entries[slots[s].entry];
+		void* old_val = e.value;
+		e.value = val;
 
-	int b = cookie->bucket;
-	int o = cookie->offset;
-	PList<DictEntry>** ttbl;
-	const int* num_buckets_p;
+		if ( ! copy_key )
+			delete [] (char*) key;
 
-	if ( ! cookie->ttbl )
-		{
-		// XXX maybe we could update cookie->b from tbl_next_ind here?
-		cookie->ttbl = tbl;
-		cookie->num_buckets_p = &num_buckets;
+		return old_val;
 		}
 
-	ttbl = cookie->ttbl;
-	num_buckets_p = cookie->num_buckets_p;
+	if ( (num_entries + 1) * 100 > num_slots * MAX_LOAD )
+		Rehash(num_slots * 2);
 
-	if ( ttbl[b] && ttbl[b]->length() > o )
+	if ( num_entries_used == entries_capacity )
 		{
-		entry = (*ttbl[b])[o];
-		++cookie->offset;
-		if ( return_hash )
-			h = new HashKey(entry->key, entry->len, entry->hash);
-		return entry->value;
-		}
+		if ( num_iterations == 0 &&
+		     num_entries_used - num_entries > entries_capacity / 4 )
+			Compact();
 
-	++b;	// Move on to next non-empty bucket.
-	while ( b < *num_buckets_p && (! ttbl[b] || ttbl[b]->length() == 0) )
-		++b;
-
-	if ( b >= *num_buckets_p )
-		{
-		// If we're resizing, we need to search the 2nd table too.
-		if ( ttbl == tbl && tbl2 )
+		if ( num_entries_used == entries_capacity )
 			{
-			cookie->ttbl = tbl2;
-			cookie->num_buckets_p = &num_buckets2;
-			cookie->bucket = 0;
-			cookie->offset = 0;
-			return Dictionary::NextEntry(h, cookie, return_hash);
-			}
+			int new_capacity = entries_capacity ?
+						entries_capacity * 2 : 8;
+			DictEntry* new_entries = new DictEntry[new_capacity];
 
-		// All done.
+			if ( num_entries_used )
+				memcpy(new_entries, entries,
+				       num_entries_used * sizeof(DictEntry));
 
-		// FIXME: I don't like removing the const here. But is there
-		// a better way?
-		const_cast<PList<IterCookie>*>(&cookies)->remove(cookie);
-		delete cookie;
-		cookie = 0;
-		return 0;
+			delete [] entries;
+			entries = new_entries;
+			entries_capacity = new_capacity;
+			}
 		}
 
-	entry = (*ttbl[b])[0];
-	if ( return_hash )
-		h = new HashKey(entry->key, entry->len, entry->hash);
-
-	cookie->bucket = b;
-	cookie->offset = 1;
+	if ( copy_key )
+		{
+		void* new_key = new char[key_size];
+		memcpy(new_key, key, key_size);
+		key = new_key;
+		}
 
-	return entry->value;
-	}
+	// Appending means that ongoing iterations will get to the new
+	// entry, too.
+	DictEntry& e = entries[num_entries_used];
+	e.key = key;
+	e.len = key_size;
+	e.hash = hash;
+	e.value = val;
 
-void Dictionary::Init(int size)
-	{
-	num_buckets = NextPrime(size);
-	tbl = new PList<DictEntry>*[num_buckets];
+	InsertSlot(num_entries_used++);
 
-	for ( int i = 0; i < num_buckets; ++i )
-		tbl[i] = 0;
+	++cumulative_entries;
+	if ( max_num_entries < ++num_entries )
+		max_num_entries = num_entries;
 
-	max_num_entries = num_entries = 0;
-	SetDensityThresh(DEFAULT_DENSITY_THRESH);
+	return 0;
 	}
 
-void Dictionary::Init2(int size)
+void* Dictionary::Remove(const void* key, int key_size, hash_t hash,
+				bool dont_delete)
 	{
-	num_buckets2 = NextPrime(size);
-	tbl2 = new PList<DictEntry>*[num_buckets2];
+	void* entry_key;
+	void* entry_value = Remove(key, key_size, hash, entry_key);
 
-	for ( int i = 0; i < num_buckets2; ++i )
-		tbl2[i] = 0;
+	if ( ! dont_delete )
+		delete [] (char*) entry_key;
 
-	max_num_entries2 = num_entries2 = 0;
+	return entry_value;
 	}
 
-// private
-void* Dictionary::Insert(DictEntry* new_entry, int copy_key)
+void* Dictionary::Remove(const void* key, int key_size, hash_t hash,
+				void*& entry_key)
 	{
-	if ( ! tbl )
-		Init(DEFAULT_DICT_SIZE);
-
-	PList<DictEntry>** ttbl;
-	int* num_entries_ptr;
-	int* max_num_entries_ptr;
-	hash_t h = new_entry->hash % num_buckets;
-
-	// We must be careful when we are in the middle of resizing.
-	// If the new entry hashes to a bucket in the old table we
-	// haven't moved yet, we need to put it in the old table. If
-	// we didn't do it this way, we would sometimes have to
-	// search both tables which is probably more expensive.
+	int s = FindSlot(key, key_size, hash);
 
-	if ( ! tbl2 || h >= tbl_next_ind )
-		{
-		ttbl = tbl;
-		num_entries_ptr = &num_entries;
-		max_num_entries_ptr = &max_num_entries;
-		}
-	else
+	if ( s < 0 )
 		{
-		ttbl = tbl2;
-		h = new_entry->hash % num_buckets2;
-		num_entries_ptr = &num_entries2;
-		max_num_entries_ptr = &max_num_entries2;
+		entry_key = 0;
+		return 0;
 		}
 
-	PList<DictEntry>* chain = ttbl[h];
+	DictEntry& e = entries[slots[s].entry];
+	void* entry_value = e.value;
+	entry_key = e.key;
 
-	int n = new_entry->len;
+	// Ongoing iterations skip over the hole.
+	e.key = 0;
+	e.value = 0;
+	e.len = -1;
 
-	if ( chain )
-		{
-		for ( int i = 0; i < chain->length(); ++i )
-			{
-			DictEntry* entry = (*chain)[i];
+	RemoveSlot(s);
+	--num_entries;
 
-			if ( entry->hash == new_entry->hash &&
-			     entry->len == n &&
-			     ! memcmp(entry->key, new_entry->key, n) )
-				{
-				void* old_value = entry->value;
-				entry->value = new_entry->value;
-				return old_value;
-				}
-			}
-		}
-	else
-		// Create new chain.
-		chain = ttbl[h] = new PList<DictEntry>;
+	int holes = num_entries_used - num_entries;
 
-	// If we got this far, then we couldn't use an existing copy
-	// of the key, so make a new one if necessary.
-	if ( copy_key )
-		{
-		void* old_key = new_entry->key;
-		new_entry->key = (void*) new char[n];
-		memcpy(new_entry->key, old_key, n);
-		delete (char*) old_key;
-		}
+	if ( num_iterations == 0 && holes > MIN_HOLES_TO_COMPACT &&
+	     holes > num_entries )
+		Compact();
 
-	// We happen to know (:-() that appending is more efficient
-	// on lists than prepending.
-	chain->push_back(new_entry);
+	return entry_value;
+	}
 
-	++cumulative_entries;
-	if ( *max_num_entries_ptr < ++*num_entries_ptr )
-		*max_num_entries_ptr = *num_entries_ptr;
+void* Dictionary::NthEntry(int n, const void*& key, int& key_len) const
+	{
+	if ( ! ordered || n < 0 || n >= num_entries )
+		return 0;
 
-	// For ongoing iterations: If we already passed the bucket where this
-	// entry was put, add it to the cookie's list of inserted entries.
-	for ( const auto& c : cookies )
+	const DictEntry* e = 0;
+
+	if ( num_entries_used == num_entries )
+		e = &entries[n];
+	else
 		{
-		if ( h < (unsigned int) c->bucket )
-			c->inserted.push_back(new_entry);
+		for ( int i = 0; i < num_entries_used; ++i )
+			if ( entries[i].len >= 0 && n-- == 0 )
+				{
+				e = &entries[i];
+				break;
+				}
 		}
 
-	return 0;
+	key = e->key;
+	key_len = e->len;
+	return e->value;
 	}
 
-int Dictionary::NextPrime(int n) const
+IterCookie* Dictionary::InitForIteration() const
 	{
-	if ( (n & 0x1) == 0 )
-		// Even.
-		++n;
-
-	if ( n > PRIME_THRESH )
-		// Too expensive to test for primality, just stick with it.
-		return n;
-
-	while ( ! IsPrime(n) )
-		n += 2;
-
-	return n;
+	++num_iterations;
+	return new IterCookie();
 	}
 
-int Dictionary::IsPrime(int n) const
+void Dictionary::StopIteration(IterCookie* cookie) const
 	{
-	for ( int j = 3; j * j <= n; ++j )
-		if ( n % j == 0 )
-			return 0;
+	if ( ! cookie )
+		return;
 
-	return 1;
+	--num_iterations;
+	delete cookie;
 	}
 
-void Dictionary::StartChangeSize(int new_size)
+void* Dictionary::NextEntry(HashKey*& h, IterCookie*& cookie, int return_hash) const
 	{
-	// Only start resizing if there isn't any iteration in progress.
-	if ( cookies.length() > 0 )
-		return;
+	while ( cookie->next < num_entries_used )
+		{
+		const DictEntry& e = entries[cookie->next++];
 
-	if ( tbl2 )
-		reporter->InternalError("Dictionary::StartChangeSize() tbl2 not NULL");
+		if ( e.len < 0 )
+			continue;
 
-	Init2(new_size);
+		if ( return_hash )
+			h = new HashKey(e.key, e.len, e.hash);
 
-	tbl_next_ind = 0;
+		return e.value;
+		}
 
-	// Preserve threshold density
-	SetDensityThresh2(DensityThresh());
+	// All done.
+	StopIteration(cookie);
+	cookie = 0;
+	return 0;
 	}
 
-void Dictionary::MoveChains()
+void* Dictionary::NextEntry(const void*& key, int& key_size, hash_t& hash,
+			IterCookie*& cookie) const
 	{
-	// Do not change current distribution if there an ongoing iteration.
-	if ( cookies.length() > 0 )
-		return;
-
-	// Attempt to move this many entries (must do at least 2)
-	int num = 8;
-
-	do
+	while ( cookie->next < num_entries_used )
 		{
-		PList<DictEntry>* chain = tbl[tbl_next_ind++];
+		const DictEntry& e = entries[cookie->next++];
 
-		if ( ! chain )
+		if ( e.len < 0 )
 			continue;
 
-		tbl[tbl_next_ind - 1] = 0;
-
-		for ( int j = 0; j < chain->length(); ++j )
-			{
-			Insert((*chain)[j], 0);
-			--num_entries;
-			--num;
-			}
-
-		delete chain;
+		key = e.key;
+		key_size = e.len;
+		hash = e.hash;
+		return e.value;
 		}
-	while ( num > 0 && int(tbl_next_ind) < num_buckets );
 
-	if ( int(tbl_next_ind) >= num_buckets )
-		FinishChangeSize();
-	}
-
-void Dictionary::FinishChangeSize()
-	{
-	// Cheap safety check.
-	if ( num_entries != 0 )
-		reporter->InternalError(
-		    "Dictionary::FinishChangeSize: num_entries is %d\n",
-		    num_entries);
-
-	for ( int i = 0; i < num_buckets; ++i )
-		delete tbl[i];
-	delete [] tbl;
-
-	tbl = tbl2;
-	tbl2 = 0;
-
-	num_buckets = num_buckets2;
-	num_entries = num_entries2;
-	max_num_entries = max_num_entries2;
-	den_thresh = den_thresh2;
-	thresh_entries = thresh_entries2;
-
-	num_buckets2 = 0;
-	num_entries2 = 0;
-	max_num_entries2 = 0;
-	den_thresh2 = 0;
-	thresh_entries2 = 0;
+	// All done.
+	StopIteration(cookie);
+	cookie = 0;
+	return 0;
 	}
 
 unsigned int Dictionary::MemoryAllocation() const
 	{
 	int size = padded_sizeof(*this);
 
-	if ( ! tbl )
-		return size;
-
-	for ( int i = 0; i < num_buckets; ++i )
-		if ( tbl[i] )
-			{
-			PList<DictEntry>* chain = tbl[i];
-			for ( const auto& c : *chain )
-				size += padded_sizeof(DictEntry) + pad_size(c->len);
-			size += chain->MemoryAllocation();
-			}
-
-	size += pad_size(num_buckets * sizeof(PList<DictEntry>*));
-
-	if ( order )
-		size += order->MemoryAllocation();
+	for ( int i = 0; i < num_entries_used; ++i )
+		if ( entries[i].len >= 0 )
+			size += pad_size(entries[i].len);
 
-	if ( tbl2 )
-		{
-		for ( int i = 0; i < num_buckets2; ++i )
-			if ( tbl2[i] )
-				{
-				PList<DictEntry>* chain = tbl2[i];
-				for ( const auto& c : *chain )
-					size += padded_sizeof(DictEntry) + pad_size(c->len);
-				size += chain->MemoryAllocation();
-				}
-
-		size += pad_size(num_buckets2 * sizeof(PList<DictEntry>*));
-		}
+	size += pad_size(entries_capacity * sizeof(DictEntry));
+	size += pad_size(num_slots * sizeof(DictSlot));
 
 	return size;
 	}
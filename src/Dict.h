@@ -8,6 +8,7 @@
 
 class Dictionary;
 class DictEntry;
+class DictSlot;
 class IterCookie;
 
 // Type indicating whether the dictionary should keep track of the order
@@ -53,16 +54,16 @@ public:
 	void* Remove(const void* key, int key_size, hash_t hash,
 				bool dont_delete = false);
 
+	// Same, but hands the entry's key bytes over to the caller, who
+	// then needs to delete [] them, instead of deleting them.
+	void* Remove(const void* key, int key_size, hash_t hash,
+				void*& entry_key);
+
 	// Number of entries.
-	int Length() const
-		{ return tbl2 ? num_entries + num_entries2 : num_entries; }
+	int Length() const		{ return num_entries; }
 
 	// Largest it's ever been.
-	int MaxLength() const
-		{
-		return tbl2 ?
-			max_num_entries + max_num_entries2 : max_num_entries;
-		}
+	int MaxLength() const		{ return max_num_entries; }
 
 	// Total number of entries ever.
 	uint64 NumCumulativeInserts() const
@@ -71,7 +72,7 @@ public:
 		}
 
 	// True if the dictionary is ordered, false otherwise.
-	int IsOrdered() const		{ return order != 0; }
+	int IsOrdered() const		{ return ordered; }
 
 	// If the dictionary is ordered then returns the n'th entry's value;
 	// the second method also returns the key.  The first entry inserted
@@ -91,29 +92,33 @@ public:
 	// to get an "iteration cookie".  The cookie can then be handed
 	// to NextEntry() to get the next entry in the iteration and update
 	// the cookie.  If NextEntry() indicates no more entries, it will
-	// also delete the cookie, or the cookie can be manually deleted
-	// prior to this if no longer needed.
+	// also delete the cookie, or the cookie can be released with
+	// StopIteration() prior to this if no longer needed.
 	//
-	// Unexpected results will occur if the elements of
-	// the dictionary are changed between calls to NextEntry() without
-	// first calling InitForIteration().
+	// Entries are visited in the order they were inserted. While any
+	// cookie is live, entries keep their positions, so entries may be
+	// added and removed between calls to NextEntry(): we'll visit all
+	// remaining entries once, including those added meanwhile, and skip
+	// those removed before we got to them. Cookies need to be finished or
+	// released with StopIteration(), as until then the space of removed
+	// entries can't be reclaimed.
 	//
 	// If return_hash is true, a HashKey for the entry is returned in h,
 	// which should be delete'd when no longer needed.
 	IterCookie* InitForIteration() const;
 	void* NextEntry(HashKey*& h, IterCookie*& cookie, int return_hash) const;
+
+	// Same, but returns the entry's key in place rather than copying it
+	// into a new HashKey. The key stays valid until the entry is removed.
+	void* NextEntry(const void*& key, int& key_size, hash_t& hash,
+			IterCookie*& cookie) const;
 	void StopIteration(IterCookie* cookie) const;
 
 	void SetDeleteFunc(dict_delete_func f)		{ delete_func = f; }
 
-	// With a robust cookie, it is safe to change the dictionary while
-	// iterating. This means that (i) we will eventually visit all
-	// unmodified entries as well as all entries added during iteration,
-	// and (ii) we won't visit any still-unseen entries which are getting
-	// removed. (We don't get this for free, so only use it if
-	// necessary.)
-	void MakeRobustCookie(IterCookie* cookie)
-		{ cookies.push_back(cookie); }
+	// All cookies come with the guarantees that robust ones used to
+	// add, see above, so this is a no-op kept for compatibility.
+	void MakeRobustCookie(IterCookie* cookie)	{ }
 
 	// Remove all entries.
 	void Clear();
@@ -121,66 +126,52 @@ public:
 	unsigned int MemoryAllocation() const;
 
 private:
+	// The dictionary is kept as an array of entries in order of
+	// insertion, plus an open-addressing hash table with Robin Hood
+	// probing mapping hashes to their positions in the array. Removing
+	// an entry leaves a hole in the array, so that iteration positions
+	// remain valid; holes get squeezed out once they make up a good
+	// part of the array and no iteration is pending.
 	void Init(int size);
-	void Init2(int size);	// initialize second table for resizing
 	void DeInit();
 
-	// Internal version of Insert().
-	void* Insert(DictEntry* entry, int copy_key);
+	// Returns the slot holding the entry for the key, or -1 if none.
+	int FindSlot(const void* key, int key_size, hash_t hash) const;
 
-	void* DoRemove(DictEntry* entry, hash_t h,
-			PList<DictEntry>* chain, int chain_offset);
+	// Adds the entry at the given position in the array to the hash
+	// table, which must have room for it.
+	void InsertSlot(int entry_idx);
 
-	int NextPrime(int n) const;
-	int IsPrime(int n) const;
-	void StartChangeSize(int new_size);
-	void FinishChangeSize();
-	void MoveChains();
+	// Removes the given slot from the hash table.
+	void RemoveSlot(int slot);
 
-	// The following get and set the "density" threshold - if the
-	// average hash chain length exceeds this threshold, the
-	// table will be resized.  The default value is 3.0.
-	double DensityThresh() const	{ return den_thresh; }
+	// Rebuilds the hash table with the given number of slots, a power
+	// of two. Squeezes out holes from the entry array if possible.
+	void Rehash(int new_num_slots);
+	void Compact();
 
-	void SetDensityThresh(double thresh)
-		{
-		den_thresh = thresh;
-		thresh_entries = int(thresh * double(num_buckets));
-		}
+	uint32 HomeSlot(uint32 h) const
+		{ return (h * 2654435769U) >> (32 - slot_bits); }
+	uint32 ProbeDistance(int slot) const;
 
-	// Same for the second table, when resizing.
-	void SetDensityThresh2(double thresh)
-		{
-		den_thresh2 = thresh;
-		thresh_entries2 = int(thresh * double(num_buckets2));
-		}
+	DictEntry* entries;
+	int num_entries_used;	// including holes
+	int entries_capacity;
+
+	DictSlot* slots;
+	int num_slots;
+	int slot_bits;
 
-	// Normally we only have tbl.
-	// When we're resizing, we'll have tbl (old) and tbl2 (new)
-	// tbl_next_ind keeps track of how much we've moved to tbl2
-	// (it's the next index we're going to move).
-	PList<DictEntry>** tbl;
-	int num_buckets;
 	int num_entries;
 	int max_num_entries;
 	uint64 cumulative_entries;
-	double den_thresh;
-	int thresh_entries;
-
-	// Resizing table (replicates tbl above).
-	PList<DictEntry>** tbl2;
-	int num_buckets2;
-	int num_entries2;
-	int max_num_entries2;
-	double den_thresh2;
-	int thresh_entries2;
 
-	hash_t tbl_next_ind;
-
-	PList<DictEntry>* order;
+	int ordered;
 	dict_delete_func delete_func;
 
-	PList<IterCookie> cookies;
+	// Number of live iteration cookies. Entries mustn't move while
+	// there are any.
+	mutable int num_iterations;
 };
 
 template<typename T>
@@ -216,8 +207,16 @@ public:
 		}
 	T* NextEntry(HashKey*& h, IterCookie*& cookie) const
 		{ return (T*) Dictionary::NextEntry(h, cookie, 1); }
+	T* NextEntry(const void*& key, int& key_size, hash_t& hash,
+		     IterCookie*& cookie) const
+		{ return (T*) Dictionary::NextEntry(key, key_size, hash, cookie); }
 	T* RemoveEntry(const HashKey* key)
 		{ return (T*) Remove(key->Key(), key->Size(), key->Hash()); }
+	T* RemoveEntry(const HashKey* key, void*& entry_key)
+		{
+		return (T*) Remove(key->Key(), key->Size(), key->Hash(),
+					entry_key);
+		}
 };
 
 #endif
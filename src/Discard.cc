@@ -16,6 +16,7 @@ Discarder::Discarder()
 	check_icmp = internal_func("discarder_check_icmp");
 
 	discarder_maxlen = static_cast<int>(opt_internal_int("discarder_maxlen"));
+	next_rule_id = 1;
 	}
 
 Discarder::~Discarder()
@@ -24,13 +25,188 @@ Discarder::~Discarder()
 
 int Discarder::IsActive()
 	{
-	return check_ip || check_tcp || check_udp || check_icmp;
+	return check_ip || check_tcp || check_udp || check_icmp || rules.size();
+	}
+
+static void compile_prefix(const IPPrefix& p, uint32* net, uint32* mask)
+	{
+	p.Prefix().CopyIPv6(net);
+
+	int width = p.LengthIPv6();
+
+	for ( int i = 0; i < 4; ++i )
+		{
+		int bits = std::min(std::max(width - 32 * i, 0), 32);
+		mask[i] = bits ? htonl(0xffffffff << (32 - bits)) : 0;
+		net[i] &= mask[i];
+		}
+	}
+
+static inline bool match_prefix(const uint32* addr, const uint32* net, const uint32* mask)
+	{
+	return (addr[0] & mask[0]) == net[0] && (addr[1] & mask[1]) == net[1] &&
+	       (addr[2] & mask[2]) == net[2] && (addr[3] & mask[3]) == net[3];
+	}
+
+uint32 Discarder::AddRule(RecordVal* r)
+	{
+	Rule rule;
+	memset(&rule, 0, sizeof(rule));
+
+	rule.id = next_rule_id++;
+	rule.proto = rule.src_port = rule.dst_port = -1;
+
+	if ( Val* v = r->Lookup("src") )
+		{
+		rule.match_src = true;
+		compile_prefix(v->AsSubNet(), rule.src_net, rule.src_mask);
+		}
+
+	if ( Val* v = r->Lookup("dst") )
+		{
+		rule.match_dst = true;
+		compile_prefix(v->AsSubNet(), rule.dst_net, rule.dst_mask);
+		}
+
+	if ( Val* v = r->Lookup("proto") )
+		rule.proto = v->AsCount();
+
+	// Ports imply their protocol.
+	Val* ports[] = { r->Lookup("src_p"), r->Lookup("dst_p") };
+	int* rule_ports[] = { &rule.src_port, &rule.dst_port };
+
+	for ( int i = 0; i < 2; ++i )
+		{
+		PortVal* p = ports[i] ? ports[i]->AsPortVal() : 0;
+
+		if ( ! p )
+			continue;
+
+		*rule_ports[i] = p->Port();
+		rule.proto = p->IsTCP() ? IPPROTO_TCP :
+			(p->IsUDP() ? IPPROTO_UDP : IPPROTO_ICMP);
+		}
+
+	if ( Val* v = r->Lookup("tcp_flags_set") )
+		rule.flags_set = v->AsCount();
+
+	if ( Val* v = r->Lookup("tcp_flags_unset") )
+		rule.flags_unset = v->AsCount();
+
+	if ( rule.flags_set || rule.flags_unset )
+		rule.proto = IPPROTO_TCP;
+
+	rules.push_back(rule);
+	return rule.id;
+	}
+
+bool Discarder::RemoveRule(uint32 id)
+	{
+	for ( std::vector<Rule>::iterator i = rules.begin(); i != rules.end(); ++i )
+		{
+		if ( i->id == id )
+			{
+			rules.erase(i);
+			return true;
+			}
+		}
+
+	return false;
+	}
+
+int Discarder::MatchRules(const IP_Hdr* ip, int len, int caplen) const
+	{
+	uint32 src[4], dst[4];
+	ip->SrcAddr().CopyIPv6(src);
+	ip->DstAddr().CopyIPv6(dst);
+
+	int proto = ip->NextProto();
+
+	// Transport-level fields, if we have them.
+	bool have_ports = false;
+	int src_port = 0, dst_port = 0;
+	int flags = -1;
+
+	int tlen = std::min(len, caplen) - ip->HdrLen();
+	const u_char* data = ip->Payload();
+
+	if ( ! ip->IsFragment() )
+		{
+		if ( proto == IPPROTO_TCP && tlen >= (int) sizeof(struct tcphdr) )
+			{
+			const struct tcphdr* tp = (const struct tcphdr*) data;
+			src_port = ntohs(tp->th_sport);
+			dst_port = ntohs(tp->th_dport);
+			flags = tp->th_flags;
+			have_ports = true;
+			}
+
+		else if ( proto == IPPROTO_UDP && tlen >= (int) sizeof(struct udphdr) )
+			{
+			const struct udphdr* up = (const struct udphdr*) data;
+			src_port = ntohs(up->uh_sport);
+			dst_port = ntohs(up->uh_dport);
+			have_ports = true;
+			}
+
+		else if ( proto == IPPROTO_ICMP && tlen >= 2 )
+			{
+			// Like for connections, we take type and code as
+			// the ports.
+			src_port = data[0];
+			dst_port = data[1];
+			have_ports = true;
+			}
+		}
+
+	for ( std::vector<Rule>::const_iterator i = rules.begin(); i != rules.end(); ++i )
+		{
+		const Rule& r = *i;
+
+		if ( r.proto >= 0 && r.proto != proto )
+			continue;
+
+		if ( r.match_src && ! match_prefix(src, r.src_net, r.src_mask) )
+			continue;
+
+		if ( r.match_dst && ! match_prefix(dst, r.dst_net, r.dst_mask) )
+			continue;
+
+		if ( r.src_port >= 0 || r.dst_port >= 0 )
+			{
+			if ( ! have_ports )
+				continue;
+
+			if ( r.src_port >= 0 && r.src_port != src_port )
+				continue;
+
+			if ( r.dst_port >= 0 && r.dst_port != dst_port )
+				continue;
+			}
+
+		if ( r.flags_set || r.flags_unset )
+			{
+			if ( flags < 0 )
+				continue;
+
+			if ( (flags & r.flags_set) != r.flags_set || (flags & r.flags_unset) )
+				continue;
+			}
+
+		return 1;
+		}
+
+	return 0;
 	}
 
 int Discarder::NextPacket(const IP_Hdr* ip, int len, int caplen)
 	{
 	int discard_packet = 0;
 
+	// The native rules come first, as they're cheap.
+	if ( rules.size() && MatchRules(ip, len, caplen) )
+		return 1;
+
 	if ( check_ip )
 		{
 		val_list args{ip->BuildPktHdrVal()};
@@ -3,6 +3,8 @@
 #ifndef discard_h
 #define discard_h
 
+#include <vector>
+
 #include "IP.h"
 #include "Func.h"
 
@@ -12,6 +14,7 @@ struct udphdr;
 struct icmp;
 
 class Val;
+class RecordVal;
 class RecordType;
 class Func;
 
@@ -24,9 +27,35 @@ public:
 
 	int NextPacket(const IP_Hdr* ip, int len, int caplen);
 
+	// Adds a native rule, given as a discard_rule record. Returns an ID
+	// for removing it again.
+	uint32 AddRule(RecordVal* rule);
+
+	// Removes a rule. Returns false if there's no rule with that ID.
+	bool RemoveRule(uint32 id);
+
 protected:
+	// A discard_rule compiled into a form that we can check a packet
+	// against without building any Vals. All conditions present must
+	// hold for a packet to be discarded.
+	struct Rule {
+		uint32 id;
+		bool match_src, match_dst;
+		uint32 src_net[4], src_mask[4];	// network order
+		uint32 dst_net[4], dst_mask[4];
+		int proto;	// IP protocol, or -1 for any
+		int src_port, dst_port;	// host order, or -1 for any
+		uint8 flags_set;	// TCP flags that all must be set
+		uint8 flags_unset;	// TCP flags none of which may be set
+	};
+
+	int MatchRules(const IP_Hdr* ip, int len, int caplen) const;
+
 	Val* BuildData(const u_char* data, int hdrlen, int len, int caplen);
 
+	std::vector<Rule> rules;
+	uint32 next_rule_id;
+
 	Func* check_ip;
 	Func* check_tcp;
 	Func* check_udp;
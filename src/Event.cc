@@ -3,9 +3,11 @@
 #include "zeek-config.h"
 
 #include "Event.h"
+#include "EventRecorder.h"
 #include "Func.h"
 #include "NetVar.h"
 #include "Trigger.h"
+#include "Net.h"
 #include "plugin/Manager.h"
 
 EventMgr mgr;
@@ -108,6 +110,9 @@ void EventMgr::QueueEvent(Event* event)
 	if ( done )
 		return;
 
+	if ( event_recorder )
+		event_recorder->Record(event);
+
 	if ( ! head )
 		head = tail = event;
 	else
@@ -119,7 +124,19 @@ void EventMgr::QueueEvent(Event* event)
 	++num_events_queued;
 	}
 
-void EventMgr::Drain()
+void EventMgr::QueueScriptEvent(const EventHandlerPtr &h, val_list vl,
+				TimerMgr* mgr)
+	{
+	if ( event_recorder )
+		event_recorder->Pause();
+
+	QueueEvent(h, std::move(vl), SOURCE_LOCAL, 0, mgr);
+
+	if ( event_recorder )
+		event_recorder->Resume();
+	}
+
+void EventMgr::Drain(bool budgeted)
 	{
 	if ( event_queue_flush_point )
 		QueueEventFast(event_queue_flush_point, val_list{});
@@ -137,7 +154,9 @@ void EventMgr::Drain()
 	// just one round to make it less likley to break existing scripts
 	// that expect the old behavior to trigger something quickly.
 
-	for ( int round = 0; head && round < 2; round++ )
+	bool out_of_budget = false;
+
+	for ( int round = 0; head && round < 2 && ! out_of_budget; round++ )
 		{
 		Event* current = head;
 		head = 0;
@@ -145,6 +164,25 @@ void EventMgr::Drain()
 
 		while ( current )
 			{
+			if ( budgeted && net_work_budget_exceeded() )
+				{
+				// Put the rest back ahead of whatever the
+				// handlers have queued meanwhile.
+				Event* last = current;
+
+				while ( last->NextEvent() )
+					last = last->NextEvent();
+
+				last->SetNext(head);
+				head = current;
+
+				if ( ! tail )
+					tail = last;
+
+				out_of_budget = true;
+				break;
+				}
+
 			Event* next = current->NextEvent();
 
 			current_src = current->Source();
@@ -158,6 +196,12 @@ void EventMgr::Drain()
 			}
 		}
 
+	// Hand what's left to batch handlers. Any events they raise wait
+	// for the next time we drain, just like ones raised in the last
+	// round above. If we're out of budget, they get the next chance.
+	if ( ! out_of_budget )
+		EventHandler::FlushAllBatches();
+
 	// Note: we might eventually need a general way to specify things to
 	// do after draining events.
 	draining = false;
@@ -4,6 +4,7 @@
 #define event_h
 
 #include "EventRegistry.h"
+#include "IntrusivePtr.h"
 
 #include "analyzer/Tag.h"
 #include "analyzer/Analyzer.h"
@@ -103,6 +104,28 @@ public:
 		delete vl;
 		}
 
+	// Same as QueueEvent, for events that script code raises. An
+	// event_recorder doesn't record these, as the scripts raise them
+	// again when run over a replay of the others.
+	void QueueScriptEvent(const EventHandlerPtr &h, val_list vl,
+			TimerMgr* mgr = 0);
+
+	// Queues a local event if there's an event handler (or remote
+	// consumer), taking over the references to its arguments. Unlike
+	// with QueueEvent(), that's visible in the argument types, and there
+	// is nothing to clean up when there's no handler: the arguments just
+	// go out of scope.
+	template <class... Args>
+	void Enqueue(const EventHandlerPtr& h, IntrusivePtr<Args>... args)
+		{
+		if ( ! h )
+			return;
+
+		val_list vl(sizeof...(args));
+		(vl.push_back(args.release()), ...);
+		QueueEvent(new Event(h, std::move(vl)));
+		}
+
 	void Dispatch(Event* event, bool no_remote = false)
 		{
 		current_src = event->Source();
@@ -110,7 +133,9 @@ public:
 		Unref(event);
 		}
 
-	void Drain();
+	// Dispatches the queued events. If budgeted, stops once the main
+	// loop's work budget is used up, keeping the rest queued in order.
+	void Drain(bool budgeted = false);
 	bool IsDraining() const	{ return draining; }
 
 	int HasEvents() const	{ return head != 0; }
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "Event.h"
 #include "EventHandler.h"
 #include "Func.h"
@@ -18,8 +20,16 @@ EventHandler::EventHandler(const char* arg_name)
 	generate_always = false;
 	}
 
+std::vector<EventHandler*> EventHandler::batching_handlers;
+
 EventHandler::~EventHandler()
 	{
+	for ( auto& b : batches )
+		{
+		Unref(b.func);
+		Unref(b.pending);
+		}
+
 	Unref(local);
 	delete [] name;
 	}
@@ -27,6 +37,7 @@ EventHandler::~EventHandler()
 EventHandler::operator bool() const
 	{
 	return enabled && ((local && local->HasBodies())
+			   || ! batches.empty()
 			   || generate_always
 			   || ! auto_publish.empty());
 	}
@@ -77,10 +88,11 @@ void EventHandler::Call(val_list* vl, bool no_remote)
 			broker::vector xs;
 			xs.reserve(vl->length());
 			bool valid_args = true;
+			bool compact = broker_mgr->CompactEventRecords();
 
 			for ( auto i = 0; i < vl->length(); ++i )
 				{
-				auto opt_data = bro_broker::val_to_data((*vl)[i]);
+				auto opt_data = bro_broker::val_to_data((*vl)[i], compact);
 
 				if ( opt_data )
 					xs.emplace_back(move(*opt_data));
@@ -101,10 +113,10 @@ void EventHandler::Call(val_list* vl, bool no_remote)
 					++it;
 
 					if ( it != auto_publish.end() )
-						broker_mgr->PublishEvent(topic, Name(), xs);
+						broker_mgr->PublishBatchedEvent(topic, Name(), xs);
 					else
 						{
-						broker_mgr->PublishEvent(topic, Name(), std::move(xs));
+						broker_mgr->PublishBatchedEvent(topic, Name(), std::move(xs));
 						break;
 						}
 					}
@@ -112,6 +124,9 @@ void EventHandler::Call(val_list* vl, bool no_remote)
 			}
 		}
 
+	if ( ! batches.empty() )
+		AddToBatches(vl);
+
 	if ( local )
 		// No try/catch here; we pass exceptions upstream.
 		Unref(local->Call(vl));
@@ -122,6 +137,66 @@ void EventHandler::Call(val_list* vl, bool no_remote)
 		}
 	}
 
+void EventHandler::AddBatchHandler(Func* f, int size)
+	{
+	if ( batches.empty() )
+		batching_handlers.push_back(this);
+
+	VectorType* vt = f->FType()->Args()->FieldType(0)->AsVectorType();
+
+	Ref(f);
+	batches.push_back({f, size, vt->YieldType()->AsRecordType(), vt, 0});
+	}
+
+void EventHandler::AddToBatches(const val_list* vl)
+	{
+	for ( auto& b : batches )
+		{
+		RecordVal* r = new RecordVal(b.record_type);
+		int n = std::min(vl->length(), b.record_type->NumFields());
+
+		for ( int i = 0; i < n; ++i )
+			{
+			Val* v = (*vl)[i];
+			Ref(v);
+			r->Assign(i, v);
+			}
+
+		if ( ! b.pending )
+			b.pending = new VectorVal(b.vector_type);
+
+		b.pending->Assign(b.pending->Size(), r);
+
+		if ( int(b.pending->Size()) >= b.size )
+			FlushBatch(&b);
+		}
+	}
+
+void EventHandler::FlushBatch(Batch* b)
+	{
+	if ( ! b->pending )
+		return;
+
+	// The handler takes over the batch, and may cause further events
+	// getting added while it runs.
+	val_list args{b->pending};
+	b->pending = 0;
+
+	Unref(b->func->Call(&args));
+	}
+
+void EventHandler::FlushBatches()
+	{
+	for ( size_t i = 0; i < batches.size(); ++i )
+		FlushBatch(&batches[i]);
+	}
+
+void EventHandler::FlushAllBatches()
+	{
+	for ( const auto& h : batching_handlers )
+		h->FlushBatches();
+	}
+
 void EventHandler::NewEvent(val_list* vl)
 	{
 	if ( ! new_event )
@@ -6,11 +6,15 @@
 #include <assert.h>
 #include <unordered_set>
 #include <string>
+#include <vector>
 #include "List.h"
 #include "BroList.h"
 
 class Func;
 class FuncType;
+class RecordType;
+class VectorType;
+class VectorVal;
 
 class EventHandler {
 public:
@@ -35,6 +39,18 @@ public:
 
 	void Call(val_list* vl, bool no_remote = false);
 
+	// Adds a handler body declared with &batch. Instead of individual
+	// events, it receives a vector of records holding the arguments of
+	// the given number of events, or of however many have accumulated
+	// by the end of draining the event queue.
+	void AddBatchHandler(Func* f, int size);
+
+	// Passes the events accumulated so far to each batch handler.
+	void FlushBatches();
+
+	// Calls FlushBatches() on all event handlers having batch handlers.
+	static void FlushAllBatches();
+
 	// Returns true if there is at least one local or remote handler.
 	explicit operator  bool() const;
 
@@ -65,6 +81,22 @@ private:
 	bool generate_always;
 
 	std::unordered_set<std::string> auto_publish;
+
+	struct Batch {
+		Func* func;
+		int size;
+		RecordType* record_type;
+		VectorType* vector_type;
+		VectorVal* pending;	// nil if empty
+	};
+
+	void AddToBatches(const val_list* vl);
+	void FlushBatch(Batch* b);
+
+	std::vector<Batch> batches;
+
+	// All the handlers having batch handlers.
+	static std::vector<EventHandler*> batching_handlers;
 };
 
 // Encapsulates a ptr to an event handler to overload the boolean operator.
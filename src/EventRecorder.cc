@@ -0,0 +1,387 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <caf/stream_serializer.hpp>
+#include <caf/stream_deserializer.hpp>
+#include <caf/streambuf.hpp>
+
+#include "EventRecorder.h"
+#include "Event.h"
+#include "Func.h"
+#include "Net.h"
+#include "NetVar.h"
+#include "Reporter.h"
+#include "DebugLogger.h"
+#include "broker/Data.h"
+
+#include "event.bif.h"
+
+// A recording starts with this, followed by one entry per event: its size
+// as a 32-bit number in network byte order and the serialized vector of
+// the event's name, network time and arguments.
+static const char RECORDING_MAGIC[8] = { 'Z', 'E', 'E', 'K', 'E', 'V', 'T', '1' };
+
+// The fields of a connection record that Connection::BuildConnVal() fills
+// in. Whatever scripts add after them, they add again during replay.
+static const int NUM_CORE_CONN_FIELDS = 11;
+static const int CONN_UID_FIELD = 7;
+
+EventRecorder* event_recorder = 0;
+
+static broker::expected<broker::data> conn_to_data(RecordVal* c)
+	{
+	broker::vector rval;
+	rval.reserve(NUM_CORE_CONN_FIELDS);
+
+	for ( int i = 0; i < NUM_CORE_CONN_FIELDS; ++i )
+		{
+		Val* v = c->Lookup(i);
+
+		if ( ! v )
+			{
+			rval.emplace_back(broker::nil);
+			continue;
+			}
+
+		auto item = bro_broker::val_to_data(v, true);
+
+		if ( ! item )
+			return broker::ec::invalid_data;
+
+		rval.emplace_back(std::move(*item));
+		}
+
+	return {std::move(rval)};
+	}
+
+EventRecorder::EventRecorder(const char* arg_path)
+	{
+	path = arg_path;
+	paused = 0;
+	num_recorded = 0;
+
+	file = fopen(path.c_str(), "w");
+
+	if ( ! file )
+		{
+		reporter->Error("cannot open event recording %s: %s", path.c_str(), strerror(errno));
+		return;
+		}
+
+	if ( fwrite(RECORDING_MAGIC, sizeof(RECORDING_MAGIC), 1, file) != 1 )
+		{
+		reporter->Error("cannot write event recording %s: %s", path.c_str(), strerror(errno));
+		fclose(file);
+		file = 0;
+		}
+	}
+
+EventRecorder::~EventRecorder()
+	{
+	if ( file && fclose(file) != 0 )
+		reporter->Error("cannot write event recording %s: %s", path.c_str(), strerror(errno));
+
+	DBG_LOG(DBG_MAINLOOP, "recorded %" PRIu64 " events to %s", num_recorded, path.c_str());
+	}
+
+void EventRecorder::Record(const Event* event)
+	{
+	// Events raised from within script functions get raised again when
+	// the scripts run over the replay.
+	if ( ! file || paused || ! call_stack.empty() )
+		return;
+
+	const char* name = event->Handler()->Name();
+	broker::vector args;
+	args.reserve(event->Args()->length());
+
+	for ( const auto& a : *event->Args() )
+		{
+		auto data = a->Type() == connection_type ?
+			conn_to_data(a->AsRecordVal()) :
+			bro_broker::val_to_data(a, true);
+
+		if ( ! data )
+			{
+			if ( unrecordable.insert(name).second )
+				reporter->Warning("cannot record event %s: unsupported argument type %s",
+						  name, type_name(a->Type()->Tag()));
+			return;
+			}
+
+		args.emplace_back(std::move(*data));
+		}
+
+	std::vector<char> buf(sizeof(uint32));
+	caf::vectorbuf sb{buf};
+	caf::stream_serializer<caf::vectorbuf&> sink{sb};
+	broker::data entry{broker::vector{std::string(name), network_time, std::move(args)}};
+
+	if ( auto err = sink(entry) )
+		{
+		reporter->Error("cannot serialize event %s for recording", name);
+		return;
+		}
+
+	uint32 len = htonl(buf.size() - sizeof(uint32));
+	memcpy(buf.data(), &len, sizeof(len));
+
+	if ( fwrite(buf.data(), 1, buf.size(), file) != buf.size() )
+		{
+		reporter->Error("cannot write event recording %s: %s", path.c_str(), strerror(errno));
+		fclose(file);
+		file = 0;
+		return;
+		}
+
+	++num_recorded;
+	}
+
+EventReplayer::EventReplayer(const char* arg_path)
+	{
+	path = arg_path;
+	data = 0;
+	size = offset = 0;
+	have_pending = false;
+	pending_time = 0.0;
+	num_replayed = 0;
+
+	int fd = open(path.c_str(), O_RDONLY);
+	struct stat st;
+
+	if ( fd < 0 || fstat(fd, &st) < 0 )
+		{
+		reporter->Error("cannot open event recording %s: %s", path.c_str(), strerror(errno));
+
+		if ( fd >= 0 )
+			close(fd);
+
+		SetClosed(true);
+		return;
+		}
+
+	if ( size_t(st.st_size) < sizeof(RECORDING_MAGIC) )
+		{
+		reporter->Error("%s is not an event recording", path.c_str());
+		close(fd);
+		SetClosed(true);
+		return;
+		}
+
+	void* m = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if ( m == MAP_FAILED )
+		{
+		reporter->Error("cannot map event recording %s: %s", path.c_str(), strerror(errno));
+		SetClosed(true);
+		return;
+		}
+
+	data = static_cast<const char*>(m);
+	size = st.st_size;
+
+	if ( memcmp(data, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) != 0 )
+		{
+		reporter->Error("%s is not an event recording", path.c_str());
+		SetClosed(true);
+		return;
+		}
+
+	offset = sizeof(RECORDING_MAGIC);
+	madvise(m, size, MADV_SEQUENTIAL);
+	}
+
+EventReplayer::~EventReplayer()
+	{
+	if ( data )
+		munmap(const_cast<char*>(data), size);
+
+	for ( const auto& c : conns )
+		Unref(c.second);
+
+	DBG_LOG(DBG_MAINLOOP, "replayed %" PRIu64 " events from %s", num_replayed, path.c_str());
+	}
+
+bool EventReplayer::DecodeNext()
+	{
+	if ( offset == size )
+		return false;
+
+	uint32 len;
+
+	if ( size - offset < sizeof(len) )
+		{
+		reporter->Error("event recording %s is truncated", path.c_str());
+		return false;
+		}
+
+	memcpy(&len, data + offset, sizeof(len));
+	len = ntohl(len);
+	offset += sizeof(len);
+
+	if ( size - offset < len )
+		{
+		reporter->Error("event recording %s is truncated", path.c_str());
+		return false;
+		}
+
+	caf::arraybuf<char> ab{const_cast<char*>(data) + offset, len};
+	caf::stream_deserializer<caf::arraybuf<char>&> source{ab};
+	broker::data entry;
+	offset += len;
+
+	auto v = source(entry) ? nullptr : caf::get_if<broker::vector>(&entry);
+	auto name = v && v->size() == 3 ? caf::get_if<std::string>(&(*v)[0]) : nullptr;
+	auto t = name ? caf::get_if<double>(&(*v)[1]) : nullptr;
+	auto args = t ? caf::get_if<broker::vector>(&(*v)[2]) : nullptr;
+
+	if ( ! args )
+		{
+		reporter->Error("cannot decode event recording %s", path.c_str());
+		return false;
+		}
+
+	pending_name = std::move(*name);
+	pending_time = *t;
+	pending_args = std::move(*args);
+	have_pending = true;
+	return true;
+	}
+
+RecordVal* EventReplayer::SharedConn(RecordVal* c)
+	{
+	Val* uid = c->Lookup(CONN_UID_FIELD);
+
+	if ( ! uid )
+		return c;
+
+	auto it = conns.find(uid->AsString()->CheckString());
+
+	if ( it == conns.end() )
+		{
+		Ref(c);
+		conns.emplace(uid->AsString()->CheckString(), c);
+		return c;
+		}
+
+	// Update the core's fields in place, like Connection::BuildConnVal()
+	// does, so that scripts find their own where they left them.
+	RecordVal* shared = it->second;
+
+	for ( int i = 0; i < NUM_CORE_CONN_FIELDS; ++i )
+		{
+		Val* v = c->Lookup(i);
+		shared->Assign(i, v ? v->Ref() : nullptr);
+		}
+
+	Unref(c);
+	Ref(shared);
+	return shared;
+	}
+
+double EventReplayer::NextTimestamp(double* local_network_time)
+	{
+	if ( ! have_pending && ! DecodeNext() )
+		{
+		SetClosed(true);
+		return -1.0;
+		}
+
+	return pending_time;
+	}
+
+void EventReplayer::Process()
+	{
+	if ( ! have_pending )
+		return;
+
+	have_pending = false;
+
+	if ( ! bro_start_network_time )
+		bro_start_network_time = pending_time;
+
+	// Network time never goes back.
+	if ( pending_time > network_time )
+		net_update_time(pending_time);
+
+	expire_timers();
+
+	EventHandlerPtr handler = event_registry->Lookup(pending_name.c_str());
+
+	if ( ! handler )
+		return;
+
+	auto arg_types = handler->FType(false)->ArgTypes()->Types();
+
+	if ( static_cast<size_t>(arg_types->length()) != pending_args.size() )
+		{
+		reporter->Warning("cannot replay event %s: got %zu arguments, expected %d",
+				  pending_name.c_str(), pending_args.size(),
+				  arg_types->length());
+		return;
+		}
+
+	val_list vl(pending_args.size());
+	RecordVal* removed_conn = 0;
+
+	for ( auto i = 0u; i < pending_args.size(); ++i )
+		{
+		bool is_conn = (*arg_types)[i] == connection_type;
+
+		// Only the core's fields got recorded.
+		auto rv = is_conn ? caf::get_if<broker::vector>(&pending_args[i]) : nullptr;
+
+		if ( rv && rv->size() < static_cast<size_t>(connection_type->NumFields()) )
+			rv->resize(connection_type->NumFields());
+
+		Val* val = bro_broker::data_to_val(std::move(pending_args[i]), (*arg_types)[i]);
+
+		if ( ! val )
+			{
+			reporter->Warning("cannot replay event %s: argument #%u doesn't convert to %s",
+					  pending_name.c_str(), i,
+					  type_name((*arg_types)[i]->Tag()));
+
+			for ( const auto& v : vl )
+				Unref(v);
+
+			return;
+			}
+
+		if ( is_conn )
+			{
+			val = SharedConn(val->AsRecordVal());
+
+			if ( handler == connection_state_remove )
+				removed_conn = val->AsRecordVal();
+			}
+
+		vl.push_back(val);
+		}
+
+	mgr.QueueEventFast(handler, std::move(vl));
+	++num_replayed;
+
+	if ( removed_conn )
+		{
+		// The queued event holds on to the record as long as needed.
+		Val* uid = removed_conn->Lookup(CONN_UID_FIELD);
+		auto it = uid ? conns.find(uid->AsString()->CheckString()) : conns.end();
+
+		if ( it != conns.end() )
+			{
+			Unref(it->second);
+			conns.erase(it);
+			}
+		}
+	}
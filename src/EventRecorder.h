@@ -0,0 +1,99 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef eventrecorder_h
+#define eventrecorder_h
+
+// Recording of the events that the core raises, and replaying them, so that
+// scripts can be run over the same input without redoing protocol analysis.
+// With event_record_file set, each event queued once zeek_init() has been
+// processed gets appended to the file with the current network time and its
+// arguments converted to Broker data, unless script code raised it: replaying
+// the others makes the scripts raise those again. Connection records keep
+// only the fields the core fills in. With event_replay_file set, an
+// EventReplayer takes the place of the packet sources and raises the
+// recorded events in turn, as fast as the scripts handle them, passing the
+// same record for all events of a connection.
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <broker/data.hh>
+
+#include "iosource/IOSource.h"
+
+class Event;
+class RecordVal;
+
+class EventRecorder {
+public:
+	// Opens the file to record into, reporting an error if that fails.
+	EventRecorder(const char* path);
+	~EventRecorder();
+
+	bool IsOpen() const	{ return file != 0; }
+
+	// Appends the event to the file if it's one to record.
+	void Record(const Event* event);
+
+	// While paused, events are raised by script code and not recorded.
+	void Pause()	{ ++paused; }
+	void Resume()	{ --paused; }
+
+	uint64 NumRecorded() const	{ return num_recorded; }
+
+private:
+	std::string path;
+	FILE* file;
+	int paused;
+	uint64 num_recorded;
+
+	// Events we've already warned about not being able to record.
+	std::set<std::string> unrecordable;
+};
+
+class EventReplayer : public iosource::IOSource {
+public:
+	// Maps the file to replay, reporting an error if that fails.
+	EventReplayer(const char* path);
+	~EventReplayer() override;
+
+	void GetFds(iosource::FD_Set* read, iosource::FD_Set* write,
+		    iosource::FD_Set* except) override	{ }
+	double NextTimestamp(double* local_network_time) override;
+	void Process() override;
+	const char* Tag() override	{ return "EventReplayer"; }
+
+	uint64 NumReplayed() const	{ return num_replayed; }
+
+private:
+	// Decodes the next event into the pending_* members. Returns false
+	// at the end of the file or if it's corrupt.
+	bool DecodeNext();
+
+	// Returns the record that stands for the connection that c describes
+	// across all of its events, updated with c's fields. Takes over the
+	// reference to c and returns a new one.
+	RecordVal* SharedConn(RecordVal* c);
+
+	std::string path;
+	const char* data;
+	size_t size;
+	size_t offset;
+
+	bool have_pending;
+	std::string pending_name;
+	double pending_time;
+	std::vector<broker::data> pending_args;
+
+	// The connection records handed to scripts, by uid, until their
+	// connection_state_remove.
+	std::map<std::string, RecordVal*> conns;
+
+	uint64 num_replayed;
+};
+
+extern EventRecorder* event_recorder;
+
+#endif
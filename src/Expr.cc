@@ -14,6 +14,7 @@
 #include "Traverse.h"
 #include "Trigger.h"
 #include "IPAddr.h"
+#include "IntrusivePtr.h"
 #include "digest.h"
 
 #include "broker/Data.h"
@@ -356,12 +357,12 @@ Val* UnaryExpr::Eval(Frame* f) const
 	if ( IsError() )
 		return 0;
 
-	Val* v = op->Eval(f);
+	IntrusivePtr<Val> v{AdoptRef{}, op->Eval(f)};
 
 	if ( ! v )
 		return 0;
 
-	if ( is_vector(v) && Tag() != EXPR_IS && Tag() != EXPR_CAST )
+	if ( is_vector(v.get()) && Tag() != EXPR_IS && Tag() != EXPR_CAST )
 		{
 		VectorVal* v_op = v->AsVectorVal();
 		VectorType* out_t;
@@ -378,15 +379,10 @@ Val* UnaryExpr::Eval(Frame* f) const
 			result->Assign(i, v_i ? Fold(v_i) : 0);
 			}
 
-		Unref(v);
 		return result;
 		}
 	else
-		{
-		Val* result = Fold(v);
-		Unref(v);
-		return result;
-		}
+		return Fold(v.get());
 	}
 
 int UnaryExpr::IsPure() const
@@ -443,26 +439,166 @@ BinaryExpr::~BinaryExpr()
 	Unref(op2);
 	}
 
+template<typename T> static T internal_value(const Val* v);
+
+template<> bro_int_t internal_value(const Val* v)
+	{ return v->InternalInt(); }
+template<> bro_uint_t internal_value(const Val* v)
+	{ return v->InternalUnsigned(); }
+template<> double internal_value(const Val* v)
+	{ return v->InternalDouble(); }
+
+static Val* numeric_result(const BroType* t, double d)
+	{
+	if ( t->Tag() == TYPE_INTERVAL )
+		return new IntervalVal(d, 1.0);
+
+	return new Val(d, t->Tag());
+	}
+
+static Val* numeric_result(const BroType* t, bro_uint_t u)
+	{ return val_mgr->GetCount(u); }
+
+static Val* numeric_result(const BroType* t, bro_int_t i)
+	{ return val_mgr->GetInt(i); }
+
+// The loop behind BinaryExpr::NumericVectorFold(). Scalar operands are
+// passed in as a nil vector and their value.
+template<typename T>
+static bool fold_numeric_vector(BroExprTag tag, const BroType* ret_type,
+				const VectorVal* vv1, T x1,
+				const VectorVal* vv2, T x2,
+				vector<Val*>& out)
+	{
+	for ( unsigned int i = 0; i < out.size(); ++i )
+		{
+		if ( vv1 )
+			{
+			Val* e = vv1->Lookup(i);
+			if ( ! e )
+				continue;
+
+			x1 = internal_value<T>(e);
+			}
+
+		if ( vv2 )
+			{
+			Val* e = vv2->Lookup(i);
+			if ( ! e )
+				continue;
+
+			x2 = internal_value<T>(e);
+			}
+
+		Val* r;
+
+		switch ( tag ) {
+		case EXPR_ADD:	r = numeric_result(ret_type, T(x1 + x2)); break;
+		case EXPR_SUB:	r = numeric_result(ret_type, T(x1 - x2)); break;
+		case EXPR_TIMES:	r = numeric_result(ret_type, T(x1 * x2)); break;
+		case EXPR_DIVIDE:
+			if ( x2 == 0 )
+				return false;
+
+			r = numeric_result(ret_type, T(x1 / x2));
+			break;
+
+		case EXPR_LT:	r = val_mgr->GetBool(x1 < x2); break;
+		case EXPR_LE:	r = val_mgr->GetBool(x1 <= x2); break;
+		case EXPR_EQ:	r = val_mgr->GetBool(x1 == x2); break;
+		case EXPR_NE:	r = val_mgr->GetBool(x1 != x2); break;
+		case EXPR_GE:	r = val_mgr->GetBool(x1 >= x2); break;
+		case EXPR_GT:	r = val_mgr->GetBool(x1 > x2); break;
+
+		default:
+			return false;
+		}
+
+		out[i] = r;
+		}
+
+	return true;
+	}
+
+VectorVal* BinaryExpr::NumericVectorFold(Val* v1, Val* v2) const
+	{
+	switch ( tag ) {
+	case EXPR_ADD:
+	case EXPR_SUB:
+	case EXPR_TIMES:
+	case EXPR_DIVIDE:
+	case EXPR_LT:
+	case EXPR_LE:
+	case EXPR_EQ:
+	case EXPR_NE:
+	case EXPR_GE:
+	case EXPR_GT:
+		break;
+
+	default:
+		return 0;
+	}
+
+	const VectorVal* vv1 = is_vector(v1) ? v1->AsVectorVal() : 0;
+	const VectorVal* vv2 = is_vector(v2) ? v2->AsVectorVal() : 0;
+	const BroType* t1 = vv1 ? vv1->Type()->YieldType() : v1->Type();
+	const BroType* t2 = vv2 ? vv2->Type()->YieldType() : v2->Type();
+
+	if ( ! t1 || ! t2 )
+		return 0;
+
+	InternalTypeTag it = t1->InternalType();
+
+	if ( it != t2->InternalType() )
+		return 0;
+
+	if ( it != TYPE_INTERNAL_INT && it != TYPE_INTERNAL_UNSIGNED &&
+	     it != TYPE_INTERNAL_DOUBLE )
+		return 0;
+
+	VectorVal* result = new VectorVal(Type()->AsVectorType());
+	result->Resize(vv1 ? vv1->Size() : vv2->Size());
+	vector<Val*>& out = *result->AsVector();
+	const BroType* ret_type = Type()->YieldType();
+	bool ok;
+
+	if ( it == TYPE_INTERNAL_INT )
+		ok = fold_numeric_vector<bro_int_t>(tag, ret_type,
+			vv1, vv1 ? 0 : v1->InternalInt(),
+			vv2, vv2 ? 0 : v2->InternalInt(), out);
+	else if ( it == TYPE_INTERNAL_UNSIGNED )
+		ok = fold_numeric_vector<bro_uint_t>(tag, ret_type,
+			vv1, vv1 ? 0 : v1->InternalUnsigned(),
+			vv2, vv2 ? 0 : v2->InternalUnsigned(), out);
+	else
+		ok = fold_numeric_vector<double>(tag, ret_type,
+			vv1, vv1 ? 0 : v1->InternalDouble(),
+			vv2, vv2 ? 0 : v2->InternalDouble(), out);
+
+	if ( ! ok )
+		{
+		Unref(result);
+		return 0;
+		}
+
+	return result;
+	}
+
 Val* BinaryExpr::Eval(Frame* f) const
 	{
 	if ( IsError() )
 		return 0;
 
-	Val* v1 = op1->Eval(f);
+	IntrusivePtr<Val> v1{AdoptRef{}, op1->Eval(f)};
 	if ( ! v1 )
 		return 0;
 
-	Val* v2 = op2->Eval(f);
+	IntrusivePtr<Val> v2{AdoptRef{}, op2->Eval(f)};
 	if ( ! v2 )
-		{
-		Unref(v1);
 		return 0;
-		}
 
-	Val* result = 0;
-
-	int is_vec1 = is_vector(v1);
-	int is_vec2 = is_vector(v2);
+	int is_vec1 = is_vector(v1.get());
+	int is_vec2 = is_vector(v2.get());
 
 	if ( is_vec1 && is_vec2 )
 		{ // fold pairs of elements
@@ -475,7 +611,12 @@ Val* BinaryExpr::Eval(Frame* f) const
 			return 0;
 			}
 
-		VectorVal* v_result = new VectorVal(Type()->AsVectorType());
+		VectorVal* v_result = NumericVectorFold(v1.get(), v2.get());
+
+		if ( v_result )
+			return v_result;
+
+		v_result = new VectorVal(Type()->AsVectorType());
 
 		for ( unsigned int i = 0; i < v_op1->Size(); ++i )
 			{
@@ -488,15 +629,18 @@ Val* BinaryExpr::Eval(Frame* f) const
 			// SetError("undefined element in vector operation");
 			}
 
-		Unref(v1);
-		Unref(v2);
 		return v_result;
 		}
 
 	if ( IsVector(Type()->Tag()) && (is_vec1 || is_vec2) )
 		{ // fold vector against scalar
 		VectorVal* vv = (is_vec1 ? v1 : v2)->AsVectorVal();
-		VectorVal* v_result = new VectorVal(Type()->AsVectorType());
+		VectorVal* v_result = NumericVectorFold(v1.get(), v2.get());
+
+		if ( v_result )
+			return v_result;
+
+		v_result = new VectorVal(Type()->AsVectorType());
 
 		for ( unsigned int i = 0; i < vv->Size(); ++i )
 			{
@@ -504,24 +648,18 @@ Val* BinaryExpr::Eval(Frame* f) const
 			if ( vv_i )
 				v_result->Assign(i,
 					 is_vec1 ?
-						 Fold(vv_i, v2) : Fold(v1, vv_i));
+						 Fold(vv_i, v2.get()) : Fold(v1.get(), vv_i));
 			else
 				v_result->Assign(i, 0);
 
 			// SetError("Undefined element in vector operation");
 			}
 
-		Unref(v1);
-		Unref(v2);
 		return v_result;
 		}
 
 	// scalar op scalar
-	result = Fold(v1, v2);
-
-	Unref(v1);
-	Unref(v2);
-	return result;
+	return Fold(v1.get(), v2.get());
 	}
 
 int BinaryExpr::IsPure() const
@@ -967,6 +1105,66 @@ IncrExpr::IncrExpr(BroExprTag arg_tag, Expr* arg_op)
 		}
 	}
 
+// Returns the value of the local that the lvalue e refers to, if the
+// frame holds the only reference to it; see Frame::UnsharedElement().
+static Val* unshared_local(const Expr* e, Frame* f)
+	{
+	if ( ! f )
+		return 0;
+
+	if ( e->Tag() == EXPR_REF )
+		e = static_cast<const RefExpr*>(e)->Op();
+
+	if ( e->Tag() != EXPR_NAME )
+		return 0;
+
+	const ID* id = e->AsNameExpr()->Id();
+
+	if ( id->IsGlobal() )
+		return 0;
+
+	return f->UnsharedElement(id);
+	}
+
+// Implements "v1 += v2" and "v1 -= v2" by modifying v1 in place. v1 has
+// to be unshared, see above. Returns false if the operands aren't suited.
+static bool fold_in_place(const BinaryExpr* e, Val* v1, const Val* v2)
+	{
+	InternalTypeTag it = v1->Type()->InternalType();
+
+	if ( v2->Type()->InternalType() != it ||
+	     e->Type()->Tag() != v1->Type()->Tag() )
+		return false;
+
+	bool add = e->Tag() == EXPR_ADD_TO;
+
+	switch ( it ) {
+	case TYPE_INTERNAL_INT:
+		{
+		bro_int_t i2 = v2->InternalInt();
+		v1->SetInternalInt(add ? v1->InternalInt() + i2 : v1->InternalInt() - i2);
+		return true;
+		}
+
+	case TYPE_INTERNAL_UNSIGNED:
+		{
+		bro_uint_t u2 = v2->InternalUnsigned();
+		v1->SetInternalUnsigned(add ? v1->InternalUnsigned() + u2 : v1->InternalUnsigned() - u2);
+		return true;
+		}
+
+	case TYPE_INTERNAL_DOUBLE:
+		{
+		double d2 = v2->InternalDouble();
+		v1->SetInternalDouble(add ? v1->InternalDouble() + d2 : v1->InternalDouble() - d2);
+		return true;
+		}
+
+	default:
+		return false;
+	}
+	}
+
 Val* IncrExpr::DoSingleEval(Frame* f, Val* v) const
 	 {
 	bro_int_t k = v->CoerceToInt();
@@ -995,6 +1193,28 @@ Val* IncrExpr::DoSingleEval(Frame* f, Val* v) const
 
 Val* IncrExpr::Eval(Frame* f) const
 	{
+	// Counters kept in locals get updated without allocating.
+	Val* local = unshared_local(op, f);
+
+	if ( local && local->Type()->InternalType() == TYPE_INTERNAL_INT )
+		{
+		local->SetInternalInt(local->InternalInt() + (Tag() == EXPR_INCR ? 1 : -1));
+		return local->Ref();
+		}
+
+	if ( local && local->Type()->InternalType() == TYPE_INTERNAL_UNSIGNED )
+		{
+		bro_int_t k = local->InternalUnsigned();
+
+		if ( Tag() == EXPR_INCR )
+			++k;
+		else if ( --k < 0 )
+			RuntimeError("count underflow");
+
+		local->SetInternalUnsigned(k);
+		return local->Ref();
+		}
+
 	Val* v = op->Eval(f);
 	if ( ! v )
 		return 0;
@@ -1264,15 +1484,46 @@ AddToExpr::AddToExpr(Expr* arg_op1, Expr* arg_op2)
 
 Val* AddToExpr::Eval(Frame* f) const
 	{
-	Val* v1 = op1->Eval(f);
-	if ( ! v1 )
-		return 0;
+	Val* v1;
+	Val* v2;
 
-	Val* v2 = op2->Eval(f);
-	if ( ! v2 )
+	if ( unshared_local(op1, f) )
 		{
-		Unref(v1);
-		return 0;
+		// Evaluating op2 first is fine as evaluating a local has
+		// no side effects. It may however change the local or take
+		// a reference to it, so look again afterwards.
+		v2 = op2->Eval(f);
+		if ( ! v2 )
+			return 0;
+
+		v1 = unshared_local(op1, f);
+
+		if ( v1 && fold_in_place(this, v1, v2) )
+			{
+			Unref(v2);
+			return v1->Ref();
+			}
+
+		v1 = op1->Eval(f);
+		if ( ! v1 )
+			{
+			Unref(v2);
+			return 0;
+			}
+		}
+
+	else
+		{
+		v1 = op1->Eval(f);
+		if ( ! v1 )
+			return 0;
+
+		v2 = op2->Eval(f);
+		if ( ! v2 )
+			{
+			Unref(v1);
+			return 0;
+			}
 		}
 
 	if ( is_vector(v1) )
@@ -1366,15 +1617,46 @@ RemoveFromExpr::RemoveFromExpr(Expr* arg_op1, Expr* arg_op2)
 
 Val* RemoveFromExpr::Eval(Frame* f) const
 	{
-	Val* v1 = op1->Eval(f);
-	if ( ! v1 )
-		return 0;
+	Val* v1;
+	Val* v2;
 
-	Val* v2 = op2->Eval(f);
-	if ( ! v2 )
+	if ( unshared_local(op1, f) )
 		{
-		Unref(v1);
-		return 0;
+		// Evaluating op2 first is fine as evaluating a local has
+		// no side effects. It may however change the local or take
+		// a reference to it, so look again afterwards.
+		v2 = op2->Eval(f);
+		if ( ! v2 )
+			return 0;
+
+		v1 = unshared_local(op1, f);
+
+		if ( v1 && fold_in_place(this, v1, v2) )
+			{
+			Unref(v2);
+			return v1->Ref();
+			}
+
+		v1 = op1->Eval(f);
+		if ( ! v1 )
+			{
+			Unref(v2);
+			return 0;
+			}
+		}
+
+	else
+		{
+		v1 = op1->Eval(f);
+		if ( ! v1 )
+			return 0;
+
+		v2 = op2->Eval(f);
+		if ( ! v2 )
+			{
+			Unref(v1);
+			return 0;
+			}
 		}
 
 	Val* result = Fold(v1, v2);
@@ -2535,7 +2817,17 @@ int IndexExpr::CanDel() const
 	if ( IsError() )
 		return 1;	// avoid cascading the error report
 
-	return op1->Type()->Tag() == TYPE_TABLE;
+	if ( op1->Type()->Tag() != TYPE_TABLE )
+		return 0;
+
+	// Looking up a table of patterns by string doesn't name an element.
+	const expr_list& index = op2->AsListExpr()->Exprs();
+
+	if ( op1->Type()->AsTableType()->IsPatternIndex() &&
+	     index.length() == 1 && index[0]->Type()->Tag() == TYPE_STRING )
+		return 0;
+
+	return 1;
 	}
 
 void IndexExpr::Add(Frame* f)
@@ -2613,6 +2905,8 @@ Val* IndexExpr::Eval(Frame* f) const
 		VectorVal* v_result = new VectorVal(Type()->AsVectorType());
 		result = v_result;
 
+		Trigger::ValueRead(v_v1);
+
 		// Booleans select each element (or not).
 		if ( IsBool(v_v2->Type()->YieldType()->Tag()) )
 			{
@@ -2647,6 +2941,16 @@ Val* IndexExpr::Eval(Frame* f) const
 	return result;
 	}
 
+// Returns true if v2 holds a string to look up in the table of patterns v1.
+static bool match_pattern_table(const Val* v1, const Val* v2)
+	{
+	if ( ! v1->Type()->AsTableType()->IsPatternIndex() )
+		return false;
+
+	const ListVal* lv = v2->AsListVal();
+	return lv->Length() == 1 && lv->Index(0)->Type()->Tag() == TYPE_STRING;
+	}
+
 static int get_slice_index(int idx, int len)
 	{
 	if ( abs(idx) > len )
@@ -2670,6 +2974,8 @@ Val* IndexExpr::Fold(Val* v1, Val* v2) const
 		VectorVal* vect = v1->AsVectorVal();
 		const ListVal* lv = v2->AsListVal();
 
+		Trigger::ValueRead(vect);
+
 		if ( lv->Length() == 1 )
 			v = vect->Lookup(v2);
 		else
@@ -2695,6 +3001,13 @@ Val* IndexExpr::Fold(Val* v1, Val* v2) const
 		break;
 
 	case TYPE_TABLE:
+		if ( match_pattern_table(v1, v2) )
+			{
+			Trigger::ValueRead(v1);
+			return v1->AsTableVal()->LookupPattern(v2->AsListVal()->Index(0)->AsStringVal());
+			}
+
+		Trigger::TableRead(v1->AsTableVal(), v2);
 		v = v1->AsTableVal()->Lookup(v2); // Then, we jump into the TableVal here.
 		break;
 
@@ -2925,6 +3238,8 @@ void FieldExpr::Delete(Frame* f)
 
 Val* FieldExpr::Fold(Val* v) const
 	{
+	Trigger::FieldRead(v->AsRecordVal(), field);
+
 	Val* result = v->AsRecordVal()->Lookup(field);
 	if ( result )
 		return result->Ref();
@@ -2994,6 +3309,8 @@ Val* HasFieldExpr::Fold(Val* v) const
 	if ( ! rec_to_look_at )
 		return val_mgr->GetBool(0);
 
+	Trigger::FieldRead(rec_to_look_at, field);
+
 	RecordVal* r = rec_to_look_at->Ref()->AsRecordVal();
 	Val* ret = val_mgr->GetBool(r->Lookup(field) != 0);
 	Unref(r);
@@ -3909,7 +4226,7 @@ ScheduleTimer::~ScheduleTimer()
 
 void ScheduleTimer::Dispatch(double /* t */, int /* is_expire */)
 	{
-	mgr.QueueEvent(event, std::move(args), SOURCE_LOCAL, 0, tmgr);
+	mgr.QueueScriptEvent(event, std::move(args), tmgr);
 	}
 
 ScheduleExpr::ScheduleExpr(Expr* arg_when, EventExpr* arg_event)
@@ -4070,6 +4387,16 @@ InExpr::InExpr(Expr* arg_op1, Expr* arg_op2)
 				}
 			}
 
+		// Check for:	<string> in set[pattern]
+		//		<string> in table[pattern] of ...
+		if ( op1->Type()->Tag() == TYPE_STRING &&
+		     op2->Type()->Tag() == TYPE_TABLE &&
+		     op2->Type()->AsTableType()->IsPatternIndex() )
+			{
+			SetType(base_type(TYPE_BOOL));
+			return;
+			}
+
 		if ( op1->Tag() != EXPR_LIST )
 			op1 = new ListExpr(op1);
 
@@ -4107,12 +4434,25 @@ Val* InExpr::Fold(Val* v1, Val* v2) const
 	     v2->Type()->Tag() == TYPE_SUBNET )
 		return val_mgr->GetBool(v2->AsSubNetVal()->Contains(v1->AsAddr()));
 
+	if ( v1->Type()->Tag() == TYPE_STRING &&
+	     v2->Type()->Tag() == TYPE_TABLE )
+		{
+		Trigger::ValueRead(v2);
+		return val_mgr->GetBool(v2->AsTableVal()->MatchPattern(v1->AsStringVal()));
+		}
+
 	Val* res;
 
 	if ( is_vector(v2) )
+		{
+		Trigger::ValueRead(v2);
 		res = v2->AsVectorVal()->Lookup(v1);
+		}
 	else
+		{
+		Trigger::TableRead(v2->AsTableVal(), v1);
 		res = v2->AsTableVal()->Lookup(v1, false);
+		}
 
 	if ( res )
 		return val_mgr->GetBool(1);
@@ -4461,7 +4801,7 @@ Val* EventExpr::Eval(Frame* f) const
 		return 0;
 
 	val_list* v = eval_list(f, args);
-	mgr.QueueEvent(handler, std::move(*v));
+	mgr.QueueScriptEvent(handler, std::move(*v));
 	delete v;
 
 	return 0;
@@ -283,6 +283,9 @@ class UnaryExpr : public Expr {
 public:
 	Expr* Op() const	{ return op; }
 
+	// Replaces the operand, taking ownership of the new one.
+	void SetOp(Expr* arg_op)	{ Unref(op); op = arg_op; }
+
 	// UnaryExpr::Eval correctly handles vector types.  Any child
 	// class that overrides Eval() should be modified to handle
 	// vectors correctly as necessary.
@@ -312,6 +315,10 @@ public:
 	Expr* Op1() const	{ return op1; }
 	Expr* Op2() const	{ return op2; }
 
+	// Replace an operand, taking ownership of the new one.
+	void SetOp1(Expr* arg_op)	{ Unref(op1); op1 = arg_op; }
+	void SetOp2(Expr* arg_op)	{ Unref(op2); op2 = arg_op; }
+
 	int IsPure() const override;
 
 	// BinaryExpr::Eval correctly handles vector types.  Any child
@@ -351,6 +358,11 @@ protected:
 	virtual Val* AddrFold(Val* v1, Val* v2) const;
 	virtual Val* SubNetFold(Val* v1, Val* v2) const;
 
+	// Folds numeric vectors element by element, either operand possibly
+	// being a scalar applied to every element. Returns nil if that
+	// doesn't apply, or an element needs the error reporting of Fold().
+	VectorVal* NumericVectorFold(Val* v1, Val* v2) const;
+
 	int BothConst() const	{ return op1->IsConst() && op2->IsConst(); }
 
 	// Exchange op1 and op2.
@@ -571,6 +583,11 @@ public:
 	const Expr* Op2() const	{ return op2; }
 	const Expr* Op3() const	{ return op3; }
 
+	// Replace an operand, taking ownership of the new one.
+	void SetOp1(Expr* arg_op)	{ Unref(op1); op1 = arg_op; }
+	void SetOp2(Expr* arg_op)	{ Unref(op2); op2 = arg_op; }
+	void SetOp3(Expr* arg_op)	{ Unref(op3); op3 = arg_op; }
+
 	Val* Eval(Frame* f) const override;
 	int IsPure() const override;
 
@@ -964,6 +981,9 @@ public:
 	Val* Eval(Frame* f) const override;
 	TraversalCode Traverse(TraversalCallback* cb) const override;
 
+	// The IDs of enclosing functions that the lambda's body uses.
+	const id_list& OuterIDs() const	{ return outer_ids; }
+
 protected:
 	void ExprDescribe(ODesc* d) const override;
 
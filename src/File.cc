@@ -16,9 +16,15 @@
 #include <sys/resource.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <signal.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
 
 #include "File.h"
 #include "Type.h"
@@ -30,6 +36,163 @@
 
 std::list<std::pair<std::string, BroFile*>> BroFile::open_files;
 
+// Writes what a BroFile queues to its descriptor from a background thread.
+// The main thread appends to one buffer while the thread writes out the
+// other, so each write from the thread covers whatever accumulated in the
+// meantime.
+class AsyncFileWriter {
+public:
+	AsyncFileWriter(int fd, size_t max_pending);
+
+	// Writes out everything still queued and stops the thread.
+	~AsyncFileWriter();
+
+	// Queues data for writing, blocking while max_pending bytes are
+	// already waiting. Returns false, with errno set, if an earlier
+	// write has failed; the data is then discarded.
+	bool Write(const char* data, size_t len);
+
+	// Waits until everything queued has been written. Returns false,
+	// with errno set, if a write has failed.
+	bool Drain();
+
+private:
+	void Run();
+
+	int fd;
+	size_t max_pending;
+
+	std::string pending;
+	bool writing;	// whether the thread has a batch in progress
+	bool stopping;
+	int write_error;
+
+	std::mutex mutex;
+	std::condition_variable have_data;
+	std::condition_variable written;
+	std::thread thread;
+};
+
+AsyncFileWriter::AsyncFileWriter(int arg_fd, size_t arg_max_pending)
+	{
+	fd = arg_fd;
+	max_pending = std::max(arg_max_pending, static_cast<size_t>(4096));
+	writing = stopping = false;
+	write_error = 0;
+
+	thread = std::thread(&AsyncFileWriter::Run, this);
+	}
+
+AsyncFileWriter::~AsyncFileWriter()
+	{
+	std::unique_lock<std::mutex> lock(mutex);
+	stopping = true;
+	have_data.notify_one();
+	lock.unlock();
+
+	thread.join();
+	}
+
+bool AsyncFileWriter::Write(const char* data, size_t len)
+	{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	// Once the thread takes over a full buffer, ours is empty again, so
+	// even data larger than max_pending doesn't wait forever.
+	written.wait(lock, [&] {
+		return write_error || pending.empty() ||
+			pending.size() + len <= max_pending;
+		});
+
+	if ( write_error )
+		{
+		errno = write_error;
+		return false;
+		}
+
+	bool was_empty = pending.empty();
+	pending.append(data, len);
+
+	if ( was_empty )
+		have_data.notify_one();
+
+	return true;
+	}
+
+bool AsyncFileWriter::Drain()
+	{
+	std::unique_lock<std::mutex> lock(mutex);
+	written.wait(lock, [&] { return write_error || (pending.empty() && ! writing); });
+
+	if ( write_error )
+		{
+		errno = write_error;
+		return false;
+		}
+
+	return true;
+	}
+
+void AsyncFileWriter::Run()
+	{
+	// Block signals in thread. We handle signals only in the main
+	// process.
+	sigset_t mask_set;
+	sigfillset(&mask_set);
+	sigdelset(&mask_set, SIGFPE);
+	sigdelset(&mask_set, SIGILL);
+	sigdelset(&mask_set, SIGSEGV);
+	sigdelset(&mask_set, SIGBUS);
+	pthread_sigmask(SIG_BLOCK, &mask_set, 0);
+
+	std::string batch;
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while ( true )
+		{
+		have_data.wait(lock, [&] { return stopping || ! pending.empty(); });
+
+		if ( pending.empty() )
+			break;
+
+		batch.swap(pending);
+		writing = true;
+		bool failed = write_error != 0;
+		lock.unlock();
+
+		const char* p = batch.data();
+		size_t left = failed ? 0 : batch.size();
+		int err = 0;
+
+		while ( left )
+			{
+			ssize_t rc = write(fd, p, left);
+
+			if ( rc < 0 )
+				{
+				if ( errno == EINTR )
+					continue;
+
+				err = errno;
+				break;
+				}
+
+			p += rc;
+			left -= rc;
+			}
+
+		batch.clear();
+
+		lock.lock();
+		writing = false;
+
+		if ( err && ! write_error )
+			write_error = err;
+
+		written.notify_all();
+		}
+	}
+
 // Maximizes the number of open file descriptors.
 static void maximize_num_fds()
 	{
@@ -169,6 +332,7 @@ void BroFile::Init()
 	attrs = 0;
 	buffered = true;
 	raw_output = false;
+	async_writer = 0;
 	t = 0;
 
 #ifdef USE_PERFTOOLS_DEBUG
@@ -186,6 +350,9 @@ FILE* BroFile::Seek(long new_position)
 	if ( ! File() )
 		return 0;
 
+	if ( async_writer && ! async_writer->Drain() )
+		reporter->Error("error writing to %s: %s", Name(), strerror(errno));
+
 	if ( fseek(f, new_position, SEEK_SET) < 0 )
 		reporter->Error("seek failed");
 
@@ -215,6 +382,8 @@ int BroFile::Close()
 	if ( ! f )
 		return 0;
 
+	StopAsyncOutput();
+
 	fclose(f);
 	f = nullptr;
 	open_time = is_open = 0;
@@ -288,10 +457,17 @@ RecordVal* BroFile::Rotate()
 
 	Unlink();
 
+	bool async = async_writer != 0;
+	StopAsyncOutput();
+
  	fclose(f);
 	f = 0;
 
 	Open(newf);
+
+	if ( async )
+		EnableAsyncOutput();
+
 	return info;
 	}
 
@@ -313,6 +489,9 @@ int BroFile::Write(const char* data, int len)
 	if ( ! len )
 		len = strlen(data);
 
+	if ( async_writer )
+		return async_writer->Write(data, len);
+
 	if ( fwrite(data, len, 1, f) < 1 )
 		return false;
 
@@ -329,9 +508,59 @@ void BroFile::RaiseOpenEvent()
 	mgr.Dispatch(event, true);
 	}
 
-double BroFile::Size()
+void BroFile::Flush()
+	{
+	if ( async_writer && ! async_writer->Drain() )
+		reporter->Error("error writing to %s: %s", Name(), strerror(errno));
+
+	fflush(f);
+	}
+
+bool BroFile::EnableAsyncOutput()
 	{
+	if ( async_writer )
+		return true;
+
+	if ( ! is_open || ! f || f == stdin || f == stdout || f == stderr )
+		return false;
+
+	// Whatever stdio still buffers has to go out first.
 	fflush(f);
+	async_writer = new AsyncFileWriter(fileno(f), BifConst::async_file_buffer_size);
+	return true;
+	}
+
+bool BroFile::StopAsyncOutput()
+	{
+	if ( ! async_writer )
+		return true;
+
+	bool ok = async_writer->Drain();
+
+	if ( ! ok )
+		reporter->Error("error writing to %s: %s", Name(), strerror(errno));
+
+	delete async_writer;
+	async_writer = 0;
+	return ok;
+	}
+
+bool BroFile::FlushOpenFiles()
+	{
+	bool ok = true;
+
+	for ( const auto& el : open_files )
+		{
+		if ( el.second->async_writer && ! el.second->async_writer->Drain() )
+			ok = false;
+		}
+
+	return fflush(0) == 0 && ok;
+	}
+
+double BroFile::Size()
+	{
+	Flush();
 	struct stat s;
 	if ( fstat(fileno(f), &s) < 0 )
 		{
@@ -16,6 +16,7 @@
 # endif // NEED_KRB5_H
 
 class BroType;
+class AsyncFileWriter;
 
 class BroFile : public BroObj {
 public:
@@ -29,7 +30,7 @@ public:
 	// Returns false if an error occured.
 	int Write(const char* data, int len = 0);
 
-	void Flush()	{ fflush(f); }
+	void Flush();
 
 	FILE* Seek(long position);	// seek to absolute position
 
@@ -66,6 +67,17 @@ public:
 	void EnableRawOutput()		{ raw_output = true; }
 	bool IsRawOutput() const	{ return raw_output; }
 
+	// Hands writes over to a background thread, buffering up to
+	// async_file_buffer_size bytes, so that the main thread doesn't
+	// spend its time in system calls. Returns false if the file isn't
+	// open or is one of stdin/stdout/stderr.
+	bool EnableAsyncOutput();
+	bool IsAsyncOutput() const	{ return async_writer != 0; }
+
+	// Flushes all open files, waiting for asynchronous output to be
+	// written. Returns false if that failed for any of them.
+	static bool FlushOpenFiles();
+
 protected:
 	BroFile()	{ Init(); }
 	void Init();
@@ -87,6 +99,10 @@ protected:
 	// Raises a file_opened event.
 	void RaiseOpenEvent();
 
+	// Waits for the writer thread to write out everything queued, and
+	// stops it. Returns false if a write failed.
+	bool StopAsyncOutput();
+
 	FILE* f;
 	BroType* t;
 	char* name;
@@ -96,6 +112,7 @@ protected:
 	bool buffered;
 	double open_time;
 	bool raw_output;
+	AsyncFileWriter* async_writer;
 
 	static const int MIN_BUFFER_SIZE = 1024;
 
@@ -11,18 +11,11 @@
 #define MIN_ACCEPTABLE_FRAG_SIZE 64
 #define MAX_ACCEPTABLE_FRAG_SIZE 64000
 
-FragTimer::~FragTimer()
-	{
-	if ( f )
-		f->ClearTimer();
-	}
+IMPLEMENT_POOLED_ALLOC(FragReassembler, OTHER)
 
-void FragTimer::Dispatch(double t, int /* is_expire */)
+void FragSweepTimer::Dispatch(double t, int is_expire)
 	{
-	if ( f )
-		f->Expire(t);
-	else
-		reporter->InternalWarning("fragment timer dispatched w/o reassembler");
+	s->ExpireFragments(t, is_expire);
 	}
 
 FragReassembler::FragReassembler(NetSessions* arg_s,
@@ -52,13 +45,18 @@ FragReassembler::FragReassembler(NetSessions* arg_s,
 	frag_size = 0;	// flag meaning "not known"
 	next_proto = ip->NextProto();
 
+	// NetSessions has charged our own overhead before creating us.
+	src_addr = ip->SrcAddr();
+	charged = (BifConst::frag_source_quota ? padded_sizeof(*this) : 0);
+
+	prev_expire = next_expire = 0;
+	expire_time = 0;
+
 	if ( frag_timeout != 0.0 )
 		{
-		expire_timer = new FragTimer(this, t + frag_timeout);
-		timer_mgr->Add(expire_timer);
+		expire_time = t + frag_timeout;
+		s->ScheduleFragExpiration(this);
 		}
-	else
-		expire_timer = 0;
 
 	AddFragment(t, ip, pkt);
 	}
@@ -66,6 +64,7 @@ FragReassembler::FragReassembler(NetSessions* arg_s,
 FragReassembler::~FragReassembler()
 	{
 	DeleteTimer();
+	s->ReleaseFragQuota(src_addr, charged);
 	delete [] proto_hdr;
 	delete reassembled_pkt;
 	delete key;
@@ -152,6 +151,17 @@ void FragReassembler::AddFragment(double t, const IP_Hdr* ip, const u_char* pkt)
 	pkt += hdr_len;
 	len -= hdr_len;
 
+	if ( BifConst::frag_source_quota )
+		{
+		if ( ! s->ChargeFragQuota(src_addr, len) )
+			{
+			s->Weird("fragment_source_quota_exceeded", ip);
+			return;
+			}
+
+		charged += len;
+		}
+
 	NewBlock(network_time, offset, len, pkt);
 	}
 
@@ -307,18 +317,15 @@ void FragReassembler::Expire(double t)
 		blocks = b;
 		}
 
-	expire_timer->ClearReassembler();
-	expire_timer = 0;	// timer manager will delete it
-
+	DeleteTimer();
 	sessions->Remove(this);
 	}
 
 void FragReassembler::DeleteTimer()
 	{
-	if ( expire_timer )
+	if ( expire_time )
 		{
-		expire_timer->ClearReassembler();
-		timer_mgr->Cancel(expire_timer);
-		expire_timer = 0;	// timer manager will delete it
+		s->UnscheduleFragExpiration(this);
+		expire_time = 0;
 		}
 	}
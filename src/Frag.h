@@ -8,31 +8,36 @@
 #include "Net.h"
 #include "Reassem.h"
 #include "Timer.h"
+#include "ObjPool.h"
 
 class HashKey;
 class NetSessions;
 
-class FragReassembler;
-class FragTimer;
-
-typedef void (FragReassembler::*frag_timer_func)(double t);
-
 class FragReassembler : public Reassembler {
 public:
 	FragReassembler(NetSessions* s, const IP_Hdr* ip, const u_char* pkt,
 			HashKey* k, double t);
 	~FragReassembler() override;
 
+	DECLARE_POOLED_ALLOC()
+
 	void AddFragment(double t, const IP_Hdr* ip, const u_char* pkt);
 
 	void Expire(double t);
+
+	// Takes the reassembler off the expiration queue.
 	void DeleteTimer();
-	void ClearTimer()	{ expire_timer = 0; }
+
+	// Returns the time at which the reassembler expires, or 0 if it
+	// doesn't.
+	double ExpireTime() const	{ return expire_time; }
 
 	const IP_Hdr* ReassembledPkt()	{ return reassembled_pkt; }
 	HashKey* Key() const	{ return key; }
 
 protected:
+	friend class NetSessions;
+
 	void BlockInserted(DataBlock* start_block) override;
 	void Overlap(const u_char* b1, const u_char* b2, uint64 n) override;
 	void Weird(const char* name) const;
@@ -45,23 +50,31 @@ protected:
 	uint16 next_proto; // first IPv6 fragment header's next proto field
 	HashKey* key;
 
-	FragTimer* expire_timer;
+	// Source of the fragments, and how many bytes we have charged
+	// against its quota.
+	IPAddr src_addr;
+	uint64 charged;
+
+	// Reassemblers are queued for expiration in the order in which
+	// they were created, which, with a fixed timeout, is also the
+	// order in which they expire.
+	double expire_time;
+	FragReassembler* prev_expire;
+	FragReassembler* next_expire;
 };
 
-class FragTimer : public Timer {
+// Expires the fragment reassemblers that have timed out. There's at most one
+// of these pending at any time, no matter how many reassemblers there are.
+class FragSweepTimer : public Timer {
 public:
-	FragTimer(FragReassembler* arg_f, double arg_t)
+	FragSweepTimer(NetSessions* arg_s, double arg_t)
 		: Timer(arg_t, TIMER_FRAG)
-			{ f = arg_f; }
-	~FragTimer() override;
+			{ s = arg_s; }
 
 	void Dispatch(double t, int is_expire) override;
 
-	// Break the association between this timer and its creator.
-	void ClearReassembler()	{ f = 0; }
-
 protected:
-	FragReassembler* f;
+	NetSessions* s;
 };
 
 #endif
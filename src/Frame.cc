@@ -8,10 +8,12 @@
 
 vector<Frame*> g_frame_stack;
 
+IMPLEMENT_POOLED_ALLOC(Frame, OTHER)
+
 Frame::Frame(int arg_size, const BroFunc* func, const val_list* fn_args)
 	{
 	size = arg_size;
-	frame = new Val*[size];
+	frame = size <= INLINE_SLOTS ? inline_slots : new Val*[size];
 	function = func;
 	func_args = fn_args;
 
@@ -88,6 +90,27 @@ Val* Frame::GetElement(const ID* id) const
 	return frame[id->Offset()];
 	}
 
+Val* Frame::UnsharedElement(const ID* id) const
+	{
+	Val* v = GetElement(id);
+
+	if ( ! v || v->RefCnt() != 1 )
+		return nullptr;
+
+	switch ( v->Type()->Tag() ) {
+	case TYPE_INT:
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		return v;
+
+	default:
+		return nullptr;
+	}
+	}
+
 void Frame::Reset(int startIdx)
 	{
 	for ( int i = startIdx; i < size; ++i )
@@ -102,7 +125,8 @@ void Frame::Release()
 	for ( int i = 0; i < size; ++i )
 		Unref(frame[i]);
 
-	delete [] frame;
+	if ( frame != inline_slots )
+		delete [] frame;
 	}
 
 void Frame::Describe(ODesc* d) const
@@ -145,6 +169,38 @@ Frame* Frame::Clone() const
 	return other;
 	}
 
+Frame* Frame::CloneLocals(const id_list& locals) const
+	{
+	Frame* other = new Frame(size, function, func_args);
+	other->offset_map = offset_map;
+	other->CaptureClosure(closure, outer_ids);
+
+	other->call = call;
+	other->trigger = trigger;
+	if ( trigger )
+		Ref(trigger);
+
+	for ( const auto& id : locals )
+		{
+		if ( closure && IsOuterID(id) )
+			continue;
+
+		int offset = id->Offset();
+
+		if ( offset_map.size() )
+			{
+			auto where = offset_map.find(std::string(id->Name()));
+			if ( where != offset_map.end() )
+				offset = where->second;
+			}
+
+		if ( offset < size && frame[offset] && ! other->frame[offset] )
+			other->frame[offset] = frame[offset]->Clone();
+		}
+
+	return other;
+	}
+
 Frame* Frame::SelectiveClone(const id_list& selection) const
 	{
 	if ( selection.length() == 0 )
@@ -214,7 +270,8 @@ broker::expected<broker::data> Frame::Serialize(const Frame* target, id_list sel
 	// and
 	id_list them;
 
-	std::unordered_map<std::string, int> new_map(target->offset_map);
+	// Only the offsets of the selected IDs are needed on the other side.
+	std::unordered_map<std::string, int> new_map;
 
 	for (const auto& we : selection)
 		{
@@ -223,7 +280,11 @@ broker::expected<broker::data> Frame::Serialize(const Frame* target, id_list sel
 		else
 			{
 			us.append(we);
-			new_map.insert(std::make_pair(std::string(we->Name()), we->Offset()));
+
+			std::string name(we->Name());
+			auto where = target->offset_map.find(name);
+			int location = where != target->offset_map.end() ? where->second : we->Offset();
+			new_map.insert(std::make_pair(name, location));
 			}
 		}
 
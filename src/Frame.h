@@ -11,6 +11,7 @@
 #include <broker/expected.hh>
 
 #include "Val.h"
+#include "ObjPool.h"
 
 class Trigger;
 class CallExpr;
@@ -33,6 +34,8 @@ public:
 	 */
 	virtual ~Frame() override;
 
+	DECLARE_POOLED_ALLOC()
+
 	/**
 	 * @param n the index to get.
 	 * @return the value at index *n* of the underlying array.
@@ -66,6 +69,17 @@ public:
 	 */
 	Val* GetElement(const ID* id) const;
 
+	/**
+	 * Returns the value associated with *id* if it's a scalar (int,
+	 * count, double, time or interval) that the frame holds the only
+	 * reference to. The value may then be updated in place instead of
+	 * allocating a new one for the result. Returns nullptr otherwise.
+	 *
+	 * @param id the local whose value to retrieve
+	 * @return the value associated with *id*, or nullptr
+	 */
+	Val* UnsharedElement(const ID* id) const;
+
 	/**
 	 * Resets all of the indexes from [*startIdx, frame_size) in
 	 * the Frame. Unrefs all of the values in reset indexes.
@@ -152,6 +166,17 @@ public:
 	 */
 	Frame* SelectiveClone(const id_list& selection) const;
 
+	/**
+	 * Like Clone(), but only copies the values of the locals in
+	 * *locals*, leaving the other slots empty. Values of outer IDs
+	 * stay in the closure, which the copy captures by reference.
+	 *
+	 * @param locals the locals that whoever runs code in the copy
+	 * may reference.
+	 * @return a copy of this frame holding just those values.
+	 */
+	Frame* CloneLocals(const id_list& locals) const;
+
 	/**
 	 * Serializes the Frame into a Broker representation.
 	 *
@@ -163,8 +188,8 @@ public:
 	 * Where serialized_values are two element vectors. A serialized_value
 	 * has the result of calling broker::data_to_val on the value in the
 	 * first index, and an integer representing that value's type in the
-	 * second index. offset_map is a serialized version of the frame's
-	 * offset_map.
+	 * second index. offset_map maps the names of the selected IDs to
+	 * their offsets.
 	 *
 	 * A Frame with a closure needs to serialize a little more information.
 	 * It is serialized as:
@@ -243,6 +268,13 @@ private:
 	/** Associates ID's offsets with values. */
 	Val** frame;
 
+	/**
+	 * Storage for the values of frames with up to this many slots, so
+	 * that calls to small functions don't need a separate allocation.
+	 */
+	static const int INLINE_SLOTS = 8;
+	Val* inline_slots[INLINE_SLOTS];
+
 	/** The enclosing frame of this frame. */
 	Frame* closure;
 
@@ -33,6 +33,7 @@
 
 #include "Base64.h"
 #include "Stmt.h"
+#include "ScriptVM.h"
 #include "Scope.h"
 #include "Net.h"
 #include "NetVar.h"
@@ -287,6 +288,7 @@ BroFunc::~BroFunc()
 	std::for_each(bodies.begin(), bodies.end(),
 		[](Body& b) { Unref(b.stmts); });
 	Unref(closure);
+	delete compiled;
 	}
 
 int BroFunc::IsPure() const
@@ -301,6 +303,8 @@ Val* BroFunc::Call(val_list* args, Frame* parent) const
 	DEBUG_MSG("Function: %s\n", Name());
 #endif
 	SegmentProfiler(segment_logger, location);
+	FuncProfiler::Scope profile_scope(&func_profiler,
+		BifConst::profile_script_functions ? this : 0);
 
 	if ( sample_logger )
 		sample_logger->FunctionSeen(this);
@@ -325,6 +329,14 @@ Val* BroFunc::Call(val_list* args, Frame* parent) const
 		return Flavor() == FUNC_FLAVOR_HOOK ? val_mgr->GetTrue() : 0;
 		}
 
+	if ( BifConst::compile_script_functions )
+		{
+		Val* result;
+
+		if ( CallCompiled(args, &result) )
+			return result;
+		}
+
 	Frame* f = new Frame(frame_size, this, args);
 
 	if ( closure )
@@ -456,9 +468,44 @@ Val* BroFunc::Call(val_list* args, Frame* parent) const
 	return result;
 	}
 
+bool BroFunc::CallCompiled(val_list* args, Val** result) const
+	{
+	// The VM skips the interpreter's per-statement hooks, so don't use
+	// it when something is watching those.
+	if ( Flavor() != FUNC_FLAVOR_FUNCTION || closure || bodies.size() != 1 ||
+	     g_policy_debug || sample_logger || g_trace_state.DoTrace() ||
+	     script_sampler.Running() )
+		return false;
+
+	if ( ! compile_attempted )
+		{
+		compile_attempted = true;
+		compiled = CompiledFunc::Compile(this, bodies[0].stmts, frame_size);
+		}
+
+	bool returned;
+
+	if ( ! compiled || ! compiled->Run(args, result, &returned) )
+		return false;
+
+	for ( const auto& arg : *args )
+		Unref(arg);
+
+	if ( FType()->YieldType() && FType()->YieldType()->Tag() != TYPE_VOID &&
+	     (! returned || ! *result) )
+		reporter->Warning("non-void function returning without a value: %s",
+				  Name());
+
+	return true;
+	}
+
 void BroFunc::AddBody(Stmt* new_body, id_list* new_inits,
 		      size_t new_frame_size, int priority)
 	{
+	delete compiled;
+	compiled = nullptr;
+	compile_attempted = false;
+
 	if ( new_frame_size > frame_size )
 		frame_size = new_frame_size;
 
@@ -598,6 +645,8 @@ Val* BuiltinFunc::Call(val_list* args, Frame* parent) const
 	DEBUG_MSG("Function: %s\n", Name());
 #endif
 	SegmentProfiler(segment_logger, Name());
+	FuncProfiler::Scope profile_scope(&func_profiler,
+		BifConst::profile_script_functions ? this : 0);
 
 	if ( sample_logger )
 		sample_logger->FunctionSeen(this);
@@ -623,6 +672,11 @@ Val* BuiltinFunc::Call(val_list* args, Frame* parent) const
 	const CallExpr* call_expr = parent ? parent->GetCall() : nullptr;
 	call_stack.emplace_back(CallInfo{call_expr, this, args});
 	Val* result = func(parent, args);
+
+	if ( ScriptSampler::Pending() )
+		// Account it to us rather than to the caller's next statement.
+		script_sampler.Sample(0);
+
 	call_stack.pop_back();
 
 	for ( const auto& arg : *args )
@@ -732,6 +786,10 @@ void init_builtin_funcs()
 	ProcStats = internal_type("ProcStats")->AsRecordType();
 	NetStats = internal_type("NetStats")->AsRecordType();
 	MatcherStats = internal_type("MatcherStats")->AsRecordType();
+	MatcherSetStats = internal_type("MatcherSetStats")->AsRecordType();
+	MatcherSetStatsList = internal_type("MatcherSetStatsList")->AsVectorType();
+	RuleStats = internal_type("RuleStats")->AsRecordType();
+	RuleStatsList = internal_type("RuleStatsList")->AsVectorType();
 	ConnStats = internal_type("ConnStats")->AsRecordType();
 	ReassemblerStats = internal_type("ReassemblerStats")->AsRecordType();
 	DNSStats = internal_type("DNSStats")->AsRecordType();
@@ -742,6 +800,23 @@ void init_builtin_funcs()
 	ThreadStats = internal_type("ThreadStats")->AsRecordType();
 	BrokerStats = internal_type("BrokerStats")->AsRecordType();
 	ReporterStats = internal_type("ReporterStats")->AsRecordType();
+	PipelineStageStats = internal_type("PipelineStageStats")->AsRecordType();
+	PipelineStatsTable = internal_type("PipelineStats")->AsTableType();
+	FunctionStats = internal_type("FunctionStats")->AsRecordType();
+	FunctionStatsTable = internal_type("FunctionStatsTable")->AsTableType();
+	AnalyzerStats = internal_type("AnalyzerStats")->AsRecordType();
+	AnalyzerStatsTable = internal_type("AnalyzerStatsTable")->AsTableType();
+	TunnelTypeStats = internal_type("TunnelTypeStats")->AsRecordType();
+	TunnelStatsTable = internal_type("TunnelStats")->AsTableType();
+	ObjectStats = internal_type("ObjectStats")->AsRecordType();
+	ObjectStatsTable = internal_type("ObjectStatsTable")->AsTableType();
+	LogWriterStats = internal_type("LogWriterStats")->AsRecordType();
+	LogStreamStats = internal_type("LogStreamStats")->AsRecordType();
+	LogWriterStatsList = LogStreamStats->FieldType("writers")->AsVectorType();
+	LogStatsTable = internal_type("LogStats")->AsTableType();
+	BrokerTopicStats = internal_type("BrokerTopicStats")->AsRecordType();
+	BrokerTrafficStats = internal_type("BrokerTrafficStats")->AsRecordType();
+	BrokerTopicStatsTable = BrokerTrafficStats->FieldType("topics")->AsTableType();
 
 	var_sizes = internal_type("var_sizes")->AsTableType();
 
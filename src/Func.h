@@ -21,6 +21,7 @@ class Stmt;
 class Frame;
 class ID;
 class CallExpr;
+class CompiledFunc;
 
 class Func : public BroObj {
 public:
@@ -148,9 +149,17 @@ protected:
 	 */
 	void SetClosureFrame(Frame* f);
 
+	// Runs the function through the bytecode VM if its body can be
+	// compiled. Returns false if it has to be interpreted instead.
+	bool CallCompiled(val_list* args, Val** result) const;
+
 private:
 	size_t frame_size;
 
+	// Bytecode for the body, see ScriptVM.h. Compiled on first call.
+	mutable CompiledFunc* compiled = nullptr;
+	mutable bool compile_attempted = false;
+
 	// List of the outer IDs used in the function.
 	id_list outer_ids;
 	// The frame the BroFunc was initialized in.
@@ -0,0 +1,304 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <caf/stream_serializer.hpp>
+#include <caf/stream_deserializer.hpp>
+#include <caf/streambuf.hpp>
+
+#include "GlobalSnapshot.h"
+#include "Net.h"
+#include "Scope.h"
+#include "Var.h"
+#include "Reporter.h"
+#include "digest.h"
+#include "input.h"
+#include "broker/Data.h"
+
+extern const char* zeek_version();
+
+// A snapshot file starts with this, followed by the fingerprint of the
+// startup it was taken from and the serialized globals.
+static const char SNAPSHOT_MAGIC[8] = { 'Z', 'E', 'E', 'K', 'S', 'N', 'P', '1' };
+static const size_t SNAPSHOT_HEADER_SIZE = sizeof(SNAPSHOT_MAGIC) + MD5_DIGEST_LENGTH;
+
+static bool restored = false;
+
+static void hash_string(EVP_MD_CTX* c, const char* s)
+	{
+	// Include the terminating NUL to keep adjacent strings apart.
+	hash_update(c, s, strlen(s) + 1);
+	}
+
+static void hash_file(EVP_MD_CTX* c, const std::string& path)
+	{
+	FILE* f = fopen(path.c_str(), "r");
+
+	if ( ! f )
+		{
+		hash_string(c, "<unreadable>");
+		return;
+		}
+
+	char buf[65536];
+	size_t n;
+
+	while ( (n = fread(buf, 1, sizeof(buf), f)) > 0 )
+		hash_update(c, buf, n);
+
+	fclose(f);
+	}
+
+// Computes what identifies the current startup: the Zeek version, the
+// command line and all the script files loaded. Returns false if scripts
+// are involved that we can't tell apart, such as ones read from stdin.
+static bool compute_fingerprint(u_char digest[MD5_DIGEST_LENGTH])
+	{
+	for ( const auto& f : files_scanned )
+		{
+		if ( f.name.empty() || f.name == "-" )
+			return false;
+		}
+
+	EVP_MD_CTX* c = hash_init(Hash_MD5);
+
+	hash_string(c, zeek_version());
+
+	for ( int i = 0; i < bro_argc; ++i )
+		hash_string(c, bro_argv[i]);
+
+	for ( const auto& f : files_scanned )
+		{
+		hash_string(c, f.name.c_str());
+
+		if ( is_dir(f.name) )
+			{
+			// A package; what matters is its loader script.
+			hash_file(c, f.name + "/__load__.zeek");
+			hash_file(c, f.name + "/__load__.bro");
+			}
+		else
+			hash_file(c, f.name);
+		}
+
+	hash_final(c, digest);
+	return true;
+	}
+
+// Returns the globals to include in snapshots.
+static std::vector<std::string> snapshot_ids()
+	{
+	std::vector<std::string> names;
+	ListVal* lv = internal_val("global_snapshot_ids")->AsTableVal()->ConvertToPureList();
+
+	for ( int i = 0; i < lv->Length(); ++i )
+		names.push_back(lv->Index(i)->AsString()->CheckString());
+
+	Unref(lv);
+	return names;
+	}
+
+bool save_global_snapshot(const char* path)
+	{
+	u_char fingerprint[MD5_DIGEST_LENGTH];
+
+	if ( ! compute_fingerprint(fingerprint) )
+		{
+		reporter->Warning("not saving global snapshot, scripts have been read from stdin");
+		return false;
+		}
+
+	broker::vector globals;
+
+	for ( const auto& name : snapshot_ids() )
+		{
+		ID* id = global_scope()->Lookup(name.c_str());
+
+		if ( ! id || ! id->HasVal() )
+			{
+			reporter->Error("cannot snapshot %s: no such global or not set", name.c_str());
+			return false;
+			}
+
+		auto data = bro_broker::val_to_data(id->ID_Val());
+
+		if ( ! data )
+			{
+			reporter->Error("cannot snapshot %s: unsupported type", name.c_str());
+			return false;
+			}
+
+		globals.emplace_back(broker::vector{name, std::move(*data)});
+		}
+
+	std::vector<char> buf(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + sizeof(SNAPSHOT_MAGIC));
+	buf.insert(buf.end(), fingerprint, fingerprint + MD5_DIGEST_LENGTH);
+
+	size_t num_globals = globals.size();
+
+	caf::vectorbuf sb{buf};
+	caf::stream_serializer<caf::vectorbuf&> sink{sb};
+	broker::data all{std::move(globals)};
+
+	if ( auto err = sink(all) )
+		{
+		reporter->Error("cannot serialize global snapshot");
+		return false;
+		}
+
+	// Write to a temporary file first, so that others starting up
+	// concurrently never see a partial snapshot.
+	std::string tmp = fmt("%s.%d.tmp", path, getpid());
+	FILE* f = fopen(tmp.c_str(), "w");
+
+	if ( ! f )
+		{
+		reporter->Error("cannot open %s: %s", tmp.c_str(), strerror(errno));
+		return false;
+		}
+
+	bool ok = fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+	ok = (fclose(f) == 0) && ok;
+
+	if ( ! ok || rename(tmp.c_str(), path) < 0 )
+		{
+		reporter->Error("cannot write global snapshot %s: %s", path, strerror(errno));
+		unlink(tmp.c_str());
+		return false;
+		}
+
+	DBG_LOG(DBG_SCRIPTS, "saved %zu globals to snapshot %s", num_globals, path);
+	return true;
+	}
+
+// Decodes the snapshot's globals. Returns false if it doesn't match the
+// current startup or can't be decoded.
+static bool decode_snapshot(const char* data, size_t size, const char* path,
+				std::vector<std::pair<ID*, Val*>>* vals)
+	{
+	u_char fingerprint[MD5_DIGEST_LENGTH];
+
+	if ( size < SNAPSHOT_HEADER_SIZE ||
+	     memcmp(data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 )
+		{
+		reporter->Warning("ignoring global snapshot %s: not a snapshot", path);
+		return false;
+		}
+
+	if ( ! compute_fingerprint(fingerprint) ||
+	     memcmp(data + sizeof(SNAPSHOT_MAGIC), fingerprint, MD5_DIGEST_LENGTH) != 0 )
+		{
+		DBG_LOG(DBG_SCRIPTS, "global snapshot %s is stale", path);
+		return false;
+		}
+
+	caf::arraybuf<char> ab{const_cast<char*>(data) + SNAPSHOT_HEADER_SIZE,
+				size - SNAPSHOT_HEADER_SIZE};
+	caf::stream_deserializer<caf::arraybuf<char>&> source{ab};
+	broker::data all;
+
+	auto globals = source(all) ? nullptr : caf::get_if<broker::vector>(&all);
+
+	if ( ! globals )
+		{
+		reporter->Warning("ignoring global snapshot %s: cannot decode it", path);
+		return false;
+		}
+
+	for ( auto& g : *globals )
+		{
+		auto entry = caf::get_if<broker::vector>(&g);
+		auto name = entry && entry->size() == 2 ?
+			caf::get_if<std::string>(&(*entry)[0]) : nullptr;
+		ID* id = name ? global_scope()->Lookup(name->c_str()) : nullptr;
+		Val* v = id ? bro_broker::data_to_val(std::move((*entry)[1]), id->Type()) : nullptr;
+
+		if ( ! v )
+			{
+			reporter->Warning("ignoring global snapshot %s: cannot restore %s",
+					  path, name ? name->c_str() : "<unknown>");
+			return false;
+			}
+
+		vals->emplace_back(id, v);
+		}
+
+	return true;
+	}
+
+bool restore_global_snapshot(const char* path)
+	{
+	int fd = open(path, O_RDONLY);
+
+	if ( fd < 0 )
+		{
+		if ( errno != ENOENT )
+			reporter->Warning("cannot open global snapshot %s: %s", path, strerror(errno));
+
+		return false;
+		}
+
+	struct stat st;
+
+	if ( fstat(fd, &st) < 0 || st.st_size == 0 )
+		{
+		close(fd);
+		return false;
+		}
+
+	void* m = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if ( m == MAP_FAILED )
+		{
+		reporter->Warning("cannot map global snapshot %s: %s", path, strerror(errno));
+		return false;
+		}
+
+	std::vector<std::pair<ID*, Val*>> vals;
+	bool ok = decode_snapshot(static_cast<const char*>(m), st.st_size, path, &vals);
+	munmap(m, st.st_size);
+
+	if ( ! ok )
+		{
+		for ( const auto& v : vals )
+			Unref(v.second);
+
+		return false;
+		}
+
+	for ( const auto& v : vals )
+		{
+		ID* id = v.first;
+		Val* old = id->ID_Val();
+
+		if ( old && old->Type()->Tag() == TYPE_TABLE )
+			{
+			// Keep the table itself, as it carries attributes
+			// such as &default and expiration.
+			TableVal* t = old->AsTableVal();
+			t->RemoveAll();
+			v.second->AddTo(t, 0);
+			Unref(v.second);
+			}
+		else
+			id->SetVal(v.second);
+		}
+
+	DBG_LOG(DBG_SCRIPTS, "restored %zu globals from snapshot %s", vals.size(), path);
+
+	restored = true;
+	return true;
+	}
+
+bool global_snapshot_restored()
+	{
+	return restored;
+	}
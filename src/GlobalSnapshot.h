@@ -0,0 +1,30 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef globalsnapshot_h
+#define globalsnapshot_h
+
+// Snapshots of script-level global variables, for speeding up startup when
+// zeek_init() handlers spend a lot of time populating large tables. Once
+// zeek_init() has finished, the globals listed in global_snapshot_ids get
+// written to global_snapshot_file. The next time Zeek starts with the same
+// version, command line and script files (compared by their contents), it
+// maps the file and restores the globals right before zeek_init(), whose
+// handlers can then check global_snapshot_restored() to skip redoing the
+// work.
+//
+// Parsing scripts still happens in any case: the snapshot covers values,
+// not code.
+
+// Restores the globals from the given file if it matches the current
+// startup. Returns true if it did; a missing or stale snapshot isn't an
+// error, but one that can't be decoded is reported as a warning.
+extern bool restore_global_snapshot(const char* path);
+
+// Writes the globals to the given file. Returns false, after reporting an
+// error, if that didn't work.
+extern bool save_global_snapshot(const char* path);
+
+// Returns true if the globals have been restored from a snapshot.
+extern bool global_snapshot_restored();
+
+#endif
@@ -14,6 +14,13 @@
 // length. MD5 is used as a scrambling scheme so that it is difficult
 // for the adversary to construct conflicts, though I do not know if
 // HMAC/MD5 is provably universal.
+//
+// 3) With ZEEK_FAST_HASH set in the environment, all keys go through a
+// wyhash-style multiply-mix hash instead, seeded from the same random
+// key. That's several times faster than SipHash for short keys and
+// avoids MD5 for long ones, but it's not a cryptographic PRF: someone
+// controlling the keys of a table could construct collisions more
+// easily. So it's only meant for deployments where that's acceptable.
 
 #include "zeek-config.h"
 
@@ -22,11 +29,141 @@
 
 #include "siphash24.h"
 
+static bool use_fast_hash = false;
+static uint64 fast_hash_seed = 0;
+
+static const uint64 fast_hash_secret[4] = {
+	0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL,
+	0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL
+};
+
+// Multiplies a and b to 128 bits, returning the low half in a and the
+// high half in b.
+static inline void fast_hash_mum(uint64* a, uint64* b)
+	{
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = *a;
+	r *= *b;
+	*a = uint64(r);
+	*b = uint64(r >> 64);
+#else
+	uint64 ha = *a >> 32, hb = *b >> 32;
+	uint64 la = uint32(*a), lb = uint32(*b);
+	uint64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64 t = rl + (rm0 << 32);
+	uint64 c = t < rl;
+	uint64 lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+	}
+
+static inline uint64 fast_hash_mix(uint64 a, uint64 b)
+	{
+	fast_hash_mum(&a, &b);
+	return a ^ b;
+	}
+
+static inline uint64 fast_hash_r8(const uint8* p)
+	{
+	uint64 v;
+	memcpy(&v, p, 8);
+	return v;
+	}
+
+static inline uint64 fast_hash_r4(const uint8* p)
+	{
+	uint32 v;
+	memcpy(&v, p, 4);
+	return v;
+	}
+
+// Follows wyhash (final version 4), which is in the public domain.
+static hash_t fast_hash(const void* bytes, size_t len)
+	{
+	const uint8* p = (const uint8*) bytes;
+	const uint64* s = fast_hash_secret;
+	uint64 seed = fast_hash_seed;
+	uint64 a, b;
+
+	if ( len <= 16 )
+		{
+		if ( len >= 4 )
+			{
+			size_t shift = (len >> 3) << 2;
+			a = (fast_hash_r4(p) << 32) | fast_hash_r4(p + shift);
+			b = (fast_hash_r4(p + len - 4) << 32) |
+			    fast_hash_r4(p + len - 4 - shift);
+			}
+
+		else if ( len > 0 )
+			{
+			a = (uint64(p[0]) << 16) | (uint64(p[len >> 1]) << 8) |
+			    p[len - 1];
+			b = 0;
+			}
+
+		else
+			a = b = 0;
+		}
+
+	else
+		{
+		size_t i = len;
+
+		if ( i > 48 )
+			{
+			uint64 see1 = seed, see2 = seed;
+
+			do
+				{
+				seed = fast_hash_mix(fast_hash_r8(p) ^ s[1],
+						     fast_hash_r8(p + 8) ^ seed);
+				see1 = fast_hash_mix(fast_hash_r8(p + 16) ^ s[2],
+						     fast_hash_r8(p + 24) ^ see1);
+				see2 = fast_hash_mix(fast_hash_r8(p + 32) ^ s[3],
+						     fast_hash_r8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+				}
+			while ( i > 48 );
+
+			seed ^= see1 ^ see2;
+			}
+
+		while ( i > 16 )
+			{
+			seed = fast_hash_mix(fast_hash_r8(p) ^ s[1],
+					     fast_hash_r8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+			}
+
+		a = fast_hash_r8(p + i - 16);
+		b = fast_hash_r8(p + i - 8);
+		}
+
+	a ^= s[1];
+	b ^= seed;
+	fast_hash_mum(&a, &b);
+	return fast_hash_mix(a ^ s[0] ^ len, b ^ s[1]);
+	}
+
 void init_hash_function()
 	{
 	// Make sure we have already called init_random_seed().
 	if ( ! (hmac_key_set && siphash_key_set) )
 		reporter->InternalError("Zeek's hash functions aren't fully initialized");
+
+	if ( zeekenv("ZEEK_FAST_HASH") )
+		{
+		uint64 k[2];
+		memcpy(k, shared_siphash_key, sizeof(k));
+		fast_hash_seed = k[0] ^ fast_hash_mix(k[1] ^ fast_hash_secret[0],
+						      fast_hash_secret[1]);
+		use_fast_hash = true;
+		}
 	}
 
 HashKey::HashKey(bro_int_t i)
@@ -164,6 +301,9 @@ void* HashKey::CopyKey(const void* k, int s) const
 
 hash_t HashKey::HashBytes(const void* bytes, int size)
 	{
+	if ( use_fast_hash )
+		return fast_hash(bytes, size);
+
 	if ( size <= UHASH_KEY_SIZE )
 		{
 		hash_t digest;
@@ -0,0 +1,181 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <netinet/icmp6.h>
+
+#include "ICMPAggregator.h"
+#include "Event.h"
+#include "IP.h"
+#include "Net.h"
+#include "NetVar.h"
+#include "Sessions.h"
+
+#include "analyzer/protocol/icmp/events.bif.h"
+
+void ICMPAggregatorTimer::Dispatch(double t, int is_expire)
+	{
+	// At termination, NetSessions::Drain() reports what's left.
+	if ( is_expire )
+		return;
+
+	a->Expire(t, false);
+	}
+
+ICMPAggregator::ICMPAggregator()
+	{
+	timer = 0;
+	cumulative_flows = 0;
+	}
+
+ICMPAggregator::~ICMPAggregator()
+	{
+	// A pending timer only fires again at termination, when it doesn't
+	// call back.
+	}
+
+bool ICMPAggregator::CanAggregate(bool icmpv6, int type)
+	{
+	// These would each need the packet in the context of a connection.
+	// Signatures don't get to see aggregated flows either, but as the
+	// base scripts always load some, we don't let them stand in the way.
+	if ( new_packet || ipv6_ext_headers || packet_contents )
+		return false;
+
+	if ( icmpv6 )
+		{
+		switch ( type ) {
+		case ICMP6_ECHO_REQUEST:
+		case ICMP6_ECHO_REPLY:
+			return ! (icmp_echo_request || icmp_echo_reply);
+
+		case ICMP6_DST_UNREACH:
+			return ! icmp_unreachable;
+
+		default:
+			return false;
+		}
+		}
+
+	switch ( type ) {
+	case ICMP_ECHO:
+	case ICMP_ECHOREPLY:
+		return ! (icmp_echo_request || icmp_echo_reply);
+
+	case ICMP_UNREACH:
+		return ! icmp_unreachable;
+
+	default:
+		return false;
+	}
+	}
+
+void ICMPAggregator::NextPacket(double t, const ConnID& id,
+				const ConnIDKey& key, const IP_Hdr* ip, int len)
+	{
+	FlowMap::iterator i = flows.find(key);
+
+	if ( i == flows.end() )
+		{
+		Flow f;
+		f.orig_addr = id.src_addr;
+		f.resp_addr = id.dst_addr;
+		f.orig_port = id.src_port;
+		f.resp_port = id.dst_port;
+		f.start_time = t;
+		f.orig_pkts = f.orig_bytes = f.orig_ip_bytes = 0;
+		f.resp_pkts = f.resp_bytes = f.resp_ip_bytes = 0;
+
+		i = flows.insert(FlowMap::value_type(key, f)).first;
+		++cumulative_flows;
+
+		if ( ! timer && icmp_inactivity_timeout > 0 )
+			{
+			timer = new ICMPAggregatorTimer(this, t + icmp_inactivity_timeout);
+			timer_mgr->Add(timer);
+			}
+		}
+
+	Flow& f = i->second;
+	f.last_time = t;
+
+	// Minus the common part of the ICMP header, as the analyzer counts it.
+	int payload_len = len > 8 ? len - 8 : 0;
+
+	if ( id.src_addr == f.orig_addr && id.src_port == f.orig_port )
+		{
+		++f.orig_pkts;
+		f.orig_bytes += payload_len;
+		f.orig_ip_bytes += ip->TotalLen();
+		}
+	else
+		{
+		++f.resp_pkts;
+		f.resp_bytes += payload_len;
+		f.resp_ip_bytes += ip->TotalLen();
+		}
+	}
+
+void ICMPAggregator::Expire(double t, bool all)
+	{
+	// The timer calling us is done.
+	timer = 0;
+
+	double next = 0;
+
+	for ( FlowMap::iterator i = flows.begin(); i != flows.end(); )
+		{
+		double due = i->second.last_time + icmp_inactivity_timeout;
+
+		if ( all || due <= t )
+			{
+			Report(i->second);
+			i = flows.erase(i);
+			continue;
+			}
+
+		if ( ! next || due < next )
+			next = due;
+
+		++i;
+		}
+
+	if ( next && ! all )
+		{
+		timer = new ICMPAggregatorTimer(this, next);
+		timer_mgr->Add(timer);
+		}
+	}
+
+void ICMPAggregator::Report(const Flow& f)
+	{
+	if ( ! icmp_flow_summary )
+		return;
+
+	RecordVal* id_val = new RecordVal(conn_id);
+	id_val->Assign(0, new AddrVal(f.orig_addr));
+	id_val->Assign(1, val_mgr->GetPort(ntohs(f.orig_port), TRANSPORT_ICMP));
+	id_val->Assign(2, new AddrVal(f.resp_addr));
+	id_val->Assign(3, val_mgr->GetPort(ntohs(f.resp_port), TRANSPORT_ICMP));
+
+	RecordVal* r = new RecordVal(icmp_flow);
+	r->Assign(0, id_val);
+	r->Assign(1, new Val(f.start_time, TYPE_TIME));
+	r->Assign(2, new Val(f.last_time - f.start_time, TYPE_INTERVAL));
+	r->Assign(3, val_mgr->GetCount(f.orig_pkts));
+	r->Assign(4, val_mgr->GetCount(f.orig_bytes));
+	r->Assign(5, val_mgr->GetCount(f.orig_ip_bytes));
+	r->Assign(6, val_mgr->GetCount(f.resp_pkts));
+	r->Assign(7, val_mgr->GetCount(f.resp_bytes));
+	r->Assign(8, val_mgr->GetCount(f.resp_ip_bytes));
+
+	mgr.QueueEventFast(icmp_flow_summary, {r});
+	}
+
+unsigned int ICMPAggregator::MemoryAllocation() const
+	{
+	// Roughly: a node per flow plus the bucket array.
+	return padded_sizeof(*this)
+		+ flows.size() * (sizeof(FlowMap::value_type) + 2 * sizeof(void*))
+		+ flows.bucket_count() * sizeof(void*);
+	}
@@ -0,0 +1,95 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef icmpaggregator_h
+#define icmpaggregator_h
+
+// Tracking of ICMP echo and destination unreachable flows without setting
+// up a Connection for each, for when icmp_aggregation is set. A ping sweep
+// or a flood of unreachables then takes up a small, fixed-size entry per
+// flow rather than a connection with its analyzer tree. The flows are
+// reported through icmp_flow_summary once they have been inactive for
+// icmp_inactivity_timeout, or when processing terminates.
+
+#include <unordered_map>
+
+#include "Conn.h"
+#include "ConnTable.h"
+#include "Timer.h"
+
+class IP_Hdr;
+class ICMPAggregator;
+
+// Sweeps the aggregated flows for inactive ones. There's at most one of
+// these pending.
+class ICMPAggregatorTimer : public Timer {
+public:
+	ICMPAggregatorTimer(ICMPAggregator* arg_a, double t)
+		: Timer(t, TIMER_CONN_INACTIVITY), a(arg_a)	{}
+
+	void Dispatch(double t, int is_expire) override;
+
+protected:
+	ICMPAggregator* a;
+};
+
+class ICMPAggregator {
+public:
+	ICMPAggregator();
+	~ICMPAggregator();
+
+	// Returns true if a packet with the given ICMP type can be
+	// aggregated, which requires that there are no handlers for events
+	// that need a connection of its own for it.
+	static bool CanAggregate(bool icmpv6, int type);
+
+	// Counts a packet for the flow with the given ID and key. "len" is
+	// the length of the ICMP message.
+	void NextPacket(double t, const ConnID& id, const ConnIDKey& key,
+			const IP_Hdr* ip, int len);
+
+	// Reports and removes the flows that have been inactive for
+	// icmp_inactivity_timeout as of the given time, or all of them if
+	// "all" is true.
+	void Expire(double t, bool all);
+
+	size_t Size() const		{ return flows.size(); }
+	uint64 NumCumulativeFlows() const	{ return cumulative_flows; }
+
+	unsigned int MemoryAllocation() const;
+
+private:
+	struct Flow {
+		IPAddr orig_addr;
+		IPAddr resp_addr;
+		uint32 orig_port;	// in network order
+		uint32 resp_port;	// in network order
+		double start_time;
+		double last_time;
+		uint64 orig_pkts;
+		uint64 orig_bytes;	// ICMP payload
+		uint64 orig_ip_bytes;
+		uint64 resp_pkts;
+		uint64 resp_bytes;
+		uint64 resp_ip_bytes;
+	};
+
+	struct KeyHash {
+		size_t operator()(const ConnIDKey& k) const
+			{ return ConnTable::Hash(k); }
+	};
+
+	struct KeyEqual {
+		bool operator()(const ConnIDKey& a, const ConnIDKey& b) const
+			{ return memcmp(&a, &b, sizeof(a)) == 0; }
+	};
+
+	typedef std::unordered_map<ConnIDKey, Flow, KeyHash, KeyEqual> FlowMap;
+
+	void Report(const Flow& f);
+
+	FlowMap flows;
+	ICMPAggregatorTimer* timer;
+	uint64 cumulative_flows;
+};
+
+#endif
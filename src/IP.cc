@@ -30,6 +30,9 @@ static RecordType* ip6_mob_bu_type = 0;
 static RecordType* ip6_mob_back_type = 0;
 static RecordType* ip6_mob_be_type = 0;
 
+static VectorType* ip6_options_type = 0;
+static VectorType* ip6_ext_hdr_chain_type = 0;
+
 static inline RecordType* hdrType(RecordType*& type, const char* name)
 	{
 	if ( ! type )
@@ -38,9 +41,17 @@ static inline RecordType* hdrType(RecordType*& type, const char* name)
 	return type;
 	}
 
+static inline VectorType* vecType(VectorType*& type, const char* name)
+	{
+	if ( ! type )
+		type = internal_type(name)->AsVectorType();
+
+	return type;
+	}
+
 static VectorVal* BuildOptionsVal(const u_char* data, int len)
 	{
-	VectorVal* vv = new VectorVal(internal_type("ip6_options")->AsVectorType());
+	VectorVal* vv = new VectorVal(vecType(ip6_options_type, "ip6_options"));
 
 	while ( len > 0 )
 		{
@@ -91,7 +102,7 @@ RecordVal* IPv6_Hdr::BuildRecordVal(VectorVal* chain) const
 		rv->Assign(6, new AddrVal(IPAddr(ip6->ip6_dst)));
 		if ( ! chain )
 			chain = new VectorVal(
-			    internal_type("ip6_ext_hdr_chain")->AsVectorType());
+			    vecType(ip6_ext_hdr_chain_type, "ip6_ext_hdr_chain"));
 		rv->Assign(7, chain);
 		}
 		break;
@@ -468,25 +479,22 @@ void IPv6_Hdr_Chain::Init(const struct ip6_hdr* ip6, int total_len,
 			return;
 
 		current_type = next_type;
-		IPv6_Hdr* p = new IPv6_Hdr(current_type, hdrs);
+		IPv6_Hdr p(current_type, hdrs);
 
-		next_type = p->NextHdr();
-		uint16 cur_len = p->Length();
+		next_type = p.NextHdr();
+		uint16 cur_len = p.Length();
 
 		// If this header is truncated, don't add it to chain, don't go further.
 		if ( cur_len > total_len )
-			{
-			delete p;
 			return;
-			}
 
 		if ( set_next && next_type == IPPROTO_FRAGMENT )
 			{
-			p->ChangeNext(next);
+			p.ChangeNext(next);
 			next_type = next;
 			}
 
-		chain.push_back(p);
+		Append(current_type, hdrs);
 
 		// Check for routing headers and remember final destination address.
 		if ( current_type == IPPROTO_ROUTING )
@@ -512,7 +520,7 @@ void IPv6_Hdr_Chain::Init(const struct ip6_hdr* ip6, int total_len,
 
 void IPv6_Hdr_Chain::ProcessRoutingHeader(const struct ip6_rthdr* r, uint16 len)
 	{
-	if ( finalDst )
+	if ( has_final_dst )
 		{
 		// RFC 2460 section 4.1 says Routing should occur at most once.
 		reporter->Weird(SrcAddr(), DstAddr(), "multiple_routing_headers");
@@ -528,7 +536,10 @@ void IPv6_Hdr_Chain::ProcessRoutingHeader(const struct ip6_rthdr* r, uint16 len)
 		if ( r->ip6r_segleft > 0 && r->ip6r_len >= 2 )
 			{
 			if ( r->ip6r_len % 2 == 0 )
-				finalDst = new IPAddr(*addr);
+				{
+				finalDst = IPAddr(*addr);
+				has_final_dst = true;
+				}
 			else
 				reporter->Weird(SrcAddr(), DstAddr(), "odd_routing0_len");
 			}
@@ -544,7 +555,10 @@ void IPv6_Hdr_Chain::ProcessRoutingHeader(const struct ip6_rthdr* r, uint16 len)
 		if ( r->ip6r_segleft > 0 )
 			{
 			if ( r->ip6r_len == 2 )
-				finalDst = new IPAddr(*addr);
+				{
+				finalDst = IPAddr(*addr);
+				has_final_dst = true;
+				}
 			else
 				reporter->Weird(SrcAddr(), DstAddr(), "bad_routing2_len");
 			}
@@ -573,10 +587,13 @@ void IPv6_Hdr_Chain::ProcessDstOpts(const struct ip6_dest* d, uint16 len)
 		case 201: // Home Address Option, Mobile IPv6 RFC 6275 section 6.3
 			{
 			if ( opt->ip6o_len == 16 )
-				if ( homeAddr )
+				if ( has_home_addr )
 					reporter->Weird(SrcAddr(), DstAddr(), "multiple_home_addr_opts");
 				else
-					homeAddr = new IPAddr(*((const in6_addr*)(data + 2)));
+					{
+					homeAddr = IPAddr(*((const in6_addr*)(data + 2)));
+					has_home_addr = true;
+					}
 			else
 				reporter->Weird(SrcAddr(), DstAddr(), "bad_home_addr_len");
 			}
@@ -615,13 +632,14 @@ VectorVal* IPv6_Hdr_Chain::BuildVal() const
 		}
 
 	VectorVal* rval = new VectorVal(
-	    internal_type("ip6_ext_hdr_chain")->AsVectorType());
+	    vecType(ip6_ext_hdr_chain_type, "ip6_ext_hdr_chain"));
 
-	for ( size_t i = 1; i < chain.size(); ++i )
+	for ( size_t i = 1; i < num_hdrs; ++i )
 		{
-		RecordVal* v = chain[i]->BuildRecordVal();
+		const IPv6_Hdr* hdr = (*this)[i];
+		RecordVal* v = hdr->BuildRecordVal();
 		RecordVal* ext_hdr = new RecordVal(ip6_ext_hdr_type);
-		uint8 type = chain[i]->Type();
+		uint8 type = hdr->Type();
 		ext_hdr->Assign(0, val_mgr->GetCount(type));
 
 		switch (type) {
@@ -682,14 +700,14 @@ IPv6_Hdr_Chain* IPv6_Hdr_Chain::Copy(const ip6_hdr* new_hdr) const
 	rval->length = length;
 
 #ifdef ENABLE_MOBILE_IPV6
-	if ( homeAddr )
-		rval->homeAddr = new IPAddr(*homeAddr);
+	rval->homeAddr = homeAddr;
+	rval->has_home_addr = has_home_addr;
 #endif
 
-	if ( finalDst )
-		rval->finalDst = new IPAddr(*finalDst);
+	rval->finalDst = finalDst;
+	rval->has_final_dst = has_final_dst;
 
-	if ( chain.empty() )
+	if ( ! num_hdrs )
 		{
 		reporter->InternalWarning("empty IPv6 header chain");
 		delete rval;
@@ -697,12 +715,13 @@ IPv6_Hdr_Chain* IPv6_Hdr_Chain::Copy(const ip6_hdr* new_hdr) const
 		}
 
 	const u_char* new_data = (const u_char*)new_hdr;
-	const u_char* old_data = chain[0]->Data();
+	const u_char* old_data = inline_hdrs[0].Data();
 
-	for ( size_t i = 0; i < chain.size(); ++i )
+	for ( size_t i = 0; i < num_hdrs; ++i )
 		{
-		int off = chain[i]->Data() - old_data;
-		rval->chain.push_back(new IPv6_Hdr(chain[i]->Type(), new_data + off));
+		const IPv6_Hdr* hdr = (*this)[i];
+		int off = hdr->Data() - old_data;
+		rval->Append(hdr->Type(), new_data + off);
 		}
 
 	return rval;
@@ -39,6 +39,12 @@ public:
 	 */
 	IPv6_Hdr(uint8 t, const u_char* d) : type(t), data(d) {}
 
+	/**
+	 * Leaves the header uninitialized, for storage that's assigned
+	 * later.
+	 */
+	IPv6_Hdr() {}
+
 	/**
 	 * Replace the value of the next protocol field.
 	 */
@@ -142,21 +148,13 @@ public:
 	 * Initializes the header chain from an IPv6 header structure.
 	 */
 	IPv6_Hdr_Chain(const struct ip6_hdr* ip6, int len) :
+		num_hdrs(0),
 #ifdef ENABLE_MOBILE_IPV6
-		homeAddr(0),
+		has_home_addr(false),
 #endif
-		finalDst(0)
+		has_final_dst(false)
 		{ Init(ip6, len, false); }
 
-	~IPv6_Hdr_Chain()
-		{
-		for ( size_t i = 0; i < chain.size(); ++i ) delete chain[i];
-#ifdef ENABLE_MOBILE_IPV6
-		delete homeAddr;
-#endif
-		delete finalDst;
-		}
-
 	/**
 	 * @return a copy of the header chain, but with pointers to individual
 	 * IPv6 headers now pointing within \a new_hdr.
@@ -166,7 +164,7 @@ public:
 	/**
 	 * Returns the number of headers in the chain.
 	 */
-	size_t Size() const { return chain.size(); }
+	size_t Size() const { return num_hdrs; }
 
 	/**
 	 * Returns the sum of the length of all headers in the chain in bytes.
@@ -176,20 +174,21 @@ public:
 	/**
 	 * Accesses the header at the given location in the chain.
 	 */
-	const IPv6_Hdr* operator[](const size_t i) const { return chain[i]; }
+	const IPv6_Hdr* operator[](const size_t i) const
+		{ return i < MAX_INLINE_HDRS ? &inline_hdrs[i] : &more_hdrs[i - MAX_INLINE_HDRS]; }
 
 	/**
 	 * Returns whether the header chain indicates a fragmented packet.
 	 */
 	bool IsFragment() const
 		{
-		if ( chain.empty() )
+		if ( ! num_hdrs )
 			{
 			reporter->InternalWarning("empty IPv6 header chain");
 			return false;
 			}
 
-		return chain[chain.size()-1]->Type() == IPPROTO_FRAGMENT;
+		return (*this)[num_hdrs-1]->Type() == IPPROTO_FRAGMENT;
 		}
 
 	/**
@@ -197,7 +196,7 @@ public:
 	 */
 	const struct ip6_frag* GetFragHdr() const
 		{ return IsFragment() ?
-				(const struct ip6_frag*)chain[chain.size()-1]->Data(): 0; }
+				(const struct ip6_frag*)(*this)[num_hdrs-1]->Data(): 0; }
 
 	/**
 	 * If the header chain is a fragment, returns the offset in number of bytes
@@ -228,16 +227,16 @@ public:
 	IPAddr SrcAddr() const
 		{
 #ifdef ENABLE_MOBILE_IPV6
-		if ( homeAddr )
-			return IPAddr(*homeAddr);
+		if ( has_home_addr )
+			return homeAddr;
 #endif
-		if ( chain.empty() )
+		if ( ! num_hdrs )
 			{
 			reporter->InternalWarning("empty IPv6 header chain");
 			return IPAddr();
 			}
 
-		return IPAddr(((const struct ip6_hdr*)(chain[0]->Data()))->ip6_src);
+		return IPAddr(((const struct ip6_hdr*)(inline_hdrs[0].Data()))->ip6_src);
 		}
 
 	/**
@@ -247,16 +246,16 @@ public:
 	 */
 	IPAddr DstAddr() const
 		{
-		if ( finalDst )
-			return IPAddr(*finalDst);
+		if ( has_final_dst )
+			return finalDst;
 
-		if ( chain.empty() )
+		if ( ! num_hdrs )
 			{
 			reporter->InternalWarning("empty IPv6 header chain");
 			return IPAddr();
 			}
 
-		return IPAddr(((const struct ip6_hdr*)(chain[0]->Data()))->ip6_dst);
+		return IPAddr(((const struct ip6_hdr*)(inline_hdrs[0].Data()))->ip6_dst);
 		}
 
 	/**
@@ -270,12 +269,16 @@ protected:
 	// point to a fragment
 	friend class FragReassembler;
 
+	// For keeping the chain of a packet's header inline.
+	friend class IP_Hdr;
+
 	IPv6_Hdr_Chain() :
+		num_hdrs(0),
 		length(0),
 #ifdef ENABLE_MOBILE_IPV6
-		homeAddr(0),
+		has_home_addr(false),
 #endif
-		finalDst(0)
+		has_final_dst(false)
 		{}
 
 	/**
@@ -283,10 +286,11 @@ protected:
 	 * the first next protocol pointer field that points to a fragment header.
 	 */
 	IPv6_Hdr_Chain(const struct ip6_hdr* ip6, uint16 next, int len) :
+		num_hdrs(0),
 #ifdef ENABLE_MOBILE_IPV6
-		homeAddr(0),
+		has_home_addr(false),
 #endif
-		finalDst(0)
+		has_final_dst(false)
 		{ Init(ip6, len, true, next); }
 
 	/**
@@ -298,7 +302,20 @@ protected:
 	          uint16 next = 0);
 
 	/**
-	 * Process a routing header and allocate/remember the final destination
+	 * Appends a header to the chain.
+	 */
+	void Append(uint8 type, const u_char* data)
+		{
+		if ( num_hdrs < MAX_INLINE_HDRS )
+			inline_hdrs[num_hdrs] = IPv6_Hdr(type, data);
+		else
+			more_hdrs.push_back(IPv6_Hdr(type, data));
+
+		++num_hdrs;
+		}
+
+	/**
+	 * Process a routing header and remember the final destination
 	 * address if it has segments left and is a valid routing header.
 	 */
 	void ProcessRoutingHeader(const struct ip6_rthdr* r, uint16 len);
@@ -311,7 +328,15 @@ protected:
 	void ProcessDstOpts(const struct ip6_dest* d, uint16 len);
 #endif
 
-	vector<IPv6_Hdr*> chain;
+	/**
+	 * The headers of the chain. Packets rarely carry more than a few
+	 * extension headers, so the first ones are kept inline and only
+	 * any further ones go into the vector.
+	 */
+	static const size_t MAX_INLINE_HDRS = 8;
+	IPv6_Hdr inline_hdrs[MAX_INLINE_HDRS];
+	vector<IPv6_Hdr> more_hdrs;
+	size_t num_hdrs;
 
 	/**
 	 * The summation of all header lengths in the chain in bytes.
@@ -322,14 +347,16 @@ protected:
 	/**
 	 * Home Address of the packet's source as defined by Mobile IPv6 (RFC 6275).
 	 */
-	IPAddr* homeAddr;
+	IPAddr homeAddr;
+	bool has_home_addr;
 #endif
 
 	/**
 	 * The final destination address in chain's first Routing header that has
 	 * non-zero segments left.
 	 */
-	IPAddr* finalDst;
+	IPAddr finalDst;
+	bool has_final_dst;
 };
 
 /**
@@ -359,14 +386,35 @@ public:
 	 * @param arg_del whether to take ownership of \a arg_ip6 pointer's memory.
 	 * @param len the packet's length in bytes.
 	 * @param c an already-constructed header chain to take ownership of.
+	 * Without one, the chain is parsed into the wrapper itself.
 	 */
 	IP_Hdr(const struct ip6_hdr* arg_ip6, bool arg_del, int len,
 	       const IPv6_Hdr_Chain* c = 0)
-		: ip4(0), ip6(arg_ip6), del(arg_del),
-		  ip6_hdrs(c ? c : new IPv6_Hdr_Chain(ip6, len))
+		: ip4(0), ip6(arg_ip6), del(arg_del), ip6_hdrs(c)
+		{
+		if ( ! c )
+			{
+			local_ip6_hdrs.Init(ip6, len, false);
+			ip6_hdrs = &local_ip6_hdrs;
+			}
+		}
+
+	/**
+	 * Copies the header wrapper. The copy points to the same memory
+	 * but never takes ownership of it.
+	 */
+	IP_Hdr(const IP_Hdr& other)
+		: ip4(other.ip4), ip6(other.ip6), del(false), ip6_hdrs(0)
 		{
+		if ( other.ip6_hdrs )
+			{
+			local_ip6_hdrs = *other.ip6_hdrs;
+			ip6_hdrs = &local_ip6_hdrs;
+			}
 		}
 
+	IP_Hdr& operator=(const IP_Hdr&) = delete;
+
 	/**
 	 * Copy a header.  The internal buffer which contains the header data
 	 * must not be truncated.  Also note that if that buffer points to a full
@@ -379,7 +427,8 @@ public:
 	 */
 	~IP_Hdr()
 		{
-		delete ip6_hdrs;
+		if ( ip6_hdrs != &local_ip6_hdrs )
+			delete ip6_hdrs;
 
 		if ( del )
 			{
@@ -585,6 +634,9 @@ private:
 	const struct ip6_hdr* ip6;
 	bool del;
 	const IPv6_Hdr_Chain* ip6_hdrs;
+
+	// Holds the chain unless one was passed in.
+	IPv6_Hdr_Chain local_ip6_hdrs;
 };
 
 #endif
@@ -14,15 +14,8 @@ const uint8_t IPAddr::v4_mapped_prefix[12] = { 0, 0, 0, 0,
                                                0, 0, 0, 0,
                                                0, 0, 0xff, 0xff };
 
-HashKey* BuildConnIDHashKey(const ConnID& id)
+void BuildConnIDKey(const ConnID& id, ConnIDKey* key)
 	{
-	struct {
-		in6_addr ip1;
-		in6_addr ip2;
-		uint16 port1;
-		uint16 port2;
-	} key;
-
 	// Lookup up connection based on canonical ordering, which is
 	// the smaller of <src addr, src port> and <dst addr, dst port>
 	// followed by the other.
@@ -30,19 +23,24 @@ HashKey* BuildConnIDHashKey(const ConnID& id)
 	     addr_port_canon_lt(id.src_addr, id.src_port, id.dst_addr, id.dst_port)
 	   )
 		{
-		key.ip1 = id.src_addr.in6;
-		key.ip2 = id.dst_addr.in6;
-		key.port1 = id.src_port;
-		key.port2 = id.dst_port;
+		key->ip1 = id.src_addr.in6;
+		key->ip2 = id.dst_addr.in6;
+		key->port1 = id.src_port;
+		key->port2 = id.dst_port;
 		}
 	else
 		{
-		key.ip1 = id.dst_addr.in6;
-		key.ip2 = id.src_addr.in6;
-		key.port1 = id.dst_port;
-		key.port2 = id.src_port;
+		key->ip1 = id.dst_addr.in6;
+		key->ip2 = id.src_addr.in6;
+		key->port1 = id.dst_port;
+		key->port2 = id.src_port;
 		}
+	}
 
+HashKey* BuildConnIDHashKey(const ConnID& id)
+	{
+	ConnIDKey key;
+	BuildConnIDKey(id, &key);
 	return new HashKey(&key, sizeof(key));
 	}
 
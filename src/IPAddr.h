@@ -14,6 +14,7 @@
 #include "threading/SerialTypes.h"
 
 struct ConnID;
+struct ConnIDKey;
 namespace analyzer { class ExpectedConn; }
 
 typedef in_addr in4_addr;
@@ -363,6 +364,7 @@ public:
 	void ConvertToThreadingValue(threading::Value::addr_t* v) const;
 
 	friend HashKey* BuildConnIDHashKey(const ConnID& id);
+	friend void BuildConnIDKey(const ConnID& id, ConnIDKey* key);
 
 	unsigned int MemoryAllocation() const { return padded_sizeof(*this); }
 
@@ -484,6 +486,22 @@ inline void IPAddr::ConvertToThreadingValue(threading::Value::addr_t* v) const
 	}
 	}
 
+/**
+ * The canonical, fixed-size representation of a ConnID that connections
+ * are indexed by. It's the same for both directions of a connection.
+ */
+struct ConnIDKey {
+	in6_addr ip1;
+	in6_addr ip2;
+	uint16 port1;
+	uint16 port2;
+};
+
+/**
+ * Fills in the canonical key for a given ConnID.
+ */
+void BuildConnIDKey(const ConnID& id, ConnIDKey* key);
+
 /**
   * Returns a hash key for a given ConnID. Passes ownership to caller.
   */
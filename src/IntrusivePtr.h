@@ -0,0 +1,120 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef intrusiveptr_h
+#define intrusiveptr_h
+
+#include <stddef.h>
+
+#include <utility>
+
+#include "Obj.h"
+
+// Tags for telling IntrusivePtr's constructors whether to take over the
+// reference the caller holds, or to add one of its own.
+struct AdoptRef {};
+struct NewRef {};
+
+// A smart pointer to a reference-counted BroObj, releasing its reference
+// when going out of scope. The point is to make ownership explicit in the
+// type: handing over a reference is a move, which leaves the counter alone,
+// instead of a Ref() on one side and an Unref() on the other. That also
+// removes the need for Unref()s along every early return.
+//
+// Raw pointers convert in both directions only explicitly, so that it's
+// always visible whether a reference changes hands: release() gives up the
+// reference without touching the counter, get() just peeks.
+template <class T>
+class IntrusivePtr {
+public:
+	IntrusivePtr() noexcept : ptr(nullptr)	{ }
+	IntrusivePtr(std::nullptr_t) noexcept : ptr(nullptr)	{ }
+
+	// Takes over the caller's reference to the object.
+	IntrusivePtr(AdoptRef, T* arg_ptr) noexcept : ptr(arg_ptr)	{ }
+
+	// Adds a reference to the object.
+	IntrusivePtr(NewRef, T* arg_ptr) noexcept : ptr(arg_ptr)
+		{
+		if ( ptr )
+			Ref(ptr);
+		}
+
+	IntrusivePtr(const IntrusivePtr& other) noexcept
+		: IntrusivePtr(NewRef{}, other.ptr)
+		{
+		}
+
+	IntrusivePtr(IntrusivePtr&& other) noexcept : ptr(other.release())	{ }
+
+	template <class U>
+	IntrusivePtr(IntrusivePtr<U> other) noexcept : ptr(other.release())	{ }
+
+	~IntrusivePtr()
+		{
+		if ( ptr )
+			Unref(ptr);
+		}
+
+	IntrusivePtr& operator=(IntrusivePtr other) noexcept
+		{
+		swap(other);
+		return *this;
+		}
+
+	void swap(IntrusivePtr& other) noexcept
+		{
+		std::swap(ptr, other.ptr);
+		}
+
+	// Gives up the reference to the object, if any, and returns it.
+	T* release() noexcept
+		{
+		T* p = ptr;
+		ptr = nullptr;
+		return p;
+		}
+
+	T* get() const noexcept	{ return ptr; }
+
+	T& operator*() const noexcept	{ return *ptr; }
+	T* operator->() const noexcept	{ return ptr; }
+
+	explicit operator bool() const noexcept	{ return ptr != nullptr; }
+
+private:
+	T* ptr;
+};
+
+// Creates a new object, which starts out with a reference count of one,
+// and returns a pointer taking over that reference.
+template <class T, class... Ts>
+IntrusivePtr<T> make_intrusive(Ts&&... args)
+	{
+	return {AdoptRef{}, new T(std::forward<Ts>(args)...)};
+	}
+
+template <class T, class U>
+bool operator==(const IntrusivePtr<T>& a, const IntrusivePtr<U>& b)
+	{
+	return a.get() == b.get();
+	}
+
+template <class T, class U>
+bool operator!=(const IntrusivePtr<T>& a, const IntrusivePtr<U>& b)
+	{
+	return a.get() != b.get();
+	}
+
+template <class T>
+bool operator==(const IntrusivePtr<T>& a, std::nullptr_t)
+	{
+	return ! a;
+	}
+
+template <class T>
+bool operator!=(const IntrusivePtr<T>& a, std::nullptr_t)
+	{
+	return static_cast<bool>(a);
+	}
+
+#endif
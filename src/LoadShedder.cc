@@ -0,0 +1,161 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "LoadShedder.h"
+#include "Net.h"
+#include "Event.h"
+#include "Var.h"
+#include "Reporter.h"
+#include "DebugLogger.h"
+#include "iosource/Manager.h"
+#include "iosource/PktSrc.h"
+
+#include "const.bif.h"
+#include "event.bif.h"
+
+LoadShedder* load_shedder = 0;
+
+static RecordType* load_shedding_state = 0;
+
+LoadShedder::LoadShedder()
+	{
+	level = LEVEL_NONE;
+	calm_checks = 0;
+	next_check = 0.0;
+	last_received = last_dropped = 0;
+
+	check_interval = BifConst::LoadShedding::check_interval;
+	max_lag = BifConst::LoadShedding::max_lag;
+	max_drop_rate = BifConst::LoadShedding::max_drop_rate;
+	max_queued_events = BifConst::LoadShedding::max_queued_events;
+	recovery_checks = BifConst::LoadShedding::recovery_checks;
+	bulk_flow_size = BifConst::LoadShedding::bulk_flow_size;
+	sampling_rate = BifConst::LoadShedding::sampling_rate;
+	analyzers = internal_val("LoadShedding::analyzers")->AsTableVal();
+
+	uint64 ml = BifConst::LoadShedding::max_level;
+	max_level = Level(ml > LEVEL_SAMPLING ? LEVEL_SAMPLING : ml);
+
+	num_skipped_analyzers = 0;
+	num_skipped_reassembly = 0;
+	num_skipped_packets = 0;
+
+	if ( ! load_shedding_state )
+		load_shedding_state = internal_type("LoadShedding::State")->AsRecordType();
+	}
+
+bool LoadShedder::DoSkipAnalyzer(EnumVal* tag)
+	{
+	if ( ! analyzers->Lookup(tag) )
+		return false;
+
+	++num_skipped_analyzers;
+	return true;
+	}
+
+void LoadShedder::DoCheck()
+	{
+	double now = current_time(true);
+
+	if ( now < next_check )
+		return;
+
+	next_check = now + check_interval;
+
+	// Without a live source, the lag between packet timestamps and
+	// the wall clock doesn't say anything about the load.
+	double lag = 0.0;
+
+	if ( reading_live && ! pseudo_realtime && network_time > 0.0 )
+		lag = now - network_time;
+
+	uint64 received = 0;
+	uint64 dropped = 0;
+
+	for ( const auto& ps : iosource_mgr->GetPktSrcs() )
+		{
+		if ( ! ps->IsLive() )
+			continue;
+
+		iosource::PktSrc::Stats s;
+		ps->Statistics(&s);
+		received += s.received;
+		dropped += s.dropped;
+		}
+
+	// Sources may reset their counters, e.g. when reopened.
+	uint64 new_received = received >= last_received ? received - last_received : received;
+	uint64 new_dropped = dropped >= last_dropped ? dropped - last_dropped : dropped;
+	last_received = received;
+	last_dropped = dropped;
+
+	double drop_rate = 0.0;
+
+	if ( new_received + new_dropped > 0 )
+		drop_rate = double(new_dropped) / (new_received + new_dropped);
+
+	uint64 queued_events = num_events_queued - num_events_dispatched;
+
+	const char* reason = Overloaded(lag, drop_rate, queued_events);
+
+	if ( reason )
+		{
+		calm_checks = 0;
+
+		if ( level < max_level )
+			SetLevel(Level(level + 1), reason, lag, drop_rate, queued_events);
+
+		return;
+		}
+
+	if ( level == LEVEL_NONE || ++calm_checks < recovery_checks )
+		return;
+
+	calm_checks = 0;
+	SetLevel(Level(level - 1), "recovered", lag, drop_rate, queued_events);
+	}
+
+const char* LoadShedder::Overloaded(double lag, double drop_rate,
+				    uint64 queued_events) const
+	{
+	if ( max_lag > 0.0 && lag > max_lag )
+		return "lag";
+
+	if ( max_drop_rate > 0.0 && drop_rate > max_drop_rate )
+		return "drops";
+
+	if ( max_queued_events && queued_events > max_queued_events )
+		return "event queue";
+
+	return 0;
+	}
+
+void LoadShedder::SetLevel(Level new_level, const char* reason, double lag,
+			   double drop_rate, uint64 queued_events)
+	{
+	Level old_level = level;
+	level = new_level;
+
+	DBG_LOG(DBG_MAINLOOP, "load shedding level %d -> %d (%s)",
+		old_level, new_level, reason);
+
+	if ( ! load_shedding_level_change )
+		return;
+
+	RecordVal* r = new RecordVal(load_shedding_state);
+	int n = 0;
+	r->Assign(n++, val_mgr->GetCount(new_level));
+	r->Assign(n++, new Val(lag, TYPE_INTERVAL));
+	r->Assign(n++, new Val(drop_rate, TYPE_DOUBLE));
+	r->Assign(n++, val_mgr->GetCount(queued_events));
+	r->Assign(n++, val_mgr->GetCount(num_skipped_analyzers));
+	r->Assign(n++, val_mgr->GetCount(num_skipped_reassembly));
+	r->Assign(n++, val_mgr->GetCount(num_skipped_packets));
+
+	mgr.QueueEventFast(load_shedding_level_change, {
+		val_mgr->GetCount(old_level),
+		r,
+		new StringVal(reason),
+	});
+	}
@@ -0,0 +1,106 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef LOADSHEDDER_H
+#define LOADSHEDDER_H
+
+#include "util.h"
+#include "Hash.h"
+
+class EnumVal;
+class TableVal;
+
+// Watches for signs that we're falling behind the traffic - the packet
+// timestamps lagging the wall clock, the packet sources dropping, the
+// event queue growing - and if so, progressively does less work, as
+// configured by the LoadShedding module's options. Each level includes
+// those below it.
+class LoadShedder {
+public:
+	enum Level {
+		LEVEL_NONE = 0,		// full analysis
+		LEVEL_ANALYZERS = 1,	// don't start LoadShedding::analyzers
+		LEVEL_BULK_FLOWS = 2,	// stop reassembling bulk TCP flows
+		LEVEL_SAMPLING = 3,	// only track a sample of new connections
+	};
+
+	LoadShedder();
+
+	// Measures the load if LoadShedding::check_interval has passed
+	// since the last time, and changes the level if needed. Called
+	// once per main loop iteration.
+	void Check()
+		{
+		if ( check_interval > 0.0 )
+			DoCheck();
+		}
+
+	Level CurrentLevel() const	{ return level; }
+
+	// Returns true if an analyzer of the given tag shouldn't be
+	// instantiated at the current level.
+	bool SkipAnalyzer(EnumVal* tag)
+		{ return level >= LEVEL_ANALYZERS && DoSkipAnalyzer(tag); }
+
+	// Returns true if a TCP reassembler that has already got up to
+	// the given relative sequence number should stop.
+	bool SkipReassembly(uint64 seq)
+		{
+		if ( level < LEVEL_BULK_FLOWS || seq < bulk_flow_size )
+			return false;
+
+		++num_skipped_reassembly;
+		return true;
+		}
+
+	// Returns true if a new connection with the given key hash
+	// shouldn't be tracked at the current level. The decision is
+	// the same for all packets of a flow, and each one of them
+	// counts as skipped.
+	bool SkipConnection(hash_t hash)
+		{
+		if ( level < LEVEL_SAMPLING || sampling_rate <= 1 ||
+		     hash % sampling_rate == 0 )
+			return false;
+
+		++num_skipped_packets;
+		return true;
+		}
+
+private:
+	void DoCheck();
+	bool DoSkipAnalyzer(EnumVal* tag);
+
+	// Returns the reason for considering ourselves overloaded, or
+	// null if we're not.
+	const char* Overloaded(double lag, double drop_rate,
+			       uint64 queued_events) const;
+
+	void SetLevel(Level new_level, const char* reason, double lag,
+		      double drop_rate, uint64 queued_events);
+
+	Level level;
+	int calm_checks;	// consecutive checks below the thresholds
+	double next_check;
+
+	// Packet source counters as of the last check.
+	uint64 last_received;
+	uint64 last_dropped;
+
+	double check_interval;
+	double max_lag;
+	double max_drop_rate;
+	uint64 max_queued_events;
+	int recovery_checks;
+	Level max_level;
+	TableVal* analyzers;
+	uint64 bulk_flow_size;
+	uint64 sampling_rate;
+
+	uint64 num_skipped_analyzers;
+	uint64 num_skipped_reassembly;
+	uint64 num_skipped_packets;
+};
+
+extern LoadShedder* load_shedder;
+
+#endif
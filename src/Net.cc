@@ -27,9 +27,14 @@
 #include "Reporter.h"
 #include "Net.h"
 #include "Anon.h"
+#include "Stats.h"
+#include "LoadShedder.h"
+#include "EventRecorder.h"
 #include "PacketDumper.h"
 #include "iosource/Manager.h"
 #include "iosource/PktSrc.h"
+#include "iosource/Handoff.h"
+#include "iosource/pcap/pcap.bif.h"
 #include "iosource/PktDumper.h"
 #include "plugin/Manager.h"
 #include "broker/Manager.h"
@@ -66,6 +71,49 @@ iosource::IOSource* current_iosrc = 0;
 std::list<ScannedFile> files_scanned;
 std::vector<string> sig_files;
 
+// Real time at which the current main loop iteration's work budget runs
+// out, or 0 if there's no budget.
+static double work_deadline = 0.0;
+static bool work_budget_exceeded = false;
+
+static void start_work_budget()
+	{
+	double budget = BifConst::main_loop_work_budget;
+
+	work_deadline = (reading_live && budget > 0.0) ? current_time(true) + budget : 0.0;
+	work_budget_exceeded = false;
+	}
+
+static void end_work_budget()
+	{
+	work_deadline = 0.0;
+	work_budget_exceeded = false;
+	}
+
+bool net_work_budget_exceeded()
+	{
+	if ( ! work_deadline || work_budget_exceeded )
+		return work_budget_exceeded;
+
+	// Reading the clock for every single event or timer would add up,
+	// so we just check every few calls.
+	static unsigned int calls = 0;
+
+	if ( ++calls % 16 == 0 && current_time(true) > work_deadline )
+		work_budget_exceeded = true;
+
+	return work_budget_exceeded;
+	}
+
+bool net_verify_checksums()
+	{
+	if ( ignore_checksums )
+		return false;
+
+	return ! (trust_checksum_offload && current_pkt &&
+		  current_pkt->checksum_offloaded);
+	}
+
 RETSIGTYPE watchdog(int /* signo */)
 	{
 	if ( processing_start_time != 0.0 )
@@ -182,6 +230,15 @@ void net_init(name_list& interfaces, name_list& readfiles,
 			}
 		}
 
+	else if ( BifConst::event_replay_file->Len() )
+		{
+		// The recorded events take the place of a trace.
+		reading_live = 0;
+		reading_traces = 1;
+
+		iosource_mgr->Register(new EventReplayer(BifConst::event_replay_file->CheckString()));
+		}
+
 	else
 		// have_pending_timers = 1, possibly.  We don't set
 		// that here, though, because at this point we don't know
@@ -189,6 +246,20 @@ void net_init(name_list& interfaces, name_list& readfiles,
 		// a timer.
 		reading_traces = reading_live = 0;
 
+	if ( BifConst::Pcap::flow_handoff->Len() )
+		{
+		// Doesn't count as a source of its own, as it only carries
+		// packets while the capturing ones, here and in the other
+		// processes, are around.
+		iosource::packet_handoff = new iosource::HandoffSource(
+			BifConst::Pcap::flow_handoff->CheckString());
+		iosource_mgr->Register(iosource::packet_handoff, true);
+
+		if ( ! iosource::packet_handoff->IsOpen() )
+			reporter->FatalError("problem with packet handoff (%s)",
+					     iosource::packet_handoff->ErrorMsg());
+		}
+
 	if ( writefile )
 		{
 		pkt_dumper = iosource_mgr->OpenPktDumper(writefile, false);
@@ -208,6 +279,7 @@ void net_init(name_list& interfaces, name_list& readfiles,
 	init_ip_addr_anonymizers();
 
 	sessions = new NetSessions();
+	load_shedder = new LoadShedder();
 
 	if ( do_watchdog )
 		{
@@ -243,7 +315,10 @@ void net_packet_dispatch(double t, const Packet* pkt, iosource::PktSrc* src_ps)
 	current_iosrc = src_ps;
 	processing_start_time = t;
 
-	expire_timers(src_ps);
+		{
+		PipelineStats::Timer timer(&pipeline_stats, PipelineStats::TIMERS);
+		expire_timers(src_ps);
+		}
 
 	SegmentProfiler* sp = 0;
 
@@ -266,7 +341,11 @@ void net_packet_dispatch(double t, const Packet* pkt, iosource::PktSrc* src_ps)
 		}
 
 	sessions->NextPacket(t, pkt);
-	mgr.Drain();
+
+		{
+		PipelineStats::Timer timer(&pipeline_stats, PipelineStats::EVENTS);
+		mgr.Drain(true);
+		}
 
 	if ( sp )
 		{
@@ -308,6 +387,8 @@ void net_run()
 		current_iosrc = src;
 		auto communication_enabled = broker_mgr->Active();
 
+		start_work_budget();
+
 		if ( src )
 			src->Process();	// which will call net_packet_dispatch()
 
@@ -355,7 +436,11 @@ void net_run()
 			// Use nanosleep(2) or setitimer(2) instead.
 			}
 
-		mgr.Drain();
+		mgr.Drain(true);
+		end_work_budget();
+
+		if ( load_shedder )
+			load_shedder->Check();
 
 		processing_start_time = 0.0;	// = "we're not processing now"
 		current_dispatched = 0;
@@ -425,6 +510,11 @@ void net_finish(int drain_events)
 
 	if ( drain_events )
 		{
+		// What's checkpointed is no longer around for Drain() to
+		// finish.
+		if ( sessions && BifConst::conn_checkpoint_file->Len() )
+			sessions->CheckpointConnections(BifConst::conn_checkpoint_file->CheckString());
+
 		if ( sessions )
 			sessions->Drain();
 
@@ -449,6 +539,7 @@ void net_delete()
 	set_processing_status("TERMINATING", "net_delete");
 
 	delete sessions;
+	delete load_shedder;
 
 	for ( int i = 0; i < NUM_ADDR_ANONYMIZATION_METHODS; ++i )
 		delete ip_anonymizer[i];
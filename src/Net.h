@@ -21,6 +21,17 @@ extern void net_update_time(double new_network_time);
 extern void net_packet_dispatch(double t, const Packet* pkt,
 			iosource::PktSrc* src_ps);
 extern void expire_timers(iosource::PktSrc* src_ps = 0);
+
+// Returns true if the current iteration of the main loop has used up its
+// main_loop_work_budget, and so any further events, timers and thread
+// messages should wait for the next one.
+extern bool net_work_budget_exceeded();
+
+// Returns true if the transport-layer checksum of the current packet
+// needs verifying, i.e., unless ignore_checksums is set or the packet
+// source says its checksum offload took care of it and
+// trust_checksum_offload is set.
+extern bool net_verify_checksums();
 extern void termination_signal();
 
 // Functions to temporarily suspend processing of live input (network packets
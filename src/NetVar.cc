@@ -8,11 +8,13 @@
 RecordType* conn_id;
 RecordType* endpoint;
 RecordType* endpoint_stats;
+RecordType* reassembly_stats;
 RecordType* connection_type;
 RecordType* fa_file_type;
 RecordType* fa_metadata_type;
 RecordType* icmp_conn;
 RecordType* icmp_context;
+RecordType* icmp_flow;
 RecordType* SYN_packet;
 RecordType* pcap_packet;
 RecordType* raw_pkt_hdr_type;
@@ -24,6 +26,8 @@ TableType* string_array;
 TableType* count_set;
 VectorType* string_vec;
 VectorType* index_vec;
+VectorType* addr_vec;
+VectorType* encapsulating_conn_vector;
 VectorType* mime_matches;
 RecordType* mime_match;
 
@@ -32,6 +36,7 @@ int watchdog_interval;
 int max_timer_expires;
 
 int ignore_checksums;
+int trust_checksum_offload;
 int partial_connection_ok;
 int tcp_SYN_ack_ok;
 int tcp_match_undelivered;
@@ -52,6 +57,10 @@ int tcp_max_initial_window;
 int tcp_max_above_hole_without_any_acks;
 int tcp_excessive_data_without_further_acks;
 int tcp_max_old_segments;
+int reassembly_cap_action;
+int default_tcp_delivery_policy;
+double tcp_delivery_max_delay;
+int tcp_delivery_max_buffered;
 
 RecordType* socks_address;
 
@@ -123,6 +132,7 @@ int dns_max_queries;
 
 double stp_delta;
 double stp_idle_min;
+int stp_max_correlations;
 TableVal* stp_skip_src;
 
 double table_expire_interval;
@@ -243,11 +253,13 @@ void init_net_var()
 	conn_id = internal_type("conn_id")->AsRecordType();
 	endpoint = internal_type("endpoint")->AsRecordType();
 	endpoint_stats = internal_type("endpoint_stats")->AsRecordType();
+	reassembly_stats = internal_type("reassembly_stats")->AsRecordType();
 	connection_type = internal_type("connection")->AsRecordType();
 	fa_file_type = internal_type("fa_file")->AsRecordType();
 	fa_metadata_type = internal_type("fa_metadata")->AsRecordType();
 	icmp_conn = internal_type("icmp_conn")->AsRecordType();
 	icmp_context = internal_type("icmp_context")->AsRecordType();
+	icmp_flow = internal_type("icmp_flow")->AsRecordType();
 	signature_state = internal_type("signature_state")->AsRecordType();
 	SYN_packet = internal_type("SYN_packet")->AsRecordType();
 	pcap_packet = internal_type("pcap_packet")->AsRecordType();
@@ -258,10 +270,14 @@ void init_net_var()
 	string_array = internal_type("string_array")->AsTableType();
 	string_vec = internal_type("string_vec")->AsVectorType();
 	index_vec = internal_type("index_vec")->AsVectorType();
+	addr_vec = internal_type("addr_vec")->AsVectorType();
+	count_set = internal_type("count_set")->AsTableType();
+	encapsulating_conn_vector = internal_type("EncapsulatingConnVector")->AsVectorType();
 	mime_match = internal_type("mime_match")->AsRecordType();
 	mime_matches = internal_type("mime_matches")->AsVectorType();
 
 	ignore_checksums = opt_internal_int("ignore_checksums");
+	trust_checksum_offload = opt_internal_int("trust_checksum_offload");
 	partial_connection_ok = opt_internal_int("partial_connection_ok");
 	tcp_SYN_ack_ok = opt_internal_int("tcp_SYN_ack_ok");
 	tcp_match_undelivered = opt_internal_int("tcp_match_undelivered");
@@ -284,6 +300,12 @@ void init_net_var()
 	tcp_excessive_data_without_further_acks =
 		opt_internal_int("tcp_excessive_data_without_further_acks");
 	tcp_max_old_segments = opt_internal_int("tcp_max_old_segments");
+	reassembly_cap_action = opt_internal_int("reassembly_cap_action");
+	default_tcp_delivery_policy =
+		opt_internal_int("default_tcp_delivery_policy");
+	tcp_delivery_max_delay = opt_internal_double("tcp_delivery_max_delay");
+	tcp_delivery_max_buffered =
+		opt_internal_int("tcp_delivery_max_buffered");
 
 	socks_address = internal_type("SOCKS::Address")->AsRecordType();
 
@@ -372,6 +394,7 @@ void init_net_var()
 
 	stp_delta = opt_internal_double("stp_delta");
 	stp_idle_min = opt_internal_double("stp_idle_min");
+	stp_max_correlations = opt_internal_int("stp_max_correlations");
 	stp_skip_src = internal_val("stp_skip_src")->AsTableVal();
 
 	orig_addr_anonymization = opt_internal_int("orig_addr_anonymization");
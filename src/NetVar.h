@@ -11,11 +11,13 @@
 extern RecordType* conn_id;
 extern RecordType* endpoint;
 extern RecordType* endpoint_stats;
+extern RecordType* reassembly_stats;
 extern RecordType* connection_type;
 extern RecordType* fa_file_type;
 extern RecordType* fa_metadata_type;
 extern RecordType* icmp_conn;
 extern RecordType* icmp_context;
+extern RecordType* icmp_flow;
 extern RecordType* signature_state;
 extern RecordType* SYN_packet;
 extern RecordType* pcap_packet;
@@ -27,6 +29,8 @@ extern TableType* string_array;
 extern TableType* count_set;
 extern VectorType* string_vec;
 extern VectorType* index_vec;
+extern VectorType* addr_vec;
+extern VectorType* encapsulating_conn_vector;
 extern VectorType* mime_matches;
 extern RecordType* mime_match;
 
@@ -35,6 +39,7 @@ extern int watchdog_interval;
 extern int max_timer_expires;
 
 extern int ignore_checksums;
+extern int trust_checksum_offload;
 extern int partial_connection_ok;
 extern int tcp_SYN_ack_ok;
 extern int tcp_match_undelivered;
@@ -55,6 +60,10 @@ extern int tcp_max_initial_window;
 extern int tcp_max_above_hole_without_any_acks;
 extern int tcp_excessive_data_without_further_acks;
 extern int tcp_max_old_segments;
+extern int reassembly_cap_action;
+extern int default_tcp_delivery_policy;
+extern double tcp_delivery_max_delay;
+extern int tcp_delivery_max_buffered;
 
 extern RecordType* socks_address;
 
@@ -126,6 +135,7 @@ extern int dns_max_queries;
 
 extern double stp_delta;
 extern double stp_idle_min;
+extern int stp_max_correlations;
 extern TableVal* stp_skip_src;
 
 extern double table_expire_interval;
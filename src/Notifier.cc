@@ -19,6 +19,9 @@ notifier::Registry::~Registry()
 	{
 	while ( registrations.begin() != registrations.end() )
 		Unregister(registrations.begin()->first);
+
+	while ( element_registrations.begin() != element_registrations.end() )
+		Unregister(element_registrations.begin()->first);
 	}
 
 void notifier::Registry::Register(Modifiable* m, notifier::Receiver* r)
@@ -29,6 +32,15 @@ void notifier::Registry::Register(Modifiable* m, notifier::Receiver* r)
 	++m->num_receivers;
 	}
 
+void notifier::Registry::Register(Modifiable* m, uint64 key, notifier::Receiver* r)
+	{
+	DBG_LOG(DBG_NOTIFIERS, "registering element %" PRIu64 " of object %p for receiver %p",
+		key, m, r);
+
+	element_registrations[m].insert({key, r});
+	++m->num_receivers;
+	}
+
 void notifier::Registry::Unregister(Modifiable* m, notifier::Receiver* r)
 	{
 	DBG_LOG(DBG_NOTIFIERS, "unregistering object %p from receiver %p", m, r);
@@ -45,6 +57,31 @@ void notifier::Registry::Unregister(Modifiable* m, notifier::Receiver* r)
 		}
 	}
 
+void notifier::Registry::Unregister(Modifiable* m, uint64 key, notifier::Receiver* r)
+	{
+	DBG_LOG(DBG_NOTIFIERS, "unregistering element %" PRIu64 " of object %p from receiver %p",
+		key, m, r);
+
+	auto e = element_registrations.find(m);
+
+	if ( e == element_registrations.end() )
+		return;
+
+	auto x = e->second.equal_range(key);
+	for ( auto i = x.first; i != x.second; i++ )
+		{
+		if ( i->second == r )
+			{
+			--m->num_receivers;
+			e->second.erase(i);
+			break;
+			}
+		}
+
+	if ( e->second.empty() )
+		element_registrations.erase(e);
+	}
+
 void notifier::Registry::Unregister(Modifiable* m)
 	{
 	DBG_LOG(DBG_NOTIFIERS, "unregistering object %p from all notifiers", m);
@@ -54,6 +91,14 @@ void notifier::Registry::Unregister(Modifiable* m)
 		--i->first->num_receivers;
 
 	registrations.erase(x.first, x.second);
+
+	auto e = element_registrations.find(m);
+
+	if ( e != element_registrations.end() )
+		{
+		m->num_receivers -= e->second.size();
+		element_registrations.erase(e);
+		}
 	}
 
 void notifier::Registry::Modified(Modifiable* m)
@@ -63,6 +108,34 @@ void notifier::Registry::Modified(Modifiable* m)
 	auto x = registrations.equal_range(m);
 	for ( auto i = x.first; i != x.second; i++ )
 		i->second->Modified(m);
+
+	// Without knowing what changed, those watching elements need to
+	// hear about it as well.
+	auto e = element_registrations.find(m);
+
+	if ( e != element_registrations.end() )
+		{
+		for ( const auto& i : e->second )
+			i.second->Modified(m);
+		}
+	}
+
+void notifier::Registry::Modified(Modifiable* m, uint64 key)
+	{
+	DBG_LOG(DBG_NOTIFIERS, "element %" PRIu64 " of object %p has been modified", key, m);
+
+	auto x = registrations.equal_range(m);
+	for ( auto i = x.first; i != x.second; i++ )
+		i->second->Modified(m);
+
+	auto e = element_registrations.find(m);
+
+	if ( e == element_registrations.end() )
+		return;
+
+	auto y = e->second.equal_range(key);
+	for ( auto i = y.first; i != y.second; i++ )
+		i->second->Modified(m);
 	}
 
 notifier::Modifiable::~Modifiable()
@@ -51,6 +51,22 @@ public:
 	 */
 	void Register(Modifiable* m, Receiver* r);
 
+	/**
+	 * Registers a receiver to be informed only when a particular
+	 * element of a modifiable object has changed, such as a table entry
+	 * or a record field, or when the object signals a change without
+	 * saying which element it concerns.
+	 *
+	 * @param m object to track, as with Register() above.
+	 *
+	 * @param key element to track. How elements map to keys is up to
+	 * the object; it may map several elements to the same key, if
+	 * receivers can stand getting notified spuriously.
+	 *
+	 * @param r receiver to notify on changes, as with Register() above.
+	 */
+	void Register(Modifiable* m, uint64 key, Receiver* r);
+
 	/**
 	 * Cancels a receiver's request to be informed about an object's
 	 * modification. The arguments to the method must match what was
@@ -62,6 +78,19 @@ public:
 	 */
 	void Unregister(Modifiable* m, Receiver* Receiver);
 
+	/**
+	 * Cancels a receiver's request to be informed about an element's
+	 * modification. The arguments to the method must match what was
+	 * originally registered.
+	 *
+	 * @param m object to no longer track.
+	 *
+	 * @param key element to no longer track.
+	 *
+	 * @param r receiver to no longer notify.
+	 */
+	void Unregister(Modifiable* m, uint64 key, Receiver* r);
+
 	/**
 	 * Cancels any active receiver requests to be informed about a
 	 * partilar object's modifications.
@@ -77,8 +106,16 @@ private:
 	// Will be called from the object itself.
 	void Modified(Modifiable* m);
 
+	// Inform the receivers of a modification to one of an object's
+	// elements.
+	void Modified(Modifiable* m, uint64 key);
+
 	typedef std::unordered_multimap<Modifiable*, Receiver*> ModifiableMap;
 	ModifiableMap registrations;
+
+	// Receivers registered for individual elements, by object.
+	typedef std::unordered_multimap<uint64, Receiver*> ElementMap;
+	std::unordered_map<Modifiable*, ElementMap> element_registrations;
 };
 
 /**
@@ -102,6 +139,19 @@ public:
 			registry.Modified(this);
 		}
 
+	/**
+	 * Calling this method signals to all registered receivers that one
+	 * of the object's elements has been modified. Receivers registered
+	 * for other elements don't get notified.
+	 *
+	 * @param key element modified; see Registry::Register().
+	 */
+	void Modified(uint64 key)
+		{
+		if ( num_receivers )
+			registry.Modified(this, key);
+		}
+
 protected:
 	friend class Registry;
 
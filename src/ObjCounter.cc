@@ -0,0 +1,23 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "ObjCounter.h"
+
+ObjCounter::ObjCounter(const char* arg_name, size_t arg_obj_size)
+	{
+	name = arg_name;
+	obj_size = arg_obj_size;
+
+	// The counts are left alone: counters have static storage, so they
+	// start out zeroed, and instances of counted classes that are
+	// created during static initialization may have bumped them already.
+
+	const_cast<std::vector<const ObjCounter*>&>(Counters()).push_back(this);
+	}
+
+const std::vector<const ObjCounter*>& ObjCounter::Counters()
+	{
+	static std::vector<const ObjCounter*>* counters = new std::vector<const ObjCounter*>;
+	return *counters;
+	}
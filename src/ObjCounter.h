@@ -0,0 +1,67 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef objcounter_h
+#define objcounter_h
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "util.h"
+
+// Counts the live instances of a class, for attributing memory growth in
+// long-running processes. Classes opt in by deriving from CountedObj<cls>
+// and placing DECLARE_OBJ_COUNTER/IMPLEMENT_OBJ_COUNTER next to the class
+// definition and implementation; CountedObj is empty, so this doesn't add
+// to the size of the instances, and it covers all constructors. Instances
+// of derived classes count toward the class that opted in.
+//
+// Counting costs an increment per construction and destruction, which is
+// cheap enough to be always on. Counters aren't synchronized, so counted
+// classes must only be instantiated by the main thread.
+//
+// Counters are never destroyed, so that objects may still be released
+// during shutdown.
+class ObjCounter {
+public:
+	ObjCounter(const char* name, size_t obj_size);
+
+	const char* Name() const	{ return name; }
+	size_t ObjSize() const	{ return obj_size; }
+
+	// Number of instances currently alive.
+	uint64 Live() const	{ return live; }
+
+	// Number of instances created so far.
+	uint64 Created() const	{ return created; }
+
+	void Inc()	{ ++live; ++created; }
+	void Dec()	{ --live; }
+
+	// Returns all counters that have been set up.
+	static const std::vector<const ObjCounter*>& Counters();
+
+private:
+	const char* name;
+	size_t obj_size;
+	uint64 live;
+	uint64 created;
+};
+
+template <class T>
+class CountedObj {
+protected:
+	CountedObj()	{ T::obj_counter.Inc(); }
+	CountedObj(const CountedObj&)	{ T::obj_counter.Inc(); }
+	~CountedObj()	{ T::obj_counter.Dec(); }
+};
+
+// To be placed into the public section of a class definition.
+#define DECLARE_OBJ_COUNTER() \
+	static ObjCounter obj_counter;
+
+// To be placed into the source file implementing the class.
+#define IMPLEMENT_OBJ_COUNTER(cls) \
+	ObjCounter cls::obj_counter(#cls, sizeof(cls));
+
+#endif
@@ -0,0 +1,208 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "ObjPool.h"
+
+// Size of a slab. Slabs are aligned to their size, so that we can get from
+// an object to its slab by masking the address.
+static const size_t SLAB_SIZE = 64 * 1024;
+
+// Alignment we guarantee for objects.
+static const size_t SLOT_ALIGN = 16;
+
+// Pools with fewer slots per slab than this don't pay off; they hand all
+// requests to malloc().
+static const uint32 MIN_SLOTS_PER_SLAB = 8;
+
+// Number of completely free slabs a pool holds on to.
+static const size_t MAX_EMPTY_SLABS = 4;
+
+struct ObjPool::Slab {
+	Slab* prev;
+	Slab* next;
+
+	// Slots released back to this slab.
+	void* free_list;
+
+	// Number of slots handed out.
+	uint32 used;
+
+	// Number of slots at the start of the slab that have ever been
+	// handed out; the ones beyond haven't been touched yet.
+	uint32 fresh;
+};
+
+// Slots start right after the header.
+static const size_t SLAB_HEADER_SIZE = 64;
+
+ObjPool::ObjPool(const char* arg_name, size_t arg_obj_size, Category arg_category)
+	{
+	name = arg_name;
+	category = arg_category;
+	obj_size = arg_obj_size;
+	slot_size = (obj_size + SLOT_ALIGN - 1) & ~(SLOT_ALIGN - 1);
+
+	if ( slot_size < sizeof(void*) )
+		slot_size = sizeof(void*);
+
+	slots_per_slab = (SLAB_SIZE - SLAB_HEADER_SIZE) / slot_size;
+
+#ifdef USE_PERFTOOLS_DEBUG
+	// Let the leak checker see individual objects.
+	slots_per_slab = 0;
+#endif
+
+	if ( slots_per_slab < MIN_SLOTS_PER_SLAB )
+		slots_per_slab = 0;
+
+	available = 0;
+	num_slabs = num_empty_slabs = in_use = 0;
+	num_allocs = 0;
+
+	// The registry is a function-local static, so it's there regardless
+	// of the order in which static pools get constructed.
+	const_cast<std::vector<const ObjPool*>&>(Pools()).push_back(this);
+	}
+
+const std::vector<const ObjPool*>& ObjPool::Pools()
+	{
+	static std::vector<const ObjPool*>* pools = new std::vector<const ObjPool*>;
+	return *pools;
+	}
+
+size_t ObjPool::MemoryAllocation() const
+	{
+	return num_slabs * SLAB_SIZE;
+	}
+
+void* ObjPool::Alloc(size_t size)
+	{
+	++num_allocs;
+
+	if ( size != obj_size || ! slots_per_slab )
+		{
+		void* p = malloc(size);
+
+		if ( ! p )
+			out_of_memory("allocating object");
+
+		if ( size == obj_size )
+			++in_use;
+
+		return p;
+		}
+
+	Slab* s = available;
+
+	if ( ! s )
+		s = NewSlab();
+
+	void* p;
+
+	if ( s->free_list )
+		{
+		p = s->free_list;
+		s->free_list = *reinterpret_cast<void**>(p);
+		}
+	else
+		p = reinterpret_cast<u_char*>(s) + SLAB_HEADER_SIZE + s->fresh++ * slot_size;
+
+	if ( s->used++ == 0 )
+		--num_empty_slabs;
+
+	if ( s->used == slots_per_slab )
+		Unlink(s);
+
+	++in_use;
+	return p;
+	}
+
+void ObjPool::Free(void* p, size_t size)
+	{
+	if ( ! p )
+		return;
+
+	if ( size != obj_size || ! slots_per_slab )
+		{
+		if ( size == obj_size )
+			--in_use;
+
+		free(p);
+		return;
+		}
+
+	Slab* s = reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(p) & ~(SLAB_SIZE - 1));
+
+	*reinterpret_cast<void**>(p) = s->free_list;
+	s->free_list = p;
+
+	if ( s->used-- == slots_per_slab )
+		// It's got room again.
+		Link(s);
+
+	--in_use;
+
+	if ( s->used )
+		return;
+
+	if ( num_empty_slabs >= MAX_EMPTY_SLABS )
+		ReleaseSlab(s);
+	else
+		++num_empty_slabs;
+	}
+
+ObjPool::Slab* ObjPool::NewSlab()
+	{
+	void* m;
+
+	if ( posix_memalign(&m, SLAB_SIZE, SLAB_SIZE) != 0 )
+		out_of_memory("allocating object pool slab");
+
+	static_assert(sizeof(Slab) <= SLAB_HEADER_SIZE, "slab header too large");
+
+	Slab* s = reinterpret_cast<Slab*>(m);
+	s->prev = s->next = 0;
+	s->free_list = 0;
+	s->used = s->fresh = 0;
+
+	Link(s);
+	++num_slabs;
+	++num_empty_slabs;
+
+	return s;
+	}
+
+void ObjPool::ReleaseSlab(Slab* s)
+	{
+	Unlink(s);
+	--num_slabs;
+	free(s);
+	}
+
+void ObjPool::Link(Slab* s)
+	{
+	s->prev = 0;
+	s->next = available;
+
+	if ( available )
+		available->prev = s;
+
+	available = s;
+	}
+
+void ObjPool::Unlink(Slab* s)
+	{
+	if ( s->prev )
+		s->prev->next = s->next;
+	else
+		available = s->next;
+
+	if ( s->next )
+		s->next->prev = s->prev;
+
+	s->prev = s->next = 0;
+	}
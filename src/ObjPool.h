@@ -0,0 +1,98 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef objpool_h
+#define objpool_h
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "util.h"
+
+// A pool allocator for objects of a single, fixed size. Objects are carved
+// out of aligned slabs, each of which keeps its own free list; once all the
+// objects of a slab have been released, the slab goes back to the system
+// (except for a few kept around to absorb the next burst). Compared to
+// individual heap allocations this keeps per-connection state densely
+// packed and stops floods of short-lived connections from fragmenting the
+// heap.
+//
+// Classes opt in through DECLARE_POOLED_ALLOC/IMPLEMENT_POOLED_ALLOC, which
+// route their operator new/delete through a pool. Requests of any other
+// size, such as for a derived class, are passed on to malloc().
+//
+// Pools are never destroyed, so that objects may still be released during
+// shutdown.
+class ObjPool {
+public:
+	// What a pool's objects belong to.
+	enum Category {
+		CONNECTION,	// connections and their timers
+		ANALYZER,	// per-connection protocol analyzer state
+		OTHER,	// everything else, such as script values
+	};
+
+	ObjPool(const char* name, size_t obj_size, Category category);
+
+	// Returns memory for one object of the given size.
+	void* Alloc(size_t size);
+
+	// Releases memory returned by Alloc() for the same size.
+	void Free(void* p, size_t size);
+
+	const char* Name() const	{ return name; }
+	size_t ObjSize() const	{ return obj_size; }
+	Category GetCategory() const	{ return category; }
+
+	// Number of objects currently handed out.
+	size_t InUse() const	{ return in_use; }
+
+	// Number of Alloc() calls so far, including those of other sizes
+	// that were passed on to malloc().
+	uint64 Allocations() const	{ return num_allocs; }
+
+	// Number of slabs currently allocated.
+	size_t Slabs() const	{ return num_slabs; }
+
+	// Number of bytes currently taken from the system.
+	size_t MemoryAllocation() const;
+
+	// Returns all pools that have been set up.
+	static const std::vector<const ObjPool*>& Pools();
+
+private:
+	struct Slab;
+
+	Slab* NewSlab();
+	void ReleaseSlab(Slab* s);
+	void Link(Slab* s);
+	void Unlink(Slab* s);
+
+	const char* name;
+	Category category;
+	size_t obj_size;	// requested object size
+	size_t slot_size;	// object size rounded up for alignment
+	uint32 slots_per_slab;
+
+	// Slabs that have at least one free slot.
+	Slab* available;
+
+	size_t num_slabs;
+	size_t num_empty_slabs;
+	size_t in_use;
+	uint64 num_allocs;
+};
+
+// To be placed into the public section of a class definition to have its
+// instances allocated from a pool.
+#define DECLARE_POOLED_ALLOC() \
+	static void* operator new(size_t size)	{ return obj_pool.Alloc(size); } \
+	static void operator delete(void* p, size_t size)	{ obj_pool.Free(p, size); } \
+	static ObjPool obj_pool;
+
+// To be placed into the source file implementing the class, with the
+// pool's ObjPool::Category.
+#define IMPLEMENT_POOLED_ALLOC(cls, category) \
+	ObjPool cls::obj_pool(#cls, sizeof(cls), ObjPool::category);
+
+#endif
@@ -3,8 +3,10 @@
 #include "OpaqueVal.h"
 #include "NetVar.h"
 #include "Reporter.h"
+#include "PrefixTable.h"
 #include "probabilistic/BloomFilter.h"
 #include "probabilistic/CardinalityCounter.h"
+#include "probabilistic/CountMinSketch.h"
 
 #include <broker/error.hh>
 
@@ -640,7 +642,8 @@ bool SHA256Val::DoUnserialize(const broker::data& data)
 	return true;
 	}
 
-EntropyVal::EntropyVal() : OpaqueVal(entropy_type)
+EntropyVal::EntropyVal(bool histogram_only)
+	: OpaqueVal(entropy_type), state(histogram_only)
 	{
 	}
 
@@ -687,6 +690,7 @@ broker::expected<broker::data> EntropyVal::DoSerialize() const
         for ( int i = 0; i < RT_MONTEN; ++i )
 		d.emplace_back(static_cast<uint64>(state.monte[i]));
 
+	d.emplace_back(state.histogram_only);
 	return {std::move(d)};
 	}
 
@@ -737,6 +741,11 @@ bool EntropyVal::DoUnserialize(const broker::data& data)
 			return false;
 		}
 
+	// Absent from what older versions serialized.
+	if ( d->size() > 14 + 256 + RT_MONTEN &&
+	     ! get_vector_idx<bool>(*d, 14 + 256 + RT_MONTEN, &state.histogram_only) )
+		return false;
+
 	return true;
 	}
 
@@ -1022,6 +1031,122 @@ bool CardinalityVal::DoUnserialize(const broker::data& data)
 	return true;
 	}
 
+CountMinVal::CountMinVal() : OpaqueVal(countmin_type)
+	{
+	sketch = 0;
+	type = 0;
+	hash = 0;
+	}
+
+CountMinVal::CountMinVal(probabilistic::CountMinSketch* arg_sketch)
+	: OpaqueVal(countmin_type)
+	{
+	sketch = arg_sketch;
+	type = 0;
+	hash = 0;
+	}
+
+CountMinVal::~CountMinVal()
+	{
+	Unref(type);
+	delete sketch;
+	delete hash;
+	}
+
+Val* CountMinVal::DoClone(CloneState* state)
+	{
+	auto cv = new CountMinVal(new probabilistic::CountMinSketch(*sketch));
+
+	if ( type )
+		cv->Typify(type);
+
+	return state->NewClone(this, cv);
+	}
+
+bool CountMinVal::Typify(BroType* arg_type)
+	{
+	if ( type )
+		return false;
+
+	type = arg_type;
+	type->Ref();
+
+	TypeList* tl = new TypeList(type);
+	tl->Append(type->Ref());
+	hash = new CompositeHash(tl);
+	Unref(tl);
+
+	return true;
+	}
+
+BroType* CountMinVal::Type() const
+	{
+	return type;
+	}
+
+void CountMinVal::Add(const Val* val, uint64 count)
+	{
+	HashKey* key = hash->ComputeHash(val, 1);
+	sketch->Add(key, count);
+	delete key;
+	}
+
+uint64 CountMinVal::Estimate(const Val* val) const
+	{
+	HashKey* key = hash->ComputeHash(val, 1);
+	uint64 estimate = sketch->Estimate(key);
+	delete key;
+	return estimate;
+	}
+
+IMPLEMENT_OPAQUE_VALUE(CountMinVal)
+
+broker::expected<broker::data> CountMinVal::DoSerialize() const
+	{
+	broker::vector d;
+
+	if ( type )
+		{
+		auto t = SerializeType(type);
+		if ( ! t )
+			return broker::ec::invalid_data;
+
+		d.emplace_back(std::move(*t));
+		}
+	else
+		d.emplace_back(broker::none());
+
+	auto s = sketch->Serialize();
+	if ( ! s )
+		return broker::ec::invalid_data;
+
+	d.emplace_back(*s);
+	return {std::move(d)};
+	}
+
+bool CountMinVal::DoUnserialize(const broker::data& data)
+	{
+	auto v = caf::get_if<broker::vector>(&data);
+
+	if ( ! (v && v->size() == 2) )
+		return false;
+
+	auto no_type = caf::get_if<broker::none>(&(*v)[0]);
+	if ( ! no_type )
+		{
+		BroType* t = UnserializeType((*v)[0]);
+		if ( ! (t && Typify(t)) )
+			return false;
+		}
+
+	auto s = probabilistic::CountMinSketch::Unserialize((*v)[1]);
+	if ( ! s )
+		return false;
+
+	sketch = s.release();
+	return true;
+	}
+
 ParaglobVal::ParaglobVal(std::unique_ptr<paraglob::Paraglob> p)
 : OpaqueVal(paraglob_type)
 	{
@@ -1089,6 +1214,73 @@ bool ParaglobVal::DoUnserialize(const broker::data& data)
 	return true;
 	}
 
+StreamMatcherVal::StreamMatcherVal() : OpaqueVal(stream_matcher_type)
+	{
+	pattern = 0;
+	state = 0;
+	offset = 0;
+	matched = false;
+	}
+
+StreamMatcherVal::StreamMatcherVal(PatternVal* p) : OpaqueVal(stream_matcher_type)
+	{
+	pattern = p;
+	pattern->Ref();
+	state = new RE_Match_State(pattern->AsPattern()->AnywhereMatcher());
+	offset = 0;
+	matched = false;
+	}
+
+StreamMatcherVal::~StreamMatcherVal()
+	{
+	delete state;
+	Unref(pattern);
+	}
+
+bool StreamMatcherVal::Feed(const BroString* data)
+	{
+	if ( matched || ! state )
+		return matched;
+
+	state->Match(data->Bytes(), data->Len(), offset == 0, false, false);
+	offset += data->Len();
+
+	matched = ! state->AcceptedMatches().empty();
+	return matched;
+	}
+
+void StreamMatcherVal::Reset()
+	{
+	if ( state )
+		state->Clear();
+
+	offset = 0;
+	matched = false;
+	}
+
+Val* StreamMatcherVal::DoClone(CloneState* clone_state)
+	{
+	StreamMatcherVal* v = new StreamMatcherVal(pattern);
+	if ( state )
+		*v->state = *state;
+
+	v->offset = offset;
+	v->matched = matched;
+	return clone_state->NewClone(this, v);
+	}
+
+IMPLEMENT_OPAQUE_VALUE(StreamMatcherVal)
+
+broker::expected<broker::data> StreamMatcherVal::DoSerialize() const
+	{
+	return broker::ec::invalid_data;
+	}
+
+bool StreamMatcherVal::DoUnserialize(const broker::data& data)
+	{
+	return false;
+	}
+
 Val* ParaglobVal::DoClone(CloneState* state)
 	{
 	try {
@@ -1106,3 +1298,214 @@ Val* ParaglobVal::DoClone(CloneState* state)
 		return nullptr;
 		}
 	}
+
+IntelIndexVal::IntelIndexVal() : OpaqueVal(intel_index_type)
+	{
+	prefix_table = new PrefixTable();
+	}
+
+IntelIndexVal::~IntelIndexVal()
+	{
+	delete prefix_table;
+	}
+
+std::string IntelIndexVal::Key(const BroString* s)
+	{
+	std::string key(reinterpret_cast<const char*>(s->Bytes()), s->Len());
+
+	for ( auto& c : key )
+		c = tolower(static_cast<unsigned char>(c));
+
+	return key;
+	}
+
+bool IntelIndexVal::InsertPrefix(const IPPrefix& p, bool subnet)
+	{
+	int flag = subnet ? PREFIX_SUBNET : PREFIX_ADDR;
+	int& flags = prefixes[p];
+
+	if ( flags & flag )
+		return false;
+
+	if ( ! flags )
+		prefix_table->Insert(p.Prefix(), p.LengthIPv6(), this);
+
+	flags |= flag;
+	return true;
+	}
+
+bool IntelIndexVal::RemovePrefix(const IPPrefix& p, bool subnet)
+	{
+	int flag = subnet ? PREFIX_SUBNET : PREFIX_ADDR;
+	auto i = prefixes.find(p);
+
+	if ( i == prefixes.end() || ! (i->second & flag) )
+		return false;
+
+	i->second &= ~flag;
+
+	if ( ! i->second )
+		{
+		prefix_table->Remove(p.Prefix(), p.LengthIPv6());
+		prefixes.erase(i);
+		}
+
+	return true;
+	}
+
+bool IntelIndexVal::HasPrefix(const IPPrefix& p, bool subnet) const
+	{
+	auto i = prefixes.find(p);
+	return i != prefixes.end() &&
+		(i->second & (subnet ? PREFIX_SUBNET : PREFIX_ADDR));
+	}
+
+bool IntelIndexVal::InsertString(bro_int_t type, const BroString* s)
+	{
+	return strings[type].insert(Key(s)).second;
+	}
+
+bool IntelIndexVal::RemoveString(bro_int_t type, const BroString* s)
+	{
+	auto i = strings.find(type);
+
+	if ( i == strings.end() )
+		return false;
+
+	return i->second.erase(Key(s)) > 0;
+	}
+
+bool IntelIndexVal::MatchAddr(const IPAddr& a) const
+	{
+	return ! prefixes.empty() && prefix_table->Lookup(a, 128) != 0;
+	}
+
+const std::string* IntelIndexVal::MatchString(bro_int_t type, const BroString* s,
+					      bool suffixes) const
+	{
+	auto i = strings.find(type);
+
+	if ( i == strings.end() || i->second.empty() )
+		return 0;
+
+	const StringSet& set = i->second;
+	std::string key = Key(s);
+
+	auto j = set.find(key);
+
+	if ( j != set.end() )
+		return &*j;
+
+	if ( ! suffixes )
+		return 0;
+
+	for ( auto dot = key.find('.'); dot != std::string::npos;
+	      dot = key.find('.', dot + 1) )
+		{
+		j = set.find(key.substr(dot + 1));
+
+		if ( j != set.end() )
+			return &*j;
+		}
+
+	return 0;
+	}
+
+uint64 IntelIndexVal::Size() const
+	{
+	uint64 n = 0;
+
+	for ( const auto& p : prefixes )
+		{
+		if ( p.second & PREFIX_ADDR )
+			++n;
+		if ( p.second & PREFIX_SUBNET )
+			++n;
+		}
+
+	for ( const auto& s : strings )
+		n += s.second.size();
+
+	return n;
+	}
+
+Val* IntelIndexVal::DoClone(CloneState* state)
+	{
+	IntelIndexVal* v = new IntelIndexVal();
+
+	for ( const auto& p : prefixes )
+		v->prefix_table->Insert(p.first.Prefix(), p.first.LengthIPv6(), v);
+
+	v->prefixes = prefixes;
+	v->strings = strings;
+	return state->NewClone(this, v);
+	}
+
+IMPLEMENT_OPAQUE_VALUE(IntelIndexVal)
+
+broker::expected<broker::data> IntelIndexVal::DoSerialize() const
+	{
+	broker::vector p;
+
+	for ( const auto& i : prefixes )
+		{
+		in6_addr tmp;
+		i.first.Prefix().CopyIPv6(&tmp);
+		auto a = broker::address(reinterpret_cast<const uint32_t*>(&tmp),
+		                         broker::address::family::ipv6,
+		                         broker::address::byte_order::network);
+		p.emplace_back(broker::subnet(std::move(a), i.first.Length()));
+		p.emplace_back(static_cast<uint64_t>(i.second));
+		}
+
+	broker::vector s;
+
+	for ( const auto& i : strings )
+		{
+		for ( const auto& str : i.second )
+			{
+			s.emplace_back(static_cast<int64_t>(i.first));
+			s.emplace_back(str);
+			}
+		}
+
+	return {broker::vector{std::move(p), std::move(s)}};
+	}
+
+bool IntelIndexVal::DoUnserialize(const broker::data& data)
+	{
+	auto v = caf::get_if<broker::vector>(&data);
+	if ( ! (v && v->size() == 2) )
+		return false;
+
+	auto p = caf::get_if<broker::vector>(&(*v)[0]);
+	auto s = caf::get_if<broker::vector>(&(*v)[1]);
+	if ( ! (p && s && p->size() % 2 == 0 && s->size() % 2 == 0) )
+		return false;
+
+	for ( size_t i = 0; i < p->size(); i += 2 )
+		{
+		auto net = caf::get_if<broker::subnet>(&(*p)[i]);
+		auto flags = caf::get_if<uint64_t>(&(*p)[i + 1]);
+		if ( ! (net && flags) )
+			return false;
+
+		auto bits = reinterpret_cast<const in6_addr*>(&net->network().bytes());
+		IPPrefix prefix(IPAddr(*bits), net->length());
+
+		prefixes[prefix] = *flags;
+		prefix_table->Insert(prefix.Prefix(), prefix.LengthIPv6(), this);
+		}
+
+	for ( size_t i = 0; i < s->size(); i += 2 )
+		{
+		auto type = caf::get_if<int64_t>(&(*s)[i]);
+		auto str = caf::get_if<std::string>(&(*s)[i + 1]);
+		if ( ! (type && str) )
+			return false;
+
+		strings[*type].insert(*str);
+		}
+
+	return true;
+	}
@@ -3,6 +3,10 @@
 #ifndef OPAQUEVAL_H
 #define OPAQUEVAL_H
 
+#include <map>
+#include <string>
+#include <unordered_set>
+
 #include <broker/data.hh>
 #include <broker/expected.hh>
 
@@ -12,6 +16,7 @@
 #include "src/paraglob.h"
 
 class OpaqueVal;
+class PrefixTable;
 
 /**
   * Singleton that registers all available all available types of opaque
@@ -155,6 +160,7 @@ protected:
 namespace probabilistic {
 	class BloomFilter;
 	class CardinalityCounter;
+	class CountMinSketch;
 }
 
 class HashVal : public OpaqueVal {
@@ -246,7 +252,7 @@ private:
 
 class EntropyVal : public OpaqueVal {
 public:
-	EntropyVal();
+	explicit EntropyVal(bool histogram_only = false);
 
 	bool Feed(const void* data, size_t size);
 	bool Get(double *r_ent, double *r_chisq, double *r_mean,
@@ -320,6 +326,31 @@ private:
 	probabilistic::CardinalityCounter* c;
 };
 
+class CountMinVal: public OpaqueVal {
+public:
+	explicit CountMinVal(probabilistic::CountMinSketch*);
+	~CountMinVal() override;
+
+	Val* DoClone(CloneState* state) override;
+
+	void Add(const Val* val, uint64 count);
+	uint64 Estimate(const Val* val) const;
+
+	BroType* Type() const;
+	bool Typify(BroType* type);
+
+	probabilistic::CountMinSketch* Get()	{ return sketch; };
+
+protected:
+	CountMinVal();
+
+	DECLARE_OPAQUE_VALUE(CountMinVal)
+private:
+	BroType* type;
+	CompositeHash* hash;
+	probabilistic::CountMinSketch* sketch;
+};
+
 class ParaglobVal : public OpaqueVal {
 public:
 	explicit ParaglobVal(std::unique_ptr<paraglob::Paraglob> p);
@@ -336,4 +367,138 @@ private:
 	std::unique_ptr<paraglob::Paraglob> internal_paraglob;
 };
 
+/**
+ * Matches a pattern incrementally against a stream fed in chunks, keeping
+ * the DFA state in between so that each byte gets looked at only once.
+ * A matcher's state is local to the process, so it can't be serialized.
+ */
+class StreamMatcherVal : public OpaqueVal {
+public:
+	explicit StreamMatcherVal(PatternVal* p);
+	~StreamMatcherVal() override;
+
+	/**
+	 * Feeds the next chunk of the stream into the matcher.
+	 *
+	 * @return True if the pattern has matched anywhere in the data fed
+	 * so far.
+	 */
+	bool Feed(const BroString* data);
+
+	/**
+	 * Starts matching a new stream.
+	 */
+	void Reset();
+
+	bool Matched() const	{ return matched; }
+
+	Val* DoClone(CloneState* state) override;
+
+protected:
+	StreamMatcherVal();
+
+	DECLARE_OPAQUE_VALUE(StreamMatcherVal)
+
+private:
+	PatternVal* pattern;
+	RE_Match_State* state;
+	uint64 offset;
+	bool matched;
+};
+
+/**
+ * An index of intelligence indicators that answers whether something seen
+ * is known, without allocating any values when it isn't. Addresses and
+ * subnets go into a prefix table, strings into a set per indicator type,
+ * folded to lower case. Each indicator is kept only once, however many
+ * sources supply it.
+ */
+class IntelIndexVal : public OpaqueVal {
+public:
+	IntelIndexVal();
+	~IntelIndexVal() override;
+
+	/**
+	 * Adds an address or subnet indicator.
+	 *
+	 * @param p The prefix; a single address has the full width.
+	 *
+	 * @param subnet True if the indicator is a subnet, false if it's an
+	 * address. The two are told apart even if their prefixes are equal.
+	 *
+	 * @return False if the indicator was present already.
+	 */
+	bool InsertPrefix(const IPPrefix& p, bool subnet);
+
+	/**
+	 * Removes an address or subnet indicator.
+	 *
+	 * @return False if the indicator wasn't present.
+	 */
+	bool RemovePrefix(const IPPrefix& p, bool subnet);
+
+	/**
+	 * Returns true if an address or subnet indicator is present, exactly.
+	 */
+	bool HasPrefix(const IPPrefix& p, bool subnet) const;
+
+	/**
+	 * Adds a string indicator of a given type.
+	 *
+	 * @return False if the indicator was present already.
+	 */
+	bool InsertString(bro_int_t type, const BroString* s);
+
+	/**
+	 * Removes a string indicator of a given type.
+	 *
+	 * @return False if the indicator wasn't present.
+	 */
+	bool RemoveString(bro_int_t type, const BroString* s);
+
+	/**
+	 * Returns true if an address is an indicator itself or falls into a
+	 * subnet indicator.
+	 */
+	bool MatchAddr(const IPAddr& a) const;
+
+	/**
+	 * Looks up a string of a given type, ignoring case.
+	 *
+	 * @param suffixes If true and the string itself isn't an indicator,
+	 * also looks up its suffixes following a dot, from the longest, so
+	 * that a domain matches its parent domains.
+	 *
+	 * @return The matching indicator, in lower case, or null if there's
+	 * none.
+	 */
+	const std::string* MatchString(bro_int_t type, const BroString* s,
+				       bool suffixes) const;
+
+	/**
+	 * Returns the number of indicators.
+	 */
+	uint64 Size() const;
+
+	Val* DoClone(CloneState* state) override;
+
+protected:
+	DECLARE_OPAQUE_VALUE(IntelIndexVal)
+
+private:
+	enum { PREFIX_ADDR = 1, PREFIX_SUBNET = 2 };
+
+	typedef std::unordered_set<std::string> StringSet;
+
+	static std::string Key(const BroString* s);
+
+	// The prefix table only answers lookups; this is the list of what's
+	// in there, with flags saying whether a prefix is an address, a
+	// subnet, or both.
+	std::map<IPPrefix, int> prefixes;
+	PrefixTable* prefix_table;
+
+	std::map<bro_int_t, StringSet> strings;	// Indexed by type.
+};
+
 #endif
@@ -1,11 +1,18 @@
 #include "PacketFilter.h"
 
+bool PacketFilter::DeleteFilter(void* f)
+	{
+	delete (Filter*) f;
+	return f != 0;
+	}
+
 void PacketFilter::AddSrc(const IPAddr& src, uint32 tcp_flags, double probability)
 	{
 	Filter* f = new Filter;
 	f->tcp_flags = tcp_flags;
 	f->probability = uint32(probability * RAND_MAX);
-	src_filter.Insert(src, 128, f);
+	if ( ! DeleteFilter(src_filter.Insert(src, 128, f)) )
+		++num_src_filters;
 	}
 
 void PacketFilter::AddSrc(Val* src, uint32 tcp_flags, double probability)
@@ -13,7 +20,8 @@ void PacketFilter::AddSrc(Val* src, uint32 tcp_flags, double probability)
 	Filter* f = new Filter;
 	f->tcp_flags = tcp_flags;
 	f->probability = uint32(probability * RAND_MAX);
-	src_filter.Insert(src, f);
+	if ( ! DeleteFilter(src_filter.Insert(src, f)) )
+		++num_src_filters;
 	}
 
 void PacketFilter::AddDst(const IPAddr& dst, uint32 tcp_flags, double probability)
@@ -21,7 +29,8 @@ void PacketFilter::AddDst(const IPAddr& dst, uint32 tcp_flags, double probabilit
 	Filter* f = new Filter;
 	f->tcp_flags = tcp_flags;
 	f->probability = uint32(probability * RAND_MAX);
-	dst_filter.Insert(dst, 128, f);
+	if ( ! DeleteFilter(dst_filter.Insert(dst, 128, f)) )
+		++num_dst_filters;
 	}
 
 void PacketFilter::AddDst(Val* dst, uint32 tcp_flags, double probability)
@@ -29,36 +38,55 @@ void PacketFilter::AddDst(Val* dst, uint32 tcp_flags, double probability)
 	Filter* f = new Filter;
 	f->tcp_flags = tcp_flags;
 	f->probability = uint32(probability * RAND_MAX);
-	dst_filter.Insert(dst, f);
+	if ( ! DeleteFilter(dst_filter.Insert(dst, f)) )
+		++num_dst_filters;
 	}
 
 bool PacketFilter::RemoveSrc(const IPAddr& src)
 	{
-	return src_filter.Remove(src, 128) != 0;
+	if ( ! DeleteFilter(src_filter.Remove(src, 128)) )
+		return false;
+
+	--num_src_filters;
+	return true;
 	}
 
 bool PacketFilter::RemoveSrc(Val* src)
 	{
-	return src_filter.Remove(src) != NULL;
+	if ( ! DeleteFilter(src_filter.Remove(src)) )
+		return false;
+
+	--num_src_filters;
+	return true;
 	}
 
 bool PacketFilter::RemoveDst(const IPAddr& dst)
 	{
-	return dst_filter.Remove(dst, 128) != NULL;
+	if ( ! DeleteFilter(dst_filter.Remove(dst, 128)) )
+		return false;
+
+	--num_dst_filters;
+	return true;
 	}
 
 bool PacketFilter::RemoveDst(Val* dst)
 	{
-	return dst_filter.Remove(dst) != NULL;
+	if ( ! DeleteFilter(dst_filter.Remove(dst)) )
+		return false;
+
+	--num_dst_filters;
+	return true;
 	}
 
 bool PacketFilter::Match(const IP_Hdr* ip, int len, int caplen)
 	{
-	Filter* f = (Filter*) src_filter.Lookup(ip->SrcAddr(), 128);
+	Filter* f = num_src_filters ?
+		(Filter*) src_filter.Lookup(ip->SrcAddr(), 128) : 0;
 	if ( f )
 		return MatchFilter(*f, *ip, len, caplen);
 
-	f = (Filter*) dst_filter.Lookup(ip->DstAddr(), 128);
+	f = num_dst_filters ?
+		(Filter*) dst_filter.Lookup(ip->DstAddr(), 128) : 0;
 	if ( f )
 		return MatchFilter(*f, *ip, len, caplen);
 
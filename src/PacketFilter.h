@@ -8,7 +8,8 @@
 
 class PacketFilter {
 public:
-	explicit PacketFilter(bool arg_default)	{ default_match = arg_default; }
+	explicit PacketFilter(bool arg_default)
+		{ default_match = arg_default; num_src_filters = num_dst_filters = 0; }
 	~PacketFilter()	{}
 
 	// Drops all packets from a particular source (which may be given
@@ -37,9 +38,18 @@ private:
 
 	bool MatchFilter(const Filter& f, const IP_Hdr& ip, int len, int caplen);
 
+	// Deletes a filter that the prefix tables returned when inserting
+	// or removing. Returns false if there wasn't any.
+	static bool DeleteFilter(void* f);
+
 	bool default_match;
 	PrefixTable src_filter;
 	PrefixTable dst_filter;
+
+	// Number of entries in the tables, so that we can skip looking
+	// into empty ones.
+	int num_src_filters;
+	int num_dst_filters;
 };
 
 #endif
@@ -1,6 +1,58 @@
+#include <algorithm>
+
 #include "PrefixTable.h"
 #include "Reporter.h"
 
+// Tables smaller than this keep using the patricia tree alone.
+static const int POPTRIE_MIN_LOOKUPS = 64;
+
+static const int POPTRIE_STRIDE = 6;
+
+struct PrefixTable::PoptrieEntry {
+	uint64 hi;	// Top 64 bits of the prefix, relative to the trie.
+	uint64 lo;	// Bottom 64 bits.
+	int len;	// Length of the prefix, relative to the trie.
+	void* data;
+};
+
+// Returns the 6 bits at the given offset, counting from the top. Bits
+// beyond the end count as zero.
+static inline unsigned int poptrie_chunk(uint64 hi, uint64 lo, int off)
+	{
+	uint64 w;
+
+	if ( off == 0 )
+		w = hi;
+	else if ( off < 64 )
+		w = (hi << off) | (lo >> (64 - off));
+	else if ( off < 128 )
+		w = lo << (off - 64);
+	else
+		w = 0;
+
+	return w >> (64 - POPTRIE_STRIDE);
+	}
+
+// Returns whether the top n bits of two 128-bit values are equal.
+static inline bool poptrie_prefix_equal(uint64 hi1, uint64 lo1,
+					uint64 hi2, uint64 lo2, int n)
+	{
+	if ( n == 0 )
+		return true;
+
+	if ( n <= 64 )
+		return ((hi1 ^ hi2) >> (64 - n)) == 0;
+
+	return hi1 == hi2 && ((lo1 ^ lo2) >> (128 - n)) == 0;
+	}
+
+static inline int poptrie_rank(uint64 bits, unsigned int v)
+	{
+	// Counts the set bits up to and including v. For v = 63, the mask
+	// wraps around to all ones.
+	return __builtin_popcountll(bits & ((uint64(2) << v) - 1));
+	}
+
 prefix_t* PrefixTable::MakePrefix(const IPAddr& addr, int width)
 	{
 	prefix_t* prefix = (prefix_t*) safe_malloc(sizeof(prefix_t));
@@ -36,6 +88,7 @@ void* PrefixTable::Insert(const IPAddr& addr, int width, void* data)
 	// node itself.
 	node->data = data ? data : node;
 
+	Changed();
 	return old;
 	}
 
@@ -87,15 +140,32 @@ list<tuple<IPPrefix,void*>> PrefixTable::FindAll(const SubNetVal* value) const
 
 void* PrefixTable::Lookup(const IPAddr& addr, int width, bool exact) const
 	{
-	prefix_t* prefix = MakePrefix(addr, width);
-	patricia_node_t* node =
-		exact ? patricia_search_exact(tree, prefix) :
-			patricia_search_best(tree, prefix);
+	if ( ! exact && width == 128 )
+		{
+		if ( ! poptrie_nodes.empty() )
+			return LookupPoptrie(addr);
 
-	int elems = 0;
-	patricia_node_t** list = nullptr;
+		if ( ++lookups_since_change >= std::max(POPTRIE_MIN_LOOKUPS,
+							tree->num_active_node) )
+			{
+			CompilePoptrie();
+			return LookupPoptrie(addr);
+			}
+		}
+
+	// The searches don't hold on to the prefix, so we can avoid the
+	// allocation MakePrefix() would do. A zero reference count marks it
+	// as static to patricia.
+	prefix_t prefix;
+	addr.CopyIPv6(&prefix.add.sin6);
+	prefix.family = AF_INET6;
+	prefix.bitlen = width;
+	prefix.ref_count = 0;
+
+	patricia_node_t* node =
+		exact ? patricia_search_exact(tree, &prefix) :
+			patricia_search_best(tree, &prefix);
 
-	Deref_Prefix(prefix);
 	return node ? node->data : 0;
 	}
 
@@ -134,6 +204,7 @@ void* PrefixTable::Remove(const IPAddr& addr, int width)
 
 	void* old = node->data;
 	patricia_remove(tree, node);
+	Changed();
 
 	return old;
 	}
@@ -201,3 +272,197 @@ void* PrefixTable::GetNext(iterator* i)
 
 	// Not reached.
 	}
+
+void PrefixTable::CompilePoptrie() const
+	{
+	std::vector<PoptrieEntry> all;
+	std::vector<patricia_node_t*> stack;
+	all.reserve(tree->num_active_node);
+
+	if ( tree->head )
+		stack.push_back(tree->head);
+
+	while ( ! stack.empty() )
+		{
+		patricia_node_t* n = stack.back();
+		stack.pop_back();
+
+		if ( n->l )
+			stack.push_back(n->l);
+
+		if ( n->r )
+			stack.push_back(n->r);
+
+		if ( ! n->prefix )
+			continue;
+
+		uint32 a[4];
+		memcpy(a, &n->prefix->add.sin6, sizeof(a));
+
+		PoptrieEntry e;
+		e.hi = (uint64(ntohl(a[0])) << 32) | ntohl(a[1]);
+		e.lo = (uint64(ntohl(a[2])) << 32) | ntohl(a[3]);
+		e.len = n->prefix->bitlen;
+		e.data = n->data;
+		all.push_back(e);
+		}
+
+	// Shorter prefixes first, so that longer ones overwrite them.
+	std::sort(all.begin(), all.end(),
+	          [](const PoptrieEntry& x, const PoptrieEntry& y)
+	          { return x.len < y.len; });
+
+	// IPv4 addresses get a trie of their own, so that their lookups
+	// don't have to step through the 96 bits of the mapped prefix.
+	static const uint64 v4_mapped_lo = 0x0000ffff00000000ULL;
+
+	std::vector<PoptrieEntry> v4_all;
+	std::vector<const PoptrieEntry*> v4;
+	std::vector<const PoptrieEntry*> v6;
+	void* v4_def = 0;
+	void* v6_def = 0;
+
+	for ( const auto& e : all )
+		{
+		bool covers_v4 = poptrie_prefix_equal(e.hi, e.lo, 0, v4_mapped_lo,
+						      std::min(e.len, 96));
+
+		if ( covers_v4 && e.len >= 96 )
+			{
+			// Only IPv4 addresses can match this one.
+			PoptrieEntry e4;
+			e4.hi = e.lo << 32;
+			e4.lo = 0;
+			e4.len = e.len - 96;
+			e4.data = e.data;
+			v4_all.push_back(e4);
+			continue;
+			}
+
+		if ( covers_v4 )
+			v4_def = e.data;
+
+		if ( e.len == 0 )
+			v6_def = e.data;
+		else
+			v6.push_back(&e);
+		}
+
+	for ( const auto& e : v4_all )
+		{
+		if ( e.len == 0 )
+			v4_def = e.data;
+		else
+			v4.push_back(&e);
+		}
+
+	poptrie_nodes.clear();
+	poptrie_leaves.clear();
+	poptrie_nodes.resize(2);
+	poptrie_v4_root = 0;
+	poptrie_v6_root = 1;
+	BuildPoptrieNode(poptrie_v4_root, v4, 0, v4_def);
+	BuildPoptrieNode(poptrie_v6_root, v6, 0, v6_def);
+	}
+
+void PrefixTable::BuildPoptrieNode(uint32 idx,
+				   const std::vector<const PoptrieEntry*>& entries,
+				   int depth, void* def) const
+	{
+	static const unsigned int fanout = 1 << POPTRIE_STRIDE;
+	void* best[fanout];
+	std::vector<const PoptrieEntry*> sub[fanout];
+
+	std::fill(best, best + fanout, def);
+
+	// The entries come sorted by length, and all are longer than depth.
+	for ( const auto e : entries )
+		{
+		unsigned int v = poptrie_chunk(e->hi, e->lo, depth);
+
+		if ( e->len > depth + POPTRIE_STRIDE )
+			{
+			sub[v].push_back(e);
+			continue;
+			}
+
+		// Expand the prefix to all chunk values it covers.
+		unsigned int span = 1 << (depth + POPTRIE_STRIDE - e->len);
+		v &= ~(span - 1);
+		std::fill(best + v, best + v + span, e->data);
+		}
+
+	uint64 vector = 0;
+	uint64 leafvec = 0;
+	uint32 base0 = poptrie_leaves.size();
+	bool have_leaf = false;
+	void* last_leaf = 0;
+
+	for ( unsigned int v = 0; v < fanout; ++v )
+		{
+		if ( ! sub[v].empty() )
+			{
+			vector |= uint64(1) << v;
+			continue;
+			}
+
+		// Runs of equal leaves share one slot.
+		if ( ! have_leaf || best[v] != last_leaf )
+			{
+			leafvec |= uint64(1) << v;
+			poptrie_leaves.push_back(best[v]);
+			last_leaf = best[v];
+			have_leaf = true;
+			}
+		}
+
+	// A node's children sit next to each other.
+	uint32 base1 = poptrie_nodes.size();
+	poptrie_nodes.resize(base1 + __builtin_popcountll(vector));
+
+	PoptrieNode& node = poptrie_nodes[idx];
+	node.vector = vector;
+	node.leafvec = leafvec;
+	node.base0 = base0;
+	node.base1 = base1;
+
+	uint32 child = base1;
+
+	for ( unsigned int v = 0; v < fanout; ++v )
+		{
+		if ( ! sub[v].empty() )
+			BuildPoptrieNode(child++, sub[v], depth + POPTRIE_STRIDE, best[v]);
+		}
+	}
+
+void* PrefixTable::LookupPoptrie(const IPAddr& addr) const
+	{
+	uint32 a[4];
+	addr.CopyIPv6(a, IPAddr::Host);
+
+	uint64 hi, lo;
+	const PoptrieNode* n;
+
+	if ( addr.GetFamily() == IPv4 )
+		{
+		hi = uint64(a[3]) << 32;
+		lo = 0;
+		n = &poptrie_nodes[poptrie_v4_root];
+		}
+	else
+		{
+		hi = (uint64(a[0]) << 32) | a[1];
+		lo = (uint64(a[2]) << 32) | a[3];
+		n = &poptrie_nodes[poptrie_v6_root];
+		}
+
+	for ( int off = 0; ; off += POPTRIE_STRIDE )
+		{
+		unsigned int v = poptrie_chunk(hi, lo, off);
+
+		if ( ! (n->vector & (uint64(1) << v)) )
+			return poptrie_leaves[n->base0 + poptrie_rank(n->leafvec, v) - 1];
+
+		n = &poptrie_nodes[n->base1 + poptrie_rank(n->vector, v) - 1];
+		}
+	}
@@ -3,13 +3,17 @@
 #include "zeek-config.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <utility>
+#include <deque>
 
 #include "RE.h"
 #include "DFA.h"
 #include "CCL.h"
 #include "EquivClass.h"
 #include "Reporter.h"
+#include "Hash.h"
+#include "NetVar.h"
 
 CCL* curr_ccl = 0;
 
@@ -31,6 +35,54 @@ Specific_RE_Matcher::Specific_RE_Matcher(match_type arg_mt, int arg_multiline)
 	dfa = 0;
 	ecs = 0;
 	accepted = new AcceptingSet();
+	min_len = 0;
+	}
+
+// Returns the length of the shortest input leading from the machine's first
+// state to an accepting one.
+static int nfa_min_length(NFA_Machine* nfa)
+	{
+	std::map<NFA_State*, int> dist;
+	std::deque<NFA_State*> todo;
+
+	dist[nfa->FirstState()] = 0;
+	todo.push_back(nfa->FirstState());
+
+	int min_len = -1;
+
+	while ( ! todo.empty() )
+		{
+		NFA_State* s = todo.front();
+		todo.pop_front();
+
+		int d = dist[s];
+
+		if ( s->Accept() != NO_ACCEPT && (min_len < 0 || d < min_len) )
+			min_len = d;
+
+		int sym = s->TransSym();
+		bool consumes = (sym != SYM_EPSILON && sym != SYM_BOL && sym != SYM_EOL);
+		int next_d = consumes ? d + 1 : d;
+
+		for ( const auto& next : *s->Transitions() )
+			{
+			auto i = dist.find(next);
+
+			if ( i != dist.end() && i->second <= next_d )
+				continue;
+
+			dist[next] = next_d;
+
+			// A 0-1 BFS: we look at states in order of their
+			// distance.
+			if ( consumes )
+				todo.push_back(next);
+			else
+				todo.push_front(next);
+			}
+		}
+
+	return min_len > 0 ? min_len : 0;
 	}
 
 Specific_RE_Matcher::~Specific_RE_Matcher()
@@ -137,6 +189,7 @@ int Specific_RE_Matcher::Compile(int lazy)
 	EC()->BuildECs();
 	ConvertCCLs();
 
+	min_len = nfa_min_length(nfa);
 	dfa = new DFA_Machine(nfa, EC());
 
 	Unref(nfa); 
@@ -194,6 +247,32 @@ int Specific_RE_Matcher::CompileSet(const string_list& set, const int_list& idx)
 	return 1;
 	}
 
+bool Specific_RE_Matcher::MatchSet(const BroString* s, std::vector<AcceptIdx>& matches)
+	{
+	if ( ! dfa )
+		return false;
+
+	const u_char* bv = s->Bytes();
+	int n = s->Len();
+
+	DFA_State* d = dfa->StartState();
+	d = d->Xtion(ecs[SYM_BOL], dfa);
+
+	while ( d && --n >= 0 )
+		d = d->Xtion(ecs[*(bv++)], dfa);
+
+	if ( d )
+		d = d->Xtion(ecs[SYM_EOL], dfa);
+
+	if ( ! d || ! d->Accept() )
+		return false;
+
+	for ( const auto& a : *d->Accept() )
+		matches.push_back(a);
+
+	return true;
+	}
+
 const char* Specific_RE_Matcher::LookupDef(const char* def)
 	{
 	return defs.Lookup(def);
@@ -237,15 +316,47 @@ int Specific_RE_Matcher::MatchAll(const u_char* bv, int n)
 		// matched is empty.
 		return n == 0;
 
+	if ( n < min_len )
+		return 0;
+
+	dfa->MaybeCompact();
+
+	const int* dense = dfa->DenseXtions();
+	int num_sym = dfa->NumSyms();
+
 	DFA_State* d = dfa->StartState();
 	d = d->Xtion(ecs[SYM_BOL], dfa);
 
 	while ( d )
 		{
+		int idx = d->DenseIndex();
+
+		if ( idx >= 0 )
+			{
+			// Stay in the dense table for as long as we can.
+			int next = idx;
+
+			while ( n > 0 && (next = dense[idx * num_sym + ecs[*bv]]) >= 0 )
+				{
+				idx = next;
+				++bv;
+				--n;
+				}
+
+			if ( next == DFA_DENSE_JAM )
+				{
+				d = 0;
+				break;
+				}
+
+			d = dfa->DenseState(idx);
+			}
+
 		if ( --n < 0 )
 			break;
 
 		int ec = ecs[*(bv++)];
+		dfa->ColdXtion();
 		d = d->Xtion(ec, dfa);
 		}
 
@@ -262,6 +373,9 @@ int Specific_RE_Matcher::Match(const u_char* bv, int n)
 		// An empty pattern matches anything.
 		return 1;
 
+	if ( n < min_len )
+		return 0;
+
 	DFA_State* d = dfa->StartState();
 
 	d = d->Xtion(ecs[SYM_BOL], dfa);
@@ -303,6 +417,35 @@ inline void RE_Match_State::AddMatches(const AcceptingSet& as,
 		accepted_matches.insert(am_idx(*it, position));
 	}
 
+// Returns the offset of the first of the given bytes in the data, or len if
+// there's none.
+static inline int find_exit(const u_char* data, int len,
+				const DFA_Machine::Exits* exits)
+	{
+	const u_char* p;
+
+	switch ( exits->n ) {
+	case 0:
+		return len;
+
+	case 1:
+		p = (const u_char*) memchr(data, exits->bytes[0], len);
+		return p ? p - data : len;
+
+	default:
+		for ( int i = 0; i < len; ++i )
+			{
+			u_char c = data[i];
+
+			for ( int j = 0; j < exits->n; ++j )
+				if ( c == exits->bytes[j] )
+					return i;
+			}
+
+		return len;
+	}
+	}
+
 bool RE_Match_State::Match(const u_char* bv, int n,
 				bool bol, bool eol, bool clear)
 	{
@@ -332,12 +475,34 @@ bool RE_Match_State::Match(const u_char* bv, int n,
 
 	size_t old_matches = accepted_matches.size();
 
+	dfa->MaybeCompact();
+
+	const int* dense = dfa->DenseXtions();
+	int num_sym = dfa->NumSyms();
+	int idx = current_state->DenseIndex();
+
 	int ec;
 	int m = bol ? n + 1 : n;
 	int e = eol ? -1 : 0;
 
 	while ( --m >= e )
 		{
+		const DFA_Machine::Exits* exits;
+
+		if ( idx >= 0 && m >= 0 && m < n &&
+		     (exits = dfa->DenseExits(idx)) )
+			{
+			// Everything but the exit bytes keeps us where we are,
+			// without any match, so skip ahead to the next of them.
+			int skip = find_exit(bv, m + 1, exits);
+			bv += skip;
+			current_pos += skip;
+			m -= skip;
+
+			if ( m < e )
+				break;
+			}
+
 		if ( m == n )
 			ec = ecs[SYM_BOL];
 		else if ( m == -1 )
@@ -345,6 +510,35 @@ bool RE_Match_State::Match(const u_char* bv, int n,
 		else
 			ec = ecs[*(bv++)];
 
+		if ( idx >= 0 )
+			{
+			// While we're in the dense table, we track the state
+			// just by its index there.
+			int next = dense[idx * num_sym + ec];
+
+			if ( next >= 0 )
+				{
+				const AcceptingSet* ac = dfa->DenseAccept(next);
+
+				if ( ac )
+					AddMatches(*ac, current_pos);
+
+				++current_pos;
+				idx = next;
+				continue;
+				}
+
+			current_state = dfa->DenseState(idx);
+			idx = -1;
+
+			if ( next == DFA_DENSE_JAM )
+				{
+				current_state = 0;
+				break;
+				}
+			}
+
+		dfa->ColdXtion();
 		DFA_State* next_state = current_state->Xtion(ec,dfa);
 
 		if ( ! next_state )
@@ -361,8 +555,12 @@ bool RE_Match_State::Match(const u_char* bv, int n,
 		++current_pos;
 
 		current_state = next_state;
+		idx = current_state->DenseIndex();
 		}
 
+	if ( idx >= 0 )
+		current_state = dfa->DenseState(idx);
+
 	return accepted_matches.size() != old_matches;
 	}
 
@@ -428,12 +626,14 @@ RE_Matcher::RE_Matcher()
 	{
 	re_anywhere = new Specific_RE_Matcher(MATCH_ANYWHERE);
 	re_exact = new Specific_RE_Matcher(MATCH_EXACTLY);
+	cache = 0;
 	}
 
 RE_Matcher::RE_Matcher(const char* pat)
 	{
 	re_anywhere = new Specific_RE_Matcher(MATCH_ANYWHERE);
 	re_exact = new Specific_RE_Matcher(MATCH_EXACTLY);
+	cache = 0;
 
 	AddPat(pat);
 	}
@@ -444,12 +644,14 @@ RE_Matcher::RE_Matcher(const char* exact_pat, const char* anywhere_pat)
 	re_anywhere->SetPat(anywhere_pat);
 	re_exact = new Specific_RE_Matcher(MATCH_EXACTLY);
 	re_exact->SetPat(exact_pat);
+	cache = 0;
 	}
 
 RE_Matcher::~RE_Matcher()
 	{
 	delete re_anywhere;
 	delete re_exact;
+	delete cache;
 	}
 
 void RE_Matcher::AddPat(const char* new_pat)
@@ -466,9 +668,64 @@ void RE_Matcher::MakeCaseInsensitive()
 
 int RE_Matcher::Compile(int lazy)
 	{
+	delete cache;
+	cache = 0;
+
 	return re_anywhere->Compile(lazy) && re_exact->Compile(lazy);
 	}
 
+// Strings longer than this don't go into the cache: they rarely repeat, and
+// checking them against it costs about as much as matching them.
+static const int MAX_CACHED_STRING_LEN = 256;
+
+int RE_Matcher::MatchExactly(const BroString* s)
+	{
+	if ( s->Len() < re_exact->MinLength() )
+		return 0;
+
+	if ( BifConst::pattern_match_cache_size == 0 ||
+	     s->Len() > MAX_CACHED_STRING_LEN )
+		return re_exact->MatchAll(s);
+
+	return CachedMatch(s, true);
+	}
+
+int RE_Matcher::MatchAnywhere(const BroString* s)
+	{
+	if ( s->Len() < re_anywhere->MinLength() )
+		return 0;
+
+	if ( BifConst::pattern_match_cache_size == 0 ||
+	     s->Len() > MAX_CACHED_STRING_LEN )
+		return re_anywhere->Match(s);
+
+	return CachedMatch(s, false);
+	}
+
+int RE_Matcher::CachedMatch(const BroString* s, bool exact)
+	{
+	if ( ! cache )
+		cache = new std::vector<CacheEntry>(BifConst::pattern_match_cache_size);
+
+	hash_t h = HashKey::HashBytes(s->Bytes(), s->Len());
+	CacheEntry& e = (*cache)[h % cache->size()];
+
+	if ( e.hash != h || e.s.size() != size_t(s->Len()) ||
+	     memcmp(e.s.data(), s->Bytes(), s->Len()) != 0 )
+		{
+		e.hash = h;
+		e.s.assign(reinterpret_cast<const char*>(s->Bytes()), s->Len());
+		e.exact = e.anywhere = -1;
+		}
+
+	int& result = exact ? e.exact : e.anywhere;
+
+	if ( result < 0 )
+		result = exact ? re_exact->MatchAll(s) : re_anywhere->Match(s);
+
+	return result;
+	}
+
 static RE_Matcher* matcher_merge(const RE_Matcher* re1, const RE_Matcher* re2,
 				const char* merge_op)
 	{
@@ -11,6 +11,8 @@
 
 #include <set>
 #include <map>
+#include <string>
+#include <vector>
 
 #include <ctype.h>
 typedef int (*cce_func)(int);
@@ -82,6 +84,11 @@ public:
 	// to the matching expressions.  (idx must not contain zeros).
 	int CompileSet(const string_list& set, const int_list& idx);
 
+	// For a matcher built through CompileSet(), adds the indices of
+	// all patterns that match s in its entirety to matches. Returns true
+	// if there was at least one.
+	bool MatchSet(const BroString* s, std::vector<AcceptIdx>& matches);
+
 	// Returns the position in s just beyond where the first match
 	// occurs, or 0 if there is no such position in s.  Note that
 	// if the pattern matches empty strings, matching continues
@@ -99,6 +106,9 @@ public:
 
 	DFA_Machine* DFA() const		{ return dfa; }
 
+	// Returns the length of the shortest input the pattern can match.
+	int MinLength() const	{ return min_len; }
+
 	void Dump(FILE* f);
 
 	unsigned int MemoryAllocation() const;
@@ -127,6 +137,7 @@ protected:
 	DFA_Machine* dfa;
 	CCL* any_ccl;
 	AcceptingSet* accepted;
+	int min_len;
 };
 
 class RE_Match_State {
@@ -158,6 +169,11 @@ public:
 
 	void AddMatches(const AcceptingSet& as, MatchPos position);
 
+	// Returns true if the DFA has run into its dead state, so that no
+	// further input can lead to another match (until cleared).
+	bool Dead() const
+		{ return ! dfa || (current_pos >= 0 && ! current_state); }
+
 protected:
 	DFA_Machine* dfa;
 	int* ecs;
@@ -184,8 +200,7 @@ public:
 	// Returns true if s exactly matches the pattern, false otherwise.
 	int MatchExactly(const char* s)
 		{ return re_exact->MatchAll(s); }
-	int MatchExactly(const BroString* s)
-		{ return re_exact->MatchAll(s); }
+	int MatchExactly(const BroString* s);
 
 	// Returns the position in s just beyond where the first match
 	// occurs, or 0 if there is no such position in s.  Note that
@@ -193,8 +208,7 @@ public:
 	// in an attempt to match at least one character.
 	int MatchAnywhere(const char* s)
 		{ return re_anywhere->Match(s); }
-	int MatchAnywhere(const BroString* s)
-		{ return re_anywhere->Match(s); }
+	int MatchAnywhere(const BroString* s);
 
 	// Note: it matches the *longest* prefix and returns the
 	// length of matched prefix. It returns -1 on mismatch.
@@ -205,7 +219,23 @@ public:
 	int MatchPrefix(const u_char* s, int n)
 		{ return re_exact->LongestMatch(s, n); }
 
+	// Compiles the given exact-match pattern texts (as returned by
+	// PatternText()) into a single matcher reporting which of them
+	// match, using the corresponding entries of idx. The matcher is then
+	// only usable through MatchSet().
+	int CompileSet(const string_list& set, const int_list& idx)
+		{ return re_exact->CompileSet(set, idx); }
+
+	// Adds the indices of all patterns of the set that exactly match s
+	// to matches. Returns true if there was at least one.
+	bool MatchSet(const BroString* s, std::vector<AcceptIdx>& matches)
+		{ return re_exact->MatchSet(s, matches); }
+
 	const char* PatternText() const	{ return re_exact->PatternText(); }
+
+	// Returns the matcher looking for the pattern anywhere in its
+	// input, for matching incrementally through RE_Match_State.
+	Specific_RE_Matcher* AnywhereMatcher() const	{ return re_anywhere; }
 	const char* AnywherePatternText() const	{ return re_anywhere->PatternText(); }
 
 	unsigned int MemoryAllocation() const
@@ -216,8 +246,22 @@ public:
 		}
 
 protected:
+	// Looks up, or computes and remembers, the result of matching s.
+	int CachedMatch(const BroString* s, bool exact);
+
 	Specific_RE_Matcher* re_anywhere;
 	Specific_RE_Matcher* re_exact;
+
+	// Results for recently matched strings, see pattern_match_cache_size.
+	// Results not computed yet are -1.
+	struct CacheEntry {
+		hash_t hash;
+		std::string s;
+		int exact;
+		int anywhere;
+	};
+
+	std::vector<CacheEntry>* cache;
 };
 
 extern RE_Matcher* RE_Matcher_conjunction(const RE_Matcher* re1, const RE_Matcher* re2);
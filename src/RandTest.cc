@@ -25,8 +25,9 @@ static double rt_log2(double x)
 // RT_INCIRC = pow(pow(256.0, (double) (RT_MONTEN / 2)) - 1, 2.0);
 #define RT_INCIRC 281474943156225.0
 
-RandTest::RandTest()
+RandTest::RandTest(bool arg_histogram_only)
 	{
+	histogram_only = arg_histogram_only;
 	totalc = 0;
 	mp = 0;
 	sccfirst = 1;
@@ -44,11 +45,14 @@ void RandTest::add(const void *buf, int bufl)
 	const unsigned char *bp = static_cast<const unsigned char*>(buf);
 	int oc;
 
+	count(bp, bufl);
+
+	if (histogram_only)
+		return;
+
 	while (bufl-- > 0)
 		{
 		oc = *bp++;
-		ccount[oc]++;   /* Update counter for this bin */
-		totalc++;
 
 		/* Update inside / outside circle counts for Monte Carlo
  		   computation of PI */
@@ -89,6 +93,39 @@ void RandTest::add(const void *buf, int bufl)
 		}
 	}
 
+void RandTest::count(const unsigned char* bp, int bufl)
+	{
+	totalc += bufl;
+
+	if (bufl < 1024)
+		{
+		while (bufl-- > 0)
+			ccount[*bp++]++;
+
+		return;
+		}
+
+	/* Four interleaved sub-histograms, so that runs of the same byte
+	   update different counters instead of each waiting for the
+	   previous increment of the same one. */
+	uint32 sub[4][256] = {};
+	int i = 0;
+
+	for (; i + 4 <= bufl; i += 4)
+		{
+		sub[0][bp[i]]++;
+		sub[1][bp[i + 1]]++;
+		sub[2][bp[i + 2]]++;
+		sub[3][bp[i + 3]]++;
+		}
+
+	for (; i < bufl; i++)
+		sub[0][bp[i]]++;
+
+	for (int c = 0; c < 256; c++)
+		ccount[c] += (int64) sub[0][c] + sub[1][c] + sub[2][c] + sub[3][c];
+	}
+
 void RandTest::end(double* r_ent, double* r_chisq,
                    double* r_mean, double* r_montepicalc, double* r_scc)
 	{
@@ -98,13 +135,16 @@ void RandTest::end(double* r_ent, double* r_chisq,
 	double prob[256];    /* Probabilities per bin for entropy */
 
 	/* Complete calculation of serial correlation coefficient */
-	scct1 = scct1 + scclast * sccu0;
-	scct2 = scct2 * scct2;
-	scc = totalc * scct3 - scct2;
-	if (scc == 0.0)
-	   scc = -100000;
-	else
-	   scc = (totalc * scct1 - scct2) / scc;
+	if (! histogram_only)
+		{
+		scct1 = scct1 + scclast * sccu0;
+		scct2 = scct2 * scct2;
+		scc = totalc * scct3 - scct2;
+		if (scc == 0.0)
+		   scc = -100000;
+		else
+		   scc = (totalc * scct1 - scct2) / scc;
+		}
 
 	/* Scan bins and calculate probability for each bin and
 	   Chi-Square distribution.  The probability will be reused
@@ -132,7 +172,7 @@ void RandTest::end(double* r_ent, double* r_chisq,
 
 	/* Calculate Monte Carlo value for PI from percentage of hits
 	   within the circle */
-	montepi = 4.0 * (((double) inmont) / mcount);
+	montepi = histogram_only ? 0 : 4.0 * (((double) inmont) / mcount);
 
 	/* Return results through arguments */
 	*r_ent = ent;
@@ -12,7 +12,11 @@ class EntropyVal;
 
 class RandTest {
 	public:
-		RandTest();
+		// With histogram_only, only the byte counts get updated as data
+		// comes in, which is all that entropy, Chi-Square and mean need.
+		// The Monte Carlo value for pi and the serial correlation
+		// coefficient are then reported as zero.
+		explicit RandTest(bool histogram_only = false);
 		void add(const void* buf, int bufl);
 		void end(double* r_ent, double* r_chisq, double* r_mean,
 		         double* r_montepicalc, double* r_scc);
@@ -20,6 +24,10 @@ class RandTest {
 	private:
 	  friend class EntropyVal;
 
+		void count(const unsigned char* bp, int bufl);
+
+		bool histogram_only;
+
 		int64 ccount[256];  /* Bins to count occurrences of values */
 		int64 totalc;       /* Total bytes counted */
 		int mp;
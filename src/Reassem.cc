@@ -6,16 +6,104 @@
 #include "zeek-config.h"
 
 #include "Reassem.h"
+#include "NetVar.h"
+#include "Reporter.h"
 
 static const bool DEBUG_reassem = false;
 
+// Reassembly data lives in buffers of a limited number of size classes,
+// four per power of two, so that buffers released by one block can be
+// reused for others rather than going back to the heap each time. Larger
+// buffers are allocated individually.
+static const int MIN_BUFFER_SHIFT = 6;		// 64 bytes
+static const int MAX_BUFFER_SHIFT = 16;		// 64KB
+static const int NUM_BUFFER_CLASSES = 1 + (MAX_BUFFER_SHIFT - MIN_BUFFER_SHIFT) * 4;
+
+// How much memory we keep around in released buffers.
+static const uint64 MAX_CACHED_BUFFER_BYTES = 8 * 1024 * 1024;
+
+struct FreeBuffer {
+	FreeBuffer* next;
+};
+
+static FreeBuffer* free_buffers[NUM_BUFFER_CLASSES];
+static uint64 cached_buffer_bytes = 0;
+
+// Returns the size class for a buffer of the given size, or -1 if it's too
+// large for any; sets *class_size to the size of buffers of that class.
+static int buffer_class(uint64 size, uint64* class_size)
+	{
+	if ( size <= (uint64(1) << MIN_BUFFER_SHIFT) )
+		{
+		*class_size = uint64(1) << MIN_BUFFER_SHIFT;
+		return 0;
+		}
+
+	if ( size > (uint64(1) << MAX_BUFFER_SHIFT) )
+		{
+		*class_size = size;
+		return -1;
+		}
+
+	// 2^k < size <= 2^(k+1), rounded up to a multiple of 2^(k-2).
+	int k = 63 - __builtin_clzll(size - 1);
+	uint64 step = uint64(1) << (k - 2);
+	uint64 steps = (size + step - 1) / step;	// 5 to 8
+
+	*class_size = steps * step;
+	return 1 + (k - MIN_BUFFER_SHIFT) * 4 + int(steps - 5);
+	}
+
+static u_char* alloc_buffer(uint64 size)
+	{
+	uint64 class_size;
+	int c = buffer_class(size, &class_size);
+
+	if ( c >= 0 && free_buffers[c] )
+		{
+		FreeBuffer* b = free_buffers[c];
+		free_buffers[c] = b->next;
+		cached_buffer_bytes -= class_size;
+		return reinterpret_cast<u_char*>(b);
+		}
+
+	return new u_char[class_size];
+	}
+
+static void free_buffer(u_char* block, uint64 size)
+	{
+	uint64 class_size;
+	int c = buffer_class(size, &class_size);
+
+	if ( c < 0 || cached_buffer_bytes + class_size > MAX_CACHED_BUFFER_BYTES )
+		{
+		delete [] block;
+		return;
+		}
+
+	FreeBuffer* b = reinterpret_cast<FreeBuffer*>(block);
+	b->next = free_buffers[c];
+	free_buffers[c] = b;
+	cached_buffer_bytes += class_size;
+	}
+
+// Memory accounted for a block holding the given amount of data.
+static uint64 block_allocation(uint64 size)
+	{
+	uint64 class_size;
+	buffer_class(size, &class_size);
+	return pad_size(class_size) + padded_sizeof(DataBlock);
+	}
+
+IMPLEMENT_OBJ_COUNTER(DataBlock)
+
 DataBlock::DataBlock(Reassembler* reass, const u_char* data,
                      uint64 size, uint64 arg_seq, DataBlock* arg_prev,
                      DataBlock* arg_next, ReassemblerType reassem_type)
 	{
 	seq = arg_seq;
 	upper = seq + size;
-	block = new u_char[size];
+	block = alloc_buffer(size);
 
 	memcpy((void*) block, (const void*) data, size);
 
@@ -31,10 +119,27 @@ DataBlock::DataBlock(Reassembler* reass, const u_char* data,
 	reassembler->size_of_all_blocks += size;
 
 	rtype = reassem_type;
-	Reassembler::sizes[rtype] += pad_size(size) + padded_sizeof(DataBlock);
-	Reassembler::total_size += pad_size(size) + padded_sizeof(DataBlock);
+	Reassembler::sizes[rtype] += block_allocation(size);
+	Reassembler::total_size += block_allocation(size);
+
+	// Appends are the common case, for which the end is the right hint.
+	Reassembler::BlockIndex& index = reassembler->block_index;
+	index.emplace_hint(next ? index.find(next->seq) : index.end(), seq, this);
+	indexed = true;
+	}
+
+DataBlock::~DataBlock()
+	{
+	if ( indexed )
+		reassembler->block_index.erase(seq);
+
+	reassembler->size_of_all_blocks -= Size();
+	Reassembler::total_size -= block_allocation(Size());
+	Reassembler::sizes[rtype] -= block_allocation(Size());
+	free_buffer(block, Size());
 	}
 
+Reassembler* Reassembler::all_reassemblers = 0;
 uint64 Reassembler::total_size = 0;
 uint64 Reassembler::sizes[REASSEM_NUM];
 
@@ -44,12 +149,103 @@ Reassembler::Reassembler(uint64 init_seq, ReassemblerType reassem_type)
 	  max_old_blocks(0), total_old_blocks(0), size_of_all_blocks(0),
 	  rtype(reassem_type)
 	{
+	Register();
+	}
+
+Reassembler::Reassembler()
+	:  blocks(), last_block(), old_blocks(), last_old_block(),
+	  last_reassem_seq(0), trim_seq(0),
+	  max_old_blocks(0), total_old_blocks(0), size_of_all_blocks(0),
+	  rtype(REASSEM_UNKNOWN)
+	{
+	Register();
 	}
 
 Reassembler::~Reassembler()
 	{
 	ClearBlocks();
 	ClearOldBlocks();
+	Unregister();
+	}
+
+void Reassembler::Register()
+	{
+	prev_reassembler = 0;
+	next_reassembler = all_reassemblers;
+
+	if ( all_reassemblers )
+		all_reassemblers->prev_reassembler = this;
+
+	all_reassemblers = this;
+	}
+
+void Reassembler::Unregister()
+	{
+	if ( prev_reassembler )
+		prev_reassembler->next_reassembler = next_reassembler;
+	else
+		all_reassemblers = next_reassembler;
+
+	if ( next_reassembler )
+		next_reassembler->prev_reassembler = prev_reassembler;
+
+	prev_reassembler = next_reassembler = 0;
+	}
+
+void Reassembler::CheckMemoryCap()
+	{
+	uint64 cap = BifConst::reassembly_memory_cap;
+
+	if ( ! cap || total_size <= cap )
+		return;
+
+	reporter->Weird("reassembly_memory_cap_exceeded");
+
+	if ( reassembly_cap_action != BifEnum::REASSEMBLY_CAP_DROP_LARGEST )
+		{
+		// Deliver what we have, skipping the holes. Subclasses
+		// report the skipped data as usual.
+		if ( last_block )
+			TrimToSeq(last_block->upper);
+
+		return;
+		}
+
+	// Discard the data of the reassemblers holding the most, until we're
+	// comfortably below the cap, so that we don't end up back here with
+	// the next block already.
+	uint64 target = cap - cap / 8;
+
+	std::vector<std::pair<uint64, Reassembler*>> candidates;
+
+	for ( Reassembler* r = all_reassemblers; r; r = r->next_reassembler )
+		{
+		if ( r->blocks || r->old_blocks )
+			candidates.push_back({r->size_of_all_blocks, r});
+		}
+
+	std::sort(candidates.begin(), candidates.end(),
+	          [](const std::pair<uint64, Reassembler*>& a,
+	             const std::pair<uint64, Reassembler*>& b)
+			{ return a.first > b.first; });
+
+	for ( const auto& c : candidates )
+		{
+		if ( total_size <= target )
+			break;
+
+		Reassembler* r = c.second;
+		uint64 upper = r->last_block ? r->last_block->upper : 0;
+
+		r->ClearBlocks();
+		r->ClearOldBlocks();
+
+		// Move past what we dropped, which reports it as skipped the
+		// same way as with the other action, so that the stream
+		// doesn't keep waiting for it.
+		if ( upper > r->last_reassem_seq )
+			r->TrimToSeq(upper);
+		}
 	}
 
 void Reassembler::CheckOverlap(DataBlock *head, DataBlock *tail,
@@ -71,7 +267,8 @@ void Reassembler::CheckOverlap(DataBlock *head, DataBlock *tail,
 		const u_char* ndata = data;
 
 		if ( nupper <= b->seq )
-			continue;
+			// Blocks are sorted, so nothing further can overlap.
+			break;
 
 		if ( nseq >= b->upper )
 			continue;
@@ -98,6 +295,10 @@ void Reassembler::NewBlock(double t, uint64 seq, uint64 len, const u_char* data)
 	if ( len == 0 )
 		return;
 
+	// We check before adding anything, as the blocks may not stay
+	// around long enough for us to look at them afterwards.
+	CheckMemoryCap();
+
 	uint64 upper_seq = seq + len;
 
 	CheckOverlap(old_blocks, last_old_block, seq, len, data);
@@ -106,7 +307,8 @@ void Reassembler::NewBlock(double t, uint64 seq, uint64 len, const u_char* data)
 		// Old data, don't do any work for it.
 		return;
 
-	CheckOverlap(blocks, last_block, seq, len, data);
+	// There's no need to look at the blocks ending before the new data.
+	CheckOverlap(FirstBlockEndingAfter(seq), last_block, seq, len, data);
 
 	if ( seq < trim_seq )
 		{ // Partially old data, just keep the good stuff.
@@ -177,6 +379,8 @@ uint64 Reassembler::TrimToSeq(uint64 seq)
 		if ( max_old_blocks )
 			{
 			// Move block over to old_blocks queue.
+			block_index.erase(blocks->seq);
+			blocks->indexed = false;
 			blocks->next = 0;
 
 			if ( last_old_block )
@@ -287,15 +491,13 @@ DataBlock* Reassembler::AddAndCheck(DataBlock* b, uint64 seq, uint64 upper,
 
 	// Find the first block that doesn't come completely before the
 	// new data.
-	while ( b->next && b->upper <= seq )
-		b = b->next;
+	b = FirstBlockEndingAfter(seq);
 
-	if ( b->upper <= seq )
+	if ( ! b )
 		{
-		// b is the last block, and it comes completely before
-		// the new block.
+		// All blocks come completely before the new block.
 		last_block = new DataBlock(this, data, upper - seq,
-		                           seq, b, 0, rtype);
+		                           seq, last_block, 0, rtype);
 		return last_block;
 		}
 
@@ -351,6 +553,24 @@ DataBlock* Reassembler::AddAndCheck(DataBlock* b, uint64 seq, uint64 upper,
 	return new_b;
 	}
 
+DataBlock* Reassembler::FirstBlockEndingAfter(uint64 seq) const
+	{
+	// The first block starting beyond seq, and the one before it,
+	// which may still extend beyond seq.
+	BlockIndex::const_iterator i = block_index.upper_bound(seq);
+
+	if ( i != block_index.begin() )
+		{
+		BlockIndex::const_iterator p = i;
+		--p;
+
+		if ( p->second->upper > seq )
+			return p->second;
+		}
+
+	return i == block_index.end() ? 0 : i->second;
+	}
+
 uint64 Reassembler::MemoryAllocation(ReassemblerType rtype)
 	{
 	return Reassembler::sizes[rtype];
@@ -3,8 +3,11 @@
 #ifndef reassem_h
 #define reassem_h
 
+#include <map>
+
 #include "Obj.h"
 #include "IPAddr.h"
+#include "ObjCounter.h"
 
 // Whenever subclassing the Reassembler class
 // you should add to this for known subclasses.
@@ -20,8 +23,10 @@ enum ReassemblerType {
 
 class Reassembler;
 
-class DataBlock {
+class DataBlock : CountedObj<DataBlock> {
 public:
+	DECLARE_OBJ_COUNTER()
+
 	DataBlock(Reassembler* reass, const u_char* data,
 	          uint64 size, uint64 seq,
 	          DataBlock* prev, DataBlock* next,
@@ -38,6 +43,10 @@ public:
 	ReassemblerType rtype;
 
 	Reassembler* reassembler; // Non-owning pointer back to parent.
+
+	// True while the block is in its reassembler's index, i.e., not yet
+	// moved to the old blocks.
+	bool indexed;
 };
 
 class Reassembler : public BroObj {
@@ -71,7 +80,7 @@ public:
 	void SetMaxOldBlocks(uint32 count)	{ max_old_blocks = count; }
 
 protected:
-	Reassembler()	{ }
+	Reassembler();
 
 	friend class DataBlock;
 
@@ -83,12 +92,31 @@ protected:
 	DataBlock* AddAndCheck(DataBlock* b, uint64 seq,
 				uint64 upper, const u_char* data);
 
+	// Returns the first of the current blocks that extends beyond seq,
+	// or nil if there's none.
+	DataBlock* FirstBlockEndingAfter(uint64 seq) const;
+
+	// Applies reassembly_cap_action if data buffered by all
+	// reassemblers together exceeds reassembly_memory_cap.
+	void CheckMemoryCap();
+
+	// Adds ourselves to, or removes ourselves from, the list of all
+	// reassemblers.
+	void Register();
+	void Unregister();
+
 	void CheckOverlap(DataBlock *head, DataBlock *tail,
 				uint64 seq, uint64 len, const u_char* data);
 
 	DataBlock* blocks;
 	DataBlock* last_block;
 
+	// The current blocks indexed by their starting sequence number, so
+	// that we can find where new data goes without walking the list.
+	// As the blocks don't overlap, their starting points are unique.
+	typedef std::map<uint64, DataBlock*> BlockIndex;
+	BlockIndex block_index;
+
 	DataBlock* old_blocks;
 	DataBlock* last_old_block;
 
@@ -100,16 +128,14 @@ protected:
 
 	ReassemblerType rtype;
 
+	// Neighbors in the list of all reassemblers.
+	Reassembler* prev_reassembler;
+	Reassembler* next_reassembler;
+
+	static Reassembler* all_reassemblers;
+
 	static uint64 total_size;
 	static uint64 sizes[REASSEM_NUM];
 };
 
-inline DataBlock::~DataBlock()
-	{
-	reassembler->size_of_all_blocks -= Size();
-	Reassembler::total_size -= pad_size(upper - seq) + padded_sizeof(DataBlock);
-	Reassembler::sizes[rtype] -= pad_size(upper - seq) + padded_sizeof(DataBlock);
-	delete [] block;
-	}
-
 #endif
@@ -45,6 +45,9 @@ Reporter::Reporter()
 	weird_sampling_duration = 0;
 	weird_sampling_threshold = 0;
 
+	for ( int i = 0; i < WEIRD_ID_CACHE_SIZE; ++i )
+		weird_id_cache[i] = {0, 0};
+
 	openlog("bro", 0, LOG_LOCAL5);
 	}
 
@@ -76,6 +79,9 @@ void Reporter::InitOptions()
 		Unref(index);
 		delete k;
 		}
+
+	for ( auto& w : weirds )
+		w.whitelisted = weird_sampling_whitelist.count(w.name) > 0;
 	}
 
 void Reporter::Info(const char* fmt, ...)
@@ -224,22 +230,79 @@ void Reporter::WeirdHelper(EventHandlerPtr event, val_list vl, const char* fmt_n
 	va_end(ap);
 	}
 
-void Reporter::UpdateWeirdStats(const char* name)
+uint32 Reporter::WeirdID(const char* name)
+	{
+	auto slot = (reinterpret_cast<uintptr_t>(name) >> 3) % WEIRD_ID_CACHE_SIZE;
+	auto& e = weird_id_cache[slot];
+
+	// The pointer may be a reused buffer holding a different name now,
+	// so confirm it.
+	if ( e.name == name && weirds[e.id].name == name )
+		return e.id;
+
+	std::string n = name;
+	auto it = weird_ids.find(n);
+	uint32 id;
+
+	if ( it != weird_ids.end() )
+		id = it->second;
+	else
+		{
+		id = weirds.size();
+		bool wl = weird_sampling_whitelist.count(n) > 0;
+		weirds.push_back({n, 0, 0, wl});
+		weird_ids.emplace(std::move(n), id);
+		}
+
+	e = {name, id};
+	return id;
+	}
+
+Reporter::WeirdCountMap Reporter::GetWeirdsByType() const
 	{
+	WeirdCountMap rval;
+
+	for ( const auto& w : weirds )
+		{
+		if ( w.count )
+			rval.emplace(w.name, w.count);
+		}
+
+	return rval;
+	}
+
+void Reporter::SetWeirdSamplingWhitelist(const WeirdSet& weird_sampling_whitelist)
+	{
+	this->weird_sampling_whitelist = weird_sampling_whitelist;
+
+	for ( auto& w : weirds )
+		w.whitelisted = weird_sampling_whitelist.count(w.name) > 0;
+	}
+
+uint32 Reporter::UpdateWeirdStats(const char* name)
+	{
+	auto id = WeirdID(name);
 	++weird_count;
-	++weird_count_by_type[name];
+	++weirds[id].count;
+	return id;
+	}
+
+bool Reporter::WantWeird(EventHandlerPtr event) const
+	{
+	return via_events && ! in_error_handler &&
+	       (event || plugin_mgr->HavePluginForHook(plugin::HOOK_REPORTER));
 	}
 
 class NetWeirdTimer : public Timer {
 public:
-	NetWeirdTimer(double t, const char* name, double timeout)
-	: Timer(t + timeout, TIMER_NET_WEIRD_EXPIRE), weird_name(name)
+	NetWeirdTimer(double t, uint32 id, double timeout)
+	: Timer(t + timeout, TIMER_NET_WEIRD_EXPIRE), weird_id(id)
 		{}
 
 	void Dispatch(double t, int is_expire) override
-		{ reporter->ResetNetWeird(weird_name); }
+		{ reporter->ResetNetWeird(weird_id); }
 
-	std::string weird_name;
+	uint32 weird_id;
 };
 
 class FlowWeirdTimer : public Timer {
@@ -258,7 +321,10 @@ public:
 
 void Reporter::ResetNetWeird(const std::string& name)
 	{
-	net_weird_state.erase(name);
+	auto it = weird_ids.find(name);
+
+	if ( it != weird_ids.end() )
+		ResetNetWeird(it->second);
 	}
 
 void Reporter::ResetFlowWeird(const IPAddr& orig, const IPAddr& resp)
@@ -266,13 +332,13 @@ void Reporter::ResetFlowWeird(const IPAddr& orig, const IPAddr& resp)
 	flow_weird_state.erase(std::make_pair(orig, resp));
 	}
 
-bool Reporter::PermitNetWeird(const char* name)
+bool Reporter::PermitNetWeird(uint32 id)
 	{
-	auto& count = net_weird_state[name];
+	auto& count = weirds[id].net_count;
 	++count;
 
 	if ( count == 1 )
-		timer_mgr->Add(new NetWeirdTimer(network_time, name,
+		timer_mgr->Add(new NetWeirdTimer(network_time, id,
 		                                 weird_sampling_duration));
 
 	if ( count <= weird_sampling_threshold )
@@ -285,17 +351,17 @@ bool Reporter::PermitNetWeird(const char* name)
 		return false;
 	}
 
-bool Reporter::PermitFlowWeird(const char* name,
+bool Reporter::PermitFlowWeird(uint32 id,
                                const IPAddr& orig, const IPAddr& resp)
 	{
 	auto endpoints = std::make_pair(orig, resp);
-	auto& map = flow_weird_state[endpoints];
+	auto& states = flow_weird_state[endpoints];
 
-	if ( map.empty() )
+	if ( states.empty() )
 		timer_mgr->Add(new FlowWeirdTimer(network_time, endpoints,
 		                                  weird_sampling_duration));
 
-	auto& count = map[name];
+	auto& count = FindWeirdState(states, id).count;
 	++count;
 
 	if ( count <= weird_sampling_threshold )
@@ -310,57 +376,69 @@ bool Reporter::PermitFlowWeird(const char* name,
 
 void Reporter::Weird(const char* name, const char* addl)
 	{
-	UpdateWeirdStats(name);
+	auto id = UpdateWeirdStats(name);
 
-	if ( ! WeirdOnSamplingWhiteList(name) )
+	if ( ! WeirdOnSamplingWhiteList(id) )
 		{
-		if ( ! PermitNetWeird(name) )
+		if ( ! PermitNetWeird(id) )
 			return;
 		}
 
+	if ( ! WantWeird(net_weird) )
+		return;
+
 	WeirdHelper(net_weird, {new StringVal(addl)}, "%s", name);
 	}
 
 void Reporter::Weird(file_analysis::File* f, const char* name, const char* addl)
 	{
-	UpdateWeirdStats(name);
+	auto id = UpdateWeirdStats(name);
 
-	if ( ! WeirdOnSamplingWhiteList(name) )
+	if ( ! WeirdOnSamplingWhiteList(id) )
 		{
-		if ( ! f->PermitWeird(name, weird_sampling_threshold,
+		if ( ! f->PermitWeird(id, weird_sampling_threshold,
 		                      weird_sampling_rate, weird_sampling_duration) )
 			return;
 		}
 
+	if ( ! WantWeird(file_weird) )
+		return;
+
 	WeirdHelper(file_weird, {f->GetVal()->Ref(), new StringVal(addl)},
 	            "%s", name);
 	}
 
 void Reporter::Weird(Connection* conn, const char* name, const char* addl)
 	{
-	UpdateWeirdStats(name);
+	auto id = UpdateWeirdStats(name);
 
-	if ( ! WeirdOnSamplingWhiteList(name) )
+	if ( ! WeirdOnSamplingWhiteList(id) )
 		{
-		if ( ! conn->PermitWeird(name, weird_sampling_threshold,
+		if ( ! conn->PermitWeird(id, weird_sampling_threshold,
 		                         weird_sampling_rate, weird_sampling_duration) )
 			return;
 		}
 
+	if ( ! WantWeird(conn_weird) )
+		return;
+
 	WeirdHelper(conn_weird, {conn->BuildConnVal(), new StringVal(addl)},
 	            "%s", name);
 	}
 
 void Reporter::Weird(const IPAddr& orig, const IPAddr& resp, const char* name, const char* addl)
 	{
-	UpdateWeirdStats(name);
+	auto id = UpdateWeirdStats(name);
 
-	if ( ! WeirdOnSamplingWhiteList(name) )
+	if ( ! WeirdOnSamplingWhiteList(id) )
 		{
-		if ( ! PermitFlowWeird(name, orig, resp) )
+		if ( ! PermitFlowWeird(id, orig, resp) )
 			 return;
 		}
 
+	if ( ! WantWeird(flow_weird) )
+		return;
+
 	WeirdHelper(flow_weird,
 	            {new AddrVal(orig), new AddrVal(resp), new StringVal(addl)},
 	            "%s", name);
@@ -9,12 +9,14 @@
 #include <utility>
 #include <string>
 #include <map>
+#include <vector>
 #include <unordered_set>
 #include <unordered_map>
 
 #include "util.h"
 #include "EventHandler.h"
 #include "IPAddr.h"
+#include "WeirdState.h"
 
 namespace analyzer { class Analyzer; }
 namespace file_analysis { class File; }
@@ -43,7 +45,7 @@ class Reporter {
 public:
 	using IPPair = std::pair<IPAddr, IPAddr>;
 	using WeirdCountMap = std::unordered_map<std::string, uint64>;
-	using WeirdFlowMap = std::map<IPPair, WeirdCountMap>;
+	using WeirdFlowMap = std::map<IPPair, WeirdStateVector>;
 	using WeirdSet = std::unordered_set<std::string>;
 
 	Reporter();
@@ -130,10 +132,27 @@ public:
 	// Signals that we're done processing an error handler event.
 	void EndErrorHandler()	{ --in_error_handler; }
 
+	/**
+	 * Returns the integer ID of a weird name, registering the name the
+	 * first time it is seen. The IDs key all sampling state, so that
+	 * weirds don't need to allocate or hash strings. Lookups are cached
+	 * by the address of *name*, which makes repeated weirds with the
+	 * same literal name cheap.
+	 */
+	uint32 WeirdID(const char* name);
+
+	/**
+	 * Returns the name of a weird registered with WeirdID().
+	 */
+	const std::string& WeirdName(uint32 id) const
+		{ return weirds[id].name; }
+
 	/**
 	 * Reset/cleanup state tracking for a "net" weird.
 	 */
 	void ResetNetWeird(const std::string& name);
+	void ResetNetWeird(uint32 id)
+		{ weirds[id].net_count = 0; }
 
 	/**
 	 * Reset/cleanup state tracking for a "flow" weird.
@@ -151,8 +170,7 @@ public:
 	 * Return number of weirds generated per weird type/name (counts weirds
 	 * before any rate-limiting occurs).
 	 */
-	const WeirdCountMap& GetWeirdsByType() const
-		{ return weird_count_by_type; }
+	WeirdCountMap GetWeirdsByType() const;
 
 	/**
 	 * Gets the weird sampling whitelist.
@@ -167,10 +185,7 @@ public:
 	 *
 	 * @param weird_sampling_whitelist New weird sampling whitelist.
 	 */
-	void SetWeirdSamplingWhitelist(const WeirdSet& weird_sampling_whitelist)
-		{
-		this->weird_sampling_whitelist = weird_sampling_whitelist;
-		}
+	void SetWeirdSamplingWhitelist(const WeirdSet& weird_sampling_whitelist);
 
 	/**
 	 * Gets the current weird sampling threshold.
@@ -248,11 +263,15 @@ private:
 	// WeirdHelper doesn't really have to be variadic, but it calls DoLog
 	// and that takes va_list anyway.
 	void WeirdHelper(EventHandlerPtr event, val_list vl, const char* fmt_name, ...) __attribute__((format(printf, 4, 5)));;
-	void UpdateWeirdStats(const char* name);
-	inline bool WeirdOnSamplingWhiteList(const char* name)
-		{ return weird_sampling_whitelist.find(name) != weird_sampling_whitelist.end(); }
-	bool PermitNetWeird(const char* name);
-	bool PermitFlowWeird(const char* name, const IPAddr& o, const IPAddr& r);
+	uint32 UpdateWeirdStats(const char* name);
+	inline bool WeirdOnSamplingWhiteList(uint32 id)
+		{ return weirds[id].whitelisted; }
+	bool PermitNetWeird(uint32 id);
+	bool PermitFlowWeird(uint32 id, const IPAddr& o, const IPAddr& r);
+
+	// Whether a weird raising the given event would be seen by anyone,
+	// so that the arguments aren't built just to be thrown away.
+	bool WantWeird(EventHandlerPtr event) const;
 
 	bool EmitToStderr(bool flag)
 		{ return flag || ! after_zeek_init; }
@@ -267,9 +286,24 @@ private:
 
 	std::list<std::pair<const Location*, const Location*> > locations;
 
+	struct WeirdInfo {
+		std::string name;
+		uint64 count;	// Before any sampling.
+		uint64 net_count;	// For sampling net weirds.
+		bool whitelisted;
+	};
+
+	struct WeirdIDCacheEntry {
+		const char* name;
+		uint32 id;
+	};
+
+	static const int WEIRD_ID_CACHE_SIZE = 256;
+
 	uint64 weird_count;
-	WeirdCountMap weird_count_by_type;
-	WeirdCountMap net_weird_state;
+	std::vector<WeirdInfo> weirds;
+	std::unordered_map<std::string, uint32> weird_ids;
+	WeirdIDCacheEntry weird_id_cache[WEIRD_ID_CACHE_SIZE];
 	WeirdFlowMap flow_weird_state;
 
 	WeirdSet weird_sampling_whitelist;
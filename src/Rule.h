@@ -26,6 +26,7 @@ public:
 		location = arg_location;
 		active = true;
 		next = 0;
+		condition_evals = matches = 0;
 		}
 
 	~Rule();
@@ -100,6 +101,10 @@ private:
 
 	Location location;
 
+	// Profiling counters, see RuleMatcher::GetRuleStats().
+	uint64 condition_evals;	// # conditions evaluated
+	uint64 matches;	// # times the rule's actions were executed
+
 	// Rules and payloads are numbered individually.
 	static unsigned int rule_counter;
 	static unsigned int pattern_counter;
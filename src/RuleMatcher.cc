@@ -1,8 +1,15 @@
 #include <algorithm>
 #include <functional>
+#include <unordered_map>
 
 #include "zeek-config.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "analyzer/Analyzer.h"
 #include "RuleMatcher.h"
 #include "DFA.h"
@@ -10,6 +17,7 @@
 #include "Scope.h"
 #include "File.h"
 #include "Reporter.h"
+#include "digest.h"
 
 // FIXME: Things that are not fully implemented/working yet:
 //
@@ -190,6 +198,32 @@ RuleEndpointState::~RuleEndpointState()
 		delete text;
 	}
 
+bool RuleEndpointState::MatchingDone() const
+	{
+	for ( const auto& r : matched_by_patterns )
+		{
+		if ( ! is_member_of(matched_rules, r->Index()) )
+			// Still waiting on further conditions.
+			return false;
+		}
+
+	for ( const auto& hdr_test : hdr_tests )
+		{
+		if ( hdr_test->pure_rules )
+			return false;
+		}
+
+	// Matchers for other pattern types get reset with each match,
+	// so they never settle.
+	for ( const auto& m : matchers )
+		{
+		if ( m->type != Rule::PAYLOAD || ! m->state->Dead() )
+			return false;
+		}
+
+	return true;
+	}
+
 RuleFileMagicState::~RuleFileMagicState()
 	{
 	for ( auto matcher : matchers )
@@ -265,6 +299,172 @@ bool RuleMatcher::ReadFiles(const name_list& files)
 	return ! parse_error;
 	}
 
+// A DFA state file starts with this, followed by the version and the number
+// of entries. Each entry then has the MD5 of a pattern, the length of the
+// data, and the data as written by DFA_Machine::Save(). Everything is in
+// host byte order, and all lengths are multiples of four.
+static const char DFA_STATES_MAGIC[4] = { 'Z', 'D', 'F', 'A' };
+static const uint32 DFA_STATES_VERSION = 1;
+
+static std::string pattern_key(const Specific_RE_Matcher* re)
+	{
+	u_char digest[MD5_DIGEST_LENGTH];
+	const char* text = re->PatternText() ? re->PatternText() : "";
+	internal_md5(reinterpret_cast<const u_char*>(text), strlen(text), digest);
+	return std::string(reinterpret_cast<const char*>(digest), sizeof(digest));
+	}
+
+void RuleMatcher::CollectMatchers(RuleHdrTest* hdr_test,
+				std::vector<Specific_RE_Matcher*>* matchers)
+	{
+	for ( int i = 0; i < Rule::TYPES; ++i )
+		for ( const auto& set : hdr_test->psets[i] )
+			if ( set->re && set->re->DFA() )
+				matchers->push_back(set->re);
+
+	for ( RuleHdrTest* h = hdr_test->child; h; h = h->sibling )
+		CollectMatchers(h, matchers);
+	}
+
+bool RuleMatcher::SaveDFAStates(const char* file)
+	{
+	std::vector<Specific_RE_Matcher*> matchers;
+	CollectMatchers(root, &matchers);
+
+	std::string buf(DFA_STATES_MAGIC, sizeof(DFA_STATES_MAGIC));
+	uint32 version = DFA_STATES_VERSION;
+	uint32 num = matchers.size();
+	buf.append(reinterpret_cast<const char*>(&version), sizeof(version));
+	buf.append(reinterpret_cast<const char*>(&num), sizeof(num));
+
+	for ( const auto& re : matchers )
+		{
+		std::string data;
+		re->DFA()->Save(&data);
+
+		uint32 len = data.size();
+		buf.append(pattern_key(re));
+		buf.append(reinterpret_cast<const char*>(&len), sizeof(len));
+		buf.append(data);
+		}
+
+	// Write to a temporary file first so that a concurrent reader
+	// never sees a partial one.
+	std::string tmp = fmt("%s.%d.tmp", file, getpid());
+	FILE* f = fopen(tmp.c_str(), "w");
+
+	if ( ! f )
+		{
+		reporter->Warning("cannot write DFA states to %s: %s", tmp.c_str(), strerror(errno));
+		return false;
+		}
+
+	bool ok = fwrite(buf.data(), buf.size(), 1, f) == 1;
+
+	if ( fclose(f) != 0 )
+		ok = false;
+
+	if ( ! ok || rename(tmp.c_str(), file) < 0 )
+		{
+		reporter->Warning("cannot write DFA states to %s: %s", file, strerror(errno));
+		unlink(tmp.c_str());
+		return false;
+		}
+
+	DBG_LOG(DBG_RULES, "saved DFA states of %d matchers to %s", num, file);
+	return true;
+	}
+
+bool RuleMatcher::LoadDFAStates(const char* file)
+	{
+	int fd = open(file, O_RDONLY);
+
+	if ( fd < 0 )
+		{
+		// Likely the first run; not worth complaining about.
+		DBG_LOG(DBG_RULES, "cannot open DFA state file %s: %s", file, strerror(errno));
+		return false;
+		}
+
+	struct stat st;
+	const size_t header_len = sizeof(DFA_STATES_MAGIC) + 2 * sizeof(uint32);
+
+	if ( fstat(fd, &st) < 0 || size_t(st.st_size) < header_len )
+		{
+		close(fd);
+		reporter->Warning("ignoring invalid DFA state file %s", file);
+		return false;
+		}
+
+	size_t size = st.st_size;
+	void* m = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if ( m == MAP_FAILED )
+		{
+		reporter->Warning("cannot map DFA state file %s: %s", file, strerror(errno));
+		return false;
+		}
+
+	const u_char* base = reinterpret_cast<const u_char*>(m);
+	const u_char* p = base + sizeof(DFA_STATES_MAGIC);
+	const u_char* end = base + size;
+
+	uint32 version, num;
+	memcpy(&version, p, sizeof(version));
+	memcpy(&num, p + sizeof(version), sizeof(num));
+	p += 2 * sizeof(uint32);
+
+	if ( memcmp(base, DFA_STATES_MAGIC, sizeof(DFA_STATES_MAGIC)) != 0 ||
+	     version != DFA_STATES_VERSION )
+		{
+		munmap(m, size);
+		reporter->Warning("ignoring invalid DFA state file %s", file);
+		return false;
+		}
+
+	std::unordered_map<std::string, std::pair<const u_char*, uint32>> entries;
+	const size_t entry_header_len = MD5_DIGEST_LENGTH + sizeof(uint32);
+
+	for ( uint32 i = 0; i < num; ++i )
+		{
+		uint32 len;
+
+		if ( size_t(end - p) < entry_header_len )
+			break;
+
+		memcpy(&len, p + MD5_DIGEST_LENGTH, sizeof(len));
+
+		if ( size_t(end - p) - entry_header_len < len )
+			break;
+
+		std::string key(reinterpret_cast<const char*>(p), MD5_DIGEST_LENGTH);
+		entries[key] = std::make_pair(p + entry_header_len, len);
+		p += entry_header_len + len;
+		}
+
+	std::vector<Specific_RE_Matcher*> matchers;
+	CollectMatchers(root, &matchers);
+
+	int loaded = 0;
+
+	for ( const auto& re : matchers )
+		{
+		auto e = entries.find(pattern_key(re));
+
+		if ( e != entries.end() &&
+		     re->DFA()->Load(e->second.first, e->second.second) )
+			++loaded;
+		}
+
+	munmap(m, size);
+
+	DBG_LOG(DBG_RULES, "loaded DFA states of %d out of %zu matchers from %s",
+		loaded, matchers.size(), file);
+
+	return true;
+	}
+
 void RuleMatcher::AddRule(Rule* rule)
 	{
 	if ( rules_by_id.Lookup(rule->ID()) )
@@ -347,6 +547,9 @@ void RuleMatcher::BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs,
 	// For each type, get all patterns on this node.
 	for ( Rule* r = hdr_test->pattern_rules; r; r = r->next )
 		{
+		if ( hdr_test == root && AddFixedMagic(r) )
+			continue;
+
 		for ( const auto& p : r->patterns )
 			{
 			exprs[p->type].push_back(p->pattern);
@@ -392,6 +595,155 @@ void RuleMatcher::BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs,
 	// If we're below the RE_level, the regexprs remains empty.
 	}
 
+// Parses a pattern that consists of fixed bytes at fixed offsets from the
+// beginning of the data, with "." standing for any byte as file magic
+// matches multiline.  Returns false for anything else.
+static bool parse_fixed_magic(const char* s,
+                              std::vector<std::pair<uint32, std::string>>* runs,
+                              uint32* min_len)
+	{
+	if ( *s++ != '^' )
+		return false;
+
+	uint32 pos = 0;
+	uint32 run_start = 0;
+	string run;
+
+	while ( *s )
+		{
+		bool any = false;
+		int c = 0;
+
+		if ( *s == '.' )
+			{
+			any = true;
+			++s;
+			}
+
+		else if ( *s == '\\' )
+			{
+			++s;
+
+			if ( ! *s || *s == '\n' )
+				return false;
+
+			if ( *s == 'x' && ! (isxdigit(s[1]) && isxdigit(s[2])) )
+				// The regexp scanner takes that as a plain 'x'.
+				return false;
+
+			bool octal = (*s >= '0' && *s <= '7');
+			c = expand_escape(s);
+
+			if ( octal && *s >= '0' && *s <= '7' )
+				// Ambiguous, leave it to the regexp scanner.
+				return false;
+			}
+
+		else if ( strchr("[]()|*+?{}^$\"", *s) )
+			return false;
+
+		else
+			c = static_cast<u_char>(*s++);
+
+		uint32 n = 1;
+
+		if ( *s == '{' )
+			{
+			char* end;
+			n = strtoul(s + 1, &end, 10);
+
+			if ( end == s + 1 || *end != '}' || n > 65535 )
+				return false;
+
+			s = end + 1;
+			}
+
+		else if ( *s && strchr("*+?", *s) )
+			return false;
+
+		for ( uint32 i = 0; i < n; ++i, ++pos )
+			{
+			if ( any )
+				{
+				if ( ! run.empty() )
+					{
+					runs->emplace_back(run_start, run);
+					run.clear();
+					}
+
+				continue;
+				}
+
+			if ( run.empty() )
+				run_start = pos;
+
+			run += static_cast<char>(c);
+			}
+		}
+
+	if ( ! run.empty() )
+		runs->emplace_back(run_start, run);
+
+	*min_len = pos;
+	return ! runs->empty();
+	}
+
+bool RuleMatcher::AddFixedMagic(Rule* r)
+	{
+	if ( r->patterns.length() != 1 )
+		return false;
+
+	const Rule::Pattern* p = r->patterns[0];
+
+	if ( p->type != Rule::FILE_MAGIC || p->depth != INT_MAX )
+		return false;
+
+	FixedMagic fm;
+	fm.rule = r;
+
+	if ( ! parse_fixed_magic(p->pattern, &fm.runs, &fm.min_len) )
+		return false;
+
+	DBG_LOG(DBG_RULES, "Matching file magic of %s without DFA", r->ID());
+
+	uint32 offset = fm.runs[0].first;
+	u_char first = fm.runs[0].second[0];
+	fixed_magic[offset][first].push_back(std::move(fm));
+	return true;
+	}
+
+void RuleMatcher::MatchFixedMagic(const u_char* data, uint64 len,
+                                  std::set<Rule*>* matches) const
+	{
+	// These are ordered by offset.
+	for ( const auto& anchor : fixed_magic )
+		{
+		if ( anchor.first >= len )
+			break;
+
+		for ( const auto& fm : anchor.second[data[anchor.first]] )
+			{
+			if ( len < fm.min_len )
+				continue;
+
+			bool matched = true;
+
+			for ( const auto& run : fm.runs )
+				{
+				if ( memcmp(data + run.first, run.second.data(),
+				            run.second.size()) != 0 )
+					{
+					matched = false;
+					break;
+					}
+				}
+
+			if ( matched )
+				matches->insert(fm.rule);
+			}
+		}
+	}
+
 void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst,
 				const string_list& exprs, const int_list& ids)
 	{
@@ -585,6 +937,7 @@ RuleFileMagicState* RuleMatcher::InitFileMagic() const
 		assert(set->re);
 		RuleFileMagicState::Matcher* m = new RuleFileMagicState::Matcher;
 		m->state = new RE_Match_State(set->re);
+		m->set = set;
 		state->matchers.push_back(m);
 		}
 
@@ -644,11 +997,22 @@ RuleMatcher::MIME_Matches* RuleMatcher::Match(RuleFileMagicState* state,
 
 	for ( const auto& m : state->matchers )
 		{
+		m->set->bytes_scanned += len;
+
 		if ( m->state->Match(data, len, true, false, true) )
 			newmatch = true;
 		}
 
-	if ( ! newmatch )
+	// Find rules for which patterns have matched.
+	set<Rule*> rule_matches;
+
+	if ( state->bof && len > 0 )
+		{
+		MatchFixedMagic(data, len, &rule_matches);
+		state->bof = false;
+		}
+
+	if ( ! newmatch && rule_matches.empty() )
 		return rval;
 
 	DBG_LOG(DBG_RULES, "New pattern match found");
@@ -661,9 +1025,6 @@ RuleMatcher::MIME_Matches* RuleMatcher::Match(RuleFileMagicState* state,
 		accepted_matches.insert(ams.begin(), ams.end());
 		}
 
-	// Find rules for which patterns have matched.
-	set<Rule*> rule_matches;
-
 	for ( AcceptingMatchSet::const_iterator it = accepted_matches.begin();
 	      it != accepted_matches.end(); ++it )
 		{
@@ -741,6 +1102,7 @@ RuleEndpointState* RuleMatcher::InitEndpoint(analyzer::Analyzer* analyzer,
 						new RuleEndpointState::Matcher;
 					m->state = new RE_Match_State(set->re);
 					m->type = (Rule::PatternType) i;
+					m->set = set;
 					state->matchers.push_back(m);
 					}
 				}
@@ -853,8 +1215,13 @@ void RuleMatcher::Match(RuleEndpointState* state, Rule::PatternType type,
 	// Feed data into all relevant matchers.
 	for ( const auto& m : state->matchers )
 		{
-		if ( m->type == type &&
-		     m->state->Match((const u_char*) data, data_len,
+		if ( m->type != type )
+			continue;
+
+		if ( clear || ! m->state->Dead() )
+			m->set->bytes_scanned += data_len;
+
+		if ( m->state->Match((const u_char*) data, data_len,
 					bol, eol, clear) )
 			newmatch = true;
 		}
@@ -1019,8 +1386,12 @@ bool RuleMatcher::EvalRuleConditions(Rule* r, RuleEndpointState* state,
 		}
 
 	for ( const auto& cond : r->conditions )
+		{
+		++r->condition_evals;
+
 		if ( ! cond->DoMatch(r, state, data, len) )
 			return false;
+		}
 
 	DBG_LOG(DBG_RULES, "Conditions met: MATCH! %s", r->ID());
 	return true;
@@ -1035,6 +1406,7 @@ void RuleMatcher::ExecRuleActions(Rule* r, RuleEndpointState* state,
 		return;
 
 	state->matched_rules.push_back(r->Index());
+	++r->matches;
 
 	for ( const auto& action : r->actions )
 		action->DoAction(r, state, data, len);
@@ -1093,6 +1465,8 @@ void RuleMatcher::ClearFileMagicState(RuleFileMagicState* state) const
 	{
 	for ( const auto& matcher : state->matchers )
 		matcher->state->Clear();
+
+	state->bof = true;
 	}
 
 void RuleMatcher::PrintDebug()
@@ -1188,6 +1562,79 @@ void RuleMatcher::GetStats(Stats* stats, RuleHdrTest* hdr_test)
 		GetStats(stats, h);
 	}
 
+void RuleMatcher::GetMatcherSetStats(std::vector<MatcherSetStats>* stats,
+					RuleHdrTest* hdr_test)
+	{
+	if ( ! hdr_test )
+		hdr_test = root;
+
+	DFA_State_Cache::Stats cstats;
+
+	for ( int i = 0; i < Rule::TYPES; ++i )
+		{
+		for ( const auto& set : hdr_test->psets[i] )
+			{
+			assert(set->re);
+
+			DFA_Machine* dfa = set->re->DFA();
+			dfa->Cache()->GetStats(&cstats);
+
+			MatcherSetStats s;
+			s.type = Rule::PatternType(i);
+			s.patterns = set->patterns.length();
+			s.nfa_states = cstats.nfa_states;
+			s.dfa_states = cstats.dfa_states;
+			s.computed = cstats.computed;
+			s.mem = cstats.mem;
+			s.hits = cstats.hits;
+			s.misses = cstats.misses;
+			s.dense_states = dfa->NumDenseStates();
+			stats->push_back(s);
+			}
+		}
+
+	for ( RuleHdrTest* h = hdr_test->child; h; h = h->sibling )
+		GetMatcherSetStats(stats, h);
+	}
+
+void RuleMatcher::GetRuleStats(std::vector<RuleStats>* stats)
+	{
+	std::map<const Rule*, uint64> bytes;
+	CollectBytesScanned(root, &bytes);
+
+	for ( const auto& r : rules )
+		{
+		RuleStats s;
+		s.rule = r;
+		s.bytes_scanned = bytes[r];
+		s.condition_evals = r->condition_evals;
+		s.matches = r->matches;
+		stats->push_back(s);
+		}
+	}
+
+void RuleMatcher::CollectBytesScanned(RuleHdrTest* hdr_test,
+					std::map<const Rule*, uint64>* bytes)
+	{
+	for ( int i = 0; i < Rule::TYPES; ++i )
+		{
+		for ( const auto& set : hdr_test->psets[i] )
+			{
+			// A rule may have several patterns in the same set.
+			std::set<const Rule*> covered;
+
+			for ( const auto& id : set->ids )
+				covered.insert(Rule::rule_table[id - 1]);
+
+			for ( const auto& r : covered )
+				(*bytes)[r] += set->bytes_scanned;
+			}
+		}
+
+	for ( RuleHdrTest* h = hdr_test->child; h; h = h->sibling )
+		CollectBytesScanned(h, bytes);
+	}
+
 void RuleMatcher::DumpStats(BroFile* f)
 	{
 	Stats stats;
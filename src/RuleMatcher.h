@@ -2,6 +2,7 @@
 #define sigs_h
 
 #include <limits.h>
+#include <array>
 #include <vector>
 #include <map>
 #include <functional>
@@ -100,9 +101,11 @@ private:
 
 	// The following are all set by RuleMatcher::BuildRulesTree().
 	friend class RuleMatcher;
+	friend class RuleEndpointState;
+	friend class RuleFileMagicState;
 
 	struct PatternSet {
-		PatternSet() : re() {}
+		PatternSet() : re(), bytes_scanned() {}
 
 		// If we're above the 'RE_level' (see RuleMatcher), this
 		// expr contains all patterns on this node. If we're on
@@ -113,6 +116,9 @@ private:
 		// All the patterns and their rule indices.
 		string_list patterns;
 		int_list ids;	// (only needed for debugging)
+
+		// Number of bytes fed into the matcher across all streams.
+		uint64 bytes_scanned;
 	};
 
 	typedef PList<PatternSet> pattern_set_list;
@@ -151,6 +157,12 @@ public:
 	// Returns -1 if no chunk has been fed yet at all.
 	int PayloadSize()	{ return payload_size; }
 
+	// Returns true if no further input can make any more signatures
+	// match for this endpoint: all pattern matchers are purely for
+	// payload and have run into a dead state, and there aren't any
+	// rules left that may still trigger on other conditions.
+	bool MatchingDone() const;
+
 	analyzer::pia::PIA* PIA() const	{ return pia; }
 
 private:
@@ -164,6 +176,7 @@ private:
 	struct Matcher {
 		RE_Match_State* state;
 		Rule::PatternType type;
+		RuleHdrTest::PatternSet* set;
 	};
 
 	typedef PList<Matcher> matcher_list;
@@ -199,10 +212,15 @@ private:
 	// Ctor is private; use RuleMatcher::InitFileMagic() for
 	// instantiation.
 	RuleFileMagicState()
-		{ }
+		{ bof = true; }
+
+	// True until the first data has been matched; fixed magic is only
+	// looked for at the beginning.
+	bool bof;
 
 	struct Matcher {
 		RE_Match_State* state;
+		RuleHdrTest::PatternSet* set;
 	};
 
 	typedef PList<Matcher> matcher_list;
@@ -282,6 +300,14 @@ public:
 
 	void PrintDebug();
 
+	// Writes the DFA states computed so far for all patterns to a file,
+	// so that a later run with the same signatures can pick up from
+	// there through LoadDFAStates(), rather than having to build them all
+	// over again while traffic is coming in. Patterns that have changed
+	// in between are skipped when loading.
+	bool SaveDFAStates(const char* file);
+	bool LoadDFAStates(const char* file);
+
 	// Interface to parser
 	void AddRule(Rule* rule);
 	void SetParseError()		{ parse_error = true; }
@@ -307,6 +333,36 @@ public:
 					const RuleEndpointState* state) const;
 
 	void GetStats(Stats* stats, RuleHdrTest* hdr_test = 0);
+
+	// Statistics for each matcher individually.
+	struct MatcherSetStats {
+		Rule::PatternType type;
+		unsigned int patterns;	// # patterns covered by the matcher
+		unsigned int nfa_states;
+		unsigned int dfa_states;
+		unsigned int computed;
+		unsigned int mem;
+		unsigned int hits;
+		unsigned int misses;
+		unsigned int dense_states;	// # DFA states in the dense table
+	};
+
+	void GetMatcherSetStats(std::vector<MatcherSetStats>* stats,
+				RuleHdrTest* hdr_test = 0);
+
+	// Profiling information for each rule.
+	struct RuleStats {
+		const Rule* rule;
+
+		// # bytes scanned by matchers covering any of the rule's
+		// patterns.
+		uint64 bytes_scanned;
+
+		uint64 condition_evals;	// # conditions evaluated
+		uint64 matches;	// # times the rule matched
+	};
+
+	void GetRuleStats(std::vector<RuleStats>* stats);
 	void DumpStats(BroFile* f);
 
 private:
@@ -350,16 +406,44 @@ private:
 
 	void PrintTreeDebug(RuleHdrTest* node);
 
+	// Collects the matchers of all pattern sets.
+	void CollectMatchers(RuleHdrTest* hdr_test,
+				std::vector<Specific_RE_Matcher*>* matchers);
+
 	void DumpStateStats(BroFile* f, RuleHdrTest* hdr_test);
 
+	// Adds the bytes scanned by each pattern set to the rules it covers.
+	void CollectBytesScanned(RuleHdrTest* hdr_test,
+				std::map<const Rule*, uint64>* bytes);
+
 	static bool AllRulePatternsMatched(const Rule* r, MatchPos matchpos,
 	                                   const AcceptingMatchSet& ams);
 
+	// A file magic signature whose single pattern is fixed bytes at
+	// fixed offsets from the beginning, like /^PK\x03\x04/ or
+	// /^.{20}\xdc\xa7/.  Those get matched without the DFA.
+	struct FixedMagic {
+		Rule* rule;
+		uint32 min_len;	// Bytes needed for the pattern to match.
+		std::vector<std::pair<uint32, std::string>> runs;	// Bytes by offset.
+	};
+
+	// Registers a rule as fixed magic if it is one.
+	bool AddFixedMagic(Rule* r);
+
+	// Adds the fixed magic signatures matching the beginning of a file.
+	void MatchFixedMagic(const u_char* data, uint64 len,
+	                     std::set<Rule*>* matches) const;
+
 	int RE_level;
 	bool parse_error;
 	RuleHdrTest* root;
 	rule_list rules;
 	rule_dict rules_by_id;
+
+	// Fixed magic signatures, by the offset of their first fixed byte and
+	// then the value of that byte.
+	std::map<uint32, std::array<std::vector<FixedMagic>, 256>> fixed_magic;
 };
 
 // Keeps bi-directional matching-state.
@@ -384,6 +468,15 @@ public:
 	bool MatcherInitialized(bool orig)
 		{ return orig ? orig_match_state : resp_match_state; }
 
+	// Returns true if both endpoints have been initialized and no
+	// signature can match anymore for either of them.
+	bool MatchingDone() const
+		{
+		return orig_match_state && resp_match_state &&
+			orig_match_state->MatchingDone() &&
+			resp_match_state->MatchingDone();
+		}
+
 private:
 	RuleEndpointState* orig_match_state;
 	RuleEndpointState* resp_match_state;
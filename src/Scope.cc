@@ -116,7 +116,14 @@ TraversalCode Scope::Traverse(TraversalCallback* cb) const
 	while ( (id = ids->NextEntry(key, iter)) )
 		{
 		TraversalCode tc = id->Traverse(cb);
-		HANDLE_TC_STMT_PRE(tc);
+
+		if ( tc == TC_ABORTALL || tc == TC_ABORTSTMT )
+			{
+			// The cookie would otherwise keep the dictionary
+			// from compacting.
+			ids->StopIteration(iter);
+			return tc;
+			}
 		}
 
 	return TC_CONTINUE;
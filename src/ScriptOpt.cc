@@ -0,0 +1,294 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "ScriptOpt.h"
+#include "Traverse.h"
+#include "DebugLogger.h"
+
+// Whether values of the given type can be put into a constant. Aggregates
+// remain mutable even if they're declared const, so we leave them alone.
+static bool is_foldable_type(const BroType* t)
+	{
+	switch ( t->Tag() ) {
+	case TYPE_BOOL:
+	case TYPE_INT:
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+	case TYPE_STRING:
+	case TYPE_PORT:
+	case TYPE_ENUM:
+		return true;
+
+	default:
+		return false;
+	}
+	}
+
+// Operators that can't have side effects and, with the exception of
+// division by zero, can't fail.
+static bool is_foldable_op(BroExprTag tag)
+	{
+	switch ( tag ) {
+	case EXPR_NOT:
+	case EXPR_COMPLEMENT:
+	case EXPR_POSITIVE:
+	case EXPR_NEGATE:
+	case EXPR_ADD:
+	case EXPR_SUB:
+	case EXPR_TIMES:
+	case EXPR_DIVIDE:
+	case EXPR_MOD:
+	case EXPR_AND:
+	case EXPR_OR:
+	case EXPR_XOR:
+	case EXPR_AND_AND:
+	case EXPR_OR_OR:
+	case EXPR_LT:
+	case EXPR_LE:
+	case EXPR_EQ:
+	case EXPR_NE:
+	case EXPR_GE:
+	case EXPR_GT:
+	case EXPR_ARITH_COERCE:
+		return true;
+
+	default:
+		return false;
+	}
+	}
+
+static bool is_unary_op(BroExprTag tag)
+	{
+	return tag == EXPR_NOT || tag == EXPR_COMPLEMENT ||
+		tag == EXPR_POSITIVE || tag == EXPR_NEGATE ||
+		tag == EXPR_ARITH_COERCE;
+	}
+
+static bool is_const_operand(const Expr* e)
+	{
+	return e->IsConst() && is_foldable_type(e->Type());
+	}
+
+class ConstantFolder : public TraversalCallback {
+public:
+	ConstantFolder()	{ num_folded = 0; }
+
+	TraversalCode PostStmt(const Stmt* s) override;
+	TraversalCode PostExpr(const Expr* e) override;
+
+	int num_folded;
+
+private:
+	// Returns an expression to use in place of e, or nil if it
+	// stays as it is.
+	Expr* Fold(const Expr* e);
+
+	Expr* MakeConst(const Expr* e, Val* v);
+};
+
+Expr* ConstantFolder::MakeConst(const Expr* e, Val* v)
+	{
+	Expr* c = new ConstExpr(v);
+	c->SetLocationInfo(e->GetLocationInfo());
+	++num_folded;
+	return c;
+	}
+
+Expr* ConstantFolder::Fold(const Expr* e)
+	{
+	if ( e->IsError() || ! is_foldable_type(e->Type()) )
+		return 0;
+
+	if ( e->Tag() == EXPR_NAME )
+		{
+		const ID* id = static_cast<const NameExpr*>(e)->Id();
+
+		if ( ! id->IsGlobal() || ! id->IsConst() || id->AsType() ||
+		     ! id->ID_Val() || ! same_type(id->Type(), e->Type()) )
+			return 0;
+
+		return MakeConst(e, const_cast<Val*>(id->ID_Val())->Ref());
+		}
+
+	if ( e->Tag() == EXPR_COND )
+		{
+		const CondExpr* ce = static_cast<const CondExpr*>(e);
+
+		if ( ! ce->Op1()->IsConst() || ce->Op1()->Type()->Tag() != TYPE_BOOL )
+			return 0;
+
+		const Expr* branch = ce->Op1()->ExprVal()->IsZero() ?
+					ce->Op3() : ce->Op2();
+
+		if ( ! same_type(branch->Type(), e->Type()) )
+			return 0;
+
+		++num_folded;
+		return const_cast<Expr*>(branch)->Ref();
+		}
+
+	if ( ! is_foldable_op(e->Tag()) )
+		return 0;
+
+	if ( is_unary_op(e->Tag()) )
+		{
+		if ( ! is_const_operand(static_cast<const UnaryExpr*>(e)->Op()) )
+			return 0;
+		}
+
+	else
+		{
+		const BinaryExpr* be = static_cast<const BinaryExpr*>(e);
+
+		if ( ! is_const_operand(be->Op1()) || ! is_const_operand(be->Op2()) )
+			return 0;
+
+		// Leave reporting the error to run-time.
+		if ( (e->Tag() == EXPR_DIVIDE || e->Tag() == EXPR_MOD) &&
+		     be->Op2()->IsZero() )
+			return 0;
+		}
+
+	Val* v = e->Eval(0);
+
+	if ( ! v )
+		return 0;
+
+	return MakeConst(e, v);
+	}
+
+TraversalCode ConstantFolder::PostExpr(const Expr* arg_e)
+	{
+	// We get to see each expression after its operands, so these have
+	// been folded already when we look at whether the operands of
+	// this one can be folded in turn.
+	Expr* e = const_cast<Expr*>(arg_e);
+	Expr* f;
+
+	switch ( e->Tag() ) {
+	case EXPR_REF:
+		// Lvalues stay as they are.
+		break;
+
+	case EXPR_INCR:
+	case EXPR_DECR:
+		break;
+
+	case EXPR_ASSIGN:
+	case EXPR_ADD_TO:
+	case EXPR_REMOVE_FROM:
+		{
+		BinaryExpr* be = static_cast<BinaryExpr*>(e);
+
+		if ( (f = Fold(be->Op2())) )
+			be->SetOp2(f);
+
+		break;
+		}
+
+	case EXPR_COND:
+		{
+		CondExpr* ce = static_cast<CondExpr*>(e);
+
+		if ( (f = Fold(ce->Op1())) )
+			ce->SetOp1(f);
+
+		if ( (f = Fold(ce->Op2())) )
+			ce->SetOp2(f);
+
+		if ( (f = Fold(ce->Op3())) )
+			ce->SetOp3(f);
+
+		break;
+		}
+
+	case EXPR_LIST:
+		{
+		expr_list& exprs = e->AsListExpr()->Exprs();
+
+		loop_over_list(exprs, i)
+			if ( (f = Fold(exprs[i])) )
+				{
+				Unref(exprs[i]);
+				exprs.replace(i, f);
+				}
+
+		break;
+		}
+
+	case EXPR_FIELD_ASSIGN:
+	case EXPR_SIZE:
+		{
+		UnaryExpr* ue = static_cast<UnaryExpr*>(e);
+
+		if ( (f = Fold(ue->Op())) )
+			ue->SetOp(f);
+
+		break;
+		}
+
+	default:
+		if ( ! is_foldable_op(e->Tag()) )
+			break;
+
+		if ( is_unary_op(e->Tag()) )
+			{
+			UnaryExpr* ue = static_cast<UnaryExpr*>(e);
+
+			if ( (f = Fold(ue->Op())) )
+				ue->SetOp(f);
+			}
+
+		else
+			{
+			BinaryExpr* be = static_cast<BinaryExpr*>(e);
+
+			if ( (f = Fold(be->Op1())) )
+				be->SetOp1(f);
+
+			if ( (f = Fold(be->Op2())) )
+				be->SetOp2(f);
+			}
+
+		break;
+	}
+
+	return TC_CONTINUE;
+	}
+
+TraversalCode ConstantFolder::PostStmt(const Stmt* arg_s)
+	{
+	switch ( arg_s->Tag() ) {
+	case STMT_EXPR:
+	case STMT_IF:
+	case STMT_SWITCH:
+	case STMT_RETURN:
+		{
+		ExprStmt* s = static_cast<ExprStmt*>(const_cast<Stmt*>(arg_s));
+		Expr* f;
+
+		if ( s->StmtExpr() && (f = Fold(s->StmtExpr())) )
+			s->SetStmtExpr(f);
+
+		break;
+		}
+
+	default:
+		break;
+	}
+
+	return TC_CONTINUE;
+	}
+
+int fold_script_constants()
+	{
+	ConstantFolder cf;
+	traverse_all(&cf);
+
+	DBG_LOG(DBG_SCRIPTS, "folded %d constant expressions", cf.num_folded);
+	return cf.num_folded;
+	}
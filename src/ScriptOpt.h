@@ -0,0 +1,13 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef scriptopt_h
+#define scriptopt_h
+
+// Rewrites the bodies of all script functions, event handlers and hooks,
+// as well as the global statements, replacing constant subexpressions with
+// their values. This includes references to scalar constants, which have
+// their final values once parsing (and with it any redefs) is done. Returns
+// the number of expressions replaced.
+extern int fold_script_constants();
+
+#endif
@@ -0,0 +1,933 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <algorithm>
+
+#include "ScriptVM.h"
+#include "Func.h"
+#include "Stmt.h"
+#include "Expr.h"
+#include "Val.h"
+#include "ID.h"
+#include "Reporter.h"
+
+// The instruction set. Suffixes name the kind of register operands: _I
+// for int and bool, _U for count, _D for double, time and interval.
+enum {
+	OP_LOADK,	// dst = k
+	OP_LOADG,	// dst = value of globals[a]
+	OP_MOV,		// dst = a
+	OP_CHKSET,	// give up if local a hasn't been assigned
+	OP_SETDEF,	// mark local a as assigned
+	OP_UNSET,	// mark local a as not assigned
+
+	OP_ADD_I, OP_ADD_U, OP_ADD_D,
+	OP_SUB_I, OP_SUB_U, OP_SUB_D,
+	OP_MUL_I, OP_MUL_U, OP_MUL_D,
+	OP_DIV_I, OP_DIV_U, OP_DIV_D,
+	OP_MOD_I, OP_MOD_U,
+	OP_BAND_U, OP_BOR_U, OP_BXOR_U,
+
+	// dst = a <op> b, with dst being a bool.
+	OP_LT_I, OP_LT_U, OP_LT_D,
+	OP_LE_I, OP_LE_U, OP_LE_D,
+	OP_EQ_I, OP_EQ_U, OP_EQ_D,
+	OP_NE_I, OP_NE_U, OP_NE_D,
+
+	OP_NEG_I, OP_NEG_D,
+	OP_NOT,
+	OP_CPL_U,
+
+	// Conversions, dst = a.
+	OP_I2U, OP_I2D, OP_U2I, OP_U2D, OP_D2I, OP_D2U,
+
+	// In-place increment/decrement of a.
+	OP_INC_I, OP_INC_U, OP_DEC_I, OP_DEC_U,
+
+	OP_JMP,		// continue at dst
+	OP_JMPF,	// continue at dst if a is zero
+	OP_JMPT,	// continue at dst if a is non-zero
+
+	OP_RET,		// return a
+	OP_RETV,	// return without a value
+	OP_END,		// fell off the end of the body
+};
+
+// The kinds of values a register can hold, by the internal type.
+static bool is_vm_type(const BroType* t)
+	{
+	switch ( t->Tag() ) {
+	case TYPE_BOOL:
+	case TYPE_INT:
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		return true;
+
+	default:
+		return false;
+	}
+	}
+
+static CompiledFunc::Slot val_to_slot(const Val* v)
+	{
+	CompiledFunc::Slot s;
+
+	switch ( v->Type()->InternalType() ) {
+	case TYPE_INTERNAL_INT:
+		s.i = v->InternalInt();
+		break;
+
+	case TYPE_INTERNAL_UNSIGNED:
+		s.u = v->InternalUnsigned();
+		break;
+
+	default:
+		s.d = v->InternalDouble();
+		break;
+	}
+
+	return s;
+	}
+
+// Builds the Val the interpreter would produce for a value of type t.
+static Val* slot_to_val(const CompiledFunc::Slot& s, const BroType* t)
+	{
+	switch ( t->Tag() ) {
+	case TYPE_BOOL:
+		return val_mgr->GetBool(s.i);
+
+	case TYPE_INT:
+		return val_mgr->GetInt(s.i);
+
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+		return val_mgr->GetCount(s.u);
+
+	case TYPE_INTERVAL:
+		return new IntervalVal(s.d, 1.0);
+
+	default:
+		return new Val(s.d, t->Tag());
+	}
+	}
+
+// Turns the AST of a function body into bytecode.
+class FuncCompiler {
+public:
+	FuncCompiler(CompiledFunc* arg_cf, int frame_size)
+		{
+		cf = arg_cf;
+		num_locals = num_regs = frame_size;
+		}
+
+	bool CompileStmt(const Stmt* s);
+
+	// Returns the register holding the result, or -1 if the expression
+	// can't be compiled.
+	int CompileExpr(const Expr* e);
+
+	int NumRegs() const	{ return num_regs; }
+
+	int Emit(int op, int dst = 0, int a = 0, int b = 0)
+		{
+		CompiledFunc::Instr i;
+		i.op = op;
+		i.dst = dst;
+		i.a = a;
+		i.b = b;
+		i.k.u = 0;
+		cf->code.push_back(i);
+		return cf->code.size() - 1;
+		}
+
+	// Returns the index of the next instruction to be emitted.
+	int Here() const	{ return cf->code.size(); }
+
+	void PatchJump(int at, int target)	{ cf->code[at].dst = target; }
+
+private:
+	int NewReg()	{ return num_regs++; }
+
+	// Returns the frame offset of the local the (lvalue) expression
+	// refers to, or -1 if it's anything else.
+	int LocalOf(const Expr* e) const;
+
+	int CompileBinary(const BinaryExpr* e);
+	int CompileBool(const BinaryExpr* e);
+	int CompileUnary(const UnaryExpr* e);
+	int CompileUpdate(const BinaryExpr* e);
+	int CompileCond(const CondExpr* e);
+
+	struct Loop {
+		int start;
+		std::vector<int> breaks;
+	};
+
+	CompiledFunc* cf;
+	int num_locals;
+	int num_regs;
+	std::vector<Loop> loops;
+};
+
+int FuncCompiler::LocalOf(const Expr* e) const
+	{
+	if ( e->Tag() == EXPR_REF )
+		e = static_cast<const RefExpr*>(e)->Op();
+
+	if ( e->Tag() != EXPR_NAME )
+		return -1;
+
+	const ID* id = static_cast<const NameExpr*>(e)->Id();
+
+	if ( id->IsGlobal() || id->AsType() || ! is_vm_type(id->Type()) )
+		return -1;
+
+	if ( id->Offset() < 0 || id->Offset() >= num_locals )
+		return -1;
+
+	return id->Offset();
+	}
+
+bool FuncCompiler::CompileStmt(const Stmt* s)
+	{
+	switch ( s->Tag() ) {
+	case STMT_LIST:
+		for ( const auto& stmt : s->AsStmtList()->Stmts() )
+			if ( ! CompileStmt(stmt) )
+				return false;
+
+		return true;
+
+	case STMT_EXPR:
+		return CompileExpr(static_cast<const ExprStmt*>(s)->StmtExpr()) >= 0;
+
+	case STMT_IF:
+		{
+		const IfStmt* if_stmt = static_cast<const IfStmt*>(s);
+		const Expr* cond = if_stmt->StmtExpr();
+
+		if ( cond->Type()->InternalType() == TYPE_INTERNAL_DOUBLE )
+			return false;
+
+		int c = CompileExpr(cond);
+
+		if ( c < 0 )
+			return false;
+
+		int to_else = Emit(OP_JMPF, 0, c);
+
+		if ( ! CompileStmt(if_stmt->TrueBranch()) )
+			return false;
+
+		int to_end = Emit(OP_JMP);
+		PatchJump(to_else, Here());
+
+		if ( ! CompileStmt(if_stmt->FalseBranch()) )
+			return false;
+
+		PatchJump(to_end, Here());
+		return true;
+		}
+
+	case STMT_WHILE:
+		{
+		const WhileStmt* w = static_cast<const WhileStmt*>(s);
+
+		if ( w->Condition()->Type()->Tag() != TYPE_BOOL )
+			return false;
+
+		Loop l;
+		l.start = Here();
+
+		int c = CompileExpr(w->Condition());
+
+		if ( c < 0 )
+			return false;
+
+		l.breaks.push_back(Emit(OP_JMPF, 0, c));
+		loops.push_back(l);
+
+		if ( ! CompileStmt(w->Body()) )
+			return false;
+
+		Emit(OP_JMP, loops.back().start);
+
+		for ( auto b : loops.back().breaks )
+			PatchJump(b, Here());
+
+		loops.pop_back();
+		return true;
+		}
+
+	case STMT_BREAK:
+		if ( loops.empty() )
+			return false;
+
+		loops.back().breaks.push_back(Emit(OP_JMP));
+		return true;
+
+	case STMT_NEXT:
+		if ( loops.empty() )
+			return false;
+
+		Emit(OP_JMP, loops.back().start);
+		return true;
+
+	case STMT_RETURN:
+		{
+		const Expr* e = static_cast<const ReturnStmt*>(s)->StmtExpr();
+
+		if ( ! e )
+			{
+			Emit(OP_RETV);
+			return true;
+			}
+
+		if ( ! cf->ret_type ||
+		     e->Type()->InternalType() != cf->ret_type->InternalType() )
+			return false;
+
+		int r = CompileExpr(e);
+
+		if ( r < 0 )
+			return false;
+
+		Emit(OP_RET, 0, r);
+		return true;
+		}
+
+	case STMT_INIT:
+		for ( const auto& id : *static_cast<const InitStmt*>(s)->Inits() )
+			{
+			if ( id->IsGlobal() || ! is_vm_type(id->Type()) ||
+			     id->Offset() < 0 || id->Offset() >= num_locals )
+				return false;
+
+			Emit(OP_UNSET, 0, id->Offset());
+			}
+
+		return true;
+
+	case STMT_NULL:
+		return true;
+
+	default:
+		return false;
+	}
+	}
+
+int FuncCompiler::CompileExpr(const Expr* e)
+	{
+	if ( e->IsError() || ! is_vm_type(e->Type()) )
+		return -1;
+
+	switch ( e->Tag() ) {
+	case EXPR_CONST:
+		{
+		const Val* v = static_cast<const ConstExpr*>(e)->Value();
+
+		if ( ! is_vm_type(v->Type()) ||
+		     v->Type()->InternalType() != e->Type()->InternalType() )
+			return -1;
+
+		int r = NewReg();
+		int i = Emit(OP_LOADK, r);
+		cf->code[i].k = val_to_slot(v);
+		return r;
+		}
+
+	case EXPR_NAME:
+		{
+		ID* id = static_cast<const NameExpr*>(e)->Id();
+
+		if ( id->AsType() )
+			return -1;
+
+		int r = NewReg();
+
+		if ( id->IsGlobal() )
+			{
+			Emit(OP_LOADG, r, cf->globals.size());
+			cf->globals.push_back(id);
+			return r;
+			}
+
+		int l = LocalOf(e);
+
+		if ( l < 0 )
+			return -1;
+
+		// We copy locals to make sure that the value doesn't
+		// change underneath us if the expression assigns to
+		// the local later.
+		Emit(OP_CHKSET, 0, l);
+		Emit(OP_MOV, r, l);
+		return r;
+		}
+
+	case EXPR_ADD:
+	case EXPR_SUB:
+	case EXPR_TIMES:
+	case EXPR_DIVIDE:
+	case EXPR_MOD:
+	case EXPR_AND:
+	case EXPR_OR:
+	case EXPR_XOR:
+	case EXPR_LT:
+	case EXPR_LE:
+	case EXPR_EQ:
+	case EXPR_NE:
+	case EXPR_GE:
+	case EXPR_GT:
+		return CompileBinary(static_cast<const BinaryExpr*>(e));
+
+	case EXPR_AND_AND:
+	case EXPR_OR_OR:
+		return CompileBool(static_cast<const BinaryExpr*>(e));
+
+	case EXPR_NEGATE:
+	case EXPR_POSITIVE:
+	case EXPR_NOT:
+	case EXPR_COMPLEMENT:
+	case EXPR_ARITH_COERCE:
+		return CompileUnary(static_cast<const UnaryExpr*>(e));
+
+	case EXPR_ASSIGN:
+		{
+		const BinaryExpr* a = static_cast<const BinaryExpr*>(e);
+		int l = LocalOf(a->Op1());
+
+		if ( l < 0 || a->Op2()->Type()->InternalType() !=
+				a->Op1()->Type()->InternalType() )
+			return -1;
+
+		int r = CompileExpr(a->Op2());
+
+		if ( r < 0 )
+			return -1;
+
+		Emit(OP_MOV, l, r);
+		Emit(OP_SETDEF, 0, l);
+		return r;
+		}
+
+	case EXPR_ADD_TO:
+	case EXPR_REMOVE_FROM:
+		return CompileUpdate(static_cast<const BinaryExpr*>(e));
+
+	case EXPR_INCR:
+	case EXPR_DECR:
+		{
+		const UnaryExpr* u = static_cast<const UnaryExpr*>(e);
+		int l = LocalOf(u->Op());
+
+		if ( l < 0 )
+			return -1;
+
+		InternalTypeTag it = u->Op()->Type()->InternalType();
+
+		if ( it == TYPE_INTERNAL_DOUBLE ||
+		     it != e->Type()->InternalType() )
+			return -1;
+
+		bool incr = (e->Tag() == EXPR_INCR);
+		int op;
+
+		if ( it == TYPE_INTERNAL_INT )
+			op = incr ? OP_INC_I : OP_DEC_I;
+		else
+			op = incr ? OP_INC_U : OP_DEC_U;
+
+		Emit(OP_CHKSET, 0, l);
+		Emit(op, 0, l);
+
+		int r = NewReg();
+		Emit(OP_MOV, r, l);
+		return r;
+		}
+
+	case EXPR_COND:
+		return CompileCond(static_cast<const CondExpr*>(e));
+
+	default:
+		return -1;
+	}
+	}
+
+int FuncCompiler::CompileBinary(const BinaryExpr* e)
+	{
+	const Expr* op1 = e->Op1();
+	const Expr* op2 = e->Op2();
+
+	if ( ! is_vm_type(op1->Type()) || ! is_vm_type(op2->Type()) )
+		return -1;
+
+	InternalTypeTag it = op1->Type()->InternalType();
+
+	if ( op2->Type()->InternalType() != it )
+		return -1;
+
+	int k = (it == TYPE_INTERNAL_INT ? 0 :
+		 (it == TYPE_INTERNAL_UNSIGNED ? 1 : 2));
+
+	// Comparisons yield bools. Arithmetic must come out in the same
+	// kind of register as the operands, as the interpreter's folding
+	// assumes that too.
+	bool is_cmp = false;
+	bool swap = false;
+	int op;
+
+	switch ( e->Tag() ) {
+	case EXPR_ADD:		op = OP_ADD_I + k; break;
+	case EXPR_SUB:		op = OP_SUB_I + k; break;
+	case EXPR_TIMES:	op = OP_MUL_I + k; break;
+	case EXPR_DIVIDE:	op = OP_DIV_I + k; break;
+
+	case EXPR_MOD:
+		if ( k == 2 )
+			return -1;
+
+		op = OP_MOD_I + k;
+		break;
+
+	case EXPR_AND:
+	case EXPR_OR:
+	case EXPR_XOR:
+		if ( k != 1 )
+			return -1;
+
+		op = (e->Tag() == EXPR_AND ? OP_BAND_U :
+		      (e->Tag() == EXPR_OR ? OP_BOR_U : OP_BXOR_U));
+		break;
+
+	case EXPR_LT:	op = OP_LT_I + k; is_cmp = true; break;
+	case EXPR_LE:	op = OP_LE_I + k; is_cmp = true; break;
+	case EXPR_EQ:	op = OP_EQ_I + k; is_cmp = true; break;
+	case EXPR_NE:	op = OP_NE_I + k; is_cmp = true; break;
+	case EXPR_GT:	op = OP_LT_I + k; is_cmp = swap = true; break;
+	case EXPR_GE:	op = OP_LE_I + k; is_cmp = swap = true; break;
+
+	default:
+		return -1;
+	}
+
+	if ( is_cmp ? e->Type()->Tag() != TYPE_BOOL :
+		      e->Type()->InternalType() != it )
+		return -1;
+
+	int a = CompileExpr(op1);
+
+	if ( a < 0 )
+		return -1;
+
+	int b = CompileExpr(op2);
+
+	if ( b < 0 )
+		return -1;
+
+	int r = NewReg();
+
+	if ( swap )
+		Emit(op, r, b, a);
+	else
+		Emit(op, r, a, b);
+
+	return r;
+	}
+
+int FuncCompiler::CompileBool(const BinaryExpr* e)
+	{
+	if ( e->Op1()->Type()->Tag() != TYPE_BOOL ||
+	     e->Op2()->Type()->Tag() != TYPE_BOOL )
+		return -1;
+
+	int r = NewReg();
+	int a = CompileExpr(e->Op1());
+
+	if ( a < 0 )
+		return -1;
+
+	Emit(OP_MOV, r, a);
+
+	// Short-circuit like the interpreter does.
+	int skip = Emit(e->Tag() == EXPR_AND_AND ? OP_JMPF : OP_JMPT, 0, a);
+
+	int b = CompileExpr(e->Op2());
+
+	if ( b < 0 )
+		return -1;
+
+	Emit(OP_MOV, r, b);
+	PatchJump(skip, Here());
+	return r;
+	}
+
+int FuncCompiler::CompileUnary(const UnaryExpr* e)
+	{
+	const Expr* op = e->Op();
+
+	if ( ! is_vm_type(op->Type()) )
+		return -1;
+
+	InternalTypeTag from = op->Type()->InternalType();
+	InternalTypeTag to = e->Type()->InternalType();
+
+	int a = -1;
+	int r = -1;
+
+	switch ( e->Tag() ) {
+	case EXPR_NOT:
+		if ( op->Type()->Tag() != TYPE_BOOL )
+			return -1;
+
+		if ( (a = CompileExpr(op)) < 0 )
+			return -1;
+
+		Emit(OP_NOT, r = NewReg(), a);
+		return r;
+
+	case EXPR_COMPLEMENT:
+		if ( from != TYPE_INTERNAL_UNSIGNED )
+			return -1;
+
+		if ( (a = CompileExpr(op)) < 0 )
+			return -1;
+
+		Emit(OP_CPL_U, r = NewReg(), a);
+		return r;
+
+	case EXPR_NEGATE:
+	case EXPR_POSITIVE:
+		{
+		// Integral operands get promoted to int.
+		if ( (from == TYPE_INTERNAL_DOUBLE) != (to == TYPE_INTERNAL_DOUBLE) )
+			return -1;
+
+		if ( (a = CompileExpr(op)) < 0 )
+			return -1;
+
+		if ( from == TYPE_INTERNAL_UNSIGNED )
+			{
+			int i = NewReg();
+			Emit(OP_U2I, i, a);
+			a = i;
+			}
+
+		r = NewReg();
+
+		if ( e->Tag() == EXPR_POSITIVE )
+			Emit(OP_MOV, r, a);
+		else
+			Emit(to == TYPE_INTERNAL_DOUBLE ? OP_NEG_D : OP_NEG_I, r, a);
+
+		return r;
+		}
+
+	case EXPR_ARITH_COERCE:
+		{
+		if ( (a = CompileExpr(op)) < 0 )
+			return -1;
+
+		if ( from == to )
+			return a;
+
+		int cop;
+
+		if ( from == TYPE_INTERNAL_INT )
+			cop = (to == TYPE_INTERNAL_UNSIGNED ? OP_I2U : OP_I2D);
+		else if ( from == TYPE_INTERNAL_UNSIGNED )
+			cop = (to == TYPE_INTERNAL_INT ? OP_U2I : OP_U2D);
+		else
+			cop = (to == TYPE_INTERNAL_INT ? OP_D2I : OP_D2U);
+
+		Emit(cop, r = NewReg(), a);
+		return r;
+		}
+
+	default:
+		return -1;
+	}
+	}
+
+int FuncCompiler::CompileUpdate(const BinaryExpr* e)
+	{
+	int l = LocalOf(e->Op1());
+
+	if ( l < 0 || ! is_vm_type(e->Op2()->Type()) )
+		return -1;
+
+	InternalTypeTag it = e->Op1()->Type()->InternalType();
+
+	if ( e->Op2()->Type()->InternalType() != it ||
+	     e->Type()->InternalType() != it )
+		return -1;
+
+	int k = (it == TYPE_INTERNAL_INT ? 0 :
+		 (it == TYPE_INTERNAL_UNSIGNED ? 1 : 2));
+
+	int op = (e->Tag() == EXPR_ADD_TO ? OP_ADD_I : OP_SUB_I) + k;
+
+	// The interpreter evaluates the local before the operand.
+	int a = NewReg();
+	Emit(OP_CHKSET, 0, l);
+	Emit(OP_MOV, a, l);
+
+	int b = CompileExpr(e->Op2());
+
+	if ( b < 0 )
+		return -1;
+
+	Emit(op, l, a, b);
+
+	int r = NewReg();
+	Emit(OP_MOV, r, l);
+	return r;
+	}
+
+int FuncCompiler::CompileCond(const CondExpr* e)
+	{
+	if ( e->Op1()->Type()->Tag() != TYPE_BOOL ||
+	     ! is_vm_type(e->Op2()->Type()) || ! is_vm_type(e->Op3()->Type()) )
+		return -1;
+
+	InternalTypeTag it = e->Type()->InternalType();
+
+	if ( e->Op2()->Type()->InternalType() != it ||
+	     e->Op3()->Type()->InternalType() != it )
+		return -1;
+
+	int r = NewReg();
+	int c = CompileExpr(e->Op1());
+
+	if ( c < 0 )
+		return -1;
+
+	int to_else = Emit(OP_JMPF, 0, c);
+	int a = CompileExpr(e->Op2());
+
+	if ( a < 0 )
+		return -1;
+
+	Emit(OP_MOV, r, a);
+	int to_end = Emit(OP_JMP);
+	PatchJump(to_else, Here());
+
+	int b = CompileExpr(e->Op3());
+
+	if ( b < 0 )
+		return -1;
+
+	Emit(OP_MOV, r, b);
+	PatchJump(to_end, Here());
+	return r;
+	}
+
+CompiledFunc* CompiledFunc::Compile(const BroFunc* func, const Stmt* body,
+					int frame_size)
+	{
+	const FuncType* ft = func->FType();
+	const RecordType* params = ft->Args();
+
+	CompiledFunc* cf = new CompiledFunc();
+	cf->num_params = params->NumFields();
+
+	if ( cf->num_params > frame_size )
+		{
+		delete cf;
+		return 0;
+		}
+
+	for ( int i = 0; i < cf->num_params; ++i )
+		{
+		BroType* t = params->FieldType(i);
+
+		if ( ! is_vm_type(t) )
+			{
+			delete cf;
+			return 0;
+			}
+
+		cf->param_types.push_back(t);
+		}
+
+	const BroType* yt = ft->YieldType();
+
+	if ( yt && yt->Tag() != TYPE_VOID )
+		{
+		if ( ! is_vm_type(yt) )
+			{
+			delete cf;
+			return 0;
+			}
+
+		cf->ret_type = yt;
+		}
+
+	FuncCompiler c(cf, frame_size);
+
+	if ( ! c.CompileStmt(body) )
+		{
+		delete cf;
+		return 0;
+		}
+
+	c.Emit(OP_END);
+
+	cf->regs.resize(c.NumRegs());
+	cf->defined.resize(frame_size);
+
+	return cf;
+	}
+
+bool CompiledFunc::Run(const val_list* args, Val** result, bool* returned) const
+	{
+	if ( args->length() != num_params )
+		return false;
+
+	Slot* r = regs.data();
+	char* def = defined.data();
+
+	std::fill(defined.begin(), defined.end(), 0);
+
+	for ( int i = 0; i < num_params; ++i )
+		{
+		r[i] = val_to_slot((*args)[i]);
+		def[i] = 1;
+		}
+
+	for ( int pc = 0; ; ++pc )
+		{
+		const Instr& in = code[pc];
+
+		switch ( in.op ) {
+		case OP_LOADK:	r[in.dst] = in.k; break;
+
+		case OP_LOADG:
+			{
+			const Val* v = globals[in.a]->ID_Val();
+
+			if ( ! v )
+				return false;
+
+			r[in.dst] = val_to_slot(v);
+			break;
+			}
+
+		case OP_MOV:	r[in.dst] = r[in.a]; break;
+
+		case OP_CHKSET:
+			if ( ! def[in.a] )
+				return false;
+			break;
+
+		case OP_SETDEF:	def[in.a] = 1; break;
+		case OP_UNSET:	def[in.a] = 0; break;
+
+#define ARITH(name, field, op) \
+		case name: r[in.dst].field = r[in.a].field op r[in.b].field; break;
+
+		ARITH(OP_ADD_I, i, +)
+		ARITH(OP_ADD_U, u, +)
+		ARITH(OP_ADD_D, d, +)
+		ARITH(OP_SUB_I, i, -)
+		ARITH(OP_SUB_U, u, -)
+		ARITH(OP_SUB_D, d, -)
+		ARITH(OP_MUL_I, i, *)
+		ARITH(OP_MUL_U, u, *)
+		ARITH(OP_MUL_D, d, *)
+		ARITH(OP_BAND_U, u, &)
+		ARITH(OP_BOR_U, u, |)
+		ARITH(OP_BXOR_U, u, ^)
+
+#define CHECKED_ARITH(name, field, op) \
+		case name: \
+			if ( r[in.b].field == 0 ) \
+				return false; \
+			r[in.dst].field = r[in.a].field op r[in.b].field; \
+			break;
+
+		CHECKED_ARITH(OP_DIV_I, i, /)
+		CHECKED_ARITH(OP_DIV_U, u, /)
+		CHECKED_ARITH(OP_DIV_D, d, /)
+		CHECKED_ARITH(OP_MOD_I, i, %)
+		CHECKED_ARITH(OP_MOD_U, u, %)
+
+#define CMP(name, field, op) \
+		case name: r[in.dst].i = (r[in.a].field op r[in.b].field); break;
+
+		CMP(OP_LT_I, i, <)
+		CMP(OP_LT_U, u, <)
+		CMP(OP_LT_D, d, <)
+		CMP(OP_LE_I, i, <=)
+		CMP(OP_LE_U, u, <=)
+		CMP(OP_LE_D, d, <=)
+		CMP(OP_EQ_I, i, ==)
+		CMP(OP_EQ_U, u, ==)
+		CMP(OP_EQ_D, d, ==)
+		CMP(OP_NE_I, i, !=)
+		CMP(OP_NE_U, u, !=)
+		CMP(OP_NE_D, d, !=)
+
+		case OP_NEG_I:	r[in.dst].i = - r[in.a].i; break;
+		case OP_NEG_D:	r[in.dst].d = - r[in.a].d; break;
+		case OP_NOT:	r[in.dst].i = ! r[in.a].i; break;
+		case OP_CPL_U:	r[in.dst].u = ~ r[in.a].u; break;
+
+		case OP_I2U:	r[in.dst].u = bro_uint_t(r[in.a].i); break;
+		case OP_I2D:	r[in.dst].d = double(r[in.a].i); break;
+		case OP_U2I:	r[in.dst].i = bro_int_t(r[in.a].u); break;
+		case OP_U2D:	r[in.dst].d = double(r[in.a].u); break;
+		case OP_D2I:	r[in.dst].i = bro_int_t(r[in.a].d); break;
+		case OP_D2U:	r[in.dst].u = bro_uint_t(r[in.a].d); break;
+
+		case OP_INC_I:	++r[in.a].i; break;
+		case OP_INC_U:	++r[in.a].u; break;
+		case OP_DEC_I:	--r[in.a].i; break;
+
+		case OP_DEC_U:
+			// The interpreter reports an underflow for anything
+			// that doesn't stay non-negative as an int.
+			if ( bro_int_t(r[in.a].u) <= 0 )
+				return false;
+
+			--r[in.a].u;
+			break;
+
+		case OP_JMP:
+			pc = in.dst - 1;
+			break;
+
+		case OP_JMPF:
+			if ( r[in.a].i == 0 )
+				pc = in.dst - 1;
+			break;
+
+		case OP_JMPT:
+			if ( r[in.a].i != 0 )
+				pc = in.dst - 1;
+			break;
+
+		case OP_RET:
+			*result = slot_to_val(r[in.a], ret_type);
+			*returned = true;
+			return true;
+
+		case OP_RETV:
+			*result = 0;
+			*returned = true;
+			return true;
+
+		case OP_END:
+			*result = 0;
+			*returned = false;
+			return true;
+
+		default:
+			reporter->InternalError("bad VM instruction %d", in.op);
+		}
+		}
+	}
@@ -0,0 +1,78 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef scriptvm_h
+#define scriptvm_h
+
+#include <vector>
+
+#include "BroList.h"
+#include "util.h"
+
+class BroFunc;
+class BroType;
+class Stmt;
+class Val;
+class ID;
+
+// A register-based bytecode for script functions that only deal in scalar
+// values (bool, int, count, double, time, interval). Registers hold the
+// values unboxed, so executing such a function allocates no Vals besides
+// its result.
+//
+// The VM knows only a subset of the language: arithmetic, comparisons and
+// assignments on locals, reading globals, and if/while/return. Functions
+// using anything else, such as calls or aggregate types, keep running in
+// the AST interpreter. As compiled code can have no side effects outside
+// its own registers, it simply gives up whenever the interpreter would
+// report a run-time error (e.g., division by zero); the caller then
+// executes the function through the interpreter, which reports the error
+// as usual.
+class CompiledFunc {
+public:
+	// Compiles the given body of a function. Returns nil if it uses
+	// anything the VM doesn't support.
+	static CompiledFunc* Compile(const BroFunc* func, const Stmt* body,
+					int frame_size);
+
+	// Runs the function on the given arguments, not taking ownership of
+	// them. Returns false if the function has to be run through the
+	// interpreter instead. Otherwise sets *result to the return value
+	// (nil if none) and *returned to whether a return statement was
+	// executed.
+	bool Run(const val_list* args, Val** result, bool* returned) const;
+
+	// Number of instructions, for debugging.
+	int CodeSize() const	{ return code.size(); }
+
+	union Slot {
+		bro_int_t i;
+		bro_uint_t u;
+		double d;
+	};
+
+	struct Instr {
+		int op;
+		int dst;
+		int a;
+		int b;
+		Slot k;
+	};
+
+private:
+	friend class FuncCompiler;
+
+	CompiledFunc()	{ num_params = 0; ret_type = 0; }
+
+	std::vector<Instr> code;
+	std::vector<ID*> globals;
+	std::vector<BroType*> param_types;
+	int num_params;
+	const BroType* ret_type;
+
+	// Scratch space for running. Compiled code never calls out, so a
+	// function can't be running more than once at the same time.
+	mutable std::vector<Slot> regs;
+	mutable std::vector<char> defined;
+};
+
+#endif
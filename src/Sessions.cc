@@ -6,17 +6,25 @@
 #include <arpa/inet.h>
 
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "Net.h"
 #include "Event.h"
 #include "Timer.h"
 #include "NetVar.h"
 #include "Sessions.h"
 #include "Reporter.h"
+#include "Stats.h"
+#include "LoadShedder.h"
 
 #include "analyzer/protocol/icmp/ICMP.h"
+#include "analyzer/protocol/tcp/TCP_Reassembler.h"
 #include "analyzer/protocol/udp/UDP.h"
+#include "analyzer/protocol/conn-size/ConnSize.h"
 
 #include "analyzer/protocol/stepping-stone/SteppingStone.h"
 #include "analyzer/protocol/stepping-stone/events.bif.h"
@@ -28,6 +36,7 @@
 #include "TunnelEncapsulation.h"
 
 #include "analyzer/Manager.h"
+#include "ObjPool.h"
 
 // These represent NetBIOS services on ephemeral ports.  They're numbered
 // so that we can use a single int to hold either an actual TCP/UDP server
@@ -37,6 +46,13 @@ enum NetBIOS_Service {
 	NETBIOS_SERVICE_DCE_RPC,
 };
 
+// Number of packets after which we check the connection state budget even
+// if no new connection has come along. Must be a power of two.
+static const uint64 STATE_BUDGET_CHECK_INTERVAL = 1024;
+
+// Maximum number of connections to evict at a time for the state budget.
+static const int MAX_STATE_BUDGET_EVICTIONS = 1000;
+
 NetSessions* sessions;
 
 void TimerMgrExpireTimer::Dispatch(double t, int is_expire)
@@ -85,21 +101,20 @@ void IPTunnelTimer::Dispatch(double t, int is_expire)
 		timer_mgr->Add(new IPTunnelTimer(t, tunnel_idx));
 	}
 
-NetSessions::NetSessions()
+void ConnExpiryTimer::Dispatch(double t, int is_expire)
 	{
-	TypeList* t = new TypeList();
-	t->Append(base_type(TYPE_ADDR));	// source IP address
-	t->Append(base_type(TYPE_ADDR));	// dest IP address
-	t->Append(base_type(TYPE_COUNT));	// source and dest ports
-
-	ch = new CompositeHash(t);
+	// Like inactivity timers, the wheel isn't swept at termination.
+	if ( is_expire )
+		return;
 
-	Unref(t);
+	s->ExpireConnections(t);
+	}
 
-	tcp_conns.SetDeleteFunc(bro_obj_delete_func);
-	udp_conns.SetDeleteFunc(bro_obj_delete_func);
-	icmp_conns.SetDeleteFunc(bro_obj_delete_func);
+NetSessions::NetSessions()
+	{
 	fragments.SetDeleteFunc(bro_obj_delete_func);
+	frag_expire_head = frag_expire_tail = 0;
+	frag_sweep_timer = 0;
 
 	if ( stp_correlate_pair )
 		stp_manager = new analyzer::stepping_stone::SteppingStoneManager();
@@ -118,6 +133,20 @@ NetSessions::NetSessions()
 	dump_this_packet = 0;
 	num_packets_processed = 0;
 
+	if ( BifConst::icmp_aggregation )
+		icmp_aggregator = new ICMPAggregator();
+	else
+		icmp_aggregator = 0;
+
+	for ( unsigned int i = 0; i < NUM_TUNNEL_TYPES; ++i )
+		tunnel_stats[i].packets = tunnel_stats[i].bytes = 0;
+
+	expiry_tick = 0;
+	num_expiry_scheduled = 0;
+	expiry_timer = 0;
+
+	lru_head = lru_tail = 0;
+
 	if ( pkt_profile_mode && pkt_profile_freq > 0 && pkt_profile_file )
 		pkt_profiler = new PacketProfiler(pkt_profile_mode,
 				pkt_profile_freq, pkt_profile_file->AsFile());
@@ -128,26 +157,41 @@ NetSessions::NetSessions()
 		arp_analyzer = new analyzer::arp::ARP_Analyzer();
 	else
 		arp_analyzer = 0;
+
+	if ( BifConst::conn_restore_file->Len() )
+		ConnCheckpoint::Read(BifConst::conn_restore_file->CheckString(),
+				     &pending_restore);
 	}
 
 NetSessions::~NetSessions()
 	{
-	delete ch;
 	delete packet_filter;
 	delete pkt_profiler;
 	Unref(arp_analyzer);
 	delete discarder;
 	delete stp_manager;
+	delete icmp_aggregator;
 	}
 
 void NetSessions::Done()
 	{
 	}
 
+Discarder* NetSessions::GetDiscarder()
+	{
+	if ( ! discarder )
+		discarder = new Discarder();
+
+	return discarder;
+	}
+
 void NetSessions::NextPacket(double t, const Packet* pkt)
 	{
 	SegmentProfiler(segment_logger, "dispatching-packet");
 
+	if ( ! pending_restore.empty() )
+		RestoreConnections();
+
 	if ( raw_packet )
 		mgr.QueueEventFast(raw_packet, {pkt->BuildPktHdrVal()});
 
@@ -211,6 +255,115 @@ void NetSessions::NextPacket(double t, const Packet* pkt)
 		DumpPacket(pkt);
 	}
 
+// How many packets ahead of the one about to be processed PrefetchConns()
+// loads the connection table slots, and the connections themselves. The
+// gaps need to cover a memory access each.
+static const size_t PREFETCH_SLOT_DISTANCE = 8;
+static const size_t PREFETCH_CONN_DISTANCE = 4;
+
+void NetSessions::PrefetchConns(const Packet* batch, size_t count, size_t pos)
+	{
+	if ( conn_prefetches.size() < count )
+		conn_prefetches.resize(count);
+
+	// At the start of a batch, fill the pipeline: each later call then
+	// advances both stages by one packet.
+	size_t slot_begin = pos ? pos + PREFETCH_SLOT_DISTANCE : 0;
+	size_t slot_end = std::min(count, pos + PREFETCH_SLOT_DISTANCE + 1);
+
+	for ( size_t i = slot_begin; i < slot_end; ++i )
+		{
+		ConnPrefetch& p = conn_prefetches[i];
+		p.table = PacketConnKey(&batch[i], &p.key);
+
+		if ( p.table )
+			{
+			p.hash = ConnTable::Hash(p.key);
+			p.table->PrefetchSlot(p.hash);
+			}
+		}
+
+	size_t conn_begin = pos ? pos + PREFETCH_CONN_DISTANCE : 0;
+	size_t conn_end = std::min(count, pos + PREFETCH_CONN_DISTANCE + 1);
+
+	for ( size_t i = conn_begin; i < conn_end; ++i )
+		{
+		const ConnPrefetch& p = conn_prefetches[i];
+
+		if ( p.table )
+			p.table->PrefetchConn(p.key, p.hash);
+		}
+	}
+
+ConnTable* NetSessions::PacketConnKey(const Packet* pkt, ConnIDKey* key)
+	{
+	if ( ! pkt->Layer2Valid() || pkt->hdr_size > pkt->cap_len )
+		return 0;
+
+	const u_char* l3 = pkt->data + pkt->hdr_size;
+	uint32 caplen = pkt->cap_len - pkt->hdr_size;
+	const u_char* l4;
+	int proto;
+	ConnID id;
+
+	if ( pkt->l3_proto == L3_IPV4 )
+		{
+		if ( caplen < sizeof(struct ip) )
+			return 0;
+
+		const struct ip* ip = (const struct ip*) l3;
+		uint32 ip_hdr_len = ip->ip_hl * 4;
+
+		if ( (ntohs(ip->ip_off) & 0x3fff) || caplen < ip_hdr_len + 4 )
+			return 0;
+
+		id.src_addr = IPAddr(ip->ip_src);
+		id.dst_addr = IPAddr(ip->ip_dst);
+		proto = ip->ip_p;
+		l4 = l3 + ip_hdr_len;
+		}
+
+	else if ( pkt->l3_proto == L3_IPV6 )
+		{
+		if ( caplen < sizeof(struct ip6_hdr) + 4 )
+			return 0;
+
+		const struct ip6_hdr* ip6 = (const struct ip6_hdr*) l3;
+		id.src_addr = IPAddr(ip6->ip6_src);
+		id.dst_addr = IPAddr(ip6->ip6_dst);
+		proto = ip6->ip6_nxt;
+		l4 = l3 + sizeof(struct ip6_hdr);
+		}
+
+	else
+		return 0;
+
+	ConnTable* d;
+
+	switch ( proto ) {
+	case IPPROTO_TCP:
+		d = &tcp_conns;
+		break;
+
+	case IPPROTO_UDP:
+		d = &udp_conns;
+		break;
+
+	default:
+		return 0;
+	}
+
+	// Both TCP and UDP start out with the ports, in network order.
+	uint16 ports[2];
+	memcpy(ports, l4, sizeof(ports));
+	id.src_port = ports[0];
+	id.dst_port = ports[1];
+	id.is_one_way = false;
+
+	BuildConnIDKey(id, key);
+	return d;
+	}
+
 int NetSessions::CheckConnectionTag(Connection* conn)
 	{
 	if ( current_iosrc->GetCurrentTag() )
@@ -292,6 +445,8 @@ static unsigned int gre_header_len(uint16 flags)
 void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr,
 			       const EncapsulationStack* encapsulation)
 	{
+	PipelineStats::Timer timer(&pipeline_stats, PipelineStats::SESSIONS);
+
 	uint32 caplen = pkt->cap_len - pkt->hdr_size;
 	const struct ip* ip4 = ip_hdr->IP4_Hdr();
 
@@ -359,6 +514,11 @@ void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr
 		else
 			{
 			f = NextFragment(t, ip_hdr, pkt->data + pkt->hdr_size);
+
+			if ( ! f )
+				// Dropped.
+				return;
+
 			const IP_Hdr* ih = f->ReassembledPkt();
 			if ( ! ih )
 				// It didn't reassemble into anything yet.
@@ -409,7 +569,8 @@ void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr
 			}
 
 		if ( mobile_ipv6_message )
-			mgr.QueueEvent(mobile_ipv6_message, {ip_hdr->BuildPktHdrVal()});
+			mgr.Enqueue(mobile_ipv6_message,
+			            IntrusivePtr<RecordVal>{AdoptRef{}, ip_hdr->BuildPktHdrVal()});
 
 		if ( ip_hdr->NextProto() != IPPROTO_NONE )
 			Weird("mobility_piggyback", pkt, encapsulation);
@@ -427,7 +588,7 @@ void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr
 	ConnID id;
 	id.src_addr = ip_hdr->SrcAddr();
 	id.dst_addr = ip_hdr->DstAddr();
-	Dictionary* d = 0;
+	ConnTable* d = 0;
 	BifEnum::Tunnel::Type tunnel_type = BifEnum::Tunnel::IP;
 
 	switch ( proto ) {
@@ -718,30 +879,52 @@ void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr
 		return;
 	}
 
-	HashKey* h = BuildConnIDHashKey(id);
-	if ( ! h )
-		reporter->InternalError("hash computation failed");
+	ConnIDKey key;
+	BuildConnIDKey(id, &key);
+	hash_t hash = ConnTable::Hash(key);
 
 	Connection* conn = 0;
 
 	// FIXME: The following is getting pretty complex. Need to split up
 	// into separate functions.
-	conn = (Connection*) d->Lookup(h);
+	conn = d->Lookup(key, hash);
+
+	if ( ! conn && d == &icmp_conns && icmp_aggregator && ! encapsulation &&
+	     ICMPAggregator::CanAggregate(proto == IPPROTO_ICMPV6,
+					  ntohs(id.src_port)) )
+		{
+		const struct icmp* icmpp = (const struct icmp*) data;
+
+		if ( caplen >= len && net_verify_checksums() )
+			{
+			int chksum = proto == IPPROTO_ICMPV6 ?
+				icmp6_checksum(icmpp, ip_hdr, len) :
+				icmp_checksum(icmpp, len);
+
+			if ( chksum != 0xffff )
+				{
+				Weird("bad_ICMP_checksum", ip_hdr, encapsulation);
+				return;
+				}
+			}
+
+		icmp_aggregator->NextPacket(t, id, key, ip_hdr, len);
+		dump_this_packet = 1;
+		return;
+		}
+
 	if ( ! conn )
 		{
-		conn = NewConn(h, t, &id, data, proto, ip_hdr->FlowLabel(), pkt, encapsulation);
+		conn = NewConn(key, hash, t, &id, data, proto, ip_hdr->FlowLabel(), pkt, encapsulation);
 		if ( conn )
-			d->Insert(h, conn);
+			d->Insert(key, conn);
 		}
 	else
 		{
 		// We already know that connection.
 		int consistent = CheckConnectionTag(conn);
 		if ( consistent < 0 )
-			{
-			delete h;
 			return;
-			}
 
 		if ( ! consistent || conn->IsReuse(t, data) )
 			{
@@ -749,22 +932,28 @@ void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr
 				conn->Event(connection_reused, 0);
 
 			Remove(conn);
-			conn = NewConn(h, t, &id, data, proto, ip_hdr->FlowLabel(), pkt, encapsulation);
+			conn = NewConn(key, hash, t, &id, data, proto, ip_hdr->FlowLabel(), pkt, encapsulation);
 			if ( conn )
-				d->Insert(h, conn);
+				d->Insert(key, conn);
 			}
 		else
-			{
-			delete h;
 			conn->CheckEncapsulation(encapsulation);
-			}
 		}
 
 	if ( ! conn )
-		{
-		delete h;
 		return;
-		}
+
+	// New connections aren't on the activity list yet.
+	bool new_conn = (! conn->lru_prev && lru_head != conn);
+
+	TouchConnection(conn);
+
+	// Check the state budget when the state grows with a new
+	// connection, and once in a while for the reassembly buffers of
+	// existing ones.
+	if ( BifConst::conn_state_budget &&
+	     (new_conn || (num_packets_processed & (STATE_BUDGET_CHECK_INTERVAL - 1)) == 0) )
+		EnforceStateBudget(conn);
 
 	int record_packet = 1;	// whether to record the packet at all
 	int record_content = 1;	// whether to record its data
@@ -841,18 +1030,26 @@ void NetSessions::DoNextInnerPacket(double t, const Packet* pkt,
 		l3_proto = L3_IPV6;
 		}
 
-	EncapsulationStack* outer = prev ?
-			new EncapsulationStack(*prev) : new EncapsulationStack();
-	outer->Add(ec);
+	// The new stack shares the layers of the previous one, and the fake
+	// packet refers to the inner header in place, so nothing of the
+	// outer packet gets copied.
+	EncapsulationStack outer(prev, ec);
+
+	unsigned int type = ec.Type();
+
+	if ( type < NUM_TUNNEL_TYPES )
+		{
+		++tunnel_stats[type].packets;
+		tunnel_stats[type].bytes += len;
+		}
 
 	// Construct fake packet for DoNextPacket
 	Packet p;
 	p.Init(DLT_RAW, &ts, caplen, len, data, false, "");
 
-	DoNextPacket(t, &p, inner, outer);
+	DoNextPacket(t, &p, inner, &outer);
 
 	delete inner;
-	delete outer;
 	}
 
 int NetSessions::ParseIPPacket(int caplen, const u_char* const pkt, int proto,
@@ -938,31 +1135,41 @@ bool NetSessions::CheckHeaderTrunc(int proto, uint32 len, uint32 caplen,
 	return false;
 	}
 
+// Identifies the fragments belonging to one datagram.
+struct FragKey {
+	in6_addr src;
+	in6_addr dst;
+	uint32 id;
+};
+
 FragReassembler* NetSessions::NextFragment(double t, const IP_Hdr* ip,
 					const u_char* pkt)
 	{
-	uint32 frag_id = ip->ID();
-
-	ListVal* key = new ListVal(TYPE_ANY);
-	key->Append(new AddrVal(ip->SrcAddr()));
-	key->Append(new AddrVal(ip->DstAddr()));
-	key->Append(val_mgr->GetCount(frag_id));
+	FragKey k;
+	memset(&k, 0, sizeof(k));
+	ip->SrcAddr().CopyIPv6(&k.src);
+	ip->DstAddr().CopyIPv6(&k.dst);
+	k.id = ip->ID();
 
-	HashKey* h = ch->ComputeHash(key, 1);
-	if ( ! h )
-		reporter->InternalError("hash computation failed");
+	HashKey* h = new HashKey(&k, sizeof(k));
 
 	FragReassembler* f = fragments.Lookup(h);
 	if ( ! f )
 		{
+		if ( BifConst::frag_source_quota &&
+		     ! ChargeFragQuota(ip->SrcAddr(), padded_sizeof(FragReassembler)) )
+			{
+			Weird("fragment_source_quota_exceeded", ip);
+			delete h;
+			return 0;
+			}
+
 		f = new FragReassembler(this, ip, pkt, h, t);
 		fragments.Insert(h, f);
-		Unref(key);
 		return f;
 		}
 
 	delete h;
-	Unref(key);
 
 	f->AddFragment(t, ip, pkt);
 	return f;
@@ -1019,11 +1226,7 @@ Connection* NetSessions::FindConnection(Val* v)
 
 	id.is_one_way = 0;	// ### incorrect for ICMP connections
 
-	HashKey* h = BuildConnIDHashKey(id);
-	if ( ! h )
-		reporter->InternalError("hash computation failed");
-
-	Dictionary* d;
+	ConnTable* d;
 
 	if ( orig_portv->IsTCP() )
 		d = &tcp_conns;
@@ -1036,18 +1239,16 @@ Connection* NetSessions::FindConnection(Val* v)
 		// This can happen due to pseudo-connections we
 		// construct, for example for packet headers embedded
 		// in ICMPs.
-		delete h;
 		return 0;
 		}
 
-	Connection* conn = (Connection*) d->Lookup(h);
-
-	delete h;
+	ConnIDKey key;
+	BuildConnIDKey(id, &key);
 
-	return conn;
+	return d->Lookup(key);
 	}
 
-void NetSessions::Remove(Connection* c)
+void NetSessions::Remove(Connection* c, bool notify)
 	{
 	HashKey* k = c->Key();
 	if ( k )
@@ -1066,40 +1267,48 @@ void NetSessions::Remove(Connection* c)
 
 		c->Done();
 
-		if ( connection_state_remove )
+		if ( notify && connection_state_remove )
 			c->Event(connection_state_remove, 0);
 
+		UnlinkConnection(c);
+		UnscheduleExpiry(c);
+
 		// Zero out c's copy of the key, so that if c has been Ref()'d
 		// up, we know on a future call to Remove() that it's no
 		// longer in the dictionary.
 		c->ClearKey();
 
-		switch ( c->ConnTransport() ) {
-		case TRANSPORT_TCP:
-			if ( ! tcp_conns.RemoveEntry(k) )
-				reporter->InternalWarning("connection missing");
-			break;
-
-		case TRANSPORT_UDP:
-			if ( ! udp_conns.RemoveEntry(k) )
-				reporter->InternalWarning("connection missing");
-			break;
+		ConnIDKey key;
+		ConnTable* d = ConnTableFor(c->ConnTransport());
 
-		case TRANSPORT_ICMP:
-			if ( ! icmp_conns.RemoveEntry(k) )
-				reporter->InternalWarning("connection missing");
-			break;
-
-		case TRANSPORT_UNKNOWN:
+		if ( ! d )
 			reporter->InternalWarning("unknown transport when removing connection");
-			break;
-		}
+
+		else if ( ! ConnTable::KeyFromHashKey(k, &key) || d->Remove(key) != c )
+			reporter->InternalWarning("connection missing");
 
 		Unref(c);
 		delete k;
 		}
 	}
 
+ConnTable* NetSessions::ConnTableFor(TransportProto proto)
+	{
+	switch ( proto ) {
+	case TRANSPORT_TCP:
+		return &tcp_conns;
+
+	case TRANSPORT_UDP:
+		return &udp_conns;
+
+	case TRANSPORT_ICMP:
+		return &icmp_conns;
+
+	default:
+		return 0;
+	}
+	}
+
 void NetSessions::Remove(FragReassembler* f)
 	{
 	if ( ! f )
@@ -1118,77 +1327,487 @@ void NetSessions::Remove(FragReassembler* f)
 	Unref(f);
 	}
 
-void NetSessions::Insert(Connection* c)
+void NetSessions::ScheduleFragExpiration(FragReassembler* f)
 	{
-	assert(c->Key());
+	f->prev_expire = frag_expire_tail;
+	f->next_expire = 0;
 
-	Connection* old = 0;
+	if ( frag_expire_tail )
+		frag_expire_tail->next_expire = f;
+	else
+		frag_expire_head = f;
 
-	switch ( c->ConnTransport() ) {
-	// Remove first. Otherwise the dictioanry would still
-	// reference the old key for already existing connections.
+	frag_expire_tail = f;
 
-	case TRANSPORT_TCP:
-		old = (Connection*) tcp_conns.Remove(c->Key());
-		tcp_conns.Insert(c->Key(), c);
-		break;
+	if ( ! frag_sweep_timer )
+		{
+		frag_sweep_timer = new FragSweepTimer(this, f->ExpireTime());
+		timer_mgr->Add(frag_sweep_timer);
+		}
+	}
 
-	case TRANSPORT_UDP:
-		old = (Connection*) udp_conns.Remove(c->Key());
-		udp_conns.Insert(c->Key(), c);
-		break;
+void NetSessions::UnscheduleFragExpiration(FragReassembler* f)
+	{
+	if ( f->prev_expire )
+		f->prev_expire->next_expire = f->next_expire;
+	else
+		frag_expire_head = f->next_expire;
 
-	case TRANSPORT_ICMP:
-		old = (Connection*) icmp_conns.Remove(c->Key());
-		icmp_conns.Insert(c->Key(), c);
-		break;
+	if ( f->next_expire )
+		f->next_expire->prev_expire = f->prev_expire;
+	else
+		frag_expire_tail = f->prev_expire;
 
-	default:
+	f->prev_expire = f->next_expire = 0;
+
+	// We leave a pending sweep timer alone even if nothing's left to
+	// expire; it'll find that out when it fires.
+	}
+
+void NetSessions::ExpireFragments(double t, bool all)
+	{
+	// The timer calling us is done.
+	frag_sweep_timer = 0;
+
+	while ( frag_expire_head && (all || frag_expire_head->ExpireTime() <= t) )
+		// Takes it off the queue.
+		frag_expire_head->Expire(t);
+
+	if ( frag_expire_head )
+		{
+		frag_sweep_timer = new FragSweepTimer(this, frag_expire_head->ExpireTime());
+		timer_mgr->Add(frag_sweep_timer);
+		}
+	}
+
+bool NetSessions::ChargeFragQuota(const IPAddr& src, uint64 n)
+	{
+	uint64& bytes = frag_bytes_by_src[src];
+
+	if ( bytes + n > BifConst::frag_source_quota )
+		{
+		if ( ! bytes )
+			frag_bytes_by_src.erase(src);
+
+		return false;
+		}
+
+	bytes += n;
+	return true;
+	}
+
+void NetSessions::ReleaseFragQuota(const IPAddr& src, uint64 n)
+	{
+	if ( ! n )
+		return;
+
+	std::map<IPAddr, uint64>::iterator i = frag_bytes_by_src.find(src);
+
+	if ( i == frag_bytes_by_src.end() )
+		return;
+
+	if ( i->second > n )
+		i->second -= n;
+	else
+		frag_bytes_by_src.erase(i);
+	}
+
+void NetSessions::Insert(Connection* c)
+	{
+	assert(c->Key());
+
+	ConnTable* d = ConnTableFor(c->ConnTransport());
+	ConnIDKey key;
+
+	if ( ! d || ! ConnTable::KeyFromHashKey(c->Key(), &key) )
+		{
 		reporter->InternalWarning("unknown connection type");
 		Unref(c);
 		return;
-	}
+		}
+
+	Connection* old = d->Insert(key, c);
 
 	if ( old && old != c )
 		{
 		// Some clean-ups similar to those in Remove() (but invisible
 		// to the script layer).
+		UnlinkConnection(old);
+		UnscheduleExpiry(old);
 		old->CancelTimers();
 		delete old->Key();
 		old->ClearKey();
 		Unref(old);
 		}
+
+	TouchConnection(c);
 	}
 
-void NetSessions::Drain()
+void NetSessions::ScheduleExpiry(Connection* c, double t)
+	{
+	double granularity = BifConst::conn_expiry_granularity;
+
+	if ( expiry_wheel.empty() )
+		expiry_wheel.resize(EXPIRY_WHEEL_SLOTS, 0);
+
+	UnscheduleExpiry(c);
+
+	if ( ! num_expiry_scheduled )
+		// Nothing to catch up on.
+		expiry_tick = uint64(network_time / granularity);
+
+	uint64 tick = uint64(t / granularity);
+
+	// Anything already due goes into the slot swept next.
+	if ( tick < expiry_tick )
+		tick = expiry_tick;
+
+	int slot = tick % EXPIRY_WHEEL_SLOTS;
+
+	c->expiry_slot = slot;
+	c->expiry_prev = 0;
+	c->expiry_next = expiry_wheel[slot];
+
+	if ( c->expiry_next )
+		c->expiry_next->expiry_prev = c;
+
+	expiry_wheel[slot] = c;
+	++num_expiry_scheduled;
+
+	if ( ! expiry_timer )
+		{
+		// Fires once the slot of the current tick has fully elapsed.
+		expiry_timer = new ConnExpiryTimer(this, (expiry_tick + 1) * granularity);
+		timer_mgr->Add(expiry_timer);
+		}
+	}
+
+void NetSessions::UnscheduleExpiry(Connection* c)
+	{
+	if ( c->expiry_slot < 0 )
+		return;
+
+	if ( c->expiry_prev )
+		c->expiry_prev->expiry_next = c->expiry_next;
+	else
+		expiry_wheel[c->expiry_slot] = c->expiry_next;
+
+	if ( c->expiry_next )
+		c->expiry_next->expiry_prev = c->expiry_prev;
+
+	c->expiry_slot = -1;
+	c->expiry_prev = c->expiry_next = 0;
+	--num_expiry_scheduled;
+	}
+
+void NetSessions::ExpireConnections(double t)
+	{
+	double granularity = BifConst::conn_expiry_granularity;
+	uint64 now_tick = uint64(t / granularity);
+
+	// After a long gap, a single pass over the wheel covers everything.
+	if ( now_tick - expiry_tick > EXPIRY_WHEEL_SLOTS )
+		expiry_tick = now_tick - EXPIRY_WHEEL_SLOTS;
+
+	while ( expiry_tick < now_tick )
+		{
+		int slot = expiry_tick++ % EXPIRY_WHEEL_SLOTS;
+
+		// Detach the slot's list first, as we may put connections
+		// back into the wheel while walking it.
+		Connection* next = expiry_wheel[slot];
+		expiry_wheel[slot] = 0;
+
+		while ( Connection* c = next )
+			{
+			next = c->expiry_next;
+
+			c->expiry_slot = -1;
+			c->expiry_prev = c->expiry_next = 0;
+			--num_expiry_scheduled;
+
+			// A timeout of zero means the timeout has been
+			// disabled since.
+			double timeout = c->InactivityTimeout();
+
+			if ( ! timeout )
+				continue;
+
+			if ( c->LastTime() + timeout <= t )
+				{
+				c->Event(connection_timeout, 0);
+				Remove(c);
+				++killed_by_inactivity;
+				}
+			else
+				ScheduleExpiry(c, c->LastTime() + timeout);
+			}
+		}
+
+	// The timer calling us is done. We've left it in place until now so
+	// that rescheduling connections above doesn't start another one.
+	expiry_timer = 0;
+
+	if ( num_expiry_scheduled )
+		{
+		expiry_timer = new ConnExpiryTimer(this, (expiry_tick + 1) * granularity);
+		timer_mgr->Add(expiry_timer);
+		}
+	}
+
+void NetSessions::TouchConnection(Connection* c)
+	{
+	if ( lru_tail == c )
+		return;
+
+	if ( c->lru_prev || lru_head == c )
+		UnlinkConnection(c);
+
+	c->lru_prev = lru_tail;
+	c->lru_next = 0;
+
+	if ( lru_tail )
+		lru_tail->lru_next = c;
+	else
+		lru_head = c;
+
+	lru_tail = c;
+	}
+
+void NetSessions::UnlinkConnection(Connection* c)
+	{
+	if ( ! c->lru_prev && lru_head != c )
+		// Not on the list.
+		return;
+
+	if ( c->lru_prev )
+		c->lru_prev->lru_next = c->lru_next;
+	else
+		lru_head = c->lru_next;
+
+	if ( c->lru_next )
+		c->lru_next->lru_prev = c->lru_prev;
+	else
+		lru_tail = c->lru_prev;
+
+	c->lru_prev = c->lru_next = 0;
+	}
+
+uint64 NetSessions::ConnStateMemory() const
+	{
+	// The connection and analyzer pools hold the objects making up the
+	// bulk of each connection's state; to that we add what's buffered
+	// for TCP reassembly. Other pools, such as the one for script
+	// values, don't shrink by evicting connections.
+	uint64 mem = Reassembler::MemoryAllocation(REASSEM_TCP);
+
+	const std::vector<const ObjPool*>& pools = ObjPool::Pools();
+
+	for ( size_t i = 0; i < pools.size(); i++ )
+		{
+		ObjPool::Category cat = pools[i]->GetCategory();
+
+		if ( cat == ObjPool::CONNECTION || cat == ObjPool::ANALYZER )
+			mem += pools[i]->InUse() * pools[i]->ObjSize();
+		}
+
+	return mem;
+	}
+
+// Returns roughly how much memory removing a connection frees up.
+static uint64 conn_state_footprint(Connection* c)
+	{
+	uint64 mem = c->MemoryAllocation();
+
+	if ( c->ConnTransport() == TRANSPORT_TCP )
+		{
+		auto ta = static_cast<analyzer::tcp::TCP_Analyzer*>(c->GetRootAnalyzer());
+
+		if ( ta )
+			{
+			if ( ta->Orig()->contents_processor )
+				mem += ta->Orig()->contents_processor->TotalSize();
+
+			if ( ta->Resp()->contents_processor )
+				mem += ta->Resp()->contents_processor->TotalSize();
+			}
+		}
+
+	return mem;
+	}
+
+void NetSessions::EnforceStateBudget(Connection* keep)
+	{
+	uint64 budget = BifConst::conn_state_budget;
+	uint64 mem = ConnStateMemory();
+
+	if ( mem <= budget )
+		return;
+
+	// Go some way below the budget so that we don't end up here again
+	// with the very next connection.
+	uint64 target = budget - budget / 8;
+	int evicted = 0;
+
+	while ( mem > target && evicted < MAX_STATE_BUDGET_EVICTIONS )
+		{
+		Connection* c = lru_head;
+
+		if ( ! c || c == keep )
+			break;
+
+		uint64 footprint = conn_state_footprint(c);
+
+		// The connection may stay around for a bit longer while events
+		// still reference it, so we can't just look at the pools again.
+		mem = (footprint < mem ? mem - footprint : 0);
+
+		Remove(c);
+		++killed_by_memory_pressure;
+		++evicted;
+		}
+
+	if ( evicted )
+		reporter->Weird("conn_state_budget_exceeded", fmt("%d", evicted));
+	}
+
+bool NetSessions::CheckpointConnections(const char* path)
 	{
-	IterCookie* cookie = tcp_conns.InitForIteration();
-	Connection* tc;
+	std::vector<Connection*> conns;
+	conns.reserve(CurrentConnections());
 
-	while ( (tc = tcp_conns.NextEntry(cookie)) )
+	ConnTable* tables[] = { &tcp_conns, &udp_conns, &icmp_conns };
+
+	for ( auto d : tables )
 		{
-		tc->Done();
-		tc->Event(connection_state_remove, 0);
+		size_t pos = 0;
+
+		while ( Connection* c = d->NextEntry(&pos) )
+			conns.push_back(c);
 		}
 
-	cookie = udp_conns.InitForIteration();
-	Connection* uc;
+	if ( ! ConnCheckpoint::Write(path, conns) )
+		return false;
+
+	for ( auto c : conns )
+		Remove(c, false);
+
+	return true;
+	}
+
+void NetSessions::RestoreConnections()
+	{
+	std::vector<ConnCheckpoint::Entry> entries;
+	entries.swap(pending_restore);
+
+	// Connections don't look at the packet beyond its link-layer
+	// addresses and VLANs, which we don't have.
+	Packet pkt;
 
-	while ( (uc = udp_conns.NextEntry(cookie)) )
+	for ( const auto& e : entries )
 		{
-		uc->Done();
-		uc->Event(connection_state_remove, 0);
+		ConnTable* d = ConnTableFor(e.proto);
+		hash_t hash = ConnTable::Hash(e.key);
+
+		if ( ! d || d->Lookup(e.key, hash) )
+			continue;
+
+		HashKey* k = new HashKey(&e.key, sizeof(e.key), hash);
+		Connection* conn = new Connection(this, k, e.start_time, &e.id, 0, &pkt, 0);
+		conn->SetTransport(e.proto);
+		conn->SetLastTime(e.last_time);
+		conn->SetUID(Bro::UID(bits_per_uid, e.uid, BRO_UID_LEN));
+		conn->RestoreHistory(e.history, e.hist_seen);
+
+		if ( ! analyzer_mgr->BuildInitialAnalyzerTree(conn) )
+			{
+			conn->Done();
+			Unref(conn);
+			continue;
+			}
+
+		auto cs = static_cast<analyzer::conn_size::ConnSize_Analyzer*>(conn->FindAnalyzer("CONNSIZE"));
+
+		if ( cs )
+			cs->RestoreCounts(e.orig_pkts, e.orig_bytes, e.resp_pkts, e.resp_bytes);
+
+		// Attach the analyzers DPD had found right away. The root
+		// skips those already there, such as ones for well-known
+		// ports.
+		for ( const auto& name : e.analyzers )
+			{
+			analyzer::Tag tag = analyzer_mgr->GetComponentTag(name);
+
+			if ( tag && analyzer_mgr->IsEnabled(tag) &&
+			     ! conn->GetRootAnalyzer()->HasChildAnalyzer(tag) )
+				conn->GetRootAnalyzer()->AddChildAnalyzer(tag);
+			}
+
+		if ( ! e.services.empty() )
+			{
+			RecordVal* conn_val = conn->BuildConnVal();
+			TableVal* services = conn_val->Lookup(5)->AsTableVal();
+
+			for ( const auto& s : e.services )
+				{
+				Val* index = new StringVal(s);
+				services->Assign(index, 0);
+				Unref(index);
+				}
+
+			Unref(conn_val);
+			}
+
+		d->Insert(e.key, conn);
+		TouchConnection(conn);
+
+		if ( connection_restored )
+			conn->Event(connection_restored, 0);
 		}
+	}
+
+// Orders connections by start time, and by their keys if that's the same.
+static bool conn_drain_order(const Connection* a, const Connection* b)
+	{
+	if ( a->StartTime() != b->StartTime() )
+		return a->StartTime() < b->StartTime();
 
-	cookie = icmp_conns.InitForIteration();
-	Connection* ic;
+	const HashKey* ka = a->Key();
+	const HashKey* kb = b->Key();
+	return memcmp(ka->Key(), kb->Key(), std::min(ka->Size(), kb->Size())) < 0;
+	}
 
-	while ( (ic = icmp_conns.NextEntry(cookie)) )
+void NetSessions::Drain()
+	{
+	// Take a snapshot first, as the tables don't support being
+	// modified while iterating over them.
+	std::vector<Connection*> conns;
+	conns.reserve(CurrentConnections());
+
+	ConnTable* tables[] = { &tcp_conns, &udp_conns, &icmp_conns };
+
+	for ( auto d : tables )
 		{
-		ic->Done();
-		ic->Event(connection_state_remove, 0);
+		size_t pos = 0;
+		size_t first = conns.size();
+
+		while ( Connection* c = d->NextEntry(&pos) )
+			conns.push_back(c);
+
+		// The tables' order depends on their layout; what gets
+		// logged at termination shouldn't.
+		std::sort(conns.begin() + first, conns.end(), conn_drain_order);
 		}
 
+	for ( auto c : conns )
+		{
+		c->Done();
+		c->Event(connection_state_remove, 0);
+		}
+
+	if ( icmp_aggregator )
+		icmp_aggregator->Expire(network_time, true);
+
 	ExpireTimerMgrs();
 	}
 
@@ -1207,9 +1826,14 @@ void NetSessions::GetStats(SessionStats& s) const
 	s.max_UDP_conns = udp_conns.MaxLength();
 	s.max_ICMP_conns = icmp_conns.MaxLength();
 	s.max_fragments = fragments.MaxLength();
+
+	s.TCP_table_mem = tcp_conns.MemoryAllocation() - padded_sizeof(tcp_conns);
+	s.UDP_table_mem = udp_conns.MemoryAllocation() - padded_sizeof(udp_conns);
+	s.ICMP_table_mem = icmp_conns.MemoryAllocation() - padded_sizeof(icmp_conns);
+	s.fragments_table_mem = fragments.MemoryAllocation() - padded_sizeof(fragments);
 	}
 
-Connection* NetSessions::NewConn(HashKey* k, double t, const ConnID* id,
+Connection* NetSessions::NewConn(const ConnIDKey& key, hash_t hash, double t, const ConnID* id,
 					const u_char* data, int proto, uint32 flow_label,
 					const Packet* pkt, const EncapsulationStack* encapsulation)
 	{
@@ -1250,6 +1874,10 @@ Connection* NetSessions::NewConn(HashKey* k, double t, const ConnID* id,
 	if ( ! WantConnection(src_h, dst_h, tproto, flags, flip) )
 		return 0;
 
+	if ( load_shedder->SkipConnection(hash) )
+		return 0;
+
+	HashKey* k = new HashKey(&key, sizeof(key), hash);
 	Connection* conn = new Connection(this, k, t, id, flow_label, pkt, encapsulation);
 	conn->SetTransport(tproto);
 
@@ -1379,7 +2007,13 @@ TimerMgr* NetSessions::LookupTimerMgr(const TimerMgr::Tag* tag, bool create)
 			return 0;
 
 		// Create new queue for tag.
-		TimerMgr* mgr = new CQ_TimerMgr(*tag);
+		TimerMgr* mgr;
+
+		if ( zeekenv("ZEEK_TIMER_WHEEL") )
+			mgr = new TW_TimerMgr(*tag);
+		else
+			mgr = new CQ_TimerMgr(*tag);
+
 		DBG_LOG(DBG_TM, "tag %s, creating new non-global timer mgr %p", tag->c_str(), mgr);
 		timer_mgrs.insert(TimerMgrMap::value_type(*tag, mgr));
 		double t = timer_mgr->Time() + timer_mgr_inactivity_timeout;
@@ -1444,23 +2078,15 @@ unsigned int NetSessions::ConnectionMemoryUsage()
 		// Connections have been flushed already.
 		return 0;
 
-	IterCookie* cookie = tcp_conns.InitForIteration();
-	Connection* tc;
-
-	while ( (tc = tcp_conns.NextEntry(cookie)) )
-		mem += tc->MemoryAllocation();
-
-	cookie = udp_conns.InitForIteration();
-	Connection* uc;
+	const ConnTable* tables[] = { &tcp_conns, &udp_conns, &icmp_conns };
 
-	while ( (uc = udp_conns.NextEntry(cookie)) )
-		mem += uc->MemoryAllocation();
-
-	cookie = icmp_conns.InitForIteration();
-	Connection* ic;
+	for ( auto d : tables )
+		{
+		size_t pos = 0;
 
-	while ( (ic = icmp_conns.NextEntry(cookie)) )
-		mem += ic->MemoryAllocation();
+		while ( Connection* c = d->NextEntry(&pos) )
+			mem += c->MemoryAllocation();
+		}
 
 	return mem;
 	}
@@ -1473,25 +2099,37 @@ unsigned int NetSessions::ConnectionMemoryUsageConnVals()
 		// Connections have been flushed already.
 		return 0;
 
-	IterCookie* cookie = tcp_conns.InitForIteration();
-	Connection* tc;
+	const ConnTable* tables[] = { &tcp_conns, &udp_conns, &icmp_conns };
 
-	while ( (tc = tcp_conns.NextEntry(cookie)) )
-		mem += tc->MemoryAllocationConnVal();
+	for ( auto d : tables )
+		{
+		size_t pos = 0;
 
-	cookie = udp_conns.InitForIteration();
-	Connection* uc;
+		while ( Connection* c = d->NextEntry(&pos) )
+			mem += c->MemoryAllocationConnVal();
+		}
 
-	while ( (uc = udp_conns.NextEntry(cookie)) )
-		mem += uc->MemoryAllocationConnVal();
+	return mem;
+	}
 
-	cookie = icmp_conns.InitForIteration();
-	Connection* ic;
+void NetSessions::AnalyzerMemoryUsage(std::map<std::string, std::pair<uint64, uint64>>* mem)
+	{
+	if ( terminating )
+		// Connections have been flushed already.
+		return;
 
-	while ( (ic = icmp_conns.NextEntry(cookie)) )
-		mem += ic->MemoryAllocationConnVal();
+	const ConnTable* tables[] = { &tcp_conns, &udp_conns, &icmp_conns };
 
-	return mem;
+	for ( auto d : tables )
+		{
+		size_t pos = 0;
+
+		while ( Connection* c = d->NextEntry(&pos) )
+			{
+			if ( c->GetRootAnalyzer() )
+				c->GetRootAnalyzer()->AccountMemory(mem);
+			}
+		}
 	}
 
 unsigned int NetSessions::MemoryAllocation()
@@ -1502,16 +2140,9 @@ unsigned int NetSessions::MemoryAllocation()
 
 	return ConnectionMemoryUsage()
 		+ padded_sizeof(*this)
-		+ ch->MemoryAllocation()
-		// must take care we don't count the HaskKeys twice.
-		+ tcp_conns.MemoryAllocation() - padded_sizeof(tcp_conns) -
-		// 12 is sizeof(Key) from ConnID::BuildConnKey();
-		// it can't be (easily) accessed here. :-(
-			(tcp_conns.Length() * pad_size(12))
-		+ udp_conns.MemoryAllocation() - padded_sizeof(udp_conns) -
-			(udp_conns.Length() * pad_size(12))
-		+ icmp_conns.MemoryAllocation() - padded_sizeof(icmp_conns) -
-			(icmp_conns.Length() * pad_size(12))
+		+ tcp_conns.MemoryAllocation() - padded_sizeof(tcp_conns)
+		+ udp_conns.MemoryAllocation() - padded_sizeof(udp_conns)
+		+ icmp_conns.MemoryAllocation() - padded_sizeof(icmp_conns)
 		+ fragments.MemoryAllocation() - padded_sizeof(fragments)
 		// FIXME: MemoryAllocation() not implemented for rest.
 		;
@@ -5,12 +5,15 @@
 
 #include "Dict.h"
 #include "CompHash.h"
+#include "ConnCheckpoint.h"
+#include "ConnTable.h"
 #include "IP.h"
 #include "Frag.h"
 #include "PacketFilter.h"
 #include "Stats.h"
 #include "NetVar.h"
 #include "TunnelEncapsulation.h"
+#include "ICMPAggregator.h"
 #include "analyzer/protocol/tcp/Stats.h"
 
 #include <utility>
@@ -22,6 +25,7 @@ struct ConnID;
 
 class Discarder;
 class PacketFilter;
+class ConnExpiryTimer;
 
 namespace analyzer { namespace stepping_stone { class SteppingStoneManager; } }
 namespace analyzer { namespace arp { class ARP_Analyzer; } }
@@ -42,6 +46,18 @@ struct SessionStats {
 	int num_fragments;
 	int max_fragments;
 	uint64 num_packets;
+
+	// Bytes taken up by the tables, not counting what they hold.
+	uint64 TCP_table_mem;
+	uint64 UDP_table_mem;
+	uint64 ICMP_table_mem;
+	uint64 fragments_table_mem;
+};
+
+// Traffic seen inside tunnels of one type.
+struct TunnelTrafficStats {
+	uint64 packets;	// inner packets decapsulated
+	uint64 bytes;	// their total length
 };
 
 // Drains and deletes a timer manager if it hasn't seen any advances
@@ -68,6 +84,15 @@ public:
 
 	void Done();	// call to drain events before destructing
 
+	// Pipelines the connection lookups for a batch of packets that
+	// get processed in order. Called before processing the packet at
+	// position "pos", this loads the connection table slots of the
+	// packets a few positions further ahead into cache, and the
+	// connections of those closer by, so that their lookups no longer
+	// wait on memory once their turn comes. Only a hint: packets that
+	// don't qualify are simply left out.
+	void PrefetchConns(const Packet* batch, size_t count, size_t pos);
+
 	// Returns a reassembled packet, or nil if there are still
 	// some missing fragments.
 	FragReassembler* NextFragment(double t, const IP_Hdr* ip,
@@ -78,17 +103,44 @@ public:
 	// no such connection or the Val is ill-formed.
 	Connection* FindConnection(Val* v);
 
-	void Remove(Connection* c);
+	// Finishes a connection and deletes it. With notify false, skips
+	// connection_state_remove, for connections that live on elsewhere.
+	void Remove(Connection* c, bool notify = true);
 	void Remove(FragReassembler* f);
 
+	// Queues a fragment reassembler for expiration at its
+	// ExpireTime(), which must not be earlier than that of any
+	// reassembler queued before.
+	void ScheduleFragExpiration(FragReassembler* f);
+	void UnscheduleFragExpiration(FragReassembler* f);
+
+	// Expires the fragment reassemblers that have timed out by the
+	// given time, or all of them if "all" is true.
+	void ExpireFragments(double t, bool all);
+
+	// Accounts for n more bytes buffered for fragments from the given
+	// source. Returns false, without recording anything, if that would
+	// exceed frag_source_quota.
+	bool ChargeFragQuota(const IPAddr& src, uint64 n);
+	void ReleaseFragQuota(const IPAddr& src, uint64 n);
+
 	void Insert(Connection* c);
 
 	// Generating connection_pending events for all connections
 	// that are still active.
 	void Drain();
 
+	// Writes the connections that are still active to the given file,
+	// see ConnCheckpoint, and removes them quietly if that succeeds.
+	// Returns false if it didn't, leaving them in place for Drain().
+	bool CheckpointConnections(const char* path);
+
 	void GetStats(SessionStats& s) const;
 
+	// Returns the traffic seen inside tunnels of the given type.
+	const TunnelTrafficStats& GetTunnelStats(BifEnum::Tunnel::Type type) const
+		{ return tunnel_stats[type < NUM_TUNNEL_TYPES ? type : BifEnum::Tunnel::NONE]; }
+
 	void Weird(const char* name, const Packet* pkt,
 	    const EncapsulationStack* encap = 0, const char* addl = "");
 	void Weird(const char* name, const IP_Hdr* ip,
@@ -101,6 +153,14 @@ public:
 		return packet_filter;
 		}
 
+	Discarder* GetDiscarder();
+
+	// Arranges for a connection's inactivity timeout to be checked at
+	// the given time, or shortly after, by periodic sweeps of the expiry
+	// wheel. Replaces any check scheduled for it earlier. Used instead
+	// of inactivity timers if conn_expiry_granularity is set.
+	void ScheduleExpiry(Connection* c, double t);
+
 	// Looks up timer manager associated with tag.  If tag is unknown and
 	// "create" is true, creates new timer manager and stores it.  Returns
 	// global timer manager if tag is nil.
@@ -164,6 +224,11 @@ public:
 
 	unsigned int ConnectionMemoryUsage();
 	unsigned int ConnectionMemoryUsageConnVals();
+
+	// Adds up the memory the analyzers of all active connections use,
+	// per analyzer name; see analyzer::Analyzer::AccountMemory().
+	void AnalyzerMemoryUsage(std::map<std::string, std::pair<uint64, uint64>>* mem);
+
 	unsigned int MemoryAllocation();
 	analyzer::tcp::TCPStateStats tcp_stats;	// keeps statistics on TCP states
 
@@ -171,11 +236,49 @@ protected:
 	friend class ConnCompressor;
 	friend class TimerMgrExpireTimer;
 	friend class IPTunnelTimer;
+	friend class ConnExpiryTimer;
 
-	Connection* NewConn(HashKey* k, double t, const ConnID* id,
+	Connection* NewConn(const ConnIDKey& key, hash_t hash, double t, const ConnID* id,
 			const u_char* data, int proto, uint32 flow_label,
 			const Packet* pkt, const EncapsulationStack* encapsulation);
 
+	// Returns the table holding connections of the given transport, or
+	// nil if there's none.
+	ConnTable* ConnTableFor(TransportProto proto);
+
+	// Extracts the key of the TCP or UDP connection a packet belongs to
+	// straight from its headers, and returns the table to look it up
+	// in. Returns nil for anything else, including fragments, tunnels
+	// and IPv6 extension headers.
+	ConnTable* PacketConnKey(const Packet* pkt, ConnIDKey* key);
+
+	// Moves a connection to the end of the activity list, adding it
+	// if it's not in there yet.
+	void TouchConnection(Connection* c);
+
+	// Takes a connection off the activity list.
+	void UnlinkConnection(Connection* c);
+
+	// Takes a connection out of the expiry wheel.
+	void UnscheduleExpiry(Connection* c);
+
+	// Checks the connections in the expiry wheel slots that have
+	// elapsed by time t, timing out those that have been inactive for
+	// long enough, and schedules the next sweep.
+	void ExpireConnections(double t);
+
+	// Returns an estimate of the memory held by connection state.
+	uint64 ConnStateMemory() const;
+
+	// If connection state has grown beyond conn_state_budget, removes
+	// the connections that have been inactive the longest until we're
+	// comfortably below it again. Never removes the given connection.
+	void EnforceStateBudget(Connection* keep);
+
+	// Recreates the connections read from conn_restore_file. Called
+	// with the first packet, as connections need a packet source.
+	void RestoreConnections();
+
 	// Check whether the tag of the current packet is consistent with
 	// the given connection.  Returns:
 	//    -1   if current packet is to be completely ignored.
@@ -212,12 +315,33 @@ protected:
 	bool CheckHeaderTrunc(int proto, uint32 len, uint32 caplen,
 			      const Packet *pkt, const EncapsulationStack* encap);
 
-	CompositeHash* ch;
-	PDict<Connection> tcp_conns;
-	PDict<Connection> udp_conns;
-	PDict<Connection> icmp_conns;
+	ConnTable tcp_conns;
+	ConnTable udp_conns;
+	ConnTable icmp_conns;
 	PDict<FragReassembler> fragments;
 
+	// ICMP flows tracked without connections, if icmp_aggregation is set.
+	ICMPAggregator* icmp_aggregator;
+
+	// Fragment reassemblers in the order in which they expire, and the
+	// timer for the next one of them, if any.
+	FragReassembler* frag_expire_head;
+	FragReassembler* frag_expire_tail;
+	FragSweepTimer* frag_sweep_timer;
+
+	// Keys of the packets of the current batch that PrefetchConns()
+	// got to, by position.
+	struct ConnPrefetch {
+		ConnTable* table;
+		ConnIDKey key;
+		hash_t hash;
+	};
+
+	std::vector<ConnPrefetch> conn_prefetches;
+
+	// Bytes buffered for fragments, per source address.
+	std::map<IPAddr, uint64> frag_bytes_by_src;
+
 	typedef pair<IPAddr, IPAddr> IPPair;
 	typedef pair<EncapsulatingConn, double> TunnelActivity;
 	typedef std::map<IPPair, TunnelActivity> IPTunnelMap;
@@ -230,6 +354,27 @@ protected:
 	PacketFilter* packet_filter;
 	int dump_this_packet;	// if true, current packet should be recorded
 	uint64 num_packets_processed;
+
+	// Indexed by BifEnum::Tunnel::Type; VXLAN is the last one defined.
+	static const unsigned int NUM_TUNNEL_TYPES = BifEnum::Tunnel::VXLAN + 1;
+	TunnelTrafficStats tunnel_stats[NUM_TUNNEL_TYPES];
+
+	// Connections awaiting an inactivity check, hashed into slots of
+	// conn_expiry_granularity width by when it's due. The wheel wraps
+	// around, so a slot may also hold connections due in later rounds.
+	static const unsigned int EXPIRY_WHEEL_SLOTS = 4096;
+	std::vector<Connection*> expiry_wheel;
+	uint64 expiry_tick;	// the next slot to sweep, as absolute tick
+	uint64 num_expiry_scheduled;
+	ConnExpiryTimer* expiry_timer;
+
+	// Connections ordered by their most recent activity, oldest first.
+	Connection* lru_head;
+	Connection* lru_tail;
+
+	// Connections read from conn_restore_file, until recreated.
+	std::vector<ConnCheckpoint::Entry> pending_restore;
+
 	PacketProfiler* pkt_profiler;
 
 	// We may use independent timer managers for different sets of related
@@ -239,6 +384,18 @@ protected:
 };
 
 
+// Sweeps the connection expiry wheel. There's at most one of these pending.
+class ConnExpiryTimer : public Timer {
+public:
+	ConnExpiryTimer(NetSessions* arg_s, double t)
+		: Timer(t, TIMER_CONN_INACTIVITY), s(arg_s)	{}
+
+	void Dispatch(double t, int is_expire) override;
+
+protected:
+	NetSessions* s;
+};
+
 class IPTunnelTimer : public Timer {
 public:
 	IPTunnelTimer(double t, NetSessions::IPPair p)
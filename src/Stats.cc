@@ -1,6 +1,15 @@
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
 #include "Conn.h"
+#include "ObjPool.h"
 #include "File.h"
 #include "Event.h"
+#include "Func.h"
+#include "Stmt.h"
+#include "Reporter.h"
 #include "NetVar.h"
 #include "Sessions.h"
 #include "Stats.h"
@@ -10,8 +19,10 @@
 #include "Trigger.h"
 #include "threading/Manager.h"
 #include "broker/Manager.h"
+#include "analyzer/Analyzer.h"
 
 uint64 killed_by_inactivity = 0;
+uint64 killed_by_memory_pressure = 0;
 
 uint64 tot_ack_events = 0;
 uint64 tot_ack_bytes = 0;
@@ -161,9 +172,25 @@ void ProfileLogger::Log()
 	file->Write(fmt("%.06f Connections expired due to inactivity: %" PRIu64 "\n",
 		network_time, killed_by_inactivity));
 
+	if ( killed_by_memory_pressure )
+		file->Write(fmt("%.06f Connections evicted due to memory pressure: %" PRIu64 "\n",
+			network_time, killed_by_memory_pressure));
+
 	file->Write(fmt("%.06f Total reassembler data: %" PRIu64 "K\n", network_time,
 		Reassembler::TotalMemoryAllocation() / 1024));
 
+	const std::vector<const ObjPool*>& pools = ObjPool::Pools();
+
+	for ( size_t i = 0; i < pools.size(); i++ )
+		{
+		if ( ! pools[i]->Slabs() )
+			continue;
+
+		file->Write(fmt("%.06f   Pool %-20s in_use=%zu slabs=%zu mem=%zuK\n",
+			network_time, pools[i]->Name(), pools[i]->InUse(),
+			pools[i]->Slabs(), pools[i]->MemoryAllocation() / 1024));
+		}
+
 	// Signature engine.
 	if ( expensive && rule_matcher )
 		{
@@ -195,6 +222,42 @@ void ProfileLogger::Log()
 
 	file->Write(fmt("%.06f Triggers: total=%lu pending=%lu\n", network_time, tstats.total, tstats.pending));
 
+	if ( BifConst::profile_script_functions )
+		{
+		std::map<std::string, FuncProfiler::Stats> fstats;
+		func_profiler.GetStats(&fstats);
+
+		// Report the functions that cost most by themselves.
+		std::vector<std::pair<std::string, FuncProfiler::Stats>> top(fstats.begin(), fstats.end());
+		std::sort(top.begin(), top.end(),
+			[](const std::pair<std::string, FuncProfiler::Stats>& a,
+			   const std::pair<std::string, FuncProfiler::Stats>& b)
+				{ return a.second.exclusive_nsecs > b.second.exclusive_nsecs; });
+
+		if ( top.size() > 20 )
+			top.resize(20);
+
+		for ( const auto& f : top )
+			file->Write(fmt("%.06f   Function %-30s calls=%" PRIu64 " incl=%.6fs excl=%.6fs "
+				"allocs=%" PRIu64 "/%" PRIu64 "\n", network_time, f.first.c_str(),
+				f.second.calls, f.second.inclusive_nsecs / 1e9,
+				f.second.exclusive_nsecs / 1e9, f.second.inclusive_allocs,
+				f.second.exclusive_allocs));
+		}
+
+	if ( BifConst::profile_analyzers )
+		{
+		std::map<std::string, AnalyzerProfiler::Stats> astats;
+		analyzer_profiler.GetStats(&astats);
+
+		for ( const auto& a : astats )
+			file->Write(fmt("%.06f   Analyzer %-20s deliveries=%" PRIu64 " bytes=%" PRIu64
+				" time=%.6fs instances=%" PRIu64 " memory=%" PRIu64 "\n",
+				network_time, a.first.c_str(), a.second.deliveries,
+				a.second.bytes, a.second.nsecs / 1e9, a.second.instances,
+				a.second.memory));
+		}
+
 	unsigned int* current_timers = TimerMgr::CurrentTimers();
 	for ( int i = 0; i < NUM_TIMER_TYPES; ++i )
 		{
@@ -483,3 +546,412 @@ void PacketProfiler::ProfilePkt(double t, unsigned int bytes)
 	byte_cnt += bytes;
 	time = t;
 	}
+
+PipelineStats pipeline_stats;
+FuncProfiler func_profiler;
+AnalyzerProfiler analyzer_profiler;
+ScriptSampler script_sampler;
+
+void LatencyHistogram::Reset()
+	{
+	memset(counts, 0, sizeof(counts));
+	samples = total = max = 0;
+	}
+
+uint64 LatencyHistogram::BucketUpperBound(int idx)
+	{
+	int group = idx >> SUB_BUCKET_BITS;
+
+	if ( group == 0 )
+		return idx;
+
+	uint64 sub = (1 << SUB_BUCKET_BITS) + (idx & ((1 << SUB_BUCKET_BITS) - 1));
+	int shift = group - 1;
+
+	return (sub << shift) + ((uint64(1) << shift) - 1);
+	}
+
+uint64 LatencyHistogram::Percentile(double p) const
+	{
+	if ( ! samples )
+		return 0;
+
+	uint64 threshold = uint64(p / 100.0 * samples + 0.5);
+
+	if ( threshold < 1 )
+		threshold = 1;
+
+	uint64 seen = 0;
+
+	for ( int i = 0; i < NUM_BUCKETS; i++ )
+		{
+		seen += counts[i];
+
+		if ( seen >= threshold )
+			return std::min(BucketUpperBound(i), max);
+		}
+
+	return max;
+	}
+
+PipelineStats::PipelineStats()
+	{
+	nested = 0;
+	}
+
+const char* PipelineStats::StageName(int stage)
+	{
+	static const char* names[NUM_STAGES] = {
+		"capture", "timers", "sessions", "analyzers", "events",
+	};
+
+	return (stage >= 0 && stage < NUM_STAGES) ? names[stage] : "<unknown>";
+	}
+
+void PipelineStats::Reset()
+	{
+	for ( int i = 0; i < NUM_STAGES; i++ )
+		stages[i].Reset();
+	}
+
+FuncProfiler::FuncProfiler()
+	{
+	nested_nsecs = nested_allocs = 0;
+	}
+
+uint64 FuncProfiler::ValAllocations()
+	{
+	// RecordVals come from a pool of their own; all other Vals, whatever
+	// their size, go through that of the base class.
+	return Val::obj_pool.Allocations() + RecordVal::obj_pool.Allocations();
+	}
+
+void FuncProfiler::Account(const Scope* scope)
+	{
+	uint64 nsecs = CPUTime() - scope->start;
+	uint64 allocs = ValAllocations() - scope->start_allocs;
+	uint64 nested_nsecs_inside = nested_nsecs - scope->nested_nsecs_at_start;
+	uint64 nested_allocs_inside = nested_allocs - scope->nested_allocs_at_start;
+
+	FuncStats& s = funcs[scope->func];
+
+	if ( ! s.calls )
+		s.name = scope->func->Name();
+
+	++s.calls;
+	s.inclusive_nsecs += nsecs;
+	s.exclusive_nsecs += nsecs > nested_nsecs_inside ? nsecs - nested_nsecs_inside : 0;
+	s.inclusive_allocs += allocs;
+	s.exclusive_allocs += allocs > nested_allocs_inside ? allocs - nested_allocs_inside : 0;
+
+	// Our caller, if any, discounts all of it.
+	nested_nsecs = scope->nested_nsecs_at_start + nsecs;
+	nested_allocs = scope->nested_allocs_at_start + allocs;
+	}
+
+void FuncProfiler::GetStats(std::map<std::string, Stats>* stats) const
+	{
+	for ( const auto& f : funcs )
+		{
+		auto i = stats->find(f.second.name);
+
+		if ( i == stats->end() )
+			{
+			(*stats)[f.second.name] = f.second;
+			continue;
+			}
+
+		Stats& s = i->second;
+		s.calls += f.second.calls;
+		s.inclusive_nsecs += f.second.inclusive_nsecs;
+		s.exclusive_nsecs += f.second.exclusive_nsecs;
+		s.inclusive_allocs += f.second.inclusive_allocs;
+		s.exclusive_allocs += f.second.exclusive_allocs;
+		}
+	}
+
+AnalyzerProfiler::AnalyzerProfiler()
+	{
+	nested_ticks = 0;
+	depth = 0;
+	timing = false;
+	top_level_deliveries = 0;
+	start_ticks = Ticks();
+	start_nsecs = PipelineStats::Now();
+	}
+
+void AnalyzerProfiler::Reset()
+	{
+	analyzers.clear();
+	}
+
+void AnalyzerProfiler::Begin(Scope* scope)
+	{
+	// Nested deliveries follow the decision taken for the top-level one,
+	// as their time is subtracted from it.
+	if ( depth++ == 0 )
+		{
+		uint64 rate = BifConst::profile_analyzers_sampling;
+		timing = rate <= 1 || ++top_level_deliveries % rate == 0;
+		}
+
+	scope->timed = timing;
+
+	if ( timing )
+		{
+		scope->nested_ticks_at_start = nested_ticks;
+		scope->start = Ticks();
+		}
+	}
+
+void AnalyzerProfiler::Account(const Scope* scope)
+	{
+	--depth;
+
+	if ( scope->type >= analyzers.size() )
+		analyzers.resize(scope->type + 1);
+
+	TagStats& s = analyzers[scope->type];
+
+	if ( ! s.deliveries )
+		{
+		s.name = scope->type ? scope->analyzer->GetAnalyzerName() : "<untagged>";
+		s.bytes = s.timed = s.ticks = 0;
+		}
+
+	++s.deliveries;
+	s.bytes += scope->len;
+
+	if ( ! scope->timed )
+		return;
+
+	uint64 ticks = Ticks() - scope->start;
+	uint64 nested_inside = nested_ticks - scope->nested_ticks_at_start;
+
+	++s.timed;
+	s.ticks += ticks > nested_inside ? ticks - nested_inside : 0;
+
+	// An enclosing delivery, if any, discounts all of it.
+	nested_ticks = scope->nested_ticks_at_start + ticks;
+	}
+
+double AnalyzerProfiler::TickRate() const
+	{
+#if defined(__x86_64__) || defined(__i386__)
+	// Calibrate against the monotonic clock over our lifetime so far,
+	// which averages out frequency changes the counter may not be
+	// immune to on older CPUs.
+	uint64 nsecs = PipelineStats::Now() - start_nsecs;
+	uint64 ticks = Ticks() - start_ticks;
+
+	if ( nsecs < 1000000 || ! ticks )
+		{
+		// Too short for a meaningful ratio.
+		struct timespec ts = { 0, 10000000 };
+		uint64 t0 = Ticks();
+		uint64 n0 = PipelineStats::Now();
+		nanosleep(&ts, 0);
+		nsecs = PipelineStats::Now() - n0;
+		ticks = Ticks() - t0;
+		}
+
+	return ticks ? double(nsecs) / ticks : 0;
+#else
+	return 1;
+#endif
+	}
+
+void AnalyzerProfiler::GetStats(std::map<std::string, Stats>* stats) const
+	{
+	double rate = TickRate();
+
+	for ( size_t i = 0; i < analyzers.size(); ++i )
+		{
+		const TagStats& t = analyzers[i];
+
+		if ( ! t.deliveries )
+			continue;
+
+		Stats& s = (*stats)[t.name];
+		s.deliveries = t.deliveries;
+		s.bytes = t.bytes;
+		s.nsecs = t.timed ?
+			uint64(t.ticks * rate * (double(t.deliveries) / t.timed)) : 0;
+		}
+
+	if ( ! sessions )
+		return;
+
+	// Entries default to all zeros for analyzers that haven't seen
+	// any deliveries yet.
+	std::map<std::string, std::pair<uint64, uint64>> mem;
+	sessions->AnalyzerMemoryUsage(&mem);
+
+	for ( const auto& m : mem )
+		{
+		Stats& s = (*stats)[m.first];
+		s.instances = m.second.first;
+		s.memory = m.second.second;
+		}
+	}
+
+volatile sig_atomic_t ScriptSampler::pending = 0;
+volatile sig_atomic_t ScriptSampler::core_samples = 0;
+pthread_t ScriptSampler::main_thread;
+
+ScriptSampler::ScriptSampler()
+	{
+	running = false;
+	memset(&old_action, 0, sizeof(old_action));
+	}
+
+void ScriptSampler::Handler(int sig)
+	{
+	// The interpreter only runs on the main thread. Other threads may
+	// receive the signal when they caused the tick, and we only want to
+	// sample the main thread's CPU time anyway.
+	if ( ! pthread_equal(pthread_self(), main_thread) )
+		return;
+
+	// Checking for an empty stack only compares two pointers, which is
+	// fine to do even if we interrupted a change to it.
+	if ( call_stack.empty() )
+		++core_samples;
+	else
+		pending = 1;
+	}
+
+bool ScriptSampler::Start(int hz)
+	{
+	if ( running )
+		{
+		reporter->Error("script sampling already running");
+		return false;
+		}
+
+	if ( hz <= 0 || hz > 10000 )
+		{
+		reporter->Error("bad script sampling rate %d", hz);
+		return false;
+		}
+
+	main_thread = pthread_self();
+	pending = 0;
+
+	struct sigaction act;
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = Handler;
+	act.sa_flags = SA_RESTART;
+	sigemptyset(&act.sa_mask);
+
+	if ( sigaction(SIGPROF, &act, &old_action) < 0 )
+		{
+		reporter->Error("cannot install SIGPROF handler: %s", strerror(errno));
+		return false;
+		}
+
+	if ( old_action.sa_handler != SIG_DFL && old_action.sa_handler != SIG_IGN )
+		{
+		sigaction(SIGPROF, &old_action, 0);
+		reporter->Error("cannot sample scripts, SIGPROF is already in use");
+		return false;
+		}
+
+	// A tv_usec of a full second or more is invalid, which is what
+	// 1 Hz would otherwise give us.
+	long usecs = 1000000 / hz;
+
+	struct itimerval it;
+	it.it_interval.tv_sec = usecs / 1000000;
+	it.it_interval.tv_usec = usecs % 1000000;
+	it.it_value = it.it_interval;
+
+	if ( setitimer(ITIMER_PROF, &it, 0) < 0 )
+		{
+		sigaction(SIGPROF, &old_action, 0);
+		reporter->Error("cannot start profiling timer: %s", strerror(errno));
+		return false;
+		}
+
+	running = true;
+	return true;
+	}
+
+void ScriptSampler::Stop()
+	{
+	if ( ! running )
+		return;
+
+	struct itimerval it;
+	memset(&it, 0, sizeof(it));
+	setitimer(ITIMER_PROF, &it, 0);
+	sigaction(SIGPROF, &old_action, 0);
+
+	running = false;
+	pending = 0;
+	}
+
+void ScriptSampler::Sample(const Stmt* stmt)
+	{
+	pending = 0;
+
+	std::string stack;
+
+	for ( const auto& ci : call_stack )
+		{
+		if ( ! stack.empty() )
+			stack += ';';
+
+		stack += ci.func->Name();
+		}
+
+	if ( stmt )
+		{
+		const Location* loc = stmt->GetLocationInfo();
+
+		if ( loc && loc->filename )
+			{
+			if ( ! stack.empty() )
+				stack += ';';
+
+			stack += fmt("%s:%d", loc->filename, loc->first_line);
+			}
+		}
+
+	if ( stack.empty() )
+		stack = "[zeek]";
+
+	// The format separates the count by a space.
+	std::replace(stack.begin(), stack.end(), ' ', '_');
+
+	++stacks[stack];
+	}
+
+bool ScriptSampler::Write(const char* path)
+	{
+	FILE* f = fopen(path, "w");
+
+	if ( ! f )
+		{
+		reporter->Error("cannot open %s: %s", path, strerror(errno));
+		return false;
+		}
+
+	if ( core_samples )
+		stacks["[zeek]"] += core_samples;
+
+	core_samples = 0;
+
+	for ( const auto& s : stacks )
+		fprintf(f, "%s %" PRIu64 "\n", s.first.c_str(), s.second);
+
+	stacks.clear();
+
+	if ( fclose(f) != 0 )
+		{
+		reporter->Error("cannot write %s: %s", path, strerror(errno));
+		return false;
+		}
+
+	return true;
+	}
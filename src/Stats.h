@@ -6,6 +6,18 @@
 #include <sys/types.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Func;
+namespace analyzer { class Analyzer; }
+class Stmt;
 
 // Object called by SegmentProfiler when it is done and reports its
 // cumulative CPU/memory statistics.
@@ -103,6 +115,7 @@ extern SampleLogger* sample_logger;
 
 // Connection statistics.
 extern uint64 killed_by_inactivity;
+extern uint64 killed_by_memory_pressure;
 
 // Content gap statistics.
 extern uint64 tot_ack_events;
@@ -132,4 +145,375 @@ protected:
 	uint64 byte_cnt;
 };
 
+// A histogram of durations in nanoseconds. Buckets grow logarithmically,
+// with each power of two split into a number of linear sub-buckets (as
+// in HdrHistogram), so that recording is constant-time and the relative
+// error of reported percentiles is bounded by the sub-bucket width.
+class LatencyHistogram {
+public:
+	LatencyHistogram()	{ Reset(); }
+
+	// Records *n* samples of the given duration.
+	void Record(uint64 nsecs, uint64 n = 1)
+		{
+		counts[BucketIndex(nsecs)] += n;
+		samples += n;
+		total += nsecs * n;
+
+		if ( nsecs > max )
+			max = nsecs;
+		}
+
+	uint64 Samples() const	{ return samples; }
+	uint64 Total() const	{ return total; }
+	uint64 Max() const	{ return max; }
+
+	// Returns the upper bound of the bucket holding the given
+	// percentile (0-100) of samples.
+	uint64 Percentile(double p) const;
+
+	void Reset();
+
+private:
+	static const int SUB_BUCKET_BITS = 3;
+	static const int NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+	static int BucketIndex(uint64 v)
+		{
+		if ( v < (1 << SUB_BUCKET_BITS) )
+			return v;
+
+		int shift = 63 - __builtin_clzll(v) - SUB_BUCKET_BITS;
+		return ((shift + 1) << SUB_BUCKET_BITS) |
+			((v >> shift) & ((1 << SUB_BUCKET_BITS) - 1));
+		}
+
+	static uint64 BucketUpperBound(int idx);
+
+	uint64 counts[NUM_BUCKETS];
+	uint64 samples;
+	uint64 total;
+	uint64 max;
+};
+
+// Keeps latency histograms for the stages of the per-packet processing
+// pipeline. Time spent in a stage nested inside another one (such as
+// analyzer delivery inside session processing) is only accounted to the
+// inner stage.
+class PipelineStats {
+public:
+	enum Stage {
+		CAPTURE,	// Retrieving packets from the packet source.
+		TIMERS,		// Expiring timers before each packet.
+		SESSIONS,	// NetSessions::DoNextPacket().
+		ANALYZERS,	// Delivering a packet to the connection's analyzers.
+		EVENTS,		// Draining the event queue after each packet.
+		NUM_STAGES
+	};
+
+	PipelineStats();
+
+	static const char* StageName(int stage);
+
+	const LatencyHistogram& Histogram(int stage) const
+		{ return stages[stage]; }
+
+	void Reset();
+
+	// Returns a monotonic timestamp in nanoseconds.
+	static uint64 Now()
+		{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return uint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+		}
+
+	// Records a duration measured outside of a Timer, spreading it
+	// evenly over *n* samples (e.g., for batches of packets).
+	void Record(Stage stage, uint64 nsecs, uint64 n = 1)
+		{
+		if ( n )
+			stages[stage].Record(nsecs / n, n);
+		}
+
+	// Measures the time spent in a stage during its lifetime.
+	class Timer {
+	public:
+		Timer(PipelineStats* arg_stats, Stage arg_stage)
+			: stats(arg_stats), stage(arg_stage)
+			{
+			nested_at_start = stats->nested;
+			start = Now();
+			}
+
+		~Timer()
+			{
+			uint64 elapsed = Now() - start;
+			uint64 nested = stats->nested - nested_at_start;
+
+			stats->stages[stage].Record(elapsed > nested ? elapsed - nested : 0);
+
+			// Our enclosing timer, if any, discounts all of it.
+			stats->nested = nested_at_start + elapsed;
+			}
+
+	private:
+		PipelineStats* stats;
+		Stage stage;
+		uint64 start;
+		uint64 nested_at_start;
+	};
+
+private:
+	LatencyHistogram stages[NUM_STAGES];
+
+	// Running total of time measured by Timers, used to subtract
+	// nested stages from enclosing ones.
+	uint64 nested;
+};
+
+extern PipelineStats pipeline_stats;
+
+// Accounts the cost of each script function, event handler and hook while
+// profile_script_functions is set. Times are CPU time of the main thread.
+// Exclusive numbers leave out what is spent in the functions called from
+// one; inclusive ones of recursive functions count nested calls repeatedly.
+class FuncProfiler {
+public:
+	struct Stats {
+		uint64 calls;
+		uint64 inclusive_nsecs;
+		uint64 exclusive_nsecs;
+		uint64 inclusive_allocs;	// # Vals allocated
+		uint64 exclusive_allocs;
+	};
+
+	FuncProfiler();
+
+	// Returns the statistics gathered so far, indexed by function name.
+	// Functions sharing a name (e.g., redefined ones) are merged.
+	void GetStats(std::map<std::string, Stats>* stats) const;
+
+	void Reset()	{ funcs.clear(); }
+
+	// Returns the main thread's CPU time in nanoseconds.
+	static uint64 CPUTime()
+		{
+		struct timespec ts;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+		return uint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+		}
+
+	// Returns the number of Vals allocated so far.
+	static uint64 ValAllocations();
+
+	// Accounts one call of a function to the profiler during its
+	// lifetime. Does nothing if no function is given.
+	class Scope {
+	public:
+		Scope(FuncProfiler* arg_profiler, const Func* arg_func)
+			: profiler(arg_profiler), func(arg_func)
+			{
+			if ( ! func )
+				return;
+
+			nested_nsecs_at_start = profiler->nested_nsecs;
+			nested_allocs_at_start = profiler->nested_allocs;
+			start_allocs = ValAllocations();
+			start = CPUTime();
+			}
+
+		~Scope()
+			{
+			if ( func )
+				profiler->Account(this);
+			}
+
+	private:
+		friend class FuncProfiler;
+
+		FuncProfiler* profiler;
+		const Func* func;
+		uint64 start;
+		uint64 start_allocs;
+		uint64 nested_nsecs_at_start;
+		uint64 nested_allocs_at_start;
+	};
+
+private:
+	struct FuncStats : Stats {
+		std::string name;
+	};
+
+	void Account(const Scope* scope);
+
+	// Functions may go away while we still report on them, so we
+	// remember their names rather than dereferencing these later.
+	std::unordered_map<const Func*, FuncStats> funcs;
+
+	// Running totals of what Scopes measured, used to subtract nested
+	// calls from enclosing ones.
+	uint64 nested_nsecs;
+	uint64 nested_allocs;
+};
+
+extern FuncProfiler func_profiler;
+
+// Accounts the time analyzers spend on their input while
+// profile_analyzers is set. Time spent in analyzers that one forwards to
+// (support analyzers, children) is only accounted to those. Analyzers are
+// told apart by their tag, so instances of the same one are merged.
+//
+// Durations are taken from the CPU's cycle counter where there is a
+// cheap one, and converted to nanoseconds when reported. To keep the
+// overhead down further, only one in profile_analyzers_sampling top-level
+// deliveries is timed, along with everything nested inside; the time
+// reported for an analyzer is extrapolated from its timed deliveries.
+class AnalyzerProfiler {
+public:
+	struct Stats {
+		uint64 deliveries;	// Packets, stream chunks and gaps.
+		uint64 bytes;	// Not counting gaps.
+		uint64 nsecs;
+		uint64 instances;	// Currently active.
+		uint64 memory;	// Of those instances, without their children.
+	};
+
+	AnalyzerProfiler();
+
+	// Returns the statistics gathered so far, indexed by analyzer name,
+	// along with the memory the currently active analyzers use.
+	void GetStats(std::map<std::string, Stats>* stats) const;
+
+	void Reset();
+
+	// Returns a timestamp in units of Ticks(); cycles where the CPU
+	// offers a cheap counter for them, and nanoseconds otherwise.
+	static uint64 Ticks()
+		{
+#if defined(__x86_64__) || defined(__i386__)
+		return __builtin_ia32_rdtsc();
+#else
+		return PipelineStats::Now();
+#endif
+		}
+
+	// Accounts one delivery to an analyzer during its lifetime. Does
+	// nothing if not enabled.
+	class Scope {
+	public:
+		Scope(AnalyzerProfiler* arg_profiler, bool arg_enabled,
+		      const analyzer::Analyzer* arg_analyzer, uint32 arg_type,
+		      int arg_len)
+			: profiler(arg_profiler), enabled(arg_enabled)
+			{
+			if ( ! enabled )
+				return;
+
+			analyzer = arg_analyzer;
+			type = arg_type;
+			len = arg_len > 0 ? arg_len : 0;
+			profiler->Begin(this);
+			}
+
+		~Scope()
+			{
+			if ( enabled )
+				profiler->Account(this);
+			}
+
+	private:
+		friend class AnalyzerProfiler;
+
+		AnalyzerProfiler* profiler;
+		bool enabled;
+		bool timed;
+		const analyzer::Analyzer* analyzer;
+		uint32 type;	// Of the analyzer's tag.
+		uint64 len;
+		uint64 start;
+		uint64 nested_ticks_at_start;
+	};
+
+private:
+	void Begin(Scope* scope);
+	void Account(const Scope* scope);
+
+	// Returns the number of nanoseconds per tick.
+	double TickRate() const;
+
+	struct TagStats {
+		std::string name;
+		uint64 deliveries;
+		uint64 bytes;
+		uint64 timed;	// Deliveries that were timed.
+		uint64 ticks;	// Spent on those.
+	};
+
+	// Indexed by the type of the analyzer's tag; 0 is for analyzers
+	// without one.
+	std::vector<TagStats> analyzers;
+
+	// Running total of what Scopes measured, used to subtract nested
+	// deliveries from enclosing ones.
+	uint64 nested_ticks;
+
+	int depth;	// Of currently open Scopes.
+	bool timing;	// Whether the current top-level delivery is timed.
+	uint64 top_level_deliveries;
+
+	// Reference points for converting ticks to nanoseconds.
+	uint64 start_ticks;
+	uint64 start_nsecs;
+};
+
+extern AnalyzerProfiler analyzer_profiler;
+
+// Samples the script call stack at a fixed rate of CPU time (via SIGPROF)
+// and aggregates the samples in the folded format that flame graph tools
+// take. As the interpreter's state can't be inspected safely from within a
+// signal handler, the handler merely flags that a sample is due; it's then
+// taken at the next statement the interpreter executes, or when the BIF
+// currently running returns. Samples hitting while no script is running
+// are accounted to a "[zeek]" frame.
+class ScriptSampler {
+public:
+	ScriptSampler();
+
+	// Starts sampling at the given rate per second of CPU time. Returns
+	// false, after reporting an error, if sampling is already running or
+	// SIGPROF is in use by somebody else (e.g., a CPU profiler).
+	bool Start(int hz);
+
+	// Stops sampling, keeping the samples collected so far.
+	void Stop();
+
+	bool Running() const	{ return running; }
+
+	// Returns true if a sample is due.
+	static bool Pending()	{ return pending; }
+
+	// Records the current call stack, with the location of the given
+	// statement (if any) as its innermost frame.
+	void Sample(const Stmt* stmt);
+
+	// Writes the samples collected so far to the given file, one line
+	// per distinct stack, and discards them. Returns false, after
+	// reporting an error, if the file can't be written.
+	bool Write(const char* path);
+
+private:
+	static void Handler(int sig);
+
+	static volatile sig_atomic_t pending;
+	static volatile sig_atomic_t core_samples;
+	static pthread_t main_thread;
+
+	std::map<std::string, uint64> stacks;
+	struct sigaction old_action;
+	bool running;
+};
+
+extern ScriptSampler script_sampler;
+
 #endif
@@ -2,6 +2,8 @@
 
 #include "zeek-config.h"
 
+#include <errno.h>
+
 #include "Expr.h"
 #include "Event.h"
 #include "Frame.h"
@@ -203,26 +205,38 @@ Val* PrintStmt::DoExec(val_list* vals, stmt_flow_type& /* flow */) const
 		++offset;
 		}
 
-	desc_style style = f->IsRawOutput() ? RAW_STYLE : STANDARD_STYLE;
+	// Format into a buffer that we keep around, and hand it to the file
+	// in one go.
+	static ODesc* d = 0;
 
-	if ( f->IsRawOutput() )
-		{
-		ODesc d(DESC_READABLE);
-		d.SetFlush(0);
-		d.SetStyle(style);
+	if ( ! d )
+		d = new ODesc(DESC_READABLE);
 
-		PrintVals(&d, vals, offset);
-		f->Write(d.Description(), d.Len());
-		}
-	else
+	d->Clear();
+	d->ClearIndentLevel();
+	d->SetStyle(f->IsRawOutput() ? RAW_STYLE : STANDARD_STYLE);
+
+	PrintVals(d, vals, offset);
+
+	if ( ! f->IsRawOutput() )
+		d->AddRaw("\n", 1);
+
+	if ( ! d->Len() )
+		return 0;
+
+	static bool write_failed = false;
+
+	if ( ! f->Write(d->Description(), d->Len()) )
 		{
-		ODesc d(DESC_READABLE, f);
-		d.SetFlush(0);
-		d.SetStyle(style);
+		if ( ! write_failed )
+			// Most likely it's a "disk full" so report
+			// subsequent failures only once.
+			reporter->Error("error writing to %s: %s", f->Name(), strerror(errno));
 
-		PrintVals(&d, vals, offset);
-		f->Write("\n", 1);
+		write_failed = true;
 		}
+	else
+		write_failed = false;
 
 	return 0;
 	}
@@ -919,7 +933,7 @@ Val* EventStmt::Exec(Frame* f, stmt_flow_type& flow) const
 
 	if ( args )
 		{
-		mgr.QueueEvent(event_expr->Handler(), std::move(*args));
+		mgr.QueueScriptEvent(event_expr->Handler(), std::move(*args));
 		delete args;
 		}
 
@@ -1151,23 +1165,41 @@ Val* ForStmt::DoExec(Frame* f, Val* v, stmt_flow_type& flow) const
 		if ( ! loop_vals->Length() )
 			return 0;
 
-		HashKey* k;
+		// Index values go straight into the loop variables, without a
+		// ListVal or a copy of the key in between.
+		int num_indices = loop_vars->length();
+		std::vector<Val*> ind_vals(num_indices);
+
+		const void* key;
+		int key_size;
+		hash_t hash;
 		TableEntryVal* current_tev;
 		IterCookie* c = loop_vals->InitForIteration();
-		while ( (current_tev = loop_vals->NextEntry(k, c)) )
+		while ( (current_tev = loop_vals->NextEntry(key, key_size, hash, c)) )
 			{
-			ListVal* ind_lv = tv->RecoverIndex(k);
-			delete k;
+			HashKey k(key, key_size, hash, true);
+			tv->RecoverIndex(&k, ind_vals.data());
 
 			if ( value_var )
 				f->SetElement(value_var, current_tev->Value()->Ref());
 
-			for ( int i = 0; i < ind_lv->Length(); i++ )
-				f->SetElement((*loop_vars)[i], ind_lv->Index(i)->Ref());
-			Unref(ind_lv);
+			for ( int i = 0; i < num_indices; i++ )
+				f->SetElement((*loop_vars)[i], ind_vals[i]);
 
 			flow = FLOW_NEXT;
-			ret = body->Exec(f, flow);
+
+			try
+				{
+				ret = body->Exec(f, flow);
+				}
+
+			catch ( InterpreterException& )
+				{
+				// A live cookie keeps the table from compacting
+				// its entries.
+				loop_vals->StopIteration(c);
+				throw;
+				}
 
 			if ( flow == FLOW_BREAK || flow == FLOW_RETURN )
 				{
@@ -1686,6 +1718,59 @@ TraversalCode NullStmt::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_STMT_POST(tc);
 	}
 
+// Collects the locals that a when statement's condition and bodies
+// reference, including those used by lambdas inside them.
+class WhenLocalsFinder : public TraversalCallback {
+public:
+	WhenLocalsFinder(id_list* arg_locals)
+		: locals(arg_locals), lambda_depth(0) { }
+
+	TraversalCode PreExpr(const Expr* expr) override;
+	TraversalCode PostExpr(const Expr* expr) override;
+
+private:
+	void Add(ID* id);
+
+	id_list* locals;
+	int lambda_depth;
+};
+
+void WhenLocalsFinder::Add(ID* id)
+	{
+	if ( id->IsGlobal() || locals->is_member(id) )
+		return;
+
+	::Ref(id);
+	locals->append(id);
+	}
+
+TraversalCode WhenLocalsFinder::PreExpr(const Expr* expr)
+	{
+	if ( expr->Tag() == EXPR_LAMBDA )
+		{
+		// The lambda's own locals live in its own frame; from ours
+		// it only takes what it captures.
+		if ( lambda_depth++ == 0 )
+			{
+			for ( const auto& id : static_cast<const LambdaExpr*>(expr)->OuterIDs() )
+				Add(id);
+			}
+		}
+
+	else if ( expr->Tag() == EXPR_NAME && lambda_depth == 0 )
+		Add(static_cast<const NameExpr*>(expr)->Id());
+
+	return TC_CONTINUE;
+	}
+
+TraversalCode WhenLocalsFinder::PostExpr(const Expr* expr)
+	{
+	if ( expr->Tag() == EXPR_LAMBDA )
+		--lambda_depth;
+
+	return TC_CONTINUE;
+	}
+
 WhenStmt::WhenStmt(Expr* arg_cond, Stmt* arg_s1, Stmt* arg_s2,
 			Expr* arg_timeout, bool arg_is_return)
 : Stmt(STMT_WHEN)
@@ -1702,6 +1787,13 @@ WhenStmt::WhenStmt(Expr* arg_cond, Stmt* arg_s1, Stmt* arg_s2,
 	if ( ! cond->IsError() && ! IsBool(cond->Type()->Tag()) )
 		cond->Error("conditional in test must be boolean");
 
+	WhenLocalsFinder cb(&locals);
+	cond->Traverse(&cb);
+	s1->Traverse(&cb);
+
+	if ( s2 )
+		s2->Traverse(&cb);
+
 	if ( timeout )
 		{
 		if ( timeout->IsError() )
@@ -1718,6 +1810,9 @@ WhenStmt::~WhenStmt()
 	Unref(cond);
 	Unref(s1);
 	Unref(s2);
+
+	for ( const auto& id : locals )
+		Unref(id);
 	}
 
 Val* WhenStmt::Exec(Frame* f, stmt_flow_type& flow) const
@@ -1733,7 +1828,7 @@ Val* WhenStmt::Exec(Frame* f, stmt_flow_type& flow) const
 		::Ref(timeout);
 
 	// The new trigger object will take care of its own deletion.
-	new Trigger(cond, s1, s2, timeout, f, is_return, location);
+	new Trigger(cond, s1, s2, timeout, f, &locals, is_return, location);
 
 	return 0;
 	}
@@ -54,7 +54,7 @@ public:
 
 	void RegisterAccess() const	{ last_access = network_time; access_count++; }
 	void AccessStats(ODesc* d) const;
-	uint32 GetAccessCount() const { return access_count; }
+	uint64 GetAccessCount() const { return access_count; }
 
 	void Describe(ODesc* d) const override;
 
@@ -83,7 +83,7 @@ protected:
 
 	// FIXME: Learn the exact semantics of mutable.
 	mutable double last_access;	// time of last execution
-	mutable uint32 access_count;	// number of executions
+	mutable uint64 access_count;	// number of executions
 };
 
 class ExprListStmt : public Stmt {
@@ -127,6 +127,9 @@ public:
 
 	const Expr* StmtExpr() const	{ return e; }
 
+	// Replaces the expression, taking ownership of the new one.
+	void SetStmtExpr(Expr* arg_e)	{ Unref(e); e = arg_e; }
+
 	void Describe(ODesc* d) const override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
@@ -288,6 +291,9 @@ public:
 	WhileStmt(Expr* loop_condition, Stmt* body);
 	~WhileStmt() override;
 
+	const Expr* Condition() const	{ return loop_condition; }
+	const Stmt* Body() const	{ return body; }
+
 	int IsPure() const override;
 
 	void Describe(ODesc* d) const override;
@@ -494,6 +500,10 @@ protected:
 	Stmt* s2;
 	Expr* timeout;
 	bool is_return;
+
+	// The locals that cond, s1 and s2 reference, which are all that
+	// triggers need to copy from the frame.
+	id_list locals;
 };
 
 #endif
@@ -5,12 +5,15 @@
 #include "util.h"
 #include "Timer.h"
 #include "Desc.h"
+#include "NetVar.h"
+#include "Net.h"
 #include "broker/Manager.h"
 
 // Names of timers in same order than in TimerType.
 const char* TimerNames[] = {
 	"BackdoorTimer",
 	"BreakpointTimer",
+	"CoalescedTimers",
 	"ConnectionDeleteTimer",
 	"ConnectionExpireTimer",
 	"ConnectionInactivityTimer",
@@ -21,6 +24,7 @@ const char* TimerNames[] = {
 	"FragTimer",
 	"InterconnTimer",
 	"IPTunnelInactivityTimer",
+	"LogAggregationTimer",
 	"NetbiosExpireTimer",
 	"NetWeirdTimer",
 	"NetworkTimer",
@@ -40,6 +44,8 @@ const char* TimerNames[] = {
 	"TimerMgrExpireTimer",
 };
 
+IMPLEMENT_OBJ_COUNTER(Timer)
+
 const char* timer_type_to_string(TimerType type)
 	{
 	return TimerNames[type];
@@ -73,6 +79,138 @@ int TimerMgr::Advance(double arg_t, int max_expire)
 	return DoAdvance(t, max_expire);
 	}
 
+// Whether timers of the given type may run somewhat late. These are
+// all re-checking state when they fire, and are numerous on busy
+// systems.
+static bool timer_type_tolerates_slack(TimerType type)
+	{
+	switch ( type ) {
+	case TIMER_CONN_INACTIVITY:
+	case TIMER_FILE_ANALYSIS_INACTIVITY:
+	case TIMER_IP_TUNNEL_INACTIVITY:
+	case TIMER_TCP_EXPIRE:
+		return true;
+
+	default:
+		return false;
+	}
+	}
+
+bool TimerMgr::Coalesce(Timer* timer)
+	{
+	double slack = BifConst::timer_coalescing_slack;
+
+	if ( slack <= 0.0 || ! timer_type_tolerates_slack(timer->Type()) )
+		return false;
+
+	double tt = timer->Time();
+
+	if ( tt <= t )
+		// Due right away anyway.
+		return false;
+
+	int64 index = int64(tt / slack);
+	TimerBucket* b = open_buckets[timer->Type()];
+
+	if ( b && index < b->index )
+		// Doesn't fit the order in which this type's timers are
+		// coming in, which is what we're optimizing for.
+		return false;
+
+	if ( ! b || index > b->index )
+		{
+		b = new TimerBucket(this, (index + 1) * slack, timer->Type(),
+					index);
+		open_buckets[timer->Type()] = b;
+		Add(b);
+		}
+
+	b->Append(timer);
+	++current_timers[timer->Type()];
+
+	return true;
+	}
+
+void TimerMgr::CancelCoalesced(Timer* timer)
+	{
+	TimerBucket* b = timer->bucket;
+	b->Unlink(timer);
+
+	--current_timers[timer->Type()];
+	delete timer;
+
+	if ( ! b->head && ! b->dispatching )
+		Remove(b);
+	}
+
+TimerBucket::TimerBucket(TimerMgr* arg_mgr, double t, TimerType arg_member_type,
+				int64 arg_index)
+	: Timer(t, TIMER_COALESCED)
+	{
+	mgr = arg_mgr;
+	member_type = arg_member_type;
+	index = arg_index;
+	head = tail = 0;
+	dispatching = false;
+	}
+
+TimerBucket::~TimerBucket()
+	{
+	if ( mgr->open_buckets[member_type] == this )
+		mgr->open_buckets[member_type] = 0;
+	}
+
+void TimerBucket::Append(Timer* timer)
+	{
+	timer->bucket = this;
+	timer->prev_in_slot = tail;
+	timer->next_in_slot = 0;
+
+	if ( tail )
+		tail->next_in_slot = timer;
+	else
+		head = timer;
+
+	tail = timer;
+	}
+
+void TimerBucket::Unlink(Timer* timer)
+	{
+	if ( timer->prev_in_slot )
+		timer->prev_in_slot->next_in_slot = timer->next_in_slot;
+	else
+		head = timer->next_in_slot;
+
+	if ( timer->next_in_slot )
+		timer->next_in_slot->prev_in_slot = timer->prev_in_slot;
+	else
+		tail = timer->prev_in_slot;
+
+	timer->prev_in_slot = timer->next_in_slot = 0;
+	timer->bucket = 0;
+	}
+
+void TimerBucket::Dispatch(double t, int is_expire)
+	{
+	// Timers added from now on go into a new bucket.
+	if ( mgr->open_buckets[member_type] == this )
+		mgr->open_buckets[member_type] = 0;
+
+	dispatching = true;
+
+	while ( head )
+		{
+		Timer* timer = head;
+		Unlink(timer);
+
+		DBG_LOG(DBG_TM, "Dispatching coalesced timer %s in TimeMgr %p",
+				timer_type_to_string(timer->Type()), mgr);
+		timer->Dispatch(t, is_expire);
+		--TimerMgr::current_timers[timer->Type()];
+		delete timer;
+		}
+	}
+
 
 PQ_TimerMgr::PQ_TimerMgr(const Tag& tag) : TimerMgr(tag)
 	{
@@ -86,6 +224,9 @@ PQ_TimerMgr::~PQ_TimerMgr()
 
 void PQ_TimerMgr::Add(Timer* timer)
 	{
+	if ( Coalesce(timer) )
+		return;
+
 	DBG_LOG(DBG_TM, "Adding timer %s to TimeMgr %p",
 			timer_type_to_string(timer->Type()), this);
 
@@ -115,7 +256,8 @@ int PQ_TimerMgr::DoAdvance(double new_t, int max_expire)
 	{
 	Timer* timer = Top();
 	for ( num_expired = 0; (num_expired < max_expire || max_expire == 0) &&
-		     timer && timer->Time() <= new_t; ++num_expired )
+		     timer && timer->Time() <= new_t &&
+		     ! net_work_budget_exceeded(); ++num_expired )
 		{
 		last_timestamp = timer->Time();
 		--current_timers[timer->Type()];
@@ -159,6 +301,9 @@ CQ_TimerMgr::~CQ_TimerMgr()
 
 void CQ_TimerMgr::Add(Timer* timer)
 	{
+	if ( Coalesce(timer) )
+		return;
+
 	DBG_LOG(DBG_TM, "Adding timer %s to TimeMgr %p",
 			timer_type_to_string(timer->Type()), this);
 
@@ -197,6 +342,7 @@ int CQ_TimerMgr::DoAdvance(double new_t, int max_expire)
 	{
 	Timer* timer;
 	while ( (num_expired < max_expire || max_expire == 0) &&
+		! net_work_budget_exceeded() &&
 		(timer = (Timer*) cq_dequeue(cq, new_t)) )
 		{
 		last_timestamp = timer->Time();
@@ -211,6 +357,270 @@ int CQ_TimerMgr::DoAdvance(double new_t, int max_expire)
 	return num_expired;
 	}
 
+// Granularity of the wheel, in seconds.
+static const double TW_RESOLUTION = 0.01;
+
+// Timers in a wheel have their offset set to a negative value encoding
+// the slot they are in; -1 means none, and offsets >= 0 are positions in
+// a PriorityQueue.
+static inline int tw_slot_offset(int level, int slot, int num_slots)
+	{
+	return -2 - (level * num_slots + slot);
+	}
+
+TW_TimerMgr::TW_TimerMgr(const Tag& tag) : TimerMgr(tag)
+	{
+	for ( int l = 0; l < NUM_LEVELS; ++l )
+		{
+		for ( int s = 0; s < NUM_SLOTS; ++s )
+			slots[l][s] = 0;
+
+		level_size[l] = 0;
+		}
+
+	num_in_wheel = 0;
+	now_tick = 0;
+	ready = new PriorityQueue;
+	peak_size = 0;
+	cumulative_num = 0;
+	}
+
+TW_TimerMgr::~TW_TimerMgr()
+	{
+	delete ready;
+	}
+
+int64 TW_TimerMgr::TickOf(double t) const
+	{
+	if ( t <= 0.0 )
+		return 0;
+
+	double tick = t / TW_RESOLUTION;
+
+	// Beyond any real time; keeps the conversion defined.
+	if ( tick > 1e18 )
+		return int64(1e18);
+
+	return int64(tick);
+	}
+
+void TW_TimerMgr::Add(Timer* timer)
+	{
+	if ( Coalesce(timer) )
+		return;
+
+	DBG_LOG(DBG_TM, "Adding timer %s to TimeMgr %p",
+			timer_type_to_string(timer->Type()), this);
+
+	if ( num_in_wheel == 0 )
+		{
+		// Nothing's pending in the wheel, so we can bring it up to
+		// the current time right away.
+		int64 cur = TickOf(t);
+
+		if ( cur > now_tick )
+			now_tick = cur;
+		}
+
+	Insert(timer);
+
+	++cumulative_num;
+	++current_timers[timer->Type()];
+
+	if ( Size() > peak_size )
+		peak_size = Size();
+	}
+
+void TW_TimerMgr::Insert(Timer* timer)
+	{
+	int64 tick = TickOf(timer->Time());
+
+	if ( tick <= now_tick )
+		{
+		if ( ! ready->Add(timer) )
+			reporter->InternalError("out of memory");
+
+		return;
+		}
+
+	int64 delta = tick - now_tick;
+	int level = 0;
+
+	while ( level < NUM_LEVELS - 1 &&
+		(delta >> (SLOT_BITS * (level + 1))) != 0 )
+		++level;
+
+	if ( (delta >> (SLOT_BITS * NUM_LEVELS)) != 0 )
+		// Too far out even for the coarsest wheel. Park it in the
+		// last slot it can reach; it gets refiled from there.
+		tick = now_tick + (int64(1) << (SLOT_BITS * NUM_LEVELS)) - 1;
+
+	int slot = (tick >> (SLOT_BITS * level)) & (NUM_SLOTS - 1);
+
+	timer->prev_in_slot = 0;
+	timer->next_in_slot = slots[level][slot];
+
+	if ( timer->next_in_slot )
+		timer->next_in_slot->prev_in_slot = timer;
+
+	slots[level][slot] = timer;
+	timer->SetOffset(tw_slot_offset(level, slot, NUM_SLOTS));
+
+	++level_size[level];
+	++num_in_wheel;
+	}
+
+void TW_TimerMgr::Unlink(Timer* timer)
+	{
+	int pos = -2 - timer->Offset();
+	int level = pos / NUM_SLOTS;
+	int slot = pos % NUM_SLOTS;
+
+	if ( timer->prev_in_slot )
+		timer->prev_in_slot->next_in_slot = timer->next_in_slot;
+	else
+		slots[level][slot] = timer->next_in_slot;
+
+	if ( timer->next_in_slot )
+		timer->next_in_slot->prev_in_slot = timer->prev_in_slot;
+
+	timer->prev_in_slot = timer->next_in_slot = 0;
+	timer->SetOffset(-1);
+
+	--level_size[level];
+	--num_in_wheel;
+	}
+
+void TW_TimerMgr::Cascade(int level, int slot)
+	{
+	Timer* timer = slots[level][slot];
+	slots[level][slot] = 0;
+
+	while ( timer )
+		{
+		Timer* next = timer->next_in_slot;
+
+		--level_size[level];
+		--num_in_wheel;
+		Insert(timer);
+
+		timer = next;
+		}
+	}
+
+void TW_TimerMgr::MoveTo(int64 tick)
+	{
+	now_tick = tick;
+
+	for ( int l = NUM_LEVELS - 1; l > 0; --l )
+		{
+		int64 span = int64(1) << (SLOT_BITS * l);
+
+		if ( tick % span == 0 )
+			Cascade(l, (tick >> (SLOT_BITS * l)) & (NUM_SLOTS - 1));
+		}
+
+	Cascade(0, tick & (NUM_SLOTS - 1));
+	}
+
+void TW_TimerMgr::Expire()
+	{
+	// Dispatching may add further timers, which we expire as well.
+	while ( num_in_wheel > 0 || ready->Size() > 0 )
+		{
+		for ( int l = 0; l < NUM_LEVELS; ++l )
+			for ( int s = 0; s < NUM_SLOTS; ++s )
+				while ( slots[l][s] )
+					{
+					Timer* timer = slots[l][s];
+					Unlink(timer);
+					ready->Add(timer);
+					}
+
+		Timer* timer;
+		while ( (timer = (Timer*) ready->Remove()) )
+			{
+			DBG_LOG(DBG_TM, "Dispatching timer %s in TimeMgr %p",
+					timer_type_to_string(timer->Type()), this);
+			timer->Dispatch(t, 1);
+			--current_timers[timer->Type()];
+			delete timer;
+			}
+		}
+	}
+
+int TW_TimerMgr::DoAdvance(double new_t, int max_expire)
+	{
+	int64 target = TickOf(new_t);
+
+	while ( now_tick < target )
+		{
+		if ( num_in_wheel == 0 )
+			{
+			now_tick = target;
+			break;
+			}
+
+		// Skip over ticks for which the finer wheels have nothing,
+		// up to the next time a coarser one needs refiling.
+		int level = 0;
+		while ( level_size[level] == 0 )
+			++level;
+
+		int64 span = int64(1) << (SLOT_BITS * level);
+		int64 next = (now_tick / span + 1) * span;
+
+		if ( next > target )
+			{
+			now_tick = target;
+			break;
+			}
+
+		MoveTo(next);
+		}
+
+	Timer* timer = (Timer*) ready->Top();
+	for ( num_expired = 0; (num_expired < max_expire || max_expire == 0) &&
+		     timer && timer->Time() <= new_t &&
+		     ! net_work_budget_exceeded(); ++num_expired )
+		{
+		last_timestamp = timer->Time();
+		--current_timers[timer->Type()];
+
+		// As with PQ_TimerMgr, remove it before dispatching.
+		(void) ready->Remove();
+
+		DBG_LOG(DBG_TM, "Dispatching timer %s in TimeMgr %p",
+				timer_type_to_string(timer->Type()), this);
+		timer->Dispatch(new_t, 0);
+		delete timer;
+
+		timer = (Timer*) ready->Top();
+		}
+
+	return num_expired;
+	}
+
+void TW_TimerMgr::Remove(Timer* timer)
+	{
+	// As with CQ_TimerMgr, a timer that's no longer with us (e.g.,
+	// because it's being dispatched) is left alone.
+	if ( timer->Offset() >= 0 )
+		{
+		if ( ! ready->Remove(timer) )
+			return;
+		}
+
+	else if ( timer->Offset() < -1 )
+		Unlink(timer);
+
+	else
+		return;
+
+	--current_timers[timer->Type()];
+	delete timer;
+	}
+
 unsigned int CQ_TimerMgr::MemoryUsage() const
 	{
 	// FIXME.
@@ -7,6 +7,7 @@
 
 #include <string>
 #include "PriorityQueue.h"
+#include "ObjCounter.h"
 
 extern "C" {
 #include "cq.h"
@@ -16,6 +17,7 @@ extern "C" {
 enum TimerType {
 	TIMER_BACKDOOR,
 	TIMER_BREAKPOINT,
+	TIMER_COALESCED,
 	TIMER_CONN_DELETE,
 	TIMER_CONN_EXPIRE,
 	TIMER_CONN_INACTIVITY,
@@ -26,6 +28,7 @@ enum TimerType {
 	TIMER_FRAG,
 	TIMER_INTERCONN,
 	TIMER_IP_TUNNEL_INACTIVITY,
+	TIMER_LOG_AGGREGATION,
 	TIMER_NB_EXPIRE,
 	TIMER_NET_WEIRD_EXPIRE,
 	TIMER_NETWORK,
@@ -49,11 +52,18 @@ const int NUM_TIMER_TYPES = int(TIMER_TIMERMGR_EXPIRE) + 1;
 extern const char* timer_type_to_string(TimerType type);
 
 class ODesc;
+class TimerBucket;
 
-class Timer : public PQ_Element {
+class Timer : public PQ_Element, CountedObj<Timer> {
 public:
+	DECLARE_OBJ_COUNTER()
+
 	Timer(double t, TimerType arg_type) : PQ_Element(t)
-		{ type = (char) arg_type; }
+		{
+		type = (char) arg_type;
+		prev_in_slot = next_in_slot = 0;
+		bucket = 0;
+		}
 	~Timer() override { }
 
 	TimerType Type() const	{ return (TimerType) type; }
@@ -66,9 +76,21 @@ public:
 	void Describe(ODesc* d) const;
 
 protected:
-	Timer()	{}
+	friend class TW_TimerMgr;
+	friend class TimerBucket;
+	friend class TimerMgr;
+
+	Timer()	{ prev_in_slot = next_in_slot = 0; bucket = 0; }
 
 	unsigned int type:8;
+
+	// Links within the slot of a TW_TimerMgr, or the TimerBucket,
+	// holding the timer.
+	Timer* prev_in_slot;
+	Timer* next_in_slot;
+
+	// If coalesced, the bucket the timer is in.
+	TimerBucket* bucket;
 };
 
 class TimerMgr {
@@ -93,7 +115,13 @@ public:
 	// timer schemes we have wound up separating timer cancelation
 	// from removing it from the manager's data structures, because
 	// the manager lacked an efficient way to find it.
-	void Cancel(Timer* timer)	{ Remove(timer); }
+	void Cancel(Timer* timer)
+		{
+		if ( timer->bucket )
+			CancelCoalesced(timer);
+		else
+			Remove(timer);
+		}
 
 	double Time() const		{ return t ? t : 1; }	// 1 > 0
 
@@ -111,17 +139,34 @@ public:
 	static unsigned int* CurrentTimers()	{ return current_timers; }
 
 protected:
+	friend class TimerBucket;
+
 	explicit TimerMgr(const Tag& arg_tag)
  		{
  		t = 0.0;
  		num_expired = 0;
  		last_advance = last_timestamp = 0;
  		tag = arg_tag;
+
+		for ( int i = 0; i < NUM_TIMER_TYPES; ++i )
+			open_buckets[i] = 0;
  		}
 
 	virtual int DoAdvance(double t, int max_expire) = 0;
 	virtual void Remove(Timer* timer) = 0;
 
+	// To be called first thing by Add(). If timer_coalescing_slack is
+	// set and the timer's type tolerates running late, files the timer
+	// into a TimerBucket with others of its type expiring around the
+	// same time and returns true; the bucket is what then gets added.
+	bool Coalesce(Timer* timer);
+
+	void CancelCoalesced(Timer* timer);
+
+	// Per timer type, the bucket new timers of that type go into if
+	// they expire within its interval.
+	TimerBucket* open_buckets[NUM_TIMER_TYPES];
+
 	double t;
 	double last_timestamp;
 	double last_advance;
@@ -132,6 +177,32 @@ protected:
 	static unsigned int current_timers[NUM_TIMER_TYPES];
 };
 
+// A group of timers of the same type which get dispatched together, at
+// the end of the slack interval they expire in. Only the manager creates
+// these.
+class TimerBucket : public Timer {
+public:
+	TimerBucket(TimerMgr* mgr, double t, TimerType member_type,
+			int64 index);
+	~TimerBucket() override;
+
+	void Dispatch(double t, int is_expire) override;
+
+protected:
+	friend class TimerMgr;
+
+	void Append(Timer* timer);
+	void Unlink(Timer* timer);
+
+	TimerMgr* mgr;
+	TimerType member_type;
+	int64 index;	// expiration time divided by the slack
+
+	Timer* head;
+	Timer* tail;
+	bool dispatching;
+};
+
 class PQ_TimerMgr : public TimerMgr {
 public:
 	explicit PQ_TimerMgr(const Tag& arg_tag);
@@ -174,6 +245,60 @@ protected:
 	struct cq_handle *cq;
 };
 
+// A hierarchical timing wheel. Timers are filed into slots by the tick
+// at which they expire, with coarser wheels for the more distant future;
+// as time approaches one of their slots, its timers are distributed into
+// the finer wheels. Adding and canceling a timer thus take constant
+// time. Timers that have come due wait in a priority queue, so that they
+// are still dispatched in exact time order.
+class TW_TimerMgr : public TimerMgr {
+public:
+	explicit TW_TimerMgr(const Tag& arg_tag);
+	~TW_TimerMgr() override;
+
+	void Add(Timer* timer) override;
+	void Expire() override;
+
+	int Size() const override { return num_in_wheel + ready->Size(); }
+	int PeakSize() const override { return peak_size; }
+	uint64 CumulativeNum() const override { return cumulative_num; }
+
+protected:
+	int DoAdvance(double t, int max_expire) override;
+	void Remove(Timer* timer) override;
+
+	static const int SLOT_BITS = 8;
+	static const int NUM_SLOTS = 1 << SLOT_BITS;
+	static const int NUM_LEVELS = 4;
+
+	int64 TickOf(double t) const;
+
+	// Files the timer into the wheel, or into the ready queue if its
+	// tick has already been reached.
+	void Insert(Timer* timer);
+
+	void Unlink(Timer* timer);
+
+	// Refiles all timers of the given slot.
+	void Cascade(int level, int slot);
+
+	// Moves the clock forward to the given tick, which must not lie
+	// beyond the next tick having work to do.
+	void MoveTo(int64 tick);
+
+	Timer* slots[NUM_LEVELS][NUM_SLOTS];
+	int level_size[NUM_LEVELS];
+	int num_in_wheel;
+
+	// All timers for this and earlier ticks are in the ready queue.
+	int64 now_tick;
+
+	PriorityQueue* ready;
+
+	int peak_size;
+	uint64 cumulative_num;
+};
+
 extern TimerMgr* timer_mgr;
 
 #endif
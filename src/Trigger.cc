@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <set>
 
 #include "Trigger.h"
 #include "Traverse.h"
@@ -18,6 +19,10 @@ public:
 
 private:
 	Trigger* trigger;
+
+	// Operands of which the condition only accesses individual
+	// elements. We see them after the expression accessing them.
+	std::set<const Expr*> element_accesses;
 };
 
 TraversalCode TriggerTraversalCallback::PreExpr(const Expr* expr)
@@ -32,15 +37,37 @@ TraversalCode TriggerTraversalCallback::PreExpr(const Expr* expr)
 		if ( e->Id()->IsGlobal() )
 			trigger->Register(e->Id());
 
+		// If the condition only accesses elements of the value,
+		// evaluating it has already registered for those it read.
+		if ( element_accesses.find(e) != element_accesses.end() )
+			break;
+
 		Val* v = e->Id()->ID_Val();
 		if ( v && v->Modifiable() )
 			trigger->Register(v);
 		break;
 		};
 
+	case EXPR_FIELD:
+	case EXPR_HAS_FIELD:
+		{
+		const UnaryExpr* e = static_cast<const UnaryExpr*>(expr);
+		element_accesses.insert(e->Op());
+		break;
+		}
+
+	case EXPR_IN:
+		{
+		const BinaryExpr* e = static_cast<const BinaryExpr*>(expr);
+		element_accesses.insert(e->Op2());
+		break;
+		}
+
 	case EXPR_INDEX:
 		{
 		const IndexExpr* e = static_cast<const IndexExpr*>(expr);
+		element_accesses.insert(e->Op1());
+
 		BroObj::SuppressErrors no_errors;
 
 		try
@@ -104,7 +131,8 @@ protected:
 
 Trigger::Trigger(Expr* arg_cond, Stmt* arg_body, Stmt* arg_timeout_stmts,
 			Expr* arg_timeout, Frame* arg_frame,
-			bool arg_is_return, const Location* arg_location)
+			const id_list* arg_locals, bool arg_is_return,
+			const Location* arg_location)
 	{
 	if ( ! pending )
 		pending = new list<Trigger*>;
@@ -113,7 +141,8 @@ Trigger::Trigger(Expr* arg_cond, Stmt* arg_body, Stmt* arg_timeout_stmts,
 	body = arg_body;
 	timeout_stmts = arg_timeout_stmts;
 	timeout = arg_timeout;
-	frame = arg_frame->Clone();
+	locals = arg_locals;
+	frame = arg_frame->CloneLocals(*locals);
 	timer = 0;
 	delayed = false;
 	disabled = false;
@@ -189,12 +218,12 @@ Trigger::~Trigger()
 void Trigger::Init()
 	{
 	assert(! disabled);
-	UnregisterAll();
 	TriggerTraversalCallback cb(this);
 	cond->Traverse(&cb);
 	}
 
 Trigger::TriggerList* Trigger::pending = 0;
+Trigger* Trigger::reading = 0;
 unsigned long Trigger::total_triggers = 0;
 
 bool Trigger::Eval()
@@ -221,6 +250,14 @@ bool Trigger::Eval()
 	Frame* f = frame->Clone();
 	f->SetTrigger(this);
 
+	// Evaluating the condition registers for the table entries and
+	// record fields it reads; Init() then adds everything else it
+	// references.
+	UnregisterAll();
+
+	Trigger* prev_reading = reading;
+	reading = this;
+
 	Val* v = nullptr;
 
 	try
@@ -230,6 +267,7 @@ bool Trigger::Eval()
 	catch ( InterpreterException& )
 		{ /* Already reported */ }
 
+	reading = prev_reading;
 	f->ClearTrigger();
 
 	if ( f->HasDelayed() )
@@ -237,6 +275,7 @@ bool Trigger::Eval()
 		DBG_LOG(DBG_NOTIFIERS, "%s: eval has delayed", Name());
 		assert(!v);
 		Unref(f);
+		Init();
 		return false;
 		}
 
@@ -382,10 +421,12 @@ void Trigger::Timeout()
 void Trigger::Register(ID* id)
 	{
 	assert(! disabled);
-	notifier::registry.Register(id, this);
 
+	if ( ! objs.insert({Registration(id, false, 0), id}).second )
+		return;
+
+	notifier::registry.Register(id, this);
 	Ref(id);
-	objs.push_back({id, id});
 	}
 
 void Trigger::Register(Val* val)
@@ -394,10 +435,55 @@ void Trigger::Register(Val* val)
 		return;
 
 	assert(! disabled);
+
+	if ( ! objs.insert({Registration(val->Modifiable(), false, 0), val}).second )
+		return;
+
 	notifier::registry.Register(val->Modifiable(), this);
+	Ref(val);
+	}
 
+void Trigger::RegisterElement(Val* val, uint64 key)
+	{
+	assert(! disabled);
+
+	notifier::Modifiable* m = val->Modifiable();
+
+	// Nothing to add if we're watching the whole value already.
+	if ( objs.find(Registration(m, false, 0)) != objs.end() )
+		return;
+
+	if ( ! objs.insert({Registration(m, true, key), val}).second )
+		return;
+
+	notifier::registry.Register(m, key, this);
 	Ref(val);
-	objs.emplace_back(val, val->Modifiable());
+	}
+
+void Trigger::RegisterTableRead(TableVal* t, const Val* index)
+	{
+	// Lookups in subnet tables may return entries for any covering
+	// prefix, so they depend on more than the one entry.
+	if ( t->Subnets() )
+		{
+		Register(t);
+		return;
+		}
+
+	// The keys are the entries' hash values, the same that the table
+	// reports modifications with.
+	HashKey* k = t->ComputeHash(index);
+
+	if ( ! k )
+		return;
+
+	RegisterElement(t, k->Hash());
+	delete k;
+	}
+
+void Trigger::RegisterFieldRead(RecordVal* r, int field)
+	{
+	RegisterElement(r, field);
 	}
 
 void Trigger::UnregisterAll()
@@ -406,8 +492,14 @@ void Trigger::UnregisterAll()
 
 	for ( const auto& o : objs )
 		{
-		notifier::registry.Unregister(o.second, this);
-		Unref(o.first);
+		notifier::Modifiable* m = std::get<0>(o.first);
+
+		if ( std::get<1>(o.first) )
+			notifier::registry.Unregister(m, std::get<2>(o.first), this);
+		else
+			notifier::registry.Unregister(m, this);
+
+		Unref(o.second);
 		}
 
 	objs.clear();
@@ -3,6 +3,7 @@
 
 #include <list>
 #include <map>
+#include <tuple>
 
 #include "Notifier.h"
 #include "Traverse.h"
@@ -12,15 +13,19 @@
 
 class TriggerTimer;
 class TriggerTraversalCallback;
+class TableVal;
+class RecordVal;
 
 class Trigger : public BroObj, public notifier::Receiver {
 public:
 	// Don't access Trigger objects; they take care of themselves after
 	// instantiation.  Note that if the condition is already true, the
 	// statements are executed immediately and the object is deleted
-	// right away.
+	// right away. Of the frame, only the values of the given locals get
+	// copied, the ones that the statements may reference.
 	Trigger(Expr* cond, Stmt* body, Stmt* timeout_stmts, Expr* timeout,
-		Frame* f, bool is_return, const Location* loc);
+		Frame* f, const id_list* locals, bool is_return,
+		const Location* loc);
 	~Trigger() override;
 
 	// Evaluates the condition. If true, executes the body and deletes
@@ -78,6 +83,29 @@ public:
 
 	static void GetStats(Stats* stats);
 
+	// Called by expressions when reading an entry of a table or a
+	// field of a record, so that a trigger whose condition is being
+	// evaluated only watches for changes to what it has looked at.
+	static void TableRead(TableVal* t, const Val* index)
+		{
+		if ( reading )
+			reading->RegisterTableRead(t, index);
+		}
+
+	static void FieldRead(RecordVal* r, int field)
+		{
+		if ( reading )
+			reading->RegisterFieldRead(r, field);
+		}
+
+	// Like TableRead(), for reads that may depend on any part of the
+	// given value.
+	static void ValueRead(Val* v)
+		{
+		if ( reading )
+			reading->Register(v);
+		}
+
 private:
 	friend class TriggerTraversalCallback;
 	friend class TriggerTimer;
@@ -85,6 +113,9 @@ private:
 	void Init();
 	void Register(ID* id);
 	void Register(Val* val);
+	void RegisterElement(Val* val, uint64 key);
+	void RegisterTableRead(TableVal* t, const Val* index);
+	void RegisterFieldRead(RecordVal* r, int field);
 	void UnregisterAll();
 
 	Expr* cond;
@@ -93,6 +124,7 @@ private:
 	Expr* timeout;
 	double timeout_value;
 	Frame* frame;
+	const id_list* locals;
 	bool is_return;
 	const Location* location;
 
@@ -102,7 +134,14 @@ private:
 	bool delayed; // true if a function call is currently being delayed
 	bool disabled;
 
-	std::vector<std::pair<BroObj *, notifier::Modifiable*>> objs;
+	// What we have registered for, each with a reference to the object
+	// owning the Modifiable. The flag tells whether the registration is
+	// for just the element with the given key.
+	typedef std::tuple<notifier::Modifiable*, bool, uint64> Registration;
+	std::map<Registration, BroObj*> objs;
+
+	// The trigger whose condition is currently being evaluated, if any.
+	static Trigger* reading;
 
 	typedef map<const CallExpr*, Val*> ValCache;
 	ValCache cache;
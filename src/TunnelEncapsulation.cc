@@ -35,18 +35,17 @@ RecordVal* EncapsulatingConn::GetRecordVal() const
 
 bool operator==(const EncapsulationStack& e1, const EncapsulationStack& e2)
 	{
-	if ( ! e1.conns )
-		return e2.conns;
-
-	if ( ! e2.conns )
+	if ( e1.Depth() != e2.Depth() )
 		return false;
 
-	if ( e1.conns->size() != e2.conns->size() )
-		return false;
+	const EncapsulationStack::Layer* l1 = e1.inner;
+	const EncapsulationStack::Layer* l2 = e2.inner;
 
-	for ( size_t i = 0; i < e1.conns->size(); ++i )
+	// Stacks derived from one another share their outer layers, so we
+	// can stop as soon as we reach a common one.
+	for ( ; l1 != l2; l1 = l1->outer, l2 = l2->outer )
 		{
-		if ( (*e1.conns)[i] != (*e2.conns)[i] )
+		if ( l1->conn != l2->conn )
 			return false;
 		}
 
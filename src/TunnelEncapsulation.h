@@ -128,45 +128,54 @@ protected:
  */
 class EncapsulationStack {
 public:
-	EncapsulationStack() : conns(0)
+	EncapsulationStack() : inner(0)
 		{}
 
+	/**
+	 * Copies share all the layers of the original; no tunnel information
+	 * gets duplicated.
+	 */
 	EncapsulationStack(const EncapsulationStack& other)
 		{
-		if ( other.conns )
-			conns = new vector<EncapsulatingConn>(*(other.conns));
-		else
-			conns = 0;
+		inner = other.inner;
+		Ref(inner);
 		}
 
-	EncapsulationStack& operator=(const EncapsulationStack& other)
+	/**
+	 * Creates a stack consisting of the layers of an existing one plus a
+	 * new inner-most tunnel. The existing stack remains unchanged and
+	 * shares its layers with the new one.
+	 *
+	 * @param outer The enclosing stack, or null if there's none.
+	 *
+	 * @param c The new inner-most tunnel.
+	 */
+	EncapsulationStack(const EncapsulationStack* outer, const EncapsulatingConn& c)
 		{
-		if ( this == &other )
-			return *this;
-
-		delete conns;
-
-		if ( other.conns )
-			conns = new vector<EncapsulatingConn>(*(other.conns));
-		else
-			conns = 0;
+		inner = new Layer(outer ? outer->inner : 0, c);
+		}
 
+	EncapsulationStack& operator=(const EncapsulationStack& other)
+		{
+		Ref(other.inner);
+		Unref(inner);
+		inner = other.inner;
 		return *this;
 		}
 
-	~EncapsulationStack() { delete conns; }
+	~EncapsulationStack() { Unref(inner); }
 
 	/**
-	 * Add a new inner-most tunnel to the EncapsulationStack.
+	 * Add a new inner-most tunnel to the EncapsulationStack. Other stacks
+	 * sharing layers with this one are not affected.
 	 *
 	 * @param c The new inner-most tunnel to append to the tunnel chain.
 	 */
 	void Add(const EncapsulatingConn& c)
 		{
-		if ( ! conns )
-			conns = new vector<EncapsulatingConn>();
-
-		conns->push_back(c);
+		Layer* l = new Layer(inner, c);
+		Unref(inner);
+		inner = l;
 		}
 
 	/**
@@ -175,7 +184,7 @@ public:
 	 */
 	size_t Depth() const
 		{
-		return conns ? conns->size() : 0;
+		return inner ? inner->depth : 0;
 		}
 
 	/**
@@ -183,7 +192,7 @@ public:
 	 */
 	BifEnum::Tunnel::Type LastType() const
 		{
-		return conns ? (*conns)[conns->size()-1].Type() : BifEnum::Tunnel::NONE;
+		return inner ? inner->conn.Type() : BifEnum::Tunnel::NONE;
 		}
 
 	/**
@@ -192,14 +201,12 @@ public:
 	 */
 	VectorVal* GetVectorVal() const
 		{
-		VectorVal* vv = new VectorVal(
-		    internal_type("EncapsulatingConnVector")->AsVectorType());
+		VectorVal* vv = new VectorVal(encapsulating_conn_vector);
 
-		if ( conns )
-			{
-			for ( size_t i = 0; i < conns->size(); ++i )
-				vv->Assign(i, (*conns)[i].GetRecordVal());
-			}
+		// We walk from the inside out, but the vector starts with the
+		// outer-most tunnel.
+		for ( const Layer* l = inner; l; l = l->outer )
+			vv->Assign(l->depth - 1, l->conn.GetRecordVal());
 
 		return vv;
 		}
@@ -214,7 +221,44 @@ public:
 		}
 
 protected:
-	vector<EncapsulatingConn>* conns;
+	// One level of encapsulation. Layers are immutable once created and
+	// are shared by all stacks containing them, each of which holds a
+	// reference to its inner-most layer.
+	struct Layer {
+		Layer(const Layer* arg_outer, const EncapsulatingConn& c)
+			: ref_cnt(1), outer(arg_outer), conn(c)
+			{
+			depth = outer ? outer->depth + 1 : 1;
+			Ref(outer);
+			}
+
+		~Layer()	{ Unref(outer); }
+
+		mutable int ref_cnt;
+		const Layer* outer;
+		EncapsulatingConn conn;
+		size_t depth;
+	};
+
+	static void Ref(const Layer* l)
+		{
+		if ( l )
+			++l->ref_cnt;
+		}
+
+	static void Unref(const Layer* l)
+		{
+		// Release iteratively, so that deep chains don't recurse.
+		while ( l && --l->ref_cnt == 0 )
+			{
+			const Layer* outer = l->outer;
+			const_cast<Layer*>(l)->outer = 0;
+			delete l;
+			l = outer;
+			}
+		}
+
+	const Layer* inner;
 };
 
 #endif
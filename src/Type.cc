@@ -7,6 +7,7 @@
 #include "Expr.h"
 #include "Scope.h"
 #include "Reporter.h"
+#include "Net.h"
 #include "zeekygen/Manager.h"
 #include "zeekygen/utils.h"
 
@@ -283,6 +284,12 @@ int IndexType::MatchesIndex(ListExpr*& index) const
 	     exprs.length() == 1 && exprs[0]->Type()->Tag() == TYPE_ADDR )
 		return MATCHES_INDEX_SCALAR;
 
+	// Indexing a table of patterns with a string yields all the values
+	// whose pattern matches.
+	if ( yield_type && IsPatternIndex() &&
+	     exprs.length() == 1 && exprs[0]->Type()->Tag() == TYPE_STRING )
+		return MATCHES_INDEX_VECTOR;
+
 	return check_and_promote_exprs(index, Indices()) ?
 			MATCHES_INDEX_SCALAR : DOES_NOT_MATCH_INDEX;
 	}
@@ -373,6 +380,12 @@ bool IndexType::IsSubNetIndex() const
 	return false;
 	}
 
+bool IndexType::IsPatternIndex() const
+	{
+	const type_list* types = indices->Types();
+	return types->length() == 1 && (*types)[0]->Tag() == TYPE_PATTERN;
+	}
+
 TableType::TableType(TypeList* ind, BroType* yield)
 : IndexType(TYPE_TABLE, ind, yield)
 	{
@@ -706,6 +719,7 @@ RecordType::RecordType(type_decl_list* arg_types) : BroType(TYPE_RECORD)
 	{
 	types = arg_types;
 	num_fields = types ? types->length() : 0;
+	field_inits = 0;
 	}
 
 // in this case the clone is actually not so shallow, since
@@ -720,6 +734,8 @@ RecordType* RecordType::ShallowClone()
 
 RecordType::~RecordType()
 	{
+	ClearFieldInits();
+
 	if ( types )
 		{
 		for ( auto type : *types )
@@ -859,9 +875,68 @@ const char* RecordType::AddFields(type_decl_list* others, attr_list* attr)
 	delete others;
 
 	num_fields = types->length();
+	ClearFieldInits();
 	return 0;
 	}
 
+const std::vector<RecordType::FieldInit>* RecordType::FieldInits() const
+	{
+	if ( field_inits )
+		return field_inits;
+
+	if ( is_parsing )
+		return 0;
+
+	field_inits = new std::vector<FieldInit>(num_fields);
+
+	for ( int i = 0; i < num_fields; ++i )
+		{
+		const TypeDecl* fd = FieldDecl(i);
+		const Attributes* a = fd->attrs;
+		Attr* def_attr = a ? a->FindAttr(ATTR_DEFAULT) : 0;
+		FieldInit& fi = (*field_inits)[i];
+
+		fi.per_instance = false;
+		fi.val = 0;
+
+		if ( def_attr )
+			{
+			// Constants of atomic type are immutable, so all
+			// instances can share them.
+			Expr* e = def_attr->AttrExpr();
+
+			if ( e->Tag() == EXPR_CONST && is_atomic_type(fd->type) &&
+			     is_atomic_type(e->Type()) )
+				fi.val = e->Eval(0);
+			else
+				fi.per_instance = true;
+			}
+
+		else if ( ! (a && a->FindAttr(ATTR_OPTIONAL)) )
+			{
+			TypeTag tag = fd->type->Tag();
+
+			if ( tag == TYPE_RECORD || tag == TYPE_TABLE ||
+			     tag == TYPE_VECTOR )
+				fi.per_instance = true;
+			}
+		}
+
+	return field_inits;
+	}
+
+void RecordType::ClearFieldInits() const
+	{
+	if ( ! field_inits )
+		return;
+
+	for ( const auto& fi : *field_inits )
+		Unref(fi.val);
+
+	delete field_inits;
+	field_inits = 0;
+	}
+
 void RecordType::DescribeFields(ODesc* d) const
 	{
 	if ( d->IsReadable() )
@@ -8,6 +8,7 @@
 #include <unordered_map>
 #include <map>
 #include <list>
+#include <vector>
 
 #include "Obj.h"
 #include "Attr.h"
@@ -346,6 +347,9 @@ public:
 	// Returns true if this table is solely indexed by subnet.
 	bool IsSubNetIndex() const;
 
+	// Returns true if this table is solely indexed by pattern.
+	bool IsPatternIndex() const;
+
 protected:
 	IndexType(){ indices = 0; yield_type = 0; }
 	IndexType(TypeTag t, TypeList* arg_indices, BroType* arg_yield_type) :
@@ -501,11 +505,32 @@ public:
 
 	string GetFieldDeprecationWarning(int field, bool has_check) const;
 
+	// How a field of a new instance gets initialized.
+	struct FieldInit {
+		// If true, the initial value needs to be set up anew for each
+		// instance from the field's attributes, as it's an aggregate
+		// or depends on evaluating an expression.
+		bool per_instance;
+
+		// Otherwise, the value all instances start out with; nil if
+		// none.
+		Val* val;
+	};
+
+	// Returns how the fields of new instances get initialized, one
+	// entry per field. Computed once and then kept, except that it
+	// returns nil while scripts are still being parsed, as the type
+	// may still change.
+	const std::vector<FieldInit>* FieldInits() const;
+
 protected:
-	RecordType() { types = 0; }
+	RecordType() { types = 0; field_inits = 0; }
+
+	void ClearFieldInits() const;
 
 	int num_fields;
 	type_decl_list* types;
+	mutable std::vector<FieldInit>* field_inits;
 };
 
 class SubNetType : public BroType {
@@ -631,10 +656,14 @@ extern OpaqueType* sha256_type;
 extern OpaqueType* entropy_type;
 extern OpaqueType* cardinality_type;
 extern OpaqueType* topk_type;
+extern OpaqueType* countmin_type;
 extern OpaqueType* bloomfilter_type;
 extern OpaqueType* x509_opaque_type;
 extern OpaqueType* ocsp_resp_opaque_type;
 extern OpaqueType* paraglob_type;
+extern OpaqueType* stream_matcher_type;
+extern OpaqueType* intel_index_type;
+extern OpaqueType* aggregator_type;
 
 // Returns the Bro basic (non-parameterized) type with the given type.
 // The reference count of the type is not increased.
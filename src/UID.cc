@@ -1,6 +1,7 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
 #include <cstdlib>
+#include <algorithm>
 
 #include "UID.h"
 
@@ -20,9 +21,69 @@ void UID::Set(bro_uint_t bits, const uint64* v, size_t n)
 	div_t res = div(bits, 64);
 	size_t size = res.rem ? res.quot + 1 : res.quot;
 
-	for ( size_t i = 0; i < size; ++i )
-		uid[i] = v && i < n ? v[i] : calculate_unique_id();
+	size_t given = v ? std::min(n, size) : 0;
+
+	for ( size_t i = 0; i < given; ++i )
+		uid[i] = v[i];
+
+	if ( given < size )
+		calculate_unique_ids(uid + given, size - given);
 
 	if ( res.rem )
 		uid[0] >>= 64 - res.rem;
 	}
+
+namespace {
+
+const char base62_digits[] =
+	"0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+// Pairs of digits for all values below 62^2, least significant first,
+// so that conversion needs half as many divisions.
+struct Base62Pairs {
+	Base62Pairs()
+		{
+		for ( int i = 0; i < 62 * 62; ++i )
+			{
+			pairs[i][0] = base62_digits[i % 62];
+			pairs[i][1] = base62_digits[i / 62];
+			}
+		}
+
+	char pairs[62 * 62][2];
+};
+
+const Base62Pairs base62_pairs;
+
+}
+
+string UID::Base62(string prefix) const
+	{
+	if ( ! initialized )
+		reporter->InternalError("use of uninitialized UID");
+
+	// Produces the same digits as uitoa_n(), least significant first,
+	// with the divisors known at compile time.
+	char tmp[BRO_UID_LEN * 12];
+	char* p = tmp;
+
+	for ( size_t i = 0; i < BRO_UID_LEN; ++i )
+		{
+		uint64 v = uid[i];
+
+		while ( v >= 62 * 62 )
+			{
+			memcpy(p, base62_pairs.pairs[v % (62 * 62)], 2);
+			p += 2;
+			v /= 62 * 62;
+			}
+
+		*p++ = base62_digits[v % 62];
+
+		if ( v >= 62 )
+			*p++ = base62_digits[v / 62];
+		}
+
+	prefix.append(tmp, p - tmp);
+	return prefix;
+	}
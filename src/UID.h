@@ -56,6 +56,13 @@ public:
 	 */
 	std::string Base62(std::string prefix = "") const;
 
+	/**
+	 * @return the BRO_UID_LEN values making up the UID, from which
+	 *         Set() can recreate it.
+	 */
+	const uint64* Values() const
+		{ return uid; }
+
 	/**
 	 * @return false if the UID instance was created via the default ctor
 	 *         and not yet initialized w/ Set().
@@ -98,18 +105,6 @@ inline UID& UID::operator=(const UID& other)
 	return *this;
 	}
 
-inline std::string UID::Base62(std::string prefix) const
-	{
-	if ( ! initialized )
-		reporter->InternalError("use of uninitialized UID");
-
-	char tmp[sizeof(uid) * 8 + 1];  // enough for even binary representation
-	for ( size_t i = 0; i < BRO_UID_LEN; ++i )
-		prefix.append(uitoa_n(uid[i], tmp, sizeof(tmp), 62));
-
-	return prefix;
-	}
-
 } // namespace Bro
 
 #endif
@@ -11,6 +11,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 
 #include "Val.h"
 #include "Net.h"
@@ -63,6 +64,8 @@ Val::Val(BroFile* f)
 #endif
 	}
 
+IMPLEMENT_POOLED_ALLOC(Val, OTHER)
+
 Val::~Val()
 	{
 	if ( type->InternalType() == TYPE_INTERNAL_STRING )
@@ -968,6 +971,8 @@ Val* SubNetVal::DoClone(CloneState* state)
 	return Ref();
 	}
 
+IMPLEMENT_OBJ_COUNTER(StringVal)
+
 StringVal::StringVal(BroString* s) : Val(TYPE_STRING)
 	{
 	val.string_val = s;
@@ -1169,6 +1174,8 @@ Val* PatternVal::DoClone(CloneState* state)
 	return state->NewClone(this, new PatternVal(re));
 	}
 
+IMPLEMENT_OBJ_COUNTER(ListVal)
+
 ListVal::ListVal(TypeTag t)
 : Val(new TypeList(t == TYPE_ANY ? 0 : base_type_no_ref(t)))
 	{
@@ -1293,6 +1300,85 @@ void TableValTimer::Dispatch(double t, int is_expire)
 		}
 	}
 
+// Matches strings against all the patterns indexing a table at once. The
+// patterns get compiled into a single set matcher when first needed; any
+// change to the table discards it.
+class TablePatternMatcher {
+public:
+	explicit TablePatternMatcher(TableVal* arg_tbl)
+		{ tbl = arg_tbl; re = 0; }
+	~TablePatternMatcher()	{ Clear(); }
+
+	void Clear();
+
+	// Adds the indices (as ListVals, not Ref()'d) of all matching
+	// entries to matches.
+	void Lookup(const StringVal* s, std::vector<ListVal*>& matches);
+
+private:
+	void Build();
+
+	TableVal* tbl;
+	RE_Matcher* re;
+
+	// Table indices, indexed by the accept index of their pattern.
+	std::vector<ListVal*> indices;
+};
+
+void TablePatternMatcher::Clear()
+	{
+	delete re;
+	re = 0;
+
+	for ( auto i : indices )
+		Unref(i);
+
+	indices.clear();
+	}
+
+void TablePatternMatcher::Build()
+	{
+	const PDict<TableEntryVal>* t = tbl->AsTable();
+	IterCookie* c = t->InitForIteration();
+
+	string_list patterns;
+	int_list ids;
+
+	HashKey* k;
+	while ( t->NextEntry(k, c) )
+		{
+		ListVal* index = tbl->RecoverIndex(k);
+		delete k;
+
+		const char* text = index->Index(0)->AsPattern()->PatternText();
+		patterns.push_back(const_cast<char*>(text));
+		ids.push_back(indices.size());
+		indices.push_back(index);
+		}
+
+	re = new RE_Matcher();
+
+	if ( ! re->CompileSet(patterns, ids) )
+		reporter->InternalError("failed to compile patterns of table");
+	}
+
+void TablePatternMatcher::Lookup(const StringVal* s, std::vector<ListVal*>& matches)
+	{
+	if ( ! re )
+		Build();
+
+	if ( indices.empty() )
+		return;
+
+	std::vector<AcceptIdx> accepted;
+
+	if ( ! re->MatchSet(s->AsString(), accepted) )
+		return;
+
+	for ( auto a : accepted )
+		matches.push_back(indices[a]);
+	}
+
 static void table_entry_val_delete_func(void* val)
 	{
 	TableEntryVal* tv = (TableEntryVal*) val;
@@ -1300,6 +1386,8 @@ static void table_entry_val_delete_func(void* val)
 	delete tv;
 	}
 
+IMPLEMENT_OBJ_COUNTER(TableVal)
+
 TableVal::TableVal(TableType* t, Attributes* a) : Val(t)
 	{
 	Init(t);
@@ -1312,7 +1400,9 @@ void TableVal::Init(TableType* t)
 	table_type = t;
 	expire_func = 0;
 	expire_time = 0;
-	expire_cookie = 0;
+	expire_buckets = 0;
+	expire_removed_keys = 0;
+	expire_buckets_timeout = 0;
 	timer = 0;
 	def_val = 0;
 
@@ -1321,6 +1411,11 @@ void TableVal::Init(TableType* t)
 	else
 		subnets = 0;
 
+	if ( t->IsPatternIndex() )
+		pattern_matcher = new TablePatternMatcher(this);
+	else
+		pattern_matcher = 0;
+
 	table_hash = new CompositeHash(table_type->Indices());
 	val.table_val = new PDict<TableEntryVal>;
 	val.table_val->SetDeleteFunc(table_entry_val_delete_func);
@@ -1331,10 +1426,12 @@ TableVal::~TableVal()
 	if ( timer )
 		timer_mgr->Cancel(timer);
 
+	ClearExpireBuckets();
 	Unref(table_type);
 	delete table_hash;
 	delete AsTable();
 	delete subnets;
+	delete pattern_matcher;
 	Unref(attrs);
 	Unref(def_val);
 	Unref(expire_func);
@@ -1347,6 +1444,41 @@ void TableVal::RemoveAll()
 	delete AsTable();
 	val.table_val = new PDict<TableEntryVal>;
 	val.table_val->SetDeleteFunc(table_entry_val_delete_func);
+	ClearExpireBuckets();
+
+	if ( pattern_matcher )
+		pattern_matcher->Clear();
+	}
+
+void TableVal::Reserve(int size)
+	{
+	if ( Size() || size <= 0 )
+		return;
+
+	ClearExpireBuckets();
+
+	delete AsTable();
+	val.table_val = new PDict<TableEntryVal>(UNORDERED, size);
+	val.table_val->SetDeleteFunc(table_entry_val_delete_func);
+	}
+
+void TableVal::SwapContents(TableVal* other)
+	{
+	// The expiration buckets are rebuilt for the new contents.
+	ClearExpireBuckets();
+	other->ClearExpireBuckets();
+
+	std::swap(val.table_val, other->val.table_val);
+	std::swap(subnets, other->subnets);
+
+	if ( pattern_matcher )
+		pattern_matcher->Clear();
+
+	if ( other->pattern_matcher )
+		other->pattern_matcher->Clear();
+
+	Modified();
+	other->Modified();
 	}
 
 int TableVal::RecursiveSize() const
@@ -1441,7 +1573,12 @@ int TableVal::Assign(Val* index, HashKey* k, Val* new_val)
 
 	TableEntryVal* new_entry_val = new TableEntryVal(new_val);
 	HashKey k_copy(k->Key(), k->Size(), k->Hash());
-	TableEntryVal* old_entry_val = AsNonConstTable()->Insert(k, new_entry_val);
+
+	// For a new entry, the dictionary keeps these key bytes.
+	void* key = k->TakeKey();
+	TableEntryVal* old_entry_val = (TableEntryVal*)
+		AsNonConstTable()->Dictionary::Insert(key, k_copy.Size(),
+						k_copy.Hash(), new_entry_val, 0);
 
 	// If the dictionary index already existed, the insert may free up the
 	// memory allocated to the key bytes, so have to assume k is invalid
@@ -1461,17 +1598,28 @@ int TableVal::Assign(Val* index, HashKey* k, Val* new_val)
 			subnets->Insert(index, new_entry_val);
 		}
 
+	if ( pattern_matcher )
+		pattern_matcher->Clear();
+
 	// Keep old expiration time if necessary.
 	if ( old_entry_val && attrs && attrs->FindAttr(ATTR_EXPIRE_CREATE) )
 		new_entry_val->SetExpireAccess(old_entry_val->ExpireAccessTime());
 
+	// An overwritten entry keeps its key, and with it its place in
+	// the buckets.
+	if ( expire_buckets && ! old_entry_val )
+		{
+		ExpireKey ek = { key, k_copy.Size(), k_copy.Hash() };
+		ScheduleExpire(ek, new_entry_val, expire_buckets_timeout);
+		}
+
 	if ( old_entry_val )
 		{
 		old_entry_val->Unref();
 		delete old_entry_val;
 		}
 
-	Modified();
+	Modified(k_copy.Hash());
 	return 1;
 	}
 
@@ -1515,13 +1663,19 @@ int TableVal::AddTo(Val* val, int is_first_init, bool propagate_ops) const
 		if ( type->IsSet() )
 			{
 			if ( ! t->Assign(v->Value(), k, 0) )
-				 return 0;
+				{
+				tbl->StopIteration(c);
+				return 0;
+				}
 			}
 		else
 			{
 			v->Ref();
 			if ( ! t->Assign(0, k, v->Value()) )
-				 return 0;
+				{
+				tbl->StopIteration(c);
+				return 0;
+				}
 			}
 		}
 
@@ -1820,19 +1974,14 @@ Val* TableVal::Lookup(Val* index, bool use_default_val)
 
 	if ( tbl->Length() > 0 )
 		{
-		HashKey* k = ComputeHash(index);
-		if ( k )
-			{
-			TableEntryVal* v = AsTable()->Lookup(k);
-			delete k;
+		TableEntryVal* v = FindEntry(index);
 
-			if ( v )
-				{
-				if ( attrs && attrs->FindAttr(ATTR_EXPIRE_READ) )
-					v->SetExpireAccess(network_time);
+		if ( v )
+			{
+			if ( attrs && attrs->FindAttr(ATTR_EXPIRE_READ) )
+				v->SetExpireAccess(network_time);
 
-				return v->Value() ? v->Value() : this;
-				}
+			return v->Value() ? v->Value() : this;
 			}
 		}
 
@@ -1845,6 +1994,62 @@ Val* TableVal::Lookup(Val* index, bool use_default_val)
 	return def;
 	}
 
+TableEntryVal* TableVal::FindEntry(const Val* index) const
+	{
+	CompositeHash::KeyBuffer buf;
+	const void* key;
+	int key_size;
+	hash_t hash;
+
+	if ( table_hash->ComputeLookupKey(index, &buf, key, key_size, hash) )
+		return static_cast<TableEntryVal*>(
+			AsTable()->Dictionary::Lookup(key, key_size, hash));
+
+	HashKey* k = ComputeHash(index);
+
+	if ( ! k )
+		return 0;
+
+	TableEntryVal* v = AsTable()->Lookup(k);
+	delete k;
+
+	return v;
+	}
+
+VectorVal* TableVal::LookupPattern(const StringVal* s)
+	{
+	if ( ! pattern_matcher || table_type->IsSet() )
+		reporter->InternalError("LookupPattern called on wrong table type");
+
+	VectorType* vt = new VectorType(table_type->YieldType()->Ref());
+	VectorVal* result = new VectorVal(vt);
+	Unref(vt);
+
+	std::vector<ListVal*> matches;
+	pattern_matcher->Lookup(s, matches);
+
+	for ( auto index : matches )
+		{
+		Val* v = Lookup(index, false);
+
+		if ( v )
+			result->Assign(result->Size(), v->Ref());
+		}
+
+	return result;
+	}
+
+bool TableVal::MatchPattern(const StringVal* s)
+	{
+	if ( ! pattern_matcher )
+		reporter->InternalError("MatchPattern called on wrong table type");
+
+	std::vector<ListVal*> matches;
+	pattern_matcher->Lookup(s, matches);
+
+	return ! matches.empty();
+	}
+
 VectorVal* TableVal::LookupSubnets(const SubNetVal* search)
 	{
 	if ( ! subnets )
@@ -1899,15 +2104,7 @@ bool TableVal::UpdateTimestamp(Val* index)
 	if ( subnets )
 		v = (TableEntryVal*) subnets->Lookup(index);
 	else
-		{
-		HashKey* k = ComputeHash(index);
-		if ( ! k )
-			return false;
-
-		v = AsTable()->Lookup(k);
-
-		delete k;
-		}
+		v = FindEntry(index);
 
 	if ( ! v )
 		return false;
@@ -1925,22 +2122,29 @@ ListVal* TableVal::RecoverIndex(const HashKey* k) const
 Val* TableVal::Delete(const Val* index)
 	{
 	HashKey* k = ComputeHash(index);
-	TableEntryVal* v = k ? AsNonConstTable()->RemoveEntry(k) : 0;
+	TableEntryVal* v = k ? RemoveEntry(k) : 0;
 	Val* va = v ? (v->Value() ? v->Value() : this->Ref()) : 0;
 
 	if ( subnets && ! subnets->Remove(index) )
 		reporter->InternalWarning("index not in prefix table");
 
+	if ( pattern_matcher )
+		pattern_matcher->Clear();
+
+	if ( k )
+		Modified(k->Hash());
+	else
+		Modified();
+
 	delete k;
 	delete v;
 
-	Modified();
 	return va;
 	}
 
 Val* TableVal::Delete(const HashKey* k)
 	{
-	TableEntryVal* v = AsNonConstTable()->RemoveEntry(k);
+	TableEntryVal* v = RemoveEntry(k);
 	Val* va = v ? (v->Value() ? v->Value() : this->Ref()) : 0;
 
 	if ( subnets )
@@ -1951,9 +2155,12 @@ Val* TableVal::Delete(const HashKey* k)
 		Unref(index);
 		}
 
+	if ( pattern_matcher )
+		pattern_matcher->Clear();
+
 	delete v;
 
-	Modified();
+	Modified(k->Hash());
 	return va;
 	}
 
@@ -2168,8 +2375,6 @@ void TableVal::DoExpire(double t)
 	if ( ! type )
 		return; // FIX ME ###
 
-	PDict<TableEntryVal>* tbl = AsNonConstTable();
-
 	double timeout = GetExpireTime();
 
 	if ( timeout < 0 )
@@ -2177,87 +2382,185 @@ void TableVal::DoExpire(double t)
 		// error, it has been reported already.
 		return;
 
-	if ( ! expire_cookie )
-		{
-		expire_cookie = tbl->InitForIteration();
-		tbl->MakeRobustCookie(expire_cookie);
-		}
+	if ( ! expire_buckets || timeout != expire_buckets_timeout )
+		RebuildExpireBuckets(timeout);
 
-	HashKey* k = 0;
-	TableEntryVal* v = 0;
-	TableEntryVal* v_saved = 0;
-	bool modified = false;
+	// The bucket of the current tick holds entries that are due by now
+	// along with ones that aren't yet; the latter go right back into
+	// it, so it's visited only once per round.
+	int64 now_tick = ExpireTick(t);
+	int budget = table_incremental_step;
+	bool visited_now_tick = false;
 
-	for ( int i = 0; i < table_incremental_step &&
-			 (v = tbl->NextEntry(k, expire_cookie)); ++i )
+	while ( budget > 0 && expire_buckets && ! expire_buckets->empty() &&
+		expire_buckets->begin()->first <= now_tick && ! visited_now_tick )
 		{
-		if ( v->ExpireAccessTime() == 0 )
+		// Take the bucket out, as &expire_func may add to the
+		// buckets, or drop them altogether.
+		auto b = expire_buckets->begin();
+		int64 tick = b->first;
+		std::vector<ExpireKey> keys = std::move(b->second);
+		expire_buckets->erase(b);
+		visited_now_tick = (tick == now_tick);
+
+		size_t i = 0;
+
+		for ( ; i < keys.size() && budget > 0 && expire_buckets;
+		      ++i, --budget )
+			ExpireEntry(keys[i], t, timeout);
+
+		// Out of budget; put the rest back for the next round.
+		// Without buckets, the keys may be gone already.
+		if ( i < keys.size() && expire_buckets )
 			{
-			// This happens when we insert val while network_time
-			// hasn't been initialized yet (e.g. in zeek_init()), and
-			// also when bro_start_network_time hasn't been initialized
-			// (e.g. before first packet).  The expire_access_time is
-			// correct, so we just need to wait.
+			std::vector<ExpireKey>& rest = (*expire_buckets)[tick];
+			rest.insert(rest.end(), keys.begin() + i, keys.end());
 			}
+		}
 
-		else if ( v->ExpireAccessTime() + timeout < t )
-			{
-			if ( expire_func )
-				{
-				Val* idx = RecoverIndex(k);
-				double secs = CallExpireFunc(idx);
-
-				// It's possible that the user-provided
-				// function modified or deleted the table
-				// value, so look it up again.
-				v_saved = v;
-				v = tbl->Lookup(k);
-
-				if ( ! v )
-					{ // user-provided function deleted it
-					v = v_saved;
-					delete k;
-					continue;
-					}
+	InitTimer(budget > 0 ? table_expire_interval : table_expire_delay);
+	}
 
-				if ( secs > 0 )
-					{
-					// User doesn't want us to expire
-					// this now.
-					v->SetExpireAccess(network_time - timeout + secs);
-					delete k;
-					continue;
-					}
+void TableVal::ExpireEntry(const ExpireKey& ek, double t, double timeout)
+	{
+	if ( expire_removed_keys->erase(ek.key) )
+		{
+		// Removed since it was filed.
+		delete [] (char*) ek.key;
+		return;
+		}
 
-				}
+	PDict<TableEntryVal>* tbl = AsNonConstTable();
+	HashKey k(ek.key, ek.size, ek.hash, true);
+	TableEntryVal* v = tbl->Lookup(&k);
 
-			if ( subnets )
-				{
-				Val* index = RecoverIndex(k);
-				if ( ! subnets->Remove(index) )
-					reporter->InternalWarning("index not in prefix table");
-				Unref(index);
-				}
+	if ( v->ExpireAccessTime() == 0 )
+		{
+		// This happens when we insert val while network_time
+		// hasn't been initialized yet (e.g. in zeek_init()), and
+		// also when bro_start_network_time hasn't been initialized
+		// (e.g. before first packet).  The expire_access_time is
+		// correct, so we just need to wait.
+		AddExpireKey(ek, ExpireTick(t) + 1);
+		return;
+		}
+
+	if ( v->ExpireAccessTime() + timeout >= t )
+		{
+		// Accessed since it was filed.
+		ScheduleExpire(ek, v, timeout);
+		return;
+		}
 
-			tbl->RemoveEntry(k);
-			Unref(v->Value());
-			delete v;
-			modified = true;
+	if ( expire_func )
+		{
+		Val* idx = RecoverIndex(&k);
+		double secs = CallExpireFunc(idx);
+
+		if ( ! expire_buckets )
+			// The user-provided function cleared the table,
+			// and the key along with it.
+			return;
+
+		if ( expire_removed_keys->erase(ek.key) )
+			{ // user-provided function deleted it
+			delete [] (char*) ek.key;
+			return;
 			}
 
-		delete k;
-		}
+		// It's possible that the user-provided
+		// function modified the table value, so
+		// look it up again.
+		v = tbl->Lookup(&k);
 
-	if ( modified )
-		Modified();
+		if ( secs > 0 )
+			{
+			// User doesn't want us to expire
+			// this now.
+			v->SetExpireAccess(network_time - timeout + secs);
+			ScheduleExpire(ek, v, timeout);
+			return;
+			}
+		}
 
-	if ( ! v )
+	if ( subnets )
 		{
-		expire_cookie = 0;
-		InitTimer(table_expire_interval);
+		Val* index = RecoverIndex(&k);
+		if ( ! subnets->Remove(index) )
+			reporter->InternalWarning("index not in prefix table");
+		Unref(index);
 		}
-	else
-		InitTimer(table_expire_delay);
+
+	if ( pattern_matcher )
+		pattern_matcher->Clear();
+
+	// This frees the key bytes.
+	tbl->RemoveEntry(&k);
+	Unref(v->Value());
+	delete v;
+	Modified(ek.hash);
+	}
+
+int64 TableVal::ExpireTick(double t) const
+	{
+	double width = table_expire_interval > 0 ? table_expire_interval : 1;
+	return int64(floor(t / width));
+	}
+
+void TableVal::AddExpireKey(const ExpireKey& k, int64 tick)
+	{
+	(*expire_buckets)[tick].push_back(k);
+	}
+
+void TableVal::ScheduleExpire(const ExpireKey& k, TableEntryVal* v,
+				double timeout)
+	{
+	AddExpireKey(k, ExpireTick(v->ExpireAccessTime() + timeout));
+	}
+
+TableEntryVal* TableVal::RemoveEntry(const HashKey* k)
+	{
+	if ( ! expire_buckets )
+		return AsNonConstTable()->RemoveEntry(k);
+
+	void* key;
+	TableEntryVal* v = AsNonConstTable()->RemoveEntry(k, key);
+
+	if ( v )
+		expire_removed_keys->insert(key);
+
+	return v;
+	}
+
+void TableVal::RebuildExpireBuckets(double timeout)
+	{
+	ClearExpireBuckets();
+	expire_buckets = new expire_bucket_map;
+	expire_removed_keys = new std::unordered_set<const void*>;
+	expire_buckets_timeout = timeout;
+
+	const PDict<TableEntryVal>* tbl = AsTable();
+	IterCookie* c = tbl->InitForIteration();
+
+	ExpireKey ek;
+	TableEntryVal* v;
+
+	while ( (v = tbl->NextEntry(ek.key, ek.size, ek.hash, c)) )
+		ScheduleExpire(ek, v, timeout);
+	}
+
+void TableVal::ClearExpireBuckets()
+	{
+	if ( ! expire_buckets )
+		return;
+
+	for ( auto k : *expire_removed_keys )
+		delete [] (char*) k;
+
+	delete expire_buckets;
+	delete expire_removed_keys;
+	expire_buckets = 0;
+	expire_removed_keys = 0;
 	}
 
 double TableVal::GetExpireTime()
@@ -2437,17 +2740,28 @@ unsigned int TableVal::MemoryAllocation() const
 		size += padded_sizeof(TableEntryVal);
 		}
 
+	if ( expire_buckets )
+		{
+		for ( const auto& b : *expire_buckets )
+			size += b.second.capacity() * sizeof(ExpireKey);
+
+		size += expire_removed_keys->size() * sizeof(void*);
+		}
+
 	return size + padded_sizeof(*this) + val.table_val->MemoryAllocation()
 		+ table_hash->MemoryAllocation();
 	}
 
 vector<RecordVal*> RecordVal::parse_time_records;
 
-RecordVal::RecordVal(RecordType* t, bool init_fields) : Val(t)
+IMPLEMENT_POOLED_ALLOC(RecordVal, OTHER)
+IMPLEMENT_OBJ_COUNTER(RecordVal)
+
+RecordVal::RecordVal(RecordType* t, bool init_fields) : Val(t), fields(t->NumFields())
 	{
 	origin = nullptr;
 	int n = t->NumFields();
-	val_list* vl = val.val_list_val = new val_list(n);
+	val_list* vl = val.val_list_val = &fields;
 
 	if ( is_parsing )
 		{
@@ -2459,9 +2773,19 @@ RecordVal::RecordVal(RecordType* t, bool init_fields) : Val(t)
 		return;
 
 	// Initialize to default values from RecordType (which are nil
-	// by default).
+	// by default). Where that's the same for all instances, we take
+	// it from the type's cache.
+	const std::vector<RecordType::FieldInit>* inits = t->FieldInits();
+
 	for ( int i = 0; i < n; ++i )
 		{
+		if ( inits && ! (*inits)[i].per_instance )
+			{
+			Val* v = (*inits)[i].val;
+			vl->push_back(v ? v->Ref() : 0);
+			continue;
+			}
+
 		Attributes* a = t->FieldDecl(i)->attrs;
 		Attr* def_attr = a ? a->FindAttr(ATTR_DEFAULT) : 0;
 		Val* def = def_attr ? def_attr->AttrExpr()->Eval(0) : 0;
@@ -2501,14 +2825,52 @@ RecordVal::RecordVal(RecordType* t, bool init_fields) : Val(t)
 
 RecordVal::~RecordVal()
 	{
-	delete_vals(AsNonConstRecord());
+	for ( const auto& v : fields )
+		Unref(v);
 	}
 
 void RecordVal::Assign(int field, Val* new_val)
 	{
 	Val* old_val = AsNonConstRecord()->replace(field, new_val);
 	Unref(old_val);
-	Modified();
+	Modified(field);
+	}
+
+void RecordVal::AssignCount(int field, bro_uint_t v)
+	{
+	Val* old_val = Lookup(field);
+
+	if ( old_val && old_val->Type()->Tag() == TYPE_COUNT &&
+	     old_val->InternalUnsigned() == v )
+		return;
+
+	Assign(field, val_mgr->GetCount(v));
+	}
+
+void RecordVal::AssignDouble(int field, double v, TypeTag t)
+	{
+	Val* old_val = Lookup(field);
+
+	if ( old_val && old_val->Type()->Tag() == t &&
+	     old_val->InternalDouble() == v )
+		return;
+
+	Assign(field, new Val(v, t));
+	}
+
+void RecordVal::AssignString(int field, const char* s, int len)
+	{
+	Val* old_val = Lookup(field);
+
+	if ( old_val && old_val->Type()->Tag() == TYPE_STRING )
+		{
+		const BroString* bs = old_val->AsString();
+
+		if ( bs->Len() == len && memcmp(bs->Bytes(), s, len) == 0 )
+			return;
+		}
+
+	Assign(field, new StringVal(len, s));
 	}
 
 Val* RecordVal::Lookup(int field) const
@@ -2729,7 +3091,8 @@ unsigned int RecordVal::MemoryAllocation() const
 		    size += v->MemoryAllocation();
 		}
 
-	return size + padded_sizeof(*this) + val.val_list_val->MemoryAllocation();
+	return size + padded_sizeof(*this) + fields.MemoryAllocation() -
+		padded_sizeof(fields);
 	}
 
 void EnumVal::ValDescribe(ODesc* d) const
@@ -2748,20 +3111,50 @@ Val* EnumVal::DoClone(CloneState* state)
 	return Ref();
 	}
 
+IMPLEMENT_OBJ_COUNTER(VectorVal)
+
 VectorVal::VectorVal(VectorType* t) : Val(t)
 	{
 	vector_type = t->Ref()->AsVectorType();
-	val.vector_val = new vector<Val*>();
+	storage = new Storage;
+	storage->refs = 1;
+	val.vector_val = &storage->elems;
+	}
+
+VectorVal::VectorVal(VectorType* t, Storage* s) : Val(t)
+	{
+	vector_type = t->Ref()->AsVectorType();
+	storage = s;
+	++storage->refs;
+	val.vector_val = &storage->elems;
 	}
 
 VectorVal::~VectorVal()
 	{
-	for ( unsigned int i = 0; i < val.vector_val->size(); ++i )
-		Unref((*val.vector_val)[i]);
+	if ( --storage->refs == 0 )
+		{
+		for ( unsigned int i = 0; i < storage->elems.size(); ++i )
+			Unref(storage->elems[i]);
+
+		delete storage;
+		}
 
 	Unref(vector_type);
+	}
 
-	delete val.vector_val;
+void VectorVal::CopyStorage()
+	{
+	Storage* s = new Storage;
+	s->refs = 1;
+	s->elems = storage->elems;
+
+	for ( auto v : s->elems )
+		if ( v )
+			v->Ref();
+
+	--storage->refs;
+	storage = s;
+	val.vector_val = &storage->elems;
 	}
 
 bool VectorVal::Assign(unsigned int index, Val* element)
@@ -2773,6 +3166,8 @@ bool VectorVal::Assign(unsigned int index, Val* element)
 		return false;
 		}
 
+	Unshare();
+
 	Val* val_at_index = 0;
 
 	if ( index < val.vector_val->size() )
@@ -2812,6 +3207,8 @@ bool VectorVal::Insert(unsigned int index, Val* element)
 		return false;
 		}
 
+	Unshare();
+
 	vector<Val*>::iterator it;
 
 	if ( index < val.vector_val->size() )
@@ -2833,6 +3230,8 @@ bool VectorVal::Remove(unsigned int index)
 	if ( index >= val.vector_val->size() )
 		return false;
 
+	Unshare();
+
 	Val* val_at_index = (*val.vector_val)[index];
 	auto it = std::next(val.vector_val->begin(), index);
 	val.vector_val->erase(it);
@@ -2876,6 +3275,8 @@ Val* VectorVal::Lookup(unsigned int index) const
 
 unsigned int VectorVal::Resize(unsigned int new_num_elements)
 	{
+	Unshare();
+
 	unsigned int oldsize = val.vector_val->size();
 	val.vector_val->reserve(new_num_elements);
 	val.vector_val->resize(new_num_elements);
@@ -2893,6 +3294,13 @@ unsigned int VectorVal::ResizeAtLeast(unsigned int new_num_elements)
 
 Val* VectorVal::DoClone(CloneState* state)
 	{
+	const BroType* yt = vector_type->YieldType();
+
+	if ( yt && is_atomic_type(yt) )
+		// The elements don't need cloning themselves, so we can
+		// defer copying until there's a modification.
+		return state->NewClone(this, new VectorVal(vector_type, storage));
+
 	auto vv = new VectorVal(vector_type);
 	vv->val.vector_val->reserve(val.vector_val->size());
 	state->NewClone(this, vv);
@@ -3179,9 +3587,39 @@ bool can_cast_value_to_type(const BroType* s, BroType* t)
 	return false;
 	}
 
+// The strings that GetInternedString() shares. The set is fixed, as
+// adding whatever traffic brings would let it grow without bound.
+static const char* const interned_string_vocabulary[] = {
+	// HTTP request methods.
+	"GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS",
+	"TRACE", "PATCH", "PROPFIND", "PROPPATCH", "MKCOL", "COPY", "MOVE",
+	"LOCK", "UNLOCK", "SEARCH", "REPORT",
+
+	// HTTP reply reason phrases.
+	"Continue", "Switching Protocols", "OK", "Created", "Accepted",
+	"Non-Authoritative Information", "No Content", "Reset Content",
+	"Partial Content", "Multiple Choices", "Moved Permanently", "Found",
+	"Moved Temporarily", "See Other", "Not Modified", "Use Proxy",
+	"Temporary Redirect", "Permanent Redirect", "Bad Request",
+	"Unauthorized", "Payment Required", "Forbidden", "Not Found",
+	"Method Not Allowed", "Not Acceptable",
+	"Proxy Authentication Required", "Request Timeout", "Conflict", "Gone",
+	"Length Required", "Precondition Failed", "Payload Too Large",
+	"Request Entity Too Large", "URI Too Long", "Request-URI Too Long",
+	"Unsupported Media Type", "Range Not Satisfiable",
+	"Requested Range Not Satisfiable", "Expectation Failed",
+	"Upgrade Required", "Too Many Requests", "Internal Server Error",
+	"Not Implemented", "Bad Gateway", "Service Unavailable",
+	"Gateway Timeout", "HTTP Version Not Supported",
+};
+
 ValManager::ValManager()
 	{
 	empty_string = new StringVal("");
+
+	for ( auto s : interned_string_vocabulary )
+		interned_strings.emplace(s, new StringVal(s));
+
 	b_false = Val::MakeBool(false);
 	b_true = Val::MakeBool(true);
 	counts = new Val*[PREALLOCATED_COUNTS];
@@ -3221,6 +3659,9 @@ ValManager::~ValManager()
 	for ( auto& arr : ports )
 		for ( auto& pv : arr )
 			Unref(pv);
+
+	for ( auto& is : interned_strings )
+		Unref(is.second);
 	}
 
 StringVal* ValManager::GetEmptyString() const
@@ -3229,6 +3670,17 @@ StringVal* ValManager::GetEmptyString() const
 	return empty_string;
 	}
 
+StringVal* ValManager::GetInternedString(int len, const char* s)
+	{
+	auto it = interned_strings.find(std::string(s, len));
+
+	if ( it == interned_strings.end() )
+		return new StringVal(len, s);
+
+	::Ref(it->second);
+	return it->second;
+	}
+
 PortVal* ValManager::GetPort(uint32 port_num, TransportProto port_type) const
 	{
 	if ( port_num >= 65536 )
@@ -5,8 +5,10 @@
 
 #include <vector>
 #include <list>
+#include <map>
 #include <array>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "net_util.h"
 #include "Type.h"
@@ -21,6 +23,8 @@
 #include "IPAddr.h"
 #include "DebugLogger.h"
 #include "RE.h"
+#include "ObjPool.h"
+#include "ObjCounter.h"
 
 // We have four different port name spaces: TCP, UDP, ICMP, and UNKNOWN.
 // We distinguish between them based on the bits specified in the *_PORT_MASK
@@ -170,6 +174,12 @@ public:
 
 	~Val() override;
 
+	// Scalar values, which are plain Vals, come from a pool so that
+	// many of them (e.g., the elements of a large vector) are packed
+	// densely. Derived classes of a different size use the heap unless
+	// they have a pool of their own.
+	DECLARE_POOLED_ALLOC()
+
 	Val* Ref()			{ ::Ref(this); return this; }
 	Val* Clone();
 
@@ -180,6 +190,13 @@ public:
 	bro_uint_t InternalUnsigned() const;
 	double InternalDouble() const;
 
+	// Change the value of an int, count or double in place. Only for
+	// values that nobody else holds a reference to, see
+	// Frame::UnsharedElement().
+	void SetInternalInt(bro_int_t i)	{ val.int_val = i; }
+	void SetInternalUnsigned(bro_uint_t u)	{ val.uint_val = u; }
+	void SetInternalDouble(double d)	{ val.double_val = d; }
+
 	bro_int_t CoerceToInt() const;
 	bro_uint_t CoerceToUnsigned() const;
 	double CoerceToDouble() const;
@@ -484,6 +501,12 @@ public:
 
 	StringVal* GetEmptyString() const;
 
+	// Returns a shared StringVal for strings from a fixed vocabulary of
+	// protocol keywords, such as HTTP methods and reason phrases, so
+	// that each of them is stored only once. Any other string gets a
+	// fresh StringVal. Callers must not modify the returned value.
+	StringVal* GetInternedString(int len, const char* s);
+
 	// Port number given in host order.
 	PortVal* GetPort(uint32 port_num, TransportProto port_type) const;
 
@@ -494,6 +517,7 @@ private:
 
 	std::array<std::array<PortVal*, 65536>, NUM_PORT_SPACES> ports;
 	StringVal* empty_string;
+	std::unordered_map<std::string, StringVal*> interned_strings;
 	Val* b_true;
 	Val* b_false;
 	Val** counts;
@@ -618,8 +642,10 @@ protected:
 	Val* DoClone(CloneState* state) override;
 };
 
-class StringVal : public Val {
+class StringVal : public Val, CountedObj<StringVal> {
 public:
+	DECLARE_OBJ_COUNTER()
+
 	explicit StringVal(BroString* s);
 	explicit StringVal(const char* s);
 	explicit StringVal(const string& s);
@@ -673,8 +699,10 @@ protected:
 
 // ListVals are mainly used to index tables that have more than one
 // element in their index.
-class ListVal : public Val {
+class ListVal : public Val, CountedObj<ListVal> {
 public:
+	DECLARE_OBJ_COUNTER()
+
 	explicit ListVal(TypeTag t);
 	~ListVal() override;
 
@@ -777,9 +805,12 @@ protected:
 
 class CompositeHash;
 class Frame;
+class TablePatternMatcher;
 
-class TableVal : public Val, public notifier::Modifiable {
+class TableVal : public Val, public notifier::Modifiable, CountedObj<TableVal> {
 public:
+	DECLARE_OBJ_COUNTER()
+
 	explicit TableVal(TableType* t, Attributes* attrs = 0);
 	~TableVal() override;
 
@@ -806,6 +837,15 @@ public:
 	// Remove the entire contents.
 	void RemoveAll();
 
+	// Makes room for the given number of entries up front. Does
+	// nothing if the table isn't empty.
+	void Reserve(int size);
+
+	// Exchanges the entire contents with those of the given table,
+	// which must be of the same type. Our attributes stay as they are,
+	// and apply to the new contents from here on.
+	void SwapContents(TableVal* other);
+
 	// Remove the entire contents of the table from the given value.
 	// which must also be a TableVal.
 	// Returns true if the addition typechecked, false if not.
@@ -846,6 +886,18 @@ public:
 	// Causes an internal error if called for any other kind of table.
 	TableVal* LookupSubnetValues(const SubNetVal* s);
 
+	// For a table[pattern], returns the values of all entries whose
+	// pattern matches the given string exactly. The patterns are
+	// compiled into a single matcher on first use, which is rebuilt
+	// after the table changes.
+	// Causes an internal error if called for any other kind of table.
+	VectorVal* LookupPattern(const StringVal* s);
+
+	// For a table[pattern]/set[pattern], returns true if any of the
+	// patterns matches the given string exactly.
+	// Causes an internal error if called for any other kind of table.
+	bool MatchPattern(const StringVal* s);
+
 	// Sets the timestamp for the given index to network time.
 	// Returns false if index does not exist.
 	bool UpdateTimestamp(Val* index);
@@ -853,6 +905,11 @@ public:
 	// Returns the index corresponding to the given HashKey.
 	ListVal* RecoverIndex(const HashKey* k) const;
 
+	// Same, but stores the index values into *vals*, which needs room
+	// for one per index type. The caller takes over the references.
+	void RecoverIndex(const HashKey* k, Val** vals) const
+		{ table_hash->RecoverVals(k, vals); }
+
 	// Returns the element if it was in the table, false otherwise.
 	Val* Delete(const Val* index);
 	Val* Delete(const HashKey* k);
@@ -911,6 +968,10 @@ protected:
 	// Calculates default value for index.  Returns 0 if none.
 	Val* Default(Val* index);
 
+	// Returns the entry for the index, or nil if there's none. Avoids
+	// allocating a HashKey for common index types.
+	TableEntryVal* FindEntry(const Val* index) const;
+
 	// Returns true if item expiration is enabled.
 	bool ExpirationEnabled()	{ return expire_time != 0; }
 
@@ -923,6 +984,38 @@ protected:
 	// takes ownership of the reference.
 	double CallExpireFunc(Val *idx);
 
+	// Returns the tick of table_expire_interval that a time falls into.
+	int64 ExpireTick(double t) const;
+
+	// A reference to the key of an entry, pointing to the bytes held
+	// by the table's dictionary.
+	struct ExpireKey {
+		const void* key;
+		int size;
+		hash_t hash;
+	};
+
+	// Files the key of an entry under the bucket for the given tick.
+	void AddExpireKey(const ExpireKey& k, int64 tick);
+
+	// Files the key of an entry under the bucket for when it's due.
+	void ScheduleExpire(const ExpireKey& k, TableEntryVal* v,
+				double timeout);
+
+	// Removes the entry of a key from the dictionary. If it's filed
+	// under a bucket, its key bytes are kept until the bucket comes up.
+	TableEntryVal* RemoveEntry(const HashKey* k);
+
+	// Fills the buckets with all entries, for the given timeout.
+	void RebuildExpireBuckets(double timeout);
+
+	// Drops the buckets; they're rebuilt on the next expiration round.
+	void ClearExpireBuckets();
+
+	// Expires the entry of a key taken from the buckets, or files it
+	// under a later bucket if it isn't due yet.
+	void ExpireEntry(const ExpireKey& k, double t, double timeout);
+
 	Val* DoClone(CloneState* state) override;
 
 	TableType* table_type;
@@ -931,16 +1024,34 @@ protected:
 	Expr* expire_time;
 	Expr* expire_func;
 	TableValTimer* timer;
-	IterCookie* expire_cookie;
+
+	// Keys of the entries, bucketed by the tick of table_expire_interval
+	// during which they may expire next. An expiration round only visits
+	// the buckets that are due; entries accessed since they were filed
+	// then move on to a later bucket, instead of on every access. The
+	// buckets are built by the first round and kept up to date by
+	// Assign() from then on, so each entry is filed exactly once. They
+	// refer to the dictionary's own key bytes rather than copies; those
+	// of removed entries linger in expire_removed_keys until their bucket
+	// comes up.
+	typedef std::map<int64, std::vector<ExpireKey>> expire_bucket_map;
+	expire_bucket_map* expire_buckets;
+	std::unordered_set<const void*>* expire_removed_keys;
+	double expire_buckets_timeout;	// What the buckets were built for.
 	PrefixTable* subnets;
+	TablePatternMatcher* pattern_matcher;
 	Val* def_val;
 };
 
-class RecordVal : public Val, public notifier::Modifiable {
+class RecordVal : public Val, public notifier::Modifiable, CountedObj<RecordVal> {
 public:
+	DECLARE_OBJ_COUNTER()
+
 	explicit RecordVal(RecordType* t, bool init_fields = true);
 	~RecordVal() override;
 
+	DECLARE_POOLED_ALLOC()
+
 	Val* SizeVal() const override
 		{ return val_mgr->GetCount(Type()->AsRecordType()->NumFields()); }
 
@@ -948,6 +1059,15 @@ public:
 	Val* Lookup(int field) const;	// Does not Ref() value.
 	Val* LookupWithDefault(int field) const;	// Does Ref() value.
 
+	// Variants of Assign() that leave the field alone if it holds the
+	// given value already. For records mirroring internal state, that
+	// avoids allocating new values each time they get refreshed.
+	void AssignCount(int field, bro_uint_t v);
+	void AssignDouble(int field, double v, TypeTag t);
+	void AssignString(int field, const char* s, int len);
+	void AssignString(int field, const string& s)
+		{ AssignString(field, s.data(), s.size()); }
+
 	/**
 	 * Looks up the value of a field by field name.  If the field doesn't
 	 * exist in the record type, it's an internal error: abort.
@@ -992,12 +1112,16 @@ public:
 
 protected:
 	friend class Val;
-	RecordVal()	{}
+	RecordVal()	{ val.val_list_val = &fields; }
 
 	Val* DoClone(CloneState* state) override;
 
 	BroObj* origin;
 
+	// The field values, what val.val_list_val points to. Keeping the
+	// list inside the record saves an allocation per instance.
+	val_list fields;
+
 	static vector<RecordVal*> parse_time_records;
 };
 
@@ -1028,8 +1152,10 @@ protected:
 };
 
 
-class VectorVal : public Val, public notifier::Modifiable {
+class VectorVal : public Val, public notifier::Modifiable, CountedObj<VectorVal> {
 public:
+	DECLARE_OBJ_COUNTER()
+
 	explicit VectorVal(VectorType* t);
 	~VectorVal() override;
 
@@ -1084,14 +1210,34 @@ public:
 	// Removes an element at a specific position.
 	bool Remove(unsigned int index);
 
+	// Clones of vectors with atomic elements share the elements with
+	// the original until either side gets modified. Callers that
+	// modify the elements through AsVector() need to call this first.
+	void Unshare()
+		{
+		if ( storage->refs > 1 )
+			CopyStorage();
+		}
+
 protected:
 	friend class Val;
 	VectorVal()	{ }
 
+	// Element storage, possibly shared among clones.
+	struct Storage {
+		int refs;
+		vector<Val*> elems;
+	};
+
+	VectorVal(VectorType* t, Storage* s);
+
+	void CopyStorage();
+
 	void ValDescribe(ODesc* d) const override;
 	Val* DoClone(CloneState* state) override;
 
 	VectorType* vector_type;
+	Storage* storage;
 };
 
 // Checks the given value for consistency with the given type.  If an
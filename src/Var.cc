@@ -329,6 +329,32 @@ static bool has_attr(const attr_list* al, attr_tag tag)
 	return find_attr(al, tag) != nullptr;
 	}
 
+// Checks that the type of a batch handler's body fits the event: it needs
+// to take a single vector of records with fields matching the event's
+// arguments.
+static void check_batch_handler(ID* id, FuncType* t)
+	{
+	if ( ! id->Type() || ! IsFunc(id->Type()->Tag()) ||
+	     id->Type()->AsFuncType()->Flavor() != FUNC_FLAVOR_EVENT )
+		{
+		id->Error("&batch requires a previously declared event");
+		return;
+		}
+
+	RecordType* ev_args = id->Type()->AsFuncType()->Args();
+	RecordType* args = t->Args();
+
+	if ( args->NumFields() == 1 && args->FieldType(0)->Tag() == TYPE_VECTOR )
+		{
+		BroType* yt = args->FieldType(0)->AsVectorType()->YieldType();
+
+		if ( yt->Tag() == TYPE_RECORD && same_type(yt, ev_args, 0, false) )
+			return;
+		}
+
+	id->Error("&batch handler must take a vector of records matching the event's arguments", t);
+	}
+
 void begin_func(ID* id, const char* module_name, function_flavor flavor,
 		int is_redef, FuncType* t, attr_list* attrs)
 	{
@@ -342,6 +368,20 @@ void begin_func(ID* id, const char* module_name, function_flavor flavor,
 		t->ClearYieldType(flavor);
 		}
 
+	if ( Attr* batch_attr = find_attr(attrs, ATTR_BATCH) )
+		{
+		if ( flavor == FUNC_FLAVOR_EVENT )
+			{
+			check_batch_handler(id, t);
+
+			// The body becomes a function of its own, which
+			// end_func() then hands to the event's handler.
+			id = new ID(id->Name(), SCOPE_GLOBAL, false);
+			}
+		else
+			batch_attr->Error("&batch only applicable to event bodies");
+		}
+
 	if ( id->Type() )
 		{
 		if ( ! same_type(id->Type(), t) )
@@ -444,7 +484,7 @@ static int get_func_priotity(const attr_list& attrs)
 
 	for ( const auto& a : attrs )
 		{
-		if ( a->Tag() == ATTR_DEPRECATED )
+		if ( a->Tag() == ATTR_DEPRECATED || a->Tag() == ATTR_BATCH )
 			continue;
 
 		if ( a->Tag() != ATTR_PRIORITY )
@@ -472,10 +512,63 @@ static int get_func_priotity(const attr_list& attrs)
 	return priority;
 	}
 
+// Gets the size of batches from a &batch attribute. Returns 0 (after
+// reporting an error) if it isn't valid.
+static int get_batch_size(const Attr* a)
+	{
+	Val* v = a->AttrExpr()->Eval(0);
+	int size = 0;
+
+	if ( ! v )
+		a->Error("cannot evaluate attribute expression");
+
+	else if ( ! IsIntegral(v->Type()->Tag()) || v->CoerceToInt() <= 0 )
+		a->Error("&batch size must be a positive integer");
+
+	else
+		size = v->CoerceToInt();
+
+	Unref(v);
+	return size;
+	}
+
 void end_func(Stmt* body)
 	{
 	std::unique_ptr<function_ingredients> ingredients = gather_function_ingredients(pop_scope(), body);
 
+	const Attr* batch_attr = find_attr(ingredients->scope->Attrs(), ATTR_BATCH);
+
+	if ( batch_attr &&
+	     ingredients->id->Type()->AsFuncType()->Flavor() == FUNC_FLAVOR_EVENT )
+		{
+		int size = get_batch_size(batch_attr);
+
+		Func* f = new BroFunc(
+			ingredients->id,
+			ingredients->body,
+			ingredients->inits,
+			ingredients->frame_size,
+			ingredients->priority);
+
+		f->SetScope(ingredients->scope);
+
+		if ( size > 0 )
+			{
+			EventHandler* h = event_registry->Lookup(ingredients->id->Name());
+
+			if ( ! h )
+				{
+				h = new EventHandler(ingredients->id->Name());
+				event_registry->Register(h);
+				}
+
+			h->AddBatchHandler(f, size);
+			}
+
+		Unref(f);
+		return;
+		}
+
 	if ( streq(ingredients->id->Name(), "anonymous-function") )
 		{
 		OuterIDBindingFinder cb(ingredients->scope);
@@ -1,10 +1,22 @@
 #include "WeirdState.h"
 #include "Net.h"
 
-bool PermitWeird(WeirdStateMap& wsm, const char* name, uint64_t threshold,
+WeirdState& FindWeirdState(WeirdStateVector& wsv, uint32_t id)
+	{
+	for ( auto& state : wsv )
+		{
+		if ( state.id == id )
+			return state;
+		}
+
+	wsv.emplace_back(id);
+	return wsv.back();
+	}
+
+bool PermitWeird(WeirdStateVector& wsv, uint32_t id, uint64_t threshold,
                  uint64_t rate, double duration)
     {
-	auto& state = wsm[name];
+	auto& state = FindWeirdState(wsv, id);
 	++state.count;
 
 	if ( state.count <= threshold )
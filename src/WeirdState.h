@@ -3,19 +3,24 @@
 #ifndef WEIRDSTATE_H
 #define WEIRDSTATE_H
 
-#include <string>
-#include <unordered_map>
+#include <stdint.h>
+#include <vector>
 
 struct WeirdState {
-	WeirdState() { count = 0; sampling_start_time = 0; }
+	WeirdState(uint32_t arg_id = 0) { id = arg_id; }
+	uint32_t id = 0;	// As returned by Reporter::WeirdID().
 	uint64_t count = 0;
 	double sampling_start_time = 0;
 };
 
-using WeirdStateMap = std::unordered_map<std::string, WeirdState>;
+// Per-connection or per-file state for the few weirds they typically
+// see, searched linearly so that no per-weird allocation or string
+// hashing is needed.
+using WeirdStateVector = std::vector<WeirdState>;
 
-bool PermitWeird(WeirdStateMap& wsm, const char* name, uint64_t threshold,
+WeirdState& FindWeirdState(WeirdStateVector& wsv, uint32_t id);
+
+bool PermitWeird(WeirdStateVector& wsv, uint32_t id, uint64_t threshold,
                  uint64_t rate, double duration);
 
 #endif // WEIRDSTATE_H
-
@@ -1,6 +1,7 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
 #include <algorithm>
+#include <vector>
 
 #include "Analyzer.h"
 #include "Manager.h"
@@ -8,6 +9,8 @@
 
 #include "analyzer/protocol/pia/PIA.h"
 #include "../Event.h"
+#include "../NetVar.h"
+#include "../Stats.h"
 
 namespace analyzer {
 
@@ -73,6 +76,14 @@ void AnalyzerTimer::Init(Analyzer* arg_analyzer, analyzer_timer_func arg_timer,
 
 analyzer::ID Analyzer::id_counter = 0;
 
+// Number of analyzers in existence, indexed by tag type. This is never
+// destroyed, as analyzers may still get deleted during shutdown.
+static std::vector<uint64>& instance_counts()
+	{
+	static std::vector<uint64>* counts = new std::vector<uint64>;
+	return *counts;
+	}
+
 const char* Analyzer::GetAnalyzerName() const
 	{
 	assert(tag);
@@ -82,6 +93,10 @@ const char* Analyzer::GetAnalyzerName() const
 void Analyzer::SetAnalyzerTag(const Tag& arg_tag)
 	{
 	assert(! tag || tag == arg_tag);
+
+	if ( ! tag )
+		CountInstance(arg_tag, 1);
+
 	tag = arg_tag;
 	}
 
@@ -129,11 +144,15 @@ void Analyzer::CtorInit(const Tag& arg_tag, Connection* arg_conn)
 	skip = false;
 	finished = false;
 	removing = false;
+	forwarding = 0;
 	parent = 0;
 	orig_supporters = 0;
 	resp_supporters = 0;
 	signature = 0;
 	output_handler = 0;
+
+	if ( tag )
+		CountInstance(tag, 1);
 	}
 
 Analyzer::~Analyzer()
@@ -158,6 +177,27 @@ Analyzer::~Analyzer()
 		}
 
 	delete output_handler;
+
+	if ( tag )
+		CountInstance(tag, -1);
+	}
+
+void Analyzer::CountInstance(const Tag& tag, int delta)
+	{
+	std::vector<uint64>& counts = instance_counts();
+	Tag::type_t t = tag.Type();
+
+	if ( t >= counts.size() )
+		counts.resize(t + 1, 0);
+
+	counts[t] += delta;
+	}
+
+uint64 Analyzer::InstanceCount(const Tag& tag)
+	{
+	const std::vector<uint64>& counts = instance_counts();
+	Tag::type_t t = tag.Type();
+	return t < counts.size() ? counts[t] : 0;
 	}
 
 void Analyzer::Init()
@@ -217,6 +257,9 @@ void Analyzer::NextPacket(int len, const u_char* data, bool is_orig, uint64 seq,
 
 	else
 		{
+		AnalyzerProfiler::Scope profile_scope(&analyzer_profiler,
+			BifConst::profile_analyzers, this, tag.Type(), len);
+
 		try
 			{
 			DeliverPacket(len, data, is_orig, seq, ip, caplen);
@@ -240,6 +283,9 @@ void Analyzer::NextStream(int len, const u_char* data, bool is_orig)
 
 	else
 		{
+		AnalyzerProfiler::Scope profile_scope(&analyzer_profiler,
+			BifConst::profile_analyzers, this, tag.Type(), len);
+
 		try
 			{
 			DeliverStream(len, data, is_orig);
@@ -263,6 +309,9 @@ void Analyzer::NextUndelivered(uint64 seq, int len, bool is_orig)
 
 	else
 		{
+		AnalyzerProfiler::Scope profile_scope(&analyzer_profiler,
+			BifConst::profile_analyzers, this, tag.Type(), 0);
+
 		try
 			{
 			Undelivered(seq, len, is_orig);
@@ -297,19 +346,26 @@ void Analyzer::ForwardPacket(int len, const u_char* data, bool is_orig,
 	AppendNewChildren();
 
 	// Pass to all children.
-	analyzer_list::iterator next;
-	for ( analyzer_list::iterator i = children.begin();
-	      i != children.end(); i = next )
+	bool purge = false;
+	++forwarding;
+
+	// Indexing rather than iterators, as children may get appended
+	// while we're looping.
+	for ( analyzer_list::size_type i = 0; i < children.size(); ++i )
 		{
-		Analyzer* current = *i;
-		next = ++i;
+		Analyzer* current = children[i];
 
 		if ( ! (current->finished || current->removing ) )
 			current->NextPacket(len, data, is_orig, seq, ip, caplen);
 		else
-			DeleteChild(--i);
+			purge = true;
 		}
 
+	--forwarding;
+
+	if ( purge )
+		PurgeChildren();
+
 	AppendNewChildren();
 	}
 
@@ -320,19 +376,26 @@ void Analyzer::ForwardStream(int len, const u_char* data, bool is_orig)
 
 	AppendNewChildren();
 
-	analyzer_list::iterator next;
-	for ( analyzer_list::iterator i = children.begin();
-	      i != children.end(); i = next )
+	bool purge = false;
+	++forwarding;
+
+	// Indexing rather than iterators, as children may get appended
+	// while we're looping.
+	for ( analyzer_list::size_type i = 0; i < children.size(); ++i )
 		{
-		Analyzer* current = *i;
-		next = ++i;
+		Analyzer* current = children[i];
 
 		if ( ! (current->finished || current->removing ) )
 			current->NextStream(len, data, is_orig);
 		else
-			DeleteChild(--i);
+			purge = true;
 		}
 
+	--forwarding;
+
+	if ( purge )
+		PurgeChildren();
+
 	AppendNewChildren();
 	}
 
@@ -343,19 +406,26 @@ void Analyzer::ForwardUndelivered(uint64 seq, int len, bool is_orig)
 
 	AppendNewChildren();
 
-	analyzer_list::iterator next;
-	for ( analyzer_list::iterator i = children.begin();
-	      i != children.end(); i = next )
+	bool purge = false;
+	++forwarding;
+
+	// Indexing rather than iterators, as children may get appended
+	// while we're looping.
+	for ( analyzer_list::size_type i = 0; i < children.size(); ++i )
 		{
-		Analyzer* current = *i;
-		next = ++i;
+		Analyzer* current = children[i];
 
 		if ( ! (current->finished || current->removing ) )
 			current->NextUndelivered(seq, len, is_orig);
 		else
-			DeleteChild(--i);
+			purge = true;
 		}
 
+	--forwarding;
+
+	if ( purge )
+		PurgeChildren();
+
 	AppendNewChildren();
 	}
 
@@ -363,19 +433,26 @@ void Analyzer::ForwardEndOfData(bool orig)
 	{
 	AppendNewChildren();
 
-	analyzer_list::iterator next;
-	for ( analyzer_list::iterator i = children.begin();
-	      i != children.end(); i = next )
+	bool purge = false;
+	++forwarding;
+
+	// Indexing rather than iterators, as children may get appended
+	// while we're looping.
+	for ( analyzer_list::size_type i = 0; i < children.size(); ++i )
 		{
-		Analyzer* current = *i;
-		next = ++i;
+		Analyzer* current = children[i];
 
 		if ( ! (current->finished || current->removing ) )
 			current->NextEndOfData(orig);
 		else
-			DeleteChild(--i);
+			purge = true;
 		}
 
+	--forwarding;
+
+	if ( purge )
+		PurgeChildren();
+
 	AppendNewChildren();
 	}
 
@@ -528,10 +605,33 @@ void Analyzer::DeleteChild(analyzer_list::iterator i)
 	DBG_LOG(DBG_ANALYZER, "%s deleted child %s 3",
 		fmt_analyzer(this).c_str(), fmt_analyzer(child).c_str());
 
-	children.erase(i);
+	// Done() may have changed the list, so we can't rely on the
+	// iterator anymore.
+	children.erase(std::find(children.begin(), children.end(), child));
 	delete child;
 	}
 
+void Analyzer::PurgeChildren()
+	{
+	if ( forwarding )
+		return;
+
+	for ( bool again = true; again; )
+		{
+		again = false;
+
+		LOOP_OVER_CHILDREN(i)
+			{
+			if ( (*i)->finished || (*i)->removing )
+				{
+				DeleteChild(i);
+				again = true;
+				break;
+				}
+			}
+		}
+	}
+
 void Analyzer::AddSupportAnalyzer(SupportAnalyzer* analyzer)
 	{
 	if ( HasSupportAnalyzer(analyzer->GetAnalyzerTag(), analyzer->IsOrig()) )
@@ -762,6 +862,30 @@ unsigned int Analyzer::MemoryAllocation() const
 	return mem;
 	}
 
+void Analyzer::AccountMemory(std::map<std::string, std::pair<uint64, uint64>>* mem) const
+	{
+	std::vector<const Analyzer*> nested(children.begin(), children.end());
+
+	for ( SupportAnalyzer* a = orig_supporters; a; a = a->sibling )
+		nested.push_back(a);
+
+	for ( SupportAnalyzer* a = resp_supporters; a; a = a->sibling )
+		nested.push_back(a);
+
+	uint64 own = MemoryAllocation();
+
+	for ( auto a : nested )
+		{
+		uint64 m = a->MemoryAllocation();
+		own -= m < own ? m : own;
+		a->AccountMemory(mem);
+		}
+
+	auto& total = (*mem)[tag ? GetAnalyzerName() : "<untagged>"];
+	++total.first;
+	total.second += own;
+	}
+
 void Analyzer::UpdateConnVal(RecordVal *conn_val)
 	{
 	LOOP_OVER_CHILDREN(i)
@@ -4,6 +4,9 @@
 #define ANALYZER_ANALYZER_H
 
 #include <list>
+#include <map>
+#include <string>
+#include <vector>
 
 #include "Tag.h"
 
@@ -25,7 +28,7 @@ class AnalyzerTimer;
 class SupportAnalyzer;
 class OutputHandler;
 
-typedef list<Analyzer*> analyzer_list;
+typedef std::vector<Analyzer*> analyzer_list;
 typedef uint32 ID;
 typedef void (Analyzer::*analyzer_timer_func)(double t);
 
@@ -553,6 +556,24 @@ public:
 	 */
 	void ConnectionEventFast(EventHandlerPtr f, val_list vl);
 
+	/**
+	 * Raises an event only if there's a handler for it, building its
+	 * arguments just in that case. This saves constructing values
+	 * that nobody would look at, without having to repeat the check
+	 * for the handler at the call site.
+	 *
+	 * @param f The event to raise.
+	 *
+	 * @param build A callable returning the event's arguments as a
+	 * \c val_list.
+	 */
+	template <typename F>
+	void ConnectionEventLazy(EventHandlerPtr f, F build)
+		{
+		if ( f )
+			ConnectionEventFast(f, build());
+		}
+
 	/**
 	 * Convenience function that forwards directly to the corresponding
 	 * Connection::Weird().
@@ -564,6 +585,24 @@ public:
 	 */
 	virtual unsigned int MemoryAllocation() const;
 
+	/**
+	 * Adds the memory this analyzer uses itself, leaving out its children
+	 * and support analyzers, to a total for its name, and then does the
+	 * same for each of those.
+	 *
+	 * @param mem Maps analyzer names to the number of instances seen and
+	 * the bytes they use.
+	 */
+	void AccountMemory(std::map<std::string, std::pair<uint64, uint64>>* mem) const;
+
+	/**
+	 * Returns the number of analyzers of a given type currently in
+	 * existence.
+	 *
+	 * @param tag The analyzer type.
+	 */
+	static uint64 InstanceCount(const Tag& tag);
+
 protected:
 	friend class AnalyzerTimer;
 	friend class Manager;
@@ -654,9 +693,16 @@ private:
 	// already Done().
 	void DeleteChild(analyzer_list::iterator i);
 
+	// Deletes all children that are finished or marked for removal,
+	// unless we're currently iterating over them.
+	void PurgeChildren();
+
 	// Helper for the ctors.
 	void CtorInit(const Tag& tag, Connection* conn);
 
+	// Adjusts the number of instances of the given type.
+	static void CountInstance(const Tag& tag, int delta);
+
 	Tag tag;
 	ID id;
 
@@ -679,6 +725,10 @@ private:
 	bool finished;
 	bool removing;
 
+	// Nesting depth of Forward*() calls currently iterating over
+	// the children. The child list may only shrink while zero.
+	int forwarding;
+
 	static ID id_counter;
 };
 
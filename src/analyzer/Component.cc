@@ -8,13 +8,15 @@
 
 using namespace analyzer;
 
-Component::Component(const std::string& name, factory_callback arg_factory, Tag::subtype_t arg_subtype, bool arg_enabled, bool arg_partial)
+Component::Component(const std::string& name, factory_callback arg_factory, Tag::subtype_t arg_subtype, bool arg_enabled, bool arg_partial, precheck_callback arg_precheck)
 	: plugin::Component(plugin::component::ANALYZER, name),
 	  plugin::TaggedComponent<analyzer::Tag>(arg_subtype)
 	{
 	factory = arg_factory;
 	enabled = arg_enabled;
 	partial = arg_partial;
+	precheck = arg_precheck;
+	num_rejected = 0;
 	}
 
 void Component::Initialize()
@@ -26,6 +26,7 @@ class Component : public plugin::Component,
                   public plugin::TaggedComponent<analyzer::Tag> {
 public:
 	typedef Analyzer* (*factory_callback)(Connection* conn);
+	typedef bool (*precheck_callback)(const u_char* data, int len);
 
 	/**
 	 * Constructor.
@@ -55,8 +56,15 @@ public:
 	 * after not seeing the beginning. Note that handling of partial
 	 * connections has generally not seen much testing yet as virtually
 	 * no existing analyzer supports it.
+	 *
+	 * @param precheck An optional function telling from the payload of a
+	 * flow's first packet whether the flow can be one that the analyzer
+	 * handles. If given, an analyzer that a UDP flow gets by its port is
+	 * instantiated only once the flow's first payload passes the check.
+	 * The check should be cheap and stateless, a few byte comparisons
+	 * on header invariants.
 	 */
-	Component(const std::string& name, factory_callback factory, Tag::subtype_t subtype = 0, bool enabled = true, bool partial = false);
+	Component(const std::string& name, factory_callback factory, Tag::subtype_t subtype = 0, bool enabled = true, bool partial = false, precheck_callback precheck = 0);
 
 	/**
 	 * Destructor.
@@ -82,6 +90,23 @@ public:
 	 */
 	bool Partial() const	{ return partial; }
 
+	/**
+	 * Returns the analyzer's precheck function, or null if it doesn't
+	 * have one.
+	 */
+	precheck_callback Precheck() const	{ return precheck; }
+
+	/**
+	 * Returns the number of flows that the analyzer wasn't instantiated
+	 * for because their first payload failed its precheck.
+	 */
+	uint64 NumRejected() const	{ return num_rejected; }
+
+	/**
+	 * Counts a flow failing the analyzer's precheck.
+	 */
+	void Rejected()	{ ++num_rejected; }
+
 	/**
 	 * Returns true if the analyzer is currently enabled and hence
 	 * available for use.
@@ -105,6 +130,8 @@ protected:
 private:
 	factory_callback factory;	// The analyzer's factory callback.
 	bool partial;	// True if the analyzer supports partial connections.
+	precheck_callback precheck;	// Payload check before instantiating, if any.
+	uint64 num_rejected;	// Flows that failed the precheck.
 	bool enabled;	// True if the analyzer is enabled.
 };
 
@@ -4,6 +4,7 @@
 
 #include "Hash.h"
 #include "Val.h"
+#include "LoadShedder.h"
 
 #include "protocol/conn-size/ConnSize.h"
 #include "protocol/icmp/ICMP.h"
@@ -18,6 +19,12 @@
 
 using namespace analyzer;
 
+// Analyzers we need regardless of whether anybody handles their events,
+// as they feed into the connection record or drive other analyzers.
+static const char* always_needed_analyzers[] = {
+	"TCP", "UDP", "ICMP", "CONNSIZE", "PIA_TCP", "PIA_UDP", 0
+};
+
 Manager::ConnIndex::ConnIndex(const IPAddr& _orig, const IPAddr& _resp,
 				     uint16 _resp_p, uint16 _proto)
 	{
@@ -106,6 +113,61 @@ void Manager::InitPostScript()
 	Unref(port_list);
 	}
 
+void Manager::DisableUnusedAnalyzers()
+	{
+	if ( ! BifConst::prune_unused_analyzers )
+		return;
+
+	plugin::Manager::plugin_list plugins = plugin_mgr->ActivePlugins();
+
+	for ( const auto& p : plugins )
+		{
+		bool has_events = false;
+		bool has_handlers = false;
+
+		for ( const auto& b : p->BifItems() )
+			{
+			if ( b.GetType() != plugin::BifItem::EVENT )
+				continue;
+
+			has_events = true;
+
+			EventHandler* h = event_registry->Lookup(b.GetID().c_str());
+
+			if ( h && *h )
+				{
+				has_handlers = true;
+				break;
+				}
+			}
+
+		if ( ! has_events || has_handlers )
+			continue;
+
+		for ( const auto& c : p->Components() )
+			{
+			if ( c->Type() != plugin::component::ANALYZER )
+				continue;
+
+			Component* ac = static_cast<Component*>(c);
+			bool needed = false;
+
+			for ( int i = 0; always_needed_analyzers[i]; ++i )
+				{
+				if ( ac->CanonicalName() == always_needed_analyzers[i] )
+					needed = true;
+				}
+
+			if ( needed || ! ac->Enabled() )
+				continue;
+
+			DBG_LOG(DBG_ANALYZER, "Disabling analyzer %s, no handlers for its events",
+				ac->CanonicalName().c_str());
+			ac->SetEnabled(false);
+			}
+		}
+	}
+
 void Manager::DumpDebug()
 	{
 #ifdef DEBUG
@@ -300,6 +362,13 @@ Analyzer* Manager::InstantiateAnalyzer(Tag tag, Connection* conn)
 	if ( ! c->Enabled() )
 		return 0;
 
+	if ( load_shedder && load_shedder->SkipAnalyzer(tag.AsEnumVal()) )
+		{
+		DBG_ANALYZER_ARGS(conn, "not activating %s analyzer due to load shedding",
+				  GetComponentName(tag).c_str());
+		return 0;
+		}
+
 	if ( ! c->Factory() )
 		{
 		reporter->InternalWarning("analyzer %s cannot be instantiated dynamically",
@@ -382,7 +451,13 @@ bool Manager::BuildInitialAnalyzerTree(Connection* conn)
 
 	case TRANSPORT_UDP:
 		root = udp = new udp::UDP_Analyzer(conn);
-		pia = new pia::PIA_UDP(conn);
+
+		// For lightweight flows, we decide on the PIA further below,
+		// once we know whether there's an analyzer for the flow
+		// already.
+		if ( ! BifConst::udp_lightweight_flows )
+			pia = new pia::PIA_UDP(conn);
+
 		check_port = true;
 		DBG_ANALYZER(conn, "activated UDP analyzer");
 		break;
@@ -400,6 +475,10 @@ bool Manager::BuildInitialAnalyzerTree(Connection* conn)
 
 	bool scheduled = ApplyScheduledAnalyzers(conn, false, root);
 
+	// Children added below only show up in the root's list of children
+	// once it processes its first packet, so we keep track ourselves.
+	bool have_analyzer = scheduled;
+
 	// Hmm... Do we want *just* the expected analyzer, or all
 	// other potential analyzers as well?  For now we only take
 	// the scheduled ones.
@@ -414,12 +493,24 @@ bool Manager::BuildInitialAnalyzerTree(Connection* conn)
 				{
 				for ( tag_set::const_iterator j = ports->begin(); j != ports->end(); ++j )
 					{
+					Component* c = udp ? Lookup(*j) : 0;
+
+					if ( c && c->Precheck() )
+						{
+						// Wait for the first payload to tell
+						// whether it's worth instantiating.
+						udp->AddCandidateAnalyzer(*j);
+						continue;
+						}
+
 					Analyzer* analyzer = analyzer_mgr->InstantiateAnalyzer(*j, conn);
 
 					if ( ! analyzer )
 						continue;
 
-					root->AddChildAnalyzer(analyzer, false);
+					if ( root->AddChildAnalyzer(analyzer, false) )
+						have_analyzer = true;
+
 					DBG_ANALYZER_ARGS(conn, "activated %s analyzer due to port %d",
 							  analyzer_mgr->GetComponentName(*j).c_str(), resp_port);
 					}
@@ -427,6 +518,9 @@ bool Manager::BuildInitialAnalyzerTree(Connection* conn)
 			}
 		}
 
+	if ( udp && ! pia && ! have_analyzer && ! udp->HasCandidateAnalyzers() )
+		pia = new pia::PIA_UDP(conn);
+
 	if ( tcp )
 		{
 		// We have to decide whether to reassamble the stream.
@@ -83,6 +83,14 @@ public:
 	 */
 	void DumpDebug(); // Called after zeek_init() events.
 
+	/**
+	 * Disables all analyzers of plugins for which none of the events
+	 * have a handler, if \c prune_unused_analyzers is set. Should be
+	 * called only after any \c zeek_init events have executed, so that
+	 * handlers set up there are taken into account.
+	 */
+	void DisableUnusedAnalyzers();
+
 	/**
 	 * Enables an analyzer type. Only enabled analyzers will be
 	 * instantiated for new connections.
@@ -15,6 +15,34 @@ AYIYA_Analyzer::~AYIYA_Analyzer()
 	delete interp;
 	}
 
+bool AYIYA_Analyzer::Precheck(const u_char* data, int len)
+	{
+	if ( len < 8 )
+		return false;
+
+	int identity_len = 1 << (data[0] >> 4);
+	int signature_len = (data[1] >> 4) * 4;
+	int op = data[2] & 0xf;
+	int next_header = data[3];
+	int hdr_len = 8 + identity_len + signature_len;
+
+	// Operations go up to 7, the query response.
+	if ( op > 7 || len < hdr_len )
+		return false;
+
+	if ( op != 1 )
+		return true;
+
+	// Forwarded packet.
+	if ( len < hdr_len + 20 )
+		return false;
+
+	int ip_version = data[hdr_len] >> 4;
+
+	return (next_header == IPPROTO_IPV4 && ip_version == 4) ||
+	       (next_header == IPPROTO_IPV6 && ip_version == 6);
+	}
+
 void AYIYA_Analyzer::Done()
 	{
 	Analyzer::Done();
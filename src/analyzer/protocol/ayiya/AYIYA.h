@@ -17,6 +17,11 @@ public:
 	static analyzer::Analyzer* Instantiate(Connection* conn)
 		{ return new AYIYA_Analyzer(conn); }
 
+	// Returns whether a flow's first payload can be an AYIYA packet:
+	// a known operation with the identity and signature fitting, and
+	// for forwarded packets an IP header matching the next header.
+	static bool Precheck(const u_char* data, int len);
+
 protected:
 	binpac::AYIYA::AYIYA_Conn* interp;
 };
@@ -12,7 +12,7 @@ class Plugin : public plugin::Plugin {
 public:
 	plugin::Configuration Configure()
 		{
-		AddComponent(new ::analyzer::Component("AYIYA", ::analyzer::ayiya::AYIYA_Analyzer::Instantiate));
+		AddComponent(new ::analyzer::Component("AYIYA", ::analyzer::ayiya::AYIYA_Analyzer::Instantiate, 0, true, false, ::analyzer::ayiya::AYIYA_Analyzer::Precheck));
 
 		plugin::Configuration config;
 		config.name = "Zeek::AYIYA";
@@ -10,6 +10,8 @@
 
 using namespace analyzer::conn_size;
 
+IMPLEMENT_POOLED_ALLOC(ConnSize_Analyzer, ANALYZER)
+
 ConnSize_Analyzer::ConnSize_Analyzer(Connection* c)
     : Analyzer("CONNSIZE", c),
       orig_bytes(), resp_bytes(), orig_pkts(), resp_pkts(),
@@ -38,6 +40,24 @@ void ConnSize_Analyzer::Init()
 	resp_pkts_thresh = 0;
 	}
 
+void ConnSize_Analyzer::GetCounts(uint64* arg_orig_pkts, uint64* arg_orig_bytes,
+				  uint64* arg_resp_pkts, uint64* arg_resp_bytes) const
+	{
+	*arg_orig_pkts = orig_pkts;
+	*arg_orig_bytes = orig_bytes;
+	*arg_resp_pkts = resp_pkts;
+	*arg_resp_bytes = resp_bytes;
+	}
+
+void ConnSize_Analyzer::RestoreCounts(uint64 arg_orig_pkts, uint64 arg_orig_bytes,
+				      uint64 arg_resp_pkts, uint64 arg_resp_bytes)
+	{
+	orig_pkts = arg_orig_pkts;
+	orig_bytes = arg_orig_bytes;
+	resp_pkts = arg_resp_pkts;
+	resp_bytes = arg_resp_bytes;
+	}
+
 void ConnSize_Analyzer::Done()
 	{
 	Analyzer::Done();
@@ -172,8 +192,8 @@ void ConnSize_Analyzer::UpdateConnVal(RecordVal *conn_val)
 	RecordVal *resp_endp = conn_val->Lookup("resp")->AsRecordVal();
 
 	// endpoint is the RecordType from NetVar.h
-	int pktidx = endpoint->FieldOffset("num_pkts");
-	int bytesidx = endpoint->FieldOffset("num_bytes_ip");
+	static int pktidx = endpoint->FieldOffset("num_pkts");
+	static int bytesidx = endpoint->FieldOffset("num_bytes_ip");
 
 	if ( pktidx < 0 )
 		reporter->InternalError("'endpoint' record missing 'num_pkts' field");
@@ -181,10 +201,10 @@ void ConnSize_Analyzer::UpdateConnVal(RecordVal *conn_val)
 	if ( bytesidx < 0 )
 		reporter->InternalError("'endpoint' record missing 'num_bytes_ip' field");
 
-	orig_endp->Assign(pktidx, val_mgr->GetCount(orig_pkts));
-	orig_endp->Assign(bytesidx, val_mgr->GetCount(orig_bytes));
-	resp_endp->Assign(pktidx, val_mgr->GetCount(resp_pkts));
-	resp_endp->Assign(bytesidx, val_mgr->GetCount(resp_bytes));
+	orig_endp->AssignCount(pktidx, orig_pkts);
+	orig_endp->AssignCount(bytesidx, orig_bytes);
+	resp_endp->AssignCount(pktidx, resp_pkts);
+	resp_endp->AssignCount(bytesidx, resp_bytes);
 
 	Analyzer::UpdateConnVal(conn_val);
 	}
@@ -6,6 +6,7 @@
 
 #include "analyzer/Analyzer.h"
 #include "NetVar.h"
+#include "ObjPool.h"
 
 namespace analyzer { namespace conn_size {
 
@@ -14,6 +15,8 @@ public:
 	explicit ConnSize_Analyzer(Connection* c);
 	~ConnSize_Analyzer() override;
 
+	DECLARE_POOLED_ALLOC()
+
 	void Init() override;
 	void Done() override;
 
@@ -25,6 +28,13 @@ public:
 	uint64 GetByteAndPacketThreshold(bool bytes, bool orig);
 
 	void SetDurationThreshold(double duration);
+
+	// Returns the counts, and carries them over from an earlier
+	// process, respectively.
+	void GetCounts(uint64* orig_pkts, uint64* orig_bytes,
+		       uint64* resp_pkts, uint64* resp_bytes) const;
+	void RestoreCounts(uint64 orig_pkts, uint64 orig_bytes,
+			   uint64 resp_pkts, uint64 resp_bytes);
 	double GetDurationThreshold() { return duration_thresh; };
 
 	static analyzer::Analyzer* Instantiate(Connection* conn)
@@ -0,0 +1,127 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "FragmentStore.h"
+#include "consts.bif.h"
+
+using namespace analyzer::dce_rpc;
+
+uint64 FragmentStore::total_bytes = 0;
+std::vector<u_char*> FragmentStore::free_chunks;
+std::vector<u_char> FragmentStore::assembled;
+
+u_char* FragmentStore::GetChunk()
+	{
+	if ( free_chunks.empty() )
+		return new u_char[CHUNK_SIZE];
+
+	u_char* chunk = free_chunks.back();
+	free_chunks.pop_back();
+	return chunk;
+	}
+
+void FragmentStore::PutChunk(u_char* chunk)
+	{
+	if ( free_chunks.size() < MAX_FREE_CHUNKS )
+		free_chunks.push_back(chunk);
+	else
+		delete [] chunk;
+	}
+
+int FragmentStore::Release(Message* m)
+	{
+	for ( auto chunk : m->chunks )
+		PutChunk(chunk);
+
+	m->chunks.clear();
+	total_bytes -= m->len;
+
+	int len = m->len;
+	m->len = 0;
+	return len;
+	}
+
+int FragmentStore::Length(uint32 call_id) const
+	{
+	MessageMap::const_iterator i = messages.find(call_id);
+	return i != messages.end() ? i->second.len : 0;
+	}
+
+bool FragmentStore::Append(uint32 call_id, const u_char* data, int len)
+	{
+	if ( total_bytes + len > BifConst::DCE_RPC::max_total_frag_data )
+		return false;
+
+	Message& m = messages[call_id];
+
+	while ( len > 0 )
+		{
+		int used = m.len % CHUNK_SIZE;
+
+		if ( used == 0 )
+			m.chunks.push_back(GetChunk());
+
+		int n = std::min(len, int(CHUNK_SIZE) - used);
+		memcpy(m.chunks.back() + used, data, n);
+
+		m.len += n;
+		total_bytes += n;
+		data += n;
+		len -= n;
+		}
+
+	return true;
+	}
+
+const u_char* FragmentStore::Assemble(uint32 call_id, int* len)
+	{
+	MessageMap::iterator i = messages.find(call_id);
+
+	if ( i == messages.end() )
+		{
+		*len = 0;
+		return 0;
+		}
+
+	Message& m = i->second;
+	assembled.resize(m.len);
+
+	for ( size_t j = 0; j < m.chunks.size(); ++j )
+		{
+		int offset = j * CHUNK_SIZE;
+		memcpy(assembled.data() + offset, m.chunks[j],
+		       std::min(int(CHUNK_SIZE), m.len - offset));
+		}
+
+	*len = Release(&m);
+	messages.erase(i);
+
+	return assembled.data();
+	}
+
+int FragmentStore::Discard(uint32 call_id)
+	{
+	MessageMap::iterator i = messages.find(call_id);
+
+	if ( i == messages.end() )
+		return 0;
+
+	int len = Release(&i->second);
+	messages.erase(i);
+	return len;
+	}
+
+int FragmentStore::Clear()
+	{
+	int len = 0;
+
+	for ( auto& m : messages )
+		len += Release(&m.second);
+
+	messages.clear();
+	return len;
+	}
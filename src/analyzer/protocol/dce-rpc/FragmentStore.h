@@ -0,0 +1,115 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef ANALYZER_PROTOCOL_DCE_RPC_FRAGMENTSTORE_H
+#define ANALYZER_PROTOCOL_DCE_RPC_FRAGMENTSTORE_H
+
+#include <map>
+#include <vector>
+
+#include "util.h"
+
+namespace analyzer { namespace dce_rpc {
+
+/**
+ * Buffers the fragments of DCE-RPC messages by call ID until the last one
+ * has arrived. Fragments go into fixed-size chunks that are recycled
+ * through a pool shared by all stores, so appending never moves data
+ * that's already buffered and a completed message's memory is readily
+ * reused by the next. The data buffered by all stores together is capped
+ * by DCE_RPC::max_total_frag_data.
+ */
+class FragmentStore {
+public:
+	FragmentStore()	{ }
+	~FragmentStore()	{ Clear(); }
+
+	/**
+	 * Returns true if fragments of the given call are buffered.
+	 */
+	bool HasCall(uint32 call_id) const
+		{ return messages.find(call_id) != messages.end(); }
+
+	/**
+	 * Returns the number of calls with fragments buffered.
+	 */
+	size_t NumCalls() const	{ return messages.size(); }
+
+	/**
+	 * Returns the number of bytes buffered for the given call.
+	 */
+	int Length(uint32 call_id) const;
+
+	/**
+	 * Appends a fragment to the data of the given call, starting a new
+	 * message if there's none yet.
+	 *
+	 * @return False, without buffering anything, if that would exceed
+	 * DCE_RPC::max_total_frag_data.
+	 */
+	bool Append(uint32 call_id, const u_char* data, int len);
+
+	/**
+	 * Puts the fragments of the given call together and forgets about
+	 * the call. The returned data lives in a buffer shared by all stores
+	 * and remains valid until the next call to Assemble(), so it needs to
+	 * be parsed right away.
+	 *
+	 * @param len Set to the number of bytes, which the store no longer
+	 * holds.
+	 *
+	 * @return The message's data, or null if the call is unknown.
+	 */
+	const u_char* Assemble(uint32 call_id, int* len);
+
+	/**
+	 * Drops the data of the given call.
+	 *
+	 * @return The number of bytes dropped.
+	 */
+	int Discard(uint32 call_id);
+
+	/**
+	 * Drops the data of all calls.
+	 *
+	 * @return The number of bytes dropped.
+	 */
+	int Clear();
+
+	/**
+	 * Returns the number of bytes buffered by all stores.
+	 */
+	static uint64 TotalBytes()	{ return total_bytes; }
+
+private:
+	enum { CHUNK_SIZE = 4096 };
+
+	// Free chunks kept in the pool at most; the rest go back to the
+	// allocator.
+	enum { MAX_FREE_CHUNKS = 256 };
+
+	struct Message {
+		Message() : len(0)	{ }
+
+		std::vector<u_char*> chunks;
+		int len;
+	};
+
+	typedef std::map<uint32, Message> MessageMap;
+
+	static u_char* GetChunk();
+	static void PutChunk(u_char* chunk);
+
+	// Returns the message's chunks to the pool and its bytes to the
+	// global budget.
+	static int Release(Message* m);
+
+	MessageMap messages;
+
+	static uint64 total_bytes;
+	static std::vector<u_char*> free_chunks;
+	static std::vector<u_char> assembled;
+};
+
+} } // namespace analyzer::*
+
+#endif
@@ -137,56 +137,28 @@ bool DNP3_Base::ProcessData(int len, const u_char* data, bool orig)
 		{
 		if ( endp->in_hdr )
 			{
-			// We're parsing the DNP3 header and link layer, get that in full.
-			int res = AddToBuffer(endp, PSEUDO_APP_LAYER_INDEX, &data, &len);
+			// We're parsing the DNP3 header and link layer, get that
+			// in full. If it's all in this delivery, we look at it
+			// in place.
+			const u_char* hdr = data;
 
-			if ( res == 0 )
-				return true;
-
-			if ( res < 0 )
-				return false;
-
-			// The first two bytes must always be 0x0564.
-			if( endp->buffer[0] != 0x05 || endp->buffer[1] != 0x64 )
+			if ( endp->buffer_len || len < (int)PSEUDO_APP_LAYER_INDEX )
 				{
-				analyzer->Weird("dnp3_header_lacks_magic");
-				return false;
-				}
+				int res = AddToBuffer(endp, PSEUDO_APP_LAYER_INDEX, &data, &len);
 
-			// Make sure header checksum is correct.
-			if ( ! CheckCRC(PSEUDO_LINK_LAYER_LEN, endp->buffer, endp->buffer + PSEUDO_LINK_LAYER_LEN, "header") )
-				{
-				analyzer->ProtocolViolation("broken_checksum");
-				return false;
-				}
+				if ( res == 0 )
+					return true;
 
-			// If the checksum works out, we're pretty certainly DNP3.
-			analyzer->ProtocolConfirmation();
+				if ( res < 0 )
+					return false;
 
-			// DNP3 packets without transport and application
-			// layers can happen, we ignore them.
-			if ( (endp->buffer[PSEUDO_LENGTH_INDEX] + 3) == (char)PSEUDO_LINK_LAYER_LEN  )
-				{
-				ClearEndpointState(orig);
-				return true;
+				hdr = endp->buffer;
 				}
 
-			// Double check the direction in case the first
-			// received packet is a response.
-			u_char ctrl = endp->buffer[PSEUDO_CONTROL_FIELD_INDEX];
-
-			if ( orig != (bool)(ctrl & 0x80) )
-				analyzer->Weird("dnp3_unexpected_flow_direction");
-
-			// Update state.
-			endp->pkt_length = endp->buffer[PSEUDO_LENGTH_INDEX];
-			endp->tpflags = endp->buffer[PSEUDO_TRANSPORT_INDEX];
-			endp->in_hdr = false; // Now parsing application layer.
+			int res = ProcessHeader(endp, hdr, orig);
 
-			// For the first packet, we submit the header to
-			// BinPAC.
-			if ( ++endp->pkt_cnt == 1 )
-				interp->NewData(orig, endp->buffer, endp->buffer + PSEUDO_LINK_LAYER_LEN);
+			if ( res <= 0 )
+				return res == 0;
 			}
 
 		if ( ! endp->in_hdr )
@@ -206,17 +178,39 @@ bool DNP3_Base::ProcessData(int len, const u_char* data, bool orig)
 			int n = PSEUDO_APP_LAYER_INDEX + (endp->pkt_length - 5) + ((endp->pkt_length - 5) / 16) * 2
 					+ 2 * ( ((endp->pkt_length - 5) % 16 == 0) ? 0 : 1) - 1 ;
 
-			int res = AddToBuffer(endp, n, &data, &len);
+			if ( n < (int)PSEUDO_APP_LAYER_INDEX )
+				{
+				reporter->AnalyzerError(analyzer, "dnp3 invalid target length: %d - %d",
+				                        n, PSEUDO_APP_LAYER_INDEX);
+				return false;
+				}
 
-			if ( res == 0 )
-				return true;
+			if ( ! endp->buffer_len && len >= n )
+				{
+				// The whole packet is in this delivery, including
+				// the header we've looked at in place. Parse it
+				// from there rather than copying it first.
+				if ( ! ParseAppLayer(endp, data, n) )
+					return false;
+
+				data += n;
+				len -= n;
+				}
 
-			if ( res < 0 )
-				return false;
+			else
+				{
+				int res = AddToBuffer(endp, n, &data, &len);
 
-			// Parse the the application layer data.
-			if ( ! ParseAppLayer(endp) )
-				return false;
+				if ( res == 0 )
+					return true;
+
+				if ( res < 0 )
+					return false;
+
+				// Parse the the application layer data.
+				if ( ! ParseAppLayer(endp, endp->buffer, endp->buffer_len) )
+					return false;
+				}
 
 			// Done with this packet, prepare for next.
 			endp->buffer_len = 0;
@@ -227,6 +221,53 @@ bool DNP3_Base::ProcessData(int len, const u_char* data, bool orig)
 	return true;
 	}
 
+int DNP3_Base::ProcessHeader(Endpoint* endp, const u_char* hdr, bool orig)
+	{
+	// The first two bytes must always be 0x0564.
+	if( hdr[0] != 0x05 || hdr[1] != 0x64 )
+		{
+		analyzer->Weird("dnp3_header_lacks_magic");
+		return -1;
+		}
+
+	// Make sure header checksum is correct.
+	if ( ! CheckCRC(PSEUDO_LINK_LAYER_LEN, hdr, hdr + PSEUDO_LINK_LAYER_LEN, "header") )
+		{
+		analyzer->ProtocolViolation("broken_checksum");
+		return -1;
+		}
+
+	// If the checksum works out, we're pretty certainly DNP3.
+	analyzer->ProtocolConfirmation();
+
+	// DNP3 packets without transport and application
+	// layers can happen, we ignore them.
+	if ( (hdr[PSEUDO_LENGTH_INDEX] + 3) == (char)PSEUDO_LINK_LAYER_LEN  )
+		{
+		ClearEndpointState(orig);
+		return 0;
+		}
+
+	// Double check the direction in case the first
+	// received packet is a response.
+	u_char ctrl = hdr[PSEUDO_CONTROL_FIELD_INDEX];
+
+	if ( orig != (bool)(ctrl & 0x80) )
+		analyzer->Weird("dnp3_unexpected_flow_direction");
+
+	// Update state.
+	endp->pkt_length = hdr[PSEUDO_LENGTH_INDEX];
+	endp->tpflags = hdr[PSEUDO_TRANSPORT_INDEX];
+	endp->in_hdr = false; // Now parsing application layer.
+
+	// For the first packet, we submit the header to
+	// BinPAC.
+	if ( ++endp->pkt_cnt == 1 )
+		interp->NewData(orig, hdr, hdr + PSEUDO_LINK_LAYER_LEN);
+
+	return 1;
+	}
+
 int DNP3_Base::AddToBuffer(Endpoint* endp, int target_len, const u_char** data, int* len)
 	{
 	if ( ! target_len )
@@ -265,12 +306,12 @@ int DNP3_Base::AddToBuffer(Endpoint* endp, int target_len, const u_char** data,
 	return 0;
 	}
 
-bool DNP3_Base::ParseAppLayer(Endpoint* endp)
+bool DNP3_Base::ParseAppLayer(Endpoint* endp, const u_char* pkt, int pkt_len)
 	{
 	bool orig = (endp == &orig_state);
 	binpac::DNP3::DNP3_Flow* flow = orig ? interp->upflow() : interp->downflow();
 
-	u_char* data = endp->buffer + PSEUDO_TRANSPORT_INDEX; // The transport layer byte counts as app-layer it seems.
+	const u_char* data = pkt + PSEUDO_TRANSPORT_INDEX; // The transport layer byte counts as app-layer it seems.
 	int len = endp->pkt_length - 5;
 
 	// DNP3 Packet :  DNP3 Pseudo Link Layer | DNP3 Pseudo Transport Layer | DNP3 Pseudo Application Layer
@@ -293,11 +334,11 @@ bool DNP3_Base::ParseAppLayer(Endpoint* endp)
 		if ( ! CheckCRC(n, data, data + n, "app_chunk") )
 			return false;
 
-		if ( data + n >= endp->buffer + endp->buffer_len )
+		if ( data + n >= pkt + pkt_len )
 			{
 			reporter->AnalyzerError(analyzer,
 			                        "dnp3 app layer parsing overflow %d - %d",
-			                        endp->buffer_len, n);
+			                        pkt_len, n);
 			return false;
 			}
 
@@ -46,7 +46,26 @@ protected:
 	 */
 	int AddToBuffer(Endpoint* endp, int target_len, const u_char** data, int* len);
 
-	bool ParseAppLayer(Endpoint* endp);
+	/**
+	 * Checks a packet's header and sets up the endpoint for the
+	 * application layer that follows.
+	 * @param endp the endpoint that sent the packet.
+	 * @param hdr the first PSEUDO_APP_LAYER_INDEX bytes of the packet,
+	 * either in the endpoint's buffer or still in the delivered data.
+	 * @param orig true if the originator sent the packet.
+	 * @return -1 if the header is broken, 0 if the packet doesn't have
+	 * an application layer, or 1 if it does.
+	 */
+	int ProcessHeader(Endpoint* endp, const u_char* hdr, bool orig);
+
+	/**
+	 * Passes a complete packet's application layer data on to BinPAC,
+	 * checking and stripping the chunks' CRCs.
+	 * @param endp the endpoint that sent the packet.
+	 * @param pkt the packet, starting with its header.
+	 * @param pkt_len the number of bytes in \a pkt.
+	 */
+	bool ParseAppLayer(Endpoint* endp, const u_char* pkt, int pkt_len);
 	bool CheckCRC(int len, const u_char* data, const u_char* crc16, const char* where);
 	unsigned int CalcCRC(int len, const u_char* data);
 
@@ -16,6 +16,66 @@
 
 using namespace analyzer::dns;
 
+// Compression pointers in a message tend to point at the same few names,
+// typically the one in the question, over and over. We remember what those
+// decoded to, so that we don't have to walk the labels again each time.
+// The cache only ever holds names of the message currently being parsed.
+struct CachedName {
+	int offset;	// where the name starts in the message
+	int consumed;	// bytes of the message that decoding it took
+	int len;	// length of the decoded name
+	int at;		// where the decoded name is stored in name_cache_buf
+};
+
+static const int NAME_CACHE_SIZE = 16;
+static const int NAME_CACHE_BUF_SIZE = 2048;
+
+static CachedName name_cache[NAME_CACHE_SIZE];
+static int num_cached_names = 0;
+static u_char name_cache_buf[NAME_CACHE_BUF_SIZE];
+static int name_cache_buf_used = 0;
+
+// Number of weirds raised while decoding names. Names whose decoding
+// triggered one don't get cached, so that they're reported each time.
+static int num_name_weirds = 0;
+
+static inline void reset_name_cache()
+	{
+	num_cached_names = 0;
+	name_cache_buf_used = 0;
+	}
+
+static inline const CachedName* lookup_name(int offset, int max_len)
+	{
+	for ( int i = 0; i < num_cached_names; ++i )
+		{
+		const CachedName& cn = name_cache[i];
+
+		// With less data available, decoding might have stopped
+		// short of where it did the first time.
+		if ( cn.offset == offset && cn.consumed < max_len )
+			return &cn;
+		}
+
+	return 0;
+	}
+
+static inline void cache_name(int offset, int consumed, const u_char* name, int len)
+	{
+	if ( num_cached_names >= NAME_CACHE_SIZE ||
+	     name_cache_buf_used + len > NAME_CACHE_BUF_SIZE )
+		return;
+
+	CachedName& cn = name_cache[num_cached_names++];
+	cn.offset = offset;
+	cn.consumed = consumed;
+	cn.len = len;
+	cn.at = name_cache_buf_used;
+
+	memcpy(name_cache_buf + name_cache_buf_used, name, len);
+	name_cache_buf_used += len;
+	}
+
 DNS_Interpreter::DNS_Interpreter(analyzer::Analyzer* arg_analyzer)
 	{
 	analyzer = arg_analyzer;
@@ -32,6 +92,8 @@ int DNS_Interpreter::ParseMessage(const u_char* data, int len, int is_query)
 		return 0;
 		}
 
+	reset_name_cache();
+
 	DNS_MsgInfo msg((DNS_RawMsgHdr*) data, is_query);
 
 	if ( first_message && msg.QR && is_query == 1 )
@@ -368,7 +430,10 @@ u_char* DNS_Interpreter::ExtractName(const u_char*& data, int& len,
 	int n = name - name_start;
 
 	if ( n >= 255 )
+		{
 		analyzer->Weird("DNS_NAME_too_long");
+		++num_name_weirds;
+		}
 
 	if ( n >= 2 && name[-1] == '.' )
 		{
@@ -425,16 +490,36 @@ int DNS_Interpreter::ExtractLabel(const u_char*& data, int& len,
 			//  sometimes compression points to compression.)
 
 			analyzer->Weird("DNS_label_forward_compress_offset");
+			++num_name_weirds;
 			return 0;
 			}
 
 		// Recursively resolve name.
 		const u_char* recurse_data = msg_start + offset;
 		int recurse_max_len = orig_data - recurse_data;
+		int max_len = recurse_max_len;
 
+		const CachedName* cn = lookup_name(offset, max_len);
+
+		if ( cn && cn->len < name_len )
+			{
+			memcpy(name, name_cache_buf + cn->at, cn->len);
+			name += cn->len;
+			name_len -= cn->len;
+			name[0] = 0;
+			return 0;
+			}
+
+		int weirds = num_name_weirds;
 		u_char* name_end = ExtractName(recurse_data, recurse_max_len,
 						name, name_len, msg_start);
 
+		// Only names that decoded cleanly, and didn't run up against
+		// the end of the data, come out the same the next time.
+		if ( num_name_weirds == weirds && recurse_max_len > 0 &&
+		     name_end - name < 255 )
+			cache_name(offset, max_len - recurse_max_len, name, name_end - name);
+
 		name_len -= name_end - name;
 		name = name_end;
 
@@ -444,6 +529,7 @@ int DNS_Interpreter::ExtractLabel(const u_char*& data, int& len,
 	if ( label_len > len )
 		{
 		analyzer->Weird("DNS_label_len_gt_pkt");
+		++num_name_weirds;
 		data += len;	// consume the rest of the packet
 		len = 0;
 		return 0;
@@ -454,12 +540,14 @@ int DNS_Interpreter::ExtractLabel(const u_char*& data, int& len,
 		ntohs(analyzer->Conn()->RespPort()) != 137 )
 		{
 		analyzer->Weird("DNS_label_too_long");
+		++num_name_weirds;
 		return 0;
 		}
 
 	if ( label_len >= name_len )
 		{
 		analyzer->Weird("DNS_label_len_gt_name_len");
+		++num_name_weirds;
 		return 0;
 		}
 
@@ -17,6 +17,20 @@ GTPv1_Analyzer::~GTPv1_Analyzer()
 	delete interp;
 	}
 
+bool GTPv1_Analyzer::Precheck(const u_char* data, int len)
+	{
+	if ( len < 8 )
+		return false;
+
+	// Version 1 with the protocol type flag set.
+	if ( (data[0] & 0xf0) != 0x30 )
+		return false;
+
+	// The length excludes the mandatory part of the header.
+	int msg_len = (data[2] << 8) | data[3];
+	return 8 + msg_len <= len;
+	}
+
 void GTPv1_Analyzer::Done()
 	{
 	Analyzer::Done();
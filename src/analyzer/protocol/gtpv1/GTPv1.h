@@ -17,6 +17,10 @@ public:
 	static analyzer::Analyzer* Instantiate(Connection* conn)
 		{ return new GTPv1_Analyzer(conn); }
 
+	// Returns whether a flow's first payload can be a GTPv1 packet:
+	// version 1, not GTP', and a length that fits.
+	static bool Precheck(const u_char* data, int len);
+
 protected:
 	binpac::GTPv1::GTPv1_Conn* interp;
 };
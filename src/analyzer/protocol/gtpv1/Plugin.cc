@@ -12,7 +12,7 @@ class Plugin : public plugin::Plugin {
 public:
 	plugin::Configuration Configure()
 		{
-		AddComponent(new ::analyzer::Component("GTPv1", ::analyzer::gtpv1::GTPv1_Analyzer::Instantiate));
+		AddComponent(new ::analyzer::Component("GTPv1", ::analyzer::gtpv1::GTPv1_Analyzer::Instantiate, 0, true, false, ::analyzer::gtpv1::GTPv1_Analyzer::Precheck));
 
 		plugin::Configuration config;
 		config.name = "Zeek::GTPv1";
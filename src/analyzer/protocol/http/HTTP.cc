@@ -1229,9 +1229,43 @@ static bool is_HTTP_token_char(char c)
 		c != '{' && c != '}';
 	}
 
+// Classes of characters in request lines. We look them up in a table so
+// that scanning a line takes a single load per character.
+enum {
+	HTTP_TOKEN_CHAR = 0x1,	// may appear in a token, like the method
+	HTTP_URI_CHAR = 0x2,	// reserved or unreserved URI character, or '%'
+};
+
+static const uint8* HTTP_char_classes()
+	{
+	static uint8 classes[256];
+	static bool initialized = false;
+
+	if ( ! initialized )
+		{
+		for ( int i = 0; i < 256; ++i )
+			{
+			unsigned char ch = i;
+
+			if ( is_HTTP_token_char(ch) )
+				classes[i] |= HTTP_TOKEN_CHAR;
+
+			if ( is_reserved_URI_char(ch) ||
+			     is_unreserved_URI_char(ch) || ch == '%' )
+				classes[i] |= HTTP_URI_CHAR;
+			}
+
+		initialized = true;
+		}
+
+	return classes;
+	}
+
 static const char* get_HTTP_token(const char* s, const char* e)
 	{
-	while ( s < e && is_HTTP_token_char(*s) )
+	static const uint8* classes = HTTP_char_classes();
+
+	while ( s < e && (classes[(unsigned char) *s] & HTTP_TOKEN_CHAR) )
 		++s;
 
 	return s;
@@ -1259,7 +1293,7 @@ int HTTP_Analyzer::HTTP_RequestLine(const char* line, const char* end_of_line)
 	if ( rest == end_of_method )
 		goto error;
 
-	request_method = new StringVal(end_of_method - line, line);
+	request_method = val_mgr->GetInternedString(end_of_method - line, line);
 
 	if ( ! ParseRequest(rest, end_of_line) )
 		{
@@ -1287,12 +1321,11 @@ int HTTP_Analyzer::ParseRequest(const char* line, const char* end_of_line)
 	const char* end_of_uri;
 	const char* version_start;
 	const char* version_end;
+	static const uint8* classes = HTTP_char_classes();
 
 	for ( end_of_uri = line; end_of_uri < end_of_line; ++end_of_uri )
 		{
-		if ( ! is_reserved_URI_char(*end_of_uri) &&
-		     ! is_unreserved_URI_char(*end_of_uri) &&
-		     *end_of_uri != '%' )
+		if ( ! (classes[(unsigned char) *end_of_uri] & HTTP_URI_CHAR) )
 			break;
 		}
 
@@ -1598,7 +1631,7 @@ int HTTP_Analyzer::HTTP_ReplyLine(const char* line, const char* end_of_line)
 
 	rest = skip_whitespace(rest, end_of_line);
 	reply_reason_phrase =
-		new StringVal(end_of_line - rest, (const char *) rest);
+		val_mgr->GetInternedString(end_of_line - rest, (const char *) rest);
 
 	return 1;
 	}
@@ -115,6 +115,7 @@ public:
 	void SubmitAllHeaders(mime::MIME_HeaderList& /* hlist */) override;
 	void SubmitData(int len, const char* buf) override;
 	int RequestBuffer(int* plen, char** pbuf) override;
+	bool SubmitsInPlace() const override	{ return true; }
 	void SubmitAllData();
 	void SubmitEvent(int event_type, const char* detail) override;
 
@@ -16,6 +16,8 @@
 
 using namespace analyzer::icmp;
 
+IMPLEMENT_POOLED_ALLOC(ICMP_Analyzer, ANALYZER)
+
 ICMP_Analyzer::ICMP_Analyzer(Connection* c)
 	: TransportLayerAnalyzer("ICMP", c),
 	icmp_conn_val(), type(), code(), request_len(-1), reply_len(-1)
@@ -45,7 +47,7 @@ void ICMP_Analyzer::DeliverPacket(int len, const u_char* data,
 
 	const struct icmp* icmpp = (const struct icmp*) data;
 
-	if ( ! ignore_checksums && caplen >= len )
+	if ( caplen >= len && net_verify_checksums() )
 		{
 		int chksum = 0;
 
@@ -472,14 +474,14 @@ void ICMP_Analyzer::UpdateEndpointVal(RecordVal* endp, int is_orig)
 	int size = is_orig ? request_len : reply_len;
 	if ( size < 0 )
 		{
-		endp->Assign(0, val_mgr->GetCount(0));
-		endp->Assign(1, val_mgr->GetCount(int(ICMP_INACTIVE)));
+		endp->AssignCount(0, 0);
+		endp->AssignCount(1, int(ICMP_INACTIVE));
 		}
 
 	else
 		{
-		endp->Assign(0, val_mgr->GetCount(size));
-		endp->Assign(1, val_mgr->GetCount(int(ICMP_ACTIVE)));
+		endp->AssignCount(0, size);
+		endp->AssignCount(1, int(ICMP_ACTIVE));
 		}
 	}
 
@@ -724,16 +726,18 @@ VectorVal* ICMP_Analyzer::BuildNDOptionsVal(int caplen, const u_char* data)
 	{
 	static RecordType* icmp6_nd_option_type = 0;
 	static RecordType* icmp6_nd_prefix_info_type = 0;
+	static VectorType* icmp6_nd_options_type = 0;
 
 	if ( ! icmp6_nd_option_type )
 		{
 		icmp6_nd_option_type = internal_type("icmp6_nd_option")->AsRecordType();
 		icmp6_nd_prefix_info_type =
 		        internal_type("icmp6_nd_prefix_info")->AsRecordType();
+		icmp6_nd_options_type =
+		        internal_type("icmp6_nd_options")->AsVectorType();
 		}
 
-	VectorVal* vv = new VectorVal(
-	        internal_type("icmp6_nd_options")->AsVectorType());
+	VectorVal* vv = new VectorVal(icmp6_nd_options_type);
 
 	while ( caplen > 0 )
 		{
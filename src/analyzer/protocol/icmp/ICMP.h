@@ -5,6 +5,7 @@
 
 #include "RuleMatcher.h"
 #include "analyzer/Analyzer.h"
+#include "ObjPool.h"
 
 namespace analyzer { namespace icmp {
 
@@ -19,6 +20,8 @@ class ICMP_Analyzer : public analyzer::TransportLayerAnalyzer {
 public:
 	explicit ICMP_Analyzer(Connection* conn);
 
+	DECLARE_POOLED_ALLOC()
+
 	void UpdateConnVal(RecordVal *conn_val) override;
 
 	static analyzer::Analyzer* Instantiate(Connection* conn)
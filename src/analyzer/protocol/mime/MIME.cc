@@ -451,11 +451,15 @@ void MIME_Multiline::append(int len, const char* data)
 	buffer.push_back(new BroString((const u_char*) data, len, 1));
 	}
 
-BroString* MIME_Multiline::get_concatenated_line()
+const BroString* MIME_Multiline::get_concatenated_line()
 	{
 	if ( buffer.size() == 0 )
 		return 0;
 
+	if ( buffer.size() == 1 )
+		// Most headers fit on a single line, no need to copy it.
+		return buffer[0];
+
 	delete line;
 	line = concatenate(buffer);
 
@@ -468,7 +472,7 @@ MIME_Header::MIME_Header(MIME_Multiline* hl)
 	lines = hl;
 	name = value = value_token = rest_value = null_data_chunk;
 
-	BroString* s = hl->get_concatenated_line();
+	const BroString* s = hl->get_concatenated_line();
 	int len = s->Len();
 	const char* data = (const char*) s->Bytes();
 
@@ -963,22 +967,21 @@ int MIME_Entity::CheckBoundaryDelimiter(int len, const char* data)
 		return NOT_MULTIPART_BOUNDARY;
 		}
 
+	// Delimiters are anchored at the beginning of the line, so all
+	// it takes for almost every line of content is looking at its
+	// first bytes.
 	if ( len >= 2 && data[0] == '-' && data[1] == '-' )
 		{
 		len -= 2; data += 2;
 
 		data_chunk_t delim = get_data_chunk(multipart_boundary);
 
-		int i;
-		for ( i = 0; i < len && i < delim.length; ++i )
-			if ( data[i] != delim.data[i] )
-				return NOT_MULTIPART_BOUNDARY;
-
-		if ( i < delim.length )
+		if ( len < delim.length ||
+		     memcmp(data, delim.data, delim.length) != 0 )
 			return NOT_MULTIPART_BOUNDARY;
 
-		len -= i;
-		data += i;
+		len -= delim.length;
+		data += delim.length;
 
 		if ( len >= 2 && data[0] == '-' && data[1] == '-' )
 			return MULTIPART_CLOSING_BOUNDARY;
@@ -1049,6 +1052,14 @@ void MIME_Entity::DecodeBinary(int len, const char* data, int trailing_CRLF)
 		}
 	}
 
+// Returns true for the characters that quoted-printable encoding leaves
+// as they are: printable ones except '=', plus whitespace.
+static inline bool is_qp_literal(char ch)
+	{
+	return (ch >= 33 && ch <= 60) || (ch >= 62 && ch <= 126) ||
+	       ch == HT || ch == SP;
+	}
+
 void MIME_Entity::DecodeQuotedPrintable(int len, const char* data)
 	{
 	// Ignore trailing HT and SP.
@@ -1093,13 +1104,18 @@ void MIME_Entity::DecodeQuotedPrintable(int len, const char* data)
 				}
 			}
 
-		else if ( (data[i] >= 33 && data[i] <= 60) ||
-			   // except controls, whitespace and '='
-			  (data[i] >= 62 && data[i] <= 126) )
-			DataOctet(data[i]);
+		else if ( is_qp_literal(data[i]) )
+			{
+			// Pass on the whole run of characters that stand
+			// for themselves at once.
+			int j = i + 1;
 
-		else if ( data[i] == HT || data[i] == SP )
-			DataOctet(data[i]);
+			while ( j <= end_of_line && is_qp_literal(data[j]) )
+				++j;
+
+			DataOctets(j - i, data + i);
+			i = j - 1;
+			}
 
 		else
 			{
@@ -1118,11 +1134,11 @@ void MIME_Entity::DecodeQuotedPrintable(int len, const char* data)
 void MIME_Entity::DecodeBase64(int len, const char* data)
 	{
 	int rlen;
-	char rbuf[128];
+	char rbuf[1024];
 
 	while ( len > 0 )
 		{
-		rlen = 128;
+		rlen = sizeof(rbuf);
 		char* prbuf = rbuf;
 		int decoded = base64_decoder->Decode(len, data, &rlen, &prbuf);
 		DataOctets(rlen, rbuf);
@@ -1208,6 +1224,17 @@ void MIME_Entity::DataOctets(int len, const char* data)
 		if ( data_buf_offset < 0 && ! GetDataBuffer() )
 			return;
 
+		if ( data_buf_offset == 0 && len >= data_buf_length &&
+		     message->SubmitsInPlace() )
+			{
+			// Nothing buffered yet, so the data can go out in
+			// the same pieces without a copy.
+			SubmitData(data_buf_length, data);
+			data += data_buf_length;
+			len -= data_buf_length;
+			continue;
+			}
+
 		int n = min(data_buf_length - data_buf_offset, len);
 		memcpy(data_buf_data + data_buf_offset, data, n);
 		data += n;
@@ -56,7 +56,7 @@ public:
 	~MIME_Multiline();
 
 	void append(int len, const char* data);
-	BroString* get_concatenated_line();
+	const BroString* get_concatenated_line();
 
 protected:
 	vector<const BroString*> buffer;
@@ -217,6 +217,11 @@ public:
 	virtual int RequestBuffer(int* plen, char** pbuf) = 0;
 	virtual void SubmitEvent(int event_type, const char* detail) = 0;
 
+	// Returns true if SubmitData() takes data from anywhere rather than
+	// only from the buffers handed out by RequestBuffer(). Entities then
+	// pass on whole buffers' worth of their input without copying it.
+	virtual bool SubmitsInPlace() const	{ return false; }
+
 protected:
 	analyzer::Analyzer* analyzer;
 
@@ -5,6 +5,9 @@
 
 using namespace analyzer::pia;
 
+IMPLEMENT_POOLED_ALLOC(PIA_UDP, ANALYZER)
+IMPLEMENT_POOLED_ALLOC(PIA_TCP, ANALYZER)
+
 PIA::PIA(analyzer::Analyzer* arg_as_analyzer)
 	: state(INIT), as_analyzer(arg_as_analyzer), conn(), current_packet()
 	{
@@ -22,8 +25,7 @@ void PIA::ClearBuffer(Buffer* buffer)
 		{
 		next = b->next;
 		delete b->ip;
-		delete [] b->data;
-		delete b;
+		delete [] reinterpret_cast<u_char*>(b);
 		}
 
 	buffer->head = buffer->tail = 0;
@@ -33,17 +35,17 @@ void PIA::ClearBuffer(Buffer* buffer)
 void PIA::AddToBuffer(Buffer* buffer, uint64 seq, int len, const u_char* data,
 			bool is_orig, const IP_Hdr* ip)
 	{
-	u_char* tmp = 0;
+	// The payload goes right behind the block so that each chunk takes
+	// only a single allocation.
+	int data_len = data ? len : 0;
+	u_char* mem = new u_char[sizeof(DataBlock) + data_len];
+	DataBlock* b = reinterpret_cast<DataBlock*>(mem);
 
 	if ( data )
-		{
-		tmp = new u_char[len];
-		memcpy(tmp, data, len);
-		}
+		memcpy(mem + sizeof(DataBlock), data, len);
 
-	DataBlock* b = new DataBlock;
 	b->ip = ip ? ip->Copy() : 0;
-	b->data = tmp;
+	b->data = data ? mem + sizeof(DataBlock) : 0;
 	b->is_orig = is_orig;
 	b->len = len;
 	b->seq = seq;
@@ -74,6 +76,20 @@ void PIA::ReplayPacketBuffer(analyzer::Analyzer* analyzer)
 		analyzer->DeliverPacket(b->len, b->data, b->is_orig, -1, b->ip, 0);
 	}
 
+bool PIA::EarlyDecision(Buffer* buffer)
+	{
+	if ( buffer->state == SKIPPING || ! MatchingDone() )
+		return false;
+
+	// None of the signatures can match anymore, so no analyzer will
+	// ever ask for the buffered data.
+	DBG_LOG(DBG_ANALYZER, "PIA no signature left to match, releasing %d buffered bytes",
+		buffer->size);
+
+	ClearBuffer(buffer);
+	return true;
+	}
+
 void PIA::PIA_Done()
 	{
 	FinishEndpointMatcher();
@@ -110,6 +126,9 @@ void PIA::PIA_DeliverPacket(int len, const u_char* data, bool is_orig, uint64 se
 	if ( clear_state )
 		RuleMatcherState::ClearMatchState(is_orig);
 
+	else if ( EarlyDecision(&pkt_buffer) )
+		new_state = SKIPPING;
+
 	pkt_buffer.state = new_state;
 
 	current_packet.data = 0;
@@ -258,6 +277,9 @@ void PIA_TCP::DeliverStream(int len, const u_char* data, bool is_orig)
 
 	DoMatch(data, len, is_orig, false, false, false, 0);
 
+	if ( EarlyDecision(&stream_buffer) )
+		new_state = SKIPPING;
+
 	stream_buffer.state = new_state;
 	}
 
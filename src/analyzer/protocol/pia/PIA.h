@@ -5,6 +5,7 @@
 
 #include "analyzer/Analyzer.h"
 #include "analyzer/protocol/tcp/TCP.h"
+#include "ObjPool.h"
 
 class RuleEndpointState;
 
@@ -48,6 +49,7 @@ protected:
 
 	// Buffers one chunk of data.  Used both for packet payload (incl.
 	// sequence numbers for TCP) and chunks of a reassembled stream.
+	// The data is stored in the same allocation, right behind the block.
 	struct DataBlock {
 		IP_Hdr* ip;
 		const u_char* data;
@@ -72,6 +74,12 @@ protected:
 				const u_char* data, bool is_orig, const IP_Hdr* ip = 0);
 	void ClearBuffer(Buffer* buffer);
 
+	// Releases the buffer if no signature can match anymore for either
+	// direction.  Returns true if so, in which case the caller moves the
+	// buffer into SKIPPING state.  Not applicable if the matching state
+	// gets cleared with each packet.
+	bool EarlyDecision(Buffer* buffer);
+
 	DataBlock* CurrentPacket()	{ return &current_packet; }
 
 	void DoMatch(const u_char* data, int len, bool is_orig, bool bol,
@@ -95,6 +103,8 @@ public:
 		{ SetConn(conn); }
 	~PIA_UDP() override { }
 
+	DECLARE_POOLED_ALLOC()
+
 	static analyzer::Analyzer* Instantiate(Connection* conn)
 		{ return new PIA_UDP(conn); }
 
@@ -126,6 +136,8 @@ public:
 
 	~PIA_TCP() override;
 
+	DECLARE_POOLED_ALLOC()
+
 	void Init() override;
 
 	// The first packet for each direction of a connection is passed
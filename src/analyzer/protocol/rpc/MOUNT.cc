@@ -190,7 +190,7 @@ val_list MOUNT_Interp::event_common_vl(RPC_CallInfo *c,
 	// These are the first parameters for each mount_* event ...
 	val_list vl(2 + extra_elements);
 	vl.push_back(analyzer->BuildConnVal());
-	VectorVal* auxgids = new VectorVal(internal_type("index_vec")->AsVectorType());
+	VectorVal* auxgids = new VectorVal(index_vec);
 
 	for (size_t i = 0; i < c->AuxGIDs().size(); ++i)
 		{
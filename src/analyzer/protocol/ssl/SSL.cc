@@ -69,6 +69,15 @@ void SSL_Analyzer::DeliverStream(int len, const u_char* data, bool orig)
 		{
 		ProtocolViolation(fmt("Binpac exception: %s", e.c_msg()));
 		}
+
+	// Once both sides are encrypted, the only thing we'd still report
+	// is the encrypted records. If nobody is interested in those,
+	// there's no point in parsing the rest of the connection.
+	if ( ! ssl_encrypted_data && interp->encryptedBothWays() )
+		{
+		DBG_LOG(DBG_ANALYZER, "SSL[%d] skipping encrypted payload", GetID());
+		SetSkip(true);
+		}
 	}
 
 void SSL_Analyzer::SendHandshake(uint16 raw_tls_version, const u_char* begin, const u_char* end, bool orig)
@@ -21,6 +21,8 @@ SteppingStoneEndpoint::SteppingStoneEndpoint(tcp::TCP_Endpoint* e, SteppingStone
 	stp_max_top_seq = 0;
 	stp_last_time = stp_resume_time = 0.0;
 	stp_manager = m;
+	stp_prev = stp_next = 0;
+	stp_active = false;
 	stp_id = stp_manager->NextID();
 	stp_key = new HashKey(bro_int_t(stp_id));
 
@@ -73,21 +75,7 @@ int SteppingStoneEndpoint::DataSent(double t, uint64 seq, int len, int caplen,
 	if ( len <= 0 )
 		return 0;
 
-	double tmin = t - stp_delta;
-
-	while ( stp_manager->OrderedEndpoints().length() > 0 )
-		{
-	    auto e = stp_manager->OrderedEndpoints().front();
-
-		if ( e->stp_resume_time < tmin )
-			{
-			stp_manager->OrderedEndpoints().pop_front();
-			e->Done();
-			Unref(e);
-			}
-		else
-			break;
-		}
+	stp_manager->Expire(t - stp_delta);
 
 	uint64 ack = endp->ToRelativeSeqSpace(endp->AckSeq(), endp->AckWraps());
 	uint64 top_seq = seq + len;
@@ -108,26 +96,34 @@ int SteppingStoneEndpoint::DataSent(double t, uint64 seq, int len, int caplen,
 	stp_last_time = stp_resume_time = t;
 
 	Event(stp_resume_endp, stp_id);
-	for ( auto ep : stp_manager->OrderedEndpoints() )
+
+	// Correlate with the endpoints that resumed most recently first,
+	// so that a limit only cuts off the least likely ones.
+	int n = 0;
+
+	for ( SteppingStoneEndpoint* ep = stp_manager->MostRecent(); ep;
+	      ep = ep->stp_prev )
 		{
-		if ( ep->endp->TCP() != endp->TCP() )
+		if ( ep->endp->TCP() == endp->TCP() )
+			// ep and this belong to same connection
+			continue;
+
+		if ( stp_max_correlations && n++ >= stp_max_correlations )
+			break;
+
+		if ( ! stp_inbound_endps.Lookup(ep->stp_key) )
 			{
 			Ref(ep);
 			Ref(this);
 
 			stp_inbound_endps.Insert(ep->stp_key, ep);
 			ep->stp_outbound_endps.Insert(stp_key, this);
-
-			Event(stp_correlate_pair, ep->stp_id, stp_id);
 			}
 
-		else
-			{ // ep and this belong to same connection
-			}
+		Event(stp_correlate_pair, ep->stp_id, stp_id);
 		}
 
-	stp_manager->OrderedEndpoints().push_back(this);
-	Ref(this);
+	stp_manager->Resumed(this);
 
 	return 1;
 	}
@@ -156,6 +152,63 @@ void SteppingStoneEndpoint::CreateEndpEvent(int is_orig)
 	});
 	}
 
+SteppingStoneManager::~SteppingStoneManager()
+	{
+	while ( head )
+		{
+		SteppingStoneEndpoint* e = head;
+		Unlink(e);
+		Unref(e);
+		}
+	}
+
+void SteppingStoneManager::Expire(double tmin)
+	{
+	while ( head && head->stp_resume_time < tmin )
+		{
+		SteppingStoneEndpoint* e = head;
+		Unlink(e);
+		e->Done();
+		Unref(e);
+		}
+	}
+
+void SteppingStoneManager::Resumed(SteppingStoneEndpoint* e)
+	{
+	if ( e->stp_active )
+		Unlink(e);
+	else
+		// The list keeps a reference to its endpoints.
+		Ref(e);
+
+	e->stp_prev = tail;
+	e->stp_next = 0;
+	e->stp_active = true;
+
+	if ( tail )
+		tail->stp_next = e;
+	else
+		head = e;
+
+	tail = e;
+	}
+
+void SteppingStoneManager::Unlink(SteppingStoneEndpoint* e)
+	{
+	if ( e->stp_prev )
+		e->stp_prev->stp_next = e->stp_next;
+	else
+		head = e->stp_next;
+
+	if ( e->stp_next )
+		e->stp_next->stp_prev = e->stp_prev;
+	else
+		tail = e->stp_prev;
+
+	e->stp_prev = e->stp_next = 0;
+	e->stp_active = false;
+	}
+
 SteppingStone_Analyzer::SteppingStone_Analyzer(Connection* c)
 : tcp::TCP_ApplicationAnalyzer("STEPPINGSTONE", c)
 	{
@@ -3,7 +3,6 @@
 #ifndef ANALYZER_PROTOCOL_STEPPING_STONE_STEPPINGSTONE_H
 #define ANALYZER_PROTOCOL_STEPPING_STONE_STEPPINGSTONE_H
 
-#include "Queue.h"
 #include "analyzer/protocol/tcp/TCP.h"
 
 class NetSessions;
@@ -23,6 +22,8 @@ public:
 		     const IP_Hdr* ip, const struct tcphdr* tp);
 
 protected:
+	friend class SteppingStoneManager;
+
 	void Event(EventHandlerPtr f, int id1, int id2 = -1);
 	void CreateEndpEvent(int is_orig);
 
@@ -40,6 +41,11 @@ protected:
 	HashKey* stp_key;
 	PDict<SteppingStoneEndpoint> stp_inbound_endps;
 	PDict<SteppingStoneEndpoint> stp_outbound_endps;
+
+	// Neighbors in the manager's list of active endpoints.
+	SteppingStoneEndpoint* stp_prev;
+	SteppingStoneEndpoint* stp_next;
+	bool stp_active;
 };
 
 class SteppingStone_Analyzer : public tcp::TCP_ApplicationAnalyzer {
@@ -68,19 +74,41 @@ protected:
 	SteppingStoneEndpoint* resp_endp;
 };
 
-// Manages ids for the possible stepping stone connections.
+// Manages ids for the possible stepping stone connections, and the
+// endpoints that resumed within the last stp_delta.
+//
+// The active endpoints are kept in a list ordered by the time they last
+// resumed. Since network time doesn't go back, a resuming endpoint just
+// moves to the end of the list, and expiring the ones that have been
+// idle too long only ever looks at its front.
 class SteppingStoneManager {
 public:
-	SteppingStoneManager()		{ endp_cnt = 0; }
+	SteppingStoneManager()
+		{
+		endp_cnt = 0;
+		head = tail = 0;
+		}
 
-	PQueue<SteppingStoneEndpoint>& OrderedEndpoints()
-		{ return ordered_endps; }
+	~SteppingStoneManager();
 
 	// Use postfix ++, since the first ID needs to be even.
 	int NextID()			{ return endp_cnt++; }
 
+	// Removes the endpoints that last resumed before tmin.
+	void Expire(double tmin);
+
+	// Moves an endpoint that just resumed to the end of the list.
+	void Resumed(SteppingStoneEndpoint* e);
+
+	// Returns the active endpoint that resumed last, from which the
+	// others can be reached through their stp_prev.
+	SteppingStoneEndpoint* MostRecent() const	{ return tail; }
+
 protected:
-	PQueue<SteppingStoneEndpoint> ordered_endps;
+	void Unlink(SteppingStoneEndpoint* e);
+
+	SteppingStoneEndpoint* head;
+	SteppingStoneEndpoint* tail;
 	int endp_cnt;
 };
 
@@ -98,8 +98,7 @@ void ContentLine_Analyzer::DeliverStream(int len, const u_char* data,
 		buf_len = ((offset + len) * 3) / 2 + 1;
 
 		u_char* tmp = new u_char[buf_len];
-		for ( int i = 0; i < old_buf_len; ++i )
-			tmp[i] = buf[i];
+		memcpy(tmp, buf, old_buf_len);
 
 		delete [] buf;
 		buf = tmp;
@@ -204,6 +203,34 @@ void ContentLine_Analyzer::DoDeliver(int len, const u_char* data)
 		}
 	}
 
+// Returns the length of the leading run of bytes that need no attention
+// from the line state machine, i.e., that contain neither CR nor LF, nor a
+// NUL if those get flagged. memchr() is vectorized by the C library, so
+// this beats looking at each byte individually even though it may take a
+// few passes.
+static inline int plain_run_length(const u_char* data, int len, bool nuls)
+	{
+	const void* p = memchr(data, '\n', len);
+
+	if ( p )
+		len = static_cast<const u_char*>(p) - data;
+
+	p = memchr(data, '\r', len);
+
+	if ( p )
+		len = static_cast<const u_char*>(p) - data;
+
+	if ( nuls )
+		{
+		p = memchr(data, '\0', len);
+
+		if ( p )
+			len = static_cast<const u_char*>(p) - data;
+		}
+
+	return len;
+	}
+
 int ContentLine_Analyzer::DoDeliverOnce(int len, const u_char* data)
 	{
 	const u_char* data_start = data;
@@ -213,6 +240,29 @@ int ContentLine_Analyzer::DoDeliverOnce(int len, const u_char* data)
 
 	for ( ; len > 0; --len, ++data )
 		{
+		// Copy over ordinary characters in bulk. A preceding CR
+		// needs the byte-wise handling below to see what follows it.
+		if ( last_char != '\r' && offset < max_line_length )
+			{
+			int n = plain_run_length(data, std::min(len, max_line_length - offset),
+			                         flag_NULs);
+
+			if ( n > 0 )
+				{
+				if ( offset + n >= buf_len )
+					InitBuffer(std::max(buf_len * 2, offset + n + 1));
+
+				memcpy(buf + offset, data, n);
+				offset += n;
+				data += n;
+				len -= n;
+				last_char = data[-1];
+
+				if ( len == 0 )
+					break;
+				}
+			}
+
 		if ( offset >= buf_len )
 			InitBuffer(buf_len * 2);
 
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 
+#include "Net.h"
 #include "NetVar.h"
 #include "File.h"
 #include "Event.h"
@@ -14,6 +15,8 @@
 
 using namespace analyzer::tcp;
 
+IMPLEMENT_POOLED_ALLOC(TCP_Analyzer, ANALYZER)
+
 namespace { // local namespace
 	const bool DEBUG_tcp_data_sent = false;
 	const bool DEBUG_tcp_connection_close = false;
@@ -259,7 +262,7 @@ const struct tcphdr* TCP_Analyzer::ExtractTCP_Header(const u_char*& data,
 bool TCP_Analyzer::ValidateChecksum(const struct tcphdr* tp,
 				TCP_Endpoint* endpoint, int len, int caplen)
 	{
-	if ( ! ignore_checksums && caplen >= len &&
+	if ( caplen >= len && net_verify_checksums() &&
 	     ! endpoint->ValidChecksum(tp, len) )
 		{
 		Weird("bad_TCP_checksum");
@@ -1245,10 +1248,10 @@ void TCP_Analyzer::UpdateConnVal(RecordVal *conn_val)
 	RecordVal *orig_endp_val = conn_val->Lookup("orig")->AsRecordVal();
 	RecordVal *resp_endp_val = conn_val->Lookup("resp")->AsRecordVal();
 
-	orig_endp_val->Assign(0, val_mgr->GetCount(orig->Size()));
-	orig_endp_val->Assign(1, val_mgr->GetCount(int(orig->state)));
-	resp_endp_val->Assign(0, val_mgr->GetCount(resp->Size()));
-	resp_endp_val->Assign(1, val_mgr->GetCount(int(resp->state)));
+	orig_endp_val->AssignCount(0, orig->Size());
+	orig_endp_val->AssignCount(1, int(orig->state));
+	resp_endp_val->AssignCount(0, resp->Size());
+	resp_endp_val->AssignCount(1, int(resp->state));
 
 	// Call children's UpdateConnVal
 	Analyzer::UpdateConnVal(conn_val);
@@ -1451,6 +1454,12 @@ void TCP_Analyzer::SetContentsFile(unsigned int direction, BroFile* f)
 		}
 	}
 
+void TCP_Analyzer::SetDeliveryPolicy(int policy)
+	{
+	orig->SetDeliveryPolicy(policy);
+	resp->SetDeliveryPolicy(policy);
+	}
+
 BroFile* TCP_Analyzer::GetContentsFile(unsigned int direction) const
 	{
 	switch ( direction ) {
@@ -9,6 +9,7 @@
 #include "TCP_Endpoint.h"
 #include "TCP_Flags.h"
 #include "Conn.h"
+#include "ObjPool.h"
 
 // We define two classes here:
 // - TCP_Analyzer is the analyzer for the TCP protocol itself.
@@ -28,6 +29,8 @@ public:
 	explicit TCP_Analyzer(Connection* conn);
 	~TCP_Analyzer() override;
 
+	DECLARE_POOLED_ALLOC()
+
 	void EnableReassembly();
 
 	// Add a child analyzer that will always get the packets,
@@ -64,6 +67,9 @@ public:
 	void SetContentsFile(unsigned int direction, BroFile* f) override;
 	BroFile* GetContentsFile(unsigned int direction) const override;
 
+	// Sets the tcp_delivery_policy for both directions.
+	void SetDeliveryPolicy(int policy);
+
 	// Callback to process a TCP option.
 	typedef int (*proc_tcp_option_t)(unsigned int opt, unsigned int optlen,
 			const u_char* option, TCP_Analyzer* analyzer,
@@ -185,8 +191,7 @@ private:
 	TCP_Endpoint* orig;
 	TCP_Endpoint* resp;
 
-	typedef list<analyzer::Analyzer*> analyzer_list;
-	analyzer_list packet_children;
+	analyzer::analyzer_list packet_children;
 
 	unsigned int first_packet_seen: 2;
 	unsigned int reassembling: 1;
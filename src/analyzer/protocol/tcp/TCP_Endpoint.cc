@@ -13,6 +13,8 @@
 
 using namespace analyzer::tcp;
 
+IMPLEMENT_POOLED_ALLOC(TCP_Endpoint, ANALYZER)
+
 TCP_Endpoint::TCP_Endpoint(TCP_Analyzer* arg_analyzer, int arg_is_orig)
 	{
 	contents_processor = 0;
@@ -29,6 +31,7 @@ TCP_Endpoint::TCP_Endpoint(TCP_Analyzer* arg_analyzer, int arg_is_orig)
 	SYN_cnt = FIN_cnt = RST_cnt = 0;
 	did_close = 0;
 	contents_file = 0;
+	delivery_policy = default_tcp_delivery_policy;
 	tcp_analyzer = arg_analyzer;
 	is_orig = arg_is_orig;
 
@@ -84,6 +87,7 @@ void TCP_Endpoint::AddReassembler(TCP_Reassembler* arg_contents_processor)
 	if ( contents_processor != arg_contents_processor )
 		delete contents_processor;
 	contents_processor = arg_contents_processor;
+	contents_processor->SetDeliveryPolicy(delivery_policy);
 
 	if ( contents_file )
 		contents_processor->SetContentsFile(contents_file);
@@ -268,6 +272,14 @@ void TCP_Endpoint::SetContentsFile(BroFile* f)
 		contents_processor->SetContentsFile(contents_file);
 	}
 
+void TCP_Endpoint::SetDeliveryPolicy(int policy)
+	{
+	delivery_policy = policy;
+
+	if ( contents_processor )
+		contents_processor->SetDeliveryPolicy(policy);
+	}
+
 int TCP_Endpoint::CheckHistory(uint32 mask, char code)
 	{
 	if ( ! IsOrig() )
@@ -4,6 +4,7 @@
 #define ANALYZER_PROTOCOL_TCP_TCP_ENDPOINT_H
 
 #include "IPAddr.h"
+#include "ObjPool.h"
 
 class Connection;
 class IP_Hdr;
@@ -30,6 +31,8 @@ public:
 	TCP_Endpoint(TCP_Analyzer* analyzer, int is_orig);
 	~TCP_Endpoint();
 
+	DECLARE_POOLED_ALLOC()
+
 	void Done();
 
 	TCP_Analyzer* TCP()	{ return tcp_analyzer; }
@@ -188,6 +191,10 @@ public:
 	void SetContentsFile(BroFile* f);
 	BroFile* GetContentsFile() const	{ return contents_file; }
 
+	// Sets the tcp_delivery_policy for the reassembler, including one
+	// added later.
+	void SetDeliveryPolicy(int policy);
+
 	// Codes used for tracking history.  For responders, we shift these
 	// over by 16 bits in order to fit both originator and responder
 	// into a Connection's hist_seen field.
@@ -210,6 +217,7 @@ public:
 	TCP_Reassembler* contents_processor;
 	TCP_Analyzer* tcp_analyzer;
 	BroFile* contents_file;
+	int delivery_policy;
 	uint32 checksum_base;
 
 	double start_time, last_time;
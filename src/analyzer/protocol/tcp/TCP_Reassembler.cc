@@ -1,6 +1,7 @@
 #include <algorithm>
 
 #include "File.h"
+#include "LoadShedder.h"
 #include "analyzer/Analyzer.h"
 #include "TCP_Reassembler.h"
 #include "analyzer/protocol/tcp/TCP.h"
@@ -10,6 +11,8 @@
 
 using namespace analyzer::tcp;
 
+IMPLEMENT_POOLED_ALLOC(TCP_Reassembler, ANALYZER)
+
 // Note, sequence numbers are relative. I.e., they start with 1.
 
 const bool DEBUG_tcp_contents = false;
@@ -33,6 +36,11 @@ TCP_Reassembler::TCP_Reassembler(analyzer::Analyzer* arg_dst_analyzer,
 	did_EOF = 0;
 	seq_to_skip = 0;
 	in_delivery = false;
+	delivery_policy = default_tcp_delivery_policy;
+
+	num_out_of_order = num_rexmit_bytes = num_overlap_bytes = 0;
+	num_gaps = num_gap_bytes = max_buffered = 0;
+	buffering_since = buffered_time = 0.0;
 
 	if ( tcp_max_old_segments )
 		SetMaxOldBlocks(tcp_max_old_segments);
@@ -72,6 +80,34 @@ void TCP_Reassembler::Done()
 
 		record_contents_file->Close();
 		}
+
+	tcp_analyzer->ConnectionEventLazy(tcp_reassembly_stats, [this]
+		{
+		return val_list{
+			tcp_analyzer->BuildConnVal(),
+			val_mgr->GetBool(IsOrig()),
+			BuildStats(),
+		};
+		});
+	}
+
+RecordVal* TCP_Reassembler::BuildStats() const
+	{
+	double waited = buffered_time;
+
+	if ( buffering_since )
+		waited += network_time - buffering_since;
+
+	RecordVal* stats = new RecordVal(reassembly_stats);
+	stats->Assign(0, val_mgr->GetCount(num_out_of_order));
+	stats->Assign(1, val_mgr->GetCount(num_rexmit_bytes));
+	stats->Assign(2, val_mgr->GetCount(num_overlap_bytes));
+	stats->Assign(3, val_mgr->GetCount(num_gaps));
+	stats->Assign(4, val_mgr->GetCount(num_gap_bytes));
+	stats->Assign(5, val_mgr->GetCount(max_buffered));
+	stats->Assign(6, new Val(waited, TYPE_INTERVAL));
+
+	return stats;
 	}
 
 void TCP_Reassembler::SizeBufferedData(uint64& waiting_on_hole,
@@ -157,6 +193,8 @@ void TCP_Reassembler::Gap(uint64 seq, uint64 len)
 		dst_analyzer->ForwardUndelivered(seq, len, IsOrig());
 
 	had_gap = true;
+	++num_gaps;
+	num_gap_bytes += len;
 	}
 
 void TCP_Reassembler::Undelivered(uint64 up_to_seq)
@@ -395,21 +433,7 @@ void TCP_Reassembler::BlockInserted(DataBlock* start_block)
 			}
 		}
 
-	TCP_Endpoint* e = endp;
-
-	if ( ! e->peer->HasContents() )
-		// Our endpoint's peer doesn't do reassembly and so
-		// (presumably) isn't processing acks.  So don't hold
-		// the now-delivered data.
-		TrimToSeq(last_reassem_seq);
-
-	else if ( e->NoDataAcked() && tcp_max_initial_window &&
-		  e->Size() > static_cast<uint64>(tcp_max_initial_window) )
-		// We've sent quite a bit of data, yet none of it has
-		// been acked.  Presume that we're not seeing the peer's
-		// acks (perhaps due to filtering or split routing) and
-		// don't hang onto the data further, as we may wind up
-		// carrying it all the way until this connection ends.
+	if ( ReleaseAfterDelivery() )
 		TrimToSeq(last_reassem_seq);
 
 	// Note: don't make an EOF check here, because then we'd miss it
@@ -423,6 +447,8 @@ void TCP_Reassembler::Overlap(const u_char* b1, const u_char* b2, uint64 n)
 	if ( DEBUG_tcp_contents )
 		DEBUG_MSG("%.6f TCP contents overlap: %" PRIu64" IsOrig()=%d\n", network_time,  n, IsOrig());
 
+	num_overlap_bytes += n;
+
 	if ( rexmit_inconsistency &&
 	     memcmp((const void*) b1, (const void*) b2, n) &&
 	     // The following weeds out keep-alives for which that's all
@@ -449,6 +475,97 @@ void TCP_Reassembler::Deliver(uint64 seq, int len, const u_char* data)
 		dst_analyzer->ForwardStream(len, data, IsOrig());
 	}
 
+bool TCP_Reassembler::ReleaseAfterDelivery() const
+	{
+	const TCP_Endpoint* e = endp;
+
+	if ( ! e->peer->HasContents() )
+		// Our endpoint's peer doesn't do reassembly and so
+		// (presumably) isn't processing acks.  So don't hold
+		// the now-delivered data.
+		return true;
+
+	if ( e->NoDataAcked() && tcp_max_initial_window &&
+	     e->Size() > static_cast<uint64>(tcp_max_initial_window) )
+		// We've sent quite a bit of data, yet none of it has
+		// been acked.  Presume that we're not seeing the peer's
+		// acks (perhaps due to filtering or split routing) and
+		// don't hang onto the data further, as we may wind up
+		// carrying it all the way until this connection ends.
+		return true;
+
+	return false;
+	}
+
+bool TCP_Reassembler::DeliverDirectly(uint64 seq, int len, const u_char* data)
+	{
+	// Only in-order data with nothing buffered ahead of it qualifies.
+	if ( seq != last_reassem_seq || seq < trim_seq || blocks )
+		return false;
+
+	// Recording to a contents file goes through the blocks.
+	if ( record_contents_file )
+		return false;
+
+	// Old blocks, if we keep them, have to be made from the data.
+	if ( max_old_blocks )
+		return false;
+
+	// Unless we'd let go of the data right away, we need to keep it
+	// around to check retransmissions against.
+	bool release = ReleaseAfterDelivery();
+
+	if ( rexmit_inconsistency && ! release )
+		return false;
+
+	last_reassem_seq += len;
+	DeliverBlock(seq, len, data);
+
+	if ( release )
+		TrimToSeq(last_reassem_seq);
+
+	return true;
+	}
+
+void TCP_Reassembler::UpdateBufferingStats(double t)
+	{
+	uint64 buffered = NumUndeliveredBytes();
+
+	if ( buffered > max_buffered )
+		max_buffered = buffered;
+
+	if ( buffered && ! buffering_since )
+		buffering_since = t;
+
+	else if ( ! buffered && buffering_since )
+		{
+		buffered_time += t - buffering_since;
+		buffering_since = 0.0;
+		}
+	}
+
+bool TCP_Reassembler::HoldingTooLong(double t) const
+	{
+	if ( ! blocks || NumUndeliveredBytes() == 0 )
+		return false;
+
+	switch ( delivery_policy ) {
+	case BifEnum::TCP_DELIVER_IMMEDIATE:
+		return true;
+
+	case BifEnum::TCP_DELIVER_BOUNDED:
+		if ( tcp_delivery_max_buffered &&
+		     NumUndeliveredBytes() >= static_cast<uint64>(tcp_delivery_max_buffered) )
+			return true;
+
+		return tcp_delivery_max_delay > 0 && buffering_since &&
+		       t - buffering_since >= tcp_delivery_max_delay;
+
+	default:
+		return false;
+	}
+	}
+
 int TCP_Reassembler::DataSent(double t, uint64 seq, int len,
 				const u_char* data, TCP_Flags arg_flags, bool replaying)
 	{
@@ -464,6 +581,19 @@ int TCP_Reassembler::DataSent(double t, uint64 seq, int len,
 	if ( skip_deliveries )
 		return 0;
 
+	if ( load_shedder->SkipReassembly(last_reassem_seq) )
+		{
+		// A bulk flow while we're shedding load. Treat the rest like
+		// a filtered trace's missing data, without reporting it.
+		skip_deliveries = 1;
+		return 0;
+		}
+
+	if ( seq < last_reassem_seq )
+		num_rexmit_bytes += std::min(upper_seq, last_reassem_seq) - seq;
+	else if ( seq > last_reassem_seq )
+		++num_out_of_order;
+
 	if ( seq < ack && ! replaying )
 		{
 		if ( upper_seq <= ack )
@@ -481,10 +611,27 @@ int TCP_Reassembler::DataSent(double t, uint64 seq, int len,
 		len -= amount_acked;
 		}
 
+	if ( len > 0 && DeliverDirectly(seq, len, data) )
+		{
+		// Nothing got buffered, so there's nothing to check either.
+		UpdateBufferingStats(t);
+		return 1;
+		}
+
 	flags = arg_flags;
 	NewBlock(t, seq, len, data);
 	flags = TCP_Flags();
 
+	UpdateBufferingStats(t);
+
+	if ( HoldingTooLong(t) )
+		{
+		// Give up on the holes, as if the peer had acked all we
+		// have.
+		TrimToSeq(last_block->upper);
+		UpdateBufferingStats(t);
+		}
+
 	if ( Endpoint()->NoDataAcked() && tcp_max_above_hole_without_any_acks &&
 	     NumUndeliveredBytes() > static_cast<uint64>(tcp_max_above_hole_without_any_acks) )
 		{
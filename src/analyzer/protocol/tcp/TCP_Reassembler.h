@@ -4,6 +4,7 @@
 #include "Reassem.h"
 #include "TCP_Endpoint.h"
 #include "TCP_Flags.h"
+#include "ObjPool.h"
 
 class BroFile;
 class Connection;
@@ -24,6 +25,8 @@ public:
 
 	~TCP_Reassembler() override;
 
+	DECLARE_POOLED_ALLOC()
+
 	void Done();
 
 	void SetDstAnalyzer(Analyzer* analyzer)	{ dst_analyzer = analyzer; }
@@ -55,6 +58,10 @@ public:
 	void SetContentsFile(BroFile* f);
 	BroFile* GetContentsFile() const	{ return record_contents_file; }
 
+	// Sets how long to wait for holes to fill, as one of the
+	// tcp_delivery_policy values.
+	void SetDeliveryPolicy(int policy)	{ delivery_policy = policy; }
+
 	void MatchUndelivered(uint64 up_to_seq, bool use_last_upper);
 
 	// Skip up to seq, as if there's a content gap.
@@ -86,6 +93,10 @@ public:
 	bool IsSkippedContents(uint64 seq, int length) const
 		{ return seq + length <= seq_to_skip; }
 
+	// Returns a reassembly_stats record summarizing the reassembly so
+	// far.
+	RecordVal* BuildStats() const;
+
 private:
 	TCP_Reassembler()	{ }
 
@@ -97,6 +108,24 @@ private:
 	void RecordGap(uint64 start_seq, uint64 upper_seq, BroFile* f);
 
 	void BlockInserted(DataBlock* b) override;
+
+	// Returns true if there's no point in holding on to delivered data
+	// until the peer acks it.
+	bool ReleaseAfterDelivery() const;
+
+	// Hands in-order data to the analyzers straight from the packet,
+	// without copying it into a block first, if nothing needs it
+	// buffered. Returns false if the data has to go through NewBlock()
+	// instead.
+	bool DeliverDirectly(uint64 seq, int len, const u_char* data);
+
+	// Tracks how much data is waiting for holes to fill, and for how
+	// long.
+	void UpdateBufferingStats(double t);
+
+	// Returns true if the delivery policy says to stop waiting for
+	// the current holes to fill.
+	bool HoldingTooLong(double t) const;
 	void Overlap(const u_char* b1, const u_char* b2, uint64 n) override;
 
 	TCP_Endpoint* endp;
@@ -110,6 +139,17 @@ private:
 
 	bool in_delivery;
 	analyzer::tcp::TCP_Flags flags;
+	int delivery_policy;
+
+	// Statistics reported by tcp_reassembly_stats.
+	uint64 num_out_of_order;
+	uint64 num_rexmit_bytes;
+	uint64 num_overlap_bytes;
+	uint64 num_gaps;
+	uint64 num_gap_bytes;
+	uint64 max_buffered;
+	double buffering_since;	// when data started waiting on a hole, or 0
+	double buffered_time;
 
 	BroFile* record_contents_file;	// file on which to reassemble contents
 
@@ -12,7 +12,7 @@ class Plugin : public plugin::Plugin {
 public:
 	plugin::Configuration Configure()
 		{
-		AddComponent(new ::analyzer::Component("Teredo", ::analyzer::teredo::Teredo_Analyzer::Instantiate));
+		AddComponent(new ::analyzer::Component("Teredo", ::analyzer::teredo::Teredo_Analyzer::Instantiate, 0, true, false, ::analyzer::teredo::Teredo_Analyzer::Precheck));
 
 		plugin::Configuration config;
 		config.name = "Zeek::Teredo";
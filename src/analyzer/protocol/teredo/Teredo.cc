@@ -15,6 +15,31 @@ void Teredo_Analyzer::Done()
 	Event(udp_session_done);
 	}
 
+bool Teredo_Analyzer::Precheck(const u_char* data, int len)
+	{
+	if ( len >= 4 && data[0] == 0 && data[1] == 1 )
+		{
+		// Authentication
+		int tot_len = 4 + data[2] + data[3] + 8 + 1;
+		data += tot_len;
+		len -= tot_len;
+		}
+
+	if ( len >= 8 && data[0] == 0 && data[1] == 0 )
+		{
+		// Origin Indication
+		data += 8;
+		len -= 8;
+		}
+
+	if ( len < 40 || (data[0] >> 4) != 6 )
+		return false;
+
+	// The IPv6 payload can't be longer than what's there.
+	int payload_len = (data[4] << 8) | data[5];
+	return 40 + payload_len <= len;
+	}
+
 bool TeredoEncapsulation::DoParse(const u_char* data, int& len,
                                   bool found_origin, bool found_auth)
 	{
@@ -24,6 +24,13 @@ public:
 	static analyzer::Analyzer* Instantiate(Connection* conn)
 		{ return new Teredo_Analyzer(conn); }
 
+	/**
+	 * Returns whether a flow's first payload can be a Teredo packet: an
+	 * IPv6 header that fits, optionally preceded by an authentication
+	 * header and an origin indication.
+	 */
+	static bool Precheck(const u_char* data, int len);
+
 	/**
 	 * Emits a weird only if the analyzer has previously been able to
 	 * decapsulate a Teredo packet in both directions or if *force* param is
@@ -15,6 +15,8 @@
 
 using namespace analyzer::udp;
 
+IMPLEMENT_POOLED_ALLOC(UDP_Analyzer, ANALYZER)
+
 UDP_Analyzer::UDP_Analyzer(Connection* conn)
 : TransportLayerAnalyzer("UDP", conn)
 	{
@@ -62,7 +64,7 @@ void UDP_Analyzer::DeliverPacket(int len, const u_char* data, bool is_orig,
 
 	int chksum = up->uh_sum;
 
-	auto validate_checksum = ! ignore_checksums && caplen >=len;
+	auto validate_checksum = caplen >= len && net_verify_checksums();
 	constexpr auto vxlan_len = 8;
 	constexpr auto eth_len = 14;
 
@@ -204,7 +206,37 @@ void UDP_Analyzer::DeliverPacket(int len, const u_char* data, bool is_orig,
 		}
 
 	if ( caplen >= len )
+		{
+		// An empty payload doesn't tell whether the flow carries the
+		// candidates' protocol, so wait for one that does.
+		if ( ! candidates.empty() && len > 0 )
+			CheckCandidateAnalyzers(data, len);
+
 		ForwardPacket(len, data, is_orig, seq, ip, caplen);
+		}
+	}
+
+void UDP_Analyzer::CheckCandidateAnalyzers(const u_char* data, int len)
+	{
+	for ( const auto& tag : candidates )
+		{
+		analyzer::Component* c = analyzer_mgr->Lookup(tag);
+
+		if ( ! c->Precheck()(data, len) )
+			{
+			c->Rejected();
+			DBG_ANALYZER_ARGS(Conn(), "not activating %s analyzer, payload fails its precheck",
+					  c->CanonicalName().c_str());
+			continue;
+			}
+
+		Analyzer* a = analyzer_mgr->InstantiateAnalyzer(tag, Conn());
+
+		if ( a )
+			AddChildAnalyzer(a);
+		}
+
+	candidates.clear();
 	}
 
 void UDP_Analyzer::UpdateConnVal(RecordVal *conn_val)
@@ -224,14 +256,14 @@ void UDP_Analyzer::UpdateEndpointVal(RecordVal* endp, int is_orig)
 	bro_int_t size = is_orig ? request_len : reply_len;
 	if ( size < 0 )
 		{
-		endp->Assign(0, val_mgr->GetCount(0));
-		endp->Assign(1, val_mgr->GetCount(int(UDP_INACTIVE)));
+		endp->AssignCount(0, 0);
+		endp->AssignCount(1, int(UDP_INACTIVE));
 		}
 
 	else
 		{
-		endp->Assign(0, val_mgr->GetCount(size));
-		endp->Assign(1, val_mgr->GetCount(int(UDP_ACTIVE)));
+		endp->AssignCount(0, size);
+		endp->AssignCount(1, int(UDP_ACTIVE));
 		}
 	}
 
@@ -3,9 +3,12 @@
 #ifndef ANALYZER_PROTOCOL_UDP_UDP_H
 #define ANALYZER_PROTOCOL_UDP_UDP_H
 
-#include "analyzer/Analyzer.h"
+#include <vector>
 #include <netinet/udp.h>
 
+#include "analyzer/Analyzer.h"
+#include "ObjPool.h"
+
 namespace analyzer { namespace udp {
 
 typedef enum {
@@ -18,12 +21,21 @@ public:
 	explicit UDP_Analyzer(Connection* conn);
 	~UDP_Analyzer() override;
 
+	DECLARE_POOLED_ALLOC()
+
 	void Init() override;
 	void UpdateConnVal(RecordVal *conn_val) override;
 
 	static analyzer::Analyzer* Instantiate(Connection* conn)
 		{ return new UDP_Analyzer(conn); }
 
+	// Adds an analyzer to instantiate once the flow's first non-empty
+	// payload passes the analyzer component's precheck.
+	void AddCandidateAnalyzer(const analyzer::Tag& tag)
+		{ candidates.push_back(tag); }
+
+	bool HasCandidateAnalyzers() const	{ return ! candidates.empty(); }
+
 protected:
 	void Done() override;
 	void DeliverPacket(int len, const u_char* data, bool orig,
@@ -33,6 +45,10 @@ protected:
 
 	void ChecksumEvent(bool is_orig, uint32 threshold);
 
+	// Instantiates the candidate analyzers whose prechecks the payload
+	// passes, and drops the others.
+	void CheckCandidateAnalyzers(const u_char* data, int len);
+
 	// Returns true if the checksum is valid, false if not
 	static bool ValidateChecksum(const IP_Hdr* ip, const struct udphdr* up,
 	                             int len);
@@ -50,6 +66,8 @@ private:
 	// For tracking checksum history.
 	uint32 req_chk_cnt, req_chk_thresh;
 	uint32 rep_chk_cnt, rep_chk_thresh;
+
+	std::vector<analyzer::Tag> candidates;
 };
 
 } } // namespace analyzer::* 
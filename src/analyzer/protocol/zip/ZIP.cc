@@ -1,38 +1,95 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
+#include <vector>
+
 #include "ZIP.h"
 
 using namespace analyzer::zip;
 
+// Window bits for auto-detecting gzip and zlib headers. "32" is a gross
+// overload hack that means "check it for whether it's a gzip file".
+// Sheesh.
+static const int AUTO_WBITS = MAX_WBITS + 32;
+
+// Number of idle inflate contexts we hold on to. Setting up a context
+// allocates its 32KB window, which we'd otherwise do for every single
+// compressed body.
+static const size_t MAX_IDLE_CONTEXTS = 16;
+
+// Size of the buffer we inflate into, and thus of the chunks we pass on.
+static const unsigned int UNZIP_BUF_SIZE = 16 * 1024;
+
+static std::vector<z_stream*>& idle_contexts()
+	{
+	static std::vector<z_stream*>* contexts = new std::vector<z_stream*>;
+	return *contexts;
+	}
+
+// Returns an inflate context ready to go, or null on failure.
+static z_stream* acquire_context()
+	{
+	std::vector<z_stream*>& idle = idle_contexts();
+
+	if ( ! idle.empty() )
+		{
+		z_stream* z = idle.back();
+		idle.pop_back();
+
+		if ( inflateReset2(z, AUTO_WBITS) == Z_OK )
+			return z;
+
+		inflateEnd(z);
+		delete z;
+		}
+
+	z_stream* z = new z_stream;
+	z->zalloc = 0;
+	z->zfree = 0;
+	z->opaque = 0;
+	z->next_out = 0;
+	z->avail_out = 0;
+	z->next_in = 0;
+	z->avail_in = 0;
+
+	if ( inflateInit2(z, AUTO_WBITS) != Z_OK )
+		{
+		delete z;
+		return 0;
+		}
+
+	return z;
+	}
+
+static void release_context(z_stream* z)
+	{
+	std::vector<z_stream*>& idle = idle_contexts();
+
+	if ( idle.size() < MAX_IDLE_CONTEXTS )
+		{
+		idle.push_back(z);
+		return;
+		}
+
+	inflateEnd(z);
+	delete z;
+	}
+
 ZIP_Analyzer::ZIP_Analyzer(Connection* conn, bool orig, Method arg_method)
 : tcp::TCP_SupportAnalyzer("ZIP", conn, orig)
 	{
-	zip = 0;
 	zip_status = Z_OK;
 	method = arg_method;
 
-	zip = new z_stream;
-	zip->zalloc = 0;
-	zip->zfree = 0;
-	zip->opaque = 0;
-	zip->next_out = 0;
-	zip->avail_out = 0;
-	zip->next_in = 0;
-	zip->avail_in = 0;
-
-	// "32" is a gross overload hack that means "check it
-	// for whether it's a gzip file".  Sheesh.
-	if ( inflateInit2(zip, MAX_WBITS + 32) != Z_OK )
-		{
+	zip = acquire_context();
+
+	if ( ! zip )
 		Weird("inflate_init_failed");
-		delete zip;
-		zip = 0;
-		}
 	}
 
 ZIP_Analyzer::~ZIP_Analyzer()
 	{
-	delete zip;
+	if ( zip )
+		release_context(zip);
 	}
 
 void ZIP_Analyzer::Done()
@@ -40,18 +97,20 @@ void ZIP_Analyzer::Done()
 	Analyzer::Done();
 
 	if ( zip )
-		inflateEnd(zip);
+		{
+		release_context(zip);
+		zip = 0;
+		}
 	}
 
 void ZIP_Analyzer::DeliverStream(int len, const u_char* data, bool orig)
 	{
 	tcp::TCP_SupportAnalyzer::DeliverStream(len, data, orig);
 
-	if ( ! len || zip_status != Z_OK )
+	if ( ! len || ! zip || zip_status != Z_OK )
 		return;
 
-	static unsigned int unzip_size = 4096;
-	Bytef unzipbuf[unzip_size];
+	Bytef unzipbuf[UNZIP_BUF_SIZE];
 
 	int allow_restart = 1;
 
@@ -64,7 +123,7 @@ void ZIP_Analyzer::DeliverStream(int len, const u_char* data, bool orig)
 	while ( true )
 		{
 		zip->next_out = unzipbuf;
-		zip->avail_out = unzip_size;
+		zip->avail_out = UNZIP_BUF_SIZE;
 
 		zip_status = inflate(zip, Z_SYNC_FLUSH);
 
@@ -73,13 +132,16 @@ void ZIP_Analyzer::DeliverStream(int len, const u_char* data, bool orig)
 			{
 			allow_restart = 0;
 
-			int have = unzip_size - zip->avail_out;
+			int have = UNZIP_BUF_SIZE - zip->avail_out;
 			if ( have )
 				ForwardStream(have, unzipbuf, IsOrig());
 
 			if ( zip_status == Z_STREAM_END )
 				{
-				inflateEnd(zip);
+				// Nothing more to do for us, so others may
+				// use the context.
+				release_context(zip);
+				zip = 0;
 				return;
 				}
 
@@ -92,9 +154,7 @@ void ZIP_Analyzer::DeliverStream(int len, const u_char* data, bool orig)
 			{
 			// Some servers seem to not generate zlib headers,
 			// so this is an attempt to fix and continue anyway.
-			inflateEnd(zip);
-
-			if ( inflateInit2(zip, -MAX_WBITS) != Z_OK )
+			if ( inflateReset2(zip, -MAX_WBITS) != Z_OK )
 				{
 				Weird("inflate_init_failed");
 				return;
@@ -38,6 +38,41 @@
 static const char *bro_inet_ntop4(const u_char *src, char *dst, socklen_t size);
 static const char *bro_inet_ntop6(const u_char *src, char *dst, socklen_t size);
 
+/*
+ * Digit conversion without going through printf, which dominated the
+ * cost of formatting addresses for logs.
+ */
+static char *
+put_dec8(u_int v, char *p)
+{
+	if (v >= 100) {
+		*p++ = '0' + v / 100;
+		v %= 100;
+		*p++ = '0' + v / 10;
+		*p++ = '0' + v % 10;
+	} else if (v >= 10) {
+		*p++ = '0' + v / 10;
+		*p++ = '0' + v % 10;
+	} else
+		*p++ = '0' + v;
+	return (p);
+}
+
+static char *
+put_hex16(u_int v, char *p)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	if (v >= 0x1000)
+		*p++ = hex[v >> 12];
+	if (v >= 0x100)
+		*p++ = hex[(v >> 8) & 0xf];
+	if (v >= 0x10)
+		*p++ = hex[(v >> 4) & 0xf];
+	*p++ = hex[v & 0xf];
+	return (p);
+}
+
 /* char *
  * bro_inet_ntop(af, src, dst, size)
  *	convert a network format address to presentation format.
@@ -76,17 +111,22 @@ bro_inet_ntop(int af, const void * __restrict src, char * __restrict dst,
 static const char *
 bro_inet_ntop4(const u_char *src, char *dst, socklen_t size)
 {
-	static const char fmt[] = "%u.%u.%u.%u";
-	char tmp[sizeof "255.255.255.255"];
-	int l;
+	char tmp[sizeof "255.255.255.255"], *tp;
+	int i, l;
 
-	l = snprintf(tmp, sizeof(tmp), fmt, src[0], src[1], src[2], src[3]);
-	if (l <= 0 || (socklen_t) l >= size) {
+	tp = tmp;
+	for (i = 0; i < 4; i++) {
+		if (i != 0)
+			*tp++ = '.';
+		tp = put_dec8(src[i], tp);
+	}
+	l = tp - tmp;
+	if ((socklen_t) l >= size) {
 		errno = ENOSPC;
 		return (NULL);
 	}
-	strncpy(dst, tmp, size - 1);
-	dst[size - 1] = 0;
+	memcpy(dst, tmp, l);
+	dst[l] = 0;
 	return (dst);
 }
 
@@ -169,7 +209,7 @@ bro_inet_ntop6(const u_char *src, char *dst, socklen_t size)
 			tp += strlen(tp);
 			break;
 		}
-		tp += sprintf(tp, "%x", words[i]);
+		tp = put_hex16(words[i], tp);
 	}
 	/* Was it a trailing run of 0x00's? */
 	if (best.base != -1 && (best.base + best.len) ==
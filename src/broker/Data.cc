@@ -1,7 +1,11 @@
 #include "Data.h"
 #include "File.h"
+#include "net_util.h"
 #include "broker/data.bif.h"
 
+#include <cstring>
+#include <unordered_map>
+
 #include <broker/error.hh>
 
 #include <caf/stream_serializer.hpp>
@@ -50,6 +54,304 @@ TransportProto bro_broker::to_bro_port_proto(broker::port::protocol tp)
 	}
 	}
 
+// Records whose fields all have a fixed size may be packed into a single
+// string: a marker byte, then per field a byte telling whether it's set,
+// followed by its value in network byte order.  Nested records of that
+// kind are packed in place, without a marker of their own.  Enums don't
+// qualify, as their values can differ between nodes.
+static const char compact_record_marker = '\xc0';
+
+static bool is_fixed_layout(RecordType* rt)
+	{
+	// Record types live until termination, so their layout is figured
+	// out only once.
+	static std::unordered_map<const RecordType*, bool> layouts;
+
+	auto it = layouts.find(rt);
+
+	if ( it != layouts.end() )
+		return it->second;
+
+	// Stops the recursion for records that contain themselves.
+	layouts[rt] = false;
+	bool fixed = true;
+
+	for ( auto i = 0; fixed && i < rt->NumFields(); ++i )
+		{
+		auto ft = rt->FieldType(i);
+
+		switch ( ft->Tag() ) {
+		case TYPE_BOOL:
+		case TYPE_INT:
+		case TYPE_COUNT:
+		case TYPE_COUNTER:
+		case TYPE_DOUBLE:
+		case TYPE_TIME:
+		case TYPE_INTERVAL:
+		case TYPE_ADDR:
+		case TYPE_SUBNET:
+		case TYPE_PORT:
+			break;
+		case TYPE_RECORD:
+			fixed = is_fixed_layout(ft->AsRecordType());
+			break;
+		default:
+			fixed = false;
+			break;
+		}
+		}
+
+	layouts[rt] = fixed;
+	return fixed;
+	}
+
+static void pack_uint(std::string& buf, uint64 u)
+	{
+	u = htonll(u);
+	buf.append(reinterpret_cast<const char*>(&u), sizeof(u));
+	}
+
+static bool pack_record(std::string& buf, RecordVal* rec)
+	{
+	auto num_fields = rec->Type()->AsRecordType()->NumFields();
+
+	for ( auto i = 0; i < num_fields; ++i )
+		{
+		auto v = rec->LookupWithDefault(i);
+
+		if ( ! v )
+			{
+			buf += '\0';
+			continue;
+			}
+
+		buf += '\1';
+		bool ok = true;
+
+		switch ( v->Type()->Tag() ) {
+		case TYPE_BOOL:
+			buf += v->AsBool() ? '\1' : '\0';
+			break;
+		case TYPE_INT:
+			pack_uint(buf, static_cast<uint64>(v->AsInt()));
+			break;
+		case TYPE_COUNT:
+		case TYPE_COUNTER:
+			pack_uint(buf, v->AsCount());
+			break;
+		case TYPE_DOUBLE:
+		case TYPE_TIME:
+		case TYPE_INTERVAL:
+			{
+			auto d = v->InternalDouble();
+			uint64 u;
+			memcpy(&u, &d, sizeof(u));
+			pack_uint(buf, u);
+			break;
+			}
+		case TYPE_ADDR:
+			{
+			in6_addr tmp;
+			v->AsAddr().CopyIPv6(&tmp);
+			buf.append(reinterpret_cast<const char*>(&tmp), sizeof(tmp));
+			break;
+			}
+		case TYPE_SUBNET:
+			{
+			auto& sn = v->AsSubNet();
+			in6_addr tmp;
+			sn.Prefix().CopyIPv6(&tmp);
+			buf.append(reinterpret_cast<const char*>(&tmp), sizeof(tmp));
+			buf += static_cast<char>(sn.Length());
+			break;
+			}
+		case TYPE_PORT:
+			{
+			auto p = v->AsPortVal();
+			uint16 n = htons(p->Port());
+			buf.append(reinterpret_cast<const char*>(&n), sizeof(n));
+			buf += static_cast<char>(p->PortType());
+			break;
+			}
+		case TYPE_RECORD:
+			ok = pack_record(buf, v->AsRecordVal());
+			break;
+		default:
+			ok = false;
+			break;
+		}
+
+		Unref(v);
+
+		if ( ! ok )
+			return false;
+		}
+
+	return true;
+	}
+
+static bool unpack_uint(const char*& p, const char* end, uint64& u)
+	{
+	if ( end - p < static_cast<ptrdiff_t>(sizeof(u)) )
+		return false;
+
+	memcpy(&u, p, sizeof(u));
+	u = ntohll(u);
+	p += sizeof(u);
+	return true;
+	}
+
+// Unpacks the fields of a record of the given type from the buffer,
+// assigning them to rv if that's set, else only checking that they are
+// there.
+static bool unpack_record(const char*& p, const char* end, RecordType* rt,
+                          RecordVal* rv)
+	{
+	for ( auto i = 0; i < rt->NumFields(); ++i )
+		{
+		if ( p >= end )
+			return false;
+
+		auto is_set = *p++;
+
+		if ( is_set == '\0' )
+			continue;
+
+		if ( is_set != '\1' )
+			return false;
+
+		auto ft = rt->FieldType(i);
+		Val* v = nullptr;
+
+		switch ( ft->Tag() ) {
+		case TYPE_BOOL:
+			if ( p >= end )
+				return false;
+
+			if ( rv )
+				v = val_mgr->GetBool(*p != '\0');
+
+			++p;
+			break;
+		case TYPE_INT:
+		case TYPE_COUNT:
+		case TYPE_COUNTER:
+			{
+			uint64 u;
+
+			if ( ! unpack_uint(p, end, u) )
+				return false;
+
+			if ( ! rv )
+				break;
+
+			if ( ft->Tag() == TYPE_INT )
+				v = val_mgr->GetInt(static_cast<int64>(u));
+			else
+				v = val_mgr->GetCount(u);
+
+			break;
+			}
+		case TYPE_DOUBLE:
+		case TYPE_TIME:
+		case TYPE_INTERVAL:
+			{
+			uint64 u;
+
+			if ( ! unpack_uint(p, end, u) )
+				return false;
+
+			if ( ! rv )
+				break;
+
+			double d;
+			memcpy(&d, &u, sizeof(d));
+			v = new Val(d, ft->Tag());
+			break;
+			}
+		case TYPE_ADDR:
+		case TYPE_SUBNET:
+			{
+			in6_addr tmp;
+			auto size = static_cast<ptrdiff_t>(sizeof(tmp));
+
+			if ( ft->Tag() == TYPE_SUBNET )
+				++size;
+
+			if ( end - p < size )
+				return false;
+
+			memcpy(&tmp, p, sizeof(tmp));
+			p += sizeof(tmp);
+
+			if ( ft->Tag() == TYPE_SUBNET )
+				{
+				auto len = static_cast<uint8>(*p++);
+
+				if ( rv )
+					v = new SubNetVal(IPPrefix(IPAddr(tmp), len));
+				}
+			else if ( rv )
+				v = new AddrVal(IPAddr(tmp));
+
+			break;
+			}
+		case TYPE_PORT:
+			{
+			uint16 n;
+
+			if ( end - p < static_cast<ptrdiff_t>(sizeof(n) + 1) )
+				return false;
+
+			memcpy(&n, p, sizeof(n));
+			p += sizeof(n);
+			auto proto = static_cast<uint8>(*p++);
+
+			if ( proto > TRANSPORT_ICMP )
+				return false;
+
+			if ( rv )
+				v = val_mgr->GetPort(ntohs(n), static_cast<TransportProto>(proto));
+
+			break;
+			}
+		case TYPE_RECORD:
+			{
+			auto frt = ft->AsRecordType();
+			auto frv = rv ? new RecordVal(frt) : nullptr;
+
+			if ( ! unpack_record(p, end, frt, frv) )
+				{
+				Unref(frv);
+				return false;
+				}
+
+			v = frv;
+			break;
+			}
+		default:
+			return false;
+		}
+
+		if ( rv )
+			rv->Assign(i, v);
+		}
+
+	return true;
+	}
+
+// Unpacks a record packed by pack_record() as for unpack_record().
+static bool unpack_compact_record(const std::string& a, RecordType* rt,
+                                  RecordVal* rv)
+	{
+	if ( a.empty() || a[0] != compact_record_marker || ! is_fixed_layout(rt) )
+		return false;
+
+	auto p = a.data() + 1;
+	auto end = a.data() + a.size();
+	return unpack_record(p, end, rt, rv) && p == end;
+	}
+
 struct val_converter {
 	using result_type = Val*;
 
@@ -102,6 +404,17 @@ struct val_converter {
 			if ( file )
 				return new Val(file);
 
+			return nullptr;
+			}
+		case TYPE_RECORD:
+			{
+			auto rt = type->AsRecordType();
+			auto rval = new RecordVal(rt);
+
+			if ( unpack_compact_record(a, rt, rval) )
+				return rval;
+
+			Unref(rval);
 			return nullptr;
 			}
 		default:
@@ -183,6 +496,9 @@ struct val_converter {
 		auto tt = type->AsTableType();
 		auto rval = new TableVal(tt);
 
+		// Spares growing the table as the elements come in.
+		rval->Reserve(a.size());
+
 		for ( auto& item : a )
 			{
 			auto expected_index_types = tt->Indices()->Types();
@@ -250,6 +566,7 @@ struct val_converter {
 
 		auto tt = type->AsTableType();
 		auto rval = new TableVal(tt);
+		rval->Reserve(a.size());
 
 		for ( auto& item : a )
 			{
@@ -326,6 +643,8 @@ struct val_converter {
 			{
 			auto vt = type->AsVectorType();
 			auto rval = new VectorVal(vt);
+			rval->Resize(a.size());
+			auto idx = 0u;
 
 			for ( auto& item : a )
 				{
@@ -337,7 +656,7 @@ struct val_converter {
 					return nullptr;
 					}
 
-				rval->Assign(rval->Size(), item_val);
+				rval->Assign(idx++, item_val);
 				}
 
 			return rval;
@@ -497,6 +816,8 @@ struct type_checker {
 			return true;
 		case TYPE_FILE:
 			return true;
+		case TYPE_RECORD:
+			return unpack_compact_record(a, type->AsRecordType(), nullptr);
 		default:
 			return false;
 		}
@@ -788,18 +1109,24 @@ static bool data_type_check(const broker::data& d, BroType* t)
 	if ( t->Tag() == TYPE_ANY )
 		return true;
 
+	// See data_to_val().
+	if ( same_type(t, bro_broker::DataVal::ScriptDataType()) )
+		return true;
+
 	return caf::visit(type_checker{t}, d);
 	}
 
 Val* bro_broker::data_to_val(broker::data d, BroType* type)
 	{
-	if ( type->Tag() == TYPE_ANY )
+	// Like for "any", but also the inverse of val_to_data() unwrapping
+	// Broker::Data values.
+	if ( type->Tag() == TYPE_ANY || same_type(type, DataVal::ScriptDataType()) )
 		return bro_broker::make_data_val(move(d));
 
 	return caf::visit(val_converter{type}, std::move(d));
 	}
 
-broker::expected<broker::data> bro_broker::val_to_data(Val* v)
+broker::expected<broker::data> bro_broker::val_to_data(Val* v, bool compact)
 	{
 	switch ( v->Type()->Tag() ) {
 	case TYPE_BOOL:
@@ -931,10 +1258,13 @@ broker::expected<broker::data> bro_broker::val_to_data(Val* v)
 
 			for ( auto k = 0; k < vl->Length(); ++k )
 				{
-				auto key_part = val_to_data((*vl->Vals())[k]);
+				auto key_part = val_to_data((*vl->Vals())[k], compact);
 
 				if ( ! key_part )
+					{
+					table->StopIteration(c);
 					return broker::ec::invalid_data;
+					}
 
 				composite_key.emplace_back(move(*key_part));
 				}
@@ -950,10 +1280,13 @@ broker::expected<broker::data> bro_broker::val_to_data(Val* v)
 				caf::get<broker::set>(rval).emplace(move(key));
 			else
 				{
-				auto val = val_to_data(entry->Value());
+				auto val = val_to_data(entry->Value(), compact);
 
 				if ( ! val )
+					{
+					table->StopIteration(c);
 					return broker::ec::invalid_data;
+					}
 
 				caf::get<broker::table>(rval).emplace(move(key), move(*val));
 				}
@@ -974,7 +1307,7 @@ broker::expected<broker::data> bro_broker::val_to_data(Val* v)
 			if ( ! item_val )
 				continue;
 
-			auto item = val_to_data(item_val);
+			auto item = val_to_data(item_val, compact);
 
 			if ( ! item )
 				return broker::ec::invalid_data;
@@ -987,6 +1320,27 @@ broker::expected<broker::data> bro_broker::val_to_data(Val* v)
 	case TYPE_RECORD:
 		{
 		auto rec = v->AsRecordVal();
+
+		// Values that are already Broker data, like the keys a store
+		// returns, convert to what they wrap rather than to a record.
+		if ( same_type(v->Type(), DataVal::ScriptDataType()) )
+			{
+			auto d = rec->Lookup(0);
+
+			if ( ! d )
+				return broker::ec::invalid_data;
+
+			return static_cast<DataVal*>(d)->data;
+			}
+
+		if ( compact && is_fixed_layout(v->Type()->AsRecordType()) )
+			{
+			std::string buf(1, compact_record_marker);
+
+			if ( pack_record(buf, rec) )
+				return {std::move(buf)};
+			}
+
 		broker::vector rval;
 		size_t num_fields = v->Type()->AsRecordType()->NumFields();
 		rval.reserve(num_fields);
@@ -1001,7 +1355,7 @@ broker::expected<broker::data> bro_broker::val_to_data(Val* v)
 				continue;
 				}
 
-			auto item = val_to_data(item_val);
+			auto item = val_to_data(item_val, compact);
 			Unref(item_val);
 
 			if ( ! item )
@@ -1038,10 +1392,10 @@ broker::expected<broker::data> bro_broker::val_to_data(Val* v)
 	return broker::ec::invalid_data;
 	}
 
-RecordVal* bro_broker::make_data_val(Val* v)
+RecordVal* bro_broker::make_data_val(Val* v, bool compact)
 	{
 	auto rval = new RecordVal(BifType::Record::Broker::Data);
-	auto data = val_to_data(v);
+	auto data = val_to_data(v, compact);
 
 	if  ( data )
 		rval->Assign(0, new DataVal(move(*data)));
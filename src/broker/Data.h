@@ -25,10 +25,12 @@ TransportProto to_bro_port_proto(broker::port::protocol tp);
 /**
  * Create a Broker::Data value from a Bro value.
  * @param v the Bro value to convert to a Broker data value.
+ * @param compact whether to pack records of fixed-size fields, see
+ * val_to_data().
  * @return a Broker::Data value, where the optional field is set if the conversion
  * was possible, else it is unset.
  */
-RecordVal* make_data_val(Val* v);
+RecordVal* make_data_val(Val* v, bool compact = false);
 
 /**
  * Create a Broker::Data value from a Broker data value.
@@ -48,9 +50,12 @@ EnumVal* get_data_type(RecordVal* v, Frame* frame);
 /**
  * Convert a Bro value to a Broker data value.
  * @param v a Bro value.
+ * @param compact whether to pack records whose fields all have a fixed size,
+ * at any nesting level, into a single string instead of a vector.  Only
+ * data_to_val() knows to unpack those, given the record type.
  * @return a Broker data value if the Bro value could be converted to one.
  */
-broker::expected<broker::data> val_to_data(Val* v);
+broker::expected<broker::data> val_to_data(Val* v, bool compact = false);
 
 /**
  * Convert a Broker data value to a Bro value.
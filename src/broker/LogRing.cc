@@ -0,0 +1,398 @@
+
+#include "zeek-config.h"
+
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <caf/stream_serializer.hpp>
+#include <caf/stream_deserializer.hpp>
+#include <caf/streambuf.hpp>
+
+#include "broker/LogRing.h"
+#include "broker/Manager.h"
+#include "Net.h"
+#include "Reporter.h"
+
+using namespace bro_broker;
+
+static const uint64_t LOG_RING_MAGIC = 0x5a45454b4c4f4731ULL; // "ZEEKLOG1"
+
+// Records are a 32-bit length followed by the message, padded to this.
+static const size_t RECORD_ALIGN = 8;
+
+// Length marking that the rest of the data area is unused, and the next
+// record starts back at the beginning.
+static const uint32_t RECORD_WRAP = 0xffffffff;
+
+// How often a writer tries for the lock before checking on its holder.
+// Holding it just means copying a message in, so contention resolves
+// quickly; if it doesn't, the holder has probably died.
+static const int MAX_LOCK_SPINS = 100000;
+
+// How long Flush() waits for the reader to empty the ring, in seconds.
+static const double FLUSH_TIMEOUT = 1.0;
+
+// The positions are running byte counts, the offset into the data area is
+// their remainder. Each sits on a cache line of its own, as they're
+// updated by different processes.
+struct LogRing::Header {
+	uint64_t magic;
+	uint64_t size;	// Size of the data area.
+	std::atomic<uint32_t> closed;	// Set once the reader has gone away.
+	alignas(64) std::atomic<uint32_t> lock;	// PID of the writer putting, or 0.
+	std::atomic<uint64_t> head;	// Where the next record goes.
+	alignas(64) std::atomic<uint64_t> tail;	// Where the next record to get starts.
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+	      "shared memory ring needs address-free atomics");
+
+size_t LogRing::HeaderSize()
+	{
+	return (sizeof(Header) + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+	}
+
+static size_t record_size(size_t len)
+	{
+	return (sizeof(uint32_t) + len + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+	}
+
+LogRing::LogRing()
+	{
+	header = 0;
+	data = 0;
+	mapped_size = 0;
+	owner = false;
+	}
+
+LogRing::~LogRing()
+	{
+	Close();
+	}
+
+bool LogRing::Map(int fd, size_t size)
+	{
+	void* m = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if ( m == MAP_FAILED )
+		return false;
+
+	header = static_cast<Header*>(m);
+	data = static_cast<char*>(m) + HeaderSize();
+	mapped_size = size;
+	return true;
+	}
+
+bool LogRing::Create(const std::string& arg_name, size_t size)
+	{
+	Close();
+
+	size = (size + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+
+	// Writers still attached to a ring left behind keep it alive, but
+	// they'll notice it being closed and come over to this one.
+	int fd = shm_open(arg_name.c_str(), O_RDWR, 0);
+
+	if ( fd >= 0 )
+		{
+		if ( Map(fd, sizeof(Header)) )
+			{
+			header->closed.store(1, std::memory_order_release);
+			munmap(header, mapped_size);
+			header = 0;
+			}
+
+		shm_unlink(arg_name.c_str());
+		}
+
+	fd = shm_open(arg_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+	if ( fd < 0 || ftruncate(fd, HeaderSize() + size) < 0 )
+		{
+		reporter->Error("cannot create shared memory log ring %s: %s",
+				arg_name.c_str(), strerror(errno));
+
+		if ( fd >= 0 )
+			{
+			close(fd);
+			shm_unlink(arg_name.c_str());
+			}
+
+		return false;
+		}
+
+	if ( ! Map(fd, HeaderSize() + size) )
+		{
+		reporter->Error("cannot map shared memory log ring %s: %s",
+				arg_name.c_str(), strerror(errno));
+		shm_unlink(arg_name.c_str());
+		return false;
+		}
+
+	header->size = size;
+	header->closed.store(0, std::memory_order_relaxed);
+	header->lock.store(0, std::memory_order_relaxed);
+	header->head.store(0, std::memory_order_relaxed);
+	header->tail.store(0, std::memory_order_relaxed);
+
+	// Writers check this last.
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = LOG_RING_MAGIC;
+
+	name = arg_name;
+	owner = true;
+	return true;
+	}
+
+bool LogRing::Attach(const std::string& arg_name)
+	{
+	Close();
+
+	int fd = shm_open(arg_name.c_str(), O_RDWR, 0);
+
+	if ( fd < 0 )
+		return false;
+
+	struct stat st;
+
+	if ( fstat(fd, &st) < 0 || size_t(st.st_size) <= HeaderSize() )
+		{
+		// Not set up yet.
+		close(fd);
+		return false;
+		}
+
+	if ( ! Map(fd, st.st_size) )
+		return false;
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	if ( header->magic != LOG_RING_MAGIC ||
+	     header->size != mapped_size - HeaderSize() )
+		{
+		Close();
+		return false;
+		}
+
+	name = arg_name;
+	owner = false;
+	return true;
+	}
+
+void LogRing::Close()
+	{
+	if ( ! header )
+		return;
+
+	if ( owner )
+		{
+		header->closed.store(1, std::memory_order_release);
+		shm_unlink(name.c_str());
+		}
+
+	munmap(header, mapped_size);
+	header = 0;
+	data = 0;
+	mapped_size = 0;
+	owner = false;
+	name.clear();
+	}
+
+bool LogRing::IsOpen() const
+	{
+	return header && (owner || ! header->closed.load(std::memory_order_acquire));
+	}
+
+bool LogRing::Empty() const
+	{
+	return ! header ||
+		header->tail.load(std::memory_order_relaxed) ==
+		header->head.load(std::memory_order_acquire);
+	}
+
+bool LogRing::Put(const broker::data& msg)
+	{
+	if ( ! IsOpen() )
+		return false;
+
+	buffer.clear();
+	caf::vectorbuf sb{buffer};
+	caf::stream_serializer<caf::vectorbuf&> sink{sb};
+
+	if ( sink(const_cast<broker::data&>(msg)) )
+		return false;
+
+	size_t len = buffer.size();
+	uint64_t size = header->size;
+	size_t needed = record_size(len);
+
+	if ( needed > size / 2 )
+		// Would hog the ring.
+		return false;
+
+	if ( ! Lock() )
+		return false;
+
+	uint64_t head = header->head.load(std::memory_order_relaxed);
+	uint64_t tail = header->tail.load(std::memory_order_acquire);
+	size_t offset = head % size;
+	size_t skip = 0;
+
+	if ( offset + needed > size )
+		// Doesn't fit in before the end, start over at the beginning.
+		skip = size - offset;
+
+	bool fits = (head - tail) + skip + needed <= size;
+
+	if ( fits )
+		{
+		if ( skip )
+			{
+			memcpy(data + offset, &RECORD_WRAP, sizeof(RECORD_WRAP));
+			offset = 0;
+			}
+
+		uint32_t len32 = len;
+		memcpy(data + offset, &len32, sizeof(len32));
+		memcpy(data + offset + sizeof(len32), buffer.data(), len);
+		header->head.store(head + skip + needed, std::memory_order_release);
+		}
+
+	header->lock.store(0, std::memory_order_release);
+	return fits;
+	}
+
+bool LogRing::Lock()
+	{
+	uint32_t self = getpid();
+	uint32_t holder = 0;
+	int spins = 0;
+
+	while ( ! header->lock.compare_exchange_weak(holder, self, std::memory_order_acquire) )
+		{
+		if ( holder && ++spins > MAX_LOCK_SPINS )
+			{
+			// A writer that died while holding the lock can't have
+			// published anything yet, so we may just take over.
+			if ( kill(holder, 0) == 0 || errno != ESRCH )
+				return false;
+
+			if ( header->lock.compare_exchange_strong(holder, self, std::memory_order_acquire) )
+				{
+				reporter->Warning("resetting lock of log ring %s held by exited process %u",
+						  name.c_str(), holder);
+				return true;
+				}
+
+			spins = 0;
+			}
+
+		holder = 0;
+		}
+
+	return true;
+	}
+
+bool LogRing::Flush()
+	{
+	double deadline = current_time(true) + FLUSH_TIMEOUT;
+
+	while ( ! Empty() )
+		{
+		if ( ! IsOpen() || current_time(true) > deadline )
+			return false;
+
+		// There's nothing to wait on across processes; the reader
+		// drains the ring in its main loop, so give it some time.
+		usleep(1000);
+		}
+
+	return true;
+	}
+
+bool LogRing::Get(broker::data* msg)
+	{
+	if ( ! header )
+		return false;
+
+	uint64_t size = header->size;
+	uint64_t tail = header->tail.load(std::memory_order_relaxed);
+	uint64_t head = header->head.load(std::memory_order_acquire);
+
+	if ( tail == head )
+		return false;
+
+	size_t offset = tail % size;
+	uint32_t len;
+	memcpy(&len, data + offset, sizeof(len));
+
+	if ( len == RECORD_WRAP )
+		{
+		tail += size - offset;
+		offset = 0;
+		memcpy(&len, data, sizeof(len));
+		}
+
+	caf::arraybuf<char> ab{data + offset + sizeof(len), len};
+	caf::stream_deserializer<caf::arraybuf<char>&> source{ab};
+	bool ok = ! source(*msg);
+
+	// Only now may writers reuse the space.
+	header->tail.store(tail + record_size(len), std::memory_order_release);
+
+	if ( ! ok )
+		{
+		reporter->Warning("ignoring undecodable message in log ring %s", name.c_str());
+		*msg = broker::data{};
+		}
+
+	return true;
+	}
+
+LogRingReader::LogRingReader(LogRing* arg_ring)
+	{
+	ring = arg_ring;
+	}
+
+LogRingReader::~LogRingReader()
+	{
+	delete ring;
+	}
+
+void LogRingReader::GetFds(iosource::FD_Set* read, iosource::FD_Set* write,
+                           iosource::FD_Set* except)
+	{
+	}
+
+double LogRingReader::NextTimestamp(double* network_time)
+	{
+	return ring->Empty() ? -1.0 : timer_mgr->Time();
+	}
+
+void LogRingReader::Process()
+	{
+	// Bound the work per round so that we don't starve other sources
+	// while the writers keep up with us.
+	static const int MAX_MESSAGES = 1000;
+
+	broker::data msg;
+
+	for ( int i = 0; i < MAX_MESSAGES && ring->Get(&msg); ++i )
+		{
+		try
+			{
+			broker_mgr->DispatchMessage(broker::topic{}, std::move(msg));
+			}
+		catch ( std::runtime_error& e )
+			{
+			reporter->Warning("ignoring invalid message in log ring: %s", e.what());
+			}
+		}
+	}
@@ -0,0 +1,144 @@
+#ifndef BRO_COMM_LOGRING_H
+#define BRO_COMM_LOGRING_H
+
+#include <broker/data.hh>
+
+#include <string>
+#include <vector>
+
+#include "iosource/IOSource.h"
+
+namespace bro_broker {
+
+/**
+ * A ring buffer in POSIX shared memory that carries log messages from the
+ * Zeek processes on a host to the local logger, bypassing Broker's
+ * publish/subscribe machinery and the TCP loopback. The logger creates the
+ * ring; any number of other processes can attach to it and put messages
+ * in. Messages are Broker's LogCreate and LogWrite messages, of which the
+ * latter already carry the rows in their compact binary serialization.
+ */
+class LogRing {
+public:
+	/**
+	 * Constructor. The ring starts out closed.
+	 */
+	LogRing();
+
+	/**
+	 * Destructor. Closes the ring.
+	 */
+	~LogRing();
+
+	/**
+	 * Creates a ring to read from, replacing any left behind by an
+	 * earlier process of the same name.
+	 *
+	 * @param name The name of the shared memory object.
+	 *
+	 * @param size The number of bytes the ring can hold.
+	 *
+	 * @return True on success; otherwise an error has been reported.
+	 */
+	bool Create(const std::string& name, size_t size);
+
+	/**
+	 * Attaches to a ring that another process has created.
+	 *
+	 * @param name The name of the shared memory object.
+	 *
+	 * @return True if the ring is now open for writing.
+	 */
+	bool Attach(const std::string& name);
+
+	/**
+	 * Detaches from the ring. If we created it, tells the writers that
+	 * it's gone and removes it.
+	 */
+	void Close();
+
+	/**
+	 * Returns true if the ring is open and, for writers, its reader is
+	 * still around.
+	 */
+	bool IsOpen() const;
+
+	/**
+	 * Puts a message into the ring.
+	 *
+	 * @return False if the ring isn't open or is too full for the
+	 * message, in which case it's up to the caller to send the message
+	 * some other way.
+	 */
+	bool Put(const broker::data& msg);
+
+	/**
+	 * Waits for the reader to take out all the messages in the ring, for
+	 * up to a second. A writer calls this before sending a message some
+	 * other way, so that it doesn't overtake the ones in the ring.
+	 *
+	 * @return True if the ring is empty now.
+	 */
+	bool Flush();
+
+	/**
+	 * Takes the oldest message out of the ring. Must only be called by the
+	 * process that created the ring.
+	 *
+	 * @return False if there's no message.
+	 */
+	bool Get(broker::data* msg);
+
+	/**
+	 * Returns true if there's no message to get.
+	 */
+	bool Empty() const;
+
+private:
+	struct Header;
+
+	static size_t HeaderSize();
+	bool Map(int fd, size_t size);
+	bool Lock();
+
+	std::string name;
+	Header* header;
+	char* data;	// Start of the ring's data area.
+	size_t mapped_size;
+	bool owner;	// True if we created the ring.
+	std::vector<char> buffer;	// Reused for serializing messages.
+};
+
+/**
+ * An IO source that feeds the messages arriving on a LogRing into the
+ * Broker manager. Like the threading manager, it has no file descriptor to
+ * wait on, so it gets polled.
+ */
+class LogRingReader : public iosource::IOSource {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param ring The ring to read from, which must have been created by
+	 * this process. The reader takes ownership.
+	 */
+	explicit LogRingReader(LogRing* ring);
+
+	/**
+	 * Destructor.
+	 */
+	~LogRingReader() override;
+
+	void GetFds(iosource::FD_Set* read, iosource::FD_Set* write,
+	            iosource::FD_Set* except) override;
+	double NextTimestamp(double* network_time) override;
+	void Process() override;
+	const char* Tag() override	{ return "Broker::LogRingReader"; }
+
+private:
+	LogRing* ring;
+};
+
+} // namespace bro_broker
+
+#endif // BRO_COMM_LOGRING_H
@@ -63,6 +63,11 @@ public:
 
 const broker::endpoint_info Manager::NoPeer{{}, {}};
 
+// Stands in for the number of fields in a LogWrite's serialized data if
+// what follows is a number of rows, each with its number of fields and
+// the values.
+static const int LOG_WRITE_BATCH = -1;
+
 int Manager::script_scope = 0;
 
 struct unref_guard {
@@ -136,6 +141,16 @@ Manager::Manager(bool arg_reading_pcaps)
 	times_processed_without_idle = 0;
 	log_batch_size = 0;
 	log_batch_interval = 0;
+	num_buffered_events = 0;
+	event_batch_size = 0;
+	event_batch_interval = 0;
+	compact_event_records = false;
+	bulk_messages_per_process = 0;
+	bulk_backlog_size = 0;
+	store_cache_size = 0;
+	store_cache_ttl = 0;
+	log_ring = nullptr;
+	log_ring_next_attach = 0;
 	log_topic_func = nullptr;
 	vector_of_data_type = nullptr;
 	log_id_type = nullptr;
@@ -146,6 +161,7 @@ Manager::Manager(bool arg_reading_pcaps)
 
 Manager::~Manager()
 	{
+	delete log_ring;
 	}
 
 void Manager::InitPostScript()
@@ -154,6 +170,21 @@ void Manager::InitPostScript()
 
 	log_batch_size = get_option("Broker::log_batch_size")->AsCount();
 	log_batch_interval = get_option("Broker::log_batch_interval")->AsInterval();
+	event_batch_size = get_option("Broker::event_batch_size")->AsCount();
+	event_batch_interval = get_option("Broker::event_batch_interval")->AsInterval();
+	compact_event_records = get_option("Broker::compact_event_records")->AsBool();
+	bulk_messages_per_process = get_option("Broker::bulk_messages_per_process")->AsCount();
+	bulk_backlog_size = get_option("Broker::bulk_backlog_size")->AsCount();
+
+	auto bulk_topics_list = get_option("Broker::bulk_topics")->AsTableVal()->ConvertToPureList();
+
+	for ( auto i = 0; i < bulk_topics_list->Length(); ++i )
+		bulk_topics.emplace_back(bulk_topics_list->Index(i)->AsString()->CheckString());
+
+	Unref(bulk_topics_list);
+
+	store_cache_size = get_option("Broker::store_cache_size")->AsCount();
+	store_cache_ttl = get_option("Broker::store_cache_ttl")->AsInterval();
 	default_log_topic_prefix =
 	    get_option("Broker::default_log_topic_prefix")->AsString()->CheckString();
 	log_topic_func = get_option("Broker::log_topic")->AsFunc();
@@ -215,12 +246,37 @@ void Manager::InitPostScript()
 
 	auto cqs = get_option("Broker::congestion_queue_size")->AsCount();
 	bstate = std::make_shared<BrokerState>(std::move(config), cqs);
+
+	log_ring_name = get_option("Broker::log_shm_name")->AsString()->CheckString();
+
+	if ( ! log_ring_name.empty() )
+		{
+		if ( get_option("Broker::log_shm_reader")->AsBool() )
+			{
+			auto ring = new LogRing();
+
+			if ( ring->Create(log_ring_name, get_option("Broker::log_shm_size")->AsCount()) )
+				iosource_mgr->Register(new LogRingReader(ring), true);
+			else
+				delete ring;
+			}
+		else
+			{
+			log_ring = new LogRing();
+			LogRingReady();
+			}
+		}
 	}
 
 void Manager::Terminate()
 	{
+	DispatchBulkMessages(bulk_backlog.size());
+	FlushEventBuffers();
 	FlushLogBuffers();
 
+	if ( log_ring )
+		log_ring->Close();
+
 	vector<string> stores_to_close;
 
 	for ( auto& x : data_stores )
@@ -340,6 +396,7 @@ void Manager::Unpeer(const string& addr, uint16_t port)
 	DBG_LOG(DBG_BROKER, "Stopping to peer with %s:%" PRIu16,
 		addr.c_str(), port);
 
+	FlushEventBuffers();
 	FlushLogBuffers();
 	bstate->endpoint.unpeer_nosync(addr, port);
 	}
@@ -365,14 +422,97 @@ bool Manager::PublishEvent(string topic, std::string name, broker::vector args)
 	if ( peer_count == 0 )
 		return true;
 
+	// Keeps the order in which events got published.
+	FlushEventBuffers();
+
 	DBG_LOG(DBG_BROKER, "Publishing event: %s",
 		RenderEvent(topic, name, args).c_str());
+	++topic_stats[topic].events_out;
 	broker::zeek::Event ev(std::move(name), std::move(args));
 	bstate->endpoint.publish(move(topic), ev.move_data());
 	++statistics.num_events_outgoing;
 	return true;
 	}
 
+bool Manager::PublishBatchedEvent(string topic, std::string name,
+                                  broker::vector args)
+	{
+	if ( event_batch_size <= 1 )
+		return PublishEvent(move(topic), move(name), move(args));
+
+	if ( bstate->endpoint.is_shutdown() )
+		return true;
+
+	if ( peer_count == 0 )
+		return true;
+
+	DBG_LOG(DBG_BROKER, "Buffering event: %s",
+		RenderEvent(topic, name, args).c_str());
+
+	auto& eb = event_buffers[topic];
+
+	if ( eb.events.empty() )
+		eb.first_time = current_time(true);
+
+	broker::zeek::Event ev(std::move(name), std::move(args));
+	eb.events.emplace_back(ev.move_data());
+	++num_buffered_events;
+	++statistics.num_events_outgoing;
+	++topic_stats[topic].events_out;
+
+	if ( eb.events.size() >= event_batch_size )
+		FlushEventBuffer(topic, eb);
+	else
+		// Makes sure we get to flush the buffer in time.
+		SetIdle(false);
+
+	return true;
+	}
+
+void Manager::FlushEventBuffers(bool all)
+	{
+	if ( ! num_buffered_events )
+		return;
+
+	double now = all ? 0 : current_time(true);
+
+	for ( auto& kv : event_buffers )
+		{
+		auto& eb = kv.second;
+
+		if ( eb.events.empty() )
+			continue;
+
+		if ( all || now - eb.first_time >= event_batch_interval )
+			FlushEventBuffer(kv.first, eb);
+		}
+	}
+
+void Manager::FlushEventBuffer(const std::string& topic, EventBuffer& eb)
+	{
+	num_buffered_events -= eb.events.size();
+
+	if ( bstate->endpoint.is_shutdown() )
+		{
+		eb.events.clear();
+		return;
+		}
+
+	DBG_LOG(DBG_BROKER, "Flushing %zu buffered events for topic %s",
+		eb.events.size(), topic.c_str());
+
+	if ( eb.events.size() == 1 )
+		// A single event goes out just as it would on its own.
+		bstate->endpoint.publish(topic, std::move(eb.events[0]));
+	else
+		{
+		broker::zeek::Batch msg(std::move(eb.events));
+		bstate->endpoint.publish(topic, msg.move_data());
+		}
+
+	eb.events.clear();
+	}
+
 bool Manager::PublishEvent(string topic, RecordVal* args)
 	{
 	if ( bstate->endpoint.is_shutdown() )
@@ -389,11 +529,22 @@ bool Manager::PublishEvent(string topic, RecordVal* args)
 	broker::vector xs;
 	xs.reserve(vv->Size());
 
+	// If nobody else holds on to the event, e.g. when it has just been
+	// made from publish()'s arguments, we can take over the converted
+	// arguments rather than copying them once more, which for large
+	// tables costs about as much as the conversion itself.
+	bool sole_owner = (args->RefCnt() == 1 && vv->RefCnt() == 1);
+
 	for ( auto i = 0u; i < vv->Size(); ++i )
 		{
-		auto val = vv->Lookup(i)->AsRecordVal()->Lookup(0);
+		auto rv = vv->Lookup(i)->AsRecordVal();
+		auto val = rv->Lookup(0);
 		auto data_val = static_cast<DataVal*>(val);
-		xs.emplace_back(data_val->data);
+
+		if ( sole_owner && rv->RefCnt() == 1 && data_val->RefCnt() == 1 )
+			xs.emplace_back(std::move(data_val->data));
+		else
+			xs.emplace_back(data_val->data);
 		}
 
 	return PublishEvent(topic, event_name, std::move(xs));
@@ -436,6 +587,55 @@ bool Manager::PublishIdentifier(std::string topic, std::string id)
 	return true;
 	}
 
+bool Manager::LogRingReady()
+	{
+	if ( ! log_ring )
+		return false;
+
+	if ( log_ring->IsOpen() )
+		return true;
+
+	// The reader may not be up yet, or may have restarted. Don't keep
+	// looking for it on every write.
+	double now = current_time(true);
+
+	if ( now < log_ring_next_attach )
+		return false;
+
+	log_ring_next_attach = now + 1.0;
+
+	if ( ! log_ring->Attach(log_ring_name) )
+		return false;
+
+	DBG_LOG(DBG_BROKER, "Sending logs through shared memory ring %s", log_ring_name.c_str());
+
+	// Rows through the ring may overtake the writers' creation messages
+	// that went to the reader through Broker, so send those again.
+	log_mgr->SendAllWritersTo(NoPeer);
+	return true;
+	}
+
+bool Manager::PutIntoLogRing(const broker::data& msg)
+	{
+	if ( log_ring->Put(msg) )
+		return true;
+
+	// Before the message goes through Broker instead, let the reader
+	// catch up, so that it doesn't overtake the ones in the ring. Then
+	// the message may well fit.
+	if ( log_ring->Flush() )
+		return log_ring->Put(msg);
+
+	// The reader isn't keeping up at all; stop using the ring for now,
+	// so that later messages don't end up interleaved with the ones
+	// going through Broker.
+	reporter->Warning("log ring %s not draining, sending logs through Broker",
+			  log_ring_name.c_str());
+	log_ring->Close();
+	log_ring_next_attach = current_time(true) + 1.0;
+	return false;
+	}
+
 bool Manager::PublishLogCreate(EnumVal* stream, EnumVal* writer,
 			       const logging::WriterBackend::WriterInfo& info,
 			       int num_fields, const threading::Field* const * fields,
@@ -444,7 +644,7 @@ bool Manager::PublishLogCreate(EnumVal* stream, EnumVal* writer,
 	if ( bstate->endpoint.is_shutdown() )
 		return true;
 
-	if ( peer_count == 0 )
+	if ( peer_count == 0 && ! LogRingReady() )
 		return true;
 
 	auto stream_id = stream->Type()->AsEnumType()->Lookup(stream->AsEnum());
@@ -483,6 +683,13 @@ bool Manager::PublishLogCreate(EnumVal* stream, EnumVal* writer,
 
 	DBG_LOG(DBG_BROKER, "Publishing log creation: %s", RenderMessage(topic, msg.as_data()).c_str());
 
+	// A reader sees the ones for new peers when they get broadcast.
+	if ( peer.node == NoPeer.node && LogRingReady() )
+		PutIntoLogRing(msg.as_data());
+
+	if ( peer_count == 0 )
+		return true;
+
 	if ( peer.node != NoPeer.node )
 		// Direct message.
 		bstate->endpoint.publish(peer, move(topic), msg.move_data());
@@ -498,7 +705,9 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path, int
 	if ( bstate->endpoint.is_shutdown() )
 		return true;
 
-	if ( peer_count == 0 )
+	bool use_ring = LogRingReady();
+
+	if ( peer_count == 0 && ! use_ring )
 		return true;
 
 	auto stream_id_num = stream->AsEnum();
@@ -520,6 +729,7 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path, int
 		return false;
 		}
 
+	uint64 start = PipelineStats::Now();
 	BinarySerializationFormat fmt;
 	char* data;
 	int len;
@@ -546,6 +756,23 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path, int
 	len = fmt.EndWrite(&data);
 	std::string serial_data(data, len);
 	free(data);
+	serialization_time.Record(PipelineStats::Now() - start);
+
+	if ( use_ring )
+		{
+		broker::zeek::LogWrite msg(broker::enum_value(stream_id),
+		                           broker::enum_value(writer_id),
+		                           path, serial_data);
+
+		if ( PutIntoLogRing(msg.as_data()) )
+			{
+			++statistics.num_logs_outgoing;
+			return true;
+			}
+
+		if ( peer_count == 0 )
+			return true;
+		}
 
 	val_list vl{
 		stream->Ref(),
@@ -565,20 +792,37 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path, int
 	std::string topic = v->AsString()->CheckString();
 	Unref(v);
 
-	auto bstream_id = broker::enum_value(move(stream_id));
-	auto bwriter_id = broker::enum_value(move(writer_id));
-	broker::zeek::LogWrite msg(move(bstream_id), move(bwriter_id), move(path),
-	                          move(serial_data));
-
-	DBG_LOG(DBG_BROKER, "Buffering log record: %s", RenderMessage(topic, msg.as_data()).c_str());
+	DBG_LOG(DBG_BROKER, "Buffering log record for stream %s at path %s, topic %s",
+	        stream_id, path.c_str(), topic.c_str());
 
 	if ( log_buffers.size() <= (unsigned int)stream_id_num )
 		log_buffers.resize(stream_id_num + 1);
 
 	auto& lb = log_buffers[stream_id_num];
 	++lb.message_count;
-	auto& pending_batch = lb.msgs[topic];
-	pending_batch.emplace_back(msg.move_data());
+
+	// Rows for the same destination share a message rather than each
+	// getting its own, which is what costs the logger most.
+	std::string key = topic;
+	key += '\n';
+	key += writer_id;
+	key += '\n';
+	key += path;
+
+	auto& pw = lb.writes[key];
+	++topic_stats[topic].logs_out;
+
+	if ( pw.topic.empty() )
+		{
+		pw.topic = move(topic);
+		pw.stream_id = broker::enum_value(stream_id);
+		pw.writer_id = broker::enum_value(writer_id);
+		pw.path = move(path);
+		pw.num_rows = 0;
+		}
+
+	pw.rows.append(serial_data);
+	++pw.num_rows;
 
 	if ( lb.message_count >= log_batch_size ||
 	     (network_time - lb.last_flush >= log_batch_interval ) )
@@ -587,6 +831,50 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path, int
 	return true;
 	}
 
+void Manager::CloseLogWriter(EnumVal* stream, EnumVal* writer, const string& path)
+	{
+	auto stream_id_num = stream->AsEnum();
+
+	if ( log_buffers.size() <= (unsigned int)stream_id_num )
+		return;
+
+	auto writer_id = writer->Type()->AsEnumType()->Lookup(writer->AsEnum());
+
+	if ( ! writer_id )
+		return;
+
+	// Matches the end of the keys in PublishLogWrite(), whatever the
+	// topic.
+	std::string suffix = "\n";
+	suffix += writer_id;
+	suffix += '\n';
+	suffix += path;
+
+	auto& lb = log_buffers[stream_id_num];
+	auto matches = [&](const std::string& key)
+		{
+		return key.size() > suffix.size() &&
+			key.compare(key.size() - suffix.size(), suffix.size(), suffix) == 0;
+		};
+
+	for ( const auto& kv : lb.writes )
+		{
+		if ( kv.second.num_rows && matches(kv.first) )
+			{
+			statistics.num_logs_outgoing += lb.Flush(bstate->endpoint, log_batch_size);
+			break;
+			}
+		}
+
+	for ( auto i = lb.writes.begin(); i != lb.writes.end(); )
+		{
+		if ( matches(i->first) )
+			i = lb.writes.erase(i);
+		else
+			++i;
+		}
+	}
+
 size_t Manager::LogBuffer::Flush(broker::endpoint& endpoint, size_t log_batch_size)
 	{
 	if ( endpoint.is_shutdown() )
@@ -596,15 +884,51 @@ size_t Manager::LogBuffer::Flush(broker::endpoint& endpoint, size_t log_batch_si
 		// No logs buffered for this stream.
 		return 0;
 
-	for ( auto& kv : msgs )
+	// Indexed by topic.
+	std::unordered_map<std::string, broker::vector> batches;
+
+	for ( auto& kv : writes )
 		{
-		auto& topic = kv.first;
-		auto& pending_batch = kv.second;
-		broker::vector batch;
-		batch.reserve(log_batch_size + 1);
-		pending_batch.swap(batch);
-		broker::zeek::Batch msg(std::move(batch));
-		endpoint.publish(topic, msg.move_data());
+		auto& pw = kv.second;
+
+		if ( ! pw.num_rows )
+			continue;
+
+		std::string serial_data;
+
+		if ( pw.num_rows == 1 )
+			// A single row goes out just as it would on its own.
+			serial_data.swap(pw.rows);
+
+		else
+			{
+			BinarySerializationFormat fmt;
+			char* data;
+
+			fmt.StartWrite();
+			fmt.Write(LOG_WRITE_BATCH, "num_fields");
+			fmt.Write(static_cast<uint64>(pw.num_rows), "num_rows");
+			int len = fmt.EndWrite(&data);
+
+			serial_data.reserve(len + pw.rows.size());
+			serial_data.assign(data, len);
+			serial_data.append(pw.rows);
+			free(data);
+
+			// Keeps the capacity for the next batch.
+			pw.rows.clear();
+			}
+
+		broker::zeek::LogWrite msg(pw.stream_id, pw.writer_id, pw.path,
+		                           move(serial_data));
+		batches[pw.topic].emplace_back(msg.move_data());
+		pw.num_rows = 0;
+		}
+
+	for ( auto& kv : batches )
+		{
+		broker::zeek::Batch msg(std::move(kv.second));
+		endpoint.publish(kv.first, msg.move_data());
 		}
 
 	auto rval = message_count;
@@ -700,6 +1024,7 @@ bool Manager::AutoUnpublishEvent(const string& topic, Val* event)
 
 RecordVal* Manager::MakeEvent(val_list* args, Frame* frame)
 	{
+	uint64 start = PipelineStats::Now();
 	auto rval = new RecordVal(BifType::Record::Broker::Event);
 	auto arg_vec = new VectorVal(vector_of_data_type);
 	rval->Assign(1, arg_vec);
@@ -761,7 +1086,7 @@ RecordVal* Manager::MakeEvent(val_list* args, Frame* frame)
 			Ref(data_val);
 			}
 		else
-			data_val = make_data_val((*args)[i]);
+			data_val = make_data_val((*args)[i], compact_event_records);
 
 		if ( ! data_val->Lookup(0) )
 			{
@@ -775,6 +1100,7 @@ RecordVal* Manager::MakeEvent(val_list* args, Frame* frame)
 		arg_vec->Assign(i - 1, data_val);
 		}
 
+	serialization_time.Record(PipelineStats::Now() - start);
 	return rval;
 	}
 
@@ -856,7 +1182,7 @@ void Manager::DispatchMessage(const broker::topic& topic, broker::data msg)
 		break;
 
 	case broker::zeek::Message::Type::LogWrite:
-		ProcessLogWrite(std::move(msg));
+		ProcessLogWrite(topic, std::move(msg));
 		break;
 
 	case broker::zeek::Message::Type::IdentifierUpdate:
@@ -923,6 +1249,12 @@ void Manager::Process()
 		auto& topic = broker::get_topic(message);
 		auto& msg = broker::get_data(message);
 
+		if ( bulk_messages_per_process && IsBulkMessage(topic, msg) )
+			{
+			bulk_backlog.emplace_back(topic, std::move(msg));
+			continue;
+			}
+
 		try
 			{
 			DispatchMessage(topic, std::move(msg));
@@ -934,6 +1266,17 @@ void Manager::Process()
 			}
 		}
 
+	if ( ! bulk_backlog.empty() )
+		{
+		had_input = true;
+		auto num_bulk = std::min(bulk_backlog.size(), bulk_messages_per_process);
+
+		if ( bulk_backlog.size() - num_bulk > bulk_backlog_size )
+			num_bulk = bulk_backlog.size() - bulk_backlog_size;
+
+		DispatchBulkMessages(num_bulk);
+		}
+
 	for ( auto& s : data_stores )
 		{
 		auto num_available = s.second->proxy.mailbox().size();
@@ -980,6 +1323,58 @@ void Manager::Process()
 		times_processed_without_idle = 0;
 		SetIdle(true);
 		}
+
+	FlushEventBuffers(false);
+
+	if ( num_buffered_events || ! bulk_backlog.empty() )
+		SetIdle(false);
+	}
+
+bool Manager::IsBulkMessage(const broker::topic& topic, broker::data& msg) const
+	{
+	for ( const auto& prefix : bulk_topics )
+		{
+		if ( topic.string().compare(0, prefix.size(), prefix) == 0 )
+			return true;
+		}
+
+	switch ( broker::zeek::Message::type(msg) ) {
+	case broker::zeek::Message::Type::LogCreate:
+	case broker::zeek::Message::Type::LogWrite:
+		return true;
+
+	case broker::zeek::Message::Type::Batch:
+		{
+		// Batches hold messages of one kind, so the first one tells.
+		broker::zeek::Batch batch(std::move(msg));
+		auto rval = batch.valid() && ! batch.batch().empty() &&
+		            broker::zeek::Message::type(batch.batch()[0]) ==
+		                broker::zeek::Message::Type::LogWrite;
+		msg = batch.move_data();
+		return rval;
+		}
+
+	default:
+		return false;
+	}
+	}
+
+void Manager::DispatchBulkMessages(size_t max)
+	{
+	for ( size_t i = 0; i < max && ! bulk_backlog.empty(); ++i )
+		{
+		auto m = std::move(bulk_backlog.front());
+		bulk_backlog.pop_front();
+
+		try
+			{
+			DispatchMessage(m.first, std::move(m.second));
+			}
+		catch ( std::runtime_error& e )
+			{
+			reporter->Warning("ignoring invalid Broker message: %s", + e.what());
+			}
+		}
 	}
 
 
@@ -998,6 +1393,7 @@ void Manager::ProcessEvent(const broker::topic& topic, broker::zeek::Event ev)
 	DBG_LOG(DBG_BROKER, "Process event: %s %s",
 			name.data(), RenderMessage(args).data());
 	++statistics.num_events_incoming;
+	++topic_stats[topic.string()].events_in;
 	auto handler = event_registry->Lookup(name.data());
 
 	if ( ! handler )
@@ -1139,7 +1535,8 @@ bool bro_broker::Manager::ProcessLogCreate(broker::zeek::LogCreate lc)
 	return true;
 	}
 
-bool bro_broker::Manager::ProcessLogWrite(broker::zeek::LogWrite lw)
+bool bro_broker::Manager::ProcessLogWrite(const broker::topic& topic,
+                                          broker::zeek::LogWrite lw)
 	{
 	DBG_LOG(DBG_BROKER, "Received log-write: %s", RenderMessage(lw.as_data()).c_str());
 
@@ -1202,26 +1599,63 @@ bool bro_broker::Manager::ProcessLogWrite(broker::zeek::LogWrite lw)
 		return false;
 		}
 
-	auto vals = new threading::Value* [num_fields];
+	uint64 num_rows = 1;
+	bool batch = (num_fields == LOG_WRITE_BATCH);
 
-	for ( int i = 0; i < num_fields; ++i )
+	if ( batch )
 		{
-		vals[i] = new threading::Value;
-
-		if ( ! vals[i]->Read(&fmt) )
+		if ( ! fmt.Read(&num_rows, "num_rows") || ! fmt.Read(&num_fields, "num_fields") )
 			{
-			for ( int j = 0; j <=i; ++j )
-				delete vals[j];
+			reporter->Warning("failed to unserialize remote log batch for stream: %s", stream_id_name.data());
+			return false;
+			}
 
-			delete [] vals;
-			reporter->Warning("failed to unserialize remote log field %d for stream: %s", i, stream_id_name.data());
+		statistics.num_logs_incoming += num_rows - 1;
+		}
+
+	// Messages from a log ring don't have a topic.
+	if ( ! topic.string().empty() )
+		topic_stats[topic.string()].logs_in += num_rows;
+
+	for ( uint64 r = 0; r < num_rows; ++r )
+		{
+		// Each row in a batch starts with its number of fields.
+		if ( r > 0 && ! fmt.Read(&num_fields, "num_fields") )
+			{
+			reporter->Warning("failed to unserialize remote log num fields for stream: %s", stream_id_name.data());
+			return false;
+			}
 
+		if ( num_fields < 0 )
+			{
+			reporter->Warning("invalid number of remote log fields for stream: %s", stream_id_name.data());
 			return false;
 			}
+
+		auto vals = new threading::Value* [num_fields];
+
+		for ( int i = 0; i < num_fields; ++i )
+			{
+			vals[i] = new threading::Value;
+
+			if ( ! vals[i]->Read(&fmt) )
+				{
+				for ( int j = 0; j <=i; ++j )
+					delete vals[j];
+
+				delete [] vals;
+				reporter->Warning("failed to unserialize remote log field %d for stream: %s", i, stream_id_name.data());
+
+				return false;
+				}
+			}
+
+		// The last row can have the path, the others need a copy.
+		log_mgr->WriteFromRemote(stream_id->AsEnumVal(), writer_id->AsEnumVal(),
+		                         r + 1 < num_rows ? *path : std::move(*path),
+		                         num_fields, vals);
 		}
 
-	log_mgr->WriteFromRemote(stream_id->AsEnumVal(), writer_id->AsEnumVal(),
-	                         std::move(*path), num_fields, vals);
 	fmt.EndRead();
 	return true;
 	}
@@ -1419,6 +1853,9 @@ void Manager::ProcessStoreResponse(StoreHandleVal* s, broker::store::response re
 		return;
 		}
 
+	// Even if the trigger has timed out, the answer is good for the cache.
+	s->CacheResponse(response.id, response.answer);
+
 	if ( request->second->Disabled() )
 		{
 		// Trigger timer must have timed the query out already.
@@ -1494,9 +1931,11 @@ StoreHandleVal* Manager::MakeMaster(const string& name, broker::backend type,
 		}
 
 	auto handle = new StoreHandleVal{*result};
+	handle->InitCache(store_cache_size, store_cache_ttl);
 	Ref(handle);
 
 	data_stores.emplace(name, handle);
+	FdsChanged();
 
 	if ( bstate->endpoint.use_real_time() )
 		return handle;
@@ -1530,9 +1969,11 @@ StoreHandleVal* Manager::MakeClone(const string& name, double resync_interval,
 		}
 
 	auto handle = new StoreHandleVal{*result};
+	handle->InitCache(store_cache_size, store_cache_ttl);
 	Ref(handle);
 
 	data_stores.emplace(name, handle);
+	FdsChanged();
 
 	return handle;
 	}
@@ -1565,6 +2006,7 @@ bool Manager::CloseStore(const string& name)
 
 	Unref(s->second);
 	data_stores.erase(s);
+	FdsChanged();
 	return true;
 	}
 
@@ -1591,4 +2033,26 @@ const Stats& Manager::GetStatistics()
 	return statistics;
 	}
 
+void Manager::GetTrafficStats(TrafficStats* stats, bool reset)
+	{
+	stats->inbound_queue = bstate->subscriber.available() + bulk_backlog.size();
+	stats->buffered_events = num_buffered_events;
+	stats->buffered_logs = 0;
+
+	for ( const auto& lb : log_buffers )
+		stats->buffered_logs += lb.message_count;
+
+	stats->serialization = serialization_time;
+	stats->topics.clear();
+
+	for ( const auto& kv : topic_stats )
+		stats->topics[kv.first] = kv.second;
+
+	if ( reset )
+		{
+		serialization_time.Reset();
+		topic_stats.clear();
+		}
+	}
+
 } // namespace bro_broker
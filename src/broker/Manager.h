@@ -13,6 +13,7 @@
 #include <broker/backend_options.hh>
 #include <broker/detail/hash.hh>
 #include <broker/zeek.hh>
+#include <deque>
 #include <memory>
 #include <string>
 #include <map>
@@ -20,6 +21,8 @@
 #include <unordered_map>
 #include <unordered_set>
 #include "broker/Store.h"
+#include "broker/LogRing.h"
+#include "Stats.h"
 #include "Reporter.h"
 #include "iosource/IOSource.h"
 #include "Val.h"
@@ -53,6 +56,38 @@ struct Stats {
 	size_t num_ids_outgoing = 0;
 };
 
+/**
+ * Traffic statistics for one topic.
+ */
+struct TopicStats {
+	// Number of events sent.
+	uint64 events_out = 0;
+	// Number of events received.
+	uint64 events_in = 0;
+	// Number of log records sent.
+	uint64 logs_out = 0;
+	// Number of log records received.
+	uint64 logs_in = 0;
+};
+
+/**
+ * Statistics on what's waiting to be sent or processed, and on the traffic
+ * per topic.
+ */
+struct TrafficStats {
+	// Number of messages received but not processed yet.
+	size_t inbound_queue = 0;
+	// Number of auto-published events waiting to be sent.
+	size_t buffered_events = 0;
+	// Number of log records waiting to be sent.
+	size_t buffered_logs = 0;
+	// Time spent converting outgoing events and log records, in
+	// nanoseconds per message.
+	LatencyHistogram serialization;
+	// Indexed by topic.
+	std::map<std::string, TopicStats> topics;
+};
+
 /**
  * Manages various forms of communication between peer Bro processes
  * or other external applications via use of the Broker messaging library.
@@ -90,6 +125,13 @@ public:
 	 */
 	bool Active();
 
+	/**
+	 * Returns true if records of fixed-size fields in event arguments are
+	 * to be sent in compact form; see Broker::compact_event_records.
+	 */
+	bool CompactEventRecords() const
+		{ return compact_event_records; }
+
 	/**
 	 * Advances time.  Broker data store expiration is driven by this
 	 * simulated time instead of real/wall time.
@@ -164,6 +206,18 @@ public:
 	 */
 	bool PublishEvent(std::string topic, RecordVal* ev);
 
+	/**
+	 * Send an auto-published event to any interested peers.  Such events
+	 * may be buffered per topic for up to Broker::event_batch_interval, so
+	 * that a burst of them goes out in a single message.
+	 * @param topic a topic string associated with the message.
+	 * @param name the name of the event
+	 * @param args the event's arguments
+	 * @return true if the message is sent or queued successfully.
+	 */
+	bool PublishBatchedEvent(std::string topic, std::string name,
+	                         broker::vector args);
+
 	/**
 	 * Send a message to create a log stream to any interested peers.
 	 * The log stream may or may not already exist on the receiving side.
@@ -197,6 +251,15 @@ public:
 	bool PublishLogWrite(EnumVal* stream, EnumVal* writer, string path, int num_vals,
 			     const threading::Value* const * vals);
 
+	/**
+	 * Sends out any log rows still buffered for a writer and forgets
+	 * about it. To be called when the writer gets closed.
+	 * @param stream the stream ID.
+	 * @param writer the writer ID.
+	 * @param path the path the writer wrote to.
+	 */
+	void CloseLogWriter(EnumVal* stream, EnumVal* writer, const string& path);
+
 	/**
 	 * Automatically send an event to any interested peers whenever it is
 	 * locally dispatched (e.g. using "event my_event(...);" in a script).
@@ -316,11 +379,26 @@ public:
 	 */
 	size_t FlushLogBuffers();
 
+	/**
+	 * Send buffered auto-published events.
+	 * @param all if false, only sends those buffered for at least
+	 * Broker::event_batch_interval.
+	 */
+	void FlushEventBuffers(bool all = true);
+
 	/**
 	 * @return communication statistics.
 	 */
 	const Stats& GetStatistics();
 
+	/**
+	 * Retrieves queue depths and per-topic traffic.
+	 * @param stats receives the statistics.
+	 * @param reset if true, starts over with the per-topic counters and
+	 * the serialization times afterwards.
+	 */
+	void GetTrafficStats(TrafficStats* stats, bool reset);
+
 	/**
 	 * Creating an instance of this struct simply helps the manager
 	 * keep track of whether calls into its API are coming from script
@@ -332,11 +410,16 @@ public:
 	};
 
 private:
+	friend class LogRingReader;
 
+	bool LogRingReady();
+	bool PutIntoLogRing(const broker::data& msg);
 	void DispatchMessage(const broker::topic& topic, broker::data msg);
+	bool IsBulkMessage(const broker::topic& topic, broker::data& msg) const;
+	void DispatchBulkMessages(size_t max);
 	void ProcessEvent(const broker::topic& topic, broker::zeek::Event ev);
 	bool ProcessLogCreate(broker::zeek::LogCreate lc);
-	bool ProcessLogWrite(broker::zeek::LogWrite lw);
+	bool ProcessLogWrite(const broker::topic& topic, broker::zeek::LogWrite lw);
 	bool ProcessIdentifierUpdate(broker::zeek::IdentifierUpdate iu);
 	void ProcessStatus(broker::status stat);
 	void ProcessError(broker::error err);
@@ -357,15 +440,33 @@ private:
 	const char* Tag() override
 		{ return "Broker::Manager"; }
 
+	// Rows for the same writer and path that go out as one LogWrite
+	// message, see PublishLogWrite().
+	struct PendingLogWrite {
+		std::string topic;
+		broker::data stream_id;
+		broker::data writer_id;
+		std::string path;
+		std::string rows;	// Serialized rows, one after the other.
+		size_t num_rows;
+	};
+
 	struct LogBuffer {
-		// Indexed by topic string.
-		std::unordered_map<std::string, broker::vector> msgs;
+		// Indexed by topic, writer and path.
+		std::unordered_map<std::string, PendingLogWrite> writes;
 		double last_flush;
 		size_t message_count;
 
 		size_t Flush(broker::endpoint& endpoint, size_t batch_size);
 	};
 
+	struct EventBuffer {
+		broker::vector events;	// Event messages, oldest first.
+		double first_time;	// When the oldest got buffered.
+	};
+
+	void FlushEventBuffer(const std::string& topic, EventBuffer& eb);
+
 	// Data stores
 	using query_id = std::pair<broker::request_id, StoreHandleVal*>;
 
@@ -380,6 +481,8 @@ private:
 	};
 
 	std::vector<LogBuffer> log_buffers; // Indexed by stream ID enum.
+	std::unordered_map<std::string, EventBuffer> event_buffers; // Indexed by topic.
+	size_t num_buffered_events;
 	std::string default_log_topic_prefix;
 	std::shared_ptr<BrokerState> bstate;
 	std::unordered_map<std::string, StoreHandleVal*> data_stores;
@@ -388,6 +491,8 @@ private:
 	std::vector<std::string> forwarded_prefixes;
 
 	Stats statistics;
+	std::unordered_map<std::string, TopicStats> topic_stats;
+	LatencyHistogram serialization_time;
 
 	uint16_t bound_port;
 	bool reading_pcaps;
@@ -397,6 +502,19 @@ private:
 
 	size_t log_batch_size;
 	double log_batch_interval;
+	size_t event_batch_size;
+	double event_batch_interval;
+	bool compact_event_records;
+	std::vector<std::string> bulk_topics;
+	size_t bulk_messages_per_process;
+	size_t bulk_backlog_size;
+	// Bulk messages received, but held back for other traffic.
+	std::deque<std::pair<broker::topic, broker::data>> bulk_backlog;
+	size_t store_cache_size;
+	double store_cache_ttl;
+	std::string log_ring_name;
+	LogRing* log_ring;	// Set if we're sending logs through a ring.
+	double log_ring_next_attach;
 	Func* log_topic_func;
 	VectorType* vector_of_data_type;
 	EnumType* log_id_type;
@@ -49,6 +49,153 @@ void StoreHandleVal::ValDescribe(ODesc* d) const
 	d->Add("}");
 	}
 
+void StoreHandleVal::InitCache(size_t size, double ttl)
+	{
+	cache_size = size;
+	cache_ttl = ttl;
+	CacheClear();
+	}
+
+RecordVal* StoreHandleVal::CacheLookup(const broker::data& key)
+	{
+	if ( ! CacheEnabled() )
+		return nullptr;
+
+	auto i = cache_index.find(key);
+
+	if ( i == cache_index.end() )
+		return nullptr;
+
+	auto e = i->second;
+
+	if ( e->expire && e->expire <= network_time )
+		{
+		CacheEvict(i);
+		return nullptr;
+		}
+
+	cache_lru.splice(cache_lru.begin(), cache_lru, e);
+
+	if ( ! e->found )
+		return query_result();
+
+	return query_result(make_data_val(e->value));
+	}
+
+void StoreHandleVal::CacheQuery(broker::request_id id, broker::data key)
+	{
+	if ( CacheEnabled() )
+		cache_pending[id] = std::move(key);
+	}
+
+void StoreHandleVal::CacheResponse(broker::request_id id,
+                                   const broker::expected<broker::data>& answer)
+	{
+	auto p = cache_pending.find(id);
+
+	if ( p == cache_pending.end() )
+		return;
+
+	bool found = static_cast<bool>(answer);
+
+	// Only definite answers go into the cache, not timeouts and the like.
+	if ( found || answer.error() == broker::ec::no_such_key )
+		{
+		auto i = cache_index.find(p->second);
+
+		if ( i != cache_index.end() )
+			CacheEvict(i);
+
+		double expire = cache_ttl > 0 ? network_time + cache_ttl : 0;
+		broker::data value = found ? *answer : broker::data();
+		cache_lru.push_front({p->second, std::move(value), found, expire});
+		cache_index.emplace(std::move(p->second), cache_lru.begin());
+
+		while ( cache_lru.size() > cache_size )
+			CacheEvict(cache_index.find(cache_lru.back().key));
+		}
+
+	cache_pending.erase(p);
+	}
+
+void StoreHandleVal::CacheInvalidate(const broker::data& key)
+	{
+	if ( ! CacheEnabled() )
+		return;
+
+	auto i = cache_index.find(key);
+
+	if ( i != cache_index.end() )
+		CacheEvict(i);
+
+	// An answer still underway may predate the modification.
+	for ( auto p = cache_pending.begin(); p != cache_pending.end(); )
+		{
+		if ( p->second == key )
+			p = cache_pending.erase(p);
+		else
+			++p;
+		}
+	}
+
+void StoreHandleVal::CacheClear()
+	{
+	cache_lru.clear();
+	cache_index.clear();
+	cache_pending.clear();
+	}
+
+void StoreHandleVal::CacheEvict(std::map<broker::data, cache_list::iterator>::iterator i)
+	{
+	cache_lru.erase(i->second);
+	cache_index.erase(i);
+	}
+
+void StoreGetManyQuery::Expect(size_t n)
+	{
+	remaining = n;
+
+	if ( ! remaining )
+		Finish(query_result(make_data_val(std::move(result))));
+	}
+
+void StoreGetManyQuery::Answered()
+	{
+	if ( remaining && --remaining == 0 )
+		Finish(query_result(make_data_val(std::move(result))));
+	}
+
+void StoreGetManyQuery::Abort()
+	{
+	Finish(query_result());
+	}
+
+void StoreGetManyQuery::Finish(RecordVal* r)
+	{
+	if ( done )
+		{
+		Unref(r);
+		return;
+		}
+
+	done = true;
+	trigger->Cache(call, r);
+	trigger->Release();
+	Unref(r);
+	}
+
+void StoreGetManyCallback::Result(RecordVal* result)
+	{
+	// Keys the store doesn't have are left out of the result.
+	auto d = result->Lookup(1)->AsRecordVal()->Lookup(0);
+
+	if ( d )
+		query->Found(std::move(key), static_cast<DataVal*>(d)->data);
+
+	Unref(result);
+	query->Answered();
+	}
+
 IMPLEMENT_OPAQUE_VALUE(StoreHandleVal)
 
 broker::expected<broker::data> StoreHandleVal::DoSerialize() const
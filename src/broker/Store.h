@@ -12,6 +12,11 @@
 #include <broker/backend.hh>
 #include <broker/backend_options.hh>
 
+#include <list>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
 namespace bro_broker {
 
 extern OpaqueType* opaque_of_store_handle;
@@ -74,19 +79,19 @@ public:
 		Ref(trigger);
 		}
 
-	~StoreQueryCallback()
+	virtual ~StoreQueryCallback()
 		{
 		Unref(trigger);
 		}
 
-	void Result(RecordVal* result)
+	virtual void Result(RecordVal* result)
 		{
 		trigger->Cache(call, result);
 		trigger->Release();
 		Unref(result);
 		}
 
-	void Abort()
+	virtual void Abort()
 		{
 		auto result = query_result();
 		trigger->Cache(call, result);
@@ -94,7 +99,7 @@ public:
 		Unref(result);
 		}
 
-	bool Disabled() const
+	virtual bool Disabled() const
 		{ return trigger->Disabled(); }
 
 	const broker::store& Store() const
@@ -107,6 +112,89 @@ private:
 	broker::store store;
 };
 
+/**
+ * Collects the answers to the get queries that Broker::get_many issues, to
+ * answer its "when" condition with all of them at once.
+ */
+class StoreGetManyQuery {
+public:
+	StoreGetManyQuery(Trigger* arg_trigger, const CallExpr* arg_call)
+		: trigger(arg_trigger), call(arg_call)
+		{
+		Ref(trigger);
+		}
+
+	~StoreGetManyQuery()
+		{
+		Unref(trigger);
+		}
+
+	/**
+	 * Adds a key the store has a value for to the result.
+	 */
+	void Found(broker::data key, broker::data value)
+		{ result.emplace(std::move(key), std::move(value)); }
+
+	/**
+	 * Sets the number of answers still to come.  Once all of them are
+	 * there, the query finishes.
+	 */
+	void Expect(size_t n);
+
+	/**
+	 * Counts one more answer.
+	 */
+	void Answered();
+
+	/**
+	 * Fails the query.
+	 */
+	void Abort();
+
+	bool Disabled() const
+		{ return done || trigger->Disabled(); }
+
+	Trigger* GetTrigger() const
+		{ return trigger; }
+
+	const CallExpr* GetCall() const
+		{ return call; }
+
+private:
+	void Finish(RecordVal* result);
+
+	Trigger* trigger;
+	const CallExpr* call;
+	broker::table result;
+	size_t remaining = 0;
+	bool done = false;
+};
+
+/**
+ * The callback of one of the get queries of a StoreGetManyQuery.
+ */
+class StoreGetManyCallback : public StoreQueryCallback {
+public:
+	StoreGetManyCallback(std::shared_ptr<StoreGetManyQuery> arg_query,
+	                     broker::data arg_key, broker::store store)
+		: StoreQueryCallback(arg_query->GetTrigger(), arg_query->GetCall(),
+		                     std::move(store)),
+		  query(std::move(arg_query)), key(std::move(arg_key))
+		{ }
+
+	void Result(RecordVal* result) override;
+
+	void Abort() override
+		{ query->Abort(); }
+
+	bool Disabled() const override
+		{ return query->Disabled(); }
+
+private:
+	std::shared_ptr<StoreGetManyQuery> query;
+	broker::data key;
+};
+
 /**
  * An opaque handle which wraps a Broker data store.
  */
@@ -118,12 +206,82 @@ public:
 
 	void ValDescribe(ODesc* d) const override;
 
+	/**
+	 * Enables the read cache, which keeps the answers to recent get
+	 * queries so that repeated lookups of the same keys don't need a
+	 * round trip to the store.
+	 * @param size the maximum number of keys to keep; zero disables the
+	 * cache.
+	 * @param ttl how long a cached answer remains valid; zero means until
+	 * evicted or invalidated.
+	 */
+	void InitCache(size_t size, double ttl);
+
+	/**
+	 * @return true if the read cache is enabled.
+	 */
+	bool CacheEnabled() const
+		{ return cache_size > 0; }
+
+	/**
+	 * Looks up a key in the read cache.
+	 * @param key the key to look up.
+	 * @return the query result for the key, or null if it isn't cached.
+	 */
+	RecordVal* CacheLookup(const broker::data& key);
+
+	/**
+	 * Remembers which key a pending get query is for, so that its answer
+	 * can go into the read cache.
+	 * @param id the query's request ID.
+	 * @param key the key being looked up.
+	 */
+	void CacheQuery(broker::request_id id, broker::data key);
+
+	/**
+	 * Puts the answer to a pending get query into the read cache.
+	 * @param id the query's request ID.
+	 * @param answer the store's answer.
+	 */
+	void CacheResponse(broker::request_id id,
+	                   const broker::expected<broker::data>& answer);
+
+	/**
+	 * Removes a key from the read cache, including the answers of any of
+	 * its queries still pending. Called when modifying the key.
+	 * @param key the key to remove.
+	 */
+	void CacheInvalidate(const broker::data& key);
+
+	/**
+	 * Empties the read cache.
+	 */
+	void CacheClear();
+
 	broker::store store;
 	broker::store::proxy proxy;
 
 protected:
 	StoreHandleVal() = default;
 
+	struct CacheEntry {
+		broker::data key;
+		broker::data value;
+		bool found;	// False if the store had no such key.
+		double expire;	// Zero if never.
+	};
+
+	// Most recently used first.
+	typedef std::list<CacheEntry> cache_list;
+
+	void CacheEvict(std::map<broker::data, cache_list::iterator>::iterator i);
+
+	size_t cache_size = 0;
+	double cache_ttl = 0;
+	cache_list cache_lru;
+	std::map<broker::data, cache_list::iterator> cache_index;
+	std::unordered_map<broker::request_id, broker::data> cache_pending;
+
 	DECLARE_OPAQUE_VALUE(StoreHandleVal)
 };
 
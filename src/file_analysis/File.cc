@@ -4,7 +4,6 @@
 #include <algorithm>
 
 #include "File.h"
-#include "FileTimer.h"
 #include "Analyzer.h"
 #include "Manager.h"
 #include "Reporter.h"
@@ -85,6 +84,8 @@ File::File(const string& file_id, const string& source_name, Connection* conn,
 	: id(file_id), val(0), file_reassembler(0), stream_offset(0),
 	  reassembly_max_buffer(0), did_metadata_inference(false),
 	  reassembly_enabled(false), postpone_timeout(false), done(false),
+	  dropped(false),
+	  pending_jobs(0), eof_pending(false), remove_pending(false),
 	  analyzers(this)
 	{
 	StaticInit();
@@ -116,6 +117,12 @@ File::~File()
 
 void File::UpdateLastActivityTime()
 	{
+	Val* last_active = val->Lookup(last_active_idx);
+
+	// Most chunks arrive with the same packet as the previous one.
+	if ( last_active && last_active->AsTime() == network_time )
+		return;
+
 	val->Assign(last_active_idx, new Val(network_time, TYPE_TIME));
 	}
 
@@ -251,11 +258,6 @@ bool File::IsComplete() const
 	return false;
 	}
 
-void File::ScheduleInactivityTimer() const
-	{
-	timer_mgr->Add(new FileTimer(network_time, id, GetTimeoutInterval()));
-	}
-
 bool File::AddAnalyzer(file_analysis::Tag tag, RecordVal* args)
 	{
 	DBG_LOG(DBG_FILE_ANALYSIS, "[%s] Queuing addition of %s analyzer",
@@ -264,6 +266,10 @@ bool File::AddAnalyzer(file_analysis::Tag tag, RecordVal* args)
 	if ( done )
 		return false;
 
+	if ( dropped )
+		// Not an error, the content is just not of interest.
+		return true;
+
 	return analyzers.QueueAdd(tag, args) != 0;
 	}
 
@@ -299,6 +305,7 @@ bool File::SetMime(const string& mime_type)
 
 	did_metadata_inference = true;
 	bof_buffer.full = true;
+	CheckDropPolicy(mime_type);
 
 	if ( ! FileEventAvailable(file_sniff) )
 		return false;
@@ -319,16 +326,21 @@ void File::InferMetadata()
 
 	if ( ! bof_buffer_val )
 		{
-		if ( bof_buffer.size == 0 )
+		bof_buffer_val = BOFBufferVal();
+
+		if ( ! bof_buffer_val )
 			return;
 
-		BroString* bs = concatenate(bof_buffer.chunks);
-		bof_buffer_val = new StringVal(bs);
-		val->Assign(bof_buffer_idx, bof_buffer_val);
+		val->Assign(bof_buffer_idx, bof_buffer_val->Ref());
 		}
 
-	if ( ! FileEventAvailable(file_sniff) )
+	bool sniff = FileEventAvailable(file_sniff);
+
+	if ( ! sniff && ! file_mgr->DropsByMIMEType() )
+		{
+		CheckDropPolicy("");
 		return;
+		}
 
 	RuleMatcher::MIME_Matches matches;
 	const u_char* data = bof_buffer_val->AsString()->Bytes();
@@ -336,12 +348,21 @@ void File::InferMetadata()
 	len = min(len, LookupFieldDefaultCount(bof_buffer_size_idx));
 	file_mgr->DetectMIME(data, len, &matches);
 
+	string mime_type;
+
+	if ( ! matches.empty() )
+		mime_type = *(matches.begin()->second.begin());
+
+	CheckDropPolicy(mime_type);
+
+	if ( ! sniff )
+		return;
+
 	RecordVal* meta = new RecordVal(fa_metadata_type);
 
 	if ( ! matches.empty() )
 		{
-		meta->Assign(meta_mime_type_idx,
-		             new StringVal(*(matches.begin()->second.begin())));
+		meta->Assign(meta_mime_type_idx, new StringVal(mime_type));
 		meta->Assign(meta_mime_types_idx,
 		             file_analysis::GenMIMEMatchesVal(matches));
 		}
@@ -350,26 +371,79 @@ void File::InferMetadata()
 	return;
 	}
 
+void File::CheckDropPolicy(const string& mime_type)
+	{
+	if ( dropped )
+		return;
+
+	Val* total = val->Lookup(total_bytes_idx);
+
+	if ( ! file_mgr->DropContent(mime_type, GetSource(),
+	                             total ? total->AsCount() : 0) )
+		return;
+
+	DBG_LOG(DBG_FILE_ANALYSIS, "[%s] Dropping content of %s file",
+	        id.c_str(), mime_type.empty() ? "unknown" : mime_type.c_str());
+
+	dropped = true;
+	DisableReassembly();
+
+	file_analysis::Analyzer* a = 0;
+	IterCookie* c = analyzers.InitForIteration();
+
+	while ( (a = analyzers.NextEntry(c)) )
+		analyzers.QueueRemove(a->Tag(), a->Args());
+	}
+
+StringVal* File::BOFBufferVal()
+	{
+	if ( ! bof_buffer.val && bof_buffer.size > 0 )
+		{
+		bof_buffer.data[bof_buffer.size] = '\0';
+		bof_buffer.val = new StringVal(new BroString(1, bof_buffer.data,
+		                                             bof_buffer.size));
+		bof_buffer.data = 0;
+		bof_buffer.capacity = 0;
+		}
+
+	return bof_buffer.val;
+	}
+
 bool File::BufferBOF(const u_char* data, uint64 len)
 	{
-	if ( bof_buffer.full )
+	if ( bof_buffer.full || bof_buffer.val )
 		return false;
 
 	uint64 desired_size = LookupFieldDefaultCount(bof_buffer_size_idx);
 
-	bof_buffer.chunks.push_back(new BroString(data, len, 0));
+	if ( bof_buffer.size + len > bof_buffer.capacity )
+		{
+		// Usually a single allocation covers the whole buffer.  The
+		// extra byte is for the NUL the string value wants.
+		uint64 capacity = max(desired_size, bof_buffer.size + len);
+		u_char* b = new u_char[capacity + 1];
+
+		if ( bof_buffer.size > 0 )
+			memcpy(b, bof_buffer.data, bof_buffer.size);
+
+		delete [] bof_buffer.data;
+		bof_buffer.data = b;
+		bof_buffer.capacity = capacity;
+		}
+
+	if ( len > 0 )
+		memcpy(bof_buffer.data + bof_buffer.size, data, len);
+
 	bof_buffer.size += len;
+	bof_buffer.chunk_ends.push_back(bof_buffer.size);
 
 	if ( bof_buffer.size < desired_size )
 		return true;
 
 	bof_buffer.full = true;
 
-	if ( bof_buffer.size > 0 )
-		{
-		BroString* bs = concatenate(bof_buffer.chunks);
-		val->Assign(bof_buffer_idx, new StringVal(bs));
-		}
+	if ( StringVal* v = BOFBufferVal() )
+		val->Assign(bof_buffer_idx, v->Ref());
 
 	return false;
 	}
@@ -384,6 +458,13 @@ void File::DeliverStream(const u_char* data, uint64 len)
 	     LookupFieldDefaultCount(missing_bytes_idx) == 0 )
 		InferMetadata();
 
+	if ( dropped )
+		{
+		stream_offset += len;
+		IncrementByteCount(len, seen_bytes_idx);
+		return;
+		}
+
 	DBG_LOG(DBG_FILE_ANALYSIS,
 	        "[%s] %" PRIu64 " stream bytes in at offset %" PRIu64 "; %s [%s%s]",
 	        id.c_str(), len, stream_offset,
@@ -400,7 +481,7 @@ void File::DeliverStream(const u_char* data, uint64 len)
 		if ( ! a->GotStreamDelivery() )
 			{
 			DBG_LOG(DBG_FILE_ANALYSIS, "skipping stream delivery to analyzer %s", file_mgr->GetComponentName(a->Tag()).c_str());
-			int num_bof_chunks_behind = bof_buffer.chunks.size();
+			int num_bof_chunks_behind = bof_buffer.chunk_ends.size();
 
 			if ( ! bof_was_full )
 				// We just added a chunk to the BOF buffer, don't count it
@@ -409,20 +490,23 @@ void File::DeliverStream(const u_char* data, uint64 len)
 
 			uint64 bytes_delivered = 0;
 
-			// Catch this analyzer up with the BOF buffer.
+			// Catch this analyzer up with the BOF buffer, chunk by
+			// chunk as the data came in.
 			for ( int i = 0; i < num_bof_chunks_behind; ++i )
 				{
+				uint64 chunk_len = bof_buffer.chunk_ends[i] - bytes_delivered;
+
 				if ( ! a->Skipping() )
 					{
-					if ( ! a->DeliverStream(bof_buffer.chunks[i]->Bytes(),
-								bof_buffer.chunks[i]->Len()) )
+					if ( ! a->DeliverStream(bof_buffer.Bytes() + bytes_delivered,
+								chunk_len) )
 						{
 						a->SetSkip(true);
 						analyzers.QueueRemove(a->Tag(), a->Args());
 						}
 					}
 
-				bytes_delivered += bof_buffer.chunks[i]->Len();
+				bytes_delivered += chunk_len;
 				}
 
 			a->SetGotStreamDelivery();
@@ -446,6 +530,18 @@ void File::DeliverStream(const u_char* data, uint64 len)
 
 void File::DeliverChunk(const u_char* data, uint64 len, uint64 offset)
 	{
+	if ( dropped )
+		{
+		// Just keep track of how far the file got.
+		IncrementByteCount(len, seen_bytes_idx);
+		stream_offset = max(stream_offset, offset + len);
+
+		if ( IsComplete() )
+			EndOfFile();
+
+		return;
+		}
+
 	// Potentially handle reassembly and deliver to the stream analyzers.
 	if ( file_reassembler )
 		{
@@ -495,6 +591,15 @@ void File::DeliverChunk(const u_char* data, uint64 len, uint64 offset)
 	        fmt_bytes((const char*) data, min((uint64)40, len)),
 	        len > 40 ? "..." : "");
 
+	if ( dropped )
+		{
+		// The content turned out not to be of interest.
+		if ( IsComplete() )
+			EndOfFile();
+
+		return;
+		}
+
 	file_analysis::Analyzer* a = 0;
 	IterCookie* c = analyzers.InitForIteration();
 
@@ -568,11 +673,45 @@ void File::EndOfFile()
 			analyzers.QueueRemove(a->Tag(), a->Args());
 		}
 
+	if ( pending_jobs )
+		{
+		// Analyzers still have results to report, which need to come
+		// before the file goes away.
+		eof_pending = true;
+		return;
+		}
+
+	FinishEndOfFile();
+	}
+
+void File::FinishEndOfFile()
+	{
 	FileEvent(file_state_remove);
 
 	analyzers.DrainModifications();
 	}
 
+void File::JobDone()
+	{
+	assert(pending_jobs > 0);
+
+	if ( --pending_jobs )
+		return;
+
+	if ( eof_pending )
+		{
+		eof_pending = false;
+		FinishEndOfFile();
+		}
+
+	if ( remove_pending )
+		{
+		// This deletes us.
+		string file_id = id;
+		file_mgr->RemoveFile(file_id);
+		}
+	}
+
 void File::Gap(uint64 offset, uint64 len)
 	{
 	DBG_LOG(DBG_FILE_ANALYSIS, "[%s] Gap of size %" PRIu64 " at offset %" PRIu64,
@@ -649,8 +788,8 @@ void File::FileEvent(EventHandlerPtr h, val_list vl)
 		}
 	}
 
-bool File::PermitWeird(const char* name, uint64 threshold, uint64 rate,
+bool File::PermitWeird(uint32 weird_id, uint64 threshold, uint64 rate,
                        double duration)
 	{
-	return ::PermitWeird(weird_state, name, threshold, rate, duration);
+	return ::PermitWeird(weird_state, weird_id, threshold, rate, duration);
 	}
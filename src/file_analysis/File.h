@@ -96,13 +96,6 @@ public:
 	 */
 	bool IsComplete() const;
 
-	/**
-	 * Create a timer to be dispatched after the amount of time indicated by
-	 * the "timeout_interval" field of the #val record in order to check if
-	 * "last_active" field is old enough to timeout analysis of the file.
-	 */
-	void ScheduleInactivityTimer() const;
-
 	/**
 	 * Queues attaching an analyzer.  Only one analyzer per type can be attached
 	 * at a time unless the arguments differ.
@@ -145,6 +138,26 @@ public:
 	 */
 	void EndOfFile();
 
+	/**
+	 * Notes that an analyzer has handed work off to a thread, the results
+	 * of which it will report later. Until all such jobs have called
+	 * JobDone(), the file's end (i.e. \c file_state_remove) and its
+	 * removal are held back.
+	 */
+	void AddPendingJob()	{ ++pending_jobs; }
+
+	/**
+	 * Notes that a job announced through AddPendingJob() has reported
+	 * its results. This may complete a deferred removal of the file, so
+	 * the caller must not access the file anymore afterwards.
+	 */
+	void JobDone();
+
+	/**
+	 * @return true if there are jobs that haven't called JobDone() yet.
+	 */
+	bool HasPendingJobs() const	{ return pending_jobs > 0; }
+
 	/**
 	 * Inform attached analyzers about a gap in file stream.
 	 * @param offset number of bytes in to file at which missing chunk starts.
@@ -203,7 +216,7 @@ public:
 	 * Whether to permit a weird to carry on through the full reporter/weird
 	 * framework.
 	 */
-	bool PermitWeird(const char* name, uint64 threshold, uint64 rate,
+	bool PermitWeird(uint32 weird_id, uint64 threshold, uint64 rate,
 	                 double duration);
 
 protected:
@@ -276,6 +289,20 @@ protected:
 	 */
 	void InferMetadata();
 
+	/**
+	 * Returns the BOF buffer's contents as a string value, which from then
+	 * on holds them, or null if nothing has been buffered.
+	 */
+	StringVal* BOFBufferVal();
+
+	/**
+	 * Applies the file analysis manager's drop policy once the file's
+	 * metadata is known: if the content isn't of interest, removes all
+	 * analyzers and only counts any further data.
+	 * @param mime_type the file's MIME type, or empty if unknown.
+	 */
+	void CheckDropPolicy(const string& mime_type);
+
 	/**
 	 * Enables reassembly on the file.
 	 */
@@ -316,6 +343,12 @@ protected:
 	 */
 	static void StaticInit();
 
+	/**
+	 * Raises \c file_state_remove, which EndOfFile() may have deferred
+	 * until all pending jobs are done.
+	 */
+	void FinishEndOfFile();
+
 protected:
 	string id;                 /**< A pretty hash that likely identifies file */
 	RecordVal* val;            /**< \c fa_file from script layer. */
@@ -326,20 +359,34 @@ protected:
 	bool reassembly_enabled;           /**< Whether file stream reassembly is needed. */
 	bool postpone_timeout;     /**< Whether postponing timeout is requested. */
 	bool done;                 /**< If this object is about to be deleted. */
+	bool dropped;              /**< Whether the content is only counted anymore. */
+	int pending_jobs;          /**< Number of jobs yet to report back. */
+	bool eof_pending;          /**< Whether EndOfFile() waits for pending jobs. */
+	bool remove_pending;       /**< Whether removal waits for pending jobs. */
 	AnalyzerSet analyzers;     /**< A set of attached file analyzers. */
 	std::list<Analyzer *> done_analyzers; /**< Analyzers we're done with, remembered here until they can be safely deleted. */
 
+	/**
+	 * The beginning of the file, kept in a single buffer that MIME
+	 * detection, the fa_file record's bof_buffer field and analyzers
+	 * catching up with the stream all share.
+	 */
 	struct BOF_Buffer {
-		BOF_Buffer() : full(false), size(0) {}
-		~BOF_Buffer()
-			{ for ( size_t i = 0; i < chunks.size(); ++i ) delete chunks[i]; }
+		BOF_Buffer() : full(false), size(0), capacity(0), data(0), val(0) {}
+		~BOF_Buffer()	{ delete [] data; Unref(val); }
+
+		const u_char* Bytes() const
+			{ return val ? val->Bytes() : data; }
 
 		bool full;
 		uint64 size;
-		BroString::CVec chunks;
+		uint64 capacity;
+		u_char* data;	// The bytes while filling, until val takes them over.
+		StringVal* val;
+		std::vector<uint64> chunk_ends;	// Where each delivered chunk ends.
 	} bof_buffer;              /**< Beginning of file buffer. */
 
-	WeirdStateMap weird_state;
+	WeirdStateVector weird_state;
 
 	static int id_idx;
 	static int parent_id_idx;
@@ -9,7 +9,8 @@
 namespace file_analysis {
 
 /**
- * Timer to periodically check if file analysis for a given file is inactive.
+ * Timer to periodically check all files for inactivity.  A single one is
+ * pending at a time, rather than one per file.
  */
 class FileTimer : public Timer {
 public:
@@ -17,21 +18,17 @@ public:
 	/**
 	 * Constructor, nothing interesting about it.
 	 * @param t unix time at which the timer should start ticking.
-	 * @param id the file identifier which will be checked for inactivity.
 	 * @param interval amount of time after \a t to check for inactivity.
 	 */
-	FileTimer(double t, const string& id, double interval);
+	FileTimer(double t, double interval);
 
 	/**
-	 * Check inactivity of file_analysis::File corresponding to #file_id,
-	 * reschedule if active, else call file_analysis::Manager::Timeout.
+	 * Calls file_analysis::Manager::Timeout for the files that have been
+	 * inactive too long, and reschedules while any files remain.
 	 * @param t current unix time
 	 * @param is_expire true if all pending timers are being expired.
 	 */
 	void Dispatch(double t, int is_expire) override;
-
-private:
-	string file_id;
 };
 
 } // namespace file_analysis
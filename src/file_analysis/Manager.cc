@@ -14,6 +14,7 @@
 
 #include "plugin/Manager.h"
 #include "analyzer/Manager.h"
+#include "threading/Offload.h"
 
 using namespace file_analysis;
 
@@ -24,7 +25,9 @@ string Manager::salt;
 Manager::Manager()
 	: plugin::ComponentManager<file_analysis::Tag,
 	                           file_analysis::Component>("Files", "Tag"),
-	id_map(), ignored(), current_file_id(), magic_state()
+	id_map(), ignored(), current_file_id(), magic_state(),
+	drop_mime_types(), drop_sources(), drop_size_threshold(),
+	last_file(), sweep_pending(false)
 	{
 	}
 
@@ -58,6 +61,9 @@ void Manager::InitPreScript()
 
 void Manager::InitPostScript()
 	{
+	drop_mime_types = internal_const_val("Files::drop_mime_types")->AsTableVal();
+	drop_sources = internal_const_val("Files::drop_sources")->AsTableVal();
+	drop_size_threshold = internal_const_val("Files::drop_size_threshold")->AsCount();
 	}
 
 void Manager::InitMagic()
@@ -68,6 +74,9 @@ void Manager::InitMagic()
 
 void Manager::Terminate()
 	{
+	// Let analyzers report anything they have handed off to threads.
+	offload_pool->Drain();
+
 	vector<string> keys;
 
 	IterCookie* it = id_map.InitForIteration();
@@ -83,6 +92,7 @@ void Manager::Terminate()
 	for ( size_t i = 0; i < keys.size(); ++i )
 		Timeout(keys[i], true);
 
+	offload_pool->Drain();
 	mgr.Drain();
 	}
 
@@ -326,10 +336,10 @@ File* Manager::GetFile(const string& file_id, Connection* conn,
 	if ( file_id.empty() )
 		return 0;
 
-	if ( IsIgnored(file_id) )
+	if ( ignored.Length() > 0 && IsIgnored(file_id) )
 		return 0;
 
-	File* rval = id_map.Lookup(file_id.c_str());
+	File* rval = LookupFile(file_id);
 
 	if ( ! rval )
 		{
@@ -338,7 +348,14 @@ File* Manager::GetFile(const string& file_id, Connection* conn,
 		                            : analyzer_mgr->GetComponentName(tag),
 		                conn, tag, is_orig);
 		id_map.Insert(file_id.c_str(), rval);
-		rval->ScheduleInactivityTimer();
+		last_file = rval;
+
+		if ( ! sweep_pending )
+			{
+			timer_mgr->Add(new FileTimer(network_time,
+			                             BifConst::Files::inactivity_sweep_interval));
+			sweep_pending = true;
+			}
 
 		// Generate file_new after inserting it into manager's mapping
 		// in case script-layer calls back in to core from the event.
@@ -362,7 +379,52 @@ File* Manager::GetFile(const string& file_id, Connection* conn,
 
 File* Manager::LookupFile(const string& file_id) const
 	{
-	return id_map.Lookup(file_id.c_str());
+	// The chunks of a file usually come in a row, so remembering the last
+	// file looked up saves hashing its ID most of the time.
+	if ( last_file && last_file->GetID() == file_id )
+		return last_file;
+
+	File* f = id_map.Lookup(file_id.c_str());
+
+	if ( f )
+		last_file = f;
+
+	return f;
+	}
+
+void Manager::SweepInactive(double t)
+	{
+	vector<string> inactive;
+	IterCookie* it = id_map.InitForIteration();
+	File* f;
+
+	while ( (f = id_map.NextEntry(it)) )
+		{
+		double last_active = f->GetLastActivityTime();
+
+		DBG_LOG(DBG_FILE_ANALYSIS, "Checking inactivity for %s, last active at %f",
+		        f->GetID().c_str(), last_active);
+
+		if ( last_active == 0.0 )
+			{
+			// Was created when network_time was zero, so start
+			// counting from now.
+			f->UpdateLastActivityTime();
+			continue;
+			}
+
+		if ( t - last_active >= f->GetTimeoutInterval() )
+			inactive.push_back(f->GetID());
+		}
+
+	for ( size_t i = 0; i < inactive.size(); ++i )
+		Timeout(inactive[i]);
+
+	if ( id_map.Length() > 0 )
+		{
+		timer_mgr->Add(new FileTimer(t, BifConst::Files::inactivity_sweep_interval));
+		sweep_pending = true;
+		}
 	}
 
 void Manager::Timeout(const string& file_id, bool is_terminating)
@@ -381,7 +443,6 @@ void Manager::Timeout(const string& file_id, bool is_terminating)
 		DBG_LOG(DBG_FILE_ANALYSIS, "Postpone file analysis timeout for %s",
 		        file->GetID().c_str());
 		file->UpdateLastActivityTime();
-		file->ScheduleInactivityTimer();
 		return;
 		}
 
@@ -416,6 +477,18 @@ bool Manager::RemoveFile(const string& file_id)
 	DBG_LOG(DBG_FILE_ANALYSIS, "[%s] Remove file", file_id.c_str());
 
 	f->EndOfFile();
+
+	if ( f->HasPendingJobs() )
+		{
+		// The file gets removed once its jobs are done, see
+		// File::JobDone().
+		f->remove_pending = true;
+		return true;
+		}
+
+	if ( f == last_file )
+		last_file = 0;
+
 	delete f;
 	id_map.Remove(&key);
 	delete static_cast<bool*>(ignored.Remove(&key));
@@ -452,6 +525,35 @@ string Manager::GetFileID(analyzer::Tag tag, Connection* c, bool is_orig)
 	return current_file_id;
 	}
 
+bool Manager::DropContent(const string& mime_type, const string& source,
+                          uint64 total_bytes) const
+	{
+	if ( drop_size_threshold && total_bytes > drop_size_threshold )
+		return true;
+
+	if ( ! source.empty() && drop_sources && drop_sources->Size() > 0 )
+		{
+		StringVal* sv = new StringVal(source);
+		bool found = drop_sources->Lookup(sv, false);
+		Unref(sv);
+
+		if ( found )
+			return true;
+		}
+
+	if ( ! mime_type.empty() && DropsByMIMEType() )
+		{
+		StringVal* mv = new StringVal(mime_type);
+		bool found = drop_mime_types->Lookup(mv, false);
+		Unref(mv);
+
+		if ( found )
+			return true;
+		}
+
+	return false;
+	}
+
 bool Manager::IsDisabled(analyzer::Tag tag)
 	{
 	if ( ! disabled )
@@ -335,6 +335,7 @@ public:
 
 protected:
 	friend class FileTimer;
+	friend class File;
 
 	typedef PDict<bool> IDSet;
 	typedef PDict<File> IDMap;
@@ -371,6 +372,14 @@ protected:
 	 */
 	void Timeout(const string& file_id, bool is_terminating = ::terminating);
 
+	/**
+	 * Evaluates the timeout policy of every file that has been inactive
+	 * for at least its timeout interval, and schedules the next sweep
+	 * while any files remain.
+	 * @param t the current time.
+	 */
+	void SweepInactive(double t);
+
 	/**
 	 * Immediately remove file_analysis::File object associated with \a file_id.
 	 * @param file_id the file identifier/hash.
@@ -401,6 +410,27 @@ protected:
 	 */
 	static bool IsDisabled(analyzer::Tag tag);
 
+	/**
+	 * Checks whether a file's content is to be dropped rather than
+	 * analyzed, per :zeek:see:`Files::drop_mime_types`,
+	 * :zeek:see:`Files::drop_sources` and
+	 * :zeek:see:`Files::drop_size_threshold`.
+	 * @param mime_type the file's detected MIME type, or empty if unknown.
+	 * @param source the file's source, e.g. "HTTP".
+	 * @param total_bytes the file's announced size, or zero if unknown.
+	 * @return true if the file's content is to be dropped.
+	 */
+	bool DropContent(const string& mime_type, const string& source,
+	                 uint64 total_bytes) const;
+
+	/**
+	 * @return whether files may get their content dropped because of
+	 *         their MIME type, which then needs to be detected even if
+	 *         no script asks for it.
+	 */
+	bool DropsByMIMEType() const
+		{ return drop_mime_types && drop_mime_types->Size() > 0; }
+
 private:
 	typedef set<Tag> TagSet;
 	typedef map<string, TagSet*> MIMEMap;
@@ -412,6 +442,11 @@ private:
 	string current_file_id;	/**< Hash of what get_file_handle event sets. */
 	RuleFileMagicState* magic_state;	/**< File magic signature match state. */
 	MIMEMap mime_types;/**< Mapping of MIME types to analyzers. */
+	TableVal* drop_mime_types;	/**< MIME types whose content is dropped. */
+	TableVal* drop_sources;	/**< Sources whose content is dropped. */
+	uint64 drop_size_threshold;	/**< Size beyond which content is dropped. */
+	mutable File* last_file;	/**< The file looked up last. */
+	bool sweep_pending;	/**< Whether an inactivity sweep is scheduled. */
 
 	static TableVal* disabled;	/**< Table of disabled analyzers. */
 	static TableType* tag_set_type;	/**< Type for set[tag]. */
@@ -7,13 +7,15 @@
 #include "Event.h"
 #include "file_analysis/Manager.h"
 
+#include "const.bif.h"
+
 using namespace file_analysis;
 
 Entropy::Entropy(RecordVal* args, File* file)
     : file_analysis::Analyzer(file_mgr->GetComponentTag("ENTROPY"), args, file)
 	{
 	//entropy->Init();
-	entropy = new EntropyVal;
+	entropy = new EntropyVal(! BifConst::FileEntropy::sequence_tests);
 	fed = false;
 	}
 
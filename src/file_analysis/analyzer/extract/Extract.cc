@@ -7,14 +7,87 @@
 #include "util.h"
 #include "Event.h"
 #include "file_analysis/Manager.h"
+#include "threading/Offload.h"
+#include "const.bif.h"
 
 using namespace file_analysis;
 
+// Bytes handed to worker threads across all extracted files.
+static uint64 total_buffered = 0;
+
+namespace {
+
+// Writes a chunk of an extracted file in a worker thread.
+class ExtractWriteJob : public threading::OffloadJob {
+public:
+	ExtractWriteJob(int arg_fd, const char* data, uint64 len,
+	                std::shared_ptr<uint64> arg_buffered)
+		: fd(arg_fd), chunk(data, len), buffered(std::move(arg_buffered))
+		{ }
+
+	void Run() override
+		{ safe_write(fd, chunk.data(), chunk.size()); }
+
+	void Complete() override
+		{
+		*buffered -= chunk.size();
+		total_buffered -= chunk.size();
+		}
+
+private:
+	int fd;
+	std::string chunk;
+	std::shared_ptr<uint64> buffered;
+};
+
+// Closes an extracted file in a worker thread, after its writes.
+class ExtractCloseJob : public threading::OffloadJob {
+public:
+	ExtractCloseJob(int arg_fd, Val* arg_file, Val* arg_args, uint64 arg_size)
+		: fd(arg_fd), file(arg_file), args(arg_args), size(arg_size)
+		{ }
+
+	~ExtractCloseJob() override
+		{
+		Unref(file);
+		Unref(args);
+		}
+
+	void Run() override
+		{ safe_close(fd); }
+
+	void Complete() override
+		{
+		if ( ! file )
+			return;
+
+		mgr.QueueEventFast(file_extraction_done, {
+			file,
+			args,
+			val_mgr->GetCount(size),
+		});
+
+		file = args = nullptr;
+		}
+
+private:
+	int fd;
+	Val* file;
+	Val* args;
+	uint64 size;
+};
+
+}
+
 Extract::Extract(RecordVal* args, File* file, const string& arg_filename,
                  uint64 arg_limit)
     : file_analysis::Analyzer(file_mgr->GetComponentTag("EXTRACT"), args, file),
-      filename(arg_filename), limit(arg_limit), depth(0)
+      filename(arg_filename), limit(arg_limit), depth(0),
+      buffered(std::make_shared<uint64>(0))
 	{
+	async = BifConst::FileExtract::async_writes &&
+	        BifConst::Threading::offload_threads > 0;
+
 	fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0666);
 
 	if ( fd < 0 )
@@ -28,8 +101,7 @@ Extract::Extract(RecordVal* args, File* file, const string& arg_filename,
 
 Extract::~Extract()
 	{
-	if ( fd )
-		safe_close(fd);
+	Close(false);
 	}
 
 static Val* get_extract_field_val(RecordVal* args, const char* name)
@@ -104,22 +176,82 @@ bool Extract::DeliverStream(const u_char* data, uint64 len)
 
 	if ( towrite > 0 )
 		{
-		safe_write(fd, reinterpret_cast<const char*>(data), towrite);
+		Write(reinterpret_cast<const char*>(data), towrite);
 		depth += towrite;
 		}
 
+	if ( limit_exceeded )
+		Close(true);
+
 	return ( ! limit_exceeded );
 	}
 
 bool Extract::Undelivered(uint64 offset, uint64 len)
 	{
-	if ( depth == offset )
+	if ( fd && depth == offset )
 		{
 		char* tmp = new char[len]();
-		safe_write(fd, tmp, len);
+		Write(tmp, len);
 		delete [] tmp;
 		depth += len;
 		}
 
 	return true;
 	}
+
+bool Extract::EndOfFile()
+	{
+	Close(true);
+	return false;
+	}
+
+void Extract::Write(const char* data, uint64 len)
+	{
+	if ( ! async )
+		{
+		safe_write(fd, data, len);
+		return;
+		}
+
+	if ( *buffered + len > BifConst::FileExtract::async_file_buffer_size ||
+	     total_buffered + len > BifConst::FileExtract::async_buffer_size )
+		// The disk doesn't keep up; wait for it rather than buffering
+		// ever more.
+		offload_pool->Drain();
+
+	*buffered += len;
+	total_buffered += len;
+
+	// All operations on the file go to the same worker, which keeps them
+	// in order.
+	offload_pool->Submit(new ExtractWriteJob(fd, data, len, buffered), fd);
+	}
+
+void Extract::Close(bool done_event)
+	{
+	if ( ! fd )
+		return;
+
+	Val* file_val = nullptr;
+	Val* args_val = nullptr;
+
+	if ( done_event && file_extraction_done )
+		{
+		file_val = GetFile()->GetVal()->Ref();
+		args_val = Args()->Ref();
+		}
+
+	auto job = new ExtractCloseJob(fd, file_val, args_val, depth);
+	int closing_fd = fd;
+	fd = 0;
+
+	if ( async )
+		{
+		offload_pool->Submit(job, closing_fd);
+		return;
+		}
+
+	job->Run();
+	job->Complete();
+	delete job;
+	}
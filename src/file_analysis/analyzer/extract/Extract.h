@@ -3,6 +3,7 @@
 #ifndef FILE_ANALYSIS_EXTRACT_H
 #define FILE_ANALYSIS_EXTRACT_H
 
+#include <memory>
 #include <string>
 
 #include "Val.h"
@@ -41,6 +42,12 @@ public:
 	 */
 	bool Undelivered(uint64 offset, uint64 len) override;
 
+	/**
+	 * Closes the extraction file and raises "file_extraction_done".
+	 * @return false, so that the analyzer detaches from the file.
+	 */
+	bool EndOfFile() override;
+
 	/**
 	 * Create a new instance of an Extract analyzer.
 	 * @param args the \c AnalyzerArgs value which represents the analyzer.
@@ -71,10 +78,24 @@ protected:
 	        uint64 arg_limit);
 
 private:
+	/**
+	 * Writes to the extraction file, or has a worker thread do that.
+	 */
+	void Write(const char* data, uint64 len);
+
+	/**
+	 * Closes the extraction file, optionally raising
+	 * "file_extraction_done" once that has happened.
+	 */
+	void Close(bool done_event);
+
 	string filename;
 	int fd;
 	uint64 limit;
 	uint64 depth;
+	bool async;
+	// Bytes handed to worker threads, but not written yet.
+	std::shared_ptr<uint64> buffered;
 };
 
 } // namespace file_analysis
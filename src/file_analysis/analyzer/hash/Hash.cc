@@ -1,6 +1,7 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
 #include <string>
+#include <algorithm>
 
 #include "Hash.h"
 #include "util.h"
@@ -57,3 +58,119 @@ void Hash::Finalize()
 		hash->Get(),
 	});
 	}
+
+// The amount of data that each digest gets at a time.  Small enough for
+// the block to still be in cache when the next digest reads it.
+static const uint64 hash_block_size = 16384;
+
+Hashes::Hashes(RecordVal* args, File* file, std::vector<Digest> arg_digests)
+	: file_analysis::Analyzer(file_mgr->GetComponentTag("HASHES"), args, file),
+	  digests(std::move(arg_digests)), fed(false)
+	{
+	}
+
+Hashes::~Hashes()
+	{
+	for ( auto& d : digests )
+		Unref(d.hash);
+	}
+
+file_analysis::Analyzer* Hashes::Instantiate(RecordVal* args, File* file)
+	{
+	if ( ! file_hash )
+		return 0;
+
+	static const struct {
+		const char* kind;
+		HashVal* (*make)();
+	} kinds[] = {
+		{ "md5", []() -> HashVal* { return new MD5Val(); } },
+		{ "sha1", []() -> HashVal* { return new SHA1Val(); } },
+		{ "sha256", []() -> HashVal* { return new SHA256Val(); } },
+	};
+
+	TableVal* wanted = nullptr;
+
+	if ( Val* v = args->Lookup("digests") )
+		wanted = v->AsTableVal();
+
+	std::vector<Digest> digests;
+
+	for ( const auto& k : kinds )
+		{
+		if ( wanted )
+			{
+			auto kind = new StringVal(k.kind);
+			bool want = wanted->Lookup(kind, false);
+			Unref(kind);
+
+			if ( ! want )
+				continue;
+			}
+
+		auto hv = k.make();
+		hv->Init();
+		digests.push_back({k.kind, hv});
+		}
+
+	if ( digests.empty() )
+		return 0;
+
+	return new Hashes(args, file, std::move(digests));
+	}
+
+bool Hashes::DeliverStream(const u_char* data, uint64 len)
+	{
+	bool valid = false;
+
+	for ( const auto& d : digests )
+		valid = valid || d.hash->IsValid();
+
+	if ( ! valid )
+		return false;
+
+	if ( ! fed )
+		fed = len > 0;
+
+	for ( uint64 off = 0; off < len; off += hash_block_size )
+		{
+		auto n = std::min(hash_block_size, len - off);
+
+		for ( auto& d : digests )
+			{
+			if ( d.hash->IsValid() )
+				d.hash->Feed(data + off, n);
+			}
+		}
+
+	return true;
+	}
+
+bool Hashes::EndOfFile()
+	{
+	Finalize();
+	return false;
+	}
+
+bool Hashes::Undelivered(uint64 offset, uint64 len)
+	{
+	return false;
+	}
+
+void Hashes::Finalize()
+	{
+	if ( ! fed || ! file_hash )
+		return;
+
+	for ( auto& d : digests )
+		{
+		if ( ! d.hash->IsValid() )
+			continue;
+
+		mgr.QueueEventFast(file_hash, {
+			GetFile()->GetVal()->Ref(),
+			new StringVal(d.kind),
+			d.hash->Get(),
+		});
+		}
+	}
@@ -14,6 +14,7 @@ public:
 		AddComponent(new ::file_analysis::Component("MD5", ::file_analysis::MD5::Instantiate));
 		AddComponent(new ::file_analysis::Component("SHA1", ::file_analysis::SHA1::Instantiate));
 		AddComponent(new ::file_analysis::Component("SHA256", ::file_analysis::SHA256::Instantiate));
+		AddComponent(new ::file_analysis::Component("HASHES", ::file_analysis::Hashes::Instantiate));
 
 		plugin::Configuration config;
 		config.name = "Zeek::FileHash";
@@ -632,7 +632,12 @@ void file_analysis::OCSP::ParseResponse(OCSP_RESPONSE *resp)
 	//ocsp_resp_record->Assign(7, new StringVal(len, buf));
 	//BIO_reset(bio);
 
-	certs_vector = new VectorVal(internal_type("x509_opaque_vector")->AsVectorType());
+	static VectorType* x509_opaque_vector = 0;
+
+	if ( ! x509_opaque_vector )
+		x509_opaque_vector = internal_type("x509_opaque_vector")->AsVectorType();
+
+	certs_vector = new VectorVal(x509_opaque_vector);
 	vl.push_back(certs_vector);
 
 #if ( OPENSSL_VERSION_NUMBER < 0x10100000L ) || defined(LIBRESSL_VERSION_NUMBER)
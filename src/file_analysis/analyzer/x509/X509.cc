@@ -1,14 +1,19 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
 #include <string>
+#include <list>
+#include <unordered_map>
 
 #include "X509.h"
 #include "Event.h"
+#include "NetVar.h"
+#include "digest.h"
 
 #include "events.bif.h"
 #include "types.bif.h"
 
 #include "file_analysis/Manager.h"
+#include "threading/Offload.h"
 
 #include <broker/error.hh>
 
@@ -20,10 +25,153 @@
 
 using namespace file_analysis;
 
+namespace file_analysis {
+
+// The events parsing a certificate has raised, for replaying them when the
+// same certificate comes along again. The arguments leave out the fa_file
+// record that comes first.
+struct CachedCertificate {
+	struct Event {
+		EventHandlerPtr handler;
+		std::vector<Val*> args;
+	};
+
+	~CachedCertificate()
+		{
+		for ( const auto& e : events )
+			for ( const auto& a : e.args )
+				Unref(a);
+		}
+
+	std::string key;
+	std::vector<Event> events;
+};
+
+}
+
+typedef std::list<std::shared_ptr<file_analysis::CachedCertificate>> cert_lru_list;
+
+// Most recently used certificates first.
+static cert_lru_list cert_lru;
+static std::unordered_map<std::string, cert_lru_list::iterator> cert_cache;
+
+static std::shared_ptr<file_analysis::CachedCertificate> lookup_certificate(const std::string& key)
+	{
+	auto i = cert_cache.find(key);
+
+	if ( i == cert_cache.end() )
+		return nullptr;
+
+	cert_lru.splice(cert_lru.begin(), cert_lru, i->second);
+	return *i->second;
+	}
+
+static void cache_certificate(std::shared_ptr<file_analysis::CachedCertificate> cached)
+	{
+	if ( cert_cache.find(cached->key) != cert_cache.end() )
+		// Another file with the same certificate got here first.
+		return;
+
+	cert_lru.push_front(cached);
+	cert_cache[cached->key] = cert_lru.begin();
+
+	while ( cert_lru.size() > BifConst::X509::certificate_cache_size )
+		{
+		cert_cache.erase(cert_lru.back()->key);
+		cert_lru.pop_back();
+		}
+	}
+
+// Scripts may modify the records they get, which mustn't show when we
+// hand out the same value again.
+static Val* copy_cached_val(Val* v)
+	{
+	switch ( v->Type()->Tag() ) {
+	case TYPE_RECORD:
+	case TYPE_VECTOR:
+	case TYPE_TABLE:
+		return v->Clone();
+
+	default:
+		return v->Ref();
+	}
+	}
+
+namespace file_analysis {
+
+// Decodes a certificate in a thread. Decoding, and the checks OpenSSL
+// computes and caches along with it, are what takes the time; the
+// conversion into script-land values then happens in the main thread.
+class X509ParseJob : public threading::OffloadJob {
+public:
+	X509ParseJob(file_analysis::X509* arg_analyzer, const std::string& arg_data,
+		     std::shared_ptr<CachedCertificate> arg_cached)
+		: analyzer(arg_analyzer), file(arg_analyzer->GetFile()),
+		  data(arg_data), cached(arg_cached), cert(0)
+		{ file->AddPendingJob(); }
+
+	~X509ParseJob() override
+		{
+		if ( cert )
+			X509_free(cert);
+		}
+
+	void Run() override
+		{
+		if ( cached )
+			return;
+
+		const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data());
+		cert = d2i_X509(NULL, &p, data.size());
+
+		if ( cert )
+			// Fills in the extension cache, which otherwise happens
+			// during the first lookup.
+			X509_check_purpose(cert, -1, 0);
+		}
+
+	void Complete() override
+		{
+		if ( analyzer )
+			{
+			analyzer->parse_job = 0;
+
+			if ( cached )
+				analyzer->ReplayCertificate(cached.get());
+			else
+				{
+				analyzer->CertificateParsed(cert);
+				cert = 0;
+				}
+			}
+
+		// May delete the file, and with it the analyzer.
+		file->JobDone();
+		}
+
+	void AnalyzerGone()	{ analyzer = 0; }
+
+private:
+	file_analysis::X509* analyzer;
+	File* file;
+	std::string data;
+	std::shared_ptr<CachedCertificate> cached;
+	::X509* cert;
+};
+
+}
+
 file_analysis::X509::X509(RecordVal* args, file_analysis::File* file)
 	: file_analysis::X509Common::X509Common(file_mgr->GetComponentTag("X509"), args, file)
 	{
 	cert_data.clear();
+	parse_job = 0;
+	}
+
+file_analysis::X509::~X509()
+	{
+	if ( parse_job )
+		parse_job->AnalyzerGone();
 	}
 
 bool file_analysis::X509::DeliverStream(const u_char* data, uint64 len)
@@ -40,15 +188,75 @@ bool file_analysis::X509::Undelivered(uint64 offset, uint64 len)
 
 bool file_analysis::X509::EndOfFile()
 	{
-	// ok, now we can try to parse the certificate with openssl. Should
-	// be rather straightforward...
-	const unsigned char* cert_char = reinterpret_cast<const unsigned char*>(cert_data.data());
+	std::shared_ptr<CachedCertificate> cached;
+
+	if ( BifConst::X509::certificate_cache_size > 0 )
+		{
+		// Popular certificates come along over and over again, so we
+		// skip parsing those we've seen recently.
+		u_char digest[SHA256_DIGEST_LENGTH];
+		EVP_MD_CTX* ctx = hash_init(Hash_SHA256);
+		hash_update(ctx, cert_data.data(), cert_data.size());
+		hash_final(ctx, digest);
+
+		cache_key.assign(reinterpret_cast<const char*>(digest), sizeof(digest));
+		cached = lookup_certificate(cache_key);
+		}
+
+	// ok, now we can try to parse the certificate with openssl. That may
+	// happen in a thread, in which case we report the results once it's
+	// done. Without offload threads, this returns only after that. A cache
+	// hit goes the same way so that the order of events stays the same.
+	parse_job = new X509ParseJob(this, cert_data, cached);
+	offload_pool->Submit(parse_job);
+	return false;
+	}
+
+void file_analysis::X509::RaiseEvent(EventHandlerPtr h, val_list vl)
+	{
+	if ( recording && h )
+		{
+		CachedCertificate::Event e;
+		e.handler = h;
+
+		for ( int i = 1; i < vl.length(); ++i )
+			e.args.push_back(copy_cached_val(vl[i]));
+
+		recording->events.push_back(std::move(e));
+		}
+
+	file_analysis::X509Common::RaiseEvent(h, std::move(vl));
+	}
+
+void file_analysis::X509::ReplayCertificate(const CachedCertificate* cached)
+	{
+	for ( const auto& e : cached->events )
+		{
+		val_list vl(e.args.size() + 1);
+		vl.append(GetFile()->GetVal()->Ref());
 
-	::X509* ssl_cert = d2i_X509(NULL, &cert_char, cert_data.size());
+		for ( const auto& a : e.args )
+			vl.append(copy_cached_val(a));
+
+		mgr.QueueEvent(e.handler, std::move(vl));
+		}
+	}
+
+void file_analysis::X509::CertificateParsed(::X509* ssl_cert)
+	{
 	if ( ! ssl_cert )
 		{
 		reporter->Weird(GetFile(), "x509_cert_parse_error");
-		return false;
+		return;
+		}
+
+	// We only cache what parses cleanly, as we'd not report weirds again.
+	uint64 weirds = reporter->GetWeirdCount();
+
+	if ( ! cache_key.empty() )
+		{
+		recording = std::make_shared<CachedCertificate>();
+		recording->key = cache_key;
 		}
 
 	X509Val* cert_val = new X509Val(ssl_cert); // cert_val takes ownership of ssl_cert
@@ -57,7 +265,7 @@ bool file_analysis::X509::EndOfFile()
 	RecordVal* cert_record = ParseCertificate(cert_val, GetFile());
 
 	// and send the record on to scriptland
-	mgr.QueueEvent(x509_certificate, {
+	RaiseEvent(x509_certificate, {
 		GetFile()->GetVal()->Ref(),
 		cert_val->Ref(),
 		cert_record->Ref(), // we Ref it here, because we want to keep a copy around for now...
@@ -83,7 +291,13 @@ bool file_analysis::X509::EndOfFile()
 	Unref(cert_record); // Unref the RecordVal that we kept around from ParseCertificate
 	Unref(cert_val); // Same for cert_val
 
-	return false;
+	if ( recording )
+		{
+		if ( reporter->GetWeirdCount() == weirds )
+			cache_certificate(recording);
+
+		recording = nullptr;
+		}
 	}
 
 RecordVal* file_analysis::X509::ParseCertificate(X509Val* cert_val, File* f)
@@ -229,7 +443,7 @@ void file_analysis::X509::ParseBasicConstraints(X509_EXTENSION* ex)
 			if ( constr->pathlen )
 				pBasicConstraint->Assign(1, val_mgr->GetCount((int32_t) ASN1_INTEGER_get(constr->pathlen)));
 
-			mgr.QueueEventFast(x509_ext_basic_constraints, {
+			RaiseEvent(x509_ext_basic_constraints, {
 				GetFile()->GetVal()->Ref(),
 				pBasicConstraint,
 			});
@@ -304,21 +518,21 @@ void file_analysis::X509::ParseSAN(X509_EXTENSION* ext)
 				{
 				case GEN_DNS:
 					if ( names == 0 )
-						names = new VectorVal(internal_type("string_vec")->AsVectorType());
+						names = new VectorVal(string_vec);
 
 					names->Assign(names->Size(), bs);
 					break;
 
 				case GEN_URI:
 					if ( uris == 0 )
-						uris = new VectorVal(internal_type("string_vec")->AsVectorType());
+						uris = new VectorVal(string_vec);
 
 					uris->Assign(uris->Size(), bs);
 					break;
 
 				case GEN_EMAIL:
 					if ( emails == 0 )
-						emails = new VectorVal(internal_type("string_vec")->AsVectorType());
+						emails = new VectorVal(string_vec);
 
 					emails->Assign(emails->Size(), bs);
 					break;
@@ -328,7 +542,7 @@ void file_analysis::X509::ParseSAN(X509_EXTENSION* ext)
 		else if ( gen->type == GEN_IPADD )
 			{
 				if ( ips == 0 )
-					ips = new VectorVal(internal_type("addr_vec")->AsVectorType());
+					ips = new VectorVal(addr_vec);
 
 				uint32* addr = (uint32*) gen->d.ip->data;
 
@@ -370,7 +584,7 @@ void file_analysis::X509::ParseSAN(X509_EXTENSION* ext)
 
 		sanExt->Assign(4, val_mgr->GetBool(otherfields));
 
-		mgr.QueueEvent(x509_ext_subject_alternative_name, {
+		RaiseEvent(x509_ext_subject_alternative_name, {
 			GetFile()->GetVal()->Ref(),
 			sanExt,
 		});
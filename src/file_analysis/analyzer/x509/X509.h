@@ -4,6 +4,7 @@
 #define FILE_ANALYSIS_X509_H
 
 #include <string>
+#include <memory>
 
 #include "OpaqueVal.h"
 #include "X509Common.h"
@@ -65,6 +66,8 @@ static void RSA_get0_key(const RSA *r,
 namespace file_analysis {
 
 class X509Val;
+class X509ParseJob;
+struct CachedCertificate;
 
 class X509 : public file_analysis::X509Common {
 public:
@@ -90,16 +93,38 @@ public:
 	static file_analysis::Analyzer* Instantiate(RecordVal* args, File* file)
 		{ return new X509(args, file); }
 
+	~X509() override;
+
+	void RaiseEvent(EventHandlerPtr h, val_list vl) override;
+
 protected:
 	X509(RecordVal* args, File* file);
 
 private:
+	friend class X509ParseJob;
+
+	// Reports a certificate that has been decoded, or a parse error
+	// if it's null. Takes ownership of the certificate.
+	void CertificateParsed(::X509* ssl_cert);
+
+	// Raises the events recorded for a certificate seen before.
+	void ReplayCertificate(const CachedCertificate* cached);
+
 	void ParseBasicConstraints(X509_EXTENSION* ex);
 	void ParseSAN(X509_EXTENSION* ex);
 	void ParseExtensionsSpecific(X509_EXTENSION* ex, bool, ASN1_OBJECT*, const char*) override;
 
 	std::string cert_data;
 
+	// Decoding of the certificate we've handed off, if still outstanding.
+	X509ParseJob* parse_job;
+
+	// SHA-256 of the certificate if caching is enabled, else empty.
+	std::string cache_key;
+
+	// Cache entry collecting the events raised while parsing, if any.
+	std::shared_ptr<CachedCertificate> recording;
+
 	// Helpers for ParseCertificate.
 	static StringVal* KeyCurve(EVP_PKEY *key);
 	static unsigned int KeyLength(EVP_PKEY *key);
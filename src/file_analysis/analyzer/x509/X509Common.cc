@@ -279,13 +279,13 @@ void file_analysis::X509Common::ParseExtension(X509_EXTENSION* ex, EventHandlerP
 	// but I am not sure if there is a better way to do it...
 
 	if ( h == ocsp_extension )
-		mgr.QueueEvent(h, {
+		RaiseEvent(h, {
 			GetFile()->GetVal()->Ref(),
 			pX509Ext,
 			val_mgr->GetBool(global ? 1 : 0),
 		});
 	else
-		mgr.QueueEvent(h, {
+		RaiseEvent(h, {
 			GetFile()->GetVal()->Ref(),
 			pX509Ext,
 		});
@@ -294,6 +294,11 @@ void file_analysis::X509Common::ParseExtension(X509_EXTENSION* ex, EventHandlerP
 	ParseExtensionsSpecific(ex, global, ext_asn, oid);
 	}
 
+void file_analysis::X509Common::RaiseEvent(EventHandlerPtr h, val_list vl)
+	{
+	mgr.QueueEvent(h, std::move(vl));
+	}
+
 StringVal* file_analysis::X509Common::GetExtensionFromBIO(BIO* bio, File* f)
 	{
 	BIO_flush(bio);
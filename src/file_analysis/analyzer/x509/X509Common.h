@@ -33,6 +33,16 @@ public:
 
 	static double GetTimeFromAsn1(const ASN1_TIME* atime, File* f, Reporter* reporter);
 
+	/**
+	 * Queues an event raised while parsing. The first argument must be
+	 * the file's \c fa_file record.
+	 *
+	 * @param h the event to raise.
+	 *
+	 * @param vl its arguments; ownership passes to the method.
+	 */
+	virtual void RaiseEvent(EventHandlerPtr h, val_list vl);
+
 protected:
 	X509Common(file_analysis::Tag arg_tag, RecordVal* arg_args, File* arg_file);
 
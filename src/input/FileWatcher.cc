@@ -0,0 +1,195 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <set>
+
+#ifdef HAVE_LINUX
+#include <sys/inotify.h>
+#endif
+
+#include "FileWatcher.h"
+#include "ReaderFrontend.h"
+#include "Manager.h"
+#include "Reporter.h"
+
+using namespace input;
+
+#ifdef HAVE_LINUX
+static const uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_ATTRIB;
+#endif
+
+FileWatcher::FileWatcher()
+	{
+#ifdef HAVE_LINUX
+	fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if ( fd < 0 )
+		reporter->Warning("cannot watch input files, will poll them instead: %s",
+				  strerror(errno));
+#else
+	fd = -1;
+#endif
+
+	// We only have something to do when our descriptor says so.
+	SetIdle(true);
+	}
+
+FileWatcher::~FileWatcher()
+	{
+	if ( fd >= 0 )
+		close(fd);
+	}
+
+bool FileWatcher::Watch(ReaderFrontend* reader, const std::string& path)
+	{
+#ifdef HAVE_LINUX
+	if ( fd < 0 )
+		return false;
+
+	std::string::size_type slash = path.rfind('/');
+	std::string dir = (slash == std::string::npos ? "." : path.substr(0, slash + 1));
+	std::string file = (slash == std::string::npos ? path : path.substr(slash + 1));
+
+	// Watching the same directory again returns the same descriptor.
+	int wd = inotify_add_watch(fd, dir.c_str(), WATCH_MASK);
+
+	if ( wd < 0 )
+		{
+		reporter->Warning("cannot watch %s, will poll it instead: %s",
+				  path.c_str(), strerror(errno));
+		return false;
+		}
+
+	Directory& d = dirs[wd];
+	d.path = dir;
+	d.files.insert(std::make_pair(file, reader));
+	FdsChanged();
+	return true;
+#else
+	return false;
+#endif
+	}
+
+void FileWatcher::Unwatch(ReaderFrontend* reader)
+	{
+#ifdef HAVE_LINUX
+	for ( std::map<int, Directory>::iterator d = dirs.begin(); d != dirs.end(); )
+		{
+		std::multimap<std::string, ReaderFrontend*>& files = d->second.files;
+
+		for ( std::multimap<std::string, ReaderFrontend*>::iterator f = files.begin(); f != files.end(); )
+			{
+			if ( f->second == reader )
+				files.erase(f++);
+			else
+				++f;
+			}
+
+		if ( files.empty() )
+			{
+			inotify_rm_watch(fd, d->first);
+			dirs.erase(d++);
+			}
+		else
+			++d;
+		}
+
+	FdsChanged();
+#endif
+	}
+
+void FileWatcher::RemoveDirectory(int wd)
+	{
+	std::map<int, Directory>::iterator d = dirs.find(wd);
+
+	if ( d == dirs.end() )
+		return;
+
+	// The readers take over again.
+	std::multimap<std::string, ReaderFrontend*>::iterator f;
+	for ( f = d->second.files.begin(); f != d->second.files.end(); ++f )
+		f->second->SetWatched(false);
+
+	dirs.erase(d);
+	FdsChanged();
+	}
+
+void FileWatcher::GetFds(iosource::FD_Set* read, iosource::FD_Set* write,
+                         iosource::FD_Set* except)
+	{
+	if ( fd >= 0 && ! dirs.empty() )
+		read->Insert(fd);
+	}
+
+double FileWatcher::NextTimestamp(double* network_time)
+	{
+	return timer_mgr->Time();
+	}
+
+void FileWatcher::Process()
+	{
+#ifdef HAVE_LINUX
+	// Several notifications for the same file make for just one update.
+	std::set<ReaderFrontend*> updates;
+	bool overflow = false;
+
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	while ( true )
+		{
+		ssize_t len = read(fd, buf, sizeof(buf));
+
+		if ( len <= 0 )
+			break;
+
+		for ( char* p = buf; p < buf + len; )
+			{
+			const struct inotify_event* ev = (const struct inotify_event*) p;
+			p += sizeof(struct inotify_event) + ev->len;
+
+			if ( ev->mask & IN_Q_OVERFLOW )
+				{
+				overflow = true;
+				continue;
+				}
+
+			if ( ev->mask & IN_IGNORED )
+				{
+				// The directory is gone.
+				RemoveDirectory(ev->wd);
+				continue;
+				}
+
+			std::map<int, Directory>::iterator d = dirs.find(ev->wd);
+
+			if ( d == dirs.end() || ! ev->len )
+				continue;
+
+			typedef std::multimap<std::string, ReaderFrontend*>::iterator iter;
+			std::pair<iter, iter> r = d->second.files.equal_range(ev->name);
+
+			for ( iter f = r.first; f != r.second; ++f )
+				updates.insert(f->second);
+			}
+		}
+
+	if ( overflow )
+		{
+		// We've lost track, so everybody checks.
+		std::map<int, Directory>::iterator d;
+		for ( d = dirs.begin(); d != dirs.end(); ++d )
+			{
+			std::multimap<std::string, ReaderFrontend*>::iterator f;
+			for ( f = d->second.files.begin(); f != d->second.files.end(); ++f )
+				updates.insert(f->second);
+			}
+		}
+
+	for ( std::set<ReaderFrontend*>::iterator i = updates.begin(); i != updates.end(); ++i )
+		(*i)->Update();
+#endif
+	}
@@ -0,0 +1,76 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef INPUT_FILEWATCHER_H
+#define INPUT_FILEWATCHER_H
+
+#include "zeek-config.h"
+
+#include <map>
+#include <string>
+
+#include "iosource/IOSource.h"
+
+namespace input {
+
+class ReaderFrontend;
+
+/**
+ * Tells readers when the files they read change, so that they don't need
+ * to check on every heartbeat. It watches the directories the files are
+ * in, which also catches files being replaced by renaming another one
+ * over them, and triggers an update of a file's readers when it has been
+ * written and closed, moved into place, or touched.
+ *
+ * This uses inotify and so only works on Linux. Elsewhere, Watch() fails
+ * and the readers keep checking themselves.
+ */
+class FileWatcher : public iosource::IOSource {
+public:
+	/**
+	 * Constructor.
+	 */
+	FileWatcher();
+
+	/**
+	 * Destructor.
+	 */
+	~FileWatcher() override;
+
+	/**
+	 * Returns true if the watcher can watch files on this system.
+	 */
+	bool IsValid() const	{ return fd >= 0; }
+
+	/**
+	 * Starts watching a file for a reader.
+	 *
+	 * @return True if the reader will be updated when the file changes.
+	 */
+	bool Watch(ReaderFrontend* reader, const std::string& path);
+
+	/**
+	 * Stops watching all files for a reader.
+	 */
+	void Unwatch(ReaderFrontend* reader);
+
+	void GetFds(iosource::FD_Set* read, iosource::FD_Set* write,
+	            iosource::FD_Set* except) override;
+	double NextTimestamp(double* network_time) override;
+	void Process() override;
+	const char* Tag() override	{ return "Input::FileWatcher"; }
+
+private:
+	struct Directory {
+		std::string path;
+		std::multimap<std::string, ReaderFrontend*> files;
+	};
+
+	void RemoveDirectory(int wd);
+
+	int fd;
+	std::map<int, Directory> dirs;	// Indexed by watch descriptor.
+};
+
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include "Manager.h"
 #include "ReaderFrontend.h"
 #include "ReaderBackend.h"
+#include "FileWatcher.h"
 #include "input.bif.h"
 
 #include "Event.h"
@@ -14,6 +15,7 @@
 #include "CompHash.h"
 
 #include "../file_analysis/Manager.h"
+#include "../iosource/Manager.h"
 #include "../threading/SerialTypes.h"
 
 using namespace input;
@@ -110,6 +112,12 @@ public:
 	PDict<InputHash>* currDict;
 	PDict<InputHash>* lastDict;
 
+	// True if complete reads replace the table's contents at once. A
+	// read then builds up the new contents in here, and swaps them in
+	// at the end.
+	bool replace;
+	TableVal* pending;
+
 	Func* pred;
 
 	EventHandlerPtr event;
@@ -141,7 +149,7 @@ public:
 Manager::TableStream::TableStream()
 	: Manager::Stream::Stream(TABLE_STREAM),
 	  num_idx_fields(), num_val_fields(), want_record(), tab(), rtype(),
-	  itype(), currDict(), lastDict(), pred(), event()
+	  itype(), currDict(), lastDict(), replace(), pending(), pred(), event()
 	{
 	}
 
@@ -168,6 +176,8 @@ Manager::TableStream::~TableStream()
 	if ( rtype ) // can be 0 for sets
 		Unref(rtype);
 
+	Unref(pending);
+
         if ( currDict != 0 )
 		{
 		currDict->Clear();
@@ -194,6 +204,7 @@ Manager::Manager()
 	: plugin::ComponentManager<input::Tag, input::Component>("Input", "Reader")
 	{
 	end_of_data = internal_handler("Input::end_of_data");
+	watcher = 0;
 	}
 
 Manager::~Manager()
@@ -282,6 +293,14 @@ bool Manager::CreateStream(Stream* info, RecordVal* description)
 
 	Unref(mode);
 
+	if ( info->stream_type == TABLE_STREAM )
+		{
+		Val* incremental = description->Lookup("incremental", true);
+		rinfo.incremental = incremental->AsBool();
+		rinfo.num_key_fields = static_cast<TableStream*>(info)->num_idx_fields;
+		Unref(incremental);
+		}
+
 	Val* config = description->Lookup("config", true);
 	info->config = config->AsTableVal(); // ref'd by LookupWithDefault
 
@@ -307,6 +326,10 @@ bool Manager::CreateStream(Stream* info, RecordVal* description)
 	ReaderFrontend* reader_obj = new ReaderFrontend(rinfo, reader);
 	assert(reader_obj);
 
+	Val* rows_per_round = description->Lookup("rows_per_round", true);
+	reader_obj->backend->SetMaxOutPerRound(rows_per_round->AsCount());
+	Unref(rows_per_round);
+
 	info->reader = reader_obj;
 	info->type = reader->AsEnumVal(); // ref'd by lookupwithdefault
 	info->name = name;
@@ -680,6 +703,8 @@ bool Manager::CreateTableStream(RecordVal* fval)
 		}
 
 	TableStream* stream = new TableStream();
+	stream->num_idx_fields = idxfields; // The reader needs to know for incremental reads.
+
 		{
 		bool res = CreateStream(stream, fval);
 		if ( ! res )
@@ -707,6 +732,12 @@ bool Manager::CreateTableStream(RecordVal* fval)
 	stream->lastDict->SetDeleteFunc(input_hash_delete_func);
 	stream->want_record = ( want_record->InternalInt() == 1 );
 
+	// Only without predicate and event, as the replacement skips
+	// comparing the entries to the old ones.
+	Val* replace = fval->Lookup("replace", true);
+	stream->replace = replace->AsBool() && ! stream->pred && ! stream->event;
+	Unref(replace);
+
 	Unref(want_record); // ref'd by lookupwithdefault
 	Unref(pred);
 
@@ -868,6 +899,15 @@ bool Manager::RemoveStream(Stream *i)
 
 	i->removed = true;
 
+	if ( i->stream_type == TABLE_STREAM )
+		{
+		// A read that failed never completes, so what it has sent
+		// so far must not end up in the table.
+		TableStream* stream = (TableStream*) i;
+		Unref(stream->pending);
+		stream->pending = 0;
+		}
+
 	DBG_LOG(DBG_INPUT, "Successfully queued removal of stream %s",
 		i->name.c_str());
 
@@ -888,6 +928,28 @@ bool Manager::RemoveStream(const string &name)
 	}
 
 
+void Manager::WatchFile(ReaderFrontend* reader, const char* path)
+	{
+	if ( ! FindStream(reader) )
+		return;
+
+	if ( ! watcher )
+		{
+		watcher = new FileWatcher();
+
+		if ( watcher->IsValid() )
+			iosource_mgr->Register(watcher, true);
+		}
+
+	if ( ! watcher->Watch(reader, path) )
+		return;
+
+	reader->SetWatched(true);
+
+	// Catches any change that came before the watch.
+	reader->Update();
+	}
+
 bool Manager::RemoveStreamContinuation(ReaderFrontend* reader)
 	{
 	Stream *i = FindStream(reader);
@@ -903,6 +965,9 @@ bool Manager::RemoveStreamContinuation(ReaderFrontend* reader)
 		i->name.c_str());
 #endif
 
+	if ( watcher )
+		watcher->Unwatch(reader);
+
 	readers.erase(reader);
 	delete(i);
 
@@ -1122,6 +1187,9 @@ int Manager::SendEntryTable(Stream* i, const Value* const *vals)
 	assert(i->stream_type == TABLE_STREAM);
 	TableStream* stream = (TableStream*) i;
 
+	if ( stream->replace )
+		return SendEntryTableBulk(i, vals);
+
 	HashKey* idxhash = HashValues(stream->num_idx_fields, vals);
 
 	if ( idxhash == 0 )
@@ -1323,6 +1391,50 @@ int Manager::SendEntryTable(Stream* i, const Value* const *vals)
 	return stream->num_val_fields + stream->num_idx_fields;
 	}
 
+int Manager::SendEntryTableBulk(Stream* i, const Value* const *vals)
+	{
+	TableStream* stream = (TableStream*) i;
+
+	if ( i->removed )
+		return stream->num_val_fields + stream->num_idx_fields;
+
+	if ( ! stream->pending )
+		{
+		// Attributes only matter once the entries are in the
+		// destination. Without them, assignments skip all the
+		// expiration bookkeeping.
+		stream->pending = new TableVal(stream->tab->Type()->AsTableType());
+		stream->pending->Reserve(stream->tab->Size());
+		}
+
+	Val* valval;
+	int position = stream->num_idx_fields;
+	bool convert_error = false;
+
+	if ( stream->num_val_fields == 0 )
+		valval = 0;
+
+	else if ( stream->num_val_fields == 1 && !stream->want_record )
+		valval = ValueToVal(i, vals[position], stream->rtype->FieldType(0), convert_error);
+
+	else
+		valval = ValueToRecordVal(i, vals, stream->rtype, &position, convert_error);
+
+	Val* idxval = ValueToIndexVal(i, stream->num_idx_fields, stream->itype, vals, convert_error);
+
+	if ( convert_error )
+		{
+		Unref(valval);
+		Unref(idxval);
+		return stream->num_val_fields + stream->num_idx_fields;
+		}
+
+	stream->pending->Assign(idxval, valval);
+	Unref(idxval);
+
+	return stream->num_val_fields + stream->num_idx_fields;
+	}
+
 void Manager::EndCurrentSend(ReaderFrontend* reader)
 	{
 	Stream *i = FindStream(reader);
@@ -1351,6 +1463,31 @@ void Manager::EndCurrentSend(ReaderFrontend* reader)
 	assert(i->stream_type == TABLE_STREAM);
 	TableStream* stream = (TableStream*) i;
 
+	if ( stream->replace )
+		{
+		if ( i->removed )
+			// The read may not have been complete.
+			return;
+
+		// Nobody needs to hear about individual changes, so we
+		// replace the contents wholesale. Scripts never get to see
+		// a partially loaded table that way.
+		if ( ! stream->pending )
+			stream->pending = new TableVal(stream->tab->Type()->AsTableType());
+
+		stream->tab->SwapContents(stream->pending);
+		Unref(stream->pending);
+		stream->pending = 0;
+
+#ifdef DEBUG
+		DBG_LOG(DBG_INPUT, "EndCurrentSend swapped in %d entries for stream %s",
+			stream->tab->Size(), i->name.c_str());
+#endif
+
+		SendEndOfData(i);
+		return;
+		}
+
 	// lastdict contains all deleted entries and should be empty apart from that
 	IterCookie *c = stream->lastDict->InitForIteration();
 	stream->lastDict->MakeRobustCookie(c);
@@ -1509,7 +1646,11 @@ int Manager::SendEventStreamEvent(Stream* i, EnumVal* type, const Value* const *
 	assert(i->stream_type == EVENT_STREAM);
 	EventStream* stream = (EventStream*) i;
 
-	list<Val*> out_vals;
+	int num_fields = stream->fields->NumFields();
+
+	// The arguments go straight into the list that the event takes
+	// over, sized up front.
+	val_list out_vals(2 + (stream->want_record ? 1 : num_fields));
 	Ref(stream->description);
 	out_vals.push_back(stream->description);
 	// no tracking, send everything with a new event...
@@ -1527,18 +1668,18 @@ int Manager::SendEventStreamEvent(Stream* i, EnumVal* type, const Value* const *
 
 	else
 		{
-		for ( int j = 0; j < stream->fields->NumFields(); j++)
+		for ( int j = 0; j < num_fields; j++)
 			{
+			BroType* field_type = stream->fields->FieldType(j);
 			Val* val = 0;
 
-			if ( stream->fields->FieldType(j)->Tag() == TYPE_RECORD )
-				val = ValueToRecordVal(i, vals,
-						stream->fields->FieldType(j)->AsRecordType(),
-						&position, convert_error);
+			if ( field_type->Tag() == TYPE_RECORD )
+				val = ValueToRecordVal(i, vals, field_type->AsRecordType(),
+						       &position, convert_error);
 
 			else
 				{
-				val = ValueToVal(i, vals[position], stream->fields->FieldType(j), convert_error);
+				val = ValueToVal(i, vals[position], field_type, convert_error);
 				position++;
 				}
 
@@ -1549,11 +1690,11 @@ int Manager::SendEventStreamEvent(Stream* i, EnumVal* type, const Value* const *
 	if ( convert_error )
 		{
 		// we have an error somewhere in our out_vals. Just delete all of them.
-		for ( list<Val*>::const_iterator it = out_vals.begin(), end = out_vals.end(); it != end; ++it )
-			Unref(*it);
+		loop_over_list(out_vals, j)
+			Unref(out_vals[j]);
 		}
 	else
-		SendEvent(stream->event, out_vals);
+		mgr.QueueEvent(stream->event, std::move(out_vals), SOURCE_LOCAL);
 
 	return stream->num_fields;
 	}
@@ -1773,11 +1914,21 @@ bool Manager::Delete(ReaderFrontend* reader, Value* *vals)
 			// only if stream = true -> no streaming
 			if ( streamresult && stream->event )
 				{
-				Ref(idxval);
-				assert(val != 0);
-				Ref(val);
-				EnumVal *ev = BifType::Enum::Input::Event->GetVal(BifEnum::Input::EVENT_REMOVED);
-				SendEvent(stream->event, 4, stream->description->Ref(), ev, idxval, val);
+				// The event takes the index as a record, like the
+				// predicate.
+				int startpos = 0;
+				bool event_convert_error = false;
+				Val* eventidx = ValueToRecordVal(i, vals, stream->itype, &startpos, event_convert_error);
+
+				if ( event_convert_error )
+					Unref(eventidx);
+				else
+					{
+					assert(val != 0);
+					Ref(val);
+					EnumVal *ev = BifType::Enum::Input::Event->GetVal(BifEnum::Input::EVENT_REMOVED);
+					SendEvent(stream->event, 4, stream->description->Ref(), ev, eventidx, val);
+					}
 				}
 			}
 
@@ -2322,46 +2473,34 @@ Val* Manager::ValueToVal(const Stream* i, const Value* val, BroType* request_typ
 		return val_mgr->GetPort(val->val.port_val.port, val->val.port_val.proto);
 
 	case TYPE_ADDR:
-		{
-		IPAddr* addr = 0;
 		switch ( val->val.addr_val.family ) {
 		case IPv4:
-			addr = new IPAddr(val->val.addr_val.in.in4);
-			break;
+			return new AddrVal(IPAddr(val->val.addr_val.in.in4));
 
 		case IPv6:
-			addr = new IPAddr(val->val.addr_val.in.in6);
-			break;
+			return new AddrVal(IPAddr(val->val.addr_val.in.in6));
 
 		default:
 			assert(false);
 		}
 
-		AddrVal* addrval = new AddrVal(*addr);
-		delete addr;
-		return addrval;
-		}
+		break;
 
 	case TYPE_SUBNET:
-		{
-		IPAddr* addr = nullptr;
 		switch ( val->val.subnet_val.prefix.family ) {
 		case IPv4:
-			addr = new IPAddr(val->val.subnet_val.prefix.in.in4);
-			break;
+			return new SubNetVal(IPAddr(val->val.subnet_val.prefix.in.in4),
+					     val->val.subnet_val.length);
 
 		case IPv6:
-			addr = new IPAddr(val->val.subnet_val.prefix.in.in6);
-			break;
+			return new SubNetVal(IPAddr(val->val.subnet_val.prefix.in.in6),
+					     val->val.subnet_val.length);
 
 		default:
 			assert(false);
 		}
 
-		SubNetVal* subnetval = new SubNetVal(*addr, val->val.subnet_val.length);
-		delete addr;
-		return subnetval;
-		}
+		break;
 
 	case TYPE_PATTERN:
 		{
@@ -2372,12 +2511,11 @@ Val* Manager::ValueToVal(const Stream* i, const Value* val, BroType* request_typ
 
 	case TYPE_TABLE:
 		{
-		// all entries have to have the same type...
-		BroType* type = request_type->AsTableType()->Indices()->PureType();
-		TypeList* set_index = new TypeList(type->Ref());
-		set_index->Append(type->Ref());
-		SetType* s = new SetType(set_index, 0);
-		TableVal* t = new TableVal(s);
+		// all entries have to have the same type, so the requested
+		// one will do for the set itself as well.
+		TableType* tt = request_type->AsTableType();
+		BroType* type = tt->Indices()->PureType();
+		TableVal* t = new TableVal(tt);
 		for ( int j = 0; j < val->val.set_val.size; j++ )
 			{
 			Val* assignval = ValueToVal(i, val->val.set_val.vals[j], type, have_error);
@@ -2386,22 +2524,21 @@ Val* Manager::ValueToVal(const Stream* i, const Value* val, BroType* request_typ
 			Unref(assignval); // index is not consumed by assign.
 			}
 
-		Unref(s);
 		return t;
 		}
 
 	case TYPE_VECTOR:
 		{
 		// all entries have to have the same type...
-		BroType* type = request_type->AsVectorType()->YieldType();
-		VectorType* vt = new VectorType(type->Ref());
+		VectorType* vt = request_type->AsVectorType();
+		BroType* type = vt->YieldType();
 		VectorVal* v = new VectorVal(vt);
+		v->Resize(val->val.vector_val.size);
 		for ( int j = 0; j < val->val.vector_val.size; j++ )
 			{
 			v->Assign(j, ValueToVal(i, val->val.vector_val.vals[j], type, have_error));
 			}
 
-		Unref(vt);
 		return v;
 		}
 
@@ -17,6 +17,7 @@ namespace input {
 
 class ReaderFrontend;
 class ReaderBackend;
+class FileWatcher;
 
 /**
  * Singleton class for managing input streams.
@@ -115,6 +116,7 @@ public:
 protected:
 	friend class ReaderFrontend;
 	friend class PutMessage;
+	friend class PutBatchMessage;
 	friend class DeleteMessage;
 	friend class ClearMessage;
 	friend class SendEventMessage;
@@ -124,6 +126,7 @@ protected:
 	friend class DisableMessage;
 	friend class EndOfDataMessage;
 	friend class ReaderErrorMessage;
+	friend class WatchFileMessage;
 
 	// For readers to write to input stream in direct mode (reporting
 	// new/deleted values directly). Functions take ownership of
@@ -158,6 +161,9 @@ protected:
 	// stream is still received.
 	bool RemoveStreamContinuation(ReaderFrontend* reader);
 
+	// Starts updating the reader whenever the file changes, if we can.
+	void WatchFile(ReaderFrontend* reader, const char* path);
+
 	// Signal Informational messages, warnings and errors. These will be
 	// passed to the error function in scriptland. Note that the messages
 	// are not passed to reporter - this is done in ReaderBackend.
@@ -195,6 +201,10 @@ private:
 	// SendEntry implementation for Table stream.
 	int SendEntryTable(Stream* i, const threading::Value* const *vals);
 
+	// SendEntry implementation for Table streams that replace their
+	// contents, which collects the entries in a table of their own.
+	int SendEntryTableBulk(Stream* i, const threading::Value* const *vals);
+
 	// Put implementation for Table stream.
 	int PutTable(Stream* i, const threading::Value* const *vals);
 
@@ -263,6 +273,10 @@ private:
 
 	map<ReaderFrontend*, Stream*> readers;
 
+	// Created when the first reader asks, and owned by iosource_mgr
+	// once registered.
+	FileWatcher* watcher;
+
 	EventHandlerPtr end_of_data;
 };
 
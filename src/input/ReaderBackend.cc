@@ -3,6 +3,8 @@
 #include "ReaderBackend.h"
 #include "ReaderFrontend.h"
 #include "Manager.h"
+#include "SerializationFormat.h"
+#include "input.bif.h"
 
 using threading::Value;
 using threading::Field;
@@ -25,6 +27,24 @@ private:
 	Value* *val;
 };
 
+class PutBatchMessage : public threading::OutputMessage<ReaderFrontend> {
+public:
+	PutBatchMessage(ReaderFrontend* reader, std::vector<Value**> vals)
+		: threading::OutputMessage<ReaderFrontend>("PutBatch", reader),
+		vals(std::move(vals)) {}
+
+	virtual bool Process()
+		{
+		for ( auto val : vals )
+			input_mgr->Put(Object(), val);
+
+		return true;
+		}
+
+private:
+	std::vector<Value**> vals;
+};
+
 class DeleteMessage : public threading::OutputMessage<ReaderFrontend> {
 public:
 	DeleteMessage(ReaderFrontend* reader, Value* *val)
@@ -175,6 +195,24 @@ public:
 		}
 };
 
+class WatchFileMessage : public threading::OutputMessage<ReaderFrontend> {
+public:
+	WatchFileMessage(ReaderFrontend* reader, const char* path)
+		: threading::OutputMessage<ReaderFrontend>("WatchFile", reader),
+		path(copy_string(path)) {}
+
+	virtual ~WatchFileMessage()	{ delete [] path; }
+
+	virtual bool Process()
+		{
+		input_mgr->WatchFile(Object(), path);
+		return true;
+		}
+
+private:
+	const char* path;
+};
+
 bool ReaderErrorMessage::Process()
 	{
 	switch ( type ) {
@@ -205,6 +243,8 @@ ReaderBackend::ReaderBackend(ReaderFrontend* arg_frontend) : MsgThread()
 	info = new ReaderInfo(frontend->Info());
 	num_fields = 0;
 	fields = 0;
+	generation = 0;
+	file_watched = false;
 
 	SetName(frontend->Name());
 	}
@@ -219,6 +259,11 @@ void ReaderBackend::Put(Value* *val)
 	SendOut(new PutMessage(frontend, val));
 	}
 
+void ReaderBackend::PutBatch(std::vector<Value**> vals)
+	{
+	SendOut(new PutBatchMessage(frontend, std::move(vals)));
+	}
+
 void ReaderBackend::Delete(Value* *val)
 	{
 	SendOut(new DeleteMessage(frontend, val));
@@ -234,8 +279,20 @@ void ReaderBackend::SendEvent(const char* name, const int num_vals, Value* *vals
 	SendOut(new SendEventMessage(frontend, name, num_vals, vals));
 	}
 
+void ReaderBackend::WatchFile(const char* path)
+	{
+	if ( BifConst::Input::watch_files )
+		SendOut(new WatchFileMessage(frontend, path));
+	}
+
 void ReaderBackend::EndCurrentSend()
 	{
+	if ( info->incremental )
+		{
+		EndCurrentSendIncremental();
+		return;
+		}
+
 	SendOut(new EndCurrentSendMessage(frontend));
 	}
 
@@ -246,9 +303,96 @@ void ReaderBackend::EndOfData()
 
 void ReaderBackend::SendEntry(Value* *vals)
 	{
+	if ( info->incremental )
+		{
+		SendEntryIncremental(vals);
+		return;
+		}
+
 	SendOut(new SendEntryMessage(frontend, vals));
 	}
 
+static std::string serialize_values(int begin, int end, const Value* const* vals)
+	{
+	BinarySerializationFormat fmt;
+	fmt.StartWrite();
+
+	for ( int i = begin; i < end; ++i )
+		vals[i]->Write(&fmt);
+
+	char* data;
+	int len = fmt.EndWrite(&data);
+	std::string s(data, len);
+	free(data);
+	return s;
+	}
+
+void ReaderBackend::SendEntryIncremental(Value* *vals)
+	{
+	int num_key_fields = info->num_key_fields;
+	std::string key = serialize_values(0, num_key_fields, vals);
+	size_t val_hash = std::hash<std::string>()(serialize_values(num_key_fields, num_fields, vals));
+
+	auto i = snapshot.find(key);
+
+	if ( i != snapshot.end() )
+		{
+		i->second.generation = generation;
+
+		if ( i->second.val_hash == val_hash )
+			{
+			// Unchanged.
+			for ( unsigned int j = 0; j < num_fields; ++j )
+				delete vals[j];
+
+			delete [] vals;
+			return;
+			}
+
+		i->second.val_hash = val_hash;
+		}
+	else
+		snapshot.emplace(std::move(key), SnapshotEntry{val_hash, generation});
+
+	Put(vals);
+	}
+
+void ReaderBackend::EndCurrentSendIncremental()
+	{
+	int num_key_fields = info->num_key_fields;
+
+	for ( auto i = snapshot.begin(); i != snapshot.end(); )
+		{
+		if ( i->second.generation == generation )
+			{
+			++i;
+			continue;
+			}
+
+		// Gone; Delete() only looks at the key fields.
+		Value** vals = new Value*[num_fields];
+		BinarySerializationFormat fmt;
+		fmt.StartRead(i->first.data(), i->first.size());
+
+		for ( int j = 0; j < num_key_fields; ++j )
+			{
+			vals[j] = new Value();
+			vals[j]->Read(&fmt);
+			}
+
+		fmt.EndRead();
+
+		for ( unsigned int j = num_key_fields; j < num_fields; ++j )
+			vals[j] = new Value(fields[j]->type, fields[j]->subtype, false);
+
+		Delete(vals);
+		i = snapshot.erase(i);
+		}
+
+	++generation;
+	EndOfData();
+	}
+
 bool ReaderBackend::Init(const int arg_num_fields,
 		         const threading::Field* const* arg_fields)
 	{
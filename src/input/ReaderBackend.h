@@ -3,6 +3,10 @@
 #ifndef INPUT_READERBACKEND_H
 #define INPUT_READERBACKEND_H
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "BroString.h"
 
 #include "threading/SerialTypes.h"
@@ -103,11 +107,26 @@ public:
 		 */
 		ReaderMode mode;
 
+		/**
+		 * True if entries passed to SendEntry() are to be diffed
+		 * against the previous round, with only the differences
+		 * going to the main thread.
+		 */
+		bool incremental;
+
+		/**
+		 * For table streams, the number of leading fields that
+		 * identify an entry.
+		 */
+		int num_key_fields;
+
 		ReaderInfo()
 			{
 			source = 0;
 			name = 0;
 			mode = MODE_NONE;
+			incremental = false;
+			num_key_fields = 0;
 			}
 
 		ReaderInfo(const ReaderInfo& other)
@@ -115,6 +134,8 @@ public:
 			source = other.source ? copy_string(other.source) : 0;
 			name = other.name ? copy_string(other.name) : 0;
 			mode = other.mode;
+			incremental = other.incremental;
+			num_key_fields = other.num_key_fields;
 
 			for ( config_map::const_iterator i = other.config.begin(); i != other.config.end(); i++ )
 				config.insert(std::make_pair(copy_string(i->first), copy_string(i->second)));
@@ -285,6 +306,15 @@ protected:
 	 */
 	void Put(threading::Value** val);
 
+	/**
+	 * Like Put(), but passes on a number of rows at once, in a single
+	 * message. That saves the per-message overhead for readers
+	 * producing rows at a high rate.
+	 *
+	 * @param vals The rows, each as for Put().
+	 */
+	void PutBatch(std::vector<threading::Value**> vals);
+
 	/**
 	 * Method allowing a reader to delete a specific value from a Bro
 	 * table.
@@ -339,7 +369,42 @@ protected:
 	 */
 	void EndCurrentSend();
 
+	/**
+	 * Asks the main thread to update the reader whenever a file changes,
+	 * if the system supports that and Input::watch_files is set. Meant
+	 * for readers that would otherwise check the file on every
+	 * heartbeat; once FileWatched() returns true, they can stop doing
+	 * so.
+	 *
+	 * @param path The file to watch.
+	 */
+	void WatchFile(const char* path);
+
+	/**
+	 * Returns true if the main thread watches the file passed to
+	 * WatchFile() and will update the reader when it changes. This can
+	 * turn false again, e.g. if the file's directory goes away.
+	 */
+	bool FileWatched() const	{ return file_watched; }
+
 private:
+	friend class SetWatchedMessage;
+
+	// Incremental reads: rather than the entries themselves, we pass on
+	// Put()s and Delete()s for the differences to what we saw last time.
+	void SendEntryIncremental(threading::Value** vals);
+	void EndCurrentSendIncremental();
+
+	struct SnapshotEntry {
+		size_t val_hash;	// Hash of the non-key fields.
+		unsigned int generation;	// Round in which we last saw the entry.
+	};
+
+	// Indexed by the serialized key fields.
+	typedef std::unordered_map<std::string, SnapshotEntry> snapshot_map;
+	snapshot_map snapshot;
+	unsigned int generation;
+
 	// Frontend that instantiated us. This object must not be accessed
 	// from this class, it's running in a different thread!
 	ReaderFrontend* frontend;
@@ -349,6 +414,7 @@ private:
 	const threading::Field* const * fields; // raw mapping
 
 	bool disabled;
+	bool file_watched;
 };
 
 }
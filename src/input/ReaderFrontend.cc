@@ -36,6 +36,23 @@ public:
 	virtual bool Process() { return Object()->Update(); }
 };
 
+class SetWatchedMessage : public threading::InputMessage<ReaderBackend>
+{
+public:
+	SetWatchedMessage(ReaderBackend* backend, bool watched)
+		: threading::InputMessage<ReaderBackend>("SetWatched", backend),
+		watched(watched) { }
+
+	virtual bool Process()
+		{
+		Object()->file_watched = watched;
+		return true;
+		}
+
+private:
+	bool watched;
+};
+
 ReaderFrontend::ReaderFrontend(const ReaderBackend::ReaderInfo& arg_info, EnumVal* type)
 	{
 	disabled = initialized = false;
@@ -46,6 +63,7 @@ ReaderFrontend::ReaderFrontend(const ReaderBackend::ReaderInfo& arg_info, EnumVa
 
 	backend = input_mgr->CreateBackend(this, type);
 	assert(backend);
+	backend->SetPlacement(threading::thread_placement(threading::THREAD_READER));
 	backend->Start();
 	}
 
@@ -94,6 +112,14 @@ void ReaderFrontend::Update()
 	backend->SendIn(new UpdateMessage(backend));
 	}
 
+void ReaderFrontend::SetWatched(bool watched)
+	{
+	if ( disabled )
+		return;
+
+	backend->SendIn(new SetWatchedMessage(backend, watched));
+	}
+
 const char* ReaderFrontend::Name() const
 	{
 	return name;
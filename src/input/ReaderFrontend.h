@@ -68,6 +68,14 @@ public:
 	 */
 	void Update();
 
+	/**
+	 * Tells the backend whether the main thread watches its file, see
+	 * ReaderBackend::WatchFile().
+	 *
+	 * This method must only be called from the main thread.
+	 */
+	void SetWatched(bool watched);
+
 	/**
 	 * Finalizes reading from this stream.
 	 *
@@ -6,6 +6,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 
 #include "Ascii.h"
 #include "ascii.bif.h"
@@ -17,6 +18,9 @@ using namespace threading;
 using threading::Value;
 using threading::Field;
 
+// Size of the blocks in which we read files.
+static const size_t READ_BLOCK_SIZE = 1024 * 1024;
+
 FieldMapping::FieldMapping(const string& arg_name, const TypeTag& arg_type, int arg_position)
 	: name(arg_name), type(arg_type), subtype(TYPE_ERROR)
 	{
@@ -116,7 +120,13 @@ bool Ascii::DoInit(const ReaderInfo& info, int num_fields, const Field* const* f
 	formatter::Ascii::SeparatorInfo sep_info(separator, set_separator, unset_field, empty_field);
 	formatter = unique_ptr<threading::formatter::Formatter>(new formatter::Ascii(this, sep_info));
 
-	return DoUpdate();
+	if ( ! DoUpdate() )
+		return false;
+
+	if ( Info().mode == MODE_REREAD )
+		WatchFile(fname.c_str());
+
+	return true;
 	}
 
 void Ascii::FailWarn(bool is_error, const char *msg, bool suppress_future)
@@ -282,6 +292,134 @@ bool Ascii::GetLine(string& str)
 	return false;
 	}
 
+// Splits up one line and sends its values on. Returns false if that hits
+// an error that is to end reading.
+bool Ascii::ProcessLine(const char* line, size_t len)
+	{
+	// Same treatment as in GetLine().
+	if ( ! len )
+		return true;
+
+	if ( line[len - 1] == '\r' )
+		--len;
+
+	if ( len && line[0] == '#' )
+		{
+		if ( len > 8 && memcmp(line, "#fields", 7) == 0 && line[7] == separator[0] )
+			{
+			line += 8;
+			len -= 8;
+			}
+		else
+			return true;
+		}
+
+	// Like getline() on a stream, we don't count an empty trailing field.
+	field_spans.clear();
+	const char* p = line;
+	const char* end = line + len;
+
+	while ( p < end )
+		{
+		const char* sep = static_cast<const char*>(memchr(p, separator[0], end - p));
+		const char* field_end = sep ? sep : end;
+		field_spans.emplace_back(p, field_end - p);
+		p = sep ? sep + 1 : end;
+		}
+
+	int pos = int(field_spans.size()) - 1; // for easy comparisons of max element.
+
+	bool error = false;
+	Value** fields = new Value*[NumFields()];
+
+	int fpos = 0;
+	for ( vector<FieldMapping>::iterator fit = columnMap.begin();
+		fit != columnMap.end();
+		fit++ )
+		{
+
+		if ( ! fit->present )
+			{
+			// add non-present field
+			fields[fpos] =  new Value((*fit).type, false);
+			fpos++;
+			continue;
+			}
+
+		assert(fit->position >= 0 );
+
+		if ( (*fit).position > pos || (*fit).secondary_position > pos )
+			{
+			FailWarn(fail_on_invalid_lines, Fmt("Not enough fields in line '%s' of %s. Found %d fields, want positions %d and %d",
+			                                    string(line, len).c_str(), fname.c_str(), pos, (*fit).position, (*fit).secondary_position));
+
+			if ( fail_on_invalid_lines )
+				{
+				for ( int i = 0; i < fpos; i++ )
+					delete fields[i];
+
+				delete [] fields;
+
+				return false;
+				}
+			else
+				{
+				error = true;
+				break;
+				}
+			}
+
+		const auto& span = field_spans[(*fit).position];
+		field_buffer.assign(span.first, span.second);
+		Value* val = formatter->ParseValue(field_buffer, (*fit).name, (*fit).type, (*fit).subtype);
+
+		if ( val == 0 )
+			{
+			Warning(Fmt("Could not convert line '%s' of %s to Val. Ignoring line.", string(line, len).c_str(), fname.c_str()));
+			error = true;
+			break;
+			}
+
+		if ( (*fit).secondary_position != -1 )
+			{
+			// we have a port definition :)
+			assert(val->type == TYPE_PORT );
+			//	Error(Fmt("Got type %d != PORT with secondary position!", val->type));
+
+			const auto& proto = field_spans[(*fit).secondary_position];
+			field_buffer.assign(proto.first, proto.second);
+			val->val.port_val.proto = formatter->ParseProto(field_buffer);
+			}
+
+		fields[fpos] = val;
+
+		fpos++;
+		}
+
+	if ( error )
+		{
+		// Encountered non-fatal error, ignoring line. But
+		// first, delete all successfully read fields and the
+		// array structure.
+
+		for ( int i = 0; i < fpos; i++ )
+			delete fields[i];
+
+		delete [] fields;
+		return true;
+		}
+
+	//printf("fpos: %d, second.num_fields: %d\n", fpos, (*it).second.num_fields);
+	assert ( fpos == NumFields() );
+
+	if ( Info().mode  == MODE_STREAM )
+		Put(fields);
+	else
+		SendEntry(fields);
+
+	return true;
+	}
+
 // read the entire file and send appropriate thingies back to InputMgr
 bool Ascii::DoUpdate()
 	{
@@ -347,112 +485,45 @@ bool Ascii::DoUpdate()
 
 		}
 
-	string line;
-
 	file.sync();
 
-	while ( GetLine(line) )
-		{
-		// split on tabs
-		bool error = false;
-		istringstream splitstream(line);
-
-		map<int, string> stringfields;
-		int pos = 0;
-		while ( splitstream )
-			{
-			string s;
-			if ( ! getline(splitstream, s, separator[0]) )
-				break;
+	// Read in large blocks and split them up ourselves; that's several
+	// times faster for large files than getline() and istringstream.
+	size_t have = 0;
 
-			stringfields[pos] = s;
-			pos++;
-			}
+	for ( ;; )
+		{
+		if ( have == read_buffer.size() )
+			read_buffer.resize(max(2 * read_buffer.size(), READ_BLOCK_SIZE));
 
-		pos--; // for easy comparisons of max element.
+		file.read(read_buffer.data() + have, read_buffer.size() - have);
+		size_t n = file.gcount();
+		have += n;
 
-		Value** fields = new Value*[NumFields()];
+		const char* p = read_buffer.data();
+		const char* end = p + have;
+		const char* nl;
 
-		int fpos = 0;
-		for ( vector<FieldMapping>::iterator fit = columnMap.begin();
-			fit != columnMap.end();
-			fit++ )
+		while ( (nl = static_cast<const char*>(memchr(p, '\n', end - p))) )
 			{
+			if ( ! ProcessLine(p, nl - p) )
+				return false;
 
-			if ( ! fit->present )
-				{
-				// add non-present field
-				fields[fpos] =  new Value((*fit).type, false);
-				fpos++;
-				continue;
-				}
-
-			assert(fit->position >= 0 );
-
-			if ( (*fit).position > pos || (*fit).secondary_position > pos )
-				{
-				FailWarn(fail_on_invalid_lines, Fmt("Not enough fields in line '%s' of %s. Found %d fields, want positions %d and %d",
-				                                    line.c_str(), fname.c_str(), pos, (*fit).position, (*fit).secondary_position));
-
-				if ( fail_on_invalid_lines )
-					{
-					for ( int i = 0; i < fpos; i++ )
-						delete fields[i];
-
-					delete [] fields;
-
-					return false;
-					}
-				else
-					{
-					error = true;
-					break;
-					}
-				}
-
-			Value* val = formatter->ParseValue(stringfields[(*fit).position], (*fit).name, (*fit).type, (*fit).subtype);
-
-			if ( val == 0 )
-				{
-				Warning(Fmt("Could not convert line '%s' of %s to Val. Ignoring line.", line.c_str(), fname.c_str()));
-				error = true;
-				break;
-				}
-
-			if ( (*fit).secondary_position != -1 )
-				{
-				// we have a port definition :)
-				assert(val->type == TYPE_PORT );
-				//	Error(Fmt("Got type %d != PORT with secondary position!", val->type));
-
-				val->val.port_val.proto = formatter->ParseProto(stringfields[(*fit).secondary_position]);
-				}
-
-			fields[fpos] = val;
-
-			fpos++;
+			p = nl + 1;
 			}
 
-		if ( error )
+		if ( n == 0 )
 			{
-			// Encountered non-fatal error, ignoring line. But
-			// first, delete all successfully read fields and the
-			// array structure.
-
-			for ( int i = 0; i < fpos; i++ )
-				delete fields[i];
+			// End of file; what's left is a last line without
+			// a newline.
+			if ( p < end && ! ProcessLine(p, end - p) )
+				return false;
 
-			delete [] fields;
-			continue;
+			break;
 			}
 
-		//printf("fpos: %d, second.num_fields: %d\n", fpos, (*it).second.num_fields);
-		assert ( fpos == NumFields() );
-
-		if ( Info().mode  == MODE_STREAM )
-			Put(fields);
-		else
-			SendEntry(fields);
+		have = end - p;
+		memmove(read_buffer.data(), p, have);
 		}
 
 	if ( Info().mode != MODE_STREAM )
@@ -463,6 +534,10 @@ bool Ascii::DoUpdate()
 
 bool Ascii::DoHeartbeat(double network_time, double current_time)
 	{
+	if ( Info().mode == MODE_REREAD && FileWatched() )
+		// We get updated when the file changes.
+		return true;
+
 	if ( ! OpenFile() )
 		return ! fail_on_file_problem;
 
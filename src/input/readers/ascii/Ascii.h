@@ -56,6 +56,7 @@ protected:
 private:
 	bool ReadHeader(bool useCached);
 	bool GetLine(string& str);
+	bool ProcessLine(const char* line, size_t len);
 	bool OpenFile();
 	// Call Warning or Error, depending on the is_error boolean.
 	// In case of a warning, setting suppress_future to true will suppress all future warnings
@@ -91,6 +92,11 @@ private:
 	bool suppress_warnings;
 
 	std::unique_ptr<threading::formatter::Formatter> formatter;
+
+	// Reused while reading, to save allocations.
+	std::vector<char> read_buffer;
+	std::vector<std::pair<const char*, size_t>> field_spans;
+	string field_buffer;
 };
 
 
@@ -27,6 +27,8 @@ Benchmark::Benchmark(ReaderFrontend *frontend) : ReaderBackend(frontend)
 	timedspread = double(BifConst::InputBenchmark::timedspread);
 	heartbeatstarttime = 0;
 	heartbeat_interval = double(BifConst::Threading::heartbeat_interval);
+	key_cardinality = BifConst::InputBenchmark::key_cardinality;
+	string_length = int(BifConst::InputBenchmark::string_length);
 
 	ascii = new threading::formatter::Ascii(this, threading::formatter::Ascii::SeparatorInfo());
 	}
@@ -42,8 +44,48 @@ void Benchmark::DoClose()
 	{
 	}
 
+bool Benchmark::InitOptions(const ReaderInfo& info)
+	{
+	uint64 seed = BifConst::InputBenchmark::seed;
+
+	for ( ReaderInfo::config_map::const_iterator i = info.config.begin();
+	      i != info.config.end(); ++i )
+		{
+		char* end;
+		unsigned long long n = strtoull(i->second, &end, 10);
+
+		if ( strcmp(i->first, "seed") != 0 &&
+		     strcmp(i->first, "key_cardinality") != 0 &&
+		     strcmp(i->first, "string_length") != 0 )
+			continue;
+
+		if ( *end )
+			{
+			Error(Fmt("invalid value for '%s', must be a number", i->first));
+			return false;
+			}
+
+		if ( strcmp(i->first, "seed") == 0 )
+			seed = n;
+		else if ( strcmp(i->first, "key_cardinality") == 0 )
+			key_cardinality = n;
+		else
+			string_length = int(n);
+		}
+
+	if ( seed )
+		rng.seed(seed);
+	else
+		rng.seed(std::random_device()());
+
+	return true;
+	}
+
 bool Benchmark::DoInit(const ReaderInfo& info, int num_fields, const Field* const* fields)
 	{
+	if ( ! InitOptions(info) )
+		return false;
+
 	num_lines = atoi(info.source);
 
 	if ( autospread != 0.0 )
@@ -65,7 +107,7 @@ string Benchmark::RandomString(const int len)
 	"abcdefghijklmnopqrstuvwxyz";
 
 	for (int i = 0; i < len; ++i)
-		s[i] = values[random() / (RAND_MAX / sizeof(values))];
+		s[i] = values[Random() % (sizeof(values) - 1)];
 
 	return s;
 	}
@@ -85,11 +127,24 @@ double Benchmark::CurrTime()
 bool Benchmark::DoUpdate()
 	{
 	int linestosend = num_lines * heartbeat_interval;
+	int num_key_fields = key_cardinality ? Info().num_key_fields : 0;
+	double first = CurrTime();
+
 	for ( int i = 0; i < linestosend; i++ )
 		{
 		Value** field = new Value*[NumFields()];
+
+		// All of an entry's key fields derive from the same key, so
+		// that there are just key_cardinality distinct entries.
+		uint64 key = num_key_fields ? Random() % key_cardinality : 0;
+
 		for  (int j = 0; j < NumFields(); j++ )
-			field[j] = EntryToVal(Fields()[j]->type, Fields()[j]->subtype);
+			{
+			if ( j < num_key_fields )
+				field[j] = KeyToVal(Fields()[j]->type, Fields()[j]->subtype, key);
+			else
+				field[j] = EntryToVal(Fields()[j]->type, Fields()[j]->subtype);
+			}
 
 		if ( Info().mode  == MODE_STREAM )
 			// do not do tracking, spread out elements over the second that we have...
@@ -117,12 +172,91 @@ bool Benchmark::DoUpdate()
 
 	}
 
+	double last = CurrTime();
+
 	if ( Info().mode != MODE_STREAM )
 		EndCurrentSend();
 
+	// This comes in only once the manager has applied all of the rows,
+	// which lets scripts measure the whole way.
+	Value** v = new Value*[4];
+	v[0] = new Value(TYPE_STRING, true);
+	v[0]->val.string_val.data = copy_string(Info().name);
+	v[0]->val.string_val.length = strlen(Info().name);
+	v[1] = new Value(TYPE_COUNT, true);
+	v[1]->val.uint_val = linestosend;
+	v[2] = new Value(TYPE_TIME, true);
+	v[2]->val.double_val = first;
+	v[3] = new Value(TYPE_TIME, true);
+	v[3]->val.double_val = last;
+
+	SendEvent("InputBenchmark::rows_applied", 4, v);
+
 	return true;
 }
 
+threading::Value* Benchmark::KeyToVal(TypeTag type, TypeTag subtype, uint64 key)
+	{
+	Value* val = new Value(type, subtype, true);
+
+	switch ( type ) {
+	case TYPE_STRING:
+		{
+		string s = Fmt("key%" PRIu64, key);
+
+		if ( int(s.size()) < string_length )
+			s.append(string_length - s.size(), '-');
+
+		val->val.string_val.data = copy_string(s.c_str());
+		val->val.string_val.length = s.size();
+		break;
+		}
+
+	case TYPE_BOOL:
+		val->val.int_val = key & 1;
+		break;
+
+	case TYPE_INT:
+		val->val.int_val = key;
+		break;
+
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+		val->val.uint_val = key;
+		break;
+
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		val->val.double_val = key;
+		break;
+
+	case TYPE_PORT:
+		val->val.port_val.port = key % 65536;
+		val->val.port_val.proto = TRANSPORT_TCP;
+		break;
+
+	case TYPE_ADDR:
+		val->val.addr_val.family = IPv4;
+		val->val.addr_val.in.in4.s_addr = htonl(0x0a000000 + uint32(key));
+		break;
+
+	case TYPE_SUBNET:
+		val->val.subnet_val.prefix.family = IPv4;
+		val->val.subnet_val.prefix.in.in4.s_addr = htonl(0x0a000000 + uint32(key));
+		val->val.subnet_val.length = 32;
+		break;
+
+	default:
+		// Sets and vectors make for unusual keys, so we don't
+		// bother making them distinct.
+		delete val;
+		return EntryToVal(type, subtype);
+	}
+
+	return val;
+	}
+
 threading::Value* Benchmark::EntryToVal(TypeTag type, TypeTag subtype)
 	{
 	Value* val = new Value(type, subtype, true);
@@ -135,7 +269,7 @@ threading::Value* Benchmark::EntryToVal(TypeTag type, TypeTag subtype)
 
 	case TYPE_STRING:
 		{
-		string rnd = RandomString(10);
+		string rnd = RandomString(string_length);
 		val->val.string_val.data = copy_string(rnd.c_str());
 		val->val.string_val.length = rnd.size();
 		break;
@@ -146,7 +280,7 @@ threading::Value* Benchmark::EntryToVal(TypeTag type, TypeTag subtype)
 		break;
 
 	case TYPE_INT:
-		val->val.int_val = random();
+		val->val.int_val = Random();
 		break;
 
 	case TYPE_TIME:
@@ -155,16 +289,16 @@ threading::Value* Benchmark::EntryToVal(TypeTag type, TypeTag subtype)
 
 	case TYPE_DOUBLE:
 	case TYPE_INTERVAL:
-		val->val.double_val = random();
+		val->val.double_val = Random();
 		break;
 
 	case TYPE_COUNT:
 	case TYPE_COUNTER:
-		val->val.uint_val = random();
+		val->val.uint_val = Random();
 		break;
 
 	case TYPE_PORT:
-		val->val.port_val.port = random() / (RAND_MAX / 60000);
+		val->val.port_val.port = Random() % 60000;
 		val->val.port_val.proto = TRANSPORT_UNKNOWN;
 		break;
 
@@ -187,7 +321,7 @@ threading::Value* Benchmark::EntryToVal(TypeTag type, TypeTag subtype)
 		// Then - common stuff
 		{
 		// how many entries do we have...
-		unsigned int length = random() / (RAND_MAX / 15);
+		unsigned int length = Random() % 15;
 
 		Value** lvals = new Value* [length];
 
@@ -3,6 +3,8 @@
 #ifndef INPUT_READERS_BENCHMARK_H
 #define INPUT_READERS_BENCHMARK_H
 
+#include <random>
+
 #include "input/ReaderBackend.h"
 #include "threading/formatters/Ascii.h"
 
@@ -25,9 +27,12 @@ protected:
 	bool DoHeartbeat(double network_time, double current_time) override;
 
 private:
+	bool InitOptions(const ReaderInfo& info);
 	double CurrTime();
+	uint32 Random()	{ return rng(); }
 	string RandomString(const int len);
 	threading::Value* EntryToVal(TypeTag Type, TypeTag subtype);
+	threading::Value* KeyToVal(TypeTag type, TypeTag subtype, uint64 key);
 
 	int num_lines;
 	double multiplication_factor;
@@ -40,6 +45,10 @@ private:
 	double timedspread;
 	double heartbeat_interval;
 
+	std::mt19937 rng;
+	uint64 key_cardinality;	// Zero for unbounded keys.
+	int string_length;
+
 	threading::formatter::Ascii* ascii;
 };
 
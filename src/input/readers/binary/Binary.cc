@@ -134,6 +134,9 @@ bool Binary::DoInit(const ReaderInfo& info, int num_fields,
 	// after initialization - do update
 	DoUpdate();
 
+	if ( Info().mode == MODE_REREAD )
+		WatchFile(fname.c_str());
+
 #ifdef DEBUG
 	Debug(DBG_INPUT, "Binary reader did first update");
 #endif
@@ -263,6 +266,10 @@ bool Binary::DoUpdate()
 
 bool Binary::DoHeartbeat(double network_time, double current_time)
 	{
+	if ( Info().mode == MODE_REREAD && FileWatched() )
+		// We get updated when the file changes.
+		return true;
+
 	switch ( Info().mode ) {
 		case MODE_MANUAL:
 			// yay, we do nothing :)
@@ -75,7 +75,13 @@ bool Config::DoInit(const ReaderInfo& info, int num_fields, const Field* const*
 	formatter::Ascii::SeparatorInfo sep_info("\t", set_separator, "", empty_field);
 	formatter = unique_ptr<threading::formatter::Formatter>(new formatter::Ascii(this, sep_info));
 
-	return DoUpdate();
+	if ( ! DoUpdate() )
+		return false;
+
+	if ( Info().mode == MODE_REREAD )
+		WatchFile(Info().source);
+
+	return true;
 	}
 
 bool Config::OpenFile()
@@ -305,6 +311,10 @@ bool Config::DoUpdate()
 
 bool Config::DoHeartbeat(double network_time, double current_time)
 	{
+	if ( Info().mode == MODE_REREAD && FileWatched() )
+		// We get updated when the file changes.
+		return true;
+
 	switch ( Info().mode )
 		{
 		case MODE_MANUAL:
@@ -24,7 +24,7 @@ using namespace input::reader;
 using threading::Value;
 using threading::Field;
 
-const int Raw::block_size = 4096; // how big do we expect our chunks of data to be.
+const int Raw::block_size = 65536; // how much we read at a time, at least.
 
 Raw::Raw(ReaderFrontend *frontend) : ReaderBackend(frontend), file(nullptr, fclose), stderrfile(nullptr, fclose)
 	{
@@ -39,7 +39,8 @@ Raw::Raw(ReaderFrontend *frontend) : ReaderBackend(frontend), file(nullptr, fclo
 
 	sep_length = BifConst::InputRaw::record_separator->Len();
 
-	bufpos = 0;
+	deliver_chunks = false;
+	batch_size = BifConst::InputRaw::batch_size;
 
 	stdin_fileno = fileno(stdin);
 	stdout_fileno = fileno(stdout);
@@ -270,6 +271,10 @@ bool Raw::Execute()
 
 bool Raw::OpenInput()
 	{
+	// Whatever is left over belongs to the previous input.
+	stdout_buf.start = stdout_buf.end = stdout_buf.scanned = 0;
+	stderr_buf.start = stderr_buf.end = stderr_buf.scanned = 0;
+
 	if ( execute )
 		return Execute();
 
@@ -376,6 +381,25 @@ bool Raw::DoInit(const ReaderInfo& info, int num_fields, const Field* const* fie
 		forcekill = true;
 		}
 
+	it = info.config.find("chunks"); // we want all complete records read at once
+	if ( it != info.config.end() )
+		deliver_chunks = true;
+
+	it = info.config.find("batch_size"); // we want several rows per message
+	if ( it != info.config.end() )
+		{
+		char* end;
+		long long n = strtoll(it->second, &end, 10);
+
+		if ( *end || n <= 0 )
+			{
+			Error("batch_size must be a positive number");
+			return false;
+			}
+
+		batch_size = n;
+		}
+
 	it = info.config.find("offset"); // we want to seek to a given offset inside the file
 	if ( it != info.config.end() && ! execute && (Info().mode == MODE_STREAM || Info().mode == MODE_MANUAL) )
 		{
@@ -430,83 +454,190 @@ bool Raw::DoInit(const ReaderInfo& info, int num_fields, const Field* const* fie
 #ifdef DEBUG
 	Debug(DBG_INPUT, "First update went through");
 #endif
+
+	if ( Info().mode == MODE_REREAD )
+		WatchFile(fname.c_str());
+
 	return true;
 	}
 
-int64_t Raw::GetLine(FILE* arg_file)
+// Reads more data into the buffer, making room for it first. Returns the
+// number of bytes read, or -1 at the end of the file, -2 if there's no data
+// right now, and -3 on an unexpected error.
+int64_t Raw::Fill(FILE* arg_file, ReadBuffer* b)
 	{
+	if ( b->start > 0 )
+		{
+		memmove(b->data.get(), b->data.get() + b->start, b->end - b->start);
+		b->end -= b->start;
+		b->start = 0;
+		}
+
+	if ( b->end == b->size )
+		{
+		size_t size = b->size ? 2 * b->size : block_size;
+		std::unique_ptr<char[]> data(new char[size]);
+
+		if ( b->end )
+			memcpy(data.get(), b->data.get(), b->end);
+
+		b->data = std::move(data);
+		b->size = size;
+		}
+
 	errno = 0;
-	int pos = 0; // strstr_n only works on ints - so no use to use something different here
-	int offset = 0;
+	size_t n = fread(b->data.get() + b->end, 1, b->size - b->end, arg_file);
+	b->end += n;
 
-	if ( ! buf )
-		buf = std::unique_ptr<char[]>(new char[block_size]);
+	if ( n > 0 )
+		return n;
 
-	int repeats = 1;
+	if ( feof(arg_file) != 0 )
+		return -1;
 
-	for ( ;; )
+	if ( errno == 0 || errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR )
+		return -2;
+
+	// an error code we did no expect. This probably is bad.
+	Error(Fmt("Reader encountered unexpected error code %d", errno));
+	return -3;
+	}
+
+// Moves the next len bytes of the buffer into outbuf, which is what goes
+// into the Value.
+void Raw::TakeData(ReadBuffer* b, size_t len)
+	{
+	outbuf = std::unique_ptr<char[]>(new char[len]);
+	memcpy(outbuf.get(), b->data.get() + b->start, len);
+	b->start += len;
+	b->scanned = 0;
+	}
+
+// Returns the position of the first separator at or after from, or -1.
+static int64_t find_separator(const char* s, size_t len, size_t from, const string& sep)
+	{
+	size_t sep_len = sep.size();
+
+	if ( ! sep_len )
+		return -1;
+
+	while ( from + sep_len <= len )
 		{
-		size_t readbytes = fread(buf.get()+bufpos+offset, 1, block_size-bufpos, arg_file);
-		pos += bufpos + readbytes;
-		//printf("Pos: %d\n", pos);
-		bufpos = offset = 0; // read full block size in next read...
+		const char* p = (const char*) memchr(s + from, sep[0], len - from - sep_len + 1);
 
-		if ( pos == 0 && errno != 0 )
-			break;
+		if ( ! p )
+			return -1;
 
-		// researching everything each time is a bit... cpu-intensive. But otherwhise we have
-		// to deal with situations where the separator is multi-character and split over multiple
-		// reads...
-		int found = strstr_n(pos, (unsigned char*) buf.get(), separator.size(), (unsigned char*) separator.c_str());
+		if ( memcmp(p, sep.data(), sep_len) == 0 )
+			return p - s;
 
-		if ( found == -1 )
-			{
-			// we did not find it and have to search again in the next try. resize buffer....
-			// but first check if we encountered the file end - because if we did this was it.
-			if ( feof(arg_file) != 0 )
-				{
-				if ( pos == 0 )
-					return -1; // signal EOF - and that we had no more data.
-				else
-					{
-					outbuf = std::move(buf); // buf is null after this
-					return pos;
-					}
-				}
+		from = p - s + 1;
+		}
 
-			repeats++;
-			// bah, we cannot use realloc because we would have to change the delete in the manager to a free.
-			std::unique_ptr<char[]> newbuf = std::unique_ptr<char[]>(new char[block_size*repeats]);
-			memcpy(newbuf.get(), buf.get(), block_size*(repeats-1));
-			buf = std::move(newbuf);
-			offset = block_size*(repeats-1);
-			}
-		else
-			{
-			outbuf = std::move(buf);
+	return -1;
+	}
 
-			if ( found < pos )
-				{
-				// we have leftovers. copy them into the buffer for the next line
-				buf = std::unique_ptr<char[]>(new char[block_size]);
-				memcpy(buf.get(), outbuf.get() + found + sep_length, pos - found - sep_length);
-				bufpos = pos - found - sep_length;
-				}
+// Returns the length of the data up to and including the last separator.
+static size_t find_last_separator_end(const char* s, size_t len, const string& sep)
+	{
+	size_t sep_len = sep.size();
 
+	if ( ! sep_len )
+		return 0;
+
+	for ( size_t i = len; i >= sep_len; --i )
+		{
+		if ( s[i - 1] == sep[sep_len - 1] &&
+		     memcmp(s + i - sep_len, sep.data(), sep_len) == 0 )
+			return i;
+		}
+
+	return 0;
+	}
+
+// Returns the length of the next line, which is then in outbuf, without
+// the separator. At the end of the file, what's left counts as a line.
+// Returns -1 at the end of the file if there's nothing left, -2 if no
+// complete line is available right now, and -3 on an unexpected error.
+int64_t Raw::GetLine(FILE* arg_file, ReadBuffer* b)
+	{
+	for ( ;; )
+		{
+		size_t avail = b->end - b->start;
+		int64_t found = avail ? find_separator(b->data.get() + b->start, avail,
+		                                       b->scanned, separator) : -1;
+
+		if ( found >= 0 )
+			{
+			TakeData(b, found);
+			b->start += sep_length;
 			return found;
 			}
 
+		// Don't search all of that again after the next read.
+		b->scanned = avail >= sep_length ? avail - sep_length + 1 : 0;
+
+		int64_t n = Fill(arg_file, b);
+
+		if ( n == -1 && b->end > b->start )
+			{
+			avail = b->end - b->start;
+			TakeData(b, avail);
+			return avail;
+			}
+
+		if ( n < 0 )
+			return n;
 		}
+	}
 
-	if ( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR )
-		return -2;
+// Like GetLine(), but returns all complete records available at once,
+// including their separators.
+int64_t Raw::GetChunk(FILE* arg_file, ReadBuffer* b)
+	{
+	for ( ;; )
+		{
+		int64_t n = Fill(arg_file, b);
 
-	else
+		if ( n == -3 )
+			return n;
+
+		size_t avail = b->end - b->start;
+		size_t len = (n == -1) ? avail :
+			find_last_separator_end(b->data.get() + b->start, avail, separator);
+
+		if ( len > 0 )
+			{
+			TakeData(b, len);
+			return len;
+			}
+
+		if ( n < 0 )
+			return n;
+		}
+	}
+
+void Raw::Deliver(Value** fields)
+	{
+	if ( batch_size <= 1 )
 		{
-		// an error code we did no expect. This probably is bad.
-		Error(Fmt("Reader encountered unexpected error code %d", errno));
-		return -3;
+		Put(fields);
+		return;
 		}
+
+	batch.push_back(fields);
+
+	if ( batch.size() >= batch_size )
+		FlushBatch();
+	}
+
+void Raw::FlushBatch()
+	{
+	if ( batch.empty() )
+		return;
+
+	PutBatch(std::move(batch));
+	batch.clear();
 	}
 
 // write to the stdin of the child process
@@ -585,18 +716,20 @@ bool Raw::DoUpdate()
 		}
 		}
 
-	string line;
 	assert ( (NumFields() == 1 && !use_stderr) || (NumFields() == 2 && use_stderr));
 	for ( ;; )
 		{
 		if ( stdin_towrite > 0 )
 			WriteToStdin();
 
-		int64_t length = GetLine(file.get());
-		//printf("Read %lld bytes\n", length);
+		int64_t length = deliver_chunks ? GetChunk(file.get(), &stdout_buf)
+		                                : GetLine(file.get(), &stdout_buf);
 
 		if ( length == -3 )
+			{
+			FlushBatch();
 			return false;
+			}
 
 		else if ( length == -2 || length == -1 )
 			// no data ready or eof
@@ -617,17 +750,20 @@ bool Raw::DoUpdate()
 			fields[1] = bval;
 			}
 
-		Put(fields);
+		Deliver(fields);
 		}
 
 	if ( use_stderr )
 		{
 		for ( ;; )
 			{
-			int64_t length = GetLine(stderrfile.get());
-			//printf("Read stderr %lld bytes\n", length);
+			int64_t length = deliver_chunks ? GetChunk(stderrfile.get(), &stderr_buf)
+			                                : GetLine(stderrfile.get(), &stderr_buf);
 			if ( length == -3 )
+				{
+				FlushBatch();
 				return false;
+				}
 
 			else if ( length == -2 || length == -1 )
 				break;
@@ -641,10 +777,12 @@ bool Raw::DoUpdate()
 			bval->val.int_val = 1; // yes, we are stderr
 			fields[1] = bval;
 
-			Put(fields);
+			Deliver(fields);
 			}
 		}
 
+	FlushBatch();
+
 	if ( ( Info().mode == MODE_MANUAL ) || ( Info().mode == MODE_REREAD ) )
 		// done with the current data source
 		EndCurrentSend();
@@ -705,6 +843,10 @@ bool Raw::DoUpdate()
 
 bool Raw::DoHeartbeat(double network_time, double current_time)
 	{
+	if ( Info().mode == MODE_REREAD && FileWatched() )
+		// We get updated when the file changes.
+		return true;
+
 	switch ( Info().mode ) {
 		case MODE_MANUAL:
 			// yay, we do nothing :)
@@ -40,9 +40,23 @@ private:
 	bool SetFDFlags(int fd, int cmd, int flags);
 	std::unique_lock<std::mutex> AcquireForkMutex();
 
+	// Data read from a file that hasn't been passed on yet.
+	struct ReadBuffer {
+		std::unique_ptr<char[]> data;
+		size_t size = 0;	// Bytes allocated.
+		size_t start = 0;	// Where the data left to pass on begins.
+		size_t end = 0;	// Where the data read so far ends.
+		size_t scanned = 0;	// Bytes after start known to contain no separator.
+	};
+
 	bool OpenInput();
 	bool CloseInput();
-	int64_t GetLine(FILE* file);
+	int64_t Fill(FILE* file, ReadBuffer* b);
+	int64_t GetLine(FILE* file, ReadBuffer* b);
+	int64_t GetChunk(FILE* file, ReadBuffer* b);
+	void TakeData(ReadBuffer* b, size_t len);
+	void Deliver(threading::Value** fields);
+	void FlushBatch();
 	bool Execute();
 	void WriteToStdin();
 
@@ -58,10 +72,18 @@ private:
 	string separator;
 	unsigned int sep_length; // length of the separator
 
-	int bufpos;
-	std::unique_ptr<char[]> buf;
+	ReadBuffer stdout_buf;
+	ReadBuffer stderr_buf;
 	std::unique_ptr<char[]> outbuf;
 
+	// If true, passes on all complete records read at once, rather
+	// than one at a time.
+	bool deliver_chunks;
+
+	// Rows to collect before passing them on together.
+	unsigned int batch_size;
+	std::vector<threading::Value**> batch;
+
 	int stdin_fileno;
 	int stdout_fileno;
 	int stderr_fileno;
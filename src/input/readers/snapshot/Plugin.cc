@@ -0,0 +1,24 @@
+// See the file  in the main distribution directory for copyright.
+
+#include "plugin/Plugin.h"
+
+#include "Snapshot.h"
+
+namespace plugin {
+namespace Zeek_SnapshotReader {
+
+class Plugin : public plugin::Plugin {
+public:
+	plugin::Configuration Configure() override
+		{
+		AddComponent(new ::input::Component("Snapshot", ::input::reader::Snapshot::Instantiate));
+
+		plugin::Configuration config;
+		config.name = "Zeek::SnapshotReader";
+		config.description = "Binary row snapshot input reader";
+		return config;
+		}
+} plugin;
+
+}
+}
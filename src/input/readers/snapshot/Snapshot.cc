@@ -0,0 +1,372 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "Snapshot.h"
+
+#include "threading/SerialTypes.h"
+#include "threading/RowFile.h"
+#include "SerializationFormat.h"
+
+using namespace input::reader;
+using threading::Value;
+using threading::Field;
+using threading::RowFile;
+
+Snapshot::Snapshot(ReaderFrontend *frontend)
+	: ReaderBackend(frontend), file(0), have_header(false), firstrun(true), mtime(0), ino(0)
+	{
+	}
+
+Snapshot::~Snapshot()
+	{
+	DoClose();
+
+	for ( auto f : file_fields )
+		delete f;
+	}
+
+void Snapshot::DoClose()
+	{
+	CloseFile();
+	}
+
+bool Snapshot::OpenFile()
+	{
+	file = fopen(fname.c_str(), "r");
+
+	if ( ! file )
+		{
+		char buf[256];
+		bro_strerror_r(errno, buf, sizeof(buf));
+		Error(Fmt("cannot open %s: %s", fname.c_str(), buf));
+		return false;
+		}
+
+	have_header = false;
+	return true;
+	}
+
+void Snapshot::CloseFile()
+	{
+	if ( ! file )
+		return;
+
+	fclose(file);
+	file = 0;
+	}
+
+int Snapshot::UpdateModificationTime()
+	{
+	struct stat sb;
+
+	if ( stat(fname.c_str(), &sb) == -1 )
+		{
+		Error(Fmt("Could not get stat for %s", fname.c_str()));
+		return -1;
+		}
+
+	if ( sb.st_ino == ino && sb.st_mtime == mtime )
+		// no change
+		return 0;
+
+	mtime = sb.st_mtime;
+	ino = sb.st_ino;
+	return 1;
+	}
+
+bool Snapshot::DoInit(const ReaderInfo& info, int num_fields,
+                      const Field* const* fields)
+	{
+	if ( ! info.source || strlen(info.source) == 0 )
+		{
+		Error("No source path provided");
+		return false;
+		}
+
+	fname = info.source;
+
+	if ( ! OpenFile() )
+		return false;
+
+	if ( UpdateModificationTime() == -1 )
+		return false;
+
+	firstrun = true;
+
+	if ( ! DoUpdate() )
+		return false;
+
+	if ( Info().mode == MODE_REREAD )
+		WatchFile(fname.c_str());
+
+	return true;
+	}
+
+// Returns true if the value is of the given type, including its elements.
+static bool value_has_type(const Value* v, TypeTag type, TypeTag subtype)
+	{
+	if ( v->type != type )
+		return false;
+
+	if ( ! v->present || (type != TYPE_TABLE && type != TYPE_VECTOR) )
+		return true;
+
+	const Value::set_t& s = (type == TYPE_TABLE ? v->val.set_val : v->val.vector_val);
+
+	for ( bro_int_t i = 0; i < s.size; ++i )
+		{
+		if ( ! value_has_type(s.vals[i], subtype, TYPE_VOID) )
+			return false;
+		}
+
+	return true;
+	}
+
+bool Snapshot::ReadHeader()
+	{
+	for ( auto f : file_fields )
+		delete f;
+
+	file_fields.clear();
+	column_map.clear();
+
+	std::string error;
+
+	switch ( RowFile::ReadHeader(file, &file_fields, &error) ) {
+	case RowFile::READ_OK:
+		break;
+
+	case RowFile::READ_END:
+		// Still being written, we'll try again with the next update.
+		return true;
+
+	case RowFile::READ_ERROR:
+		Error(Fmt("%s: %s", fname.c_str(), error.c_str()));
+		return false;
+	}
+
+	for ( int i = 0; i < NumFields(); ++i )
+		{
+		const Field* field = Fields()[i];
+		int column = -1;
+
+		for ( size_t j = 0; j < file_fields.size(); ++j )
+			{
+			if ( strcmp(file_fields[j]->name, field->name) == 0 )
+				{
+				column = j;
+				break;
+				}
+			}
+
+		if ( column < 0 )
+			{
+			if ( ! field->optional )
+				{
+				Error(Fmt("Did not find requested field %s in %s", field->name, fname.c_str()));
+				return false;
+				}
+			}
+
+		else
+			{
+			const Field* have = file_fields[column];
+			bool container = (field->type == TYPE_TABLE || field->type == TYPE_VECTOR);
+
+			if ( have->type != field->type || (container && have->subtype != field->subtype) )
+				{
+				Error(Fmt("Field %s in %s is of type %s, but %s was requested",
+				          field->name, fname.c_str(), have->TypeName().c_str(),
+				          field->TypeName().c_str()));
+				return false;
+				}
+			}
+
+		column_map.push_back(column);
+		}
+
+	have_header = true;
+	return true;
+	}
+
+bool Snapshot::ProcessBlock(const std::string& data, uint32 num_rows)
+	{
+	BinarySerializationFormat fmt;
+	fmt.StartRead(data.data(), data.size());
+
+	int num_file_fields = file_fields.size();
+	row.assign(num_file_fields, 0);
+
+	for ( uint32 r = 0; r < num_rows; ++r )
+		{
+		bool ok = true;
+
+		for ( int j = 0; ok && j < num_file_fields; ++j )
+			{
+			// Each value takes at least a few bytes, so this keeps
+			// the format from running out of input.
+			if ( size_t(fmt.BytesRead()) >= data.size() )
+				{
+				ok = false;
+				break;
+				}
+
+			row[j] = new Value();
+			ok = row[j]->Read(&fmt) &&
+				value_has_type(row[j], file_fields[j]->type, file_fields[j]->subtype);
+			}
+
+		if ( ! ok )
+			{
+			for ( int j = 0; j < num_file_fields; ++j )
+				{
+				delete row[j];
+				row[j] = 0;
+				}
+
+			fmt.EndRead();
+			Error(Fmt("%s: invalid row in block", fname.c_str()));
+			return false;
+			}
+
+		Value** vals = new Value*[NumFields()];
+		bool complete = true;
+
+		for ( int i = 0; i < NumFields(); ++i )
+			{
+			const Field* field = Fields()[i];
+			int j = column_map[i];
+
+			if ( j >= 0 )
+				{
+				vals[i] = row[j];
+				row[j] = 0;
+				}
+			else
+				vals[i] = new Value(field->type, field->subtype, false);
+
+			if ( ! vals[i]->present && ! field->optional )
+				complete = false;
+			}
+
+		for ( int j = 0; j < num_file_fields; ++j )
+			{
+			delete row[j];
+			row[j] = 0;
+			}
+
+		if ( ! complete )
+			{
+			Warning(Fmt("%s: skipping row with unset non-optional field", fname.c_str()));
+
+			for ( int i = 0; i < NumFields(); ++i )
+				delete vals[i];
+
+			delete [] vals;
+			continue;
+			}
+
+		if ( Info().mode == MODE_STREAM )
+			Put(vals);
+		else
+			SendEntry(vals);
+		}
+
+	fmt.EndRead();
+	return true;
+	}
+
+bool Snapshot::DoUpdate()
+	{
+	if ( firstrun )
+		firstrun = false;
+
+	else
+		{
+		switch ( Info().mode ) {
+		case MODE_REREAD:
+			{
+			switch ( UpdateModificationTime() ) {
+			case -1:
+				return false; // error
+			case 0:
+				return true; // no change
+			case 1:
+				break; // file changed. reread.
+			default:
+				assert(false);
+			}
+			// fallthrough
+			}
+
+		case MODE_MANUAL:
+			CloseFile();
+
+			if ( ! OpenFile() )
+				return false;
+
+			break;
+
+		case MODE_STREAM:
+			// Continue where we left off.
+			break;
+
+		default:
+			assert(false);
+		}
+		}
+
+	if ( ! have_header && ! ReadHeader() )
+		return false;
+
+	while ( have_header )
+		{
+		uint32 num_rows;
+		std::string error;
+
+		RowFile::ReadResult r = RowFile::ReadBlock(file, &block, &num_rows, &error);
+
+		if ( r == RowFile::READ_END )
+			break;
+
+		if ( r == RowFile::READ_ERROR )
+			{
+			Error(Fmt("%s: %s", fname.c_str(), error.c_str()));
+			return false;
+			}
+
+		if ( ! ProcessBlock(block, num_rows) )
+			return false;
+		}
+
+	if ( Info().mode != MODE_STREAM )
+		EndCurrentSend();
+
+	return true;
+	}
+
+bool Snapshot::DoHeartbeat(double network_time, double current_time)
+	{
+	if ( Info().mode == MODE_REREAD && FileWatched() )
+		// We get updated when the file changes.
+		return true;
+
+	switch ( Info().mode ) {
+		case MODE_MANUAL:
+			// yay, we do nothing :)
+			break;
+
+		case MODE_REREAD:
+		case MODE_STREAM:
+			Update();	// call update and not DoUpdate, because update
+					// checks disabled.
+			break;
+
+		default:
+			assert(false);
+	}
+
+	return true;
+	}
@@ -0,0 +1,65 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef INPUT_READERS_SNAPSHOT_H
+#define INPUT_READERS_SNAPSHOT_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "input/ReaderBackend.h"
+
+namespace input { namespace reader {
+
+/**
+ * Reader for Zeek's binary row files, as written by the Snapshot log
+ * writer. See threading::RowFile for the format. The rows come in already
+ * serialized the way the reader passes them on, so the only work left is
+ * matching the file's fields to the ones the stream asks for, by name.
+ */
+class Snapshot : public ReaderBackend {
+public:
+	explicit Snapshot(ReaderFrontend* frontend);
+	~Snapshot() override;
+
+	static ReaderBackend* Instantiate(ReaderFrontend* frontend)
+		{ return new Snapshot(frontend); }
+
+protected:
+	bool DoInit(const ReaderInfo& info, int arg_num_fields,
+	            const threading::Field* const* fields) override;
+	void DoClose() override;
+	bool DoUpdate() override;
+	bool DoHeartbeat(double network_time, double current_time) override;
+
+private:
+	bool OpenFile();
+	void CloseFile();
+	bool ReadHeader();
+	int UpdateModificationTime();
+	bool ProcessBlock(const std::string& data, uint32 num_rows);
+
+	string fname;
+	FILE* file;
+	bool have_header;
+	bool firstrun;
+	time_t mtime;
+	ino_t ino;
+
+	// The fields in the file.
+	std::vector<threading::Field*> file_fields;
+
+	// For each field of the stream, the index of the one in the file
+	// that it comes from, or -1 if the file doesn't have it.
+	std::vector<int> column_map;
+
+	// Reused while reading, to save allocations.
+	std::string block;
+	std::vector<threading::Value*> row;
+};
+
+}
+}
+
+#endif /* INPUT_READERS_SNAPSHOT_H */
@@ -21,7 +21,8 @@ using threading::Field;
 
 SQLite::SQLite(ReaderFrontend *frontend)
 	: ReaderBackend(frontend),
-	  fields(), num_fields(), mode(), started(), query(), db(), st()
+	  fields(), num_fields(), mode(), started(), query(), db(), st(),
+	  rowid_column(-1), last_rowid()
 	{
 	set_separator.assign(
 			(const char*) BifConst::LogSQLite::set_separator->Bytes(),
@@ -51,6 +52,8 @@ void SQLite::DoClose()
 	{
 	if ( db != 0 )
 		{
+		sqlite3_finalize(st);
+		st = 0;
 		sqlite3_close(db);
 		db = 0;
 		}
@@ -79,9 +82,12 @@ bool SQLite::DoInit(const ReaderInfo& info, int arg_num_fields, const threading:
 	// allows simultaneous writes to one file.
 	sqlite3_enable_shared_cache(1);
 
-	if ( Info().mode != MODE_MANUAL )
+	ReaderInfo::config_map::const_iterator rowid = info.config.find("rowid_column");
+
+	if ( Info().mode != MODE_MANUAL &&
+	     ! (Info().mode == MODE_STREAM && rowid != info.config.end()) )
 		{
-		Error("SQLite only supports manual reading mode.");
+		Error("SQLite only supports manual reading mode, and streaming with rowid_column set.");
 		return false;
 		}
 
@@ -118,11 +124,86 @@ bool SQLite::DoInit(const ReaderInfo& info, int arg_num_fields, const threading:
 		return false;
 		}
 
+	if ( ! MapColumns() )
+		return false;
+
+	if ( rowid != info.config.end() )
+		{
+		for ( int i = 0; i < sqlite3_column_count(st); ++i )
+			{
+			if ( strcmp(sqlite3_column_name(st, i), rowid->second) == 0 )
+				rowid_column = i;
+			}
+
+		if ( rowid_column < 0 )
+			{
+			Error(Fmt("Column %s not found after SQLite statement", rowid->second));
+			return false;
+			}
+
+		if ( sqlite3_bind_parameter_index(st, ":last_rowid") == 0 )
+			{
+			Error("SQLite query needs a :last_rowid parameter to be read incrementally");
+			return false;
+			}
+		}
+
 	DoUpdate();
 
 	return true;
 	}
 
+bool SQLite::MapColumns()
+	{
+	int numcolumns = sqlite3_column_count(st);
+
+	// first set them all to -1
+	mapping.assign(num_fields, -1);
+	submapping.assign(num_fields, -1);
+
+	for ( int i = 0; i < numcolumns; ++i )
+		{
+		const char *name = sqlite3_column_name(st, i);
+
+		for ( unsigned j = 0; j < num_fields; j++ )
+			{
+			if ( strcmp(fields[j]->name, name) == 0 )
+				{
+				if ( mapping[j] != -1 )
+					{
+					Error(Fmt("SQLite statement returns several columns with name %s! Cannot decide which to choose, aborting", name));
+					return false;
+					}
+
+				mapping[j] = i;
+				}
+
+			if ( fields[j]->secondary_name != 0 && strcmp(fields[j]->secondary_name, name) == 0 )
+				{
+				assert(fields[j]->type == TYPE_PORT);
+				if ( submapping[j] != -1 )
+					{
+					Error(Fmt("SQLite statement returns several columns with name %s! Cannot decide which to choose, aborting", name));
+					return false;
+					}
+
+				submapping[j] = i;
+				}
+			}
+		}
+
+	for ( unsigned int i = 0; i < num_fields; ++i )
+		{
+		if ( mapping[i] == -1 )
+			{
+			Error(Fmt("Required field %s not found after SQLite statement", fields[i]->name));
+			return false;
+			}
+		}
+
+	return true;
+	}
+
 // pos = field position
 // subpos = subfield position, only used for port-field
 Value* SQLite::EntryToVal(sqlite3_stmt *st, const threading::Field *field, int pos, int subpos)
@@ -246,62 +327,14 @@ Value* SQLite::EntryToVal(sqlite3_stmt *st, const threading::Field *field, int p
 
 bool SQLite::DoUpdate()
 	{
-	int numcolumns = sqlite3_column_count(st);
-	int *mapping = new int [num_fields];
-	int *submapping = new int [num_fields];
-
-	// first set them all to -1
-	for ( unsigned int i = 0; i < num_fields; ++i )
-		{
-		mapping[i] = -1;
-		submapping[i] = -1;
-		}
-
-	for ( int i = 0; i < numcolumns; ++i )
-		{
-		const char *name = sqlite3_column_name(st, i);
+	// The statement is prepared once and reused. Incremental queries
+	// only get the rows added since the last update, which add to what
+	// we've sent before rather than replace it.
+	bool incremental = (rowid_column >= 0);
 
-		for ( unsigned j = 0; j < num_fields; j++ )
-			{
-			if ( strcmp(fields[j]->name, name) == 0 )
-				{
-				if ( mapping[j] != -1 )
-					{
-					Error(Fmt("SQLite statement returns several columns with name %s! Cannot decide which to choose, aborting", name));
-					delete [] mapping;
-					delete [] submapping;
-					return false;
-					}
-
-				mapping[j] = i;
-				}
-
-			if ( fields[j]->secondary_name != 0 && strcmp(fields[j]->secondary_name, name) == 0 )
-				{
-				assert(fields[j]->type == TYPE_PORT);
-				if ( submapping[j] != -1 )
-					{
-					Error(Fmt("SQLite statement returns several columns with name %s! Cannot decide which to choose, aborting", name));
-					delete [] mapping;
-					delete [] submapping;
-					return false;
-					}
-
-				submapping[j] = i;
-				}
-			}
-		}
-
-	for ( unsigned int i = 0; i < num_fields; ++i )
-		{
-		if ( mapping[i] == -1 )
-			{
-			Error(Fmt("Required field %s not found after SQLite statement", fields[i]->name));
-			delete [] mapping;
-			delete [] submapping;
-			return false;
-			}
-		}
+	if ( incremental &&
+	     checkError(sqlite3_bind_int64(st, sqlite3_bind_parameter_index(st, ":last_rowid"), last_rowid)) )
+		return false;
 
 	int errorcode;
 	while ( ( errorcode = sqlite3_step(st)) == SQLITE_ROW )
@@ -317,22 +350,34 @@ bool SQLite::DoUpdate()
 					delete ofields[k];
 
 				delete [] ofields;
-				delete [] mapping;
-				delete [] submapping;
+				sqlite3_reset(st);
 				return false;
 				}
 			}
 
-		SendEntry(ofields);
-		}
+		if ( incremental )
+			{
+			int64 rowid = sqlite3_column_int64(st, rowid_column);
 
-	delete [] mapping;
-	delete [] submapping;
+			if ( rowid > last_rowid )
+				last_rowid = rowid;
+
+			Put(ofields);
+			}
+		else
+			SendEntry(ofields);
+		}
 
 	if ( checkError(errorcode) ) // check the last error code returned by sqlite
+		{
+		sqlite3_reset(st);
 		return false;
+		}
 
-	EndCurrentSend();
+	if ( ! incremental )
+		EndCurrentSend();
+	else if ( Info().mode == MODE_MANUAL )
+		EndOfData();
 
 	if ( checkError(sqlite3_reset(st)) )
 		return false;
@@ -340,3 +385,11 @@ bool SQLite::DoUpdate()
 	return true;
 	}
 
+bool SQLite::DoHeartbeat(double network_time, double current_time)
+	{
+	if ( Info().mode == MODE_STREAM )
+		Update();	// call update and not DoUpdate, because update
+				// checks disabled.
+
+	return true;
+	}
@@ -25,10 +25,11 @@ protected:
 	bool DoInit(const ReaderInfo& info, int arg_num_fields, const threading::Field* const* arg_fields) override;
 	void DoClose() override;
 	bool DoUpdate() override;
-	bool DoHeartbeat(double network_time, double current_time) override { return true; }
+	bool DoHeartbeat(double network_time, double current_time) override;
 
 private:
 	bool checkError(int code);
+	bool MapColumns();
 
 	threading::Value* EntryToVal(sqlite3_stmt *st, const threading::Field *field, int pos, int subpos);
 
@@ -41,6 +42,15 @@ private:
 	sqlite3_stmt *st;
 	threading::formatter::Ascii* io;
 
+	// Result columns of the fields, and of the ports' protocols.
+	std::vector<int> mapping;
+	std::vector<int> submapping;
+
+	// For incremental queries, the result column with the rowids, and
+	// the highest one seen so far.
+	int rowid_column;
+	int64 last_rowid;
+
 	string set_separator;
 	string unset_field;
 	string empty_field;
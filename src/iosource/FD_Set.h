@@ -85,6 +85,14 @@ public:
 		return fds.empty();
 		}
 
+	/**
+	 * @return all file descriptors that have been added to the set.
+	 */
+	const std::set<int>& Fds() const
+		{
+		return fds;
+		}
+
 	/**
 	 * @return the greatest file descriptor of all that have been added to the
 	 * set, or -1 if the set is empty.
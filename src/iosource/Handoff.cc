@@ -0,0 +1,325 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <pcap.h>
+
+#include "Handoff.h"
+#include "util.h"
+
+#include "pcap/pcap.bif.h"
+
+using namespace iosource;
+
+HandoffSource* iosource::packet_handoff = 0;
+
+// Seconds between checks of a peer's segment, whether or not it's up.
+static const double PEER_CHECK_INTERVAL = 1.0;
+
+static inline uint32 record_size(uint32 cap_len, size_t hdr_len)
+	{
+	// Keep records 8-byte aligned.
+	return (hdr_len + cap_len + 7) & ~size_t(7);
+	}
+
+HandoffSource::HandoffSource(const std::string& arg_name)
+	{
+	name = arg_name;
+	num_shards = BifConst::Pcap::flow_shards;
+	my_shard = BifConst::Pcap::flow_shard;
+	ring_size = (BifConst::Pcap::flow_handoff_ring_size + 7) & ~size_t(7);
+	segment_size = num_shards * RingSpace();
+	current_ring = 0;
+	current_size = 0;
+	next_ring = 0;
+
+	props.path = "handoff:" + name;
+	props.is_live = true;
+	props.link_type = DLT_EN10MB;
+	}
+
+HandoffSource::~HandoffSource()
+	{
+	Close();
+
+	if ( packet_handoff == this )
+		packet_handoff = 0;
+	}
+
+std::string HandoffSource::SegmentName(uint64 shard) const
+	{
+	return fmt("/%s-%" PRIu64, name.c_str(), shard);
+	}
+
+void HandoffSource::Open()
+	{
+	if ( num_shards <= 1 || my_shard >= num_shards )
+		{
+		Error("packet handoff requires Pcap::flow_shards and Pcap::flow_shard");
+		return;
+		}
+
+	if ( ring_size < 2 * record_size(BifConst::Pcap::snaplen, sizeof(Record)) )
+		{
+		Error("Pcap::flow_handoff_ring_size too small for Pcap::snaplen");
+		return;
+		}
+
+	// A segment left behind by an earlier run would have stale ring
+	// positions.
+	std::string seg_name = SegmentName(my_shard);
+	shm_unlink(seg_name.c_str());
+
+	int fd = shm_open(seg_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+	if ( fd < 0 )
+		{
+		Error(fmt("cannot create %s: %s", seg_name.c_str(), strerror(errno)));
+		return;
+		}
+
+	// The new segment reads as zeros, so all rings start out empty.
+	if ( ftruncate(fd, segment_size) < 0 )
+		{
+		Error(fmt("cannot size %s: %s", seg_name.c_str(), strerror(errno)));
+		close(fd);
+		shm_unlink(seg_name.c_str());
+		return;
+		}
+
+	void* m = mmap(0, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if ( m == MAP_FAILED )
+		{
+		Error(fmt("cannot map %s: %s", seg_name.c_str(), strerror(errno)));
+		shm_unlink(seg_name.c_str());
+		return;
+		}
+
+	own.base = static_cast<u_char*>(m);
+
+	// Other processes update the ring positions concurrently.
+	if ( ! Ring(own, 0)->head.is_lock_free() )
+		{
+		Error("packet handoff requires lock-free 64-bit atomics");
+		Close();
+		return;
+		}
+
+	peers.resize(num_shards);
+	Opened(props);
+	}
+
+void HandoffSource::Close()
+	{
+	for ( auto& p : peers )
+		UnmapPeer(&p);
+
+	peers.clear();
+
+	if ( ! own.base )
+		return;
+
+	munmap(own.base, segment_size);
+	own.base = 0;
+	shm_unlink(SegmentName(my_shard).c_str());
+
+	Closed();
+	}
+
+bool HandoffSource::MapPeer(uint64 shard, double t)
+	{
+	Segment& s = peers[shard];
+
+	if ( t < s.check_time )
+		return s.base != 0;
+
+	s.check_time = t + PEER_CHECK_INTERVAL;
+
+	int fd = shm_open(SegmentName(shard).c_str(), O_RDWR, 0);
+	struct stat st;
+
+	// The peer may not be up, not have sized the segment yet, or have
+	// a different configuration.
+	if ( fd < 0 || fstat(fd, &st) < 0 || size_t(st.st_size) != segment_size )
+		{
+		if ( fd >= 0 )
+			close(fd);
+
+		UnmapPeer(&s);
+		return false;
+		}
+
+	if ( s.base && st.st_dev == s.dev && st.st_ino == s.ino )
+		{
+		close(fd);
+		return true;
+		}
+
+	// A restarted peer has set up a new segment, and nobody reads the
+	// one we have mapped anymore.
+	UnmapPeer(&s);
+
+	void* m = mmap(0, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if ( m == MAP_FAILED )
+		return false;
+
+	s.base = static_cast<u_char*>(m);
+	s.dev = st.st_dev;
+	s.ino = st.st_ino;
+	return true;
+	}
+
+void HandoffSource::UnmapPeer(Segment* s)
+	{
+	if ( ! s->base )
+		return;
+
+	munmap(s->base, segment_size);
+	s->base = 0;
+	}
+
+void HandoffSource::Forward(const Packet* pkt, uint64 shard)
+	{
+	if ( ! own.base || shard >= num_shards || shard == my_shard )
+		return;
+
+	if ( ! MapPeer(shard, pkt->time) )
+		{
+		++stats.dropped;
+		Weird("packet_handoff_peer_unavailable", pkt);
+		return;
+		}
+
+	// We're the only producer for this ring, so only the tail can
+	// change under us.
+	RingHeader* r = Ring(peers[shard], my_shard);
+	u_char* data = (u_char*) (r + 1);
+
+	uint32 size = record_size(pkt->cap_len, sizeof(Record));
+	uint64 head = r->head.load(std::memory_order_relaxed);
+	uint64 tail = r->tail.load(std::memory_order_acquire);
+
+	size_t pos = head % ring_size;
+	size_t left = ring_size - pos;
+	size_t needed = left < size ? left + size : size;
+
+	if ( head - tail + needed > ring_size )
+		{
+		++stats.dropped;
+		Weird("packet_handoff_ring_full", pkt);
+		return;
+		}
+
+	if ( left < size )
+		{
+		// Doesn't fit before the end; mark the rest as unused.
+		((Record*) (data + pos))->size = 0;
+		head += left;
+		pos = 0;
+		}
+
+	Record* rec = (Record*) (data + pos);
+	rec->size = size;
+	rec->link_type = pkt->link_type;
+	rec->cap_len = pkt->cap_len;
+	rec->len = pkt->len;
+	rec->ts_sec = pkt->ts.tv_sec;
+	rec->ts_usec = pkt->ts.tv_usec;
+	memcpy(rec + 1, pkt->data, pkt->cap_len);
+
+	r->head.store(head + size, std::memory_order_release);
+	}
+
+bool HandoffSource::ExtractNextPacket(Packet* pkt)
+	{
+	if ( ! own.base )
+		return false;
+
+	// Take turns between the peers so that none gets starved.
+	for ( uint64 i = 0; i < num_shards; ++i )
+		{
+		uint64 from = (next_ring + i) % num_shards;
+
+		if ( from == my_shard )
+			continue;
+
+		RingHeader* r = Ring(own, from);
+		u_char* data = (u_char*) (r + 1);
+		uint64 tail = r->tail.load(std::memory_order_relaxed);
+
+		for ( ;; )
+			{
+			uint64 head = r->head.load(std::memory_order_acquire);
+
+			if ( tail == head )
+				break;
+
+			size_t pos = tail % ring_size;
+			const Record* rec = (const Record*) (data + pos);
+
+			if ( rec->size == 0 )
+				{
+				// Skip to the beginning of the ring.
+				tail += ring_size - pos;
+				r->tail.store(tail, std::memory_order_release);
+				continue;
+				}
+
+			pkt_timeval ts;
+			ts.tv_sec = rec->ts_sec;
+			ts.tv_usec = rec->ts_usec;
+
+			pkt->Init(rec->link_type, &ts, rec->cap_len, rec->len,
+				  (const u_char*) (rec + 1));
+
+			current_ring = from;
+			current_size = rec->size;
+			next_ring = from + 1;
+
+			++stats.received;
+			stats.bytes_received += rec->len;
+			return true;
+			}
+		}
+
+	return false;
+	}
+
+void HandoffSource::DoneWithPacket()
+	{
+	if ( ! current_size )
+		return;
+
+	// Only now may the sender reuse the space.
+	RingHeader* r = Ring(own, current_ring);
+	uint64 tail = r->tail.load(std::memory_order_relaxed);
+	r->tail.store(tail + current_size, std::memory_order_release);
+	current_size = 0;
+	}
+
+bool HandoffSource::PrecompileFilter(int index, const std::string& filter)
+	{
+	// Packets have passed the sender's filters already.
+	return true;
+	}
+
+bool HandoffSource::SetFilter(int index)
+	{
+	return true;
+	}
+
+void HandoffSource::Statistics(Stats* s)
+	{
+	*s = stats;
+	}
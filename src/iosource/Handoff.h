@@ -0,0 +1,147 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef IOSOURCE_HANDOFF_H
+#define IOSOURCE_HANDOFF_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "PktSrc.h"
+
+namespace iosource {
+
+/**
+ * Exchanges packets between the Zeek processes on a host that split the
+ * traffic into flow shards (see Pcap::flow_shards), for when each of them
+ * captures a different part of it, such as one NIC queue each. A process
+ * forwards the packets belonging to another shard to that shard's
+ * process, which then analyzes them as if it had captured them itself.
+ * That way all packets of a connection end up in the same process even
+ * if its two directions arrive at different ones.
+ *
+ * Each process sets up a shared memory segment named after
+ * Pcap::flow_handoff and its shard, with one single-producer,
+ * single-consumer ring per peer for the packets that peer forwards. It
+ * maps its peers' segments once they exist, and maps them anew when a
+ * restarted peer has replaced its segment. Packets for peers that aren't
+ * up, or whose ring is full, get dropped.
+ */
+class HandoffSource : public PktSrc {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param name The name shared by all processes taking part, which
+	 * prefixes their segments' names.
+	 */
+	explicit HandoffSource(const std::string& name);
+
+	/**
+	 * Destructor.
+	 */
+	~HandoffSource() override;
+
+	/**
+	 * Forwards a packet to the process analyzing the given shard.
+	 *
+	 * @param pkt The packet, which the call copies.
+	 *
+	 * @param shard The shard the packet belongs to.
+	 */
+	void Forward(const Packet* pkt, uint64 shard);
+
+protected:
+	// PktSrc interface.
+	void Open() override;
+	void Close() override;
+	bool ExtractNextPacket(Packet* pkt) override;
+	void DoneWithPacket() override;
+	bool PrecompileFilter(int index, const std::string& filter) override;
+	bool SetFilter(int index) override;
+	void Statistics(Stats* stats) override;
+
+private:
+	// The shared part of a ring. Head and tail count the bytes that
+	// went in and out, respectively, since the ring was set up. They
+	// live on separate cache lines as each is written by a different
+	// process.
+	struct RingHeader {
+		std::atomic<uint64_t> head;
+		char pad1[64 - sizeof(std::atomic<uint64_t>)];
+		std::atomic<uint64_t> tail;
+		char pad2[64 - sizeof(std::atomic<uint64_t>)];
+	};
+
+	// Precedes each packet in a ring. A size of zero marks the unused
+	// end of the ring, with the next record starting at its beginning.
+	struct Record {
+		uint32 size;	// Including this header and padding.
+		uint32 link_type;
+		uint32 cap_len;
+		uint32 len;
+		int64 ts_sec;
+		int64 ts_usec;
+	};
+
+	// A segment mapped into memory, holding a ring per shard.
+	struct Segment {
+		Segment() : base(0), dev(0), ino(0), check_time(0)	{ }
+
+		u_char* base;
+		dev_t dev;	// Which file we mapped, to notice a new
+		ino_t ino;	// one under the same name.
+		double check_time;	// When to look at a peer's segment again.
+	};
+
+	// Returns the name of the segment of the given shard.
+	std::string SegmentName(uint64 shard) const;
+
+	// Returns the header of the ring for packets from shard "from" in
+	// the given segment, which is followed by the ring's data.
+	RingHeader* Ring(const Segment& s, uint64 from) const
+		{ return (RingHeader*) (s.base + from * RingSpace()); }
+
+	// Returns the bytes taken up by a ring including its header.
+	size_t RingSpace() const
+		{ return sizeof(RingHeader) + ring_size; }
+
+	// Maps the segment of the given peer, if it's up. Checks every so
+	// often whether the peer is still up with the same segment.
+	bool MapPeer(uint64 shard, double t);
+
+	// Unmaps a peer's segment, if mapped.
+	void UnmapPeer(Segment* s);
+
+	Properties props;
+	Stats stats;
+
+	std::string name;
+	uint64 num_shards;
+	uint64 my_shard;
+	size_t ring_size;
+	size_t segment_size;
+
+	// Our own segment, and those of the peers by shard.
+	Segment own;
+	std::vector<Segment> peers;
+
+	// The ring the current packet came from, and the size of its
+	// record.
+	uint64 current_ring;
+	uint32 current_size;
+
+	// The ring to look at first for the next packet.
+	uint64 next_ring;
+};
+
+/**
+ * The handoff between flow shards, if Pcap::flow_handoff is set.
+ */
+extern HandoffSource* packet_handoff;
+
+}
+
+#endif
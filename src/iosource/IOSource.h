@@ -22,7 +22,7 @@ public:
 	/**
 	 * Constructor.
 	 */
-	IOSource()	{ idle = false; closed = false; }
+	IOSource()	{ idle = false; closed = false; fds_version = 0; }
 
 	/**
 	 * Destructor.
@@ -63,6 +63,13 @@ public:
 	 */
 	virtual void GetFds(FD_Set* read, FD_Set* write, FD_Set* except) = 0;
 
+	/**
+	 * Returns a counter that changes whenever the descriptors GetFds()
+	 * returns may have changed. The manager caches them and calls
+	 * GetFds() again only once this changes.
+	 */
+	unsigned int FdsVersion() const	{ return fds_version; }
+
 	/**
 	 * Returns the timestamp (in \a global network time) associated with
 	 * next data item from this source.  If the source wants the data
@@ -130,9 +137,16 @@ protected:
 	 */
 	void SetClosed(bool is_closed)	{ closed = is_closed; }
 
+	/*
+	 * Callback for derived classes to call when the descriptors they
+	 * return from GetFds() change.
+	 */
+	void FdsChanged()	{ ++fds_version; }
+
 private:
 	bool idle;
 	bool closed;
+	unsigned int fds_version;
 };
 
 }
@@ -19,6 +19,14 @@
 
 using namespace iosource;
 
+Manager::Manager()
+	{
+	call_count = 0;
+	dont_counts = 0;
+
+	DBG_LOG(DBG_MAINLOOP, "using %s for IOSource readiness", poller.Backend());
+	}
+
 Manager::~Manager()
 	{
 	for ( SourceList::iterator i = sources.begin(); i != sources.end(); ++i )
@@ -54,6 +62,8 @@ IOSource* Manager::FindSoonest(double* ts)
 		if ( ! (*i)->src->IsOpen() )
 			{
 			(*i)->src->Done();
+			(*i)->Clear();
+			UpdatePollerInterest(*i);
 			delete *i;
 			sources.erase(i);
 			break;
@@ -99,6 +109,21 @@ IOSource* Manager::FindSoonest(double* ts)
 	if ( soonest_src && (call_count % SELECT_FREQUENCY) != 0 )
 		goto finished;
 
+	if ( poller.IsValid() )
+		{
+		if ( all_idle )
+			{
+			// See below.
+			struct timeval timeout;
+			timeout.tv_sec = 0;
+			timeout.tv_usec = 20;
+			select(0, 0, 0, 0, &timeout);
+			}
+
+		PollIdleSources(&soonest_src, &soonest_ts, &soonest_local_network_time);
+		goto finished;
+		}
+
 	// Select on the join of all file descriptors.
 	fd_set fd_read, fd_write, fd_except;
 
@@ -116,8 +141,7 @@ IOSource* Manager::FindSoonest(double* ts)
 			// be ready.
 			continue;
 
-		src->Clear();
-		src->src->GetFds(&src->fd_read, &src->fd_write, &src->fd_except);
+		RefreshFds(src);
 		src->SetFds(&fd_read, &fd_write, &fd_except, &maxx);
 		}
 
@@ -179,6 +203,115 @@ finished:
 	return soonest_src;
 	}
 
+void Manager::AdjustInterest(const FD_Set& from, const FD_Set& to,
+                             int FdInterest::* counter, std::set<int>* touched)
+	{
+	const std::set<int>& old_fds = from.Fds();
+	const std::set<int>& new_fds = to.Fds();
+
+	for ( std::set<int>::const_iterator i = old_fds.begin(); i != old_fds.end(); ++i )
+		if ( new_fds.find(*i) == new_fds.end() )
+			{
+			--(fd_interest[*i].*counter);
+			touched->insert(*i);
+			}
+
+	for ( std::set<int>::const_iterator i = new_fds.begin(); i != new_fds.end(); ++i )
+		if ( old_fds.find(*i) == old_fds.end() )
+			{
+			++(fd_interest[*i].*counter);
+			touched->insert(*i);
+			}
+	}
+
+void Manager::UpdatePollerInterest(Source* src)
+	{
+	if ( ! poller.IsValid() )
+		return;
+
+	std::set<int> touched;
+	AdjustInterest(src->reg_read, src->fd_read, &FdInterest::read, &touched);
+	AdjustInterest(src->reg_write, src->fd_write, &FdInterest::write, &touched);
+	AdjustInterest(src->reg_except, src->fd_except, &FdInterest::except, &touched);
+
+	src->reg_read = src->fd_read;
+	src->reg_write = src->fd_write;
+	src->reg_except = src->fd_except;
+
+	// Only descriptors whose set of interested sources changed need to
+	// go to the backend; in the common case that's none at all.
+	for ( std::set<int>::const_iterator i = touched.begin(); i != touched.end(); ++i )
+		{
+		const FdInterest& interest = fd_interest[*i];
+		int mask = (interest.read ? Poller::READ : 0) |
+			   (interest.write ? Poller::WRITE : 0) |
+			   (interest.except ? Poller::EXCEPT : 0);
+
+		poller.Update(*i, mask);
+
+		if ( ! mask )
+			fd_interest.erase(*i);
+		}
+	}
+
+void Manager::RefreshFds(Source* src)
+	{
+	if ( src->have_fds && src->fds_version == src->src->FdsVersion() )
+		return;
+
+	src->Clear();
+	src->src->GetFds(&src->fd_read, &src->fd_write, &src->fd_except);
+	src->fds_version = src->src->FdsVersion();
+	src->have_fds = true;
+	UpdatePollerInterest(src);
+	}
+
+void Manager::PollIdleSources(IOSource** soonest_src, double* soonest_ts,
+                              double* soonest_local_network_time)
+	{
+	bool have_fds = false;
+
+	for ( SourceList::iterator i = sources.begin(); i != sources.end(); ++i )
+		{
+		Source* src = (*i);
+
+		if ( ! src->src->IsIdle() )
+			continue;
+
+		RefreshFds(src);
+
+		if ( ! (src->fd_read.Empty() && src->fd_write.Empty() && src->fd_except.Empty()) )
+			have_fds = true;
+		}
+
+	if ( ! have_fds )
+		return;
+
+	Poller::ReadySet ready;
+
+	if ( poller.Poll(&ready) <= 0 )
+		return;
+
+	for ( SourceList::iterator i = sources.begin(); i != sources.end(); ++i )
+		{
+		Source* src = (*i);
+
+		if ( ! src->src->IsIdle() || ! src->Ready(ready) )
+			continue;
+
+		double local_network_time = 0;
+		double ts = src->src->NextTimestamp(&local_network_time);
+
+		if ( ts >= 0.0 && ts < *soonest_ts )
+			{
+			*soonest_ts = ts;
+			*soonest_src = src->src;
+			*soonest_local_network_time =
+				local_network_time ? local_network_time : ts;
+			}
+		}
+	}
+
 void Manager::Register(IOSource* src, bool dont_count)
 	{
 	// First see if we already have registered that source. If so, just
@@ -199,6 +332,8 @@ void Manager::Register(IOSource* src, bool dont_count)
 	Source* s = new Source;
 	s->src = src;
 	s->dont_count = dont_count;
+	s->fds_version = 0;
+	s->have_fds = false;
 	if ( dont_count )
 		++dont_counts;
 
@@ -318,6 +453,27 @@ PktDumper* Manager::OpenPktDumper(const string& path, bool append)
 	return pd;
 	}
 
+bool Manager::Source::Ready(const Poller::ReadySet& ready) const
+	{
+	const FD_Set* sets[] = { &fd_read, &fd_write, &fd_except };
+	const int masks[] = { Poller::READ, Poller::WRITE, Poller::EXCEPT };
+
+	for ( int j = 0; j < 3; ++j )
+		{
+		const std::set<int>& fds = sets[j]->Fds();
+
+		for ( std::set<int>::const_iterator i = fds.begin(); i != fds.end(); ++i )
+			{
+			Poller::ReadySet::const_iterator r = ready.find(*i);
+
+			if ( r != ready.end() && (r->second & masks[j]) )
+				return true;
+			}
+		}
+
+	return false;
+	}
+
 void Manager::Source::SetFds(fd_set* read, fd_set* write, fd_set* except,
                              int* maxx) const
 	{
@@ -5,7 +5,9 @@
 
 #include <string>
 #include <list>
+#include <map>
 #include "iosource/FD_Set.h"
+#include "iosource/Poller.h"
 
 namespace iosource {
 
@@ -21,7 +23,7 @@ public:
 	/**
 	 * Constructor.
 	 */
-	Manager()	{ call_count = 0; dont_counts = 0; }
+	Manager();
 
 	/**
 	 * Destructor.
@@ -99,7 +101,8 @@ public:
 private:
 	/**
 	 * When looking for a source with something to process, every
-	 * SELECT_FREQUENCY calls we will go ahead and block on a select().
+	 * SELECT_FREQUENCY calls we will go ahead and poll all idle sources
+	 * for readiness.
 	 */
 	static const int SELECT_FREQUENCY = 25;
 
@@ -114,6 +117,34 @@ private:
 	unsigned int call_count;
 	int dont_counts;
 
+	struct Source;
+
+	// Brings the poller's registrations in line with the descriptors a
+	// source most recently returned from GetFds().
+	void UpdatePollerInterest(Source* src);
+
+	// Asks a source for its descriptors again if they may have changed
+	// since the last time.
+	void RefreshFds(Source* src);
+
+	// Finds the soonest ready source among the idle ones via the poller.
+	void PollIdleSources(IOSource** soonest_src, double* soonest_ts,
+	                     double* soonest_local_network_time);
+
+	// Number of sources interested in each condition, per descriptor.
+	struct FdInterest {
+		int read;
+		int write;
+		int except;
+		FdInterest() : read(0), write(0), except(0)	{ }
+	};
+
+	void AdjustInterest(const FD_Set& from, const FD_Set& to,
+	                    int FdInterest::* counter, std::set<int>* touched);
+
+	Poller poller;
+	std::map<int, FdInterest> fd_interest;
+
 	struct Source {
 		IOSource* src;
 		FD_Set fd_read;
@@ -121,10 +152,21 @@ private:
 		FD_Set fd_except;
 		bool dont_count;
 
+		// The source's FdsVersion() when we last called GetFds().
+		unsigned int fds_version;
+		bool have_fds;
+
+		// Descriptors currently registered with the poller.
+		FD_Set reg_read;
+		FD_Set reg_write;
+		FD_Set reg_except;
+
 		bool Ready(fd_set* read, fd_set* write, fd_set* except) const
 			{ return fd_read.Ready(read) || fd_write.Ready(write) ||
 			         fd_except.Ready(except); }
 
+		bool Ready(const Poller::ReadySet& ready) const;
+
 		void SetFds(fd_set* read, fd_set* write, fd_set* except,
 		            int* maxx) const;
 
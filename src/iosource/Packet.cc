@@ -47,6 +47,9 @@ void Packet::Init(int arg_link_type, pkt_timeval *arg_ts, uint32 arg_caplen,
 	inner_vlan = 0;
 	l2_src = 0;
 	l2_dst = 0;
+	rx_hash = 0;
+	hw_timestamp = false;
+	checksum_offloaded = false;
 
 	l2_valid = false;
 
@@ -107,8 +110,61 @@ int Packet::GetLinkHeaderSize(int link_type)
 	return -1;
 	}
 
+bool Packet::ProcessCanonicalLayer2()
+	{
+	// Init() has already made sure that the link-layer header is there.
+	switch ( link_type ) {
+	case DLT_EN10MB:
+		{
+		int protocol = (data[12] << 8) + data[13];
+
+		if ( protocol == 0x800 )
+			l3_proto = L3_IPV4;
+		else if ( protocol == 0x86dd )
+			l3_proto = L3_IPV6;
+		else
+			// VLAN, MPLS, PPPoE, FabricPath, ARP, ...
+			return false;
+
+		eth_type = protocol;
+		l2_dst = data;
+		l2_src = data + 6;
+		break;
+		}
+
+	case DLT_RAW:
+		{
+		if ( cap_len <= sizeof(struct ip) )
+			return false;
+
+		int version = data[0] >> 4;
+
+		if ( version == 4 )
+			l3_proto = L3_IPV4;
+		else if ( version == 6 )
+			l3_proto = L3_IPV6;
+		else
+			return false;
+
+		break;
+		}
+
+	default:
+		return false;
+	}
+
+	// hdr_size already is the link type's header size.
+	l2_valid = true;
+	return true;
+	}
+
 void Packet::ProcessLayer2()
 	{
+	// Most traffic is IP directly on top of the link layer. Handle that
+	// without going through the generic decoding below.
+	if ( ! encap_hdr_size && ProcessCanonicalLayer2() )
+		return;
+
 	l2_valid = true;
 
 	// Unfortunately some packets on the link might have MPLS labels
@@ -580,6 +636,107 @@ void Packet::ProcessLayer2()
 	hdr_size = (pdata - data);
 }
 
+// Mixes a 32-bit word into a running hash (the MurmurHash3 block step).
+static inline uint32 mix_flow_hash(uint32 h, uint32 k)
+	{
+	k *= 0xcc9e2d51;
+	k = (k << 15) | (k >> 17);
+	k *= 0x1b873593;
+
+	h ^= k;
+	h = (h << 13) | (h >> 19);
+	return h * 5 + 0xe6546b64;
+	}
+
+static inline uint32 load_flow_word(const u_char* p)
+	{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+	}
+
+uint32 Packet::FlowHash(bool include_ports) const
+	{
+	if ( ! l2_valid || (l3_proto != L3_IPV4 && l3_proto != L3_IPV6) )
+		return 0;
+
+	const u_char* l3 = data + hdr_size;
+	const u_char* end_of_data = data + cap_len;
+
+	const u_char* a;
+	const u_char* b;
+	int addr_len;
+	int proto;
+	const u_char* l4 = 0;
+
+	if ( l3_proto == L3_IPV4 )
+		{
+		if ( l3 + 20 > end_of_data )
+			return 0;
+
+		a = l3 + 12;
+		b = l3 + 16;
+		addr_len = 4;
+		proto = l3[9];
+
+		int ihl = (l3[0] & 0x0f) * 4;
+		bool fragment = ((l3[6] << 8) | l3[7]) & 0x3fff;
+
+		if ( ! fragment )
+			l4 = l3 + ihl;
+		}
+	else
+		{
+		if ( l3 + 40 > end_of_data )
+			return 0;
+
+		a = l3 + 8;
+		b = l3 + 24;
+		addr_len = 16;
+		proto = l3[6];
+
+		// We don't walk extension headers here; packets carrying any
+		// fall back to their addresses.
+		l4 = l3 + 40;
+		}
+
+	// Order the endpoints so that both directions hash the same.
+	int cmp = memcmp(a, b, addr_len);
+	bool swap = (cmp > 0);
+
+	if ( swap )
+		std::swap(a, b);
+
+	uint32 h = 0x5a6b;
+
+	for ( int i = 0; i < addr_len; i += 4 )
+		h = mix_flow_hash(h, load_flow_word(a + i));
+
+	for ( int i = 0; i < addr_len; i += 4 )
+		h = mix_flow_hash(h, load_flow_word(b + i));
+
+	if ( include_ports && l4 && l4 + 4 <= end_of_data &&
+	     (proto == IPPROTO_TCP || proto == IPPROTO_UDP || proto == 132 /* SCTP */) )
+		{
+		uint32 sport = (l4[0] << 8) | l4[1];
+		uint32 dport = (l4[2] << 8) | l4[3];
+
+		// With equal addresses, order by port instead.
+		if ( cmp == 0 ? sport > dport : swap )
+			std::swap(sport, dport);
+
+		h = mix_flow_hash(h, (sport << 16) | dport);
+		h = mix_flow_hash(h, proto);
+		}
+
+	// Final avalanche.
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+
+	return h;
+	}
+
 RecordVal* Packet::BuildPktHdrVal() const
 	{
 	RecordVal* pkt_hdr = new RecordVal(raw_pkt_hdr_type);
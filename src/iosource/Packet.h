@@ -117,6 +117,19 @@ public:
 	const IP_Hdr IP() const
 		{ return IP_Hdr((struct ip *) (data + hdr_size), false); }
 
+	/**
+	 * Computes a hash over the packet's IP addresses that is the same
+	 * for both directions of a flow. Optionally, the transport-layer
+	 * ports of TCP, UDP and SCTP packets are included as well, except
+	 * for fragments and IPv6 packets carrying extension headers, which
+	 * are hashed by their addresses only.
+	 *
+	 * @param include_ports True to include ports where available.
+	 *
+	 * @return The hash, or zero if the packet isn't IP.
+	 */
+	uint32 FlowHash(bool include_ports) const;
+
 	/**
 	 * Returns a \c raw_pkt_hdr RecordVal, which includes layer 2 and
 	 * also everything in IP_Hdr (i.e., IP4/6 + TCP/UDP/ICMP).
@@ -195,10 +208,39 @@ public:
 	 */
 	uint32 inner_vlan;
 
+	// These are optionally filled in by packet sources after calling
+	// Init(), which resets them.
+
+	/**
+	 * A flow hash computed by the capture hardware or kernel (e.g.,
+	 * for receive-side scaling), if the packet source provides one.
+	 * Note that such hashes are generally not the same for both
+	 * directions of a flow. Zero if not available.
+	 */
+	uint32 rx_hash;
+
+	/**
+	 * True if *ts* was taken by the NIC rather than by the kernel or
+	 * the capture library.
+	 */
+	bool hw_timestamp;
+
+	/**
+	 * True if the NIC or kernel takes care of the transport-layer
+	 * checksum: either it has already verified it, or it will only
+	 * fill it in later (for packets sent by this host).
+	 */
+	bool checksum_offloaded;
+
 private:
 	// Calculate layer 2 attributes. Sets
 	void ProcessLayer2();
 
+	// Fast path for ProcessLayer2() covering plain Ethernet and raw
+	// frames that directly carry IPv4 or IPv6. Returns false, without
+	// having changed any state, if the packet needs the generic path.
+	bool ProcessCanonicalLayer2();
+
 	// Wrapper to generate a packet-level weird.
 	void Weird(const char* name);
 
@@ -3,13 +3,17 @@
 #include <errno.h>
 #include <sys/stat.h>
 
+#include <set>
+
 #include "zeek-config.h"
 
 #include "util.h"
 #include "PktSrc.h"
+#include "Handoff.h"
 #include "Hash.h"
 #include "Net.h"
 #include "Sessions.h"
+#include "Stats.h"
 #include "broker/Manager.h"
 #include "iosource/Manager.h"
 
@@ -23,11 +27,15 @@ PktSrc::Properties::Properties()
 	link_type = -1;
 	netmask = NETMASK_UNKNOWN;
 	is_live = false;
+	batch_capable = false;
 	}
 
 PktSrc::PktSrc()
 	{
 	have_packet = false;
+	batch = 0;
+	batch_size = batch_count = batch_pos = 0;
+	current_batch_packet = 0;
 	errbuf = "";
 	SetClosed(true);
 
@@ -39,8 +47,10 @@ PktSrc::PktSrc()
 
 PktSrc::~PktSrc()
 	{
-	for ( auto code : filters )
-		delete code;
+	for ( auto& f : compiled_filters )
+		delete f.second;
+
+	delete [] batch;
 	}
 
 const std::string& PktSrc::Path() const
@@ -100,8 +110,18 @@ void PktSrc::Opened(const Properties& arg_props)
 		return;
 		}
 
+	if ( BifConst::Pcap::flow_shards > 1 &&
+	     BifConst::Pcap::flow_shard >= BifConst::Pcap::flow_shards )
+		{
+		Error(fmt("flow shard %" PRIu64 " out of range for %" PRIu64 " shards",
+			  BifConst::Pcap::flow_shard, BifConst::Pcap::flow_shards));
+		Close();
+		return;
+		}
+
 	props = arg_props;
 	SetClosed(false);
+	FdsChanged();
 
 	if ( ! PrecompileFilter(0, "") || ! SetFilter(0) )
 		{
@@ -118,6 +138,7 @@ void PktSrc::Opened(const Properties& arg_props)
 void PktSrc::Closed()
 	{
 	SetClosed(true);
+	FdsChanged();
 
 	DBG_LOG(DBG_PKTIO, "Closed source %s", props.path.c_str());
 	}
@@ -173,6 +194,12 @@ void PktSrc::Init()
 
 void PktSrc::Done()
 	{
+	if ( batch_count )
+		{
+		batch_count = batch_pos = 0;
+		DoneWithPacketBatch();
+		}
+
 	if ( IsOpen() )
 		Close();
 	}
@@ -183,8 +210,10 @@ void PktSrc::GetFds(iosource::FD_Set* read, iosource::FD_Set* write,
 	if ( pseudo_realtime )
 		{
 		// Select would give erroneous results. But we simulate it
-		// by setting idle accordingly.
+		// by setting idle accordingly, which means we need to get
+		// asked again each time.
 		SetIdle(CheckPseudoTime() == 0);
+		FdsChanged();
 		return;
 		}
 
@@ -209,6 +238,9 @@ double PktSrc::NextTimestamp(double* local_network_time)
 	if ( ! IsOpen() )
 		return -1.0;
 
+	if ( ! have_packet && UseBatching() )
+		return ExtractPacketBatchInternal() ? batch[batch_pos].time : -1.0;
+
 	if ( ! ExtractNextPacketInternal() )
 		return -1.0;
 
@@ -231,6 +263,12 @@ void PktSrc::Process()
 	if ( ! IsOpen() )
 		return;
 
+	if ( ! have_packet && UseBatching() )
+		{
+		ProcessBatch();
+		return;
+		}
+
 	if ( ! ExtractNextPacketInternal() )
 		return;
 
@@ -275,14 +313,25 @@ bool PktSrc::ExtractNextPacketInternal()
 	if ( pseudo_realtime )
 		current_wallclock = current_time(true);
 
-	if ( ExtractNextPacket(&current_packet) )
+	uint64 start = PipelineStats::Now();
+
+	while ( ExtractNextPacket(&current_packet) )
 		{
+		pipeline_stats.Record(PipelineStats::CAPTURE, PipelineStats::Now() - start);
+
 		if ( current_packet.time < 0 )
 			{
 			Weird("negative_packet_timestamp", &current_packet);
 			return 0;
 			}
 
+		if ( ! InShard(&current_packet) )
+			{
+			DoneWithPacket();
+			start = PipelineStats::Now();
+			continue;
+			}
+
 		if ( ! first_timestamp )
 			first_timestamp = current_packet.time;
 
@@ -301,11 +350,133 @@ bool PktSrc::ExtractNextPacketInternal()
 	return 0;
 	}
 
+bool PktSrc::InShard(const Packet* pkt) const
+	{
+	uint64 shards = BifConst::Pcap::flow_shards;
+
+	if ( shards <= 1 )
+		return true;
+
+	uint64 shard = pkt->FlowHash(BifConst::Pcap::flow_shard_ports) % shards;
+
+	if ( shard == BifConst::Pcap::flow_shard )
+		return true;
+
+	// Packets handed to us are ours by construction, unless the
+	// processes disagree on the sharding.
+	if ( packet_handoff && packet_handoff != this )
+		packet_handoff->Forward(pkt, shard);
+
+	return false;
+	}
+
+bool PktSrc::UseBatching() const
+	{
+	// With a batch pending, the main loop doesn't get to pick the source
+	// with the soonest packet for each packet anymore. We thus only batch
+	// if there's no other packet source to interleave with.
+	return props.batch_capable && ! pseudo_realtime &&
+		BifConst::Pcap::batch_size > 1 &&
+		iosource_mgr->GetPktSrcs().size() == 1;
+	}
+
+bool PktSrc::ExtractPacketBatchInternal()
+	{
+	if ( batch_pos < batch_count )
+		return true;
+
+	if ( batch_count )
+		{
+		batch_count = batch_pos = 0;
+		DoneWithPacketBatch();
+		}
+
+	// Same as in ExtractNextPacketInternal().
+	if ( net_is_processing_suspended() && first_timestamp )
+		{
+		SetIdle(true);
+		return false;
+		}
+
+	if ( ! batch )
+		{
+		batch_size = BifConst::Pcap::batch_size;
+		batch = new Packet[batch_size];
+		}
+
+	uint64 start = PipelineStats::Now();
+	batch_count = ExtractPacketBatch(batch, batch_size);
+	pipeline_stats.Record(PipelineStats::CAPTURE, PipelineStats::Now() - start, batch_count);
+
+	if ( ! batch_count )
+		{
+		SetIdle(true);
+		return false;
+		}
+
+	if ( ! first_timestamp )
+		first_timestamp = batch[0].time;
+
+	SetIdle(false);
+	return true;
+	}
+
+void PktSrc::ProcessBatch()
+	{
+	if ( ! ExtractPacketBatchInternal() )
+		return;
+
+	while ( batch_pos < batch_count )
+		{
+		// Scripts may suspend processing from inside an event handler;
+		// leave the rest of the batch pending in that case.
+		if ( net_is_processing_suspended() )
+			break;
+
+		sessions->PrefetchConns(batch, batch_count, batch_pos);
+
+		Packet* pkt = &batch[batch_pos++];
+
+		if ( pkt->time < 0 )
+			{
+			Weird("negative_packet_timestamp", pkt);
+			continue;
+			}
+
+		if ( ! pkt->Layer2Valid() || ! InShard(pkt) )
+			continue;
+
+		current_batch_packet = pkt;
+		net_packet_dispatch(pkt->time, pkt, this);
+		current_batch_packet = 0;
+		}
+
+	if ( batch_pos >= batch_count )
+		{
+		batch_count = batch_pos = 0;
+		DoneWithPacketBatch();
+		}
+	}
+
 bool PktSrc::PrecompileBPFFilter(int index, const std::string& filter)
 	{
 	if ( index < 0 )
 		return false;
 
+	// Store it in vector.
+	if ( index >= static_cast<int>(filters.size()) )
+		filters.resize(index + 1);
+
+	// Scripts tend to compile the same filters over and over again, so
+	// reuse what we've already compiled.
+	auto cached = compiled_filters.find(filter);
+
+	if ( cached != compiled_filters.end() )
+		{
+		filters[index] = cached->second;
+		return true;
+		}
+
 	char errbuf[PCAP_ERRBUF_SIZE];
 
 	// Compile filter.
@@ -324,18 +495,32 @@ bool PktSrc::PrecompileBPFFilter(int index, const std::string& filter)
 		return 0;
 		}
 
-	// Store it in vector.
-	if ( index >= static_cast<int>(filters.size()) )
-		filters.resize(index + 1);
-
-	if ( auto old = filters[index] )
-		delete old;
-
 	filters[index] = code;
+	compiled_filters[filter] = code;
+
+	if ( compiled_filters.size() > MAX_CACHED_FILTERS )
+		PruneFilterCache();
 
 	return true;
 	}
 
+void PktSrc::PruneFilterCache()
+	{
+	std::set<BPF_Program*> in_use(filters.begin(), filters.end());
+
+	for ( auto i = compiled_filters.begin(); i != compiled_filters.end(); )
+		{
+		if ( in_use.find(i->second) != in_use.end() )
+			{
+			++i;
+			continue;
+			}
+
+		delete i->second;
+		i = compiled_filters.erase(i);
+		}
+	}
+
 BPF_Program* PktSrc::GetBPFFilter(int index)
 	{
 	if ( index < 0 )
@@ -363,6 +548,12 @@ bool PktSrc::ApplyBPFFilter(int index, const struct pcap_pkthdr *hdr, const u_ch
 
 bool PktSrc::GetCurrentPacket(const Packet** pkt)
 	{
+	if ( current_batch_packet )
+		{
+		*pkt = current_batch_packet;
+		return true;
+		}
+
 	if ( ! have_packet )
 		return false;
 
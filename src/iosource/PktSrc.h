@@ -3,6 +3,7 @@
 #ifndef IOSOURCE_PKTSRC_PKTSRC_H
 #define IOSOURCE_PKTSRC_PKTSRC_H
 
+#include <map>
 #include <vector>
 
 #include "IOSource.h"
@@ -244,6 +245,11 @@ protected:
 		 */
 		bool is_live;
 
+		/**
+		 * True if the source implements \a ExtractPacketBatch().
+		 */
+		bool batch_capable;
+
 		Properties();
 	};
 
@@ -334,6 +340,36 @@ protected:
 	 */
 	virtual void DoneWithPacket() = 0;
 
+	/**
+	 * Provides a batch of packets from the source at once. Sources that
+	 * can hand out several packets per underlying operation (e.g., via
+	 * \c pcap_dispatch() or a memory-mapped ring) can override this to
+	 * amortize per-packet overhead in the main loop. Sources that do so
+	 * must also set \a Properties::batch_capable. The default
+	 * implementation doesn't provide any packets.
+	 *
+	 * @param out An array of at least *max* packets to fill in. As with
+	 * \a ExtractNextPacket(), the callee keeps ownership of the data
+	 * but must guarantee that it stays available until \a
+	 * DoneWithPacketBatch() is called. It is guaranteed that no two
+	 * calls to this method will happen without \a DoneWithPacketBatch()
+	 * in between, and that it won't be mixed with \a
+	 * ExtractNextPacket() while a batch is outstanding.
+	 *
+	 * @param max The maximum number of packets to return.
+	 *
+	 * @return The number of packets filled in, which will be zero if no
+	 * packet is available or an error occured (which must be flagged
+	 * via Error()).
+	 */
+	virtual size_t ExtractPacketBatch(Packet* out, size_t max)	{ return 0; }
+
+	/**
+	 * Signals that the data of all packets returned by the previous
+	 * call to \a ExtractPacketBatch() will no longer be needed.
+	 */
+	virtual void DoneWithPacketBatch()	{ }
+
 private:
 	// Checks if the current packet has a pseudo-time <= current_time. If
 	// yes, returns pseudo-time, otherwise 0.
@@ -342,6 +378,22 @@ private:
 	// Internal helper for ExtractNextPacket().
 	bool ExtractNextPacketInternal();
 
+	// Returns true if the packet belongs to the flow shard this process
+	// is configured to analyze. If not, hands it off to the process
+	// analyzing its shard, if there's a handoff.
+	bool InShard(const Packet* pkt) const;
+
+	// Returns true if packets should be retrieved through
+	// ExtractPacketBatch().
+	bool UseBatching() const;
+
+	// Internal helper for ExtractPacketBatch(). Returns true if there's
+	// at least one packet pending in the current batch.
+	bool ExtractPacketBatchInternal();
+
+	// Dispatches all pending packets of the current batch.
+	void ProcessBatch();
+
 	// IOSource interface implementation.
 	void Init() override;
 	void Done() override;
@@ -356,8 +408,23 @@ private:
 	bool have_packet;
 	Packet current_packet;
 
-	// For BPF filtering support.
+	// For batched packet extraction.
+	Packet* batch;
+	size_t batch_size;
+	size_t batch_count;
+	size_t batch_pos;
+	const Packet* current_batch_packet;
+
+	// Drops cached filters that no index refers to anymore.
+	void PruneFilterCache();
+
+	// For BPF filtering support. The programs are owned by the cache,
+	// keyed by filter text; an entry may be bound to several indices.
 	std::vector<BPF_Program *> filters;
+	std::map<std::string, BPF_Program *> compiled_filters;
+
+	// Beyond this many cached filters, we remove those not in use.
+	static const size_t MAX_CACHED_FILTERS = 32;
 
 	// Only set in pseudo-realtime mode.
 	double first_timestamp;
@@ -0,0 +1,200 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Poller.h"
+#include "DebugLogger.h"
+
+using namespace iosource;
+
+Poller::Poller()
+	{
+#if defined(IOSOURCE_USE_EPOLL)
+	poll_fd = epoll_create1(EPOLL_CLOEXEC);
+#elif defined(IOSOURCE_USE_KQUEUE)
+	poll_fd = kqueue();
+#else
+	poll_fd = -1;
+#endif
+
+	if ( poll_fd < 0 )
+		DBG_LOG(DBG_MAINLOOP, "no readiness notification backend, using select()");
+	}
+
+Poller::~Poller()
+	{
+	if ( poll_fd >= 0 )
+		close(poll_fd);
+	}
+
+const char* Poller::Backend() const
+	{
+	if ( poll_fd < 0 )
+		return "select";
+
+#if defined(IOSOURCE_USE_EPOLL)
+	return "epoll";
+#elif defined(IOSOURCE_USE_KQUEUE)
+	return "kqueue";
+#else
+	return "select";
+#endif
+	}
+
+bool Poller::Update(int fd, int mask)
+	{
+	if ( poll_fd < 0 )
+		return false;
+
+	std::map<int, int>::iterator i = masks.find(fd);
+	int old_mask = (i != masks.end() ? i->second : 0);
+
+	if ( old_mask == mask )
+		return true;
+
+	if ( always_ready.find(fd) != always_ready.end() )
+		{
+		// Not known to the backend, just track the mask.
+		if ( mask )
+			masks[fd] = mask;
+		else
+			{
+			masks.erase(fd);
+			always_ready.erase(fd);
+			}
+
+		return true;
+		}
+
+#if defined(IOSOURCE_USE_EPOLL)
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.data.fd = fd;
+
+	if ( mask & READ )
+		ev.events |= EPOLLIN;
+	if ( mask & WRITE )
+		ev.events |= EPOLLOUT;
+	if ( mask & EXCEPT )
+		ev.events |= EPOLLPRI;
+
+	int op = (! old_mask ? EPOLL_CTL_ADD : (mask ? EPOLL_CTL_MOD : EPOLL_CTL_DEL));
+
+	int rc = epoll_ctl(poll_fd, op, fd, &ev);
+
+	// A descriptor that got closed and reused in between has silently
+	// dropped out of the epoll set.
+	if ( rc < 0 && op == EPOLL_CTL_MOD && errno == ENOENT )
+		rc = epoll_ctl(poll_fd, EPOLL_CTL_ADD, fd, &ev);
+
+	if ( rc < 0 && op == EPOLL_CTL_DEL && (errno == ENOENT || errno == EBADF) )
+		rc = 0;
+
+	if ( rc < 0 )
+		{
+		if ( op == EPOLL_CTL_ADD && errno == EPERM )
+			{
+			// Regular files and the like; select() reports them
+			// as ready all the time.
+			always_ready.insert(fd);
+			masks[fd] = mask;
+			return true;
+			}
+
+		DBG_LOG(DBG_MAINLOOP, "epoll_ctl for fd %d failed: %s", fd, strerror(errno));
+		return false;
+		}
+
+#elif defined(IOSOURCE_USE_KQUEUE)
+	struct kevent changes[2];
+	int n = 0;
+
+	// kqueue has no separate notion of exceptional conditions; they
+	// are signaled through the read filter.
+	bool old_read = old_mask & (READ | EXCEPT);
+	bool new_read = mask & (READ | EXCEPT);
+	bool old_write = old_mask & WRITE;
+	bool new_write = mask & WRITE;
+
+	if ( old_read != new_read )
+		EV_SET(&changes[n++], fd, EVFILT_READ, new_read ? EV_ADD : EV_DELETE, 0, 0, 0);
+
+	if ( old_write != new_write )
+		EV_SET(&changes[n++], fd, EVFILT_WRITE, new_write ? EV_ADD : EV_DELETE, 0, 0, 0);
+
+	if ( n && kevent(poll_fd, changes, n, 0, 0, 0) < 0 )
+		{
+		DBG_LOG(DBG_MAINLOOP, "kevent for fd %d failed: %s", fd, strerror(errno));
+		return false;
+		}
+#endif
+
+	if ( mask )
+		masks[fd] = mask;
+	else
+		masks.erase(fd);
+
+	return true;
+	}
+
+int Poller::Poll(ReadySet* ready)
+	{
+	ready->clear();
+
+	if ( poll_fd < 0 )
+		return -1;
+
+	for ( std::set<int>::const_iterator i = always_ready.begin();
+	      i != always_ready.end(); ++i )
+		(*ready)[*i] = masks[*i];
+
+	if ( masks.size() > always_ready.size() )
+		{
+#if defined(IOSOURCE_USE_EPOLL)
+		events.resize(masks.size());
+
+		int n = epoll_wait(poll_fd, events.data(), events.size(), 0);
+
+		if ( n < 0 )
+			return errno == EINTR ? ready->size() : -1;
+
+		for ( int i = 0; i < n; ++i )
+			{
+			int mask = 0;
+
+			if ( events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR) )
+				mask |= READ;
+			if ( events[i].events & EPOLLOUT )
+				mask |= WRITE;
+			if ( events[i].events & EPOLLPRI )
+				mask |= EXCEPT;
+
+			(*ready)[events[i].data.fd] |= mask;
+			}
+
+#elif defined(IOSOURCE_USE_KQUEUE)
+		// Each descriptor may have up to two filters registered.
+		events.resize(masks.size() * 2);
+
+		struct timespec timeout = { 0, 0 };
+		int n = kevent(poll_fd, 0, 0, events.data(), events.size(), &timeout);
+
+		if ( n < 0 )
+			return errno == EINTR ? ready->size() : -1;
+
+		for ( int i = 0; i < n; ++i )
+			{
+			int fd = events[i].ident;
+
+			if ( events[i].filter == EVFILT_READ )
+				(*ready)[fd] |= (masks[fd] & (READ | EXCEPT));
+			else if ( events[i].filter == EVFILT_WRITE )
+				(*ready)[fd] |= WRITE;
+			}
+#endif
+		}
+
+	return ready->size();
+	}
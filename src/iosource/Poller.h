@@ -0,0 +1,108 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef IOSOURCE_POLLER_H
+#define IOSOURCE_POLLER_H
+
+#include "zeek-config.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+#if defined(HAVE_LINUX)
+#define IOSOURCE_USE_EPOLL
+#include <sys/epoll.h>
+#elif defined(HAVE_DARWIN) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+#define IOSOURCE_USE_KQUEUE
+#include <sys/types.h>
+#include <sys/event.h>
+#endif
+
+namespace iosource {
+
+/**
+ * A thin wrapper around the platform's persistent readiness notification
+ * mechanism (epoll on Linux, kqueue on BSD and macOS). File descriptors
+ * are registered once and remain so until explicitly updated, so that
+ * polling costs scale with the number of ready descriptors rather than
+ * with the number of registered ones.
+ *
+ * On platforms without either mechanism, IsValid() returns false and the
+ * caller is expected to fall back to select().
+ */
+class Poller {
+public:
+	static const int READ = 0x1;	///< Interest in readability.
+	static const int WRITE = 0x2;	///< Interest in writability.
+	static const int EXCEPT = 0x4;	///< Interest in exceptional conditions.
+
+	/**
+	 * Maps ready file descriptors to the conditions they are ready for.
+	 */
+	typedef std::map<int, int> ReadySet;
+
+	/**
+	 * Constructor.
+	 */
+	Poller();
+
+	/**
+	 * Destructor.
+	 */
+	~Poller();
+
+	/**
+	 * Returns true if a notification backend is available and has been
+	 * set up successfully.
+	 */
+	bool IsValid() const	{ return poll_fd >= 0; }
+
+	/**
+	 * Returns the name of the backend in use, for debugging.
+	 */
+	const char* Backend() const;
+
+	/**
+	 * Sets the conditions of interest for a file descriptor, replacing
+	 * any earlier registration.
+	 *
+	 * @param fd The file descriptor.
+	 *
+	 * @param mask A combination of READ, WRITE and EXCEPT. Zero removes
+	 * the descriptor.
+	 *
+	 * @return False if the backend rejected the registration.
+	 */
+	bool Update(int fd, int mask);
+
+	/**
+	 * Checks which of the registered descriptors are ready, without
+	 * blocking.
+	 *
+	 * @param ready Set to fill with ready descriptors; it's cleared
+	 * first.
+	 *
+	 * @return The number of ready descriptors, or -1 on error.
+	 */
+	int Poll(ReadySet* ready);
+
+private:
+	int poll_fd;
+
+	// Currently registered interest per descriptor.
+	std::map<int, int> masks;
+
+	// Descriptors the backend doesn't support (e.g., regular files with
+	// epoll). Like select() does, we report them as always ready.
+	std::set<int> always_ready;
+
+#if defined(IOSOURCE_USE_EPOLL)
+	std::vector<struct epoll_event> events;
+#elif defined(IOSOURCE_USE_KQUEUE)
+	std::vector<struct kevent> events;
+#endif
+};
+
+}
+
+#endif
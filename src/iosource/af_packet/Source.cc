@@ -0,0 +1,532 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <net/ethernet.h>
+#include <arpa/inet.h>
+
+extern "C" {
+#include <linux/filter.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+}
+
+#include "Source.h"
+#include "iosource/Packet.h"
+
+#include "af_packet.bif.h"
+
+using namespace iosource::af_packet;
+
+// Size of a single frame slot inside a block. The kernel packs frames of
+// variable size into TPACKET_V3 blocks; this only bounds the largest
+// frame we accept.
+static const unsigned int AF_PACKET_FRAME_SIZE = TPACKET_ALIGN(9216 + TPACKET3_HDRLEN);
+
+AF_PacketSource::~AF_PacketSource()
+	{
+	Close();
+	}
+
+AF_PacketSource::AF_PacketSource(const std::string& path, bool is_live)
+	{
+	props.path = path;
+	props.is_live = is_live;
+	fd = -1;
+	ifindex = 0;
+	ring = 0;
+	ring_size = 0;
+	memset(&req, 0, sizeof(req));
+	current_block = 0;
+	current_block_idx = 0;
+	packets_left = 0;
+	current_frame = 0;
+	in_batch = false;
+	deferred_block = 0;
+	userspace_filter = -1;
+	kernel_dropped = kernel_received = 0;
+	}
+
+void AF_PacketSource::Open()
+	{
+	if ( props.path.empty() )
+		{
+		Error("af_packet: no interface given");
+		return;
+		}
+
+	ifindex = if_nametoindex(props.path.c_str());
+
+	if ( ! ifindex )
+		{
+		Error(fmt("af_packet: unknown interface %s", props.path.c_str()));
+		return;
+		}
+
+	fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+
+	if ( fd < 0 )
+		{
+		SocketError("socket");
+		return;
+		}
+
+	int version = TPACKET_V3;
+
+	if ( setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0 )
+		{
+		SocketError("PACKET_VERSION");
+		return;
+		}
+
+	if ( ! SetupRing() )
+		return;
+
+	if ( ! BindInterface() )
+		return;
+
+	if ( ! EnablePromiscMode() )
+		return;
+
+	if ( BifConst::AF_Packet::enable_fanout && ! ConfigureFanout() )
+		return;
+
+	if ( BifConst::AF_Packet::enable_hw_timestamping )
+		EnableHWTimestamping();
+
+	props.selectable_fd = fd;
+	props.link_type = DLT_EN10MB;
+	props.netmask = NETMASK_UNKNOWN;
+	props.is_live = true;
+	props.batch_capable = true;
+
+	Opened(props);
+	}
+
+bool AF_PacketSource::SetupRing()
+	{
+	long page_size = sysconf(_SC_PAGESIZE);
+	unsigned int block_size = BifConst::AF_Packet::block_size;
+
+	// Blocks must be a multiple of the page size and large enough for
+	// at least one maximum-sized frame.
+	if ( block_size < AF_PACKET_FRAME_SIZE )
+		block_size = AF_PACKET_FRAME_SIZE;
+
+	block_size = (block_size + page_size - 1) / page_size * page_size;
+
+	unsigned int block_nr = BifConst::AF_Packet::buffer_size / block_size;
+
+	if ( block_nr < 2 )
+		block_nr = 2;
+
+	req.tp_block_size = block_size;
+	req.tp_block_nr = block_nr;
+	req.tp_frame_size = AF_PACKET_FRAME_SIZE;
+	req.tp_frame_nr = (block_size / AF_PACKET_FRAME_SIZE) * block_nr;
+	req.tp_retire_blk_tov = static_cast<unsigned int>(BifConst::AF_Packet::block_timeout * 1000);
+	req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+
+	if ( setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0 )
+		{
+		SocketError("PACKET_RX_RING");
+		return false;
+		}
+
+	ring_size = static_cast<size_t>(req.tp_block_size) * req.tp_block_nr;
+	void* m = mmap(0, ring_size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_LOCKED | MAP_POPULATE, fd, 0);
+
+	if ( m == MAP_FAILED )
+		{
+		// MAP_LOCKED may fail due to RLIMIT_MEMLOCK; retry without.
+		m = mmap(0, ring_size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, fd, 0);
+
+		if ( m == MAP_FAILED )
+			{
+			ring_size = 0;
+			SocketError("mmap");
+			return false;
+			}
+		}
+
+	ring = reinterpret_cast<u_char*>(m);
+	current_block_idx = 0;
+	current_block = 0;
+	packets_left = 0;
+	return true;
+	}
+
+bool AF_PacketSource::BindInterface()
+	{
+	struct sockaddr_ll saddr;
+	memset(&saddr, 0, sizeof(saddr));
+	saddr.sll_family = AF_PACKET;
+	saddr.sll_protocol = htons(ETH_P_ALL);
+	saddr.sll_ifindex = ifindex;
+
+	if ( bind(fd, reinterpret_cast<struct sockaddr*>(&saddr), sizeof(saddr)) < 0 )
+		{
+		SocketError("bind");
+		return false;
+		}
+
+	return true;
+	}
+
+bool AF_PacketSource::EnablePromiscMode()
+	{
+	struct packet_mreq mreq;
+	memset(&mreq, 0, sizeof(mreq));
+	mreq.mr_ifindex = ifindex;
+	mreq.mr_type = PACKET_MR_PROMISC;
+
+	if ( setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0 )
+		{
+		SocketError("PACKET_ADD_MEMBERSHIP");
+		return false;
+		}
+
+	return true;
+	}
+
+bool AF_PacketSource::ConfigureFanout()
+	{
+	uint32 fanout_arg = (BifConst::AF_Packet::fanout_id & 0xffff) |
+			    ((PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG) << 16);
+
+	if ( setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof(fanout_arg)) < 0 )
+		{
+		SocketError("PACKET_FANOUT");
+		return false;
+		}
+
+	return true;
+	}
+
+void AF_PacketSource::EnableHWTimestamping()
+	{
+	// Ask the driver to timestamp all incoming packets. This affects the
+	// whole interface, not just our socket.
+	struct hwtstamp_config cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.tx_type = HWTSTAMP_TX_OFF;
+	cfg.rx_filter = HWTSTAMP_FILTER_ALL;
+
+	struct ifreq ifr;
+	memset(&ifr, 0, sizeof(ifr));
+	safe_strncpy(ifr.ifr_name, props.path.c_str(), sizeof(ifr.ifr_name));
+	ifr.ifr_data = reinterpret_cast<char*>(&cfg);
+
+	if ( ioctl(fd, SIOCSHWTSTAMP, &ifr) < 0 )
+		{
+		Info(fmt("af_packet: %s: no hardware timestamping, using software timestamps (%s)",
+			 props.path.c_str(), strerror(errno)));
+		return;
+		}
+
+	// And have the ring report the hardware timestamps.
+	int req = SOF_TIMESTAMPING_RAW_HARDWARE;
+
+	if ( setsockopt(fd, SOL_PACKET, PACKET_TIMESTAMP, &req, sizeof(req)) < 0 )
+		Info(fmt("af_packet: %s: cannot enable PACKET_TIMESTAMP, using software timestamps (%s)",
+			 props.path.c_str(), strerror(errno)));
+	}
+
+void AF_PacketSource::Close()
+	{
+	if ( fd < 0 )
+		return;
+
+	if ( ring )
+		munmap(ring, ring_size);
+
+	close(fd);
+
+	fd = -1;
+	ring = 0;
+	ring_size = 0;
+	current_block = 0;
+	current_frame = 0;
+	packets_left = 0;
+	deferred_block = 0;
+
+	Closed();
+	}
+
+bool AF_PacketSource::ExtractNextPacket(Packet* pkt)
+	{
+	if ( ! ring )
+		return false;
+
+	while ( true )
+		{
+		if ( ! current_block )
+			{
+			if ( deferred_block )
+				// Part of the current batch still lives in there.
+				return false;
+
+			struct tpacket_block_desc* block =
+				reinterpret_cast<struct tpacket_block_desc*>(ring + current_block_idx * req.tp_block_size);
+
+			if ( ! (__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) )
+				// Kernel hasn't retired the next block yet.
+				return false;
+
+			current_block = block;
+			packets_left = block->hdr.bh1.num_pkts;
+			current_frame = reinterpret_cast<struct tpacket3_hdr*>(
+				reinterpret_cast<u_char*>(block) + block->hdr.bh1.offset_to_first_pkt);
+
+			if ( ! packets_left )
+				{
+				ReleaseBlock();
+				continue;
+				}
+			}
+
+		if ( current_frame->tp_len == 0 || current_frame->tp_snaplen == 0 )
+			{
+			// Skip the frame; we won't see a DoneWithPacket() for it.
+			DoneWithPacket();
+			continue;
+			}
+
+		if ( userspace_filter >= 0 && ! FrameMatchesFilter() )
+			{
+			if ( fd < 0 )
+				// Filtering failed and closed the source.
+				return false;
+
+			DoneWithPacket();
+			continue;
+			}
+
+		break;
+		}
+
+	pkt_timeval ts;
+	ts.tv_sec = current_frame->tp_sec;
+	ts.tv_usec = current_frame->tp_nsec / 1000;
+
+	const u_char* data = reinterpret_cast<const u_char*>(current_frame) + current_frame->tp_mac;
+	pkt->Init(props.link_type, &ts, current_frame->tp_snaplen, current_frame->tp_len, data);
+
+	// The kernel strips the outermost VLAN tag off the frame and reports it
+	// out-of-band instead. Since we don't copy, we can't reinsert it, but
+	// we can still make it visible.
+	if ( (current_frame->tp_status & TP_STATUS_VLAN_VALID) && ! pkt->vlan )
+		pkt->vlan = current_frame->hv1.tp_vlan_tci & 0x0fff;
+
+	pkt->rx_hash = current_frame->hv1.tp_rxhash;
+	pkt->hw_timestamp = (current_frame->tp_status & TP_STATUS_TS_RAW_HARDWARE);
+
+#ifdef TP_STATUS_CSUM_VALID
+	pkt->checksum_offloaded = (current_frame->tp_status & (TP_STATUS_CSUMNOTREADY | TP_STATUS_CSUM_VALID));
+#else
+	pkt->checksum_offloaded = (current_frame->tp_status & TP_STATUS_CSUMNOTREADY);
+#endif
+
+	++stats.received;
+	stats.bytes_received += current_frame->tp_len;
+
+	return true;
+	}
+
+bool AF_PacketSource::FrameMatchesFilter()
+	{
+	struct pcap_pkthdr hdr;
+	hdr.ts.tv_sec = current_frame->tp_sec;
+	hdr.ts.tv_usec = current_frame->tp_nsec / 1000;
+	hdr.caplen = current_frame->tp_snaplen;
+	hdr.len = current_frame->tp_len;
+
+	const u_char* data = reinterpret_cast<const u_char*>(current_frame) + current_frame->tp_mac;
+	return ApplyBPFFilter(userspace_filter, &hdr, data);
+	}
+
+void AF_PacketSource::DoneWithPacket()
+	{
+	if ( ! current_block )
+		return;
+
+	if ( --packets_left == 0 )
+		{
+		ReleaseBlock();
+		return;
+		}
+
+	current_frame = reinterpret_cast<struct tpacket3_hdr*>(
+		reinterpret_cast<u_char*>(current_frame) + current_frame->tp_next_offset);
+	}
+
+size_t AF_PacketSource::ExtractPacketBatch(Packet* out, size_t max)
+	{
+	size_t n = 0;
+
+	// We move past each frame right away. Once we reach the end of the
+	// block, its release gets deferred until DoneWithPacketBatch(), and
+	// ExtractNextPacket() won't move on to the next block before that.
+	in_batch = true;
+
+	while ( true )
+		{
+		while ( n < max && ExtractNextPacket(&out[n]) )
+			{
+			++n;
+			DoneWithPacket();
+			}
+
+		// With nothing extracted, there won't be a DoneWithPacketBatch()
+		// for a block we've held back, which can happen when none of
+		// its frames passed. Hand it back now and look at the next one.
+		if ( n || ! deferred_block )
+			break;
+
+		DoneWithPacketBatch();
+		}
+
+	in_batch = false;
+	return n;
+	}
+
+void AF_PacketSource::DoneWithPacketBatch()
+	{
+	if ( ! deferred_block )
+		return;
+
+	__atomic_store_n(&deferred_block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+	deferred_block = 0;
+	}
+
+void AF_PacketSource::ReleaseBlock()
+	{
+	if ( in_batch )
+		deferred_block = current_block;
+	else
+		__atomic_store_n(&current_block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+
+	current_block = 0;
+	current_frame = 0;
+	packets_left = 0;
+	current_block_idx = (current_block_idx + 1) % req.tp_block_nr;
+	}
+
+bool AF_PacketSource::PrecompileFilter(int index, const std::string& filter)
+	{
+	return PktSrc::PrecompileBPFFilter(index, filter);
+	}
+
+bool AF_PacketSource::SetFilter(int index)
+	{
+	if ( fd < 0 )
+		return true; // Prevent error message
+
+	BPF_Program* code = GetBPFFilter(index);
+
+	if ( ! code )
+		{
+		Error(fmt("No precompiled pcap filter for index %d", index));
+		return false;
+		}
+
+	userspace_filter = -1;
+
+	if ( code->MatchesAnything() )
+		return DetachFilter();
+
+	struct bpf_program* program = code->GetProgram();
+
+	// libpcap's bpf_insn has the same layout as the kernel's sock_filter.
+	struct sock_fprog fprog;
+	fprog.len = program->bf_len;
+	fprog.filter = reinterpret_cast<struct sock_filter*>(program->bf_insns);
+
+	if ( setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) < 0 )
+		{
+		if ( errno != EINVAL && errno != ENOMEM )
+			{
+			SocketError("SO_ATTACH_FILTER");
+			return false;
+			}
+
+		// The kernel refuses programs exceeding its size limits, as
+		// well as some it can't verify. Evaluate those ourselves.
+		Info(fmt("af_packet: %s: kernel rejected filter (%s), filtering in user space",
+			 props.path.c_str(), strerror(errno)));
+
+		if ( ! DetachFilter() )
+			return false;
+
+		userspace_filter = index;
+		}
+
+	return true;
+	}
+
+bool AF_PacketSource::DetachFilter()
+	{
+	// Removing a filter that was never attached fails with ENOENT,
+	// which is fine.
+	int dummy = 0;
+
+	if ( setsockopt(fd, SOL_SOCKET, SO_DETACH_FILTER, &dummy, sizeof(dummy)) < 0 &&
+	     errno != ENOENT )
+		{
+		SocketError("SO_DETACH_FILTER");
+		return false;
+		}
+
+	return true;
+	}
+
+void AF_PacketSource::Statistics(Stats* s)
+	{
+	if ( fd >= 0 )
+		{
+		struct tpacket_stats_v3 kstats;
+		socklen_t len = sizeof(kstats);
+
+		// The kernel resets its counters with each read. Its packet
+		// count includes the drops.
+		if ( getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &kstats, &len) == 0 )
+			{
+			kernel_received += kstats.tp_packets;
+			kernel_dropped += kstats.tp_drops;
+			}
+		}
+
+	s->received = stats.received;
+	s->bytes_received = stats.bytes_received;
+	s->dropped = kernel_dropped;
+	s->link = kernel_received;
+	}
+
+void AF_PacketSource::SocketError(const char* where)
+	{
+	Error(fmt("af_packet error (%s): %s", where, strerror(errno)));
+
+	if ( fd >= 0 )
+		{
+		if ( ring )
+			munmap(ring, ring_size);
+
+		close(fd);
+		fd = -1;
+		ring = 0;
+		ring_size = 0;
+		}
+	}
+
+iosource::PktSrc* AF_PacketSource::Instantiate(const std::string& path, bool is_live)
+	{
+	return new AF_PacketSource(path, is_live);
+	}
@@ -0,0 +1,86 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef IOSOURCE_PKTSRC_AF_PACKET_SOURCE_H
+#define IOSOURCE_PKTSRC_AF_PACKET_SOURCE_H
+
+extern "C" {
+#include <linux/if_packet.h>
+}
+
+#include "../PktSrc.h"
+
+namespace iosource {
+namespace af_packet {
+
+/**
+ * A live packet source reading from a Linux AF_PACKET socket with a
+ * TPACKET_V3 block ring mapped into our address space. Packets handed out
+ * point directly into the ring; a block is returned to the kernel once
+ * all of its frames have been processed.
+ */
+class AF_PacketSource : public iosource::PktSrc {
+public:
+	AF_PacketSource(const std::string& path, bool is_live);
+	~AF_PacketSource() override;
+
+	static PktSrc* Instantiate(const std::string& path, bool is_live);
+
+protected:
+	// PktSrc interface.
+	void Open() override;
+	void Close() override;
+	bool ExtractNextPacket(Packet* pkt) override;
+	void DoneWithPacket() override;
+	size_t ExtractPacketBatch(Packet* out, size_t max) override;
+	void DoneWithPacketBatch() override;
+	bool PrecompileFilter(int index, const std::string& filter) override;
+	bool SetFilter(int index) override;
+	void Statistics(Stats* stats) override;
+
+private:
+	bool BindInterface();
+	bool EnablePromiscMode();
+	bool ConfigureFanout();
+	void EnableHWTimestamping();
+	bool SetupRing();
+	void ReleaseBlock();
+	bool DetachFilter();
+	bool FrameMatchesFilter();
+	void SocketError(const char* where);
+
+	Properties props;
+	Stats stats;
+
+	int fd;
+	int ifindex;
+
+	// The memory-mapped ring.
+	u_char* ring;
+	size_t ring_size;
+	struct tpacket_req3 req;
+
+	// Block currently being walked, or null if we have to wait for the
+	// kernel to hand over the next one.
+	struct tpacket_block_desc* current_block;
+	unsigned int current_block_idx;
+	uint32 packets_left;
+	struct tpacket3_hdr* current_frame;
+
+	// While extracting a batch, a block we're done walking stays with us
+	// until the batch has been processed.
+	bool in_batch;
+	struct tpacket_block_desc* deferred_block;
+
+	// Index of the filter to apply in user space if the kernel didn't
+	// accept it, or -1.
+	int userspace_filter;
+
+	// Kernel counters are reset on each read, so we accumulate here.
+	uint64 kernel_dropped;
+	uint64 kernel_received;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,198 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "AsyncWriter.h"
+
+using namespace iosource::pcap;
+
+// How long buffered records may wait for a chunk to fill up before we
+// write them out anyway.
+static const std::chrono::milliseconds FLUSH_INTERVAL(1000);
+
+// The on-disk record header of the classic pcap format, which always uses
+// 32-bit timestamps.
+struct pcap_record_header_raw {
+	uint32 ts_sec;
+	uint32 ts_usec;
+	uint32 caplen;
+	uint32 len;
+};
+
+AsyncWriter::AsyncWriter(int arg_fd, size_t ring_size, size_t arg_chunk_size)
+	: head(0), tail(0), dropped(0), write_error(0)
+	{
+	fd = arg_fd;
+	chunk_size = std::max(arg_chunk_size, static_cast<size_t>(4096));
+	ring.resize((std::max(ring_size, chunk_size) + chunk_size - 1) / chunk_size * chunk_size);
+	running = stopping = false;
+	}
+
+AsyncWriter::~AsyncWriter()
+	{
+	Stop();
+	}
+
+void AsyncWriter::Start()
+	{
+	if ( running )
+		return;
+
+	stopping = false;
+	running = true;
+	thread = std::thread(&AsyncWriter::Run, this);
+	}
+
+void AsyncWriter::Stop()
+	{
+	if ( ! running )
+		return;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	stopping = true;
+	have_data.notify_one();
+	lock.unlock();
+
+	thread.join();
+	running = false;
+	}
+
+bool AsyncWriter::Write(uint32 ts_sec, uint32 ts_usec, uint32 caplen,
+			uint32 len, const u_char* data)
+	{
+	size_t n = sizeof(pcap_record_header_raw) + caplen;
+	uint64 h = head.load(std::memory_order_relaxed);
+	uint64 t = tail.load(std::memory_order_acquire);
+
+	if ( n > ring.size() - (h - t) )
+		{
+		++dropped;
+		return false;
+		}
+
+	pcap_record_header_raw hdr;
+	hdr.ts_sec = ts_sec;
+	hdr.ts_usec = ts_usec;
+	hdr.caplen = caplen;
+	hdr.len = len;
+
+	// Copy into the ring, wrapping around at its end.
+	const u_char* parts[2] = { reinterpret_cast<const u_char*>(&hdr), data };
+	size_t sizes[2] = { sizeof(hdr), caplen };
+	uint64 pos = h;
+
+	for ( int i = 0; i < 2; i++ )
+		{
+		size_t off = pos % ring.size();
+		size_t first = std::min(sizes[i], ring.size() - off);
+		memcpy(ring.data() + off, parts[i], first);
+		memcpy(ring.data(), parts[i] + first, sizes[i] - first);
+		pos += sizes[i];
+		}
+
+	head.store(pos, std::memory_order_release);
+
+	// Wake up the writer once another chunk has filled up.
+	if ( pos / chunk_size != h / chunk_size )
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+		have_data.notify_one();
+		}
+
+	return true;
+	}
+
+void AsyncWriter::Run()
+	{
+	// Block signals in thread. We handle signals only in the main
+	// process.
+	sigset_t mask_set;
+	sigfillset(&mask_set);
+	sigdelset(&mask_set, SIGFPE);
+	sigdelset(&mask_set, SIGILL);
+	sigdelset(&mask_set, SIGSEGV);
+	sigdelset(&mask_set, SIGBUS);
+	pthread_sigmask(SIG_BLOCK, &mask_set, 0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while ( true )
+		{
+		if ( head.load(std::memory_order_acquire) -
+		     tail.load(std::memory_order_relaxed) >= chunk_size )
+			{
+			lock.unlock();
+			Flush(false);
+			lock.lock();
+			continue;
+			}
+
+		if ( stopping )
+			break;
+
+		if ( have_data.wait_for(lock, FLUSH_INTERVAL) == std::cv_status::timeout )
+			{
+			lock.unlock();
+			Flush(true);
+			lock.lock();
+			}
+		}
+
+	lock.unlock();
+	Flush(true);
+	}
+
+void AsyncWriter::Flush(bool partial)
+	{
+	while ( true )
+		{
+		uint64 t = tail.load(std::memory_order_relaxed);
+		uint64 pending = head.load(std::memory_order_acquire) - t;
+
+		if ( ! pending )
+			return;
+
+		// Write up to the next chunk boundary. As the ring's size is a
+		// multiple of the chunk size, that never crosses its end.
+		size_t off = t % ring.size();
+		size_t n = chunk_size - off % chunk_size;
+
+		if ( n > pending )
+			{
+			if ( ! partial )
+				return;
+
+			n = pending;
+			}
+
+		const u_char* p = ring.data() + off;
+		size_t left = n;
+
+		while ( left && ! write_error )
+			{
+			ssize_t rc = write(fd, p, left);
+
+			if ( rc < 0 )
+				{
+				if ( errno != EINTR )
+					write_error = errno;
+
+				continue;
+				}
+
+			p += rc;
+			left -= rc;
+			}
+
+		tail.store(t + n, std::memory_order_release);
+		}
+	}
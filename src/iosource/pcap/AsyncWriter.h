@@ -0,0 +1,116 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef IOSOURCE_PKTSRC_PCAP_ASYNCWRITER_H
+#define IOSOURCE_PKTSRC_PCAP_ASYNCWRITER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util.h"
+
+namespace iosource {
+namespace pcap {
+
+/**
+ * Writes pcap packet records to a file descriptor from a background
+ * thread. Records are copied into a bounded ring buffer, from which the
+ * thread writes them out in large chunks aligned to the ring's chunk
+ * boundaries. If the ring is full, records are dropped rather than
+ * blocking the caller.
+ *
+ * There must be only one thread calling Write().
+ */
+class AsyncWriter {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param fd The descriptor to write to. It must already be
+	 * positioned after the file header. The writer doesn't take
+	 * ownership.
+	 *
+	 * @param ring_size The size of the ring buffer in bytes. It's
+	 * rounded up to a multiple of *chunk_size*.
+	 *
+	 * @param chunk_size The preferred size of individual writes.
+	 */
+	AsyncWriter(int fd, size_t ring_size, size_t chunk_size);
+
+	/**
+	 * Destructor. Stops the thread if still running.
+	 */
+	~AsyncWriter();
+
+	/**
+	 * Starts the writer thread.
+	 */
+	void Start();
+
+	/**
+	 * Writes out everything still buffered and stops the writer thread.
+	 */
+	void Stop();
+
+	/**
+	 * Queues a packet record for writing.
+	 *
+	 * @param ts_sec The seconds part of the packet's timestamp.
+	 *
+	 * @param ts_usec The microseconds part of the packet's timestamp.
+	 *
+	 * @param caplen The number of bytes in *data*.
+	 *
+	 * @param len The packet's length on the wire.
+	 *
+	 * @param data The packet's data, which gets copied.
+	 *
+	 * @return False if the record had to be dropped because the ring
+	 * is full.
+	 */
+	bool Write(uint32 ts_sec, uint32 ts_usec, uint32 caplen, uint32 len,
+		   const u_char* data);
+
+	/**
+	 * Returns the number of records dropped so far.
+	 */
+	uint64 Dropped() const	{ return dropped; }
+
+	/**
+	 * Returns the \c errno value of a failed write, or zero if all
+	 * writes have succeeded so far. Once a write has failed, all
+	 * further output is discarded.
+	 */
+	int WriteError() const	{ return write_error; }
+
+private:
+	void Run();
+	void Flush(bool partial);
+
+	int fd;
+	std::vector<u_char> ring;
+	size_t chunk_size;
+
+	// Total bytes queued and written since start. Ring offsets are
+	// these modulo the ring's size. The producer only advances head,
+	// the writer thread only advances tail.
+	std::atomic<uint64> head;
+	std::atomic<uint64> tail;
+
+	std::atomic<uint64> dropped;
+	std::atomic<int> write_error;
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable have_data;
+	bool running;
+	bool stopping;
+};
+
+}
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include "Dumper.h"
 #include "../PktSrc.h"
 #include "../../Net.h"
+#include "../../Reporter.h"
 
 #include "pcap.bif.h"
 
@@ -17,10 +18,14 @@ PcapDumper::PcapDumper(const std::string& path, bool arg_append)
 	props.path = path;
 	dumper = 0;
 	pd = 0;
+	writer = 0;
+	reported_drops = 0;
+	next_drop_report = 0;
 	}
 
 PcapDumper::~PcapDumper()
 	{
+	delete writer;
 	}
 
 void PcapDumper::Open()
@@ -81,16 +86,67 @@ void PcapDumper::Open()
 			}
 		}
 
+	if ( BifConst::Pcap::async_dump )
+		StartAsyncWriter();
+
 	props.open_time = network_time;
 	props.hdr_size = Packet::GetLinkHeaderSize(pcap_datalink(pd));
 	Opened(props);
 	}
 
+void PcapDumper::StartAsyncWriter()
+	{
+	// From here on we bypass libpcap's stdio buffering and write the
+	// records to the file ourselves, so push out what it has buffered
+	// (i.e., the file header) first.
+	FILE* f = pcap_dump_file(dumper);
+
+	if ( fflush(f) != 0 )
+		{
+		reporter->Warning("cannot flush %s, not dumping asynchronously: %s",
+				  props.path.c_str(), strerror(errno));
+		return;
+		}
+
+	writer = new AsyncWriter(fileno(f), BifConst::Pcap::async_dump_buffer_size,
+				 BifConst::Pcap::async_dump_chunk_size);
+	writer->Start();
+	reported_drops = 0;
+	next_drop_report = 0;
+	}
+
+void PcapDumper::ReportDrops()
+	{
+	uint64 dropped = writer->Dropped();
+
+	if ( dropped == reported_drops )
+		return;
+
+	reporter->Warning("%s: dump buffer full, %" PRIu64 " packets not written",
+			  props.path.c_str(), dropped - reported_drops);
+
+	reported_drops = dropped;
+	}
+
 void PcapDumper::Close()
 	{
 	if ( ! dumper )
 		return;
 
+	if ( writer )
+		{
+		writer->Stop();
+		ReportDrops();
+
+		int err = writer->WriteError();
+
+		if ( err && ! IsError() )
+			reporter->Error("error writing to %s: %s", props.path.c_str(), strerror(err));
+
+		delete writer;
+		writer = 0;
+		}
+
 	pcap_dump_close(dumper);
 	pcap_close(pd);
 	dumper = 0;
@@ -104,6 +160,28 @@ bool PcapDumper::Dump(const Packet* pkt)
 	if ( ! dumper )
 		return false;
 
+	if ( writer )
+		{
+		if ( int err = writer->WriteError() )
+			{
+			Error(fmt("error writing to %s: %s", props.path.c_str(), strerror(err)));
+			return false;
+			}
+
+		// Report drops at most once per network time second, so
+		// that a slow disk doesn't flood the reporter.
+		bool queued = writer->Write(pkt->ts.tv_sec, pkt->ts.tv_usec,
+					    pkt->cap_len, pkt->len, pkt->data);
+
+		if ( ! queued && network_time >= next_drop_report )
+			{
+			ReportDrops();
+			next_drop_report = network_time + 1.0;
+			}
+
+		return true;
+		}
+
 	// Reconstitute the pcap_pkthdr.
 	const struct pcap_pkthdr phdr = {
 		.ts = pkt->ts, .caplen = pkt->cap_len, .len = pkt->len
@@ -8,6 +8,7 @@ extern "C" {
 }
 
 #include "../PktDumper.h"
+#include "AsyncWriter.h"
 
 namespace iosource {
 namespace pcap {
@@ -26,11 +27,19 @@ protected:
 	bool Dump(const Packet* pkt) override;
 
 private:
+	void StartAsyncWriter();
+	void ReportDrops();
+
 	Properties props;
 
 	bool append;
 	pcap_dumper_t* dumper;
 	pcap_t* pd;
+
+	// Set if records get written from a background thread.
+	AsyncWriter* writer;
+	uint64 reported_drops;
+	double next_drop_report;
 };
 
 }
@@ -0,0 +1,265 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+extern "C" {
+#include <pcap.h>
+}
+
+#include <algorithm>
+
+#include "MmapReader.h"
+
+using namespace iosource::pcap;
+
+// Magic numbers of the classic pcap format.
+static const uint32 PCAP_MAGIC_USEC = 0xa1b2c3d4;
+static const uint32 PCAP_MAGIC_NSEC = 0xa1b23c4d;
+
+// LINKTYPE_* values as found in trace files. See libpcap's pcap-common.c.
+static const uint32 LINKTYPE_NULL = 0;
+static const uint32 LINKTYPE_ETHERNET = 1;
+static const uint32 LINKTYPE_FDDI = 10;
+static const uint32 LINKTYPE_PPP_HDLC = 50;
+static const uint32 LINKTYPE_RAW = 101;
+static const uint32 LINKTYPE_IEEE802_11 = 105;
+static const uint32 LINKTYPE_LINUX_SLL = 113;
+static const uint32 LINKTYPE_IEEE802_11_RADIOTAP = 127;
+static const uint32 LINKTYPE_NFLOG = 239;
+
+// How far ahead of the current position we ask the kernel to prefetch,
+// and the granularity at which we move that window along.
+static const size_t READAHEAD_WINDOW = 64 * 1024 * 1024;
+static const size_t READAHEAD_STEP = 16 * 1024 * 1024;
+
+// Translates a file's link type into the DLT_* value that libpcap would
+// report. We only take on link types for which that's all libpcap does:
+// for others, it maps values differently per platform, or rewrites the
+// packets' pseudo-headers on the way. Returns -1 for those, so that they
+// keep going through libpcap.
+static int linktype_to_dlt(uint32 lt, bool swapped)
+	{
+	switch ( lt ) {
+	case LINKTYPE_NULL:
+		return DLT_NULL;
+
+	case LINKTYPE_ETHERNET:
+		return DLT_EN10MB;
+
+	case LINKTYPE_FDDI:
+		return DLT_FDDI;
+
+	case LINKTYPE_PPP_HDLC:
+		return DLT_PPP_SERIAL;
+
+	case LINKTYPE_RAW:
+		return DLT_RAW;
+
+	case LINKTYPE_IEEE802_11:
+		return DLT_IEEE802_11;
+
+#ifdef DLT_LINUX_SLL
+	case LINKTYPE_LINUX_SLL:
+		return DLT_LINUX_SLL;
+#endif
+
+	case LINKTYPE_IEEE802_11_RADIOTAP:
+		return DLT_IEEE802_11_RADIO;
+
+	case LINKTYPE_NFLOG:
+		// libpcap byte-swaps the NFLOG headers of traces written on
+		// a host of the other byte order.
+		return swapped ? -1 : DLT_NFLOG;
+
+	default:
+		return -1;
+	}
+	}
+
+struct pcap_file_header_raw {
+	uint32 magic;
+	uint16 version_major;
+	uint16 version_minor;
+	int32 thiszone;
+	uint32 sigfigs;
+	uint32 snaplen;
+	uint32 linktype;
+};
+
+struct pcap_record_header_raw {
+	uint32 ts_sec;
+	uint32 ts_frac;
+	uint32 caplen;
+	uint32 len;
+};
+
+MmapReader::MmapReader()
+	{
+	fd = -1;
+	base = 0;
+	size = pos = 0;
+	swapped = nanosecs = false;
+	link_type = -1;
+	snaplen = 0;
+	prefetched = released = next_advise = 0;
+	}
+
+MmapReader::~MmapReader()
+	{
+	Close();
+	}
+
+bool MmapReader::Open(const std::string& path, std::string* errmsg)
+	{
+	errmsg->clear();
+
+	fd = open(path.c_str(), O_RDONLY);
+
+	if ( fd < 0 )
+		{
+		*errmsg = fmt("%s: %s", path.c_str(), strerror(errno));
+		return false;
+		}
+
+	struct stat st;
+
+	if ( fstat(fd, &st) < 0 || ! S_ISREG(st.st_mode) ||
+	     st.st_size < static_cast<off_t>(sizeof(pcap_file_header_raw)) )
+		{
+		// Pipes, devices and the like; let libpcap deal with them.
+		Close();
+		return false;
+		}
+
+	pcap_file_header_raw hdr;
+
+	if ( pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) )
+		{
+		Close();
+		return false;
+		}
+
+	if ( hdr.magic == PCAP_MAGIC_USEC || hdr.magic == PCAP_MAGIC_NSEC )
+		swapped = false;
+
+	else if ( __builtin_bswap32(hdr.magic) == PCAP_MAGIC_USEC ||
+		  __builtin_bswap32(hdr.magic) == PCAP_MAGIC_NSEC )
+		swapped = true;
+
+	else
+		{
+		// Not a classic pcap file (pcapng, perhaps).
+		Close();
+		return false;
+		}
+
+	nanosecs = (Swap(hdr.magic) == PCAP_MAGIC_NSEC);
+	snaplen = Swap(hdr.snaplen);
+
+	link_type = linktype_to_dlt(Swap(hdr.linktype) & 0x03ffffff, swapped);
+
+	if ( link_type < 0 )
+		{
+		Close();
+		return false;
+		}
+
+	size = st.st_size;
+	void* m = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if ( m == MAP_FAILED )
+		{
+		*errmsg = fmt("%s: mmap failed: %s", path.c_str(), strerror(errno));
+		Close();
+		return false;
+		}
+
+	base = reinterpret_cast<const u_char*>(m);
+	pos = sizeof(pcap_file_header_raw);
+	prefetched = released = next_advise = 0;
+
+	madvise(const_cast<u_char*>(base), size, MADV_SEQUENTIAL);
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	Advise(pos);
+
+	return true;
+	}
+
+void MmapReader::Close()
+	{
+	if ( base )
+		munmap(const_cast<u_char*>(base), size);
+
+	if ( fd >= 0 )
+		close(fd);
+
+	fd = -1;
+	base = 0;
+	size = pos = 0;
+	}
+
+void MmapReader::Advise(size_t at)
+	{
+	static size_t page_size = sysconf(_SC_PAGESIZE);
+
+	size_t window_end = std::min(at + READAHEAD_WINDOW, size);
+
+	if ( window_end > prefetched )
+		{
+		size_t start = std::max(prefetched, at) / page_size * page_size;
+		madvise(const_cast<u_char*>(base) + start, window_end - start, MADV_WILLNEED);
+		prefetched = window_end;
+		}
+
+	// Drop what we've moved past. We keep one step of slack as the
+	// packet currently being processed lives just before the current
+	// position.
+	if ( at > released + 2 * READAHEAD_STEP )
+		{
+		size_t end = (at - READAHEAD_STEP) / page_size * page_size;
+		madvise(const_cast<u_char*>(base) + released, end - released, MADV_DONTNEED);
+		released = end;
+		}
+
+	next_advise = at + READAHEAD_STEP;
+	}
+
+bool MmapReader::Next(Record* rec)
+	{
+	if ( ! base )
+		return false;
+
+	if ( pos + sizeof(pcap_record_header_raw) > size )
+		return false;
+
+	pcap_record_header_raw hdr;
+	memcpy(&hdr, base + pos, sizeof(hdr));
+
+	uint32 caplen = Swap(hdr.caplen);
+
+	if ( pos + sizeof(hdr) + caplen > size )
+		// Truncated final record.
+		return false;
+
+	rec->ts.tv_sec = Swap(hdr.ts_sec);
+	rec->ts.tv_usec = nanosecs ? Swap(hdr.ts_frac) / 1000 : Swap(hdr.ts_frac);
+	rec->caplen = caplen;
+	rec->len = Swap(hdr.len);
+	rec->data = base + pos + sizeof(hdr);
+
+	pos += sizeof(hdr) + caplen;
+
+	if ( pos >= next_advise )
+		Advise(pos);
+
+	return true;
+	}
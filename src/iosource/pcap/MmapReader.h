@@ -0,0 +1,113 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef IOSOURCE_PKTSRC_PCAP_MMAPREADER_H
+#define IOSOURCE_PKTSRC_PCAP_MMAPREADER_H
+
+#include <string>
+
+#include "util.h"
+
+namespace iosource {
+namespace pcap {
+
+/**
+ * Reads classic pcap trace files by mapping them into memory, instead of
+ * going through libpcap's stdio path. Packets returned point directly into
+ * the mapping. The reader tells the kernel about its sequential access
+ * pattern and keeps a window ahead of the current position prefetched, while
+ * dropping pages it has moved past.
+ *
+ * Only the classic pcap format is supported (both byte orders, micro- and
+ * nanosecond resolution), with the link types Zeek analyzes whose packets
+ * libpcap passes through unchanged. For anything else, such as pcapng,
+ * Open() fails without an error message so that the caller can fall back
+ * to libpcap.
+ */
+class MmapReader {
+public:
+	/**
+	 * A packet record as found in the trace.
+	 */
+	struct Record {
+		struct timeval ts;	///< Capture timestamp.
+		uint32 caplen;		///< Bytes captured.
+		uint32 len;		///< Bytes on the wire.
+		const u_char* data;	///< Points into the mapping.
+	};
+
+	MmapReader();
+	~MmapReader();
+
+	/**
+	 * Maps a trace file.
+	 *
+	 * @param path The file to map.
+	 *
+	 * @param errmsg Set to a description of the problem if the file
+	 * exists but cannot be read; left empty if the file just isn't in a
+	 * format we support.
+	 *
+	 * @return True on success.
+	 */
+	bool Open(const std::string& path, std::string* errmsg);
+
+	/**
+	 * Unmaps the trace.
+	 */
+	void Close();
+
+	/**
+	 * Returns true if a trace is mapped.
+	 */
+	bool IsOpen() const	{ return base != 0; }
+
+	/**
+	 * Returns the file descriptor of the mapped file.
+	 */
+	int Fd() const	{ return fd; }
+
+	/**
+	 * Returns the data link type, as a \c DLT_* constant.
+	 */
+	int LinkType() const	{ return link_type; }
+
+	/**
+	 * Returns the snapshot length recorded in the file header.
+	 */
+	uint32 Snaplen() const	{ return snaplen; }
+
+	/**
+	 * Retrieves the next record.
+	 *
+	 * @param rec The record to fill in.
+	 *
+	 * @return False if the end of the trace has been reached. A
+	 * truncated final record counts as the end.
+	 */
+	bool Next(Record* rec);
+
+private:
+	uint32 Swap(uint32 v) const	{ return swapped ? __builtin_bswap32(v) : v; }
+	void Advise(size_t pos);
+
+	int fd;
+	const u_char* base;
+	size_t size;
+	size_t pos;
+
+	bool swapped;
+	bool nanosecs;
+	int link_type;
+	uint32 snaplen;
+
+	// Offsets of the window currently prefetched, and of the part we've
+	// already released.
+	size_t prefetched;
+	size_t released;
+	size_t next_advise;
+};
+
+}
+}
+
+#endif
@@ -2,6 +2,8 @@
 
 #include <assert.h>
 
+#include <algorithm>
+
 #include "zeek-config.h"
 
 #include "Source.h"
@@ -28,6 +30,7 @@ PcapSource::PcapSource(const std::string& path, bool is_live)
 	memset(&current_hdr, 0, sizeof(current_hdr));
 	memset(&last_hdr, 0, sizeof(last_hdr));
 	last_data = 0;
+	mmap_filter = -1;
 	}
 
 void PcapSource::Open()
@@ -40,6 +43,13 @@ void PcapSource::Open()
 
 void PcapSource::Close()
 	{
+	if ( mmap_reader.IsOpen() )
+		{
+		mmap_reader.Close();
+		Closed();
+		return;
+		}
+
 	if ( ! pd )
 		return;
 
@@ -145,6 +155,7 @@ void PcapSource::OpenLive()
 #endif
 
 	props.selectable_fd = pcap_fileno(pd);
+	props.batch_capable = true;
 
 	SetHdrSize();
 
@@ -157,10 +168,38 @@ void PcapSource::OpenLive()
 	Opened(props);
 	}
 
+bool PcapSource::OpenMmap()
+	{
+	std::string errmsg;
+
+	if ( ! mmap_reader.Open(props.path, &errmsg) )
+		{
+		if ( ! errmsg.empty() )
+			Error(errmsg);
+
+		return false;
+		}
+
+	props.link_type = mmap_reader.LinkType();
+	props.selectable_fd = mmap_reader.Fd();
+	props.is_live = false;
+	props.batch_capable = true;
+	Opened(props);
+	return true;
+	}
+
 void PcapSource::OpenOffline()
 	{
 	char errbuf[PCAP_ERRBUF_SIZE];
 
+	if ( BifConst::Pcap::mmap_offline && props.path != "-" )
+		{
+		if ( OpenMmap() || IsError() )
+			return;
+
+		// Not a format we can map, fall back to libpcap.
+		}
+
 	pd = pcap_open_offline(props.path.c_str(), errbuf);
 
 	if ( ! pd )
@@ -181,11 +220,60 @@ void PcapSource::OpenOffline()
 		InternalError("OS does not support selectable pcap fd");
 
 	props.is_live = false;
+	props.batch_capable = true;
 	Opened(props);
 	}
 
+bool PcapSource::ExtractNextMmapPacket(Packet* pkt)
+	{
+	MmapReader::Record rec;
+
+	while ( true )
+		{
+		if ( ! mmap_reader.Next(&rec) )
+			{
+			Close();
+			return false;
+			}
+
+		if ( rec.len == 0 || rec.caplen == 0 )
+			{
+			Weird("empty_pcap_header", 0);
+			continue;
+			}
+
+		if ( mmap_filter < 0 )
+			break;
+
+		struct pcap_pkthdr hdr;
+		hdr.ts = rec.ts;
+		hdr.caplen = rec.caplen;
+		hdr.len = rec.len;
+
+		if ( ApplyBPFFilter(mmap_filter, &hdr, rec.data) )
+			break;
+
+		if ( ! IsOpen() )
+			// Filter couldn't be applied.
+			return false;
+		}
+
+	pkt_timeval ts;
+	ts.tv_sec = rec.ts.tv_sec;
+	ts.tv_usec = rec.ts.tv_usec;
+	pkt->Init(props.link_type, &ts, rec.caplen, rec.len, rec.data);
+
+	++stats.received;
+	stats.bytes_received += rec.len;
+
+	return true;
+	}
+
 bool PcapSource::ExtractNextPacket(Packet* pkt)
 	{
+	if ( mmap_reader.IsOpen() )
+		return ExtractNextMmapPacket(pkt);
+
 	if ( ! pd )
 		return false;
 
@@ -224,6 +312,97 @@ void PcapSource::DoneWithPacket()
 	// Nothing to do.
 	}
 
+namespace {
+
+struct BatchState {
+	int link_type;
+	Packet* out;
+	u_char* buffer;
+	size_t slot_size;
+	size_t count;
+	uint64 bytes;
+	bool empty_header;
+};
+
+}
+
+void PcapSource::BatchCallback(u_char* user, const struct pcap_pkthdr* hdr,
+			       const u_char* data)
+	{
+	BatchState* state = reinterpret_cast<BatchState*>(user);
+
+	if ( hdr->len == 0 || hdr->caplen == 0 )
+		{
+		state->empty_header = true;
+		return;
+		}
+
+	// libpcap only guarantees the data to remain valid until the
+	// callback returns (and reuses a single buffer when reading from
+	// a file), so we copy into one slot of our batch buffer.
+	u_char* slot = state->buffer + state->count * state->slot_size;
+	uint32 caplen = std::min(hdr->caplen, static_cast<uint32>(state->slot_size));
+	memcpy(slot, data, caplen);
+
+	pkt_timeval ts = hdr->ts;
+	state->out[state->count++].Init(state->link_type, &ts, caplen, hdr->len, slot);
+	state->bytes += hdr->len;
+	}
+
+size_t PcapSource::ExtractPacketBatch(Packet* out, size_t max)
+	{
+	if ( mmap_reader.IsOpen() )
+		{
+		// The mapping stays valid, no need to copy.
+		size_t n = 0;
+
+		while ( n < max && ExtractNextMmapPacket(&out[n]) )
+			++n;
+
+		return n;
+		}
+
+	if ( ! pd )
+		return 0;
+
+	size_t slot_size = std::max(static_cast<int>(BifConst::Pcap::snaplen), pcap_snapshot(pd));
+
+	if ( batch_buffer.size() < max * slot_size )
+		batch_buffer.resize(max * slot_size);
+
+	BatchState state;
+	state.link_type = props.link_type;
+	state.out = out;
+	state.buffer = batch_buffer.data();
+	state.slot_size = slot_size;
+	state.count = 0;
+	state.bytes = 0;
+	state.empty_header = false;
+
+	int rc = pcap_dispatch(pd, static_cast<int>(max), BatchCallback, reinterpret_cast<u_char*>(&state));
+
+	if ( state.empty_header )
+		Weird("empty_pcap_header", 0);
+
+	if ( rc < 0 )
+		{
+		PcapError("pcap_dispatch");
+		return 0;
+		}
+
+	if ( rc == 0 && ! props.is_live )
+		{
+		// File is exhausted.
+		Close();
+		return 0;
+		}
+
+	stats.received += state.count;
+	stats.bytes_received += state.bytes;
+
+	return state.count;
+	}
+
 bool PcapSource::PrecompileFilter(int index, const std::string& filter)
 	{
 	return PktSrc::PrecompileBPFFilter(index, filter);
@@ -231,6 +410,20 @@ bool PcapSource::PrecompileFilter(int index, const std::string& filter)
 
 bool PcapSource::SetFilter(int index)
 	{
+	if ( mmap_reader.IsOpen() )
+		{
+		BPF_Program* code = GetBPFFilter(index);
+
+		if ( ! code )
+			{
+			Error(fmt("No precompiled pcap filter for index %d", index));
+			return false;
+			}
+
+		mmap_filter = (code->MatchesAnything() || LinkType() == DLT_NFLOG) ? -1 : index;
+		return true;
+		}
+
 	if ( ! pd )
 		return true; // Prevent error message
 
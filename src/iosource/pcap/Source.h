@@ -4,6 +4,7 @@
 #define IOSOURCE_PKTSRC_PCAP_SOURCE_H
 
 #include "../PktSrc.h"
+#include "MmapReader.h"
 
 namespace iosource {
 namespace pcap {
@@ -21,6 +22,7 @@ protected:
 	void Close() override;
 	bool ExtractNextPacket(Packet* pkt) override;
 	void DoneWithPacket() override;
+	size_t ExtractPacketBatch(Packet* out, size_t max) override;
 	bool PrecompileFilter(int index, const std::string& filter) override;
 	bool SetFilter(int index) override;
 	void Statistics(Stats* stats) override;
@@ -28,9 +30,14 @@ protected:
 private:
 	void OpenLive();
 	void OpenOffline();
+	bool OpenMmap();
+	bool ExtractNextMmapPacket(Packet* pkt);
 	void PcapError(const char* where = 0);
 	void SetHdrSize();
 
+	static void BatchCallback(u_char* user, const struct pcap_pkthdr* hdr,
+				  const u_char* data);
+
 	Properties props;
 	Stats stats;
 
@@ -39,6 +46,14 @@ private:
 	struct pcap_pkthdr current_hdr;
 	struct pcap_pkthdr last_hdr;
 	const u_char* last_data;
+
+	// Holds copies of the packets of the current batch.
+	std::vector<u_char> batch_buffer;
+
+	// Used instead of libpcap for offline input if Pcap::mmap_offline is
+	// set. We then apply BPF filters ourselves.
+	MmapReader mmap_reader;
+	int mmap_filter;
 };
 
 }
@@ -1,6 +1,8 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
 #include <algorithm>
+#include <deque>
+#include <functional>
 
 #include "Event.h"
 #include "EventHandler.h"
@@ -12,6 +14,7 @@
 #include "broker/Manager.h"
 #include "threading/Manager.h"
 #include "threading/SerialTypes.h"
+#include "threading/Formatter.h"
 
 #include "Manager.h"
 #include "WriterFrontend.h"
@@ -22,6 +25,10 @@
 
 using namespace logging;
 
+// Bound on the number of memoized path_func results per filter. Once
+// reached, we start over.
+static const size_t MAX_PATH_CACHE_SIZE = 10000;
+
 struct Manager::Filter {
 	Val* fval;
 	string name;
@@ -50,9 +57,35 @@ struct Manager::Filter {
 	// sub-records.
 	vector<list<int> > indices;
 
+	// Collapsing of identical rows, if aggregate_fields is set. The
+	// count goes into an extra field at the end.
+	bool aggregate;
+	vector<int> aggregate_key;	// Indices of the fields to compare.
+	double aggregate_interval;
+	map<string, AggregateEntry*> aggregates;	// Indexed by key.
+	std::deque<AggregateEntry*> aggregate_order;	// Oldest first.
+	Timer* aggregate_timer;
+
+	// Memoized path_func results, if path_func_key_fields is set.
+	vector<int> path_func_key;	// Offsets of the columns to compare.
+	map<string, string> path_cache;	// Indexed by key.
+
+	// The last ext_func result, if ext_func_interval is set.
+	double ext_func_interval;
+	RecordVal* ext_rec;	// May be null.
+	string ext_path;	// The path it was computed for.
+	double ext_time;
+
 	~Filter();
 };
 
+struct Manager::AggregateEntry {
+	string key;
+	WriterFrontend* writer;
+	threading::Value** vals;	// Of the first row.
+	double start;
+};
+
 struct Manager::WriterInfo {
 	EnumVal* type;
 	double open_time;
@@ -82,11 +115,26 @@ struct Manager::Stream {
 
 	bool enable_remote;
 
+	uint64 writes;	// Rows logged, since the last stats reset.
+	uint64 filtered;	// Rows filters held back, since the last stats reset.
+
 	~Stream();
 	};
 
 Manager::Filter::~Filter()
 	{
+	if ( aggregate_timer )
+		timer_mgr->Cancel(aggregate_timer);
+
+	for ( auto e : aggregate_order )
+		{
+		for ( int i = 0; i < num_fields; i++ )
+			delete e->vals[i];
+
+		delete [] e->vals;
+		delete e;
+		}
+
 	Unref(fval);
 	Unref(field_name_map);
 	Unref(writer);
@@ -98,6 +146,7 @@ Manager::Filter::~Filter()
 	free(fields);
 
 	Unref(path_val);
+	Unref(ext_rec);
 	}
 
 Manager::Stream::~Stream()
@@ -209,6 +258,9 @@ void Manager::RemoveDisabledWriters(Stream* stream)
 		{
 		if ( j->second->writer->Disabled() )
 			{
+			for ( auto f : stream->filters )
+				DropAggregates(f, j->second->writer);
+
 			j->second->writer->Stop();
 			delete j->second;
 			disabled.push_back(j->first);
@@ -304,6 +356,8 @@ bool Manager::CreateStream(EnumVal* id, RecordVal* sval)
 	streams[idx]->name = id->Type()->AsEnumType()->Lookup(idx);
 	streams[idx]->event = event ? event_registry->Lookup(event->Name()) : 0;
 	streams[idx]->columns = columns->Ref()->AsRecordType();
+	streams[idx]->writes = 0;
+	streams[idx]->filtered = 0;
 
 	streams[idx]->enable_remote = internal_val("Log::enable_remote_logging")->AsBool();
 
@@ -325,6 +379,9 @@ bool Manager::RemoveStream(EnumVal* id)
 	if ( ! stream )
 		return false;
 
+	for ( auto f : stream->filters )
+		FlushAggregates(f, true);
+
 	for ( Stream::WriterMap::iterator i = stream->writers.begin(); i != stream->writers.end(); i++ )
 		{
 		WriterInfo* winfo = i->second;
@@ -553,6 +610,7 @@ bool Manager::AddFilter(EnumVal* id, RecordVal* fval)
 	Val* scope_sep = fval->Lookup("scope_sep", true);
 	Val* ext_prefix = fval->Lookup("ext_prefix", true);
 	Val* ext_func = fval->Lookup("ext_func", true);
+	Val* ext_func_interval = fval->Lookup("ext_func_interval", true);
 
 	Filter* filter = new Filter;
 	filter->fval = fval->Ref();
@@ -570,6 +628,9 @@ bool Manager::AddFilter(EnumVal* id, RecordVal* fval)
 	filter->scope_sep = scope_sep->AsString()->CheckString();
 	filter->ext_prefix = ext_prefix->AsString()->CheckString();
 	filter->ext_func = ext_func ? ext_func->AsFunc() : 0;
+	filter->ext_func_interval = ext_func_interval->AsInterval();
+	filter->ext_rec = 0;
+	filter->ext_time = 0;
 
 	Unref(name);
 	Unref(pred);
@@ -583,6 +644,7 @@ bool Manager::AddFilter(EnumVal* id, RecordVal* fval)
 	Unref(scope_sep);
 	Unref(ext_prefix);
 	Unref(ext_func);
+	Unref(ext_func_interval);
 
 	// Build the list of fields that the filter wants included, including
 	// potentially rolling out fields.
@@ -620,6 +682,82 @@ bool Manager::AddFilter(EnumVal* id, RecordVal* fval)
 		return false;
 		}
 
+	filter->aggregate = false;
+	filter->aggregate_interval = 0;
+	filter->aggregate_timer = 0;
+
+	Val* aggregate_fields = fval->Lookup("aggregate_fields");
+
+	if ( aggregate_fields )
+		{
+		Val* interv = fval->Lookup("aggregate_interval", true);
+		Val* count_field = fval->Lookup("aggregate_count_field", true);
+		filter->aggregate_interval = interv->AsInterval();
+		string count_name = count_field->AsString()->CheckString();
+		Unref(interv);
+		Unref(count_field);
+
+		ListVal* names = aggregate_fields->AsTableVal()->ConvertToPureList();
+		bool ok = true;
+
+		for ( int i = 0; ok && i < names->Length(); ++i )
+			{
+			const char* name = names->Index(i)->AsString()->CheckString();
+			int j;
+
+			for ( j = 0; j < filter->num_fields; ++j )
+				{
+				if ( strcmp(filter->fields[j]->name, name) == 0 )
+					break;
+				}
+
+			if ( j == filter->num_fields )
+				{
+				reporter->Error("unknown aggregation field '%s' in filter '%s'",
+						name, filter->name.c_str());
+				ok = false;
+				}
+
+			filter->aggregate_key.push_back(j);
+			}
+
+		Unref(names);
+
+		for ( int j = 0; ok && j < filter->num_fields; ++j )
+			{
+			if ( count_name == filter->fields[j]->name )
+				{
+				reporter->Error("aggregation count field '%s' in filter '%s' conflicts with a column",
+						count_name.c_str(), filter->name.c_str());
+				ok = false;
+				}
+			}
+
+		if ( ! ok )
+			{
+			delete filter;
+			return false;
+			}
+
+		// The set's order is arbitrary.
+		sort(filter->aggregate_key.begin(), filter->aggregate_key.end());
+
+		void* tmp = realloc(filter->fields,
+				    sizeof(threading::Field*) * (filter->num_fields + 1));
+
+		if ( ! tmp )
+			{
+			reporter->Error("out of memory in add_filter");
+			delete filter;
+			return false;
+			}
+
+		filter->fields = (threading::Field**) tmp;
+		filter->fields[filter->num_fields++] =
+			new threading::Field(count_name.c_str(), 0, TYPE_COUNT, TYPE_VOID, false);
+		filter->aggregate = true;
+		}
+
 	// Get the path for the filter.
 	Val* path_val = fval->Lookup("path");
 
@@ -636,6 +774,55 @@ bool Manager::AddFilter(EnumVal* id, RecordVal* fval)
 		filter->path_val = 0;
 		}
 
+	Val* path_func_key_fields = fval->Lookup("path_func_key_fields");
+
+	if ( path_func_key_fields && filter->path_func )
+		{
+		ListVal* names = path_func_key_fields->AsTableVal()->ConvertToPureList();
+		bool ok = true;
+
+		for ( int i = 0; ok && i < names->Length(); ++i )
+			{
+			const char* name = names->Index(i)->AsString()->CheckString();
+			int offset = stream->columns->FieldOffset(name);
+
+			if ( offset < 0 )
+				{
+				reporter->Error("unknown path_func key field '%s' in filter '%s'",
+						name, filter->name.c_str());
+				ok = false;
+				break;
+				}
+
+			switch ( stream->columns->FieldType(offset)->InternalType() ) {
+			case TYPE_INTERNAL_INT:
+			case TYPE_INTERNAL_UNSIGNED:
+			case TYPE_INTERNAL_DOUBLE:
+			case TYPE_INTERNAL_STRING:
+			case TYPE_INTERNAL_ADDR:
+			case TYPE_INTERNAL_SUBNET:
+				filter->path_func_key.push_back(offset);
+				break;
+
+			default:
+				reporter->Error("path_func key field '%s' in filter '%s' is not of an atomic type",
+						name, filter->name.c_str());
+				ok = false;
+			}
+			}
+
+		Unref(names);
+
+		if ( ! ok )
+			{
+			delete filter;
+			return false;
+			}
+
+		// The set's order is arbitrary.
+		sort(filter->path_func_key.begin(), filter->path_func_key.end());
+		}
+
 	// Remove any filter with the same name we might already have.
 	RemoveFilter(id, filter->name);
 
@@ -682,6 +869,7 @@ bool Manager::RemoveFilter(EnumVal* id, string name)
 		if ( (*i)->name == name )
 			{
 			Filter* filter = *i;
+			FlushAggregates(filter, true);
 			stream->filters.erase(i);
 			DBG_LOG(DBG_LOGGING, "Removed filter '%s' from stream '%s'",
 				filter->name.c_str(), stream->name.c_str());
@@ -697,6 +885,60 @@ bool Manager::RemoveFilter(EnumVal* id, string name)
 	return true;
 	}
 
+static void add_to_path_key(string* key, const Val* v)
+	{
+	if ( ! v )
+		{
+		key->push_back('\0');
+		return;
+		}
+
+	key->push_back('\1');
+
+	switch ( v->Type()->InternalType() ) {
+	case TYPE_INTERNAL_STRING:
+		{
+		const BroString* s = v->AsString();
+		int len = s->Len();
+		key->append(reinterpret_cast<const char*>(&len), sizeof(len));
+		key->append(reinterpret_cast<const char*>(s->Bytes()), len);
+		break;
+		}
+
+	case TYPE_INTERNAL_ADDR:
+		{
+		uint32_t bytes[4];
+		v->AsAddr().CopyIPv6(bytes);
+		key->append(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+		break;
+		}
+
+	case TYPE_INTERNAL_SUBNET:
+		{
+		uint32_t bytes[4];
+		v->AsSubNet().Prefix().CopyIPv6(bytes);
+		key->append(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+		key->push_back(v->AsSubNet().LengthIPv6());
+		break;
+		}
+
+	case TYPE_INTERNAL_DOUBLE:
+		{
+		double d = v->InternalDouble();
+		key->append(reinterpret_cast<const char*>(&d), sizeof(d));
+		break;
+		}
+
+	default:
+		{
+		// Ints and counts.
+		bro_uint_t u = v->ForceAsUInt();
+		key->append(reinterpret_cast<const char*>(&u), sizeof(u));
+		break;
+		}
+	}
+	}
+
 bool Manager::Write(EnumVal* id, RecordVal* columns)
 	{
 	Stream* stream = FindStream(id);
@@ -714,6 +956,8 @@ bool Manager::Write(EnumVal* id, RecordVal* columns)
 		return false;
 		}
 
+	++stream->writes;
+
 	// Raise the log event.
 	if ( stream->event )
 		mgr.QueueEventFast(stream->event, {columns->Ref()}, SOURCE_LOCAL);
@@ -741,11 +985,35 @@ bool Manager::Write(EnumVal* id, RecordVal* columns)
 				}
 
 			if ( ! result )
+				{
+				++stream->filtered;
 				continue;
+				}
 			}
 
-		if ( filter->path_func )
+		string path_key;
+		bool have_path = false;
+
+		if ( filter->path_func && ! filter->path_func_key.empty() )
 			{
+			for ( auto i : filter->path_func_key )
+				add_to_path_key(&path_key, columns->Lookup(i));
+
+			auto c = filter->path_cache.find(path_key);
+
+			if ( c != filter->path_cache.end() )
+				{
+				path = c->second;
+				have_path = true;
+				}
+			}
+
+		if ( filter->path_func && ! have_path )
+			{
+			// The first call doesn't get to see a path yet, so
+			// its result doesn't go into the cache.
+			bool cache_path = filter->path_val && ! filter->path_func_key.empty();
+
 			Val* path_arg;
 			if ( filter->path_val )
 				path_arg = filter->path_val->Ref();
@@ -790,6 +1058,14 @@ bool Manager::Write(EnumVal* id, RecordVal* columns)
 			path = v->AsString()->CheckString();
 			Unref(v);
 
+			if ( cache_path )
+				{
+				if ( filter->path_cache.size() >= MAX_PATH_CACHE_SIZE )
+					filter->path_cache.clear();
+
+				filter->path_cache.insert(std::make_pair(path_key, path));
+				}
+
 #ifdef DEBUG
 			DBG_LOG(DBG_LOGGING, "Path function for filter '%s' on stream '%s' return '%s'",
 				filter->name.c_str(), stream->name.c_str(), path.c_str());
@@ -827,6 +1103,9 @@ bool Manager::Write(EnumVal* id, RecordVal* columns)
 			  instantiator.c_str());
 
 			path = filter->path = filter->path_val->AsString()->CheckString();
+
+			// The path_func saw the old path.
+			filter->path_cache.clear();
 			}
 
 		WriterBackend::WriterInfo* info = 0;
@@ -910,7 +1189,8 @@ bool Manager::Write(EnumVal* id, RecordVal* columns)
 
 		// Alright, can do the write now.
 
-		threading::Value** vals = RecordToFilterVals(stream, filter, columns);
+		bool in_arena;
+		threading::Value** vals = RecordToFilterVals(stream, filter, columns, writer, &in_arena);
 
 		if ( ! PLUGIN_HOOK_WITH_RESULT(HOOK_LOG_WRITE,
 		                               HookLogWrite(filter->writer->Type()->AsEnumType()->Lookup(filter->writer->InternalInt()),
@@ -920,6 +1200,7 @@ bool Manager::Write(EnumVal* id, RecordVal* columns)
 		                               true) )
 			{
 			DeleteVals(filter->num_fields, vals);
+			++stream->filtered;
 
 #ifdef DEBUG
 			DBG_LOG(DBG_LOGGING, "Hook prevented writing to filter '%s' on stream '%s'",
@@ -930,7 +1211,11 @@ bool Manager::Write(EnumVal* id, RecordVal* columns)
 
 		// Write takes ownership of vals.
 		assert(writer);
-		writer->Write(filter->num_fields, vals);
+
+		if ( filter->aggregate )
+			Aggregate(filter, writer, vals);
+		else
+			writer->Write(filter->num_fields, vals, in_arena);
 
 #ifdef DEBUG
 		DBG_LOG(DBG_LOGGING, "Wrote record to filter '%s' on stream '%s'",
@@ -943,15 +1228,27 @@ bool Manager::Write(EnumVal* id, RecordVal* columns)
 	return true;
 	}
 
-threading::Value* Manager::ValToLogVal(Val* val, BroType* ty)
+// Copies string data for a log value, into the arena if there's one.
+static char* copy_log_string(threading::ValueArena* arena, const char* s, size_t len)
+	{
+	if ( arena )
+		return arena->CopyString(s, len);
+
+	char* buf = new char[len + 1];
+	memcpy(buf, s, len);
+	buf[len] = '\0';
+	return buf;
+	}
+
+threading::Value* Manager::ValToLogVal(Val* val, BroType* ty, threading::ValueArena* arena)
 	{
 	if ( ! ty )
 		ty = val->Type();
 
 	if ( ! val )
-		return new threading::Value(ty->Tag(), false);
+		return arena ? arena->NewValue(ty->Tag(), false) : new threading::Value(ty->Tag(), false);
 
-	threading::Value* lval = new threading::Value(ty->Tag());
+	threading::Value* lval = arena ? arena->NewValue(ty->Tag()) : new threading::Value(ty->Tag());
 
 	switch ( lval->type ) {
 	case TYPE_BOOL:
@@ -966,14 +1263,14 @@ threading::Value* Manager::ValToLogVal(Val* val, BroType* ty)
 
 		if ( s )
 			{
-			lval->val.string_val.data = copy_string(s);
 			lval->val.string_val.length = strlen(s);
+			lval->val.string_val.data = copy_log_string(arena, s, lval->val.string_val.length);
 			}
 
 		else
 			{
 			val->Type()->Error("enum type does not contain value", val);
-			lval->val.string_val.data = copy_string("");
+			lval->val.string_val.data = copy_log_string(arena, "", 0);
 			lval->val.string_val.length = 0;
 			}
 		break;
@@ -1006,10 +1303,7 @@ threading::Value* Manager::ValToLogVal(Val* val, BroType* ty)
 	case TYPE_STRING:
 		{
 		const BroString* s = val->AsString();
-		char* buf = new char[s->Len()];
-		memcpy(buf, s->Bytes(), s->Len());
-
-		lval->val.string_val.data = buf;
+		lval->val.string_val.data = copy_log_string(arena, (const char*) s->Bytes(), s->Len());
 		lval->val.string_val.length = s->Len();
 		break;
 		}
@@ -1018,7 +1312,7 @@ threading::Value* Manager::ValToLogVal(Val* val, BroType* ty)
 		{
 		const BroFile* f = val->AsFile();
 		string s = f->Name();
-		lval->val.string_val.data = copy_string(s.c_str());
+		lval->val.string_val.data = copy_log_string(arena, s.data(), s.size());
 		lval->val.string_val.length = s.size();
 		break;
 		}
@@ -1029,8 +1323,8 @@ threading::Value* Manager::ValToLogVal(Val* val, BroType* ty)
 		const Func* f = val->AsFunc();
 		f->Describe(&d);
 		const char* s = d.Description();
-		lval->val.string_val.data = copy_string(s);
 		lval->val.string_val.length = strlen(s);
+		lval->val.string_val.data = copy_log_string(arena, s, lval->val.string_val.length);
 		break;
 		}
 
@@ -1043,10 +1337,11 @@ threading::Value* Manager::ValToLogVal(Val* val, BroType* ty)
 			set = new ListVal(TYPE_INT);
 
 		lval->val.set_val.size = set->Length();
-		lval->val.set_val.vals = new threading::Value* [lval->val.set_val.size];
+		lval->val.set_val.vals = arena ? arena->NewValues(lval->val.set_val.size) :
+			new threading::Value* [lval->val.set_val.size];
 
 		for ( int i = 0; i < lval->val.set_val.size; i++ )
-			lval->val.set_val.vals[i] = ValToLogVal(set->Index(i));
+			lval->val.set_val.vals[i] = ValToLogVal(set->Index(i), 0, arena);
 
 		Unref(set);
 		break;
@@ -1056,14 +1351,14 @@ threading::Value* Manager::ValToLogVal(Val* val, BroType* ty)
 		{
 		VectorVal* vec = val->AsVectorVal();
 		lval->val.vector_val.size = vec->Size();
-		lval->val.vector_val.vals =
+		lval->val.vector_val.vals = arena ? arena->NewValues(lval->val.vector_val.size) :
 			new threading::Value* [lval->val.vector_val.size];
 
 		for ( int i = 0; i < lval->val.vector_val.size; i++ )
 			{
 			lval->val.vector_val.vals[i] =
 				ValToLogVal(vec->Lookup(i),
-					    vec->Type()->YieldType());
+					    vec->Type()->YieldType(), arena);
 			}
 
 		break;
@@ -1077,20 +1372,59 @@ threading::Value* Manager::ValToLogVal(Val* val, BroType* ty)
 	}
 
 threading::Value** Manager::RecordToFilterVals(Stream* stream, Filter* filter,
-				    RecordVal* columns)
+				    RecordVal* columns, WriterFrontend* writer,
+				    bool* in_arena)
 	{
 	RecordVal* ext_rec = nullptr;
 	if ( filter->num_ext_fields > 0 )
 		{
-		val_list vl{filter->path_val->Ref()};
-		Val* res = filter->ext_func->Call(&vl);
-		if ( res )
-			ext_rec = res->AsRecordVal();
+		if ( filter->ext_rec && filter->ext_path == filter->path &&
+		     network_time < filter->ext_time + filter->ext_func_interval )
+			ext_rec = filter->ext_rec->Ref()->AsRecordVal();
+
+		else
+			{
+			val_list vl{filter->path_val->Ref()};
+			Val* res = filter->ext_func->Call(&vl);
+			if ( res )
+				ext_rec = res->AsRecordVal();
+
+			if ( filter->ext_func_interval > 0 )
+				{
+				Unref(filter->ext_rec);
+				filter->ext_rec = ext_rec ? ext_rec->Ref()->AsRecordVal() : 0;
+				filter->ext_path = filter->path;
+				filter->ext_time = network_time;
+				}
+			}
 		}
 
-	threading::Value** vals = new threading::Value*[filter->num_fields];
+	// Build the values right in the writer's batch, unless a plugin
+	// gets to see them first; it may want to replace some. We only get
+	// the arena now as the extension function above may have logged
+	// something, with the batch going off to the writer.
+	threading::ValueArena* arena = 0;
+
+	// Aggregated rows may stay around for longer than a batch.
+	if ( ! filter->aggregate && ! plugin_mgr->HavePluginForHook(plugin::HOOK_LOG_WRITE) )
+		arena = writer->WriteArena();
+
+	*in_arena = (arena != 0);
+
+	threading::Value** vals = arena ? arena->NewValues(filter->num_fields) :
+		new threading::Value*[filter->num_fields];
+
+	int num_fields = filter->num_fields;
 
-	for ( int i = 0; i < filter->num_fields; ++i )
+	if ( filter->aggregate )
+		{
+		// That's the count.
+		--num_fields;
+		vals[num_fields] = new threading::Value(TYPE_COUNT, true);
+		vals[num_fields]->val.uint_val = 1;
+		}
+
+	for ( int i = 0; i < num_fields; ++i )
 		{
 		Val* val;
 		if ( i < filter->num_ext_fields )
@@ -1098,7 +1432,8 @@ threading::Value** Manager::RecordToFilterVals(Stream* stream, Filter* filter,
 			if ( ! ext_rec )
 				{
 				// executing function did not return record. Send empty for all vals.
-				vals[i] = new threading::Value(filter->fields[i]->type, false);
+				vals[i] = arena ? arena->NewValue(filter->fields[i]->type, false) :
+					new threading::Value(filter->fields[i]->type, false);
 				continue;
 				}
 
@@ -1118,13 +1453,14 @@ threading::Value** Manager::RecordToFilterVals(Stream* stream, Filter* filter,
 			if ( ! val )
 				{
 				// Value, or any of its parents, is not set.
-				vals[i] = new threading::Value(filter->fields[i]->type, false);
+				vals[i] = arena ? arena->NewValue(filter->fields[i]->type, false) :
+					new threading::Value(filter->fields[i]->type, false);
 				break;
 				}
 			}
 
 		if ( val )
-			vals[i] = ValToLogVal(val);
+			vals[i] = ValToLogVal(val, 0, arena);
 		}
 
 	if ( ext_rec )
@@ -1369,6 +1705,9 @@ void Manager::Terminate()
 		if ( ! *s )
 			continue;
 
+		for ( auto f : (*s)->filters )
+			FlushAggregates(f, true);
+
 		for ( Stream::WriterMap::iterator i = (*s)->writers.begin();
 		      i != (*s)->writers.end(); i++ )
 			i->second->writer->Stop();
@@ -1456,6 +1795,222 @@ void RotationTimer::Dispatch(double t, int is_expire)
 		}
 	}
 
+// Timer which on dispatching writes out a filter's aggregated rows whose
+// interval has passed.
+class AggregationTimer : public Timer {
+public:
+	AggregationTimer(double t, Manager::Filter* arg_filter)
+		: Timer(t, TIMER_LOG_AGGREGATION)
+			{
+			filter = arg_filter;
+			}
+
+	~AggregationTimer();
+
+	void Dispatch(double t, int is_expire);
+
+protected:
+	Manager::Filter* filter;
+};
+
+AggregationTimer::~AggregationTimer()
+	{
+	if ( filter->aggregate_timer == this )
+		filter->aggregate_timer = 0;
+	}
+
+void AggregationTimer::Dispatch(double t, int is_expire)
+	{
+	filter->aggregate_timer = 0;
+	log_mgr->FlushAggregates(filter, is_expire);
+
+	if ( ! is_expire )
+		log_mgr->InstallAggregationTimer(filter);
+	}
+
+// Adds a value to the key identifying rows to aggregate.
+static void add_to_aggregation_key(string* key, const threading::Value* v)
+	{
+	if ( ! v->present )
+		{
+		key->push_back('-');
+		return;
+		}
+
+	key->push_back('+');
+
+	switch ( v->type ) {
+	case TYPE_ENUM:
+	case TYPE_STRING:
+	case TYPE_FILE:
+	case TYPE_FUNC:
+		key->append(reinterpret_cast<const char*>(&v->val.string_val.length),
+			    sizeof(v->val.string_val.length));
+		key->append(v->val.string_val.data, v->val.string_val.length);
+		break;
+
+	case TYPE_ADDR:
+		{
+		char buf[threading::formatter::Formatter::RENDER_BUF_SIZE];
+		key->append(threading::formatter::Formatter::Render(v->val.addr_val, buf));
+		key->push_back('\0');
+		break;
+		}
+
+	case TYPE_SUBNET:
+		{
+		char buf[threading::formatter::Formatter::RENDER_BUF_SIZE];
+		key->append(threading::formatter::Formatter::Render(v->val.subnet_val, buf));
+		key->push_back('\0');
+		break;
+		}
+
+	case TYPE_PORT:
+		key->append(reinterpret_cast<const char*>(&v->val.port_val),
+			    sizeof(v->val.port_val));
+		break;
+
+	case TYPE_TABLE:
+	case TYPE_VECTOR:
+		{
+		const threading::Value::set_t& s =
+			(v->type == TYPE_TABLE ? v->val.set_val : v->val.vector_val);
+
+		key->append(reinterpret_cast<const char*>(&s.size), sizeof(s.size));
+
+		for ( bro_int_t i = 0; i < s.size; ++i )
+			add_to_aggregation_key(key, s.vals[i]);
+
+		break;
+		}
+
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		key->append(reinterpret_cast<const char*>(&v->val.double_val),
+			    sizeof(v->val.double_val));
+		break;
+
+	default:
+		// Bools, ints and counts.
+		key->append(reinterpret_cast<const char*>(&v->val.uint_val),
+			    sizeof(v->val.uint_val));
+		break;
+	}
+	}
+
+void Manager::Aggregate(Filter* filter, WriterFrontend* writer, threading::Value** vals)
+	{
+	FlushAggregates(filter, false);
+
+	string key(reinterpret_cast<const char*>(&writer), sizeof(writer));
+
+	for ( auto i : filter->aggregate_key )
+		add_to_aggregation_key(&key, vals[i]);
+
+	auto a = filter->aggregates.find(key);
+
+	if ( a != filter->aggregates.end() )
+		{
+		++a->second->vals[filter->num_fields - 1]->val.uint_val;
+		DeleteVals(filter->num_fields, vals);
+		return;
+		}
+
+	AggregateEntry* e = new AggregateEntry;
+	e->key = key;
+	e->writer = writer;
+	e->vals = vals;
+	e->start = network_time;
+
+	filter->aggregates.insert(std::make_pair(key, e));
+	filter->aggregate_order.push_back(e);
+
+	if ( ! filter->aggregate_timer )
+		InstallAggregationTimer(filter);
+	}
+
+void Manager::FlushAggregates(Filter* filter, bool all)
+	{
+	// All entries have the same interval, so the ones done are at the
+	// front.
+	while ( ! filter->aggregate_order.empty() )
+		{
+		AggregateEntry* e = filter->aggregate_order.front();
+
+		if ( ! all && e->start + filter->aggregate_interval > network_time )
+			break;
+
+		filter->aggregate_order.pop_front();
+		filter->aggregates.erase(e->key);
+
+		// Write takes ownership of vals.
+		e->writer->Write(filter->num_fields, e->vals);
+		delete e;
+		}
+	}
+
+void Manager::DropAggregates(Filter* filter, WriterFrontend* writer)
+	{
+	std::deque<AggregateEntry*> keep;
+
+	for ( auto e : filter->aggregate_order )
+		{
+		if ( e->writer != writer )
+			{
+			keep.push_back(e);
+			continue;
+			}
+
+		filter->aggregates.erase(e->key);
+		DeleteVals(filter->num_fields, e->vals);
+		delete e;
+		}
+
+	filter->aggregate_order.swap(keep);
+	}
+
+void Manager::InstallAggregationTimer(Filter* filter)
+	{
+	if ( terminating || filter->aggregate_order.empty() )
+		return;
+
+	AggregateEntry* e = filter->aggregate_order.front();
+	filter->aggregate_timer =
+		new AggregationTimer(e->start + filter->aggregate_interval, filter);
+
+	timer_mgr->Add(filter->aggregate_timer);
+	}
+
+void Manager::GetStats(std::map<string, StreamStats>* stats, bool reset)
+	{
+	for ( auto s : streams )
+		{
+		if ( ! s )
+			continue;
+
+		StreamStats& ss = (*stats)[s->name];
+		ss.writes = s->writes;
+		ss.filtered = s->filtered;
+
+		for ( auto i : s->writers )
+			{
+			WriterInfo* winfo = i.second;
+			WriterStats ws;
+
+			if ( ! winfo->writer->GetWriteStats(&ws.backend, &ws.pending, &ws.dropped, reset) )
+				continue;
+
+			ws.path = winfo->writer->Info().path;
+			ws.writer = winfo->type->Type()->AsEnumType()->Lookup(winfo->type->InternalInt());
+			ss.writers.push_back(ws);
+			}
+
+		if ( reset )
+			s->writes = s->filtered = 0;
+		}
+	}
+
 void Manager::InstallRotationTimer(WriterInfo* winfo)
 	{
 	if ( terminating )
@@ -1485,8 +2040,20 @@ void Manager::InstallRotationTimer(WriterInfo* winfo)
 				log_rotate_base_time->AsString()->CheckString() : 0;
 
 			double base = parse_rotate_base_time(base_time);
+
+			// Shift each writer's rotation times by a fixed offset
+			// so that they don't all rotate at once.
+			double stagger = min(BifConst::log_rotate_stagger, rotation_interval);
+			double offset = 0;
+
+			if ( stagger > 0 )
+				{
+				size_t h = std::hash<string>()(winfo->writer->Info().path);
+				offset = (h % 1000000) / 1000000.0 * stagger;
+				}
+
 			double delta_t =
-				calc_next_rotate(network_time, rotation_interval, base);
+				calc_next_rotate(network_time - offset, rotation_interval, base);
 
 			winfo->rotation_timer =
 				new RotationTimer(network_time + delta_t, winfo, true);
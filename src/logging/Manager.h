@@ -17,6 +17,7 @@
 
 class SerializationFormat;
 class RotationTimer;
+class AggregationTimer;
 
 namespace logging {
 
@@ -228,11 +229,41 @@ public:
 	 */
 	RecordType* StreamColumns(EnumVal* stream_id);
 
+	/**
+	 * Statistics about one writer of a stream.
+	 */
+	struct WriterStats {
+		string path;	//! The path written to.
+		string writer;	//! The writer type.
+		uint64 pending;	//! Rows passed to the writer but not yet processed.
+		uint64 dropped;	//! Rows dropped because too many were pending.
+		WriterBackend::WriteStats backend;	//! The writer thread's statistics.
+	};
+
+	/**
+	 * Statistics about one stream.
+	 */
+	struct StreamStats {
+		uint64 writes;	//! Rows logged to the stream.
+		uint64 filtered;	//! Rows that filters have held back.
+		std::vector<WriterStats> writers;	//! Stats of the stream's local writers.
+	};
+
+	/**
+	 * Retrieves statistics about all log streams, indexed by stream
+	 * name.
+	 *
+	 * @param reset If true, starts over afterwards. That doesn't affect
+	 * the number of pending rows.
+	 */
+	void GetStats(std::map<string, StreamStats>* stats, bool reset);
+
 protected:
 	friend class WriterFrontend;
 	friend class RotationFinishedMessage;
 	friend class RotationFailedMessage;
 	friend class ::RotationTimer;
+	friend class ::AggregationTimer;
 
 	// Instantiates a new WriterBackend of the given type (note that
 	// doing so creates a new thread!).
@@ -256,14 +287,17 @@ private:
 	struct Filter;
 	struct Stream;
 	struct WriterInfo;
+	struct AggregateEntry;
 
 	bool TraverseRecord(Stream* stream, Filter* filter, RecordType* rt,
 			    TableVal* include, TableVal* exclude, string path, list<int> indices);
 
 	threading::Value** RecordToFilterVals(Stream* stream, Filter* filter,
-				    RecordVal* columns);
+				    RecordVal* columns, WriterFrontend* writer,
+				    bool* in_arena);
 
-	threading::Value* ValToLogVal(Val* val, BroType* ty = 0);
+	threading::Value* ValToLogVal(Val* val, BroType* ty = 0,
+				      threading::ValueArena* arena = 0);
 	Stream* FindStream(EnumVal* id);
 	void RemoveDisabledWriters(Stream* stream);
 	void InstallRotationTimer(WriterInfo* winfo);
@@ -271,6 +305,10 @@ private:
 	WriterInfo* FindWriter(WriterFrontend* writer);
 	bool CompareFields(const Filter* filter, const WriterFrontend* writer);
 	bool CheckFilterWriterConflict(const WriterInfo* winfo, const Filter* filter);
+	void Aggregate(Filter* filter, WriterFrontend* writer, threading::Value** vals);
+	void FlushAggregates(Filter* filter, bool all);
+	void DropAggregates(Filter* filter, WriterFrontend* writer);
+	void InstallAggregationTimer(Filter* filter);
 
 	vector<Stream *> streams;	// Indexed by stream enum.
 	int rotations_pending;	// Number of rotations not yet finished.
@@ -8,6 +8,7 @@
 #include "Manager.h"
 #include "WriterBackend.h"
 #include "WriterFrontend.h"
+#include "Stats.h"
 
 // Messages sent from backend to frontend (i.e., "OutputMessages").
 
@@ -127,11 +128,20 @@ WriterBackend::WriterBackend(WriterFrontend* arg_frontend) : MsgThread()
 	info = new WriterInfo(frontend->Info());
 	rotation_counter = 0;
 
+	rows_processed = 0;
+	rows_waiter = false;
+	bytes_in = 0;
+	bytes_out = 0;
+	rows_written = 0;
+	write_latency = new LatencyHistogram;
+
 	SetName(frontend->Name());
 	}
 
 WriterBackend::~WriterBackend()
 	{
+	delete write_latency;
+
 	if ( fields )
 		{
 		for(int i = 0; i < num_fields; ++i)
@@ -143,10 +153,15 @@ WriterBackend::~WriterBackend()
 	delete info;
 	}
 
-void WriterBackend::DeleteVals(int num_writes, Value*** vals)
+void WriterBackend::DeleteVals(int num_writes, Value*** vals,
+			       threading::ValueArena* arena)
 	{
 	for ( int j = 0; j < num_writes; ++j )
 		{
+		// Writes built in the arena go away with it.
+		if ( arena && arena->Owns(vals[j]) )
+			continue;
+
 		// Note this code is duplicated in Manager::DeleteVals().
 		for ( int i = 0; i < num_fields; i++ )
 			delete vals[j][i];
@@ -155,6 +170,7 @@ void WriterBackend::DeleteVals(int num_writes, Value*** vals)
 		}
 
 	delete [] vals;
+	delete arena;
 	}
 
 bool WriterBackend::FinishedRotation(const char* new_name, const char* old_name,
@@ -172,6 +188,62 @@ bool WriterBackend::FinishedRotation()
 	return true;
 	}
 
+void WriterBackend::WaitForRowsProcessed(uint64_t target)
+	{
+	std::unique_lock<std::mutex> lock(rows_mutex);
+	rows_waiter = true;
+
+	// The timeout lets the caller notice a writer thread that went away.
+	rows_cond.wait_for(lock, std::chrono::milliseconds(100), [&]()
+		{ return rows_processed.load() >= target; });
+
+	rows_waiter = false;
+	}
+
+void WriterBackend::GetWriteStats(WriteStats* stats, bool reset)
+	{
+	if ( reset )
+		{
+		stats->bytes_in = bytes_in.exchange(0, std::memory_order_relaxed);
+		stats->bytes_out = bytes_out.exchange(0, std::memory_order_relaxed);
+		}
+	else
+		{
+		stats->bytes_in = bytes_in.load(std::memory_order_relaxed);
+		stats->bytes_out = bytes_out.load(std::memory_order_relaxed);
+		}
+
+	std::lock_guard<std::mutex> lock(stats_mutex);
+
+	stats->rows = rows_written;
+	stats->latency_p99 = write_latency->Percentile(99);
+	stats->latency_max = write_latency->Max();
+
+	if ( reset )
+		{
+		rows_written = 0;
+		write_latency->Reset();
+		}
+	}
+
+void WriterBackend::DeferRotation()
+	{
+	--rotation_counter;
+	}
+
+bool WriterBackend::FinishedDeferredRotation(const char* new_name, const char* old_name,
+					     double open, double close, bool terminating)
+	{
+	SendOut(new RotationFinishedMessage(frontend, new_name, old_name, open, close, true, terminating));
+	return true;
+	}
+
+bool WriterBackend::FinishedDeferredRotation()
+	{
+	SendOut(new RotationFinishedMessage(frontend, 0, 0, 0, 0, false, false));
+	return true;
+	}
+
 void WriterBackend::DisableFrontend()
 	{
 	SendOut(new DisableMessage(frontend));
@@ -195,8 +267,20 @@ bool WriterBackend::Init(int arg_num_fields, const Field* const* arg_fields)
 	return true;
 	}
 
-bool WriterBackend::Write(int arg_num_fields, int num_writes, Value*** vals)
+bool WriterBackend::Write(int arg_num_fields, int num_writes, Value*** vals,
+			  threading::ValueArena* arena)
 	{
+	// For the main thread to tell how much is still waiting for us.
+	rows_processed.fetch_add(num_writes);
+
+	if ( rows_waiter )
+		{
+		// Taking the mutex makes sure the main thread is either still
+		// before its check or already waiting.
+		std::lock_guard<std::mutex> lock(rows_mutex);
+		rows_cond.notify_one();
+		}
+
 	// Double-check that the arguments match. If we get this from remote,
 	// something might be mixed up.
 	if ( num_fields != arg_num_fields )
@@ -208,7 +292,7 @@ bool WriterBackend::Write(int arg_num_fields, int num_writes, Value*** vals)
 		Debug(DBG_LOGGING, msg);
 #endif
 
-		DeleteVals(num_writes, vals);
+		DeleteVals(num_writes, vals, arena);
 		DisableFrontend();
 		return false;
 		}
@@ -226,7 +310,7 @@ bool WriterBackend::Write(int arg_num_fields, int num_writes, Value*** vals)
 				Debug(DBG_LOGGING, msg);
 #endif
 				DisableFrontend();
-				DeleteVals(num_writes, vals);
+				DeleteVals(num_writes, vals, arena);
 				return false;
 				}
 			}
@@ -236,16 +320,28 @@ bool WriterBackend::Write(int arg_num_fields, int num_writes, Value*** vals)
 
 	if ( ! Failed() )
 		{
+		batch_latencies.clear();
+
 		for ( int j = 0; j < num_writes; j++ )
 			{
+			uint64 start = PipelineStats::Now();
 			success = DoWrite(num_fields, fields, vals[j]);
+			batch_latencies.push_back(PipelineStats::Now() - start);
 
 			if ( ! success )
 				break;
 			}
+
+		// Take the lock just once per batch.
+		std::lock_guard<std::mutex> lock(stats_mutex);
+
+		for ( auto l : batch_latencies )
+			write_latency->Record(l);
+
+		rows_written += batch_latencies.size();
 		}
 
-	DeleteVals(num_writes, vals);
+	DeleteVals(num_writes, vals, arena);
 
 	if ( ! success )
 		DisableFrontend();
@@ -5,12 +5,19 @@
 #ifndef LOGGING_WRITERBACKEND_H
 #define LOGGING_WRITERBACKEND_H
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
 #include "threading/MsgThread.h"
 
 #include "Component.h"
 
 namespace broker { class data; }
 
+class LatencyHistogram;
+
 namespace logging  {
 
 class WriterFrontend;
@@ -143,12 +150,16 @@ public:
 	 * types musst match with the field passed to Init(). The method
 	 * takes ownership of \a vals..
 	 *
+	 * @param arena If given, the arena holding the values of (some of)
+	 * the writes. The method takes ownership of it as well.
+	 *
 	 * Returns false if an error occured, in which case the writer must
 	 * not be used any further.
 	 *
 	 * @return False if an error occured.
 	 */
-	bool Write(int num_fields, int num_writes, threading::Value*** vals);
+	bool Write(int num_fields, int num_writes, threading::Value*** vals,
+		   threading::ValueArena* arena = 0);
 
 	/**
 	 * Sets the buffering status for the writer, assuming the writer
@@ -245,6 +256,84 @@ public:
 	 */
 	bool FinishedRotation();
 
+	/**
+	 * Signals that DoRotate() has handed off finishing the rotated file
+	 * to the background, so that the writer can go on with a new one
+	 * right away. This takes the place of calling FinishedRotation()
+	 * from DoRotate(); the writer must then call one of the
+	 * FinishedDeferredRotation() methods later, from its own thread,
+	 * once the rotated file is complete.
+	 */
+	void DeferRotation();
+
+	/**
+	 * Signals that a rotation deferred with DeferRotation() has
+	 * finished successfully. The parameters are the same as for
+	 * FinishedRotation().
+	 */
+	bool FinishedDeferredRotation(const char* new_name, const char* old_name,
+				      double open, double close, bool terminating);
+
+	/**
+	 * Signals that a rotation deferred with DeferRotation() has failed.
+	 */
+	bool FinishedDeferredRotation();
+
+	/**
+	 * Statistics about the writes a writer has carried out.
+	 */
+	struct WriteStats
+		{
+		uint64_t rows;		//! Number of rows written.
+		uint64_t bytes_in;	//! Number of bytes of output produced.
+		uint64_t bytes_out;	//! Number of bytes of output stored, e.g., after compression.
+		uint64_t latency_p99;	//! 99th percentile of the DoWrite() time, in nanoseconds.
+		uint64_t latency_max;	//! Maximum DoWrite() time, in nanoseconds.
+		};
+
+	/**
+	 * Returns statistics about the writes carried out so far. Unlike
+	 * most methods, this one is called from the main thread.
+	 *
+	 * @param stats Receives the statistics.
+	 *
+	 * @param reset If true, starts over with counting afterwards.
+	 */
+	void GetWriteStats(WriteStats* stats, bool reset);
+
+	/**
+	 * Returns the total number of rows passed to Write() since this
+	 * writer has been started, whether written successfully or not. This
+	 * may be called from the main thread.
+	 */
+	uint64_t RowsProcessed() const
+		{ return rows_processed.load(std::memory_order_relaxed); }
+
+	/**
+	 * Blocks until RowsProcessed() has reached a given value, or until a
+	 * short timeout has passed, whichever comes first. This is to be
+	 * called from the main thread, which needs to check again afterwards.
+	 *
+	 * @param target The number of processed rows to wait for.
+	 */
+	void WaitForRowsProcessed(uint64_t target);
+
+	/**
+	 * Records the amount of output written, for the statistics. Writers
+	 * that can tell call this from their DoWrite() implementation.
+	 *
+	 * @param in The number of bytes of output produced.
+	 *
+	 * @param out The number of bytes ending up in storage. This can
+	 * differ from *in* in the case of compression, and may as well be
+	 * recorded separately as the data actually gets stored.
+	 */
+	void BytesWritten(uint64_t in, uint64_t out)
+		{
+		bytes_in.fetch_add(in, std::memory_order_relaxed);
+		bytes_out.fetch_add(out, std::memory_order_relaxed);
+		}
+
 	// Overridden from MsgThread.
 	bool OnHeartbeat(double network_time, double current_time) override;
 	bool OnFinish(double network_time) override;
@@ -372,9 +461,10 @@ protected:
 
 private:
 	/**
-	 * Deletes the values as passed into Write().
+	 * Deletes the values and the arena as passed into Write().
 	 */
-	void DeleteVals(int num_writes, threading::Value*** vals);
+	void DeleteVals(int num_writes, threading::Value*** vals,
+			threading::ValueArena* arena);
 
 	// Frontend that instantiated us. This object must not be access from
 	// this class, it's running in a different thread!
@@ -386,6 +476,18 @@ private:
 	bool buffering;	// True if buffering is enabled.
 
 	int rotation_counter; // Tracks FinishedRotation() calls.
+
+	// Statistics, read by the main thread.
+	std::atomic<uint64_t> rows_processed;	// Never reset.
+	std::atomic<bool> rows_waiter;	// True while the main thread waits.
+	std::mutex rows_mutex;	// For signaling rows_processed.
+	std::condition_variable rows_cond;
+	std::atomic<uint64_t> bytes_in;
+	std::atomic<uint64_t> bytes_out;
+	std::mutex stats_mutex;	// Protects the following.
+	uint64_t rows_written;
+	LatencyHistogram* write_latency;
+	std::vector<uint64_t> batch_latencies;	// Only used by our thread.
 };
 
 
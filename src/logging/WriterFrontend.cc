@@ -55,16 +55,18 @@ private:
 class WriteMessage : public threading::InputMessage<WriterBackend>
 {
 public:
-	WriteMessage(WriterBackend* backend, int num_fields, int num_writes, Value*** vals)
+	WriteMessage(WriterBackend* backend, int num_fields, int num_writes, Value*** vals,
+		     threading::ValueArena* arena)
 		: threading::InputMessage<WriterBackend>("Write", backend),
-		num_fields(num_fields), num_writes(num_writes), vals(vals)	{}
+		num_fields(num_fields), num_writes(num_writes), vals(vals), arena(arena)	{}
 
-	virtual bool Process() { return Object()->Write(num_fields, num_writes, vals); }
+	virtual bool Process() { return Object()->Write(num_fields, num_writes, vals, arena); }
 
 private:
 	int num_fields;
 	int num_writes;
 	Value ***vals;
+	threading::ValueArena* arena;
 };
 
 class SetBufMessage : public threading::InputMessage<WriterBackend>
@@ -111,6 +113,10 @@ WriterFrontend::WriterFrontend(const WriterBackend::WriterInfo& arg_info, EnumVa
 	remote = arg_remote;
 	write_buffer = 0;
 	write_buffer_pos = 0;
+	write_arena = 0;
+	rows_sent = 0;
+	rows_dropped = 0;
+	warned_dropping = false;
 	info = new WriterBackend::WriterInfo(arg_info);
 
 	num_fields = 0;
@@ -124,7 +130,10 @@ WriterFrontend::WriterFrontend(const WriterBackend::WriterInfo& arg_info, EnumVa
 		backend = log_mgr->CreateBackend(this, writer);
 
 		if ( backend )
+			{
+			backend->SetPlacement(threading::thread_placement(threading::THREAD_WRITER));
 			backend->Start();
+			}
 		}
 
 	else
@@ -137,6 +146,7 @@ WriterFrontend::~WriterFrontend()
 	Unref(writer);
 	delete info;
 	delete [] name;
+	delete write_arena;
 	}
 
 void WriterFrontend::Stop()
@@ -144,6 +154,9 @@ void WriterFrontend::Stop()
 	FlushWriteBuffer();
 	SetDisable();
 
+	if ( remote )
+		broker_mgr->CloseLogWriter(stream, writer, info->path);
+
 	if ( backend )
 		{
 		backend->SignalStop();
@@ -178,18 +191,36 @@ void WriterFrontend::Init(int arg_num_fields, const Field* const * arg_fields)
 
 	}
 
-void WriterFrontend::Write(int arg_num_fields, Value** vals)
+threading::ValueArena* WriterFrontend::WriteArena()
+	{
+	if ( disabled || ! backend )
+		return 0;
+
+	if ( ! write_arena )
+		write_arena = new threading::ValueArena;
+
+	return write_arena;
+	}
+
+void WriterFrontend::Write(int arg_num_fields, Value** vals, bool in_arena)
 	{
+	// Values in the arena get released along with it, and we never have
+	// one without a backend.
 	if ( disabled )
 		{
-		DeleteVals(arg_num_fields, vals);
+		if ( ! in_arena )
+			DeleteVals(arg_num_fields, vals);
+
 		return;
 		}
 
 	if ( arg_num_fields != num_fields )
 		{
 		reporter->Warning("WriterFrontend %s expected %d fields in write, got %d. Skipping line.", name, num_fields, arg_num_fields);
-		DeleteVals(arg_num_fields, vals);
+
+		if ( ! in_arena )
+			DeleteVals(arg_num_fields, vals);
+
 		return;
 		}
 
@@ -216,6 +247,7 @@ void WriterFrontend::Write(int arg_num_fields, Value** vals)
 		}
 
 	write_buffer[write_buffer_pos++] = vals;
+	++rows_sent;
 
 	if ( write_buffer_pos >= WRITER_BUFFER_SIZE || ! buf || terminating )
 		// Buffer full (or no bufferin desired or termiating).
@@ -223,18 +255,84 @@ void WriterFrontend::Write(int arg_num_fields, Value** vals)
 
 	}
 
+bool WriterFrontend::GetWriteStats(WriterBackend::WriteStats* stats, uint64_t* pending,
+				   uint64_t* dropped, bool reset)
+	{
+	if ( ! backend )
+		return false;
+
+	backend->GetWriteStats(stats, reset);
+
+	uint64_t processed = backend->RowsProcessed();
+	*pending = rows_sent > processed ? rows_sent - processed : 0;
+	*dropped = rows_dropped;
+
+	if ( reset )
+		rows_dropped = 0;
+
+	return true;
+	}
+
+bool WriterFrontend::CheckBackpressure()
+	{
+	uint64_t max_pending = BifConst::log_max_pending_writes;
+
+	if ( ! max_pending )
+		return true;
+
+	// The rows of the batch at hand are already counted as sent.
+	auto pending = [&]() { return rows_sent - write_buffer_pos - backend->RowsProcessed(); };
+
+	if ( pending() < max_pending )
+		return true;
+
+	if ( BifConst::log_backpressure_policy->AsEnum() == BifEnum::LOG_BACKPRESSURE_BLOCK )
+		{
+		DBG_LOG(DBG_LOGGING, "Waiting for writer %s to catch up", name);
+
+		while ( pending() >= max_pending && ! backend->Killed() )
+			backend->WaitForRowsProcessed(rows_sent - write_buffer_pos - max_pending + 1);
+
+		return true;
+		}
+
+	if ( ! warned_dropping )
+		{
+		reporter->Warning("log writer %s cannot keep up, dropping rows", name);
+		warned_dropping = true;
+		}
+
+	rows_dropped += write_buffer_pos;
+	rows_sent -= write_buffer_pos;
+	return false;
+	}
+
 void WriterFrontend::FlushWriteBuffer()
 	{
 	if ( ! write_buffer_pos )
 		// Nothing to do.
 		return;
 
-	if ( backend )
-		backend->SendIn(new WriteMessage(backend, num_fields, write_buffer_pos, write_buffer));
+	if ( backend && CheckBackpressure() )
+		backend->SendIn(new WriteMessage(backend, num_fields, write_buffer_pos, write_buffer, write_arena));
+
+	else
+		{
+		for ( int j = 0; j < write_buffer_pos; ++j )
+			{
+			// Writes built in the arena go away with it.
+			if ( ! (write_arena && write_arena->Owns(write_buffer[j])) )
+				DeleteVals(num_fields, write_buffer[j]);
+			}
+
+		delete [] write_buffer;
+		delete write_arena;
+		}
 
 	// Clear buffer (no delete, we pass ownership to child thread.)
 	write_buffer = 0;
 	write_buffer_pos = 0;
+	write_arena = 0;
 	}
 
 void WriterFrontend::SetBuf(bool enabled)
@@ -91,9 +91,27 @@ public:
 	 * takes only a single record, not an array). The method takes
 	 * ownership of \a vals.
 	 *
+	 * @param in_arena True if \a vals has been built in the arena
+	 * returned by WriteArena().
+	 *
 	 * This method must only be called from the main thread.
 	 */
-	void Write(int num_fields, threading::Value** vals);
+	void Write(int num_fields, threading::Value** vals, bool in_arena = false);
+
+	/**
+	 * Returns the arena in which to build the values of the next write,
+	 * so that it goes to the backend along with the rest of its batch
+	 * instead of as individually allocated values. Returns null if
+	 * writes wouldn't reach a local backend anyway; values must then be
+	 * allocated individually.
+	 *
+	 * The arena stays valid until the next call to Write() or
+	 * FlushWriteBuffer(), and anything allocated from it gets released
+	 * with the batch.
+	 *
+	 * This method must only be called from the main thread.
+	 */
+	threading::ValueArena* WriteArena();
 
 	/**
 	 * Sets the buffering state.
@@ -185,11 +203,37 @@ public:
 	 */
 	const threading::Field* const * Fields() const	{ return fields; }
 
+	/**
+	 * Retrieves statistics about the writes carried out by the local
+	 * backend.
+	 *
+	 * @param stats Receives the backend's statistics.
+	 *
+	 * @param pending Receives the number of rows passed to Write() that
+	 * the backend hasn't processed yet.
+	 *
+	 * @param dropped Receives the number of rows dropped because too
+	 * many were pending.
+	 *
+	 * @param reset If true, the backend starts over with counting
+	 * afterwards.
+	 *
+	 * @return False if there's no local backend.
+	 *
+	 * This method must only be called from the main thread.
+	 */
+	bool GetWriteStats(WriterBackend::WriteStats* stats, uint64_t* pending,
+			   uint64_t* dropped, bool reset);
+
 protected:
 	friend class Manager;
 
 	void DeleteVals(int num_fields, threading::Value** vals);
 
+	// Applies log_max_pending_writes before passing on a batch. Returns
+	// false if the batch is to be dropped.
+	bool CheckBackpressure();
+
 	EnumVal* stream;
 	EnumVal* writer;
 
@@ -208,7 +252,11 @@ protected:
 	// Buffer for bulk writes.
 	static const int WRITER_BUFFER_SIZE = 1000;
 	int write_buffer_pos;	// Position of next write in buffer.
+	uint64_t rows_sent;	// Rows passed on to the backend, including buffered ones.
+	uint64_t rows_dropped;	// Rows dropped due to backpressure, since the last stats reset.
+	bool warned_dropping;	// True once we've reported dropping rows.
 	threading::Value*** write_buffer;	// Buffer of size WRITER_BUFFER_SIZE.
+	threading::ValueArena* write_arena;	// Values of the buffered writes.
 };
 
 }
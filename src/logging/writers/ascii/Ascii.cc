@@ -3,6 +3,7 @@
 #include <string>
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "threading/SerialTypes.h"
@@ -15,6 +16,8 @@ using namespace threading;
 using threading::Value;
 using threading::Field;
 
+static bool close_log_file(int fd, gzFile gzfile, ParallelGzip* pgzip, string* error);
+
 Ascii::Ascii(WriterFrontend* frontend) : WriterBackend(frontend)
 	{
 	fd = 0;
@@ -26,7 +29,11 @@ Ascii::Ascii(WriterFrontend* frontend) : WriterBackend(frontend)
 	enable_utf_8 = false;
 	formatter = 0;
 	gzip_level = 0;
+	gzip_threads = 0;
+	background_rotation = false;
 	gzfile = nullptr;
+	pgzip = nullptr;
+	stored_size = 0;
 
 	InitConfigOptions();
 	init_options = InitFilterOptions();
@@ -39,6 +46,8 @@ void Ascii::InitConfigOptions()
 	use_json = BifConst::LogAscii::use_json;
 	enable_utf_8 = BifConst::LogAscii::enable_utf_8;
 	gzip_level = BifConst::LogAscii::gzip_level;
+	gzip_threads = BifConst::LogAscii::gzip_threads;
+	background_rotation = BifConst::LogAscii::background_rotation;
 
 	separator.assign(
 			(const char*) BifConst::LogAscii::separator->Bytes(),
@@ -104,6 +113,31 @@ bool Ascii::InitFilterOptions()
 				return false;
 				}
 			}
+
+		else if ( strcmp(i->first, "gzip_threads" ) == 0 )
+			{
+			gzip_threads = atoi(i->second);
+
+			if ( gzip_threads < 0 || gzip_threads > 64 )
+				{
+				Error("invalid value for 'gzip_threads', must be a number between 0 and 64.");
+				return false;
+				}
+			}
+
+		else if ( strcmp(i->first, "background_rotation") == 0 )
+			{
+			if ( strcmp(i->second, "T") == 0 )
+				background_rotation = true;
+			else if ( strcmp(i->second, "F") == 0 )
+				background_rotation = false;
+			else
+				{
+				Error("invalid value for 'background_rotation', must be a string and either \"T\" or \"F\"");
+				return false;
+				}
+			}
+
 		else if ( strcmp(i->first, "use_json") == 0 )
 			{
 			if ( strcmp(i->second, "T") == 0 )
@@ -217,6 +251,9 @@ Ascii::~Ascii()
 		// DoFinish() may not have been called.
 		CloseFile(network_time);
 
+	// We can't report anything anymore at this point.
+	FinishPendingRotations(true, false);
+
 	delete formatter;
 	}
 
@@ -235,9 +272,11 @@ void Ascii::CloseFile(double t)
 	if ( include_meta && ! tsv )
 		WriteHeaderField("close", Timestamp(0));
 
+	UpdateStoredBytes();
 	InternalClose(fd);
 	fd = 0;
 	gzfile = nullptr;
+	pgzip = nullptr;
 	}
 
 bool Ascii::DoInit(const WriterInfo& info, int num_fields, const Field* const * fields)
@@ -265,6 +304,8 @@ bool Ascii::DoInit(const WriterInfo& info, int num_fields, const Field* const *
 		return false;
 		}
 
+	stored_size = 0;
+
 	if ( gzip_level > 0 )
 		{
 		if ( gzip_level < 0 || gzip_level > 9 )
@@ -273,21 +314,27 @@ bool Ascii::DoInit(const WriterInfo& info, int num_fields, const Field* const *
 			return false;
 			}
 
-		char mode[4];
-		snprintf(mode, sizeof(mode), "wb%d", gzip_level);
-		errno = 0; // errno will only be set under certain circumstances by gzdopen.
-		gzfile = gzdopen(fd, mode);
-
-		if ( gzfile == nullptr )
+		if ( gzip_threads > 0 )
+			pgzip = new ParallelGzip(fd, gzip_level, gzip_threads);
+		else
 			{
-			Error(Fmt("cannot gzip %s: %s", fname.c_str(),
-			                                Strerror(errno)));
-			return false;
+			char mode[4];
+			snprintf(mode, sizeof(mode), "wb%d", gzip_level);
+			errno = 0; // errno will only be set under certain circumstances by gzdopen.
+			gzfile = gzdopen(fd, mode);
+
+			if ( gzfile == nullptr )
+				{
+				Error(Fmt("cannot gzip %s: %s", fname.c_str(),
+				                                Strerror(errno)));
+				return false;
+				}
 			}
 		}
 	else
 		{
 		gzfile = nullptr;
+		pgzip = nullptr;
 		}
 
 	if ( ! WriteHeader(path) )
@@ -370,6 +417,7 @@ bool Ascii::DoFinish(double network_time)
 	ascii_done = true;
 
 	CloseFile(network_time);
+	FinishPendingRotations(true);
 
 	return true;
 	}
@@ -425,11 +473,64 @@ bool Ascii::DoRotate(const char* rotated_path, double open, double close, bool t
 		return true;
 		}
 
-	CloseFile(close);
-
 	string nname = string(rotated_path) + "." + LogExt() +
 	               (gzip_level > 0 ? ".gz" : "");
 
+	if ( background_rotation && ! terminating )
+		{
+		// Write the trailer and move the file out of the way right
+		// away, so that the next write starts a new one. Flushing
+		// out and closing the old one, which can take a while with
+		// compression, happens in a separate thread.
+		if ( include_meta && ! tsv )
+			WriteHeaderField("close", Timestamp(0));
+
+		UpdateStoredBytes();
+
+		if ( rename(fname.c_str(), nname.c_str()) != 0 )
+			{
+			char buf[256];
+			bro_strerror_r(errno, buf, sizeof(buf));
+			Error(Fmt("failed to rename %s to %s: %s", fname.c_str(),
+			          nname.c_str(), buf));
+			InternalClose(fd);
+			fd = 0;
+			gzfile = nullptr;
+			pgzip = nullptr;
+			FinishedRotation();
+			return false;
+			}
+
+		PendingRotation* r = new PendingRotation;
+		r->done = false;
+		r->ok = false;
+		r->new_name = nname;
+		r->old_name = fname;
+		r->open = open;
+		r->close = close;
+		r->terminating = terminating;
+
+		r->thread = std::thread([r, fd = fd, gzfile = gzfile, pgzip = pgzip]()
+			{
+			r->ok = close_log_file(fd, gzfile, pgzip, &r->error);
+			r->done.store(true, std::memory_order_release);
+			});
+
+		fd = 0;
+		gzfile = nullptr;
+		pgzip = nullptr;
+
+		pending_rotations.push_back(r);
+		DeferRotation();
+		return true;
+		}
+
+	// Finish earlier ones first to keep the order in which the
+	// post-processors see them.
+	FinishPendingRotations(true);
+
+	CloseFile(close);
+
 	if ( rename(fname.c_str(), nname.c_str()) != 0 )
 		{
 		char buf[256];
@@ -457,10 +558,58 @@ bool Ascii::DoSetBuf(bool enabled)
 
 bool Ascii::DoHeartbeat(double network_time, double current_time)
 	{
-	// Nothing to do.
+	FinishPendingRotations(false);
+	UpdateStoredBytes();
 	return true;
 	}
 
+void Ascii::UpdateStoredBytes()
+	{
+	// Without compression, InternalWrite() keeps track. With it, we
+	// go by how much the file has grown, which leaves out whatever the
+	// compressor still holds on to.
+	if ( ! fd || ! (gzfile || pgzip) )
+		return;
+
+	struct stat st;
+
+	if ( fstat(fd, &st) < 0 || uint64_t(st.st_size) <= stored_size )
+		return;
+
+	BytesWritten(0, st.st_size - stored_size);
+	stored_size = st.st_size;
+	}
+
+void Ascii::FinishPendingRotations(bool wait, bool report)
+	{
+	// Report them in order, so stop at the first one still running.
+	while ( ! pending_rotations.empty() )
+		{
+		PendingRotation* r = pending_rotations.front();
+
+		if ( ! wait && ! r->done.load(std::memory_order_acquire) )
+			break;
+
+		r->thread.join();
+		pending_rotations.pop_front();
+
+		if ( report )
+			{
+			if ( r->ok )
+				FinishedDeferredRotation(r->new_name.c_str(), r->old_name.c_str(),
+							 r->open, r->close, r->terminating);
+			else
+				{
+				Error(Fmt("error finishing rotated file %s: %s",
+					  r->new_name.c_str(), r->error.c_str()));
+				FinishedDeferredRotation();
+				}
+			}
+
+		delete r;
+		}
+	}
+
 string Ascii::LogExt()
 	{
 	const char* ext = zeekenv("ZEEK_LOG_SUFFIX");
@@ -497,8 +646,24 @@ string Ascii::Timestamp(double t)
 
 bool Ascii::InternalWrite(int fd, const char* data, int len)
 	{
+	if ( pgzip )
+		{
+		BytesWritten(len, 0);
+
+		if ( pgzip->Write(data, len) )
+			return true;
+
+		Error(Fmt("Ascii::InternalWrite error: %s\n", pgzip->ErrorMsg().c_str()));
+		return false;
+		}
+
 	if ( ! gzfile )
+		{
+		BytesWritten(len, len);
 		return safe_write(fd, data, len);
+		}
+
+	BytesWritten(len, 0);
 
 	while ( len > 0 )
 		{
@@ -518,8 +683,22 @@ bool Ascii::InternalWrite(int fd, const char* data, int len)
 	return true;
 	}
 
-bool Ascii::InternalClose(int fd)
+// Flushes out and closes a log file. Doesn't touch any writer state, so
+// that it can run in a separate thread.
+static bool close_log_file(int fd, gzFile gzfile, ParallelGzip* pgzip, string* error)
 	{
+	if ( pgzip )
+		{
+		bool ok = pgzip->Close();
+
+		if ( ! ok )
+			*error = "error: " + pgzip->ErrorMsg() + "\n";
+
+		delete pgzip;
+		safe_close(fd);
+		return ok;
+		}
+
 	if ( ! gzfile )
 		{
 		safe_close(fd);
@@ -533,20 +712,34 @@ bool Ascii::InternalClose(int fd)
 
 	switch ( res ) {
 	case Z_STREAM_ERROR:
-		Error("Ascii::InternalClose gzclose error: invalid file stream");
+		*error = "gzclose error: invalid file stream";
 		break;
 	case Z_BUF_ERROR:
-		Error("Ascii::InternalClose gzclose error: "
-		      "no compression progress possible during buffer flush");
+		*error = "gzclose error: no compression progress possible during buffer flush";
 		break;
 	case Z_ERRNO:
-		Error(Fmt("Ascii::InternalClose gzclose error: %s\n", Strerror(errno)));
+		{
+		char buf[256];
+		bro_strerror_r(errno, buf, sizeof(buf));
+		*error = string("gzclose error: ") + buf + "\n";
 		break;
+		}
 	default:
-		Error("Ascii::InternalClose invalid gzclose result");
+		*error = "invalid gzclose result";
 		break;
 	}
 
 	return false;
 	}
 
+bool Ascii::InternalClose(int fd)
+	{
+	string error;
+
+	if ( close_log_file(fd, gzfile, pgzip, &error) )
+		return true;
+
+	Error(Fmt("Ascii::InternalClose %s", error.c_str()));
+	return false;
+	}
+
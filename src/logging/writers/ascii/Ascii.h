@@ -5,10 +5,15 @@
 #ifndef LOGGING_WRITER_ASCII_H
 #define LOGGING_WRITER_ASCII_H
 
+#include <atomic>
+#include <list>
+#include <thread>
+
 #include "logging/WriterBackend.h"
 #include "threading/formatters/Ascii.h"
 #include "threading/formatters/JSON.h"
 #include "zlib.h"
+#include "ParallelGzip.h"
 
 namespace logging { namespace writer {
 
@@ -45,9 +50,26 @@ private:
 	bool InitFormatter();
 	bool InternalWrite(int fd, const char* data, int len);
 	bool InternalClose(int fd);
+	void UpdateStoredBytes();
+	void FinishPendingRotations(bool wait, bool report = true);
+
+	// A rotated file that a background thread is finishing up.
+	struct PendingRotation {
+		std::thread thread;
+		std::atomic<bool> done;
+		bool ok;
+		string error;
+		string new_name;
+		string old_name;
+		double open;
+		double close;
+		bool terminating;
+	};
 
 	int fd;
 	gzFile gzfile;
+	ParallelGzip* pgzip;	// Instead of gzfile if using threads.
+	uint64_t stored_size;	// Compressed size of the file reported so far.
 	string fname;
 	ODesc desc;
 	bool ascii_done;
@@ -64,12 +86,16 @@ private:
 	string meta_prefix;
 
 	int gzip_level; // level > 0 enables gzip compression
+	int gzip_threads; // > 0 compresses in that many threads
+	bool background_rotation;
 	bool use_json;
 	bool enable_utf_8;
 	string json_timestamps;
 
 	threading::formatter::Formatter* formatter;
 	bool init_options;
+
+	std::list<PendingRotation*> pending_rotations;
 };
 
 }
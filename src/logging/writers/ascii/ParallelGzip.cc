@@ -0,0 +1,213 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+
+#include "zlib.h"
+
+#include "util.h"
+#include "ParallelGzip.h"
+
+using namespace logging::writer;
+
+// Amount of data compressed as one member. Compressing blocks separately
+// costs a bit of ratio, but little at this size.
+static const size_t BLOCK_SIZE = 1024 * 1024;
+
+ParallelGzip::ParallelGzip(int arg_fd, int arg_level, int num_threads)
+	{
+	fd = arg_fd;
+	level = arg_level;
+	closed = false;
+	wrote_any = false;
+	stopping = false;
+
+	// Each worker can have one block at hand with another one waiting,
+	// which bounds the memory we use.
+	max_pending = 2 * num_threads;
+
+	for ( int i = 0; i < num_threads; ++i )
+		workers.emplace_back(&ParallelGzip::Work, this);
+	}
+
+ParallelGzip::~ParallelGzip()
+	{
+	if ( ! closed )
+		Close();
+	}
+
+bool ParallelGzip::Write(const char* data, int len)
+	{
+	if ( ! error.empty() )
+		return false;
+
+	while ( len > 0 )
+		{
+		if ( ! current )
+			{
+			current.reset(new Block);
+			current->in.reserve(BLOCK_SIZE);
+			}
+
+		size_t n = std::min(size_t(len), BLOCK_SIZE - current->in.size());
+		current->in.append(data, n);
+		data += n;
+		len -= n;
+
+		if ( current->in.size() >= BLOCK_SIZE && ! Submit() )
+			return false;
+		}
+
+	return true;
+	}
+
+bool ParallelGzip::Submit()
+	{
+	std::shared_ptr<Block> b(current.release());
+	b->done = false;
+	b->ok = false;
+
+		{
+		std::unique_lock<std::mutex> lock(mutex);
+		work.push_back(b);
+		}
+
+	have_work.notify_one();
+	pending.push_back(b);
+
+	return WriteFinished(max_pending);
+	}
+
+bool ParallelGzip::WriteFinished(size_t max)
+	{
+	while ( ! pending.empty() )
+		{
+		std::shared_ptr<Block> b = pending.front();
+
+			{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			if ( ! b->done )
+				{
+				if ( pending.size() <= max )
+					// Don't wait, there's room.
+					return true;
+
+				have_done.wait(lock, [&b]() { return b->done; });
+				}
+			}
+
+		pending.pop_front();
+
+		if ( ! b->ok )
+			{
+			error = "compression failed";
+			return false;
+			}
+
+		if ( ! safe_write(fd, b->out.data(), b->out.size()) )
+			{
+			error = strerror(errno);
+			return false;
+			}
+
+		wrote_any = true;
+		}
+
+	return true;
+	}
+
+bool ParallelGzip::Close()
+	{
+	if ( closed )
+		return error.empty();
+
+	// Even without any data, the file should end up a valid gzip file.
+	if ( ! current && ! wrote_any && pending.empty() )
+		current.reset(new Block);
+
+	bool ok = error.empty();
+
+	if ( ok && current )
+		ok = Submit();
+
+	if ( ok )
+		ok = WriteFinished(0);
+
+		{
+		std::unique_lock<std::mutex> lock(mutex);
+		stopping = true;
+		}
+
+	have_work.notify_all();
+
+	for ( auto& t : workers )
+		t.join();
+
+	workers.clear();
+	pending.clear();
+	work.clear();
+	current.reset();
+	closed = true;
+
+	return ok;
+	}
+
+void ParallelGzip::Work()
+	{
+	while ( true )
+		{
+		std::shared_ptr<Block> b;
+
+			{
+			std::unique_lock<std::mutex> lock(mutex);
+			have_work.wait(lock, [this]() { return stopping || ! work.empty(); });
+
+			if ( work.empty() )
+				return;
+
+			b = work.front();
+			work.pop_front();
+			}
+
+		bool ok = Compress(b.get());
+
+			{
+			std::unique_lock<std::mutex> lock(mutex);
+			b->ok = ok;
+			b->done = true;
+			}
+
+		have_done.notify_all();
+		}
+	}
+
+bool ParallelGzip::Compress(Block* b) const
+	{
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+
+	// 16 added to the window bits asks for a gzip header and trailer.
+	if ( deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK )
+		return false;
+
+	b->out.resize(deflateBound(&zs, b->in.size()));
+
+	zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(b->in.data()));
+	zs.avail_in = b->in.size();
+	zs.next_out = reinterpret_cast<Bytef*>(&b->out[0]);
+	zs.avail_out = b->out.size();
+
+	int rc = deflate(&zs, Z_FINISH);
+	b->out.resize(zs.total_out);
+	deflateEnd(&zs);
+
+	// Release the input right away, it may be a while until the block's
+	// turn to be written.
+	std::string().swap(b->in);
+
+	return rc == Z_STREAM_END;
+	}
@@ -0,0 +1,75 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Gzip compression spread across worker threads.
+
+#ifndef LOGGING_WRITER_PARALLELGZIP_H
+#define LOGGING_WRITER_PARALLELGZIP_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace logging { namespace writer {
+
+// Compresses what's written into a file descriptor with gzip, using a
+// number of worker threads. The data is cut into blocks that the workers
+// compress independently, each into a gzip member of its own; the members
+// go to the file in order. Gzip readers (gunzip, zcat, zlib's gzread())
+// treat such a sequence of members just like a single stream.
+//
+// An instance must only be used by one thread, usually a writer's.
+class ParallelGzip {
+public:
+	ParallelGzip(int fd, int level, int num_threads);
+	~ParallelGzip();
+
+	// Queues data for compression. Returns false if an earlier block
+	// couldn't be compressed or written.
+	bool Write(const char* data, int len);
+
+	// Compresses and writes out everything queued, and stops the
+	// workers. Doesn't close the file descriptor.
+	bool Close();
+
+	// Returns a description of the last error.
+	const std::string& ErrorMsg() const	{ return error; }
+
+private:
+	struct Block {
+		std::string in;
+		std::string out;
+		bool done;
+		bool ok;
+	};
+
+	bool Submit();
+	bool WriteFinished(size_t max_pending);
+	void Work();
+	bool Compress(Block* b) const;
+
+	int fd;
+	int level;
+	bool closed;
+	bool wrote_any;
+	std::string error;
+
+	std::unique_ptr<Block> current;	// Block being filled.
+	std::deque<std::shared_ptr<Block>> pending;	// Blocks submitted, in order.
+	size_t max_pending;
+
+	std::mutex mutex;
+	std::condition_variable have_work;
+	std::condition_variable have_done;
+	std::deque<std::shared_ptr<Block>> work;
+	bool stopping;
+	std::vector<std::thread> workers;
+};
+
+}
+}
+
+#endif
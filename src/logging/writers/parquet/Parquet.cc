@@ -0,0 +1,438 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <string>
+#include <errno.h>
+#include <stdio.h>
+
+#include <arrow/util/compression.h>
+#include <parquet/properties.h>
+
+#include "threading/SerialTypes.h"
+#include "threading/Formatter.h"
+
+#include "Parquet.h"
+#include "parquet.bif.h"
+
+using namespace logging;
+using namespace writer;
+using threading::Value;
+using threading::Field;
+using threading::formatter::Formatter;
+
+Parquet::Parquet(WriterFrontend* frontend) : WriterBackend(frontend)
+	{
+	num_rows = 0;
+	compression = arrow::Compression::UNCOMPRESSED;
+	dictionary_encoding = BifConst::LogParquet::dictionary_encoding;
+	row_group_size = BifConst::LogParquet::row_group_size;
+	}
+
+Parquet::~Parquet()
+	{
+	// DoFinish() may not have been called.
+	CloseFile();
+	}
+
+static bool parse_compression(const char* name, arrow::Compression::type* c)
+	{
+	if ( strcmp(name, "none") == 0 )
+		*c = arrow::Compression::UNCOMPRESSED;
+	else if ( strcmp(name, "snappy") == 0 )
+		*c = arrow::Compression::SNAPPY;
+	else if ( strcmp(name, "gzip") == 0 )
+		*c = arrow::Compression::GZIP;
+	else if ( strcmp(name, "zstd") == 0 )
+		*c = arrow::Compression::ZSTD;
+	else if ( strcmp(name, "lz4") == 0 )
+		*c = arrow::Compression::LZ4;
+	else if ( strcmp(name, "brotli") == 0 )
+		*c = arrow::Compression::BROTLI;
+	else
+		return false;
+
+	return arrow::util::Codec::IsAvailable(*c);
+	}
+
+bool Parquet::InitFilterOptions()
+	{
+	const WriterInfo& info = Info();
+
+	string default_compression((const char*) BifConst::LogParquet::compression->Bytes(),
+				   BifConst::LogParquet::compression->Len());
+
+	if ( ! parse_compression(default_compression.c_str(), &compression) )
+		{
+		Error(Fmt("unsupported compression '%s'", default_compression.c_str()));
+		return false;
+		}
+
+	// Set per-filter configuration options.
+	for ( WriterInfo::config_map::const_iterator i = info.config.begin();
+	      i != info.config.end(); ++i )
+		{
+		if ( strcmp(i->first, "compression") == 0 )
+			{
+			if ( ! parse_compression(i->second, &compression) )
+				{
+				Error(Fmt("unsupported compression '%s'", i->second));
+				return false;
+				}
+			}
+
+		else if ( strcmp(i->first, "dictionary_encoding") == 0 )
+			{
+			if ( strcmp(i->second, "T") == 0 )
+				dictionary_encoding = true;
+			else if ( strcmp(i->second, "F") == 0 )
+				dictionary_encoding = false;
+			else
+				{
+				Error("invalid value for 'dictionary_encoding', must be a string and either \"T\" or \"F\"");
+				return false;
+				}
+			}
+
+		else if ( strcmp(i->first, "row_group_size") == 0 )
+			{
+			char* end;
+			long long n = strtoll(i->second, &end, 10);
+
+			if ( *end || n <= 0 )
+				{
+				Error("invalid value for 'row_group_size', must be a positive number");
+				return false;
+				}
+
+			row_group_size = n;
+			}
+		}
+
+	if ( row_group_size <= 0 )
+		row_group_size = 1;
+
+	return true;
+	}
+
+std::shared_ptr<arrow::DataType> Parquet::ArrowType(TypeTag type, TypeTag subtype) const
+	{
+	switch ( type ) {
+	case TYPE_BOOL:
+		return arrow::boolean();
+
+	case TYPE_INT:
+		return arrow::int64();
+
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+		return arrow::uint64();
+
+	case TYPE_PORT:
+		// Like the other writers, we leave out the protocol.
+		return arrow::uint16();
+
+	case TYPE_DOUBLE:
+	case TYPE_INTERVAL:
+		return arrow::float64();
+
+	case TYPE_TIME:
+		return arrow::timestamp(arrow::TimeUnit::MICRO, "UTC");
+
+	case TYPE_SUBNET:
+	case TYPE_ADDR:
+	case TYPE_ENUM:
+	case TYPE_STRING:
+	case TYPE_FILE:
+	case TYPE_FUNC:
+		return arrow::utf8();
+
+	case TYPE_TABLE:
+	case TYPE_VECTOR:
+		{
+		auto element = ArrowType(subtype, TYPE_VOID);
+		return element ? arrow::list(element) : nullptr;
+		}
+
+	default:
+		return nullptr;
+	}
+	}
+
+bool Parquet::CheckStatus(const arrow::Status& status, const char* what)
+	{
+	if ( status.ok() )
+		return true;
+
+	Error(Fmt("%s %s: %s", what, fname.c_str(), status.ToString().c_str()));
+	return false;
+	}
+
+bool Parquet::DoInit(const WriterInfo& info, int num_fields, const Field* const* fields)
+	{
+	if ( ! InitFilterOptions() )
+		return false;
+
+	fname = string(info.path) + ".parquet";
+
+	std::vector<std::shared_ptr<arrow::Field>> columns;
+
+	for ( int i = 0; i < num_fields; ++i )
+		{
+		const Field* field = fields[i];
+		auto type = ArrowType(field->type, field->subtype);
+
+		if ( ! type )
+			{
+			Error(Fmt("unsupported type %s for field %s", field->TypeName().c_str(), field->name));
+			return false;
+			}
+
+		columns.push_back(arrow::field(field->name, type, field->optional));
+
+		std::unique_ptr<arrow::ArrayBuilder> builder;
+
+		if ( ! CheckStatus(arrow::MakeBuilder(arrow::default_memory_pool(), type, &builder),
+				   "cannot set up columns for") )
+			return false;
+
+		builders.push_back(std::move(builder));
+		}
+
+	schema = arrow::schema(columns);
+
+	return OpenFile();
+	}
+
+bool Parquet::OpenFile()
+	{
+	auto out = arrow::io::FileOutputStream::Open(fname);
+
+	if ( ! CheckStatus(out.status(), "cannot open") )
+		return false;
+
+	outfile = *out;
+
+	parquet::WriterProperties::Builder props;
+	props.compression(compression);
+
+	// Dictionaries pay off for the strings, which tend to repeat a lot
+	// (e.g., services, states, methods), but not for the numbers.
+	props.disable_dictionary();
+
+	if ( dictionary_encoding )
+		{
+		for ( const auto& f : schema->fields() )
+			{
+			auto id = f->type()->id();
+
+			if ( id == arrow::Type::STRING )
+				props.enable_dictionary(f->name());
+
+			else if ( id == arrow::Type::LIST )
+				props.enable_dictionary(f->name() + ".list.item");
+			}
+		}
+
+	if ( ! CheckStatus(parquet::arrow::FileWriter::Open(*schema, arrow::default_memory_pool(),
+							    outfile, props.build(),
+							    &file_writer),
+			   "cannot write to") )
+		{
+		outfile.reset();
+		return false;
+		}
+
+	return true;
+	}
+
+bool Parquet::CloseFile()
+	{
+	if ( ! file_writer )
+		return true;
+
+	bool ok = WriteRowGroup();
+	ok = CheckStatus(file_writer->Close(), "cannot finish") && ok;
+	ok = CheckStatus(outfile->Close(), "cannot close") && ok;
+
+	file_writer.reset();
+	outfile.reset();
+	return ok;
+	}
+
+bool Parquet::WriteRowGroup()
+	{
+	int64_t rows = num_rows;
+	num_rows = 0;
+
+	std::vector<std::shared_ptr<arrow::Array>> arrays;
+
+	for ( auto& b : builders )
+		{
+		std::shared_ptr<arrow::Array> a;
+
+		if ( ! CheckStatus(b->Finish(&a), "cannot build columns for") )
+			{
+			ResetBuilders();
+			return false;
+			}
+
+		// Columns that got a value of a row that didn't make it in
+		// completely are one longer than the others; drop that value.
+		if ( a->length() > rows )
+			a = a->Slice(0, rows);
+
+		arrays.push_back(a);
+		}
+
+	if ( ! rows )
+		return true;
+
+	auto table = arrow::Table::Make(schema, arrays, rows);
+
+	return CheckStatus(file_writer->WriteTable(*table, table->num_rows()),
+			   "cannot write to");
+	}
+
+void Parquet::ResetBuilders()
+	{
+	for ( auto& b : builders )
+		b->Reset();
+
+	num_rows = 0;
+	}
+
+bool Parquet::Append(arrow::ArrayBuilder* builder, const Value* val)
+	{
+	if ( ! val->present )
+		return builder->AppendNull().ok();
+
+	switch ( val->type ) {
+	case TYPE_BOOL:
+		return static_cast<arrow::BooleanBuilder*>(builder)->Append(val->val.int_val != 0).ok();
+
+	case TYPE_INT:
+		return static_cast<arrow::Int64Builder*>(builder)->Append(val->val.int_val).ok();
+
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+		return static_cast<arrow::UInt64Builder*>(builder)->Append(val->val.uint_val).ok();
+
+	case TYPE_PORT:
+		return static_cast<arrow::UInt16Builder*>(builder)->Append(val->val.port_val.port).ok();
+
+	case TYPE_DOUBLE:
+	case TYPE_INTERVAL:
+		return static_cast<arrow::DoubleBuilder*>(builder)->Append(val->val.double_val).ok();
+
+	case TYPE_TIME:
+		return static_cast<arrow::TimestampBuilder*>(builder)->Append(int64_t(val->val.double_val * 1e6)).ok();
+
+	case TYPE_SUBNET:
+		return static_cast<arrow::StringBuilder*>(builder)->Append(Formatter::Render(val->val.subnet_val)).ok();
+
+	case TYPE_ADDR:
+		return static_cast<arrow::StringBuilder*>(builder)->Append(Formatter::Render(val->val.addr_val)).ok();
+
+	case TYPE_ENUM:
+	case TYPE_STRING:
+	case TYPE_FILE:
+	case TYPE_FUNC:
+		return static_cast<arrow::StringBuilder*>(builder)->Append(val->val.string_val.data,
+									  val->val.string_val.length).ok();
+
+	case TYPE_TABLE:
+	case TYPE_VECTOR:
+		{
+		auto lb = static_cast<arrow::ListBuilder*>(builder);
+
+		if ( ! lb->Append().ok() )
+			return false;
+
+		const Value::set_t& s = (val->type == TYPE_TABLE ? val->val.set_val : val->val.vector_val);
+
+		for ( bro_int_t i = 0; i < s.size; ++i )
+			{
+			if ( ! Append(lb->value_builder(), s.vals[i]) )
+				return false;
+			}
+
+		return true;
+		}
+
+	default:
+		return false;
+	}
+	}
+
+bool Parquet::DoWrite(int num_fields, const Field* const* fields, Value** vals)
+	{
+	if ( ! file_writer && ! OpenFile() )
+		return false;
+
+	for ( int i = 0; i < num_fields; ++i )
+		{
+		if ( ! Append(builders[i].get(), vals[i]) )
+			{
+			Error(Fmt("cannot add value of field %s to %s", fields[i]->name, fname.c_str()));
+
+			// The fields before this one already have their value
+			// of the row; get rid of it so the columns stay aligned.
+			WriteRowGroup();
+			return false;
+			}
+		}
+
+	if ( ++num_rows >= row_group_size )
+		return WriteRowGroup();
+
+	return true;
+	}
+
+bool Parquet::DoFlush(double network_time)
+	{
+	// Parquet files can't be read before they're closed anyway, so
+	// there's no point in cutting row groups short here.
+	return true;
+	}
+
+bool Parquet::DoRotate(const char* rotated_path, double open, double close, bool terminating)
+	{
+	if ( ! file_writer )
+		{
+		FinishedRotation();
+		return true;
+		}
+
+	if ( ! CloseFile() )
+		{
+		FinishedRotation();
+		return false;
+		}
+
+	string nname = string(rotated_path) + ".parquet";
+
+	if ( rename(fname.c_str(), nname.c_str()) != 0 )
+		{
+		char buf[256];
+		bro_strerror_r(errno, buf, sizeof(buf));
+		Error(Fmt("failed to rename %s to %s: %s", fname.c_str(),
+		          nname.c_str(), buf));
+		FinishedRotation();
+		return false;
+		}
+
+	if ( ! FinishedRotation(nname.c_str(), fname.c_str(), open, close, terminating) )
+		{
+		Error(Fmt("error rotating %s to %s", fname.c_str(), nname.c_str()));
+		return false;
+		}
+
+	// The next write opens a new file.
+	return true;
+	}
+
+bool Parquet::DoFinish(double network_time)
+	{
+	return CloseFile();
+	}
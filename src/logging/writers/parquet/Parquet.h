@@ -0,0 +1,67 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Log writer for Apache Parquet files.
+
+#ifndef LOGGING_WRITER_PARQUET_H
+#define LOGGING_WRITER_PARQUET_H
+
+#include <memory>
+#include <vector>
+
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <parquet/arrow/writer.h>
+
+#include "logging/WriterBackend.h"
+
+namespace logging { namespace writer {
+
+// Buffers rows into one Arrow column builder per log field, and writes
+// them out as a Parquet row group whenever enough have come together.
+class Parquet : public WriterBackend {
+public:
+	explicit Parquet(WriterFrontend* frontend);
+	~Parquet() override;
+
+	static WriterBackend* Instantiate(WriterFrontend* frontend)
+		{ return new Parquet(frontend); }
+
+protected:
+	bool DoInit(const WriterInfo& info, int num_fields,
+			    const threading::Field* const* fields) override;
+	bool DoWrite(int num_fields, const threading::Field* const* fields,
+			     threading::Value** vals) override;
+	bool DoSetBuf(bool enabled) override	{ return true; }
+	bool DoRotate(const char* rotated_path, double open,
+			      double close, bool terminating) override;
+	bool DoFlush(double network_time) override;
+	bool DoFinish(double network_time) override;
+	bool DoHeartbeat(double network_time, double current_time) override	{ return true; }
+
+private:
+	bool InitFilterOptions();
+	std::shared_ptr<arrow::DataType> ArrowType(TypeTag type, TypeTag subtype) const;
+	bool OpenFile();
+	bool CloseFile();
+	bool WriteRowGroup();
+	void ResetBuilders();
+	bool Append(arrow::ArrayBuilder* builder, const threading::Value* val);
+	bool CheckStatus(const arrow::Status& status, const char* what);
+
+	string fname;
+	std::shared_ptr<arrow::Schema> schema;
+	std::vector<std::unique_ptr<arrow::ArrayBuilder>> builders;
+	std::shared_ptr<arrow::io::FileOutputStream> outfile;
+	std::unique_ptr<parquet::arrow::FileWriter> file_writer;
+	int64_t num_rows;	// Rows buffered in the builders.
+
+	// Options.
+	arrow::Compression::type compression;
+	bool dictionary_encoding;
+	int64_t row_group_size;
+};
+
+}
+}
+
+#endif
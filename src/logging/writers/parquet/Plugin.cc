@@ -0,0 +1,25 @@
+// See the file  in the main distribution directory for copyright.
+
+
+#include "plugin/Plugin.h"
+
+#include "Parquet.h"
+
+namespace plugin {
+namespace Zeek_ParquetWriter {
+
+class Plugin : public plugin::Plugin {
+public:
+	plugin::Configuration Configure() override
+		{
+		AddComponent(new ::logging::Component("Parquet", ::logging::writer::Parquet::Instantiate));
+
+		plugin::Configuration config;
+		config.name = "Zeek::ParquetWriter";
+		config.description = "Parquet log writer";
+		return config;
+		}
+} plugin;
+
+}
+}
@@ -0,0 +1,25 @@
+// See the file  in the main distribution directory for copyright.
+
+
+#include "plugin/Plugin.h"
+
+#include "Snapshot.h"
+
+namespace plugin {
+namespace Zeek_SnapshotWriter {
+
+class Plugin : public plugin::Plugin {
+public:
+	plugin::Configuration Configure() override
+		{
+		AddComponent(new ::logging::Component("Snapshot", ::logging::writer::Snapshot::Instantiate));
+
+		plugin::Configuration config;
+		config.name = "Zeek::SnapshotWriter";
+		config.description = "Binary row snapshot log writer";
+		return config;
+		}
+} plugin;
+
+}
+}
@@ -0,0 +1,229 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <string>
+#include <errno.h>
+#include <stdio.h>
+
+#include "threading/SerialTypes.h"
+#include "threading/RowFile.h"
+
+#include "Snapshot.h"
+#include "snapshot.bif.h"
+
+using namespace logging;
+using namespace writer;
+using threading::Value;
+using threading::Field;
+using threading::RowFile;
+
+Snapshot::Snapshot(WriterFrontend* frontend) : WriterBackend(frontend)
+	{
+	file = 0;
+	num_rows = 0;
+	compress = BifConst::LogSnapshot::compress;
+	block_rows = BifConst::LogSnapshot::block_rows;
+	}
+
+Snapshot::~Snapshot()
+	{
+	// DoFinish() may not have been called.
+	CloseFile();
+	}
+
+bool Snapshot::InitFilterOptions()
+	{
+	const WriterInfo& info = Info();
+
+	// Set per-filter configuration options.
+	for ( WriterInfo::config_map::const_iterator i = info.config.begin();
+	      i != info.config.end(); ++i )
+		{
+		if ( strcmp(i->first, "compress") == 0 )
+			{
+			if ( strcmp(i->second, "T") == 0 )
+				compress = true;
+			else if ( strcmp(i->second, "F") == 0 )
+				compress = false;
+			else
+				{
+				Error("invalid value for 'compress', must be a string and either \"T\" or \"F\"");
+				return false;
+				}
+			}
+
+		else if ( strcmp(i->first, "block_rows") == 0 )
+			{
+			char* end;
+			long long n = strtoll(i->second, &end, 10);
+
+			if ( *end || n <= 0 )
+				{
+				Error("invalid value for 'block_rows', must be a positive number");
+				return false;
+				}
+
+			block_rows = n;
+			}
+		}
+
+	if ( block_rows == 0 )
+		block_rows = 1;
+
+	return true;
+	}
+
+bool Snapshot::DoInit(const WriterInfo& info, int num_fields, const Field* const* fields)
+	{
+	if ( ! InitFilterOptions() )
+		return false;
+
+	fname = string(info.path) + ".snap";
+
+	return OpenFile();
+	}
+
+bool Snapshot::OpenFile()
+	{
+	file = fopen(fname.c_str(), "w");
+
+	if ( ! file )
+		{
+		char buf[256];
+		bro_strerror_r(errno, buf, sizeof(buf));
+		Error(Fmt("cannot open %s: %s", fname.c_str(), buf));
+		return false;
+		}
+
+	if ( ! RowFile::WriteHeader(file, NumFields(), Fields()) || fflush(file) != 0 )
+		{
+		char buf[256];
+		bro_strerror_r(errno, buf, sizeof(buf));
+		Error(Fmt("cannot write to %s: %s", fname.c_str(), buf));
+		fclose(file);
+		file = 0;
+		return false;
+		}
+
+	block.StartWrite();
+	num_rows = 0;
+	return true;
+	}
+
+bool Snapshot::CloseFile()
+	{
+	if ( ! file )
+		return true;
+
+	bool ok = WriteBlock();
+
+	if ( fclose(file) != 0 && ok )
+		{
+		char buf[256];
+		bro_strerror_r(errno, buf, sizeof(buf));
+		Error(Fmt("cannot close %s: %s", fname.c_str(), buf));
+		ok = false;
+		}
+
+	file = 0;
+	return ok;
+	}
+
+bool Snapshot::WriteBlock()
+	{
+	if ( ! num_rows )
+		return true;
+
+	char* data;
+	uint32 len = block.EndWrite(&data);
+	bool ok = RowFile::WriteBlock(file, data, len, num_rows, compress);
+	free(data);
+
+	block.StartWrite();
+	num_rows = 0;
+
+	if ( ! ok )
+		{
+		char buf[256];
+		bro_strerror_r(errno, buf, sizeof(buf));
+		Error(Fmt("cannot write to %s: %s", fname.c_str(), buf));
+		}
+
+	return ok;
+	}
+
+bool Snapshot::DoWrite(int num_fields, const Field* const* fields, Value** vals)
+	{
+	if ( ! file && ! OpenFile() )
+		return false;
+
+	for ( int i = 0; i < num_fields; ++i )
+		{
+		if ( ! vals[i]->Write(&block) )
+			{
+			Error(Fmt("cannot serialize value of field %s for %s", fields[i]->name, fname.c_str()));
+			return false;
+			}
+		}
+
+	if ( ++num_rows >= block_rows )
+		return WriteBlock();
+
+	return true;
+	}
+
+bool Snapshot::DoFlush(double network_time)
+	{
+	if ( ! file )
+		return true;
+
+	// Cutting the block short lets readers following the file see the
+	// rows right away.
+	if ( ! WriteBlock() )
+		return false;
+
+	fflush(file);
+	return true;
+	}
+
+bool Snapshot::DoRotate(const char* rotated_path, double open, double close, bool terminating)
+	{
+	if ( ! file )
+		{
+		FinishedRotation();
+		return true;
+		}
+
+	if ( ! CloseFile() )
+		{
+		FinishedRotation();
+		return false;
+		}
+
+	string nname = string(rotated_path) + ".snap";
+
+	if ( rename(fname.c_str(), nname.c_str()) != 0 )
+		{
+		char buf[256];
+		bro_strerror_r(errno, buf, sizeof(buf));
+		Error(Fmt("failed to rename %s to %s: %s", fname.c_str(),
+		          nname.c_str(), buf));
+		FinishedRotation();
+		return false;
+		}
+
+	if ( ! FinishedRotation(nname.c_str(), fname.c_str(), open, close, terminating) )
+		{
+		Error(Fmt("error rotating %s to %s", fname.c_str(), nname.c_str()));
+		return false;
+		}
+
+	// The next write opens a new file.
+	return true;
+	}
+
+bool Snapshot::DoFinish(double network_time)
+	{
+	return CloseFile();
+	}
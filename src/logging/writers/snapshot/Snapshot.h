@@ -0,0 +1,57 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Log writer for Zeek's binary row files.
+
+#ifndef LOGGING_WRITER_SNAPSHOT_H
+#define LOGGING_WRITER_SNAPSHOT_H
+
+#include <stdio.h>
+
+#include "logging/WriterBackend.h"
+#include "SerializationFormat.h"
+
+namespace logging { namespace writer {
+
+// Serializes rows as the threads pass them around, and writes them out as
+// a block of a threading::RowFile whenever enough have come together or
+// the log gets flushed.
+class Snapshot : public WriterBackend {
+public:
+	explicit Snapshot(WriterFrontend* frontend);
+	~Snapshot() override;
+
+	static WriterBackend* Instantiate(WriterFrontend* frontend)
+		{ return new Snapshot(frontend); }
+
+protected:
+	bool DoInit(const WriterInfo& info, int num_fields,
+			    const threading::Field* const* fields) override;
+	bool DoWrite(int num_fields, const threading::Field* const* fields,
+			     threading::Value** vals) override;
+	bool DoSetBuf(bool enabled) override	{ return true; }
+	bool DoRotate(const char* rotated_path, double open,
+			      double close, bool terminating) override;
+	bool DoFlush(double network_time) override;
+	bool DoFinish(double network_time) override;
+	bool DoHeartbeat(double network_time, double current_time) override	{ return true; }
+
+private:
+	bool InitFilterOptions();
+	bool OpenFile();
+	bool CloseFile();
+	bool WriteBlock();
+
+	string fname;
+	FILE* file;
+	BinarySerializationFormat block;	// Rows not written out yet.
+	uint32 num_rows;	// Rows in the block.
+
+	// Options.
+	bool compress;
+	uint32 block_rows;
+};
+
+}
+}
+
+#endif
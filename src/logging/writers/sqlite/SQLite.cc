@@ -18,8 +18,15 @@ using threading::Field;
 
 SQLite::SQLite(WriterFrontend* frontend)
 	: WriterBackend(frontend),
-	  fields(), num_fields(), db(), st()
+	  fields(), num_fields(), db(), st(), begin_st(), commit_st(),
+	  buffered(true), batch_rows()
 	{
+	batch_size = BifConst::LogSQLite::batch_size;
+	journal_mode.assign(
+			(const char*) BifConst::LogSQLite::journal_mode->Bytes(),
+			BifConst::LogSQLite::journal_mode->Len()
+			);
+
 	set_separator.assign(
 			(const char*) BifConst::LogSQLite::set_separator->Bytes(),
 			BifConst::LogSQLite::set_separator->Len()
@@ -43,8 +50,14 @@ SQLite::~SQLite()
 	{
 	if ( db != 0 )
 		{
+		// DoFinish() may not have been called.
+		Commit();
+
 		sqlite3_finalize(st);
-		if ( ! sqlite3_close(db) )
+		sqlite3_finalize(begin_st);
+		sqlite3_finalize(commit_st);
+
+		if ( sqlite3_close(db) != SQLITE_OK )
 			Error("Sqlite could not close connection");
 
 		db = 0;
@@ -111,6 +124,38 @@ bool SQLite::checkError(int code)
 	return false;
 	}
 
+bool SQLite::InitFilterOptions()
+	{
+	const WriterInfo& info = Info();
+
+	// Set per-filter configuration options.
+	for ( WriterInfo::config_map::const_iterator i = info.config.begin();
+	      i != info.config.end(); ++i )
+		{
+		if ( strcmp(i->first, "batch_size") == 0 )
+			{
+			char* end;
+			long long n = strtoll(i->second, &end, 10);
+
+			if ( *end || n < 0 )
+				{
+				Error("invalid value for 'batch_size', must be a number");
+				return false;
+				}
+
+			batch_size = n;
+			}
+
+		else if ( strcmp(i->first, "journal_mode") == 0 )
+			journal_mode = i->second;
+		}
+
+	if ( batch_size == 0 )
+		batch_size = 1;
+
+	return true;
+	}
+
 bool SQLite::DoInit(const WriterInfo& info, int arg_num_fields,
 			    const Field* const * arg_fields)
 	{
@@ -124,6 +169,9 @@ bool SQLite::DoInit(const WriterInfo& info, int arg_num_fields,
 	// allows simultaneous writes to one file.
 	sqlite3_enable_shared_cache(1);
 
+	if ( ! InitFilterOptions() )
+		return false;
+
 	num_fields = arg_num_fields;
 	fields = arg_fields;
 
@@ -145,11 +193,36 @@ bool SQLite::DoInit(const WriterInfo& info, int arg_num_fields,
 					&db,
 					SQLITE_OPEN_READWRITE |
 					SQLITE_OPEN_CREATE |
-					SQLITE_OPEN_NOMUTEX
+					SQLITE_OPEN_NOMUTEX |
+					// Writers in a shared cache cannot wait for
+					// each other's transactions, so we use a
+					// private one and let the busy handler wait.
+					SQLITE_OPEN_PRIVATECACHE
 					,
 					NULL)) )
 		return false;
 
+	sqlite3_busy_timeout(db, 10000);
+
+	if ( journal_mode.size() )
+		{
+		// Many connections can read a database in WAL mode while
+		// another writes it, and commits only need to sync the log.
+		string pragma = "PRAGMA journal_mode=" + journal_mode + ";";
+
+		if ( journal_mode == "wal" || journal_mode == "WAL" )
+			pragma += " PRAGMA synchronous=NORMAL;";
+
+		char *errorMsg = 0;
+		int res = sqlite3_exec(db, pragma.c_str(), NULL, NULL, &errorMsg);
+		if ( res != SQLITE_OK )
+			{
+			Error(Fmt("Error setting journal mode: %s", errorMsg));
+			sqlite3_free(errorMsg);
+			return false;
+			}
+		}
+
 	string create = "CREATE TABLE IF NOT EXISTS " + tablename + " (\n";
 		//"id SERIAL UNIQUE NOT NULL"; // SQLite has rowids, we do not need a counter here.
 
@@ -233,6 +306,33 @@ bool SQLite::DoInit(const WriterInfo& info, int arg_num_fields,
 	if ( checkError(sqlite3_prepare_v2(db, insert.c_str(), insert.size()+1, &st, NULL)) )
 		return false;
 
+	if ( checkError(sqlite3_prepare_v2(db, "BEGIN;", -1, &begin_st, NULL)) ||
+	     checkError(sqlite3_prepare_v2(db, "COMMIT;", -1, &commit_st, NULL)) )
+		return false;
+
+	return true;
+	}
+
+bool SQLite::Commit()
+	{
+	if ( ! batch_rows )
+		return true;
+
+	batch_rows = 0;
+
+	int res = sqlite3_step(commit_st);
+	sqlite3_reset(commit_st);
+
+	if ( checkError(res) )
+		{
+		// Leave no transaction behind that a later batch would
+		// run into.
+		if ( ! sqlite3_get_autocommit(db) )
+			sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+
+		return false;
+		}
+
 	return true;
 	}
 
@@ -335,6 +435,19 @@ int SQLite::AddParams(Value* val, int pos)
 
 bool SQLite::DoWrite(int num_fields, const Field* const * fields, Value** vals)
 	{
+	// Committing each row on its own would sync the database every
+	// time, so we group them into transactions.
+	if ( ! batch_rows )
+		{
+		int res = sqlite3_step(begin_st);
+		sqlite3_reset(begin_st);
+
+		if ( checkError(res) )
+			return false;
+		}
+
+	++batch_rows;
+
 	// bind parameters
 	for ( int i = 0; i < num_fields; i++ )
 		{
@@ -353,11 +466,44 @@ bool SQLite::DoWrite(int num_fields, const Field* const * fields, Value** vals)
 	if ( checkError(sqlite3_reset(st)) )
 		return false;
 
+	if ( ! buffered || batch_rows >= batch_size )
+		return Commit();
+
 	return true;
 	}
 
+bool SQLite::DoSetBuf(bool enabled)
+	{
+	buffered = enabled;
+
+	if ( ! buffered )
+		return Commit();
+
+	return true;
+	}
+
+bool SQLite::DoFlush(double network_time)
+	{
+	return Commit();
+	}
+
+bool SQLite::DoFinish(double network_time)
+	{
+	return Commit();
+	}
+
+bool SQLite::DoHeartbeat(double network_time, double current_time)
+	{
+	// Makes sure that rows don't wait for long to become visible, and
+	// that other writers to the same database get their turn.
+	return Commit();
+	}
+
 bool SQLite::DoRotate(const char* rotated_path, double open, double close, bool terminating)
 	{
+	if ( ! Commit() )
+		return false;
+
 	if ( ! FinishedRotation("/dev/null", Info().path, open, close, terminating))
 		{
 		Error(Fmt("error rotating %s", Info().path));
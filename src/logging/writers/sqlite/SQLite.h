@@ -26,15 +26,17 @@ protected:
 			    const threading::Field* const* arg_fields) override;
 	bool DoWrite(int num_fields, const threading::Field* const* fields,
 			     threading::Value** vals) override;
-	bool DoSetBuf(bool enabled) override { return true; }
+	bool DoSetBuf(bool enabled) override;
 	bool DoRotate(const char* rotated_path, double open,
 			      double close, bool terminating) override;
-	bool DoFlush(double network_time) override { return true; }
-	bool DoFinish(double network_time) override { return true; }
-	bool DoHeartbeat(double network_time, double current_time) override { return true; }
+	bool DoFlush(double network_time) override;
+	bool DoFinish(double network_time) override;
+	bool DoHeartbeat(double network_time, double current_time) override;
 
 private:
 	bool checkError(int code);
+	bool InitFilterOptions();
+	bool Commit();
 
 	int AddParams(threading::Value* val, int pos);
 	string GetTableType(int, int);
@@ -44,6 +46,13 @@ private:
 
 	sqlite3 *db;
 	sqlite3_stmt *st;
+	sqlite3_stmt *begin_st;
+	sqlite3_stmt *commit_st;
+
+	bool buffered;
+	uint64 batch_size;	// Rows per transaction.
+	uint64 batch_rows;	// Rows in the open transaction, if any.
+	string journal_mode;
 
 	string set_separator;
 	string unset_field;
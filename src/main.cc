@@ -26,6 +26,7 @@ extern "C" {
 #include "DNS_Mgr.h"
 #include "Frame.h"
 #include "Scope.h"
+#include "ScriptOpt.h"
 #include "Event.h"
 #include "File.h"
 #include "Reporter.h"
@@ -40,10 +41,13 @@ extern "C" {
 #include "Anon.h"
 #include "EventRegistry.h"
 #include "Stats.h"
+#include "GlobalSnapshot.h"
+#include "EventRecorder.h"
 #include "Brofiler.h"
 #include "Traverse.h"
 
 #include "threading/Manager.h"
+#include "threading/Affinity.h"
 #include "input/Manager.h"
 #include "logging/Manager.h"
 #include "logging/writers/ascii/Ascii.h"
@@ -115,10 +119,14 @@ OpaqueType* sha256_type = 0;
 OpaqueType* entropy_type = 0;
 OpaqueType* cardinality_type = 0;
 OpaqueType* topk_type = 0;
+OpaqueType* countmin_type = 0;
 OpaqueType* bloomfilter_type = 0;
 OpaqueType* x509_opaque_type = 0;
 OpaqueType* ocsp_resp_opaque_type = 0;
 OpaqueType* paraglob_type = 0;
+OpaqueType* stream_matcher_type = 0;
+OpaqueType* intel_index_type = 0;
+OpaqueType* aggregator_type = 0;
 
 // Keep copy of command line
 int bro_argc;
@@ -195,6 +203,7 @@ void usage(int code = 1)
 	fprintf(stderr, "    $ZEEKPATH                      | file search path (%s)\n", bro_path().c_str());
 	fprintf(stderr, "    $ZEEK_PLUGIN_PATH              | plugin search path (%s)\n", bro_plugin_path());
 	fprintf(stderr, "    $ZEEK_PLUGIN_ACTIVATE          | plugins to always activate (%s)\n", bro_plugin_activate());
+	fprintf(stderr, "    $ZEEK_PLUGIN_CACHE             | file caching the plugins found on the search path (%s)\n", zeekenv("ZEEK_PLUGIN_CACHE") ? zeekenv("ZEEK_PLUGIN_CACHE") : "not set");
 	fprintf(stderr, "    $ZEEK_PREFIXES                 | prefix list (%s)\n", bro_prefixes().c_str());
 	fprintf(stderr, "    $ZEEK_DNS_FAKE                 | disable DNS lookups (%s)\n", bro_dns_fake() ? "on" : "off");
 	fprintf(stderr, "    $ZEEK_SEED_FILE                | file to load seeds from (not set)\n");
@@ -202,6 +211,8 @@ void usage(int code = 1)
 	fprintf(stderr, "    $ZEEK_PROFILER_FILE            | Output file for script execution statistics (not set)\n");
 	fprintf(stderr, "    $ZEEK_DISABLE_ZEEKYGEN         | Disable Zeekygen documentation support (%s)\n", zeekenv("ZEEK_DISABLE_ZEEKYGEN") ? "set" : "not set");
 	fprintf(stderr, "    $ZEEK_DNS_RESOLVER             | IPv4/IPv6 address of DNS resolver to use (%s)\n", zeekenv("ZEEK_DNS_RESOLVER") ? zeekenv("ZEEK_DNS_RESOLVER") : "not set, will use first IPv4 address from /etc/resolv.conf");
+	fprintf(stderr, "    $ZEEK_FAST_HASH                | Hash table keys with a faster, non-cryptographic hash (%s)\n", zeekenv("ZEEK_FAST_HASH") ? "set" : "not set");
+	fprintf(stderr, "    $ZEEK_TIMER_WHEEL              | Manage timers with a timing wheel (%s)\n", zeekenv("ZEEK_TIMER_WHEEL") ? "set" : "not set");
 
 	fprintf(stderr, "\n");
 
@@ -315,6 +326,13 @@ void terminate_bro()
 
 	brofiler.WriteStats();
 
+	if ( rule_matcher && BifConst::signature_dfa_state_file->Len() )
+		rule_matcher->SaveDFAStates(BifConst::signature_dfa_state_file->CheckString());
+
+	// Same as with zeek_init(), replay raises zeek_done() itself.
+	delete event_recorder;
+	event_recorder = 0;
+
 	EventHandlerPtr zeek_done = internal_handler("zeek_done");
 	if ( zeek_done )
 		mgr.QueueEventFast(zeek_done, val_list{});
@@ -708,7 +726,10 @@ int main(int argc, char** argv)
 	createCurrentDoc("1.0");		// Set a global XML document
 #endif
 
-	timer_mgr = new PQ_TimerMgr("<GLOBAL>");
+	if ( zeekenv("ZEEK_TIMER_WHEEL") )
+		timer_mgr = new TW_TimerMgr("<GLOBAL>");
+	else
+		timer_mgr = new PQ_TimerMgr("<GLOBAL>");
 	// timer_mgr = new CQ_TimerMgr();
 
 	zeekygen_mgr = new zeekygen::Manager(zeekygen_config, bro_argv[0]);
@@ -784,10 +805,14 @@ int main(int argc, char** argv)
 	entropy_type = new OpaqueType("entropy");
 	cardinality_type = new OpaqueType("cardinality");
 	topk_type = new OpaqueType("topk");
+	countmin_type = new OpaqueType("countmin");
 	bloomfilter_type = new OpaqueType("bloomfilter");
 	x509_opaque_type = new OpaqueType("x509");
 	ocsp_resp_opaque_type = new OpaqueType("ocsp_resp");
 	paraglob_type = new OpaqueType("paraglob");
+	stream_matcher_type = new OpaqueType("stream_matcher");
+	intel_index_type = new OpaqueType("intel_index");
+	aggregator_type = new OpaqueType("aggregator");
 
 	// The leak-checker tends to produce some false
 	// positives (memory which had already been
@@ -840,6 +865,16 @@ int main(int argc, char** argv)
 	file_mgr->InitPostScript();
 	dns_mgr->InitPostScript();
 
+	// After the broker's threads have started, so that they don't
+	// inherit the main thread's CPUs.
+	const auto& main_placement = threading::thread_placement(threading::THREAD_MAIN);
+
+	if ( ! main_placement.Empty() )
+		{
+		threading::apply_cpu_affinity(pthread_self(), main_placement, "main");
+		threading::apply_memory_policy(main_placement);
+		}
+
 	if ( parse_only )
 		{
 		int rc = (reporter->Errors() > 0 ? 1 : 0);
@@ -895,6 +930,9 @@ int main(int argc, char** argv)
 		if ( rule_debug )
 			rule_matcher->PrintDebug();
 
+		if ( BifConst::signature_dfa_state_file->Len() )
+			rule_matcher->LoadDFAStates(BifConst::signature_dfa_state_file->CheckString());
+
 		file_mgr->InitMagic();
 		}
 
@@ -978,6 +1016,14 @@ int main(int argc, char** argv)
 		// we don't have any other source for it.
 		net_update_time(current_time());
 
+	// Constants may still have been changed up to here, e.g. by
+	// command-line options, so this has to come last.
+	if ( BifConst::fold_script_constants && ! g_policy_debug )
+		fold_script_constants();
+
+	if ( BifConst::global_snapshot_file->Len() )
+		restore_global_snapshot(BifConst::global_snapshot_file->CheckString());
+
 	EventHandlerPtr zeek_init = internal_handler("zeek_init");
 	if ( zeek_init )	//### this should be a function
 		mgr.QueueEventFast(zeek_init, val_list{});
@@ -1037,8 +1083,17 @@ int main(int argc, char** argv)
 	if ( reporter->Errors() > 0 && ! zeekenv("ZEEK_ALLOW_INIT_ERRORS") )
 		reporter->FatalError("errors occurred while initializing");
 
+	if ( BifConst::global_snapshot_file->Len() && ! global_snapshot_restored() )
+		save_global_snapshot(BifConst::global_snapshot_file->CheckString());
+
+	// Start recording only now, as zeek_init() gets raised on replay
+	// anyway.
+	if ( BifConst::event_record_file->Len() )
+		event_recorder = new EventRecorder(BifConst::event_record_file->CheckString());
+
 	broker_mgr->ZeekInitDone();
 	reporter->ZeekInitDone();
+	analyzer_mgr->DisableUnusedAnalyzers();
 	analyzer_mgr->DumpDebug();
 
 	have_pending_timers = ! reading_traces && timer_mgr->Size() > 0;
@@ -9,11 +9,109 @@
 
 #include <arpa/inet.h>
 
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include "Reporter.h"
 #include "net_util.h"
 #include "IPAddr.h"
 #include "IP.h"
 
+// Adds up the 32-bit little-endian words in [p, p + n) into 64 bits,
+// n being a multiple of 8. Since 2^16 = 1 (mod 2^16 - 1), that's
+// congruent to adding up the 16-bit words, and so folds down to the
+// same ones-complement sum.
+#if defined(__AVX2__)
+static uint64 add_words(const unsigned char* p, int n)
+	{
+	__m256i acc = _mm256_setzero_si256();
+
+	for ( ; n >= 32; p += 32, n -= 32 )
+		{
+		__m256i v = _mm256_loadu_si256((const __m256i*) p);
+		acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(v)));
+		acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(v, 1)));
+		}
+
+	uint64 lanes[4];
+	_mm256_storeu_si256((__m256i*) lanes, acc);
+	uint64 sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+	for ( ; n > 0; p += 8, n -= 8 )
+		{
+		uint64 w;
+		memcpy(&w, p, sizeof(w));
+		sum += (w & 0xffffffff) + (w >> 32);
+		}
+
+	return sum;
+	}
+#elif defined(__SSE2__)
+static uint64 add_words(const unsigned char* p, int n)
+	{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i acc = zero;
+
+	for ( ; n >= 16; p += 16, n -= 16 )
+		{
+		__m128i v = _mm_loadu_si128((const __m128i*) p);
+		acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, zero));
+		acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, zero));
+		}
+
+	uint64 lanes[2];
+	_mm_storeu_si128((__m128i*) lanes, acc);
+	uint64 sum = lanes[0] + lanes[1];
+
+	if ( n > 0 )
+		{
+		uint64 w;
+		memcpy(&w, p, sizeof(w));
+		sum += (w & 0xffffffff) + (w >> 32);
+		}
+
+	return sum;
+	}
+#elif defined(__ARM_NEON)
+static uint64 add_words(const unsigned char* p, int n)
+	{
+	uint64x2_t acc = vdupq_n_u64(0);
+
+	for ( ; n >= 16; p += 16, n -= 16 )
+		acc = vpadalq_u32(acc, vreinterpretq_u32_u8(vld1q_u8(p)));
+
+	uint64 sum = vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+
+	if ( n > 0 )
+		{
+		uint64 w;
+		memcpy(&w, p, sizeof(w));
+		sum += (w & 0xffffffff) + (w >> 32);
+		}
+
+	return sum;
+	}
+#else
+static uint64 add_words(const unsigned char* p, int n)
+	{
+	uint64 sum = 0;
+
+	for ( ; n > 0; p += 8, n -= 8 )
+		{
+		uint64 w;
+		memcpy(&w, p, sizeof(w));
+		sum += (w & 0xffffffff) + (w >> 32);
+		}
+
+	return sum;
+	}
+#endif
+
 // - adapted from tcpdump
 // Returns the ones-complement checksum of a chunk of b short-aligned bytes.
 int ones_complement_checksum(const void* p, int b, uint32 sum)
@@ -22,17 +120,28 @@ int ones_complement_checksum(const void* p, int b, uint32 sum)
 
 	b /= 2;	// convert to count of short's
 
+	uint64 wide_sum = sum;
+
+#ifndef WORDS_BIGENDIAN
+	// The words are added up as little-endian ones below, which is what
+	// add_words() sees on such hosts.
+	int wide = (b / 4) * 8;
+	wide_sum += add_words(sp, wide);
+	sp += wide;
+	b -= wide / 2;
+#endif
+
 	/* No need for endian conversions. */
 	while ( --b >= 0 )
 		{
-		sum += *sp + (*(sp+1) << 8);
+		wide_sum += *sp + (*(sp+1) << 8);
 		sp += 2;
 		}
 
-	while ( sum > 0xffff )
-		sum = (sum & 0xffff) + (sum >> 16);
+	while ( wide_sum > 0xffff )
+		wide_sum = (wide_sum & 0xffff) + (wide_sum >> 16);
 
-	return sum;
+	return wide_sum;
 	}
 
 int ones_complement_checksum(const IPAddr& a, uint32 sum)
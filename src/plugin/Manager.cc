@@ -7,6 +7,7 @@
 #include <dlfcn.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include "Manager.h"
 
@@ -40,10 +41,32 @@ Manager::~Manager()
 	delete [] hooks;
 	}
 
+// First line of a plugin cache file.
+static const char* PLUGIN_CACHE_MAGIC = "zeek-plugin-cache 1";
+
 void Manager::SearchDynamicPlugins(const std::string& dir)
 	{
 	assert(! init);
 
+	if ( dir.empty() )
+		return;
+
+	const char* cache = zeekenv("ZEEK_PLUGIN_CACHE");
+
+	if ( cache && *cache && LoadPluginCache(cache, dir) )
+		return;
+
+	scanned_paths.clear();
+	found_plugins.clear();
+
+	ScanDynamicPlugins(dir);
+
+	if ( cache && *cache )
+		SavePluginCache(cache, dir);
+	}
+
+void Manager::ScanDynamicPlugins(const std::string& dir)
+	{
 	if ( dir.empty() )
 		return;
 
@@ -54,12 +77,23 @@ void Manager::SearchDynamicPlugins(const std::string& dir)
 		std::string d;
 
 		while ( std::getline(s, d, ':') )
-			SearchDynamicPlugins(d);
+			ScanDynamicPlugins(d);
 
 		return;
 		}
 
-	if ( ! is_dir(dir) )
+	struct stat st;
+
+	if ( stat(dir.c_str(), &st) < 0 )
+		{
+		scanned_paths.push_back(std::make_pair(dir, time_t(-1)));
+		DBG_LOG(DBG_PLUGINS, "Not a valid plugin directory: %s", dir.c_str());
+		return;
+		}
+
+	scanned_paths.push_back(std::make_pair(dir, st.st_mtime));
+
+	if ( ! S_ISDIR(st.st_mode) )
 		{
 		DBG_LOG(DBG_PLUGINS, "Not a valid plugin directory: %s", dir.c_str());
 		return;
@@ -80,21 +114,15 @@ void Manager::SearchDynamicPlugins(const std::string& dir)
 		std::string name;
 		std::getline(in, name);
 		strstrip(name);
-		string lower_name = strtolower(name);
 
 		if ( name.empty() )
 			reporter->FatalError("empty plugin magic file %s", magic.c_str());
 
-		if ( dynamic_plugins.find(lower_name) != dynamic_plugins.end() )
-			{
-			DBG_LOG(DBG_PLUGINS, "Found already known plugin %s in %s, ignoring", name.c_str(), dir.c_str());
-			return;
-			}
-
-		// Record it, so that we can later activate it.
-		dynamic_plugins.insert(std::make_pair(lower_name, dir));
+		if ( stat(magic.c_str(), &st) == 0 )
+			scanned_paths.push_back(std::make_pair(magic, st.st_mtime));
 
-		DBG_LOG(DBG_PLUGINS, "Found plugin %s in %s", name.c_str(), dir.c_str());
+		found_plugins.push_back(std::make_pair(name, dir));
+		AddDynamicPlugin(name, dir);
 		return;
 		}
 
@@ -108,14 +136,10 @@ void Manager::SearchDynamicPlugins(const std::string& dir)
 		return;
 		}
 
-	bool found = false;
-
 	struct dirent *dp;
 
 	while ( (dp = readdir(d)) )
 		{
-		struct stat st;
-
 		if ( strcmp(dp->d_name, "..") == 0
 		     || strcmp(dp->d_name, ".") == 0 )
 			continue;
@@ -129,12 +153,136 @@ void Manager::SearchDynamicPlugins(const std::string& dir)
 			}
 
 		if ( st.st_mode & S_IFDIR )
-			SearchDynamicPlugins(path);
+			ScanDynamicPlugins(path);
 		}
 
 	closedir(d);
 	}
 
+void Manager::AddDynamicPlugin(const std::string& name, const std::string& dir)
+	{
+	string lower_name = strtolower(name);
+
+	if ( dynamic_plugins.find(lower_name) != dynamic_plugins.end() )
+		{
+		DBG_LOG(DBG_PLUGINS, "Found already known plugin %s in %s, ignoring", name.c_str(), dir.c_str());
+		return;
+		}
+
+	// Record it, so that we can later activate it.
+	dynamic_plugins.insert(std::make_pair(lower_name, dir));
+
+	DBG_LOG(DBG_PLUGINS, "Found plugin %s in %s", name.c_str(), dir.c_str());
+	}
+
+bool Manager::LoadPluginCache(const std::string& cache, const std::string& dir)
+	{
+	std::ifstream in(cache.c_str());
+
+	if ( in.fail() )
+		return false;
+
+	std::string line;
+
+	if ( ! (std::getline(in, line) && line == PLUGIN_CACHE_MAGIC) )
+		return false;
+
+	if ( ! (std::getline(in, line) && line == "search\t" + dir) )
+		{
+		DBG_LOG(DBG_PLUGINS, "Plugin cache %s is for a different search path", cache.c_str());
+		return false;
+		}
+
+	std::vector<std::pair<std::string, std::string> > plugins;
+
+	// Each further line is a tab-separated triple of either "path",
+	// modification time and path, or "plugin", name and directory.
+	while ( std::getline(in, line) )
+		{
+		string::size_type i = line.find('\t');
+		string::size_type j = i == string::npos ? i : line.find('\t', i + 1);
+
+		if ( j == string::npos )
+			{
+			DBG_LOG(DBG_PLUGINS, "Plugin cache %s is corrupt", cache.c_str());
+			return false;
+			}
+
+		std::string kind = line.substr(0, i);
+		std::string arg = line.substr(i + 1, j - i - 1);
+		std::string path = line.substr(j + 1);
+
+		if ( kind == "plugin" )
+			{
+			plugins.push_back(std::make_pair(arg, path));
+			continue;
+			}
+
+		if ( kind != "path" )
+			{
+			DBG_LOG(DBG_PLUGINS, "Plugin cache %s is corrupt", cache.c_str());
+			return false;
+			}
+
+		struct stat st;
+		time_t mtime = stat(path.c_str(), &st) < 0 ? time_t(-1) : st.st_mtime;
+
+		if ( std::to_string(mtime) != arg )
+			{
+			DBG_LOG(DBG_PLUGINS, "Plugin cache %s is out of date: %s changed", cache.c_str(), path.c_str());
+			return false;
+			}
+		}
+
+	DBG_LOG(DBG_PLUGINS, "Using plugin cache %s", cache.c_str());
+
+	for ( const auto& p : plugins )
+		AddDynamicPlugin(p.first, p.second);
+
+	return true;
+	}
+
+void Manager::SavePluginCache(const std::string& cache, const std::string& dir)
+	{
+	// Modification times have a resolution of a second, so we wouldn't
+	// notice changes made in the same second as the scan.
+	time_t now = time(0);
+
+	for ( const auto& p : scanned_paths )
+		{
+		if ( p.second >= now - 1 )
+			{
+			DBG_LOG(DBG_PLUGINS, "Not writing plugin cache, %s changed too recently", p.first.c_str());
+			return;
+			}
+		}
+
+	// Write to a temporary file first so that concurrent starts never
+	// see a partial cache.
+	std::string tmp = fmt("%s.%d.tmp", cache.c_str(), getpid());
+	std::ofstream out(tmp.c_str());
+
+	out << PLUGIN_CACHE_MAGIC << "\n";
+	out << "search\t" << dir << "\n";
+
+	for ( const auto& p : scanned_paths )
+		out << "path\t" << p.second << "\t" << p.first << "\n";
+
+	for ( const auto& p : found_plugins )
+		out << "plugin\t" << p.first << "\t" << p.second << "\n";
+
+	out.close();
+
+	if ( out.fail() || rename(tmp.c_str(), cache.c_str()) < 0 )
+		{
+		DBG_LOG(DBG_PLUGINS, "Cannot write plugin cache %s: %s", cache.c_str(), strerror(errno));
+		unlink(tmp.c_str());
+		return;
+		}
+
+	DBG_LOG(DBG_PLUGINS, "Wrote plugin cache %s", cache.c_str());
+	}
+
 bool Manager::ActivateDynamicPluginInternal(const std::string& name, bool ok_if_not_found)
 	{
 	dynamic_plugin_map::iterator m = dynamic_plugins.find(strtolower(name));
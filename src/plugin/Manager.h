@@ -5,6 +5,7 @@
 
 #include <utility>
 #include <map>
+#include <vector>
 
 #include "Plugin.h"
 #include "Component.h"
@@ -68,6 +69,12 @@ public:
 	 *
 	 * This must be called only before InitPluginsPreScript().
 	 *
+	 * If the ZEEK_PLUGIN_CACHE environment variable names a file, the
+	 * method records what it finds there, along with the modification
+	 * times of all directories it looked at. Later searches of the same
+	 * directories take the plugins from that file rather than scanning
+	 * again as long as none of those times changed.
+	 *
 	 * @param dir The directory to search for plugins. Multiple directories
 	 * can be given by splitting them with ':'.
 	 */
@@ -414,6 +421,28 @@ private:
 	void MetaHookPre(HookType hook, const HookArgumentList& args) const;
 	void MetaHookPost(HookType hook, const HookArgumentList& args, HookArgument result) const;
 
+	// Scans a directory for plugins, recursively. Each path looked at
+	// gets recorded in scanned_paths and each plugin in found_plugins.
+	void ScanDynamicPlugins(const std::string& dir);
+
+	// Makes a plugin found in a directory available for activation,
+	// unless one of the same name is already known.
+	void AddDynamicPlugin(const std::string& name, const std::string& dir);
+
+	// Takes the plugins from a cache file if it's for the same search
+	// path and still up to date. Returns false if not.
+	bool LoadPluginCache(const std::string& cache, const std::string& dir);
+
+	// Writes what the last scan found to a cache file.
+	void SavePluginCache(const std::string& cache, const std::string& dir);
+
+	// Paths looked at during a scan with their modification times, or
+	// -1 if they didn't exist.
+	std::vector<std::pair<std::string, time_t> > scanned_paths;
+
+	// Plugins found during a scan, as pairs of name and directory.
+	std::vector<std::pair<std::string, std::string> > found_plugins;
+
 	 // All found dynamic plugins, mapping their names to base directory.
 	typedef std::map<std::string, std::string> dynamic_plugin_map;
 	dynamic_plugin_map dynamic_plugins;
@@ -0,0 +1,339 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <broker/error.hh>
+
+#include "probabilistic/Aggregator.h"
+#include "probabilistic/CardinalityCounter.h"
+#include "probabilistic/Topk.h"
+#include "NetVar.h"
+#include "Reporter.h"
+
+namespace probabilistic {
+
+static const struct {
+	const char* name;
+	int calc;
+} calculations[] = {
+	{ "SUM", AggregatorVal::CALC_SUM },
+	{ "MIN", AggregatorVal::CALC_MIN },
+	{ "MAX", AggregatorVal::CALC_MAX },
+	{ "AVERAGE", AggregatorVal::CALC_AVERAGE },
+	{ "VARIANCE", AggregatorVal::CALC_VARIANCE },
+	{ "STD_DEV", AggregatorVal::CALC_STD_DEV },
+	{ "HLL_UNIQUE", AggregatorVal::CALC_HLL_UNIQUE },
+	{ "TOPK", AggregatorVal::CALC_TOPK },
+};
+
+// ResultVal fields the calculations fill in, in the order of the above.
+static const char* result_fields[] = {
+	"sum", "min", "max", "average", "variance", "std_dev", "hll_unique", "topk",
+};
+
+static const int num_calculations = sizeof(calculations) / sizeof(calculations[0]);
+
+static bool serialize_opaque(broker::vector* d, const OpaqueVal* v)
+	{
+	if ( ! v )
+		{
+		d->emplace_back(broker::none());
+		return true;
+		}
+
+	auto s = v->Serialize();
+	if ( ! s )
+		return false;
+
+	d->emplace_back(std::move(*s));
+	return true;
+	}
+
+template<typename T>
+static T* unserialize_opaque(const broker::data& data)
+	{
+	OpaqueVal* o = OpaqueVal::Unserialize(data);
+	T* t = dynamic_cast<T*>(o);
+
+	if ( ! t )
+		Unref(o);
+
+	return t;
+	}
+
+AggregatorVal::AggregatorVal() : OpaqueVal(aggregator_type)
+	{
+	calcs = 0;
+	num = 0;
+	sum = min = max = mean = m2 = 0.0;
+	card = 0;
+	topk = 0;
+	}
+
+AggregatorVal::AggregatorVal(int arg_calcs, double hll_error_margin,
+			     double hll_confidence, uint64 topk_size)
+	: OpaqueVal(aggregator_type)
+	{
+	calcs = arg_calcs;
+	num = 0;
+	sum = min = max = mean = m2 = 0.0;
+	card = 0;
+	topk = 0;
+
+	if ( calcs & CALC_HLL_UNIQUE )
+		card = new CardinalityVal(new CardinalityCounter(hll_error_margin,
+								 hll_confidence));
+
+	if ( calcs & CALC_TOPK )
+		topk = new TopkVal(topk_size);
+	}
+
+AggregatorVal::~AggregatorVal()
+	{
+	Unref(card);
+	Unref(topk);
+	}
+
+int AggregatorVal::CalculationByName(const char* name)
+	{
+	const char* sep = strstr(name, "::");
+
+	if ( sep )
+		name = sep + 2;
+
+	for ( int i = 0; i < num_calculations; ++i )
+		{
+		if ( strcmp(calculations[i].name, name) == 0 )
+			return calculations[i].calc;
+		}
+
+	return 0;
+	}
+
+void AggregatorVal::Observe(double val, Val* obs)
+	{
+	++num;
+	sum += val;
+
+	if ( num == 1 || val < min )
+		min = val;
+
+	if ( num == 1 || val > max )
+		max = val;
+
+	// Welford's method.
+	double delta = val - mean;
+	mean += delta / num;
+	m2 += delta * (val - mean);
+
+	if ( card )
+		{
+		if ( ! card->Type() )
+			card->Typify(obs->Type());
+
+		if ( same_type(card->Type(), obs->Type()) )
+			card->Add(obs);
+		}
+
+	if ( topk )
+		topk->Encountered(obs);
+	}
+
+bool AggregatorVal::Merge(const AggregatorVal* other)
+	{
+	if ( calcs != other->calcs )
+		return false;
+
+	if ( card && card->Type() && other->card->Type() &&
+	     ! same_type(card->Type(), other->card->Type()) )
+		return false;
+
+	if ( card && ! card->Get()->Merge(other->card->Get()) )
+		return false;
+
+	if ( card && ! card->Type() && other->card->Type() )
+		card->Typify(other->card->Type());
+
+	if ( topk )
+		topk->Merge(other->topk);
+
+	if ( ! other->num )
+		return true;
+
+	if ( ! num )
+		{
+		min = other->min;
+		max = other->max;
+		}
+	else
+		{
+		min = std::min(min, other->min);
+		max = std::max(max, other->max);
+		}
+
+	// Chan et al.'s method for combining the variances of two sets.
+	uint64 n = num + other->num;
+	double delta = other->mean - mean;
+	m2 += other->m2 + delta * delta * num * other->num / n;
+	mean += delta * other->num / n;
+	sum += other->sum;
+	num = n;
+
+	return true;
+	}
+
+void AggregatorVal::Fill(RecordVal* rv) const
+	{
+	static RecordType* last_type = 0;
+	static int offsets[num_calculations];
+
+	RecordType* rt = rv->Type()->AsRecordType();
+
+	if ( rt != last_type )
+		{
+		for ( int i = 0; i < num_calculations; ++i )
+			offsets[i] = rt->FieldOffset(result_fields[i]);
+
+		last_type = rt;
+		}
+
+	double variance = num > 1 ? m2 / (num - 1) : 0.0;
+
+	for ( int i = 0; i < num_calculations; ++i )
+		{
+		int calc = calculations[i].calc;
+		int offset = offsets[i];
+
+		if ( ! (calcs & calc) || offset < 0 )
+			continue;
+
+		Val* v = 0;
+
+		switch ( calc ) {
+		case CALC_SUM:
+			v = new Val(sum, TYPE_DOUBLE);
+			break;
+
+		case CALC_MIN:
+			if ( num )
+				v = new Val(min, TYPE_DOUBLE);
+			break;
+
+		case CALC_MAX:
+			if ( num )
+				v = new Val(max, TYPE_DOUBLE);
+			break;
+
+		case CALC_AVERAGE:
+			if ( num )
+				v = new Val(mean, TYPE_DOUBLE);
+			break;
+
+		case CALC_VARIANCE:
+			if ( num )
+				v = new Val(variance, TYPE_DOUBLE);
+			break;
+
+		case CALC_STD_DEV:
+			v = new Val(sqrt(variance), TYPE_DOUBLE);
+			break;
+
+		case CALC_HLL_UNIQUE:
+			{
+			// An empty counter estimates a negative size.
+			double size = num ? card->Get()->Size() : 0.0;
+			v = val_mgr->GetCount(bro_uint_t(rint(std::max(size, 0.0))));
+			break;
+			}
+
+		case CALC_TOPK:
+			v = topk->Ref();
+			break;
+		}
+
+		if ( v )
+			rv->Assign(offset, v);
+		}
+	}
+
+Val* AggregatorVal::DoClone(CloneState* state)
+	{
+	AggregatorVal* v = new AggregatorVal();
+	v->calcs = calcs;
+	v->num = num;
+	v->sum = sum;
+	v->min = min;
+	v->max = max;
+	v->mean = mean;
+	v->m2 = m2;
+
+	if ( card )
+		{
+		// Cloning a counter doesn't carry over its element type.
+		v->card = static_cast<CardinalityVal*>(card->Clone());
+
+		if ( card->Type() )
+			v->card->Typify(card->Type());
+		}
+
+	if ( topk )
+		v->topk = static_cast<TopkVal*>(topk->Clone());
+
+	return state->NewClone(this, v);
+	}
+
+IMPLEMENT_OPAQUE_VALUE(AggregatorVal)
+
+broker::expected<broker::data> AggregatorVal::DoSerialize() const
+	{
+	broker::vector d = {
+		static_cast<uint64_t>(calcs), static_cast<uint64_t>(num),
+		sum, min, max, mean, m2,
+	};
+
+	if ( ! (serialize_opaque(&d, card) && serialize_opaque(&d, topk)) )
+		return broker::ec::invalid_data;
+
+	return {std::move(d)};
+	}
+
+bool AggregatorVal::DoUnserialize(const broker::data& data)
+	{
+	auto v = caf::get_if<broker::vector>(&data);
+
+	if ( ! (v && v->size() == 9) )
+		return false;
+
+	auto c = caf::get_if<uint64_t>(&(*v)[0]);
+	auto n = caf::get_if<uint64_t>(&(*v)[1]);
+	auto s = caf::get_if<double>(&(*v)[2]);
+	auto mi = caf::get_if<double>(&(*v)[3]);
+	auto ma = caf::get_if<double>(&(*v)[4]);
+	auto me = caf::get_if<double>(&(*v)[5]);
+	auto m = caf::get_if<double>(&(*v)[6]);
+
+	if ( ! (c && n && s && mi && ma && me && m) )
+		return false;
+
+	calcs = *c;
+	num = *n;
+	sum = *s;
+	min = *mi;
+	max = *ma;
+	mean = *me;
+	m2 = *m;
+
+	if ( (calcs & CALC_HLL_UNIQUE) &&
+	     ! (card = unserialize_opaque<CardinalityVal>((*v)[7])) )
+		return false;
+
+	if ( (calcs & CALC_TOPK) &&
+	     ! (topk = unserialize_opaque<TopkVal>((*v)[8])) )
+		return false;
+
+	return true;
+	}
+
+}
@@ -0,0 +1,107 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef PROBABILISTIC_AGGREGATOR_H
+#define PROBABILISTIC_AGGREGATOR_H
+
+#include "OpaqueVal.h"
+
+namespace probabilistic {
+
+class TopkVal;
+
+/**
+ * Keeps the statistics that a SumStats reducer asks for natively, so that
+ * an observation takes a single function call rather than one per
+ * calculation. Aggregators with the same calculations can be merged, as
+ * when the nodes of a cluster report their results at the end of an
+ * epoch; serializing one yields a compact representation for that.
+ */
+class AggregatorVal : public OpaqueVal {
+public:
+	/**
+	 * The calculations supported, as a bit mask.
+	 */
+	enum Calculation {
+		CALC_SUM = 0x01,
+		CALC_MIN = 0x02,
+		CALC_MAX = 0x04,
+		CALC_AVERAGE = 0x08,
+		CALC_VARIANCE = 0x10,
+		CALC_STD_DEV = 0x20,
+		CALC_HLL_UNIQUE = 0x40,
+		CALC_TOPK = 0x80,
+	};
+
+	/**
+	 * Constructor.
+	 *
+	 * @param calcs The calculations to do, a mask of Calculation.
+	 *
+	 * @param hll_error_margin The error margin of the HyperLogLog
+	 * counter, if CALC_HLL_UNIQUE is set.
+	 *
+	 * @param hll_confidence The confidence of the HyperLogLog counter.
+	 *
+	 * @param topk_size The number of elements to track, if CALC_TOPK is
+	 * set.
+	 */
+	AggregatorVal(int calcs, double hll_error_margin, double hll_confidence,
+		      uint64 topk_size);
+
+	~AggregatorVal() override;
+
+	/**
+	 * Returns the calculation of a SumStats::Calculation name, with or
+	 * without module, or 0 if it's not supported.
+	 */
+	static int CalculationByName(const char* name);
+
+	/**
+	 * Adds an observation.
+	 *
+	 * @param val The numeric value of the observation.
+	 *
+	 * @param obs The observation itself, for counting unique ones and
+	 * the top-k.
+	 */
+	void Observe(double val, Val* obs);
+
+	/**
+	 * Merges another aggregator into this one.
+	 *
+	 * @return False if the two don't do the same calculations or their
+	 * counters are incompatible, leaving this one unchanged.
+	 */
+	bool Merge(const AggregatorVal* other);
+
+	/**
+	 * Sets the fields of a SumStats::ResultVal for the calculations done,
+	 * leaving the others alone.
+	 */
+	void Fill(RecordVal* rv) const;
+
+	int Calculations() const	{ return calcs; }
+
+	Val* DoClone(CloneState* state) override;
+
+protected:
+	AggregatorVal();
+
+	DECLARE_OPAQUE_VALUE(AggregatorVal)
+
+private:
+	int calcs;
+	uint64 num;
+	double sum;
+	double min;
+	double max;
+	double mean;
+	double m2;	// Sum of squared differences from the mean.
+
+	CardinalityVal* card;
+	TopkVal* topk;
+};
+
+}
+
+#endif
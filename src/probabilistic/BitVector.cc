@@ -5,6 +5,7 @@
 #include <limits>
 
 #include "BitVector.h"
+#include "PackedInts.h"
 #include "digest.h"
 
 using namespace probabilistic;
@@ -507,13 +508,8 @@ uint64 BitVector::Hash() const
 
 broker::expected<broker::data> BitVector::Serialize() const
 	{
-	broker::vector v = {static_cast<uint64>(num_bits), static_cast<uint64>(bits.size())};
-	v.reserve(2 + bits.size());
-
-	for ( size_t i = 0; i < bits.size(); ++i )
-		v.emplace_back(static_cast<uint64>(bits[i]));
-
-	return {std::move(v)};
+	return {broker::vector{static_cast<uint64>(num_bits),
+			       pack_ints(bits.data(), bits.size())}};
 	}
 
 std::unique_ptr<BitVector> BitVector::Unserialize(const broker::data& data)
@@ -523,17 +519,28 @@ std::unique_ptr<BitVector> BitVector::Unserialize(const broker::data& data)
 		return nullptr;
 
 	auto num_bits = caf::get_if<uint64>(&(*v)[0]);
-	auto size = caf::get_if<uint64>(&(*v)[1]);
 
-	if ( ! (num_bits && size) )
-		return nullptr;
-
-	if ( v->size() != 2 + *size )
+	if ( ! num_bits )
 		return nullptr;
 
 	auto bv = std::unique_ptr<BitVector>(new BitVector());
 	bv->num_bits = *num_bits;
 
+	if ( auto blob = caf::get_if<std::string>(&(*v)[1]) )
+		{
+		if ( v->size() != 2 || ! unpack_ints(*blob, &bv->bits) )
+			return nullptr;
+
+		return bv;
+		}
+
+	// Earlier versions sent the number of blocks, followed by each
+	// block as an element of its own.
+	auto size = caf::get_if<uint64>(&(*v)[1]);
+
+	if ( ! size || v->size() != 2 + *size )
+		return nullptr;
+
 	for ( size_t i = 0; i < *size; ++i )
 		{
 		auto x = caf::get_if<uint64>(&(*v)[2 + i]);
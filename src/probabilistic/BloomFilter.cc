@@ -1,5 +1,6 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
+#include <algorithm>
 #include <typeinfo>
 #include <cmath>
 #include <limits>
@@ -11,6 +12,7 @@
 #include "CounterVector.h"
 
 #include "../util.h"
+#include "../digest.h"
 #include "../Reporter.h"
 
 using namespace probabilistic;
@@ -70,6 +72,13 @@ std::unique_ptr<BloomFilter> BloomFilter::Unserialize(const broker::data& data)
 	case Counting:
 		bf = std::unique_ptr<BloomFilter>(new CountingBloomFilter());
 		break;
+
+	case Blocked:
+		bf = std::unique_ptr<BloomFilter>(new BlockedBloomFilter());
+		break;
+
+	default:
+		return nullptr;
 	}
 
 	if ( ! bf->DoUnserialize((*v)[2]) )
@@ -193,6 +202,158 @@ bool BasicBloomFilter::DoUnserialize(const broker::data& data)
 	return true;
 	}
 
+BlockedBloomFilter::BlockedBloomFilter()
+	{
+	}
+
+BlockedBloomFilter::BlockedBloomFilter(const Hasher* hasher, size_t cells)
+	: BloomFilter(hasher)
+	{
+	size_t n = (cells + WORDS_PER_BLOCK * 64 - 1) / (WORDS_PER_BLOCK * 64);
+	blocks.resize(n ? n : 1, Block{});
+	}
+
+BlockedBloomFilter::~BlockedBloomFilter()
+	{
+	}
+
+size_t BlockedBloomFilter::Locate(const HashKey* key, Block* mask) const
+	{
+	Hasher::digest_vector h = hasher->Hash(key);
+
+	for ( size_t i = 0; i < WORDS_PER_BLOCK; ++i )
+		mask->words[i] = 0;
+
+	// The upper half of the first digest picks the block, the lower bits
+	// of each digest a bit within it.
+	for ( size_t i = 0; i < h.size(); ++i )
+		{
+		size_t bit = h[i] % (WORDS_PER_BLOCK * 64);
+		mask->words[bit / 64] |= uint64(1) << (bit % 64);
+		}
+
+	return (h[0] >> 32) % blocks.size();
+	}
+
+void BlockedBloomFilter::Add(const HashKey* key)
+	{
+	Block mask;
+	Block& b = blocks[Locate(key, &mask)];
+
+	for ( size_t i = 0; i < WORDS_PER_BLOCK; ++i )
+		b.words[i] |= mask.words[i];
+	}
+
+size_t BlockedBloomFilter::Count(const HashKey* key) const
+	{
+	Block mask;
+	const Block& b = blocks[Locate(key, &mask)];
+
+	// Branch-free over a fixed number of words, which compilers turn into
+	// a few vector instructions.
+	uint64 missing = 0;
+
+	for ( size_t i = 0; i < WORDS_PER_BLOCK; ++i )
+		missing |= mask.words[i] & ~b.words[i];
+
+	return missing ? 0 : 1;
+	}
+
+bool BlockedBloomFilter::Empty() const
+	{
+	for ( const auto& b : blocks )
+		for ( size_t i = 0; i < WORDS_PER_BLOCK; ++i )
+			if ( b.words[i] )
+				return false;
+
+	return true;
+	}
+
+void BlockedBloomFilter::Clear()
+	{
+	std::fill(blocks.begin(), blocks.end(), Block{});
+	}
+
+bool BlockedBloomFilter::Merge(const BloomFilter* other)
+	{
+	if ( typeid(*this) != typeid(*other) )
+		return false;
+
+	const BlockedBloomFilter* o = static_cast<const BlockedBloomFilter*>(other);
+
+	if ( ! hasher->Equals(o->hasher) )
+		{
+		reporter->Error("incompatible hashers in BlockedBloomFilter merge");
+		return false;
+		}
+
+	else if ( blocks.size() != o->blocks.size() )
+		{
+		reporter->Error("different number of blocks in BlockedBloomFilter merge");
+		return false;
+		}
+
+	for ( size_t j = 0; j < blocks.size(); ++j )
+		for ( size_t i = 0; i < WORDS_PER_BLOCK; ++i )
+			blocks[j].words[i] |= o->blocks[j].words[i];
+
+	return true;
+	}
+
+BlockedBloomFilter* BlockedBloomFilter::Clone() const
+	{
+	BlockedBloomFilter* copy = new BlockedBloomFilter();
+
+	copy->hasher = hasher->Clone();
+	copy->blocks = blocks;
+
+	return copy;
+	}
+
+string BlockedBloomFilter::InternalState() const
+	{
+	uint64 digest[2];
+	internal_md5(reinterpret_cast<const u_char*>(blocks.data()),
+	             blocks.size() * sizeof(Block),
+	             reinterpret_cast<u_char*>(digest));
+	return fmt("%" PRIu64, digest[0]);
+	}
+
+broker::expected<broker::data> BlockedBloomFilter::DoSerialize() const
+	{
+	broker::vector v;
+	v.reserve(blocks.size() * WORDS_PER_BLOCK);
+
+	for ( const auto& b : blocks )
+		for ( size_t i = 0; i < WORDS_PER_BLOCK; ++i )
+			v.emplace_back(static_cast<uint64>(b.words[i]));
+
+	return {std::move(v)};
+	}
+
+bool BlockedBloomFilter::DoUnserialize(const broker::data& data)
+	{
+	auto v = caf::get_if<broker::vector>(&data);
+
+	if ( ! v || v->empty() || v->size() % WORDS_PER_BLOCK )
+		return false;
+
+	blocks.resize(v->size() / WORDS_PER_BLOCK);
+
+	for ( size_t j = 0; j < blocks.size(); ++j )
+		for ( size_t i = 0; i < WORDS_PER_BLOCK; ++i )
+			{
+			auto w = caf::get_if<uint64>(&(*v)[j * WORDS_PER_BLOCK + i]);
+
+			if ( ! w )
+				return false;
+
+			blocks[j].words[i] = *w;
+			}
+
+	return true;
+	}
+
 CountingBloomFilter::CountingBloomFilter()
 	{
 	cells = 0;
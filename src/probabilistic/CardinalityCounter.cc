@@ -2,13 +2,18 @@
 
 #include <math.h>
 #include <stdint.h>
+#include <algorithm>
 #include <iostream>
 
 #include "CardinalityCounter.h"
+#include "PackedInts.h"
 #include "Reporter.h"
 
 using namespace probabilistic;
 
+// Sparse entries keep the bucket index in their upper 24 bits.
+static const uint64_t max_sparse_m = uint64_t(1) << 24;
+
 int CardinalityCounter::OptimalB(double error, double confidence) const
 	{
 	double initial_estimate = 2 * (log(1.04) - log(error)) / log(2);
@@ -54,18 +59,15 @@ void CardinalityCounter::Init(uint64_t size)
 		reporter->InternalError("Invalid size %" PRIu64 ". Size either has to be a power of 2", size);
 
 	p = calc_p;
-
-	buckets.reserve(m);
-	for ( uint64_t i = 0; i < m; i++ )
-		buckets.push_back(0);
-
-	assert(buckets.size() == m);
-
 	V = m;
+
+	// Counters start out sparse, as most never see many elements.
+	if ( m > max_sparse_m )
+		Densify();
 	}
 
 CardinalityCounter::CardinalityCounter(CardinalityCounter& other)
-	: buckets(other.buckets)
+	: buckets(other.buckets), sparse(other.sparse)
 	{
 	V = other.V;
 	alpha_m = other.alpha_m;
@@ -82,6 +84,7 @@ CardinalityCounter::CardinalityCounter(CardinalityCounter&& o)
 
 	o.m = 0;
 	buckets = std::move(o.buckets);
+	sparse = std::move(o.sparse);
 	}
 
 CardinalityCounter::CardinalityCounter(double error_margin, double confidence)
@@ -100,11 +103,6 @@ CardinalityCounter::CardinalityCounter(uint64_t size)
 CardinalityCounter::CardinalityCounter(uint64_t arg_size, uint64_t arg_V, double arg_alpha_m)
 	{
 	m = arg_size;
-
-	buckets.reserve(m);
-	for ( uint64_t i = 0; i < m; i++ )
-		buckets.push_back(0);
-
 	alpha_m = arg_alpha_m;
 	V = arg_V;
 	p = log2(m);
@@ -128,15 +126,53 @@ void CardinalityCounter::AddElement(uint64_t hash)
 	uint64_t index = hash % m;
 	hash = hash-index;
 
+	uint8_t temp = Rank(hash);
+
+	if ( IsSparse() )
+		{
+		AddSparse(index, temp);
+		return;
+		}
+
 	if( buckets[index] == 0 )
 		V--;
 
-	uint8_t temp = Rank(hash);
-
 	if ( temp > buckets[index] )
 		buckets[index] = temp;
 	}
 
+void CardinalityCounter::AddSparse(uint64_t index, uint8_t rank)
+	{
+	uint32_t key = index << 8;
+	auto it = std::lower_bound(sparse.begin(), sparse.end(), key);
+
+	if ( it != sparse.end() && (*it >> 8) == index )
+		{
+		if ( rank > (*it & 0xff) )
+			*it = key | rank;
+
+		return;
+		}
+
+	sparse.insert(it, key | rank);
+	V--;
+
+	// An entry takes four times the space of a bucket.
+	if ( sparse.size() > m / 4 )
+		Densify();
+	}
+
+void CardinalityCounter::Densify()
+	{
+	buckets.assign(m, 0);
+
+	for ( auto e : sparse )
+		buckets[e >> 8] = e & 0xff;
+
+	sparse.clear();
+	sparse.shrink_to_fit();
+	}
+
 /**
  * Estimate the size by using the the "raw" HyperLogLog estimate. Then,
  * check if it's too "large" or "small" because the raw estimate doesn't
@@ -148,9 +184,30 @@ void CardinalityCounter::AddElement(uint64_t hash)
  **/
 double CardinalityCounter::Size() const
 	{
+	// Count the buckets by value first. The terms are powers of two, so
+	// adding them up by value gives the same sum, without a pow() per
+	// bucket.
+	uint64_t counts[64] = { 0 };
+
+	if ( IsSparse() )
+		{
+		counts[0] = m - sparse.size();
+
+		for ( auto e : sparse )
+			++counts[e & 0x3f];
+		}
+	else
+		{
+		for ( auto b : buckets )
+			++counts[b & 0x3f];
+		}
+
 	double answer = 0;
-	for ( unsigned int i = 0; i < m; i++ )
-		answer += pow(2, -((int)buckets[i]));
+	for ( int i = 0; i < 64; i++ )
+		{
+		if ( counts[i] )
+			answer += counts[i] * ldexp(1.0, -i);
+		}
 
 	answer = 1 / answer;
 	answer = (alpha_m * m * m * answer);
@@ -170,19 +227,54 @@ bool CardinalityCounter::Merge(CardinalityCounter* c)
 	if ( m != c->GetM() )
 		return false;
 
-	const vector<uint8_t> temp = c->GetBuckets();
+	if ( c->IsSparse() && IsSparse() )
+		{
+		std::vector<uint32_t> merged;
+		merged.reserve(sparse.size() + c->sparse.size());
+
+		auto i = sparse.begin();
+		auto j = c->sparse.begin();
+
+		while ( i != sparse.end() || j != c->sparse.end() )
+			{
+			if ( j == c->sparse.end() || (i != sparse.end() && (*i >> 8) < (*j >> 8)) )
+				merged.push_back(*i++);
+
+			else if ( i == sparse.end() || (*j >> 8) < (*i >> 8) )
+				merged.push_back(*j++);
+
+			else
+				merged.push_back(std::max(*i++, *j++));
+			}
+
+		sparse.swap(merged);
+		V = m - sparse.size();
+
+		if ( sparse.size() > m / 4 )
+			Densify();
 
-	V = 0;
+		return true;
+		}
+
+	if ( IsSparse() )
+		Densify();
 
-	for ( unsigned int i = 0; i < m; i++ )
+	if ( c->IsSparse() )
+		{
+		for ( auto e : c->sparse )
+			buckets[e >> 8] = std::max(buckets[e >> 8], uint8_t(e & 0xff));
+		}
+	else
 		{
-		if ( temp[i] > buckets[i] )
-			buckets[i] = temp[i];
+		// Kept free of branches, so that compilers vectorize it.
+		const uint8_t* o = c->buckets.data();
+		uint8_t* b = buckets.data();
 
-		if ( buckets[i] == 0 )
-			++V;
+		for ( uint64_t i = 0; i < m; i++ )
+			b[i] = std::max(b[i], o[i]);
 		}
 
+	V = std::count(buckets.begin(), buckets.end(), 0);
 	return true;
 	}
 
@@ -198,13 +290,13 @@ uint64_t CardinalityCounter::GetM() const
 
 broker::expected<broker::data> CardinalityCounter::Serialize() const
 	{
-	broker::vector v = {m, V, alpha_m};
-	v.reserve(3 + m);
+	// The size of the packed elements tells sparse and dense apart.
+	if ( IsSparse() )
+		return {broker::vector{m, V, alpha_m,
+				       pack_ints(sparse.data(), sparse.size())}};
 
-	for ( size_t i = 0; i < m; ++i )
-		v.emplace_back(static_cast<uint64>(buckets[i]));
-
-	return {std::move(v)};
+	return {broker::vector{m, V, alpha_m,
+			       pack_ints(buckets.data(), buckets.size())}};
 	}
 
 std::unique_ptr<CardinalityCounter> CardinalityCounter::Unserialize(const broker::data& data)
@@ -219,14 +311,66 @@ std::unique_ptr<CardinalityCounter> CardinalityCounter::Unserialize(const broker
 
 	if ( ! (m && V && alpha_m) )
 		return nullptr;
-	if ( v->size() != 3 + *m )
+	if ( v->size() > 3 + *m )
 		return nullptr;
 
 	auto cc = std::unique_ptr<CardinalityCounter>(new CardinalityCounter(*m, *V, *alpha_m));
 	if ( *m != cc->m )
 		return nullptr;
-	if ( cc->buckets.size() != * m )
-		return nullptr;
+
+	if ( auto blob = v->size() == 4 ? caf::get_if<std::string>(&(*v)[3]) : nullptr )
+		{
+		if ( unpack_ints(*blob, &cc->buckets) )
+			{
+			if ( cc->buckets.size() != *m )
+				return nullptr;
+
+			return cc;
+			}
+
+		if ( *m > max_sparse_m || ! unpack_ints(*blob, &cc->sparse) )
+			return nullptr;
+
+		for ( size_t i = 0; i < cc->sparse.size(); ++i )
+			{
+			uint32_t x = cc->sparse[i];
+
+			if ( (x >> 8) >= *m || (x & 0xff) >= 64 )
+				return nullptr;
+
+			if ( i > 0 && (x >> 8) <= (cc->sparse[i - 1] >> 8) )
+				return nullptr;
+			}
+
+		cc->V = *m - cc->sparse.size();
+		return cc;
+		}
+
+	// Earlier versions sent each sparse entry or bucket as an element
+	// of its own, with fewer entries than buckets telling the two apart.
+	if ( v->size() < 3 + *m )
+		{
+		if ( *m > max_sparse_m )
+			return nullptr;
+
+		for ( size_t i = 3; i < v->size(); ++i )
+			{
+			auto x = caf::get_if<uint64>(&(*v)[i]);
+
+			if ( ! x || (*x >> 8) >= *m || (*x & 0xff) >= 64 )
+				return nullptr;
+
+			if ( ! cc->sparse.empty() && (*x >> 8) <= (cc->sparse.back() >> 8) )
+				return nullptr;
+
+			cc->sparse.push_back(*x);
+			}
+
+		cc->V = *m - cc->sparse.size();
+		return cc;
+		}
+
+	cc->Densify();
 
 	for ( size_t i = 0; i < *m; ++i )
 		{
@@ -101,7 +101,7 @@ protected:
 
 	/**
 	 * Returns the buckets array that holds all of the rough cardinality
-	 * estimates.
+	 * estimates. It's empty as long as the counter is sparse.
 	 *
 	 * Use GetM() to determine the size.
 	 *
@@ -109,6 +109,11 @@ protected:
 	 */
 	const std::vector<uint8_t>& GetBuckets() const;
 
+	/**
+	 * Returns whether the counter still keeps only its non-empty buckets.
+	 */
+	bool IsSparse() const	{ return buckets.empty(); }
+
 private:
 	/**
 	 * Constructor used when unserializing, i.e., all parameters are
@@ -159,6 +164,17 @@ private:
 	 */
 	static int flsll(uint64_t mask);
 
+	/**
+	 * Sets a bucket of a sparse counter to at least the given rank, and
+	 * switches to the dense representation once that takes less memory.
+	 */
+	void AddSparse(uint64_t index, uint8_t rank);
+
+	/**
+	 * Switches from the sparse to the dense representation.
+	 */
+	void Densify();
+
 	/**
 	 * This is the number of buckets that will be stored. The standard
 	 * error is 1.04/sqrt(m), so the actual cardinality will be the
@@ -174,6 +190,13 @@ private:
 	 */
 	std::vector<uint8_t> buckets;
 
+	/**
+	 * While most buckets are 0, only the others are kept here instead of
+	 * in #buckets, each as its index shifted left by 8 bits or'ed with its
+	 * value, in ascending order.
+	 */
+	std::vector<uint32_t> sparse;
+
 	/**
 	 * There are some state constants that need to be kept track of to
 	 * make the final estimate easier. V is the number of values in
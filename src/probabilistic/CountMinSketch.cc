@@ -0,0 +1,177 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <math.h>
+#include <algorithm>
+
+#include "CountMinSketch.h"
+
+using namespace probabilistic;
+
+CountMinSketch::CountMinSketch()
+	{
+	hasher = 0;
+	width = 0;
+	depth = 0;
+	conservative = true;
+	total = 0;
+	}
+
+CountMinSketch::CountMinSketch(const Hasher* arg_hasher, size_t arg_width,
+			       bool arg_conservative)
+	{
+	hasher = arg_hasher;
+	width = arg_width;
+	depth = hasher->K();
+	conservative = arg_conservative;
+	total = 0;
+	counters.resize(width * depth, 0);
+	}
+
+CountMinSketch::CountMinSketch(const CountMinSketch& other)
+	: counters(other.counters)
+	{
+	hasher = other.hasher->Clone();
+	width = other.width;
+	depth = other.depth;
+	conservative = other.conservative;
+	total = other.total;
+	}
+
+CountMinSketch::~CountMinSketch()
+	{
+	delete hasher;
+	}
+
+size_t CountMinSketch::Width(double epsilon)
+	{
+	return static_cast<size_t>(ceil(M_E / epsilon));
+	}
+
+size_t CountMinSketch::Depth(double delta)
+	{
+	return static_cast<size_t>(ceil(log(1 / delta)));
+	}
+
+void CountMinSketch::Add(const HashKey* key, uint64_t count)
+	{
+	Hasher::digest_vector h = hasher->Hash(key);
+	total += count;
+
+	if ( ! conservative )
+		{
+		for ( size_t i = 0; i < depth; ++i )
+			counters[i * width + h[i] % width] += count;
+
+		return;
+		}
+
+	// Only raise the counters that are below the new estimate; the
+	// others already overestimate the element by at least as much.
+	uint64_t target = count;
+
+	for ( size_t i = 0; i < depth; ++i )
+		{
+		h[i] = i * width + h[i] % width;
+
+		if ( i == 0 || counters[h[i]] + count < target )
+			target = counters[h[i]] + count;
+		}
+
+	for ( size_t i = 0; i < depth; ++i )
+		counters[h[i]] = std::max(counters[h[i]], target);
+	}
+
+uint64_t CountMinSketch::Estimate(const HashKey* key) const
+	{
+	Hasher::digest_vector h = hasher->Hash(key);
+	uint64_t estimate = counters[h[0] % width];
+
+	for ( size_t i = 1; i < depth; ++i )
+		estimate = std::min(estimate, counters[i * width + h[i] % width]);
+
+	return estimate;
+	}
+
+bool CountMinSketch::Merge(const CountMinSketch* other)
+	{
+	if ( width != other->width || depth != other->depth ||
+	     ! hasher->Equals(other->hasher) )
+		return false;
+
+	// Sums of upper bounds stay upper bounds, so this works for
+	// conservatively updated sketches as well.
+	const uint64_t* src = other->counters.data();
+	uint64_t* dst = counters.data();
+
+	for ( size_t i = 0; i < counters.size(); ++i )
+		dst[i] += src[i];
+
+	total += other->total;
+	return true;
+	}
+
+void CountMinSketch::Clear()
+	{
+	std::fill(counters.begin(), counters.end(), 0);
+	total = 0;
+	}
+
+broker::expected<broker::data> CountMinSketch::Serialize() const
+	{
+	auto h = hasher->Serialize();
+
+	if ( ! h )
+		return broker::ec::invalid_data;
+
+	broker::vector v = {std::move(*h), static_cast<uint64>(width),
+			    conservative, total};
+	v.reserve(4 + counters.size());
+
+	for ( auto c : counters )
+		v.emplace_back(static_cast<uint64>(c));
+
+	return {std::move(v)};
+	}
+
+std::unique_ptr<CountMinSketch> CountMinSketch::Unserialize(const broker::data& data)
+	{
+	auto v = caf::get_if<broker::vector>(&data);
+
+	if ( ! (v && v->size() >= 4) )
+		return nullptr;
+
+	auto w = caf::get_if<uint64>(&(*v)[1]);
+	auto conservative = caf::get_if<bool>(&(*v)[2]);
+	auto total = caf::get_if<uint64>(&(*v)[3]);
+
+	if ( ! (w && *w > 0 && conservative && total) )
+		return nullptr;
+
+	auto hasher = Hasher::Unserialize((*v)[0]);
+
+	if ( ! (hasher && hasher->K() > 0) )
+		return nullptr;
+
+	if ( v->size() != 4 + *w * hasher->K() )
+		return nullptr;
+
+	auto cms = std::unique_ptr<CountMinSketch>(new CountMinSketch());
+	cms->width = *w;
+	cms->depth = hasher->K();
+	cms->conservative = *conservative;
+	cms->total = *total;
+	cms->hasher = hasher.release();
+	cms->counters.reserve(v->size() - 4);
+
+	for ( size_t i = 4; i < v->size(); ++i )
+		{
+		auto c = caf::get_if<uint64>(&(*v)[i]);
+
+		if ( ! c )
+			return nullptr;
+
+		cms->counters.push_back(*c);
+		}
+
+	return cms;
+	}
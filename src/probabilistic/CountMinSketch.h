@@ -0,0 +1,133 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef PROBABILISTIC_COUNTMINSKETCH_H
+#define PROBABILISTIC_COUNTMINSKETCH_H
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include <broker/data.hh>
+#include <broker/expected.hh>
+
+#include "Hasher.h"
+
+namespace probabilistic {
+
+/**
+ * A Count-Min sketch, estimating how often elements occurred in constant
+ * space. Estimates never fall below the true count; with probability
+ * 1 - *delta*, they exceed it by at most *epsilon* times the sum of all
+ * counts.
+ */
+class CountMinSketch {
+public:
+	/**
+	 * Constructs a sketch.
+	 *
+	 * @param hasher The hasher to use. Its *k* determines the number of
+	 * rows. The sketch takes ownership.
+	 *
+	 * @param width The number of counters per row.
+	 *
+	 * @param conservative Whether to use conservative update, which
+	 * raises only those counters of an element that are below its new
+	 * estimate. That reduces the overestimation considerably, but a
+	 * conservatively updated sketch no longer supports subtraction.
+	 */
+	CountMinSketch(const Hasher* hasher, size_t width, bool conservative = true);
+
+	/**
+	 * Copy constructor.
+	 */
+	CountMinSketch(const CountMinSketch& other);
+
+	/**
+	 * Destructor.
+	 */
+	~CountMinSketch();
+
+	/**
+	 * Computes the width for a given error bound, i.e., ceil(e / epsilon).
+	 *
+	 * @param epsilon The error relative to the sum of all counts.
+	 *
+	 * @return The number of counters per row.
+	 */
+	static size_t Width(double epsilon);
+
+	/**
+	 * Computes the number of rows for a given failure probability, i.e.,
+	 * ceil(ln(1 / delta)).
+	 *
+	 * @param delta The probability of exceeding the error bound.
+	 *
+	 * @return The number of rows.
+	 */
+	static size_t Depth(double delta);
+
+	/**
+	 * Adds to the count of an element.
+	 *
+	 * @param key The key of the element.
+	 *
+	 * @param count The amount to add.
+	 */
+	void Add(const HashKey* key, uint64_t count = 1);
+
+	/**
+	 * Estimates the count of an element.
+	 *
+	 * @param key The key of the element.
+	 *
+	 * @return The estimate, which is at least the true count.
+	 */
+	uint64_t Estimate(const HashKey* key) const;
+
+	/**
+	 * Returns the sum of all counts added so far.
+	 */
+	uint64_t Total() const	{ return total; }
+
+	/**
+	 * Merges another sketch into this one. Both need to have the same
+	 * dimensions and hasher. Estimates from the result bound the
+	 * combined counts the same way, whether or not the inputs were
+	 * updated conservatively.
+	 *
+	 * @param other The sketch to merge.
+	 *
+	 * @return True if successful.
+	 */
+	bool Merge(const CountMinSketch* other);
+
+	/**
+	 * Resets all counts to zero.
+	 */
+	void Clear();
+
+	broker::expected<broker::data> Serialize() const;
+	static std::unique_ptr<CountMinSketch> Unserialize(const broker::data& data);
+
+private:
+	CountMinSketch& operator=(const CountMinSketch&); // Disable.
+
+	/**
+	 * Constructor used when unserializing.
+	 */
+	CountMinSketch();
+
+	const Hasher* hasher;
+	size_t width;
+	size_t depth;
+	bool conservative;
+	uint64_t total;
+
+	// The rows, one after the other, so that merging and clearing are
+	// plain loops over one array.
+	std::vector<uint64_t> counters;
+};
+
+}
+
+#endif
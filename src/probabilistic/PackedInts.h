@@ -0,0 +1,89 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef PROBABILISTIC_PACKEDINTS_H
+#define PROBABILISTIC_PACKEDINTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace probabilistic {
+
+/**
+ * Packs an array of unsigned integers into a single string for
+ * serialization, which spares large bit and counter arrays from turning
+ * into a vector of individual Broker values. The string starts with a
+ * header of a format version byte, a byte with the size of the elements,
+ * and their number as 64-bit integer, followed by the elements. All
+ * integers are in network byte order.
+ *
+ * @param elems The elements to pack.
+ *
+ * @param n The number of elements.
+ *
+ * @return The packed elements.
+ */
+template <typename T>
+std::string pack_ints(const T* elems, size_t n)
+	{
+	std::string blob;
+	blob.reserve(10 + n * sizeof(T));
+	blob.push_back(1);
+	blob.push_back(sizeof(T));
+
+	for ( int i = 7; i >= 0; --i )
+		blob.push_back(static_cast<char>(uint64_t(n) >> (i * 8)));
+
+	for ( size_t j = 0; j < n; ++j )
+		for ( int i = sizeof(T) - 1; i >= 0; --i )
+			blob.push_back(static_cast<char>(uint64_t(elems[j]) >> (i * 8)));
+
+	return blob;
+	}
+
+/**
+ * Unpacks an array of unsigned integers packed by pack_ints().
+ *
+ * @param blob The packed elements.
+ *
+ * @param elems Receives the elements, replacing what's there.
+ *
+ * @return False if *blob* isn't an array of elements of type *T*.
+ */
+template <typename T>
+bool unpack_ints(const std::string& blob, std::vector<T>* elems)
+	{
+	if ( blob.size() < 10 || blob[0] != 1 ||
+	     blob[1] != static_cast<char>(sizeof(T)) )
+		return false;
+
+	auto p = reinterpret_cast<const unsigned char*>(blob.data());
+	uint64_t n = 0;
+
+	for ( int i = 2; i < 10; ++i )
+		n = (n << 8) | p[i];
+
+	if ( (blob.size() - 10) / sizeof(T) != n ||
+	     (blob.size() - 10) % sizeof(T) != 0 )
+		return false;
+
+	elems->resize(n);
+	p += 10;
+
+	for ( uint64_t j = 0; j < n; ++j )
+		{
+		uint64_t x = 0;
+
+		for ( size_t i = 0; i < sizeof(T); ++i )
+			x = (x << 8) | *p++;
+
+		(*elems)[j] = static_cast<T>(x);
+		}
+
+	return true;
+	}
+
+}
+
+#endif
@@ -1,5 +1,8 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
+#include <algorithm>
+#include <vector>
+
 #include <broker/error.hh>
 
 #include "broker/Data.h"
@@ -100,6 +103,15 @@ void TopkVal::Merge(const TopkVal* value, bool doPrune)
 			}
 		}
 
+	// Stepping each merged element up the bucket list one at a time makes
+	// merging quadratic. Instead, collect the new counts first, take the
+	// elements out of their buckets, and then insert them all in a single
+	// pass over the bucket list. Within a bucket, the touched elements end
+	// up behind the untouched ones, in the order we encountered them -
+	// just like stepping them one by one would.
+	std::vector<std::pair<uint64, Element*>> touched;
+	touched.reserve(value->numElements);
+
 	std::list<Bucket*>::const_iterator it = value->buckets.begin();
 	while ( it != value->buckets.end() )
 		{
@@ -113,35 +125,29 @@ void TopkVal::Merge(const TopkVal* value, bool doPrune)
 			// lookup if we already know this one...
 			HashKey* key = GetHash(e->value);
 			Element* olde = (Element*) elementDict->Lookup(key);
+			uint64 newcount = currcount;
 
 			if ( olde == 0 )
 				{
 				olde = new Element();
 				olde->epsilon = 0;
 				olde->value = e->value->Ref();
-				// insert at bucket position 0
-				if ( buckets.size() > 0 )
-					{
-					assert (buckets.front()-> count > 0 );
-					}
-
-				Bucket* newbucket = new Bucket();
-				newbucket->count = 0;
-				newbucket->bucketPos = buckets.insert(buckets.begin(), newbucket);
-
-				olde->parent = newbucket;
-				newbucket->elements.insert(newbucket->elements.end(), olde);
+				olde->parent = 0;
 
 				elementDict->Insert(key, olde);
 				numElements++;
+				}
 
+			else
+				{
+				newcount += olde->parent->count;
+				DetachElement(olde);
 				}
 
 			// now that we are sure that the old element is present - increment epsilon
 			olde->epsilon += e->epsilon;
 
-			// and increment position...
-			IncrementCounter(olde, currcount);
+			touched.emplace_back(newcount, olde);
 			delete key;
 
 			eit++;
@@ -150,6 +156,29 @@ void TopkVal::Merge(const TopkVal* value, bool doPrune)
 		it++;
 		}
 
+	std::stable_sort(touched.begin(), touched.end(),
+	                 [](const std::pair<uint64, Element*>& a,
+	                    const std::pair<uint64, Element*>& b)
+	                 { return a.first < b.first; });
+
+	std::list<Bucket*>::iterator bit = buckets.begin();
+
+	for ( const auto& t : touched )
+		{
+		while ( bit != buckets.end() && (*bit)->count < t.first )
+			bit++;
+
+		if ( bit == buckets.end() || (*bit)->count != t.first )
+			{
+			Bucket* b = new Bucket();
+			b->count = t.first;
+			bit = buckets.insert(bit, b);
+			b->bucketPos = bit;
+			}
+
+		AttachElement(t.second, *bit);
+		}
+
 	// now we have added everything. And our top-k table could be too big.
 	// prune everything...
 
@@ -312,15 +341,13 @@ void TopkVal::Encountered(Val* encountered)
 				b->count = 1;
 				std::list<Bucket*>::iterator pos = buckets.insert(buckets.begin(), b);
 				b->bucketPos = pos;
-				b->elements.insert(b->elements.end(), e);
-				e->parent = b;
+				AttachElement(e, b);
 				}
 			else
 				{
 				Bucket* b = *buckets.begin();
 				assert(b->count == 1);
-				b->elements.insert(b->elements.end(), e);
-				e->parent = b;
+				AttachElement(e, b);
 				}
 
 			elementDict->Insert(key, e);
@@ -346,9 +373,8 @@ void TopkVal::Encountered(Val* encountered)
 
 			// and add the new one to the end
 			e->epsilon = b->count;
-			b->elements.insert(b->elements.end(), e);
+			AttachElement(e, b);
 			elementDict->Insert(key, e);
-			e->parent = b;
 
 			// fallthrough, increment operation has to run!
 			}
@@ -394,17 +420,27 @@ void TopkVal::IncrementCounter(Element* e, unsigned int count)
 		}
 
 	// ok, now we have the new bucket in nextBucket. Shift the element over...
-	currBucket->elements.remove(e);
-	nextBucket->elements.insert(nextBucket->elements.end(), e);
+	DetachElement(e);
+	AttachElement(e, nextBucket);
+	}
 
-	e->parent = nextBucket;
+void TopkVal::AttachElement(Element* e, Bucket* b)
+	{
+	e->elementPos = b->elements.insert(b->elements.end(), e);
+	e->parent = b;
+	}
 
-	// if currBucket is empty, we have to delete it now
-	if ( currBucket->elements.size() == 0 )
+void TopkVal::DetachElement(Element* e)
+	{
+	Bucket* b = e->parent;
+	b->elements.erase(e->elementPos);
+	e->parent = 0;
+
+	// if the bucket is empty, we have to delete it now
+	if ( b->elements.empty() )
 		{
-		buckets.remove(currBucket);
-		delete currBucket;
-		currBucket = 0;
+		buckets.erase(b->bucketPos);
+		delete b;
 		}
 	}
 
@@ -513,9 +549,7 @@ bool TopkVal::DoUnserialize(const broker::data& data)
 			Element* e = new Element();
 			e->epsilon = *epsilon;
 			e->value = val;
-			e->parent = b;
-
-			b->elements.insert(b->elements.end(), e);
+			AttachElement(e, b);
 
 			HashKey* key = GetHash(e->value);
 			assert (elementDict->Lookup(key) == 0);
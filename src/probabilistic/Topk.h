@@ -30,6 +30,10 @@ struct Element {
 	Val* value;
 	Bucket* parent;
 
+	// Our position in the parent's element list, so that moving to
+	// another bucket doesn't need to search for us.
+	std::list<Element*>::iterator elementPos;
+
 	~Element();
 };
 
@@ -147,6 +151,23 @@ private:
 	 */
 	void IncrementCounter(Element* e, unsigned int count = 1);
 
+	/**
+	 * Append an element to the end of a bucket's element list.
+	 *
+	 * @param e element to append
+	 *
+	 * @param b bucket to append the element to
+	 */
+	void AttachElement(Element* e, Bucket* b);
+
+	/**
+	 * Take an element out of its bucket, deleting the bucket if that
+	 * leaves it empty.
+	 *
+	 * @param e element to detach
+	 */
+	void DetachElement(Element* e);
+
 	/**
 	 * get the hashkey for a specific value
 	 *
@@ -0,0 +1,210 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#ifdef HAVE_LINUX
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#include "Affinity.h"
+#include "NetVar.h"
+#include "Reporter.h"
+
+using namespace threading;
+
+bool threading::parse_cpu_list(const char* s, std::vector<int>* cpus)
+	{
+	cpus->clear();
+
+	while ( *s && *s != '\n' )
+		{
+		char* end;
+		long first = strtol(s, &end, 10);
+
+		if ( end == s || first < 0 )
+			return false;
+
+		long last = first;
+		s = end;
+
+		if ( *s == '-' )
+			{
+			++s;
+			last = strtol(s, &end, 10);
+
+			if ( end == s || last < first )
+				return false;
+
+			s = end;
+			}
+
+		if ( last >= 65536 )
+			return false;
+
+		for ( long i = first; i <= last; ++i )
+			cpus->push_back(i);
+
+		if ( *s == ',' )
+			++s;
+		else if ( *s && *s != '\n' )
+			return false;
+		}
+
+	return true;
+	}
+
+static std::vector<int> numa_node_cpus(int node)
+	{
+	std::vector<int> cpus;
+	std::string path = fmt("/sys/devices/system/node/node%d/cpulist", node);
+	FILE* f = fopen(path.c_str(), "r");
+
+	if ( ! f )
+		return cpus;
+
+	char buf[4096];
+
+	if ( ! fgets(buf, sizeof(buf), f) || ! parse_cpu_list(buf, &cpus) )
+		cpus.clear();
+
+	fclose(f);
+	return cpus;
+	}
+
+static Placement make_placement(const char* what, StringVal* cpu_list, bro_int_t node)
+	{
+	Placement p;
+	const char* s = cpu_list->CheckString();
+
+	if ( *s && ! parse_cpu_list(s, &p.cpus) )
+		{
+		reporter->Error("invalid CPU list for %s threads: '%s'", what, s);
+		p.cpus.clear();
+		}
+
+	if ( node >= 0 )
+		{
+		if ( node >= 1024 )
+			reporter->Error("invalid NUMA node for %s threads: %" PRId64, what, node);
+		else
+			p.numa_node = node;
+		}
+
+	return p;
+	}
+
+const Placement& threading::thread_placement(ThreadClass c)
+	{
+	static bool initialized = false;
+	static Placement placements[3];
+
+	if ( ! initialized )
+		{
+		placements[THREAD_MAIN] =
+			make_placement("main", BifConst::Threading::main_cpus,
+			               BifConst::Threading::main_numa_node);
+		placements[THREAD_WRITER] =
+			make_placement("log writer", BifConst::Threading::writer_cpus,
+			               BifConst::Threading::writer_numa_node);
+		placements[THREAD_READER] =
+			make_placement("input reader", BifConst::Threading::reader_cpus,
+			               BifConst::Threading::reader_numa_node);
+		initialized = true;
+
+#ifdef HAVE_LINUX
+		// New threads inherit the affinity of the main thread. Once
+		// that's pinned, let the others keep running wherever the
+		// process could run originally, rather than competing with it.
+		cpu_set_t set;
+
+		if ( ! placements[THREAD_MAIN].Empty() &&
+		     sched_getaffinity(0, sizeof(set), &set) == 0 )
+			{
+			std::vector<int> original;
+
+			for ( int i = 0; i < CPU_SETSIZE; ++i )
+				{
+				if ( CPU_ISSET(i, &set) )
+					original.push_back(i);
+				}
+
+			for ( auto c : {THREAD_WRITER, THREAD_READER} )
+				{
+				if ( placements[c].cpus.empty() && placements[c].numa_node < 0 )
+					placements[c].cpus = original;
+				}
+			}
+#endif
+		}
+
+	return placements[c];
+	}
+
+void threading::apply_cpu_affinity(pthread_t t, const Placement& p, const char* name)
+	{
+	std::vector<int> cpus = p.cpus;
+
+	if ( cpus.empty() && p.numa_node >= 0 )
+		{
+		cpus = numa_node_cpus(p.numa_node);
+
+		if ( cpus.empty() )
+			{
+			reporter->Warning("cannot determine CPUs of NUMA node %d for thread %s",
+			                  p.numa_node, name);
+			return;
+			}
+		}
+
+	if ( cpus.empty() )
+		return;
+
+#ifdef HAVE_LINUX
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	for ( auto cpu : cpus )
+		{
+		if ( cpu < CPU_SETSIZE )
+			CPU_SET(cpu, &set);
+		}
+
+	int err = pthread_setaffinity_np(t, sizeof(set), &set);
+
+	if ( err )
+		reporter->Warning("cannot set CPU affinity of thread %s: %s",
+		                  name, strerror(err));
+#else
+	static bool warned = false;
+
+	if ( ! warned )
+		reporter->Warning("thread CPU affinity is not supported on this platform");
+
+	warned = true;
+#endif
+	}
+
+void threading::apply_memory_policy(const Placement& p)
+	{
+	if ( p.numa_node < 0 )
+		return;
+
+#if defined(HAVE_LINUX) && defined(SYS_set_mempolicy)
+	// MPOL_PREFERRED from <linux/mempolicy.h>, which not all systems
+	// have installed.
+	const int mpol_preferred = 1;
+	const int bits = 8 * sizeof(unsigned long);
+	unsigned long mask[1024 / bits] = { 0 };
+
+	mask[p.numa_node / bits] |= 1UL << (p.numa_node % bits);
+
+	// The kernel expects the number of bits plus one.
+	syscall(SYS_set_mempolicy, mpol_preferred, mask, 1024 + 1);
+#endif
+	}
@@ -0,0 +1,73 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef THREADING_AFFINITY_H
+#define THREADING_AFFINITY_H
+
+#include <pthread.h>
+#include <vector>
+
+namespace threading {
+
+/**
+ * The kinds of threads that can be placed separately, each with its own
+ * set of \c Threading::*_cpus and \c Threading::*_numa_node options.
+ */
+enum ThreadClass {
+	THREAD_MAIN,	// The main packet-processing thread.
+	THREAD_WRITER,	// Log writer threads.
+	THREAD_READER,	// Input reader threads.
+};
+
+/**
+ * Where a thread should run: a set of CPUs, and a NUMA node to prefer
+ * for its memory.
+ */
+struct Placement {
+	std::vector<int> cpus;	// Empty for no restriction.
+	int numa_node = -1;	// Negative for no preference.
+
+	bool Empty() const	{ return cpus.empty() && numa_node < 0; }
+};
+
+/**
+ * Returns the configured placement for a class of threads. The script
+ * options are parsed on first use, so this must only be called once the
+ * scripts have been loaded, and from the main thread.
+ */
+const Placement& thread_placement(ThreadClass c);
+
+/**
+ * Parses a list of CPUs in the format of Linux' cpulist files, such as
+ * "0-3,8".
+ *
+ * @param s The list.
+ *
+ * @param cpus Receives the CPUs.
+ *
+ * @return False if *s* isn't a valid list.
+ */
+bool parse_cpu_list(const char* s, std::vector<int>* cpus);
+
+/**
+ * Restricts a thread to the CPUs of a placement. Without explicit CPUs,
+ * the CPUs of the placement's NUMA node are used. Must be called from
+ * the main thread, since failures go to the reporter.
+ *
+ * @param t The thread.
+ *
+ * @param p The placement.
+ *
+ * @param name The thread's name for error messages.
+ */
+void apply_cpu_affinity(pthread_t t, const Placement& p, const char* name);
+
+/**
+ * Makes the calling thread prefer the placement's NUMA node for new
+ * memory. Silently does nothing where that isn't supported, since it
+ * may run inside a thread that can't use the reporter.
+ */
+void apply_memory_policy(const Placement& p);
+
+}
+
+#endif
@@ -114,6 +114,9 @@ void BasicThread::Start()
 
 	thread = std::thread(&BasicThread::launcher, this);
 
+	if ( ! placement.Empty() )
+		apply_cpu_affinity(thread.native_handle(), placement, name);
+
 	DBG_LOG(DBG_THREADING, "Started thread %s", name);
 
 	OnStart();
@@ -204,6 +207,8 @@ void* BasicThread::launcher(void *arg)
 	int res = pthread_sigmask(SIG_BLOCK, &mask_set, 0);
 	assert(res == 0);
 
+	apply_memory_policy(thread->placement);
+
 	// Run thread's main function.
 	thread->Run();
 
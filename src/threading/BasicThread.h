@@ -5,6 +5,7 @@
 #include <thread>
 
 #include "util.h"
+#include "Affinity.h"
 
 using namespace std;
 
@@ -63,6 +64,12 @@ public:
 	 */
 	void SetOSName(const char* name);
 
+	/**
+	 * Sets the CPUs and NUMA node the thread will run on, see
+	 * thread_placement(). Must be called before Start().
+	 */
+	void SetPlacement(const Placement& p)	{ placement = p; }
+
 	/**
 	 * Starts the thread. Calling this methods will spawn a new OS thread
 	 * executing Run(). Note that one can't restart a thread after a
@@ -202,6 +209,7 @@ private:
 	bool started; 		// Set to to true once running.
 	bool terminating;	// Set to to true to signal termination.
 	bool killed;	// Set to true once forcefully killed.
+	Placement placement;
 
 	// For implementing Fmt().
 	char* buf;
@@ -23,25 +23,25 @@ Formatter::~Formatter()
 	}
 
 string Formatter::Render(const threading::Value::addr_t& addr)
+	{
+	char buf[RENDER_BUF_SIZE];
+	return Render(addr, buf);
+	}
+
+const char* Formatter::Render(const threading::Value::addr_t& addr, char* buf)
 	{
 	if ( addr.family == IPv4 )
 		{
-		char s[INET_ADDRSTRLEN];
-
-		if ( ! bro_inet_ntop(AF_INET, &addr.in.in4, s, INET_ADDRSTRLEN) )
+		if ( ! bro_inet_ntop(AF_INET, &addr.in.in4, buf, RENDER_BUF_SIZE) )
 			return "<bad IPv4 address conversion>";
-		else
-			return s;
 		}
 	else
 		{
-		char s[INET6_ADDRSTRLEN];
-
-		if ( ! bro_inet_ntop(AF_INET6, &addr.in.in6, s, INET6_ADDRSTRLEN) )
+		if ( ! bro_inet_ntop(AF_INET6, &addr.in.in6, buf, RENDER_BUF_SIZE) )
 			return "<bad IPv6 address conversion>";
-		else
-			return s;
 		}
+
+	return buf;
 	}
 
 TransportProto Formatter::ParseProto(const string &proto) const
@@ -92,21 +92,37 @@ threading::Value::addr_t Formatter::ParseAddr(const string &s) const
 
 string Formatter::Render(const threading::Value::subnet_t& subnet)
 	{
-	char l[16];
+	char buf[RENDER_BUF_SIZE];
+	return Render(subnet, buf);
+	}
+
+const char* Formatter::Render(const threading::Value::subnet_t& subnet, char* buf)
+	{
+	const char* prefix = Render(subnet.prefix, buf);
+
+	if ( prefix != buf )
+		// Conversion failed, keep the error message.
+		strcpy(buf, prefix);
+
+	char* p = buf + strlen(buf);
+	*p++ = '/';
 
 	if ( subnet.prefix.family == IPv4 )
-		modp_uitoa10(subnet.length - 96, l);
+		modp_uitoa10(subnet.length - 96, p);
 	else
-		modp_uitoa10(subnet.length, l);
-
-	string s = Render(subnet.prefix) + "/" + l;
+		modp_uitoa10(subnet.length, p);
 
-	return s;
+	return buf;
 	}
 
 string Formatter::Render(double d)
 	{
-	char buf[256];
+	char buf[RENDER_BUF_SIZE];
+	return Render(d, buf);
+	}
+
+const char* Formatter::Render(double d, char* buf)
+	{
 	modp_dtoa(d, buf, 6);
 	return buf;
 	}
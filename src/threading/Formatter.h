@@ -89,6 +89,24 @@ public:
 	 */
 	static string Render(const threading::Value::addr_t& addr);
 
+	/**
+	 * The minimum size of the buffers passed to the Render() variants
+	 * that write into caller-provided memory.
+	 */
+	static const int RENDER_BUF_SIZE = 64;
+
+	/**
+	 * Convert an IP address into a string, like Render() but without
+	 * allocating.
+	 *
+	 * @param addr The address.
+	 *
+	 * @param buf A buffer of at least RENDER_BUF_SIZE bytes.
+	 *
+	 * @return *buf*, holding the NUL-terminated representation.
+	 */
+	static const char* Render(const threading::Value::addr_t& addr, char* buf);
+
 	/**
 	 * Convert an subnet value into a string.
 	 *
@@ -100,6 +118,18 @@ public:
 	 */
 	static string Render(const threading::Value::subnet_t& subnet);
 
+	/**
+	 * Convert a subnet value into a string, like Render() but without
+	 * allocating.
+	 *
+	 * @param subnet The subnet.
+	 *
+	 * @param buf A buffer of at least RENDER_BUF_SIZE bytes.
+	 *
+	 * @return *buf*, holding the NUL-terminated representation.
+	 */
+	static const char* Render(const threading::Value::subnet_t& subnet, char* buf);
+
 	/**
 	 * Convert a double into a string. This renders the double with Bro's
 	 * standard precision.
@@ -112,6 +142,18 @@ public:
 	 */
 	static string Render(double d);
 
+	/**
+	 * Convert a double into a string, like Render() but without
+	 * allocating.
+	 *
+	 * @param d The double.
+	 *
+	 * @param buf A buffer of at least RENDER_BUF_SIZE bytes.
+	 *
+	 * @return *buf*, holding the NUL-terminated representation.
+	 */
+	static const char* Render(double d, char* buf);
+
 	/**
 	 * Convert a transport protocol into a string.
 	 *
@@ -0,0 +1,100 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef THREADING_MPSCQUEUE_H
+#define THREADING_MPSCQUEUE_H
+
+#include <atomic>
+
+namespace threading {
+
+/**
+ * A lock-free multi-producer single-consumer FIFO queue, following Dmitry
+ * Vyukov's node-based design. Any thread may push; only a single thread
+ * may pop. Pushing never blocks or spins, and popping is a couple of
+ * loads. Elements pushed by the same thread come out in the order they
+ * went in.
+ *
+ * A pop may briefly see the queue as empty while another element's push
+ * is still in progress, but that element will show up on a later pop.
+ */
+template<typename T>
+class MPSCQueue
+{
+public:
+	/**
+	 * Constructor.
+	 */
+	MPSCQueue()
+		{
+		Node* stub = new Node;
+		stub->next.store(0, std::memory_order_relaxed);
+		head.store(stub, std::memory_order_relaxed);
+		tail = stub;
+		}
+
+	/**
+	 * Destructor. Elements still queued are dropped; it's up to the
+	 * caller to pop whatever needs cleaning up first.
+	 */
+	~MPSCQueue()
+		{
+		T data;
+		while ( Pop(&data) )
+			;
+
+		delete tail;
+		}
+
+	/**
+	 * Queues one element. May be called from any thread.
+	 */
+	void Push(const T& data)
+		{
+		Node* n = new Node;
+		n->data = data;
+		n->next.store(0, std::memory_order_relaxed);
+
+		Node* prev = head.exchange(n, std::memory_order_acq_rel);
+		prev->next.store(n, std::memory_order_release);
+		}
+
+	/**
+	 * Retrieves the oldest element, if any. Must only be called by the
+	 * consumer.
+	 *
+	 * @return True if an element has been stored in *data.
+	 */
+	bool Pop(T* data)
+		{
+		Node* next = tail->next.load(std::memory_order_acquire);
+
+		if ( ! next )
+			return false;
+
+		// The node we pop becomes the new stub.
+		*data = next->data;
+		delete tail;
+		tail = next;
+		return true;
+		}
+
+	/**
+	 * Returns true if a Pop() would currently return nothing. Must only
+	 * be called by the consumer.
+	 */
+	bool Empty() const
+		{ return tail->next.load(std::memory_order_acquire) == 0; }
+
+private:
+	struct Node {
+		std::atomic<Node*> next;
+		T data;
+	};
+
+	std::atomic<Node*> head;	// Most recently pushed, written by producers.
+	Node* tail;	// Stub preceding the oldest element, owned by the consumer.
+};
+
+}
+
+#endif
@@ -1,6 +1,7 @@
 
 #include "Manager.h"
 #include "NetVar.h"
+#include "Net.h"
 
 using namespace threading;
 
@@ -41,6 +42,13 @@ void Manager::Terminate()
 	for ( all_thread_list::iterator i = all_threads.begin(); i != all_threads.end(); i++ )
 		{
 		(*i)->Join();
+
+		MsgThread* mt = dynamic_cast<MsgThread *>(*i);
+
+		// Its last messages may still be waiting for us.
+		while ( mt && mt->HasOut() )
+			ProcessMessages();
+
 		delete *i;
 		}
 
@@ -119,34 +127,15 @@ void Manager::Process()
 
 	did_process = false;
 
-	for ( msg_thread_list::iterator i = msg_threads.begin(); i != msg_threads.end(); i++ )
+	if ( do_beat )
 		{
-		MsgThread* t = *i;
-
-		if ( do_beat )
-			t->Heartbeat();
-
-		while ( t->HasOut() )
-			{
-			Message* msg = t->RetrieveOut();
-			assert(msg);
-
-			if ( msg->Process() )
-				{
-				if ( network_time )
-					did_process = true;
-				}
-
-			else
-				{
-				reporter->Error("%s failed, terminating thread", msg->Name());
-				t->SignalStop();
-				}
-
-			delete msg;
-			}
+		for ( msg_thread_list::iterator i = msg_threads.begin(); i != msg_threads.end(); i++ )
+			(*i)->Heartbeat();
 		}
 
+	if ( ProcessMessages(true) > 0 && network_time )
+		did_process = true;
+
 	all_thread_list to_delete;
 
 	for ( all_thread_list::iterator i = all_threads.begin(); i != all_threads.end(); i++ )
@@ -167,15 +156,94 @@ void Manager::Process()
 		MsgThread* mt = dynamic_cast<MsgThread *>(t);
 
 		if ( mt )
+			{
+			ProcessHeldMessages(mt, false);
 			msg_threads.remove(mt);
+			}
 
 		t->Join();
+
+		// Its last messages may still be waiting for us.
+		while ( mt && mt->HasOut() )
+			ProcessMessages();
+
 		delete t;
 		}
 
 //	fprintf(stderr, "P %.6f %.6f do_beat=%d did_process=%d next_next=%.6f\n", network_time, timer_mgr->Time(), do_beat, (int)did_process, next_beat);
 	}
 
+void Manager::DispatchMessage(MsgThread* thread, BasicOutputMessage* msg)
+	{
+	--thread->pending_out;
+	++thread->out_this_round;
+
+	DBG_LOG(DBG_THREADING, "Retrieved '%s' from %s",  msg->Name(), thread->Name());
+
+	if ( ! msg->Process() )
+		{
+		reporter->Error("%s failed, terminating thread", msg->Name());
+		thread->SignalStop();
+		}
+
+	delete msg;
+	}
+
+int Manager::ProcessHeldMessages(MsgThread* thread, bool budgeted)
+	{
+	int n = 0;
+
+	while ( ! thread->held_out.empty() )
+		{
+		if ( budgeted && (net_work_budget_exceeded() ||
+				  (thread->max_out_per_round &&
+				   thread->out_this_round >= thread->max_out_per_round)) )
+			break;
+
+		BasicOutputMessage* msg = thread->held_out.front();
+		thread->held_out.pop_front();
+		DispatchMessage(thread, msg);
+		++n;
+		}
+
+	return n;
+	}
+
+int Manager::ProcessMessages(bool budgeted)
+	{
+	int n = 0;
+	InboundMessage m;
+
+	// Held back messages go first, they're older than anything from
+	// the same thread still in the inbound queue.
+	for ( msg_thread_list::iterator i = msg_threads.begin(); i != msg_threads.end(); i++ )
+		{
+		if ( budgeted )
+			(*i)->out_this_round = 0;
+
+		n += ProcessHeldMessages(*i, budgeted);
+		}
+
+	while ( ! (budgeted && net_work_budget_exceeded()) && inbound.Pop(&m) )
+		{
+		MsgThread* t = m.thread;
+
+		if ( budgeted && (! t->held_out.empty() ||
+				  (t->max_out_per_round && t->out_this_round >= t->max_out_per_round)) )
+			{
+			// Keep it for a later round, along with whatever
+			// else comes from this thread.
+			t->held_out.push_back(m.msg);
+			continue;
+			}
+
+		DispatchMessage(t, m.msg);
+		++n;
+		}
+
+	return n;
+	}
+
 const threading::Manager::msg_stats_list& threading::Manager::GetMsgThreadStats()
 	{
 	stats.clear();
@@ -8,6 +8,7 @@
 
 #include "BasicThread.h"
 #include "MsgThread.h"
+#include "MPSCQueue.h"
 
 namespace threading {
 
@@ -17,9 +18,10 @@ namespace threading {
  * once it has terminated.
  *
  * In addition to basic threads, the manager also provides additional
- * functionality specific to MsgThread instances. In particular, it polls
- * their outgoing message queue on a regular basis and feeds data sent into
- * the rest of Bro. It also triggers the regular heartbeats.
+ * functionality specific to MsgThread instances. In particular, it drains
+ * the lock-free queue that all of them send their messages to the main
+ * thread through on a regular basis, and feeds data sent into the rest of
+ * Bro. It also triggers the regular heartbeats.
  */
 class Manager : public iosource::IOSource
 {
@@ -78,6 +80,17 @@ public:
 	 */
 	void KillThreads();
 
+	/**
+	 * Processes all messages from threads that are currently queued for
+	 * the main thread, in the order each thread sent them.
+	 *
+	 * @param budgeted If true, stops early once the main loop's work
+	 * budget is used up, leaving the rest queued.
+	 *
+	 * @return The number of messages processed.
+	 */
+	int ProcessMessages(bool budgeted = false);
+
 protected:
 	friend class BasicThread;
 	friend class MsgThread;
@@ -100,6 +113,17 @@ protected:
 	 */
 	void AddMsgThread(MsgThread* thread);
 
+	/**
+	 * Queues a message from a thread for the main thread. May be called
+	 * from any thread.
+	 *
+	 * @param thread The sending thread.
+	 *
+	 * @param msg The message, with ownership passed to the manager.
+	 */
+	void QueueMessage(MsgThread* thread, BasicOutputMessage* msg)
+		{ inbound.Push(InboundMessage{thread, msg}); }
+
 	/**
 	 * Part of the IOSource interface.
 	 */
@@ -133,6 +157,20 @@ private:
 	bool terminating;	// True if we are in Terminate().
 
 	msg_stats_list stats;
+
+	// Processes one message from a thread.
+	void DispatchMessage(MsgThread* thread, BasicOutputMessage* msg);
+
+	// Processes messages that a thread's per-round limit has held back,
+	// as far as the limit and, if budgeted, the work budget allow.
+	int ProcessHeldMessages(MsgThread* thread, bool budgeted);
+
+	struct InboundMessage {
+		MsgThread* thread;
+		BasicOutputMessage* msg;
+	};
+
+	MPSCQueue<InboundMessage> inbound;
 };
 
 }
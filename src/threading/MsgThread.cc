@@ -171,9 +171,11 @@ bool ReporterMessage::Process()
 	return true;
 	}
 
-MsgThread::MsgThread() : BasicThread(), queue_in(this, 0), queue_out(0, this)
+MsgThread::MsgThread() : BasicThread(), queue_in(this, 0)
 	{
 	cnt_sent_in = cnt_sent_out = 0;
+	pending_out = 0;
+	max_out_per_round = out_this_round = 0;
 	main_finished = false;
 	child_finished = false;
 	failed = false;
@@ -230,16 +232,8 @@ void MsgThread::OnWaitForStop()
 		if ( ! Killed() )
 			queue_in.WakeUp();
 
-		while ( HasOut() )
-			{
-			Message* msg = RetrieveOut();
-			assert ( msg );
-
-			if ( ! msg->Process() )
-				reporter->Error("%s failed during thread termination", msg->Name());
-
-			delete msg;
-			}
+		if ( HasOut() )
+			thread_mgr->ProcessMessages();
 
 		if ( ! Killed() )
 			usleep(1000);
@@ -336,22 +330,14 @@ void MsgThread::SendOut(BasicOutputMessage* msg, bool force)
 		return;
 		}
 
-	queue_out.Put(msg);
+	// Count it first, so that the main thread can't see it processed
+	// before it's been counted.
+	++pending_out;
+	thread_mgr->QueueMessage(this, msg);
 
 	++cnt_sent_out;
 	}
 
-BasicOutputMessage* MsgThread::RetrieveOut()
-	{
-	BasicOutputMessage* msg = queue_out.Get();
-	if ( ! msg )
-		return 0;
-
-	DBG_LOG(DBG_THREADING, "Retrieved '%s' from %s",  msg->Name(), Name());
-
-	return msg;
-	}
-
 BasicInputMessage* MsgThread::RetrieveIn()
 	{
 	BasicInputMessage* msg = queue_in.Get();
@@ -408,8 +394,9 @@ void MsgThread::GetStats(Stats* stats)
 	stats->sent_in = cnt_sent_in;
 	stats->sent_out = cnt_sent_out;
 	stats->pending_in = queue_in.Size();
-	stats->pending_out = queue_out.Size();
+	stats->pending_out = pending_out.load();
 	queue_in.GetStats(&stats->queue_in_stats);
-	queue_out.GetStats(&stats->queue_out_stats);
+	stats->queue_out_stats.num_writes = stats->sent_out;
+	stats->queue_out_stats.num_reads = stats->sent_out - stats->pending_out;
 	}
 
@@ -2,6 +2,9 @@
 #ifndef THREADING_MSGTHREAD_H
 #define THREADING_MSGTHREAD_H
 
+#include <atomic>
+#include <deque>
+
 #include "DebugLogger.h"
 
 #include "BasicThread.h"
@@ -176,6 +179,17 @@ public:
 	 */
 	void GetStats(Stats* stats);
 
+	/**
+	 * Limits how many of the thread's messages the main thread processes
+	 * per round, spreading large amounts of output across several
+	 * main-loop iterations. Messages still get processed in order.
+	 *
+	 * Must only be called by the main thread.
+	 *
+	 * @param n The maximum, or 0 for no limit.
+	 */
+	void SetMaxOutPerRound(uint64_t n)	{ max_out_per_round = n; }
+
 protected:
 	friend class Manager;
 	friend class HeartbeatMessage;
@@ -183,16 +197,6 @@ protected:
 	friend class FinishedMessage;
 	friend class KillMeMessage;
 
-	/**
-	 * Pops a message sent by the child from the child-to-main queue.
-	 *
-	 * This is method is called regularly by the threading::Manager.
-	 *
-	 * @return The message, wth ownership passed to caller. Returns null
-	 * if the queue is empty.
-	 */
-	BasicOutputMessage* RetrieveOut();
-
 	/**
 	 * Triggers a heartbeat message being sent to the client thread.
 	 *
@@ -285,14 +289,14 @@ private:
 	 * Returns true if there's at least one message pending for the main
 	 * thread.
 	 */
-	bool HasOut()	{ return queue_out.Ready(); }
+	bool HasOut()	{ return pending_out.load() > 0; }
 
 	/**
 	 * Returns true if there might be at least one message pending for
-	 * the main thread. This function may occasionally return a value not
-	 * indicating the actual state, but won't do so very often.
+	 * the main thread. The main thread only ever sees messages becoming
+	 * pending late, never processed ones as pending.
 	 */
-	bool MightHaveOut() { return queue_out.MaybeReady(); }
+	bool MightHaveOut() { return pending_out.load(std::memory_order_relaxed) > 0; }
 
 	/** Sends a message to the main thread signaling that the child process
 	 *  has finished processing. Called from child.
@@ -300,11 +304,19 @@ private:
 	void Finished();
 
 	Queue<BasicInputMessage *> queue_in;
-	Queue<BasicOutputMessage *> queue_out;
+
+	// Messages to the main thread go into the threading::Manager's
+	// inbound queue, shared by all threads. This counts ours in there.
+	std::atomic<uint64_t> pending_out;
 
 	uint64_t cnt_sent_in;	// Counts message sent to child.
 	uint64_t cnt_sent_out;	// Counts message sent by child.
 
+	// Per-round limit, only accessed by the main thread.
+	uint64_t max_out_per_round;	// Zero for none.
+	uint64_t out_this_round;	// Messages processed in the current round.
+	std::deque<BasicOutputMessage*> held_out;	// Over the limit, for later rounds.
+
 	bool main_finished;	// Main thread is finished, meaning child_finished propagated back through message queue.
 	bool child_finished;	// Child thread is finished.
 	bool failed;	// Set to true when a command failed.
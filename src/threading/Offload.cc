@@ -0,0 +1,145 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <unistd.h>
+
+#include "Offload.h"
+#include "Manager.h"
+#include "Net.h"
+#include "NetVar.h"
+#include "Reporter.h"
+
+using namespace threading;
+
+threading::OffloadPool* offload_pool = new OffloadPool();
+
+namespace threading {
+
+// Hands a job to a worker.
+class OffloadRunMessage : public InputMessage<OffloadThread> {
+public:
+	OffloadRunMessage(OffloadThread* thread, OffloadJob* arg_job)
+		: InputMessage<OffloadThread>("OffloadRun", thread)
+		{ job = arg_job; }
+
+	bool Process() override;
+
+private:
+	OffloadJob* job;
+};
+
+// Hands a job that has run back to the main thread.
+class OffloadDoneMessage : public OutputMessage<OffloadThread> {
+public:
+	OffloadDoneMessage(OffloadThread* thread, OffloadJob* arg_job)
+		: OutputMessage<OffloadThread>("OffloadDone", thread)
+		{ job = arg_job; }
+
+	bool Process() override
+		{
+		Object()->Pool()->JobDone(job);
+		return true;
+		}
+
+private:
+	OffloadJob* job;
+};
+
+}
+
+bool OffloadRunMessage::Process()
+	{
+	job->Run();
+	Object()->SendOut(new OffloadDoneMessage(Object(), job));
+	return true;
+	}
+
+OffloadThread::OffloadThread(OffloadPool* arg_pool, int idx)
+	{
+	pool = arg_pool;
+	SetName(fmt("offload/%d", idx));
+	}
+
+void OffloadThread::ProcessResults()
+	{
+	// Our results arrive through the manager's queue along with
+	// everybody else's messages.
+	thread_mgr->ProcessMessages();
+	}
+
+OffloadPool::OffloadPool()
+	{
+	next_thread = 0;
+	started = false;
+	}
+
+void OffloadPool::Start()
+	{
+	started = true;
+
+	for ( bro_uint_t i = 0; i < BifConst::Threading::offload_threads; ++i )
+		{
+		OffloadThread* t = new OffloadThread(this, i);
+		t->Start();
+		threads.push_back(t);
+		}
+	}
+
+void OffloadPool::Submit(OffloadJob* job)
+	{
+	Dispatch(job, next_thread++);
+	}
+
+void OffloadPool::Submit(OffloadJob* job, size_t affinity)
+	{
+	Dispatch(job, affinity);
+	}
+
+void OffloadPool::Dispatch(OffloadJob* job, size_t thread_idx)
+	{
+	if ( ! started )
+		Start();
+
+	job->done = false;
+
+	if ( threads.empty() || terminating )
+		{
+		// Nothing to offload to. We still keep the order with jobs
+		// that may still be pending.
+		job->Run();
+		jobs.push_back(job);
+		JobDone(job);
+		return;
+		}
+
+	jobs.push_back(job);
+
+	OffloadThread* t = threads[thread_idx % threads.size()];
+	t->SendIn(new OffloadRunMessage(t, job));
+	}
+
+void OffloadPool::JobDone(OffloadJob* job)
+	{
+	job->done = true;
+
+	// Complete everything that's next in line; a job finishing early
+	// has to wait for those submitted before it.
+	while ( ! jobs.empty() && jobs.front()->done )
+		{
+		OffloadJob* j = jobs.front();
+		jobs.pop_front();
+		j->Complete();
+		delete j;
+		}
+	}
+
+void OffloadPool::Drain()
+	{
+	while ( ! jobs.empty() )
+		{
+		for ( const auto& t : threads )
+			t->ProcessResults();
+
+		if ( ! jobs.empty() )
+			usleep(100);
+		}
+	}
@@ -0,0 +1,128 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef THREADING_OFFLOAD_H
+#define THREADING_OFFLOAD_H
+
+#include <deque>
+#include <vector>
+
+#include "MsgThread.h"
+
+namespace threading {
+
+class OffloadThread;
+class OffloadDoneMessage;
+
+/**
+ * A unit of work that an analyzer hands off to a worker thread. The
+ * expensive part goes into Run(), which executes inside a worker thread;
+ * Complete() then executes back in the main thread and reports the results.
+ */
+class OffloadJob {
+public:
+	/**
+	 * Destructor.
+	 */
+	virtual ~OffloadJob()	{ }
+
+	/**
+	 * Performs the work. Called from a worker thread, so this must not
+	 * access any of the main thread's data structures, such as Vals,
+	 * the reporter, or the event manager.
+	 */
+	virtual void Run() = 0;
+
+	/**
+	 * Reports the results. Called from the main thread once Run() has
+	 * finished, and once all jobs submitted earlier have completed.
+	 */
+	virtual void Complete() = 0;
+
+private:
+	friend class OffloadPool;
+
+	bool done;
+};
+
+/**
+ * A pool of worker threads that process OffloadJobs. The size of the pool
+ * is given by \c Threading::offload_threads; if that's zero, jobs just run
+ * right away when submitted. Jobs complete in the order they have been
+ * submitted, regardless of which worker they ran on.
+ */
+class OffloadPool {
+public:
+	/**
+	 * Constructor. The threads get started with the first job.
+	 */
+	OffloadPool();
+
+	/**
+	 * Passes a job on to a worker, taking ownership. Only the main
+	 * thread may call this method.
+	 */
+	void Submit(OffloadJob* job);
+
+	/**
+	 * Like Submit(), but runs all jobs of the same affinity on the same
+	 * worker, so that they also run in the order submitted. Only the
+	 * main thread may call this method.
+	 */
+	void Submit(OffloadJob* job, size_t affinity);
+
+	/**
+	 * Blocks until all jobs submitted so far have completed. Only the
+	 * main thread may call this method.
+	 */
+	void Drain();
+
+	/**
+	 * Returns the number of jobs that haven't completed yet.
+	 */
+	size_t Pending() const	{ return jobs.size(); }
+
+private:
+	friend class OffloadDoneMessage;
+
+	void Start();
+	void Dispatch(OffloadJob* job, size_t thread_idx);
+
+	// Called by the worker once it's done running a job.
+	void JobDone(OffloadJob* job);
+
+	std::vector<OffloadThread*> threads;
+	size_t next_thread;
+	bool started;
+
+	// Jobs that haven't completed yet, in submission order.
+	std::deque<OffloadJob*> jobs;
+};
+
+/**
+ * A worker thread of an OffloadPool.
+ */
+class OffloadThread : public MsgThread {
+public:
+	OffloadThread(OffloadPool* pool, int idx);
+
+	// Processes any jobs this worker has finished. Called from the main
+	// thread while draining the pool.
+	void ProcessResults();
+
+	OffloadPool* Pool() const	{ return pool; }
+
+protected:
+	bool OnHeartbeat(double network_time, double current_time) override
+		{ return true; }
+	bool OnFinish(double network_time) override
+		{ return true; }
+
+private:
+	OffloadPool* pool;
+};
+
+}
+
+extern threading::OffloadPool* offload_pool;
+
+#endif
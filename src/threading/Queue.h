@@ -1,9 +1,9 @@
 #ifndef THREADING_QUEUE_H
 #define THREADING_QUEUE_H
 
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
 #include <deque>
 #include <stdint.h>
 #include <sys/time.h>
@@ -18,13 +18,15 @@ namespace threading {
 /**
  * A thread-safe single-reader single-writer queue.
  *
- * The implementation uses multiple queues and reads/writes in rotary fashion
- * in an attempt to limit contention.
+ * Elements go through a fixed-size lock-free ring, so neither side takes a
+ * lock as long as the ring has room and the reader has something to do.
+ * If the writer outpaces the reader far enough to fill the ring, further
+ * elements spill into a mutex-protected overflow list until the reader
+ * has caught up. A reader that runs out of input sleeps on a condition
+ * variable, which the writer signals only while the reader is actually
+ * sleeping.
  *
  * All Queue instances must be instantiated by Bro's main thread.
- *
- * TODO: Unclear how critical performance is for this qeueue. We could likely
- * optimize it further if helpful.
  */
 template<typename T>
 class Queue
@@ -67,10 +69,10 @@ public:
 	 * state, but won't do so very often. Note that this means that it can
 	 * consistently return false even if there is something in the Queue.
 	 * You have to check real queue status from time to time to be sure that
-	 * it is empty. In other words, this method helps to avoid locking the queue
-	 * frequently, but doesn't allow you to forgo it completely.
+	 * it is empty.
 	 */
-	bool MaybeReady() { return (num_reads != num_writes); }
+	bool MaybeReady()
+		{ return num_reads.load(std::memory_order_relaxed) != num_writes.load(std::memory_order_relaxed); }
 
 	/**
 	 * Wake up the reader if it's currently blocked for input. This is
@@ -101,23 +103,35 @@ public:
 	void GetStats(Stats* stats);
 
 private:
-	static const int NUM_QUEUES = 8;
+	// Number of ring slots; must be a power of two.
+	static const uint64_t RING_SIZE = 1024;
+
+	bool TryPop(T* data);
+	bool Empty();
 
-	std::vector<std::unique_lock<std::mutex>> LocksForAllQueues();
+	// The ring. The writer owns ring_tail, the reader ring_head; both
+	// only ever grow, and are taken modulo RING_SIZE to index.
+	T ring[RING_SIZE];
+	std::atomic<uint64_t> ring_head;
+	std::atomic<uint64_t> ring_tail;
 
-	std::mutex mutex[NUM_QUEUES];	// Mutex protected shared accesses.
-	std::condition_variable has_data[NUM_QUEUES];	// Signals when data becomes available
-	std::queue<T> messages[NUM_QUEUES];	// Actually holds the queued messages
+	// Elements that didn't fit into the ring. While there are any, all
+	// new ones go here as well to keep them in order.
+	std::mutex overflow_mutex;
+	std::deque<T> overflow;
+	std::atomic<bool> overflowing;
 
-	int read_ptr;	// Where the next operation will read from
-	int write_ptr;	// Where the next operation will write to
+	// For the reader to wait for input.
+	std::mutex wait_mutex;
+	std::condition_variable has_data;
+	std::atomic<bool> reader_waiting;
 
 	BasicThread* reader;
 	BasicThread* writer;
 
 	// Statistics.
-	uint64_t num_reads;
-	uint64_t num_writes;
+	std::atomic<uint64_t> num_reads;
+	std::atomic<uint64_t> num_writes;
 };
 
 inline static std::unique_lock<std::mutex> acquire_lock(std::mutex& m)
@@ -137,8 +151,9 @@ inline static std::unique_lock<std::mutex> acquire_lock(std::mutex& m)
 template<typename T>
 inline Queue<T>::Queue(BasicThread* arg_reader, BasicThread* arg_writer)
 	{
-	read_ptr = 0;
-	write_ptr = 0;
+	ring_head = ring_tail = 0;
+	overflowing = false;
+	reader_waiting = false;
 	num_reads = num_writes = 0;
 	reader = arg_reader;
 	writer = arg_writer;
@@ -150,113 +165,135 @@ inline Queue<T>::~Queue()
 	}
 
 template<typename T>
-inline T Queue<T>::Get()
+inline bool Queue<T>::TryPop(T* data)
 	{
-	auto lock = acquire_lock(mutex[read_ptr]);
+	// Check for overflow first: if it has started, everything that went
+	// into the ring before is visible to us now.
+	bool have_overflow = overflowing.load(std::memory_order_acquire);
 
-	int old_read_ptr = read_ptr;
+	uint64_t head = ring_head.load(std::memory_order_relaxed);
 
-	if ( messages[read_ptr].empty() && ! ((reader && reader->Killed()) || (writer && writer->Killed())) )
+	if ( head != ring_tail.load(std::memory_order_acquire) )
 		{
-		if ( has_data[read_ptr].wait_for(lock, std::chrono::seconds(5)) == std::cv_status::timeout )
-			return nullptr;
+		*data = ring[head % RING_SIZE];
+		ring_head.store(head + 1, std::memory_order_release);
+		// Only we write this, no need for an atomic increment.
+		num_reads.store(num_reads.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return true;
 		}
 
-	if ( messages[read_ptr].empty() )
-		return nullptr;
+	if ( ! have_overflow )
+		return false;
+
+	auto lock = acquire_lock(overflow_mutex);
 
-	T data = messages[read_ptr].front();
-	messages[read_ptr].pop();
+	if ( overflow.empty() )
+		return false;
 
-	read_ptr = (read_ptr + 1) % NUM_QUEUES;
-	++num_reads;
+	*data = overflow.front();
+	overflow.pop_front();
 
-	return data;
+	if ( overflow.empty() )
+		overflowing.store(false, std::memory_order_release);
+
+	num_reads.store(num_reads.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	return true;
 	}
 
 template<typename T>
-inline void Queue<T>::Put(T data)
+inline bool Queue<T>::Empty()
 	{
-	auto lock = acquire_lock(mutex[write_ptr]);
+	return ring_head.load(std::memory_order_acquire) == ring_tail.load(std::memory_order_acquire) &&
+		! overflowing.load(std::memory_order_acquire);
+	}
 
-	int old_write_ptr = write_ptr;
+template<typename T>
+inline T Queue<T>::Get()
+	{
+	T data;
 
-	bool need_signal = messages[write_ptr].empty();
+	if ( TryPop(&data) )
+		return data;
 
-	messages[write_ptr].push(data);
+	if ( (reader && reader->Killed()) || (writer && writer->Killed()) )
+		return nullptr;
 
-	write_ptr = (write_ptr + 1) % NUM_QUEUES;
-	++num_writes;
+	// Announce that we're going to sleep before checking one last time,
+	// so that a writer either sees us waiting or we see its element.
+	auto lock = acquire_lock(wait_mutex);
+	reader_waiting.store(true);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
 
-	if ( need_signal )
+	has_data.wait_for(lock, std::chrono::seconds(5), [this]()
 		{
-		lock.unlock();
-		has_data[old_write_ptr].notify_one();
-		}
-	}
+		return ! Empty() ||
+			(reader && reader->Killed()) || (writer && writer->Killed());
+		});
 
+	reader_waiting.store(false);
+	lock.unlock();
 
-template<typename T>
-inline bool Queue<T>::Ready()
-	{
-	auto lock = acquire_lock(mutex[read_ptr]);
-
-	bool ret = (messages[read_ptr].size());
+	if ( TryPop(&data) )
+		return data;
 
-	return ret;
+	return nullptr;
 	}
 
 template<typename T>
-inline std::vector<std::unique_lock<std::mutex>> Queue<T>::LocksForAllQueues()
+inline void Queue<T>::Put(T data)
 	{
-	std::vector<std::unique_lock<std::mutex>> locks;
+	uint64_t tail = ring_tail.load(std::memory_order_relaxed);
 
-	try
+	if ( ! overflowing.load(std::memory_order_relaxed) &&
+	     tail - ring_head.load(std::memory_order_acquire) < RING_SIZE )
 		{
-		for ( int i = 0; i < NUM_QUEUES; i++ )
-			locks.emplace_back(std::unique_lock<std::mutex>(mutex[i]));
+		ring[tail % RING_SIZE] = data;
+		ring_tail.store(tail + 1, std::memory_order_release);
+		}
+	else
+		{
+		auto lock = acquire_lock(overflow_mutex);
+		overflow.push_back(data);
+		overflowing.store(true, std::memory_order_release);
 		}
 
-	catch ( const std::system_error& e )
+	num_writes.store(num_writes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if ( reader_waiting.load(std::memory_order_relaxed) )
 		{
-		reporter->FatalErrorWithCore("cannot lock all mutexes: %s", e.what());
-		// Never gets here.
-		throw std::exception();
+		// Taking the mutex makes sure the reader is either still
+		// before its final check or already waiting.
+		auto lock = acquire_lock(wait_mutex);
+		has_data.notify_one();
 		}
+	}
 
-	return locks;
+template<typename T>
+inline bool Queue<T>::Ready()
+	{
+	return ! Empty();
 	}
 
 template<typename T>
 inline uint64_t Queue<T>::Size()
 	{
-	// Need to lock all queues.
-	auto locks = LocksForAllQueues();
-
-	uint64_t size = 0;
-
-	for ( int i = 0; i < NUM_QUEUES; i++ )
-		size += messages[i].size();
-
-	return size;
+	return num_writes.load() - num_reads.load();
 	}
 
 template<typename T>
 inline void Queue<T>::GetStats(Stats* stats)
 	{
-	// To be safe, we look all queues. That's probably unneccessary, but
-	// doesn't really hurt.
-	auto locks = LocksForAllQueues();
-
-	stats->num_reads = num_reads;
-	stats->num_writes = num_writes;
+	stats->num_reads = num_reads.load();
+	stats->num_writes = num_writes.load();
 	}
 
 template<typename T>
 inline void Queue<T>::WakeUp()
 	{
-	for ( int i = 0; i < NUM_QUEUES; i++ )
-		has_data[i].notify_all();
+	auto lock = acquire_lock(wait_mutex);
+	has_data.notify_all();
 	}
 
 }
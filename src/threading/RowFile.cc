@@ -0,0 +1,197 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include <arpa/inet.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "RowFile.h"
+#include "SerializationFormat.h"
+
+using namespace threading;
+
+static const char ROW_FILE_MAGIC[8] = { 'Z', 'E', 'E', 'K', 'R', 'O', 'W', '1' };
+
+// Limits that only damaged files exceed.
+static const uint32 MAX_SCHEMA_SIZE = 1024 * 1024;
+static const uint32 MAX_BLOCK_SIZE = 1024 * 1024 * 1024;
+
+struct BlockHeader {
+	uint32 num_rows;
+	uint32 raw_len;	// Length of the serialized rows.
+	uint32 stored_len;	// Length of what follows in the file.
+	uint32 crc;	// CRC-32 of what follows in the file.
+};
+
+// Reads exactly len bytes starting at the current position. If they're
+// not all there yet, goes back to where we started.
+static bool read_all(FILE* f, void* buf, size_t len, off_t start)
+	{
+	if ( fread(buf, 1, len, f) == len )
+		return true;
+
+	clearerr(f);
+	fseeko(f, start, SEEK_SET);
+	return false;
+	}
+
+bool RowFile::WriteHeader(FILE* f, int num_fields, const Field* const* fields)
+	{
+	BinarySerializationFormat fmt;
+	fmt.StartWrite();
+	fmt.Write(num_fields, "num_fields");
+
+	for ( int i = 0; i < num_fields; ++i )
+		fields[i]->Write(&fmt);
+
+	char* schema;
+	uint32 len = fmt.EndWrite(&schema);
+	uint32 nlen = htonl(len);
+	uint32 crc = htonl(crc32(0, (const Bytef*) schema, len));
+
+	bool ok = fwrite(ROW_FILE_MAGIC, sizeof(ROW_FILE_MAGIC), 1, f) == 1 &&
+		fwrite(&nlen, sizeof(nlen), 1, f) == 1 &&
+		fwrite(&crc, sizeof(crc), 1, f) == 1 &&
+		fwrite(schema, len, 1, f) == 1;
+
+	free(schema);
+	return ok;
+	}
+
+bool RowFile::WriteBlock(FILE* f, const char* data, uint32 len,
+			 uint32 num_rows, bool compress)
+	{
+	std::string compressed;
+	const char* stored = data;
+	uLongf stored_len = len;
+
+	if ( compress )
+		{
+		uLongf clen = compressBound(len);
+		compressed.resize(clen);
+
+		if ( compress2((Bytef*) &compressed[0], &clen, (const Bytef*) data,
+			       len, Z_DEFAULT_COMPRESSION) == Z_OK &&
+		     clen < len )
+			{
+			stored = compressed.data();
+			stored_len = clen;
+			}
+		}
+
+	BlockHeader hdr;
+	hdr.num_rows = htonl(num_rows);
+	hdr.raw_len = htonl(len);
+	hdr.stored_len = htonl(stored_len);
+	hdr.crc = htonl(crc32(0, (const Bytef*) stored, stored_len));
+
+	return fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+		fwrite(stored, stored_len, 1, f) == 1;
+	}
+
+RowFile::ReadResult RowFile::ReadHeader(FILE* f, std::vector<Field*>* fields,
+					std::string* error)
+	{
+	off_t start = ftello(f);
+	char magic[sizeof(ROW_FILE_MAGIC)];
+	uint32 len;
+	uint32 crc;
+
+	if ( ! read_all(f, magic, sizeof(magic), start) ||
+	     ! read_all(f, &len, sizeof(len), start) ||
+	     ! read_all(f, &crc, sizeof(crc), start) )
+		return READ_END;
+
+	len = ntohl(len);
+
+	if ( memcmp(magic, ROW_FILE_MAGIC, sizeof(magic)) != 0 || len > MAX_SCHEMA_SIZE )
+		{
+		*error = "not a Zeek row file";
+		return READ_ERROR;
+		}
+
+	std::string schema(len, '\0');
+
+	if ( ! read_all(f, &schema[0], len, start) )
+		return READ_END;
+
+	if ( crc32(0, (const Bytef*) schema.data(), len) != ntohl(crc) )
+		{
+		*error = "schema checksum mismatch";
+		return READ_ERROR;
+		}
+
+	BinarySerializationFormat fmt;
+	fmt.StartRead(schema.data(), len);
+
+	int num_fields;
+	bool ok = fmt.Read(&num_fields, "num_fields") && num_fields >= 0;
+
+	for ( int i = 0; ok && i < num_fields; ++i )
+		{
+		Field* field = new Field(0, 0, TYPE_VOID, TYPE_VOID, false);
+		fields->push_back(field);
+		ok = field->Read(&fmt);
+		}
+
+	fmt.EndRead();
+
+	if ( ! ok )
+		{
+		*error = "cannot decode schema";
+		return READ_ERROR;
+		}
+
+	return READ_OK;
+	}
+
+RowFile::ReadResult RowFile::ReadBlock(FILE* f, std::string* data, uint32* num_rows,
+				       std::string* error)
+	{
+	off_t start = ftello(f);
+	BlockHeader hdr;
+
+	if ( ! read_all(f, &hdr, sizeof(hdr), start) )
+		return READ_END;
+
+	uint32 raw_len = ntohl(hdr.raw_len);
+	uint32 stored_len = ntohl(hdr.stored_len);
+
+	if ( raw_len > MAX_BLOCK_SIZE || stored_len > raw_len )
+		{
+		*error = "invalid block header";
+		return READ_ERROR;
+		}
+
+	std::string stored(stored_len, '\0');
+
+	if ( ! read_all(f, &stored[0], stored_len, start) )
+		return READ_END;
+
+	if ( crc32(0, (const Bytef*) stored.data(), stored_len) != ntohl(hdr.crc) )
+		{
+		*error = "block checksum mismatch";
+		return READ_ERROR;
+		}
+
+	*num_rows = ntohl(hdr.num_rows);
+
+	if ( stored_len == raw_len )
+		{
+		data->swap(stored);
+		return READ_OK;
+		}
+
+	data->resize(raw_len);
+	uLongf len = raw_len;
+
+	if ( uncompress((Bytef*) &(*data)[0], &len, (const Bytef*) stored.data(),
+			stored_len) != Z_OK || len != raw_len )
+		{
+		*error = "cannot decompress block";
+		return READ_ERROR;
+		}
+
+	return READ_OK;
+	}
@@ -0,0 +1,88 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#ifndef THREADING_ROWFILE_H
+#define THREADING_ROWFILE_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "SerialTypes.h"
+
+namespace threading {
+
+/**
+ * Reads and writes Zeek's binary row files, which carry log or input rows
+ * in the same serialization that the threads use to exchange them, so
+ * that no text has to be rendered or parsed in between.
+ *
+ * A file starts with a magic string and the schema, i.e., the fields in
+ * their serialized form, preceded by its length and checksum. Then follow
+ * blocks of rows, each of which has a header with the number of rows, the
+ * length of the serialized rows, the number of bytes stored, and a
+ * checksum of those. If fewer bytes are stored than the rows take, the
+ * block is zlib-compressed. All integers in the headers are in network
+ * byte order.
+ *
+ * Blocks are written in one go, so a reader following a growing file sees
+ * them either completely or not at all. The checksums matter as the
+ * serialization format aborts on running out of input.
+ */
+class RowFile {
+public:
+	/**
+	 * Outcome of reading from a file.
+	 */
+	enum ReadResult {
+		READ_OK,	//! Got what we asked for.
+		READ_END,	//! Nothing more (yet); the file position is unchanged.
+		READ_ERROR	//! The file is damaged or not a row file.
+	};
+
+	/**
+	 * Writes the file's magic and schema.
+	 *
+	 * @return False if writing failed; errno says why.
+	 */
+	static bool WriteHeader(FILE* f, int num_fields, const Field* const* fields);
+
+	/**
+	 * Writes a block of rows.
+	 *
+	 * @param data The rows, each the sequence of its fields' values in
+	 * their serialized form.
+	 *
+	 * @param compress If true, compresses the block if that makes it
+	 * smaller.
+	 *
+	 * @return False if writing failed; errno says why.
+	 */
+	static bool WriteBlock(FILE* f, const char* data, uint32 len,
+			       uint32 num_rows, bool compress);
+
+	/**
+	 * Reads the file's magic and schema.
+	 *
+	 * @param fields Receives the fields, which the caller takes ownership of.
+	 *
+	 * @param error Set to what's wrong if returning READ_ERROR.
+	 */
+	static ReadResult ReadHeader(FILE* f, std::vector<Field*>* fields,
+				     std::string* error);
+
+	/**
+	 * Reads the next block of rows.
+	 *
+	 * @param data Receives the serialized rows, uncompressed.
+	 *
+	 * @param num_rows Receives the number of rows in the block.
+	 *
+	 * @param error Set to what's wrong if returning READ_ERROR.
+	 */
+	static ReadResult ReadBlock(FILE* f, std::string* data, uint32* num_rows,
+				    std::string* error);
+};
+
+}
+
+#endif /* THREADING_ROWFILE_H */
@@ -419,3 +419,70 @@ bool Value::Write(SerializationFormat* fmt) const
 
 	return false;
 	}
+
+// Chunks start out at this size and double with each new one, up to the
+// maximum, so that a batch of rows needs just a handful.
+static const size_t ARENA_MIN_CHUNK_SIZE = 16 * 1024;
+static const size_t ARENA_MAX_CHUNK_SIZE = 1024 * 1024;
+static const size_t ARENA_ALIGN = alignof(Value);
+
+ValueArena::ValueArena()
+	{
+	used = size = 0;
+	}
+
+ValueArena::~ValueArena()
+	{
+	for ( const auto& c : chunks )
+		free(c.data);
+	}
+
+void* ValueArena::Allocate(size_t n)
+	{
+	n = (n + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+	if ( chunks.empty() || used + n > chunks.back().size )
+		{
+		size_t csize = chunks.empty() ? ARENA_MIN_CHUNK_SIZE : chunks.back().size * 2;
+
+		if ( csize > ARENA_MAX_CHUNK_SIZE )
+			csize = ARENA_MAX_CHUNK_SIZE;
+
+		if ( csize < n )
+			csize = n;
+
+		char* data = reinterpret_cast<char*>(malloc(csize));
+
+		if ( ! data )
+			out_of_memory("allocating log values");
+
+		chunks.push_back({data, csize});
+		used = 0;
+		}
+
+	void* p = chunks.back().data + used;
+	used += n;
+	size += n;
+	return p;
+	}
+
+char* ValueArena::CopyString(const char* s, size_t len)
+	{
+	char* p = static_cast<char*>(Allocate(len + 1));
+	memcpy(p, s, len);
+	p[len] = '\0';
+	return p;
+	}
+
+bool ValueArena::Owns(const void* p) const
+	{
+	const char* cp = static_cast<const char*>(p);
+
+	for ( const auto& c : chunks )
+		{
+		if ( cp >= c.data && cp < c.data + c.size )
+			return true;
+		}
+
+	return false;
+	}
@@ -7,6 +7,9 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
+#include <new>
+#include <vector>
+
 #include "Type.h"
 #include "net_util.h"
 
@@ -195,6 +198,77 @@ private:
 	Value(const Value& other)	{ } // Disabled.
 };
 
+/**
+ * Memory for the values of a batch of log writes. Rather than allocating
+ * each Value, its nested values and its string data separately, they are
+ * laid out one after the other in a few large chunks, which all get
+ * released at once with the arena. Values created in an arena must not be
+ * deleted individually.
+ *
+ * An arena may be filled by one thread and then passed on to another, but
+ * it must not be used from two threads at the same time.
+ */
+class ValueArena {
+public:
+	/**
+	 * Constructor.
+	 */
+	ValueArena();
+
+	/**
+	 * Destructor. Releases all the memory handed out.
+	 */
+	~ValueArena();
+
+	/**
+	 * Returns memory for \a size bytes, suitably aligned for any of the
+	 * data a Value holds.
+	 */
+	void* Allocate(size_t size);
+
+	/**
+	 * Creates a value in the arena, with the same arguments as Value's
+	 * constructor.
+	 */
+	Value* NewValue(TypeTag type, bool present = true)
+		{ return new (Allocate(sizeof(Value))) Value(type, present); }
+
+	/**
+	 * Creates an array of \a n value pointers in the arena.
+	 */
+	Value** NewValues(int n)
+		{ return static_cast<Value**>(Allocate(n * sizeof(Value*))); }
+
+	/**
+	 * Copies \a len bytes of string data into the arena, adding a
+	 * terminating NUL.
+	 */
+	char* CopyString(const char* s, size_t len);
+
+	/**
+	 * Returns true if \a p points into memory handed out by the arena.
+	 */
+	bool Owns(const void* p) const;
+
+	/**
+	 * Returns the number of bytes handed out so far.
+	 */
+	size_t Size() const	{ return size; }
+
+private:
+	struct Chunk {
+		char* data;
+		size_t size;
+	};
+
+	std::vector<Chunk> chunks;
+	size_t used;	// Bytes handed out from the last chunk.
+	size_t size;	// Bytes handed out from all chunks.
+
+	ValueArena(const ValueArena& other);	// Disabled.
+	ValueArena& operator=(const ValueArena& other);	// Disabled.
+};
+
 }
 
 #endif /* THREADING_SERIALIZATIONTYPES_H */
@@ -96,12 +96,18 @@ bool Ascii::Describe(ODesc* desc, threading::Value* val, const string& name) con
 		break;
 
 	case TYPE_SUBNET:
-		desc->Add(Render(val->val.subnet_val));
+		{
+		char buf[RENDER_BUF_SIZE];
+		desc->Add(Render(val->val.subnet_val, buf));
 		break;
+		}
 
 	case TYPE_ADDR:
-		desc->Add(Render(val->val.addr_val));
+		{
+		char buf[RENDER_BUF_SIZE];
+		desc->Add(Render(val->val.addr_val, buf));
 		break;
+		}
 
 	case TYPE_DOUBLE:
 		// Rendering via Add() truncates trailing 0s after the
@@ -115,8 +121,11 @@ bool Ascii::Describe(ODesc* desc, threading::Value* val, const string& name) con
 		// Rendering via Render() keeps trailing 0s after the decimal
 		// point. The difference with DOUBLE is mainly to keep the
 		// log format consistent.
-		desc->Add(Render(val->val.double_val));
+		{
+		char buf[RENDER_BUF_SIZE];
+		desc->Add(Render(val->val.double_val, buf));
 		break;
+		}
 
 	case TYPE_ENUM:
 	case TYPE_STRING:
@@ -10,38 +10,223 @@
 #include <errno.h>
 #include <math.h>
 #include <stdint.h>
+#include <string.h>
 
+#include "3rdparty/json.hpp"
+#include "ConvertUTF.h"
 #include "JSON.h"
 
 using namespace threading::formatter;
 
+static const uint64_t ONES = 0x0101010101010101ULL;
+static const uint64_t HIGHS = 0x8080808080808080ULL;
+
+// Returns true if any of the eight bytes in the word may need escaping:
+// control characters, quotes, backslashes and anything non-ASCII. This
+// is exact; it just checks all of them at once.
+static inline bool word_needs_escape(uint64_t w)
+	{
+	uint64_t quote = w ^ (ONES * '"');
+	uint64_t backslash = w ^ (ONES * '\\');
+
+	uint64_t ctrl = (w - ONES * 0x20) & ~w;
+	uint64_t q = (quote - ONES) & ~quote;
+	uint64_t b = (backslash - ONES) & ~backslash;
+
+	return ((ctrl | q | b | w) & HIGHS) != 0;
+	}
+
+static inline bool byte_needs_escape(unsigned char c)
+	{
+	return c < 0x20 || c == '"' || c == '\\' || c >= 0x80;
+	}
+
+// Returns the length of the prefix that can be copied over as is.
+static size_t clean_prefix(const char* s, size_t len)
+	{
+	size_t i = 0;
+
+	for ( ; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t) )
+		{
+		uint64_t w;
+		memcpy(&w, s + i, sizeof(w));
+
+		if ( word_needs_escape(w) )
+			break;
+		}
+
+	while ( i < len && ! byte_needs_escape(s[i]) )
+		++i;
+
+	return i;
+	}
+
+static void add_escaped_byte(ODesc* desc, unsigned char c)
+	{
+	// Same as json_escape_utf8(), with the backslash escaped on top.
+	char buf[5] = { '\\', '\\', 'x', '0', '0' };
+	bytetohex(c, buf + 3);
+	desc->AddN(buf, sizeof(buf));
+	}
+
+// Adds a string as a quoted JSON string. This produces exactly what
+// running it through json_escape_utf8() and then the json library would:
+// invalid UTF-8 and most control characters turn into \\xNN, everything
+// else gets JSON's standard escaping.
+static void add_json_string(ODesc* desc, const char* s, size_t len)
+	{
+	desc->AddN("\"", 1);
+
+	while ( len )
+		{
+		size_t n = clean_prefix(s, len);
+
+		if ( n )
+			{
+			desc->AddN(s, n);
+			s += n;
+			len -= n;
+
+			if ( ! len )
+				break;
+			}
+
+		unsigned char c = *s;
+
+		if ( c >= 0x80 )
+			{
+			size_t char_size = getNumBytesForUTF8(c);
+			auto p = reinterpret_cast<const UTF8*>(s);
+
+			if ( char_size == 0 || char_size > len ||
+			     ! isLegalUTF8Sequence(p, p + char_size) )
+				{
+				add_escaped_byte(desc, c);
+				char_size = 1;
+				}
+			else
+				desc->AddN(s, char_size);
+
+			s += char_size;
+			len -= char_size;
+			continue;
+			}
+
+		switch ( c ) {
+		case '"':	desc->AddN("\\\"", 2); break;
+		case '\\':	desc->AddN("\\\\", 2); break;
+		case '\b':	desc->AddN("\\b", 2); break;
+		case '\f':	desc->AddN("\\f", 2); break;
+		case '\n':	desc->AddN("\\n", 2); break;
+		case '\r':	desc->AddN("\\r", 2); break;
+		case '\t':	desc->AddN("\\t", 2); break;
+		default:	add_escaped_byte(desc, c); break;
+		}
+
+		++s;
+		--len;
+		}
+
+	desc->AddN("\"", 1);
+	}
+
+static void add_json_string(ODesc* desc, const char* s)
+	{
+	add_json_string(desc, s, strlen(s));
+	}
+
+static void add_json_number(ODesc* desc, double d)
+	{
+	if ( ! isfinite(d) )
+		{
+		// That's what the json library does, too.
+		desc->AddN("null", 4);
+		return;
+		}
+
+	// Use the json library's formatting, which gives the shortest
+	// representation that reads back as the same double.
+	char buf[64];
+	char* end = nlohmann::detail::to_chars(buf, buf + sizeof(buf), d);
+	desc->AddN(buf, end - buf);
+	}
+
+static void add_json_number(ODesc* desc, uint64_t u)
+	{
+	char buf[32];
+	modp_ulitoa10(u, buf);
+	desc->AddN(buf, strlen(buf));
+	}
+
+static void add_json_number(ODesc* desc, int64_t i)
+	{
+	char buf[32];
+	modp_litoa10(i, buf);
+	desc->AddN(buf, strlen(buf));
+	}
+
 JSON::JSON(MsgThread* t, TimeFormat tf) : Formatter(t), surrounding_braces(true)
 	{
 	timestamps = tf;
+	key_fields = 0;
 	}
 
 JSON::~JSON()
 	{
 	}
 
+const std::vector<string>& JSON::FieldKeys(int num_fields, const Field* const * fields) const
+	{
+	bool valid = (fields == key_fields && keys.size() == size_t(num_fields));
+
+	for ( int i = 0; valid && i < num_fields; i++ )
+		valid = (fields[i]->name == key_names[i]);
+
+	if ( valid )
+		return keys;
+
+	key_fields = fields;
+	key_names.clear();
+	keys.clear();
+
+	for ( int i = 0; i < num_fields; i++ )
+		{
+		ODesc d;
+		add_json_string(&d, fields[i]->name);
+		d.AddN(":", 1);
+
+		key_names.push_back(fields[i]->name);
+		keys.emplace_back(reinterpret_cast<const char*>(d.Bytes()), d.Len());
+		}
+
+	return keys;
+	}
+
 bool JSON::Describe(ODesc* desc, int num_fields, const Field* const * fields,
                     Value** vals) const
 	{
-	ZeekJson j = ZeekJson::object();
+	const std::vector<string>& k = FieldKeys(num_fields, fields);
+	bool first = true;
+
+	desc->AddN("{", 1);
 
 	for ( int i = 0; i < num_fields; i++ )
 		{
-		if ( vals[i]->present )
-			{
-			ZeekJson new_entry = BuildJSON(vals[i]);
-			if ( new_entry.is_null() )
-				return false;
+		if ( ! vals[i]->present )
+			continue;
 
-			j[fields[i]->name] = new_entry;
-			}
+		if ( ! first )
+			desc->AddN(",", 1);
+
+		desc->AddN(k[i].data(), k[i].size());
+
+		if ( ! BuildJSON(desc, vals[i]) )
+			return false;
+
+		first = false;
 		}
 
-	desc->Add(j.dump());
+	desc->AddN("}", 1);
 
 	return true;
 	}
@@ -57,11 +242,17 @@ bool JSON::Describe(ODesc* desc, Value* val, const string& name) const
 	if ( ! val->present )
 		return true;
 
-	ZeekJson j = BuildJSON(val, name);
-	if ( j.is_null() )
+	if ( name.empty() )
+		return BuildJSON(desc, val);
+
+	desc->AddN("{", 1);
+	add_json_string(desc, name.data(), name.size());
+	desc->AddN(":", 1);
+
+	if ( ! BuildJSON(desc, val) )
 		return false;
 
-	desc->Add(j.dump());
+	desc->AddN("}", 1);
 	return true;
 	}
 
@@ -71,39 +262,47 @@ threading::Value* JSON::ParseValue(const string& s, const string& name, TypeTag
 	return nullptr;
 	}
 
-ZeekJson JSON::BuildJSON(Value* val, const string& name) const
+bool JSON::BuildJSON(ODesc* desc, Value* val) const
 	{
-	ZeekJson j;
 	switch ( val->type )
 		{
 		case TYPE_BOOL:
-			j = val->val.int_val != 0;
+			if ( val->val.int_val != 0 )
+				desc->AddN("true", 4);
+			else
+				desc->AddN("false", 5);
 			break;
 
 		case TYPE_INT:
-			j = val->val.int_val;
+			add_json_number(desc, int64_t(val->val.int_val));
 			break;
 
 		case TYPE_COUNT:
 		case TYPE_COUNTER:
-			j = val->val.uint_val;
+			add_json_number(desc, uint64_t(val->val.uint_val));
 			break;
 
 		case TYPE_PORT:
-			j = val->val.port_val.port;
+			add_json_number(desc, uint64_t(val->val.port_val.port));
 			break;
 
 		case TYPE_SUBNET:
-			j = Formatter::Render(val->val.subnet_val);
+			{
+			char buf[RENDER_BUF_SIZE];
+			add_json_string(desc, Formatter::Render(val->val.subnet_val, buf));
 			break;
+			}
 
 		case TYPE_ADDR:
-			j = Formatter::Render(val->val.addr_val);
+			{
+			char buf[RENDER_BUF_SIZE];
+			add_json_string(desc, Formatter::Render(val->val.addr_val, buf));
 			break;
+			}
 
 		case TYPE_DOUBLE:
 		case TYPE_INTERVAL:
-			j = val->val.double_val;
+			add_json_number(desc, val->val.double_val);
 			break;
 
 		case TYPE_TIME:
@@ -121,7 +320,7 @@ ZeekJson JSON::BuildJSON(Value* val, const string& name) const
 					GetThread()->Error(GetThread()->Fmt("json formatter: failure getting time: (%lf)", val->val.double_val));
 					// This was a failure, doesn't really matter what gets put here
 					// but it should probably stand out...
-					j = "2000-01-01T00:00:00.000000";
+					add_json_string(desc, "2000-01-01T00:00:00.000000");
 					}
 				else
 					{
@@ -132,19 +331,22 @@ ZeekJson JSON::BuildJSON(Value* val, const string& name) const
 						frac += 1;
 
 					snprintf(buffer2, sizeof(buffer2), "%s.%06.0fZ", buffer, fabs(frac) * 1000000);
-					j = buffer2;
+					add_json_string(desc, buffer2);
 					}
 				}
 
 			else if ( timestamps == TS_EPOCH )
-				j = val->val.double_val;
+				add_json_number(desc, val->val.double_val);
 
 			else if ( timestamps == TS_MILLIS )
 				{
 				// ElasticSearch uses milliseconds for timestamps
-				j = (uint64_t) (val->val.double_val * 1000);
+				add_json_number(desc, (uint64_t) (val->val.double_val * 1000));
 				}
 
+			else
+				return false;
+
 			break;
 			}
 
@@ -152,41 +354,34 @@ ZeekJson JSON::BuildJSON(Value* val, const string& name) const
 		case TYPE_STRING:
 		case TYPE_FILE:
 		case TYPE_FUNC:
-			{
-			j = json_escape_utf8(string(val->val.string_val.data, val->val.string_val.length));
+			add_json_string(desc, val->val.string_val.data, val->val.string_val.length);
 			break;
-			}
 
 		case TYPE_TABLE:
+		case TYPE_VECTOR:
 			{
-			j = ZeekJson::array();
+			const Value::set_t& s = (val->type == TYPE_TABLE ? val->val.set_val : val->val.vector_val);
 
-			for ( int idx = 0; idx < val->val.set_val.size; idx++ )
-				j.push_back(BuildJSON(val->val.set_val.vals[idx]));
+			desc->AddN("[", 1);
 
-			break;
-			}
-
-		case TYPE_VECTOR:
-			{
-			j = ZeekJson::array();
+			for ( bro_int_t idx = 0; idx < s.size; idx++ )
+				{
+				if ( idx )
+					desc->AddN(",", 1);
 
-			for ( int idx = 0; idx < val->val.vector_val.size; idx++ )
-				j.push_back(BuildJSON(val->val.vector_val.vals[idx]));
+				// Like the json library, we put in a null for
+				// elements we can't represent.
+				if ( ! BuildJSON(desc, s.vals[idx]) )
+					desc->AddN("null", 4);
+				}
 
+			desc->AddN("]", 1);
 			break;
 			}
 
 		default:
-			break;
-		}
-
-	if ( ! name.empty() && ! j.is_null() )
-		{
-		ZeekJson j2 = ZeekJson::object();
-		j2[name] = j;
-		return j2;
+			return false;
 		}
 
-	return j;
+	return true;
 	}
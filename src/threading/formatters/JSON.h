@@ -3,20 +3,12 @@
 #ifndef THREADING_FORMATTERS_JSON_H
 #define THREADING_FORMATTERS_JSON_H
 
-#include "../Formatter.h"
-#include "3rdparty/json.hpp"
-#include "3rdparty/fifo_map.hpp"
+#include <vector>
 
+#include "../Formatter.h"
 
 namespace threading { namespace formatter {
 
-// Define a class for use with the json library that orders the keys in the same order that
-// they were inserted. By default, the json library orders them alphabetically and we don't
-// want it like that.
-template<class K, class V, class compare, class A>
-using json_fifo_map = nlohmann::fifo_map<K, V, nlohmann::fifo_map_compare<K>, A>;
-using ZeekJson = nlohmann::basic_json<json_fifo_map>;
-
 /**
   * A thread-safe class for converting values into a JSON representation
   * and vice versa.
@@ -39,10 +31,21 @@ public:
 
 private:
 
-	ZeekJson BuildJSON(Value* val, const string& name = "") const;
+	// Writes the JSON representation of a value into the description.
+	// Returns false if its type isn't supported.
+	bool BuildJSON(ODesc* desc, Value* val) const;
+
+	// Returns the escaped and quoted key, including the colon, for each
+	// of a set of fields. It's computed once per set of fields, which
+	// stays the same for the lifetime of a writer.
+	const std::vector<string>& FieldKeys(int num_fields, const Field* const * fields) const;
 
 	TimeFormat timestamps;
 	bool surrounding_braces;
+
+	mutable const Field* const * key_fields;
+	mutable std::vector<const char*> key_names;
+	mutable std::vector<string> keys;
 };
 
 }}
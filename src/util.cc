@@ -1564,6 +1564,13 @@ uint64 calculate_unique_id()
 	}
 
 uint64 calculate_unique_id(size_t pool)
+	{
+	uint64 rval;
+	calculate_unique_ids(&rval, 1, pool);
+	return rval;
+	}
+
+void calculate_unique_ids(uint64* dst, size_t n, size_t pool)
 	{
 	uint64 uid_instance = 0;
 
@@ -1617,8 +1624,13 @@ uint64 calculate_unique_id(size_t pool)
 	assert(!uid_pool[pool].needs_init);
 	assert(uid_pool[pool].key.instance != 0);
 
-	++uid_pool[pool].key.counter;
-	return HashKey::HashBytes(&(uid_pool[pool].key), sizeof(uid_pool[pool].key));
+	auto& key = uid_pool[pool].key;
+
+	for ( size_t i = 0; i < n; ++i )
+		{
+		++key.counter;
+		dst[i] = HashKey::HashBytes(&key, sizeof(key));
+		}
 	}
 
 bool safe_write(int fd, const char* data, int len)
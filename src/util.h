@@ -427,6 +427,12 @@ extern int time_compare(struct timeval* tv_a, struct timeval* tv_b);
 extern uint64 calculate_unique_id();
 extern uint64 calculate_unique_id(const size_t pool);
 
+// Fills dst with the next n integers of the given pool. This yields the
+// same sequence as n calls to calculate_unique_id(), with the pool set
+// up only once.
+extern void calculate_unique_ids(uint64* dst, size_t n,
+                                 const size_t pool = UID_POOL_DEFAULT_INTERNAL);
+
 // For now, don't use hash_maps - they're not fully portable.
 #if 0
 // Use for hash_map's string keys.
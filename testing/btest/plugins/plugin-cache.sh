@@ -0,0 +1,23 @@
+# @TEST-EXEC: bash %INPUT
+# @TEST-EXEC: ZEEK_PLUGIN_PATH=`pwd`/plugins ZEEK_PLUGIN_CACHE=`pwd`/cache ZEEK_PLUGIN_ACTIVATE=Demo::Foo zeek -b >>output
+# @TEST-EXEC: grep -q "Demo::Foo" cache
+#
+# Rename the plugin in the cache only, so that activating it under the new
+# name works only if the cache gets used.
+# @TEST-EXEC: sed 's/Demo::Foo/Demo::Cached/' cache >cache.tmp && mv cache.tmp cache
+# @TEST-EXEC: echo === >>output
+# @TEST-EXEC: ZEEK_PLUGIN_PATH=`pwd`/plugins ZEEK_PLUGIN_CACHE=`pwd`/cache ZEEK_PLUGIN_ACTIVATE=Demo::Cached zeek -b >>output
+#
+# Adding a plugin makes the cache out of date.
+# @TEST-EXEC: mkdir -p plugins/bar/scripts && echo Demo::Bar >plugins/bar/__bro_plugin__
+# @TEST-EXEC: echo 'print "bar loaded";' >plugins/bar/scripts/__load__.zeek
+# @TEST-EXEC: echo === >>output
+# @TEST-EXEC: ZEEK_PLUGIN_PATH=`pwd`/plugins ZEEK_PLUGIN_CACHE=`pwd`/cache ZEEK_PLUGIN_ACTIVATE=Demo::Bar zeek -b >>output
+# @TEST-EXEC: btest-diff output
+
+mkdir -p plugins/foo/scripts
+echo Demo::Foo >plugins/foo/__bro_plugin__
+echo 'print "foo loaded";' >plugins/foo/scripts/__load__.zeek
+
+# The cache doesn't get written while directories have just changed.
+touch -t 201901010000 plugins plugins/foo plugins/foo/__bro_plugin__